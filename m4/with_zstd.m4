@@ -0,0 +1,81 @@
+
+#
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+#
+AC_DEFUN([PBS_AC_WITH_ZSTD],
+[
+  AC_ARG_WITH([zstd],
+    AS_HELP_STRING([--with-zstd@<:@=DIR@:>@],
+      [Use zstd as an optional TPP compression codec, optionally specifying the directory where zstd is installed.]
+    )
+  )
+  AS_IF([test "x$with_zstd" != "x" -a "x$with_zstd" != "xno"],
+  [
+    AS_IF([test "x$with_zstd" != "xyes"],
+      [zstd_dir="$with_zstd"],
+      [zstd_dir=""]
+    )
+    AC_MSG_CHECKING([for zstd])
+    AS_IF(
+      [test "$zstd_dir" = ""],
+      AC_CHECK_HEADER([zstd.h], [], AC_MSG_ERROR([zstd headers not found.])),
+      [test -r "$zstd_dir/include/zstd.h"],
+      [zstd_inc="-I$zstd_dir/include"],
+      AC_MSG_ERROR([zstd headers not found.])
+    )
+    AS_IF(
+      # Using system installed zstd
+      [test "$zstd_dir" = ""],
+      AC_CHECK_LIB([zstd], [ZSTD_compress],
+        [zstd_lib="-lzstd"],
+        AC_MSG_ERROR([zstd shared object library not found.])),
+      # Using developer installed zstd
+      [test -r "${zstd_dir}/lib64/libzstd.a"],
+      [zstd_lib="${zstd_dir}/lib64/libzstd.a"],
+      [test -r "${zstd_dir}/lib/libzstd.a"],
+      [zstd_lib="${zstd_dir}/lib/libzstd.a"],
+      AC_MSG_ERROR([zstd not found.])
+    )
+    AC_MSG_RESULT([$zstd_dir])
+    # everything that links libz for TPP compression links zstd too
+    libz_inc="$libz_inc $zstd_inc"
+    libz_lib="$libz_lib $zstd_lib"
+    AC_DEFINE([PBS_ZSTD_ENABLED], [], [Defined when zstd is available])
+  ])
+])
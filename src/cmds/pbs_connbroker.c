@@ -0,0 +1,630 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file	pbs_connbroker.c
+ * @brief
+ * 	pbs_connbroker - local connection broker for PBS commands
+ *
+ *	Runs as a user and keeps a small pool of connections to the server
+ *	that are already authenticated as that user.  Commands started with
+ *	PBS_CONN_BROKER pointing at the broker's Unix socket ask it for a
+ *	session instead of connecting to the server themselves; the broker
+ *	lends them an idle server connection and relays the DIS packets of
+ *	the session both ways.  A command ends its session with a packet of
+ *	type PBS_CONN_BROKER_EOS in place of the Disconnect request; only
+ *	then, and with no reply outstanding, does the server connection go
+ *	back into the pool.  A session that just drops is not trusted to have
+ *	left the connection at a message boundary, so it is closed.
+ *
+ *	The batch protocol has no request tags, so a server connection
+ *	carries one session at a time; the pool size bounds how many
+ *	commands are served at once, others wait for a connection.
+ *
+ *	On startup the broker prints the environment setting for the shell,
+ *	in the manner of ssh-agent:
+ *		eval `pbs_connbroker`
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+#include <pbs_version.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+
+#include "cmds.h"
+#include "dis.h"
+#include "pbs_internal.h"
+#include "libutil.h"
+
+#define BROKER_SESSIONS	8	/* default number of server connections */
+#define BROKER_IDLE	300	/* default seconds an idle connection is kept */
+#define BROKER_HELLO_TOUT 10	/* seconds a client has to send its request */
+
+/* an idle, authenticated connection to the server */
+struct broker_conn {
+	int bc_sd;
+	time_t bc_last;		/* when it was last given back */
+	struct broker_conn *bc_next;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static struct broker_conn *pool_idle = NULL;
+static int pool_total = 0;	/* connections open, idle or lent */
+static int max_sessions = BROKER_SESSIONS;
+static int idle_secs = BROKER_IDLE;
+
+static char *server = NULL;	/* server as given on the command line */
+static char svr_name[PBS_MAXSERVERNAME + 1];
+static unsigned int svr_port;
+static volatile sig_atomic_t done = 0;
+
+/**
+ * @brief
+ *	is there anything to read on a socket right now?  On an idle server
+ *	connection that means it was closed or carries a stray reply.
+ *
+ * @param[in] sd - socket
+ *
+ * @return int
+ * @retval 1	readable or in error
+ * @retval 0	nothing pending
+ */
+static int
+sock_pending(int sd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = sd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return (poll(&pfd, 1, 0) != 0);
+}
+
+/**
+ * @brief
+ *	take a server connection from the pool, opening a new one if the
+ *	pool is below its size, otherwise wait for one to be given back.
+ *
+ * @return int
+ * @retval >= 0	connection to the server
+ * @retval -1	could not connect, pbs_errno is set
+ */
+static int
+pool_get(void)
+{
+	struct broker_conn *bc;
+	int sd;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		while ((bc = pool_idle) != NULL) {
+			pool_idle = bc->bc_next;
+			sd = bc->bc_sd;
+			free(bc);
+			if (!sock_pending(sd)) {
+				pthread_mutex_unlock(&pool_lock);
+				return sd;
+			}
+			/* closed by the server while idle */
+			pool_total--;
+			pthread_mutex_unlock(&pool_lock);
+			pbs_disconnect(sd);
+			pthread_mutex_lock(&pool_lock);
+		}
+		if (pool_total < max_sessions)
+			break;
+		pthread_cond_wait(&pool_cond, &pool_lock);
+	}
+	pool_total++;
+	pthread_mutex_unlock(&pool_lock);
+
+	if ((sd = pbs_connect(server)) < 0) {
+		pthread_mutex_lock(&pool_lock);
+		pool_total--;
+		pthread_cond_signal(&pool_cond);
+		pthread_mutex_unlock(&pool_lock);
+		return -1;
+	}
+	return sd;
+}
+
+/**
+ * @brief
+ *	give a server connection back to the pool, or close it.
+ *
+ * @param[in] sd - connection to the server
+ * @param[in] reuse - non-zero if it is in a clean state
+ *
+ * @return void
+ */
+static void
+pool_put(int sd, int reuse)
+{
+	struct broker_conn *bc = NULL;
+
+	if (reuse && (bc = malloc(sizeof(struct broker_conn))) != NULL) {
+		bc->bc_sd = sd;
+		bc->bc_last = time(NULL);
+		pthread_mutex_lock(&pool_lock);
+		bc->bc_next = pool_idle;
+		pool_idle = bc;
+	} else {
+		pbs_disconnect(sd);
+		pthread_mutex_lock(&pool_lock);
+		pool_total--;
+	}
+	pthread_cond_signal(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+/**
+ * @brief
+ *	close pooled connections that have been idle too long, or all of them.
+ *
+ * @param[in] all - close every idle connection
+ *
+ * @return void
+ */
+static void
+pool_expire(int all)
+{
+	struct broker_conn **pbc;
+	struct broker_conn *bc;
+	struct broker_conn *expired = NULL;
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&pool_lock);
+	for (pbc = &pool_idle; (bc = *pbc) != NULL;) {
+		if (all || now - bc->bc_last >= idle_secs || sock_pending(bc->bc_sd)) {
+			*pbc = bc->bc_next;
+			bc->bc_next = expired;
+			expired = bc;
+			pool_total--;
+		} else
+			pbc = &bc->bc_next;
+	}
+	pthread_cond_broadcast(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	while ((bc = expired) != NULL) {
+		expired = bc->bc_next;
+		pbs_disconnect(bc->bc_sd);
+		free(bc);
+	}
+}
+
+/**
+ * @brief
+ *	read the session request line of a client.
+ *
+ * @param[in] sd - client socket
+ * @param[out] buf - line read, without the newline
+ * @param[in] len - size of buf
+ *
+ * @return int
+ * @retval 0	success
+ * @retval -1	error, timeout or line too long
+ */
+static int
+read_hello(int sd, char *buf, size_t len)
+{
+	struct pollfd pfd;
+	size_t i;
+
+	pfd.fd = sd;
+	pfd.events = POLLIN;
+	for (i = 0; i < len - 1; i++) {
+		pfd.revents = 0;
+		if (poll(&pfd, 1, BROKER_HELLO_TOUT * 1000) != 1)
+			return -1;
+		if (read(sd, &buf[i], 1) != 1)
+			return -1;
+		if (buf[i] == '\n') {
+			buf[i] = '\0';
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief
+ *	relay DIS packets between a client and a server connection until the
+ *	client ends the session or disconnects.
+ *
+ * @param[in] cfd - client socket
+ * @param[in] sfd - server connection
+ *
+ * @return int
+ * @retval 1	the server connection is clean and can be reused
+ * @retval 0	it must be closed
+ */
+static int
+relay(int cfd, int sfd)
+{
+	struct pollfd pfd[2];
+	int outstanding = 0;	/* a request went up with no reply seen yet */
+	int type;
+	void *data;
+	size_t len;
+
+	pfd[0].fd = cfd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = sfd;
+	pfd[1].events = POLLIN;
+
+	for (;;) {
+		pfd[0].revents = 0;
+		pfd[1].revents = 0;
+		if (poll(pfd, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+		if (pfd[1].revents) {
+			if (transport_recv_pkt(sfd, &type, &data, &len) <= 0)
+				return 0;
+			if (transport_send_pkt(cfd, type, data, len) < 0)
+				return 0;
+			outstanding = 0;
+			continue;
+		}
+		if (pfd[0].revents) {
+			if (transport_recv_pkt(cfd, &type, &data, &len) <= 0)
+				return 0;
+			if (type == PBS_CONN_BROKER_EOS)
+				break;
+			if (transport_send_pkt(sfd, type, data, len) < 0)
+				return 0;
+			outstanding = 1;
+		}
+	}
+
+	/* session ended cleanly; reuse only if nothing more is due from the server */
+	return (!outstanding && !sock_pending(sfd));
+}
+
+/**
+ * @brief
+ *	serve one client session, runs in its own thread.
+ *
+ * @param[in] arg - client socket
+ *
+ * @return NULL
+ */
+static void *
+session(void *arg)
+{
+	int cfd = (int)(intptr_t) arg;
+	int sfd;
+	int port;
+	int reuse;
+	char line[PBS_CONN_BROKER_LINESZ];
+	char word[sizeof(line)];
+	char host[sizeof(line)];
+
+	if (read_hello(cfd, line, sizeof(line)) != 0 ||
+		sscanf(line, "%s %s %d", word, host, &port) != 3 ||
+		strcmp(word, PBS_CONN_BROKER_HELLO) != 0) {
+		close(cfd);
+		return NULL;
+	}
+
+	/* only sessions with the server the pool is connected to */
+	if (port != svr_port || !is_same_host(host, svr_name)) {
+		snprintf(line, sizeof(line), "ERR %d\n", PBSE_NOSERVER);
+		(void) write(cfd, line, strlen(line));
+		close(cfd);
+		return NULL;
+	}
+
+	if ((sfd = pool_get()) < 0) {
+		snprintf(line, sizeof(line), "ERR %d\n", pbs_errno);
+		(void) write(cfd, line, strlen(line));
+		close(cfd);
+		return NULL;
+	}
+
+	snprintf(line, sizeof(line), "OK %d\n", dis_get_version(sfd));
+	if (write(cfd, line, strlen(line)) != strlen(line))
+		reuse = 1;
+	else
+		reuse = relay(cfd, sfd);
+
+	dis_destroy_chan(cfd);
+	destroy_connection(cfd);
+	close(cfd);
+	pool_put(sfd, reuse);
+	return NULL;
+}
+
+/**
+ * @brief
+ *	check that a client runs as the same user as the broker.
+ *
+ * @param[in] sd - accepted client socket
+ *
+ * @return int
+ * @retval 1	same user
+ * @retval 0	other user, or cannot tell
+ */
+static int
+peer_is_me(int sd)
+{
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	pbs_socklen_t len = sizeof(cred);
+
+	if (getsockopt(sd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return 0;
+	return (cred.uid == getuid());
+#else
+	uid_t euid;
+	gid_t egid;
+
+	if (getpeereid(sd, &euid, &egid) != 0)
+		return 0;
+	return (euid == getuid());
+#endif
+}
+
+/**
+ * @brief
+ *	create the directory for the broker socket, or check that an
+ *	existing one belongs to us and is private.
+ *
+ * @param[in] dir - directory path
+ *
+ * @return int
+ * @retval 0	success
+ * @retval -1	error, a message has been printed
+ */
+static int
+make_sockdir(char *dir)
+{
+	struct stat sb;
+
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		fprintf(stderr, "pbs_connbroker: cannot create %s: %s\n", dir, strerror(errno));
+		return -1;
+	}
+	if (lstat(dir, &sb) != 0 || !S_ISDIR(sb.st_mode) ||
+		sb.st_uid != getuid() || (sb.st_mode & 077) != 0) {
+		fprintf(stderr, "pbs_connbroker: %s is not a private directory\n", dir);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	signal handler, asks the accept loop to stop.
+ *
+ * @param[in] sig - signal number
+ *
+ * @return void
+ */
+static void
+stop(int sig)
+{
+	done = 1;
+}
+
+int
+main(int argc, char **argv)
+{
+	int c;
+	int errflg = 0;
+	int foreground = 0;
+	int lsd;
+	int cfd;
+	int sd;
+	char *sockpath = NULL;
+	char sockdir[MAXPATHLEN + 1];
+	char defpath[sizeof(sockdir) + sizeof("/socket")];
+	struct sockaddr_un sun;
+	struct pollfd pfd;
+	struct sigaction act;
+	pthread_t tid;
+	pthread_attr_t attr;
+
+	/*test for real deal or just version and exit*/
+
+	PRINT_VERSION_AND_EXIT(argc, argv);
+
+	if (initsocketlib())
+		return 1;
+
+	while ((c = getopt(argc, argv, "a:fi:n:")) != EOF) {
+		switch (c) {
+			case 'a':
+				sockpath = optarg;
+				break;
+			case 'f':
+				foreground = 1;
+				break;
+			case 'i':
+				if ((idle_secs = atoi(optarg)) <= 0)
+					errflg++;
+				break;
+			case 'n':
+				if ((max_sessions = atoi(optarg)) <= 0)
+					errflg++;
+				break;
+			default:
+				errflg++;
+		}
+	}
+	if (optind < argc)
+		server = argv[optind++];
+
+	if (errflg || optind != argc) {
+		static char usage[] =
+			"usage:\n"
+		"\tpbs_connbroker [-f] [-a socket] [-i idle_seconds] [-n connections] [server]\n"
+		"\tpbs_connbroker --version\n";
+		fprintf(stderr, "%s", usage);
+		exit(2);
+	}
+
+	/* the broker must connect to the server itself */
+	unsetenv(PBS_CONN_BROKER_ENV);
+
+	if (pbs_loadconf(0) == 0) {
+		fprintf(stderr, "pbs_connbroker: cannot load pbs.conf\n");
+		exit(1);
+	}
+	if (get_num_servers() > 1 && server == NULL) {
+		fprintf(stderr, "pbs_connbroker: multi-server configurations are not supported\n");
+		exit(1);
+	}
+	if (PBS_get_server(server, svr_name, &svr_port) == NULL) {
+		fprintf(stderr, "pbs_connbroker: cannot resolve the server name\n");
+		exit(1);
+	}
+
+	if (sockpath == NULL) {
+		snprintf(sockdir, sizeof(sockdir), "%s/pbs_broker.%d", pbs_conf.pbs_tmpdir, (int) getuid());
+		if (make_sockdir(sockdir) != 0)
+			exit(1);
+		snprintf(defpath, sizeof(defpath), "%s/socket", sockdir);
+		sockpath = defpath;
+	}
+	if (strlen(sockpath) >= sizeof(sun.sun_path)) {
+		fprintf(stderr, "pbs_connbroker: socket path too long: %s\n", sockpath);
+		exit(1);
+	}
+
+	/*perform needed security library initializations (including none)*/
+
+	if (CS_client_init() != CS_SUCCESS) {
+		fprintf(stderr, "pbs_connbroker: unable to initialize security library.\n");
+		exit(1);
+	}
+
+	DIS_tcp_funcs();
+
+	/* open the first connection now so that problems show up at startup */
+	if ((sd = pool_get()) < 0) {
+		fprintf(stderr, "pbs_connbroker: cannot connect to server %s, error=%d\n", svr_name, pbs_errno);
+		exit(1);
+	}
+	pool_put(sd, 1);
+
+	if ((lsd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("pbs_connbroker: socket");
+		exit(1);
+	}
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strcpy(sun.sun_path, sockpath);
+	unlink(sockpath);
+	if (bind(lsd, (struct sockaddr *) &sun, sizeof(sun)) != 0 ||
+		chmod(sockpath, 0600) != 0 || listen(lsd, 128) != 0) {
+		fprintf(stderr, "pbs_connbroker: cannot listen on %s: %s\n", sockpath, strerror(errno));
+		exit(1);
+	}
+
+	printf("%s=%s; export %s;\n", PBS_CONN_BROKER_ENV, sockpath, PBS_CONN_BROKER_ENV);
+	fflush(stdout);
+
+	if (!foreground) {
+		pid_t pid = fork();
+
+		if (pid == -1) {
+			perror("pbs_connbroker: fork");
+			exit(1);
+		} else if (pid > 0)
+			exit(0);
+		setsid();
+		if ((c = open("/dev/null", O_RDWR)) != -1) {
+			dup2(c, 0);
+			dup2(c, 1);
+			dup2(c, 2);
+			if (c > 2)
+				close(c);
+		}
+	}
+
+	memset(&act, 0, sizeof(act));
+	sigemptyset(&act.sa_mask);
+	act.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &act, NULL);
+	act.sa_handler = stop;
+	sigaction(SIGTERM, &act, NULL);
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGHUP, &act, NULL);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	pfd.fd = lsd;
+	pfd.events = POLLIN;
+	while (!done) {
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 1000) <= 0) {
+			pool_expire(0);
+			continue;
+		}
+		if ((cfd = accept(lsd, NULL, NULL)) == -1)
+			continue;
+		if (!peer_is_me(cfd) ||
+			pthread_create(&tid, &attr, session, (void *)(intptr_t) cfd) != 0)
+			close(cfd);
+	}
+
+	close(lsd);
+	unlink(sockpath);
+	if (sockpath == defpath)
+		rmdir(sockdir);
+	pool_expire(1);
+	CS_close_app();
+	return 0;
+}
@@ -1728,6 +1728,12 @@ display(int otype, int ptype, char *oname, struct batch_status *status,
 						attr = attr->next;
 						continue;
 					}
+					if ((otype == MGR_OBJ_SCHED) &&
+						(strcmp(attr->name, ATTR_sched_cycle_profile) == 0)) {
+						/* kept up to date by the scheduler, not a setting */
+						attr = attr->next;
+						continue;
+					}
 					if (otype == MGR_OBJ_RSC) {
 						if ((attr != NULL) && (strcmp(attr->name, ATTR_RESC_TYPE) == 0)) {
 							struct resc_type_map *rtm = find_resc_type_map_by_typev(atoi(attr->value));
@@ -86,6 +86,8 @@ extern "C" {
 
 extern int  acct_open(char *filename);
 extern void acct_close(void);
+extern int  acct_async_start(unsigned int bufsize, int fsync_interval);
+extern void acct_flush(void);
 extern void account_record(int acctype, const job *pjob, char *text);
 extern void write_account_record(int acctype, const char *jobid, char *text);
 
@@ -316,6 +316,10 @@ extern void clear_attr(attribute *pattr, attribute_def *pdef);
 extern int  find_attr  (void *attrdef_idx, attribute_def *attr_def, char *name);
 extern int  recov_attr_fs(int fd, void *parent, void *padef_idx, attribute_def *padef,
 	attribute *pattr, int limit, int unknown);
+extern int  recov_attr_mem(char *buf, size_t len, char *fname, void *padef_idx,
+	attribute_def *padef, attribute *pattr, int unknown, char *recov_act);
+extern void recov_attr_action(void *parent, attribute_def *padef, attribute *pattr,
+	int limit, char *recov_act);
 extern void free_null  (attribute *attr);
 extern void free_none  (attribute *attr);
 extern svrattrl *attrlist_alloc(int szname, int szresc, int szval);
@@ -460,6 +464,7 @@ extern void free_depend(attribute *attr);
 extern void free_unkn(attribute *attr);
 extern int   parse_equal_string(char  *start, char **name, char **value);
 extern char *parse_comma_string(char *start);
+extern char *parse_comma_string_ctx(char *start, char **ctx);
 extern char *return_external_value(char *name, char *val);
 extern char *return_internal_value(char *name, char *val);
 
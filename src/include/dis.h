@@ -71,6 +71,18 @@ extern "C" {
 #define DIS_NOCOMMIT	10	/* Protocol failure in commit */
 #define DIS_EOF		11	/* End of File */
 
+/*
+ * Encoding versions of a DIS channel.  Version 1 is the original ASCII
+ * Data-is-Strings encoding.  Version 2 sends integers (and so string counts)
+ * as binary varints, it is only used once both ends of a connection have
+ * agreed to it.  Floating point values are encoded as in version 1.
+ */
+#define DIS_VERSION_1	1
+#define DIS_VERSION_2	2
+
+/* maximum length in bytes of a version 2 encoded integer */
+#define DIS_VARINT_MAXSZ	10
+
 
 unsigned long disrul(int stream, int *retval);
 
@@ -225,6 +237,7 @@ typedef struct pbs_tcp_chan {
 	pbs_dis_buf_t readbuf;
 	pbs_dis_buf_t writebuf;
 	int is_old_client; /* This is just for backward compatibility */
+	int dis_version; /* DIS_VERSION_2 if binary encoding was negotiated */
 	pbs_tcp_auth_data_t auths[2];
 } pbs_tcp_chan_t;
 
@@ -235,6 +248,10 @@ int dis_getc(int);
 int dis_gets(int, char *, size_t);
 int dis_puts(int, const char *, size_t);
 int dis_flush(int);
+int dis_getv(int, int *, u_Long *);
+int dis_putv(int, int, u_Long);
+int dis_get_version(int);
+void dis_set_version(int, int);
 void dis_setup_chan(int, pbs_tcp_chan_t * (*)(int));
 void dis_destroy_chan(int);
 
@@ -112,6 +112,42 @@ typedef enum hook_user hook_user;
 #define MOM_EVENTS	(HOOK_EVENT_EXECJOB_BEGIN|HOOK_EVENT_EXECJOB_PROLOGUE|HOOK_EVENT_EXECJOB_EPILOGUE|HOOK_EVENT_EXECJOB_END|HOOK_EVENT_EXECJOB_PRETERM|HOOK_EVENT_EXECHOST_PERIODIC|HOOK_EVENT_EXECJOB_LAUNCH|HOOK_EVENT_EXECHOST_STARTUP|HOOK_EVENT_EXECJOB_ATTACH|HOOK_EVENT_EXECJOB_RESIZE|HOOK_EVENT_EXECJOB_ABORT|HOOK_EVENT_EXECJOB_POSTSUSPEND|HOOK_EVENT_EXECJOB_PRERESUME)
 #define USER_MOM_EVENTS	(HOOK_EVENT_EXECJOB_PROLOGUE|HOOK_EVENT_EXECJOB_EPILOGUE|HOOK_EVENT_EXECJOB_PRETERM)
 #define FAIL_ACTION_EVENTS (HOOK_EVENT_EXECJOB_BEGIN|HOOK_EVENT_EXECHOST_STARTUP|HOOK_EVENT_EXECJOB_PROLOGUE)
+/* server events whose outcome does not gate a reply, hence may run in the background */
+#define ASYNC_HOOK_EVENTS	(HOOK_EVENT_MANAGEMENT|HOOK_EVENT_MODIFYVNODE|HOOK_EVENT_RESV_END)
+
+/* Hook profiling: per event latency histograms and outcome counts */
+#define HOOK_PROF_NEVENTS	32	/* one per HOOK_EVENT_* bit */
+#define HOOK_PROF_BUCKETS	24	/* bucket i holds times <= 2^i usecs, last one the rest */
+
+enum hook_prof_phase {
+	HOOK_PROF_MARSHAL,	/* building the Python event objects */
+	HOOK_PROF_RUN,		/* running the hook script */
+	HOOK_PROF_APPLY,	/* acting on the hook results */
+	HOOK_PROF_NPHASES
+};
+
+enum hook_prof_counter {
+	HOOK_PROF_CALLS,
+	HOOK_PROF_REJECTS,
+	HOOK_PROF_TIMEOUTS,
+	HOOK_PROF_ERRORS,	/* internal errors and unhandled exceptions */
+	HOOK_PROF_RESTARTS,	/* Python interpreter restarts */
+	HOOK_PROF_NCOUNTS
+};
+
+struct hook_prof_hist {
+	unsigned long long	total_us;
+	unsigned long long	max_us;
+	unsigned int		bucket[HOOK_PROF_BUCKETS];
+};
+
+struct hook_prof {
+	struct {
+		unsigned long		count[HOOK_PROF_NCOUNTS];
+		struct hook_prof_hist	phase[HOOK_PROF_NPHASES];
+	} ev[HOOK_PROF_NEVENTS];
+};
+
 struct hook {
 	char 		*hook_name;	/* unique name of the hook */
 	hook_type	type;		/* site-defined or pbs builtin */
@@ -158,6 +194,7 @@ struct hook {
 	pbs_list_link	hi_execjob_postsuspend_hooks;
 	pbs_list_link	hi_execjob_preresume_hooks;
 	struct work_task *ptask;		    /* work task pointer, used in periodic hooks */
+	struct hook_prof *prof;			/* profiling data, set on first run */
 };
 
 typedef struct hook hook;
@@ -165,6 +202,7 @@ typedef struct hook hook;
 /* Hook-related files and directories */
 #define	HOOK_FILE_SUFFIX	".HK"	/* hook control file */
 #define	HOOK_SCRIPT_SUFFIX	".PY"	/* hook script file */
+#define	HOOK_BYTECODE_SUFFIX	HOOK_SCRIPT_SUFFIX PBS_PYTHON_BYTECODE_SUFFIX /* compiled hook script */
 #define	HOOK_REJECT_SUFFIX	".RJ"	/* hook error reject message */
 #define HOOK_TRACKING_SUFFIX	".TR"	/* hook pending action tracking file */
 #define HOOK_BAD_SUFFIX		".BD"	/* a bad (moved out of the way) hook file */
@@ -209,6 +247,7 @@ typedef struct hook hook;
 #define	HOOKATT_FREQ		"freq"
 #define	HOOKATT_FAIL_ACTION	"fail_action"
 #define	HOOKATT_PENDING_DELETE  "pending_delete"
+#define	HOOKATT_PROFILE		"profile"	/* read only, on request */
 
 #define	HOOK_PBS_PREFIX		"PBS"  /* valid Hook name prefix for PBS hook */
 
@@ -400,7 +439,10 @@ extern void catch_hook_alarm(ALARM_HANDLER_ARG);
 extern int set_alarm(int sec, void (*)(void));
 
 extern void hook_perf_stat_start(char *label, char *action, int);
-extern void hook_perf_stat_stop(char *label, char *action, int);
+extern double hook_perf_stat_stop(char *label, char *action, int);
+extern void hook_prof_record(hook *, unsigned int, enum hook_prof_phase, double);
+extern void hook_prof_count(hook *, unsigned int, enum hook_prof_counter);
+extern char *hook_prof_as_string(hook *);
 #define HOOK_PERF_POPULATE "populate"
 #define HOOK_PERF_FUNC "hook_func"
 #define HOOK_PERF_RUN_CODE "run_code"
@@ -414,6 +456,9 @@ extern void hook_perf_stat_stop(char *label, char *action, int);
 #define HOOK_PERF_POPULATE_RESVLIST "populate:pbs.event().resv_list"
 #define HOOK_PERF_POPULATE_JOBLIST "populate:pbs.event().job_list"
 #define HOOK_PERF_LOAD_DATA "load_hook_data"
+#define HOOK_PERF_EVENT_SET "event_set"
+#define HOOK_PERF_MARSHAL "marshal"
+#define HOOK_PERF_HOOK_RESULTS "hook_results"
 #ifdef	__cplusplus
 }
 #endif
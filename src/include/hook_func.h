@@ -134,6 +134,7 @@ extern int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook
 				char *hook_msg, int msg_len, void (*pyinter_func)(void),
 				int *num_run, int *event_initialized);
 extern int process_hooks(struct batch_request *, char *, size_t, void (*)(void));
+extern void log_async_hooks(void);
 extern int recreate_request(struct batch_request *);
 
 /* Server periodic hook call-back */
@@ -313,8 +313,28 @@ typedef struct	noderes {
 	long		nr_cpupercent;  /* cpu percent */
 	attribute	nr_used;	/* node resources used */
 	enum PBS_NodeRes_Status nr_status;
+	time_t		nr_polltime;	/* last IM_POLL_BATCH report */
 } noderes;
 
+/*
+ * A sister that is handed a job-wide command through the sister fan-out
+ * tree (see send_sisters_tree()) keeps one of these while it waits for
+ * its own subtree to report back.  The arrays are indexed by the host
+ * index (ji_hosts) of each node in the subtree.
+ */
+typedef struct	fanout_state {
+	int		fo_command;	/* IM_KILL_JOB or IM_POLL_JOB */
+	int		fo_arity;	/* children per node in the tree */
+	int		fo_stream;	/* stream the request came in on */
+	tm_event_t	fo_event;	/* event of the sender to reply to */
+	int		fo_pending;	/* subtrees (and me) not reported yet */
+	int		fo_local;	/* my own part still outstanding */
+	tm_event_t	*fo_wait;	/* event outstanding to each child */
+	int		*fo_status;	/* error per node, -1 if not reported */
+	int		*fo_kill;	/* POLL_JOB kill recommendation per node */
+	noderes		*fo_resc;	/* resources used reported per node */
+} fanout_state;
+
 /* State for a sister */
 
 #define SISTER_OKAY		0
@@ -479,6 +499,7 @@ struct job {
 	pbs_list_head ji_failed_node_list; /* list of mom nodes which fail to join job */
 	pbs_list_head ji_node_list;	   /* list of functional mom nodes with vnodes assigned to the job */
 	tm_node_id ji_nodekill;		   /* set to nodeid requesting job die */
+	fanout_state *ji_fanout;	   /* sister: fan-out command in progress */
 	int ji_flags;			   /* mom only flags */
 	void *ji_setup;			   /* save setup info */
 
@@ -664,6 +685,7 @@ typedef struct	eventent {
 	tm_task_id	ee_taskid;	/* which task id */
 	char		**ee_argv;	/* save args for spawn */
 	char		**ee_envp;	/* save env for spawn */
+	int		ee_fanout;	/* tree arity if sent by send_sisters_tree */
 	pbs_list_link	ee_next;	/* link to next one */
 } eventent;
 
@@ -746,6 +768,9 @@ typedef struct	infoent {
 #define IM_PMIX			26
 #define IM_RECONNECT_TO_MS			27
 #define IM_JOIN_RECOV_JOB		28
+#define IM_FANOUT		29	/* job-wide command relayed down a tree */
+#define IM_FANOUT_REPLY		30	/* aggregated reply for a subtree */
+#define IM_POLL_BATCH		31	/* resources used for all jobs with a MS */
 
 #define IM_ERROR		99
 #define IM_ERROR2		100
@@ -1067,6 +1092,8 @@ attribute *get_jattr(const job *pjob, int attr_idx);
 #ifdef PBS_MOM
 
 extern job *job_recov_fs(char *);
+extern job *job_recov_load(char *, char *);
+extern void job_recov_finish(job *, char *, char *);
 extern int job_save_fs(job *);
 
 #define job_save  job_save_fs
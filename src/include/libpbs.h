@@ -335,6 +335,19 @@ struct batch_reply
 #define EXTEND_OPT_IMPLICIT_COMMIT ":C:" /* option added to pbs_submit() extend parameter to request implicit commit */
 #define EXTEND_OPT_NEXT_MSG_TYPE "next_msg_type"
 #define EXTEND_OPT_NEXT_MSG_PARAM "next_msg_param"
+#define EXTEND_OPT_DIS_VERSION "dis_version=2" /* Connect request extend asking for DIS version 2 */
+/* local connection broker (pbs_connbroker), its socket is named in the environment */
+#define PBS_CONN_BROKER_ENV	"PBS_CONN_BROKER"
+#define PBS_CONN_BROKER_HELLO	"PBSBROKER1"	/* first word of the session request line */
+#define PBS_CONN_BROKER_LINESZ	(PBS_MAXSERVERNAME + 64)
+#define PBS_CONN_BROKER_EOS	0x7f	/* packet type that ends a session, data packets are type 0 */
+
+#define EXTEND_OPT_STAT_SINCE "since=" /* node status extend: only return vnodes changed since token */
+
+/* attributes of the header object that leads a conditional node status reply */
+#define STAT_SINCE_TOKEN	"since"		/* token to pass on the next request */
+#define STAT_SINCE_FULL		"full"		/* "1" if the reply is a full listing */
+#define STAT_SINCE_DELETED	"deleted"	/* name of a vnode deleted since the token */
 
 int is_compose(int, int);
 int ps_compose(int, int);
@@ -412,6 +425,22 @@ int get_server_fd_from_jid(int c, char *jobid);
 int multi_svr_op(int fd);
 int get_job_svr_inst_id(int c, char *job_id);
 
+/* arena for decoding status replies, see stat_arena.c */
+typedef struct pbs_stat_arena pbs_stat_arena_t;
+int pbs_stat_arena(int);
+int stat_arena_enabled(void);
+struct batch_status *bstat_alloc(void);
+void bstat_free(struct batch_status *);
+pbs_stat_arena_t *stat_arena_new(void);
+void stat_arena_free(pbs_stat_arena_t *);
+void *stat_arena_alloc(pbs_stat_arena_t *, size_t);
+struct batch_status *stat_arena_new_bstat(pbs_stat_arena_t *);
+char *stat_arena_disrst(int, pbs_stat_arena_t *, int *);
+int stat_arena_owns(struct batch_status *, pbs_stat_arena_t **);
+void stat_arena_release(pbs_stat_arena_t *);
+void stat_arena_discard(pbs_stat_arena_t *, struct batch_status *);
+int decode_DIS_attrl_arena(int, struct attrl **, pbs_stat_arena_t *);
+
 int pbs_register_sched_msvr_instance(const char *sched_id, int primary_conn_id, int secondary_conn_id);
 void pbs_connect_msvr_instance(svr_conn_t *conn);
 int pbs_disconnect_msvr_instance(svr_conn_t *svr_conn);
@@ -341,6 +341,11 @@ void delay_query(void);
  */
 char *perf_stat_stop(char *instance);
 
+/**
+ * End collecting performance stats, returning the elapsed times
+ */
+int perf_stat_elapsed(char *instance, double *walltime, double *cputime);
+
 extern char *netaddr(struct sockaddr_in *);
 extern unsigned long crc_file(char *fname);
 extern int get_fullhostname(char *, char *, int);
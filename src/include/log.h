@@ -61,6 +61,7 @@ extern "C" {
 #define	LOG_AUTH	8
 #endif	/* SYSLOG */
 
+#include <stdint.h>
 #include <sys/stat.h>
 
 /*
@@ -123,6 +124,43 @@ extern void log_suspect_file(const char *func, const char *text, const char *fil
 extern int  log_open(char *name, char *directory);
 extern int  log_open_main(char *name, char *directory, int silent);
 extern void log_record(int type, int objclass, int severity, const char *objname, const char *text);
+extern int  log_async_start(unsigned int nrecs);
+extern void log_flush(void);
+
+/* Structured log stream, see log_struct.c */
+#define LOG_STRUCT_REC_SUFFIX	".rec"
+#define LOG_STRUCT_IDX_SUFFIX	".idx"
+
+struct log_struct_file;
+struct log_struct_rec {		/* a record read back from a stream */
+	time_t	sec;
+	long	usec;		/* -1 if not known */
+	int	eventtype;
+	int	objclass;
+	int	nfields;
+	char	**keys;		/* NULL terminated */
+	char	**vals;
+};
+struct log_struct_out {		/* a record encoded by log_struct_encode() */
+	const char *rec;
+	size_t	len;
+	uint64_t hash;		/* log_struct_id_hash() of its id */
+	int	indexed;	/* 0 if it has no id */
+};
+
+extern void log_struct_enable(int enable);
+extern int  log_struct_enabled(void);
+extern struct log_struct_file *log_struct_open(const char *path);
+extern void log_struct_close(struct log_struct_file *lsf);
+extern uint64_t log_struct_id_hash(const char *id);
+extern size_t log_struct_encode(char *buf, size_t size, time_t sec, long usec,
+		int eventtype, int objclass, const char **fields);
+extern int  log_struct_append(struct log_struct_file *lsf, struct log_struct_out *recs, int n);
+extern int  log_struct_write(struct log_struct_file *lsf, time_t sec, long usec,
+		int eventtype, int objclass, const char *id, const char **fields);
+extern char *log_struct_field(struct log_struct_rec *rec, const char *key);
+extern int  log_struct_lookup(const char *path, const char *id,
+		int (*func)(struct log_struct_rec *, void *), void *arg);
 extern char log_buffer[LOG_BUF_SIZE];
 extern int log_level_2_etype(int level);
 
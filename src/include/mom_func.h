@@ -86,6 +86,67 @@ extern char	pbs_jobdir_root[];
 extern int	pbs_jobdir_root_shared;
 #define JOBDIR_DEFAULT	"PBS_USER_HOME"
 
+/* process limits for a job, see mom_get_limits() */
+
+#define	ML_NICE		0x1
+#define	ML_FSIZE	0x2
+#define	ML_AS		0x4
+#define	ML_RSS		0x8
+#define	ML_CPU		0x10
+
+typedef struct mom_limits {
+	int		ml_set;		/* which of the ML_* limits below apply */
+	int		ml_nice;
+	unsigned long	ml_fsize;
+	unsigned long	ml_as;
+	unsigned long	ml_rss;
+	unsigned long	ml_cpu;
+} mom_limits_t;
+
+extern int mom_get_limits(job *, mom_limits_t *);
+extern int mom_apply_limits(mom_limits_t *);
+
+/* used by start_exec.c and mom_launcher.c for $launcher */
+
+#define LAUNCH_STDIO_NULL	0	/* stdout/err to /dev/null */
+#define LAUNCH_STDIO_FDS	1	/* stdout/err passed with the request */
+#define LAUNCH_STDIO_DEMUX	2	/* stdout/err connected to the demux */
+
+struct launch_req {
+	uid_t		lr_uid;
+	gid_t		lr_gid;
+	gid_t		lr_rgid;
+	mode_t		lr_umask;
+	mom_limits_t	lr_limits;
+	int		lr_shell;		/* job shell, restore MoM's original core and nproc limits */
+	char		lr_jobid[PBS_MAXSVRJOBID + 1];	/* for set_job() */
+	long		lr_svrflags;		/* for set_job() */
+	int		lr_stdio;		/* LAUNCH_STDIO_* */
+	int		lr_stdin;		/* stdin passed with the request, else /dev/null */
+	u_long		lr_demux_addr;		/* Mother Superior address */
+	int		lr_demux_out;		/* demux port for stdout */
+	int		lr_demux_err;		/* demux port for stderr */
+	char		*lr_prog;		/* program to exec, argv[0] if NULL */
+	char		**lr_argv;		/* program and arguments */
+	char		**lr_envp;		/* environment */
+	char		*lr_euser;		/* user name for initgroups */
+	char		*lr_cwd;		/* working directory */
+	char		*lr_cookie;		/* job cookie for the demux */
+	/* the strings above follow the request on the wire */
+	long		lr_tag;
+	int		lr_argc;
+	int		lr_envc;
+	size_t		lr_strlen;
+};
+struct startjob_rtn;
+/* called with the starter return once the helper has started a process */
+typedef void (*launch_done_t)(job *, pbs_task *, struct startjob_rtn *);
+extern int   launcher;
+extern int   launcher_start(int);
+extern long  launcher_spawn(struct launch_req *, int *, pbs_task *, launch_done_t);
+extern int   launcher_wait(long, struct startjob_rtn *);
+extern pid_t launcher_reaped(int *);
+
 /* test bits */
 #define PBSQA_DELJOB_SLEEP	1
 #define PBSQA_DELJOB_CRASH	2
@@ -224,6 +285,12 @@ extern void send_join_job_restart(int, eventent *, int, job *, pbs_list_head *);
 extern int send_resc_used_to_ms(int stream, job *pjob);
 extern int recv_resc_used_from_sister(int stream, job *pjob, int nodeidx);
 extern int  is_comm_up(int);
+extern int  sister_fanout;
+extern void fanout_local_done(job *pjob, int errcode);
+extern void fanout_free(job *pjob);
+extern int  sister_poll_batch;
+extern void send_resc_used_batch(void);
+extern int  check_resc_used_batch(job *pjob);
 
 /* Defines for pe_io_type, see run_pelog() */
 
@@ -361,6 +428,8 @@ extern pid_t fork_me(int sock);
 extern ssize_t readpipe(int pfd, void *vptr, size_t nbytes);
 extern ssize_t writepipe(int pfd, void *vptr, size_t nbytes);
 extern int   get_la(double *);
+/* most threads init_abort_jobs() decodes recovered jobs with */
+#define RECOV_THREADS_MAX	8
 extern void  init_abort_jobs(int, pbs_list_head *);
 extern void  checkret(char **spot, int len);
 extern void  mom_nice(void);
@@ -116,6 +116,8 @@ struct pbs_client_thread_context {
 	int			th_pbs_tcp_interrupt;
 	int			th_pbs_tcp_errno;
 	int			th_pbs_mode;
+	/** decode status replies into an arena, see stat_arena.c */
+	int			th_stat_arena;
 };
 
 
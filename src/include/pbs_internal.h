@@ -254,8 +254,15 @@ struct pbs_config
 	char *pbs_mom_node_name;	/* mom short name used for natural node, default NULL */
 	char *pbs_lr_save_path;		/* path to store undo live recordings */
 	unsigned int pbs_log_highres_timestamp; /* high resolution logging */
+	unsigned int pbs_log_async;	/* log records to buffer, 0 to log synchronously */
+	unsigned int pbs_log_structured; /* keep a structured stream next to the logs */
+	unsigned int pbs_acct_buffer;	/* accounting bytes to buffer, 0 to write directly */
+	int pbs_acct_fsync;		/* seconds between accounting fsync()s, -1 for none */
 	unsigned int pbs_sched_threads;	/* number of threads for scheduler */
 	char *pbs_daemon_service_user; /* user the scheduler runs as */
+	char *pbs_hook_async_events;	/* server hook events to run in the background */
+	unsigned int pbs_python_hook_max_blocks; /* objects a hook may hold before it is recycled */
+	char *pbs_python_persist_hooks;	/* hooks whose globals() are kept between runs */
 	char current_user[PBS_MAXUSER+1]; /* current running user */
 #ifdef WIN32
 	char *pbs_conf_remote_viewer; /* Remote viewer client executable for PBS GUI jobs, along with launch options */
@@ -320,8 +327,15 @@ extern struct pbs_config pbs_conf;
 #define PBS_CONF_MOM_NODE_NAME	"PBS_MOM_NODE_NAME"
 #define PBS_CONF_LR_SAVE_PATH	"PBS_LR_SAVE_PATH"
 #define PBS_CONF_LOG_HIGHRES_TIMESTAMP	"PBS_LOG_HIGHRES_TIMESTAMP"
+#define PBS_CONF_LOG_ASYNC	"PBS_LOG_ASYNC"
+#define PBS_CONF_LOG_STRUCTURED	"PBS_LOG_STRUCTURED"
+#define PBS_CONF_ACCT_BUFFER	"PBS_ACCT_BUFFER"
+#define PBS_CONF_ACCT_FSYNC	"PBS_ACCT_FSYNC"
 #define PBS_CONF_SCHED_THREADS	"PBS_SCHED_THREADS"
 #define PBS_CONF_DAEMON_SERVICE_USER "PBS_DAEMON_SERVICE_USER"
+#define PBS_CONF_HOOK_ASYNC_EVENTS "PBS_HOOK_ASYNC_EVENTS"
+#define PBS_CONF_PYTHON_HOOK_MAX_BLOCKS "PBS_PYTHON_HOOK_MAX_BLOCKS"
+#define PBS_CONF_PYTHON_PERSIST_HOOKS "PBS_PYTHON_PERSIST_HOOKS"
 #ifdef WIN32
 #define PBS_CONF_REMOTE_VIEWER "PBS_REMOTE_VIEWER"	/* Executable for remote viewer application alongwith its launch options, for PBS GUI jobs */
 #endif
@@ -265,6 +265,9 @@ struct pbsnode {
 	pbs_list_link un_lic_link;		/*Link to unlicense list */
 	int nd_svrflags;	/* server flags */
 	pbs_list_link nd_link;	/* Link to holding svr list in case if this is an alien node */
+	unsigned long long nd_stat_gen;	/* node_stat_gen when status last changed */
+	unsigned long long nd_stat_hash; /* hash of the last encoded status */
+	unsigned long long nd_stat_sig;	/* hash of the attribute list it covers */
 	attribute nd_attr[ND_ATR_LAST];
 };
 typedef struct pbsnode pbs_node;
@@ -473,6 +476,14 @@ extern void reset_pool_inventory_mom(mominfo_t *);
 extern vnpool_mom_t *find_vnode_pool(mominfo_t *pmom);
 extern void mcast_msg();
 int get_job_share_type(struct job *pjob);
+
+/* conditional node status, see req_stat_node() */
+#define NODE_STAT_TOMBS	1024	/* deleted vnode names remembered */
+extern unsigned long long node_stat_gen;
+extern unsigned long long node_stat_floor;
+extern time_t node_stat_epoch;
+extern void node_stat_tombstone(struct pbsnode *);
+extern int node_stat_deleted_since(unsigned long long, pbs_list_head *);
 #endif
 
 extern  int	   recover_vmap(void);
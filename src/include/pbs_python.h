@@ -106,8 +106,27 @@ struct python_script {
 					      * type is PyObject *
 					      */
 	struct stat cur_sbuf;                /* last modification time */
+	long   blocks_held;                  /* objects reachable from
+					      * global_dict when last counted
+					      */
+	unsigned long runs_counted;          /* runs since global_dict was
+					      * created, see blocks_held
+					      */
+	int    keep_globals;                 /* reuse globals() across runs */
+	unsigned long restart_count;         /* pbs_python_restart_count when
+					      * global_dict was created
+					      */
+	int    cache_bytecode;               /* keep the compiled code in
+					      * <path>PBS_PYTHON_BYTECODE_SUFFIX
+					      */
 };
 
+/*
+ * Appended to a script path to name the file holding its compiled
+ * bytecode, e.g. <hook>.PY -> <hook>.PYC
+ */
+#define PBS_PYTHON_BYTECODE_SUFFIX	"C"
+
 /**
  *
  * @brief
@@ -258,6 +277,9 @@ extern int get_py_progname(char **);
 #define PY_ATTRIBUTES_HOOK_SET	"_attributes_hook_set"
 /* attributes that got set in */
 /* a hook script */
+#define PY_ATTRIBUTES_LAZY	"_attributes_lazy"
+/* attribute values loaded */
+/* but not yet converted */
 #define PY_READONLY_FLAG	"_readonly"	/* an object is read-only */
 #define PY_RERUNJOB_FLAG	"_rerun"	/* flag some job to rerun */
 #define PY_DELETEJOB_FLAG	"_delete"	/* flag some job to be deleted*/
@@ -460,6 +482,8 @@ extern int  pbs_python_event_set(
 
 extern void pbs_python_event_unset(void);
 
+extern unsigned long pbs_python_restart_count;
+
 extern int  pbs_python_event_to_request(unsigned int hook_event,
 	hook_output_param_t *req_params, char *perf_label, char *perf_action);
 
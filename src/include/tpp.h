@@ -108,12 +108,15 @@ struct tpp_config {
 	int    numthreads;
 	char   *node_name; /* list of comma separated node names */
 	int    compress;
+	int    codec; /* compression codec, TPP_CODEC_* */
+	int    compr_min_size; /* only compress messages larger than this */
 	int    tcp_keepalive; /* use keepalive? */
 	int    tcp_keep_idle;
 	int    tcp_keep_intvl;
 	int    tcp_keep_probes;
 	int    tcp_user_timeout;
 	int    buf_limit_per_conn; /* buffer limit per physical connection */
+	int    send_cork_ms; /* hold small sends this long to batch them, 0 = off */
 	pbs_auth_config_t *auth_config;
 	char **supported_auth_methods;
 };
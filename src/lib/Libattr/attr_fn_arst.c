@@ -117,6 +117,7 @@ decode_arst_direct(attribute *patr, char *val)
 	int			 rc;
 	char			 strbuf[BUF_SIZE];	/* Should handle most values */
 	char			*sbufp = NULL;
+	char			*ctx = NULL;
 	size_t			 slen;
 
 	if (!patr || !val)
@@ -172,14 +173,14 @@ decode_arst_direct(attribute *patr, char *val)
 	/* now copy in substrings and set pointers */
 	pc = pbuf;
 	j = 0;
-	pstr = parse_comma_string(sbufp);
+	pstr = parse_comma_string_ctx(sbufp, &ctx);
 	while ((pstr != NULL) && (j < ns)) {
 		stp->as_string[j] = pc;
 		while (*pstr) {
 			*pc++ = *pstr++;
 		}
 		*pc++ = '\0';
-		pstr = parse_comma_string(NULL);
+		pstr = parse_comma_string_ctx(NULL, &ctx);
 		j++;
 	}
 
@@ -634,6 +635,7 @@ arst_string(char *str, attribute *pattr)
  *	the next value element is returned...
  *
  * @param[in] start - string to be parsed
+ * @param[in,out] ctx - where to restart from when start is NULL
  *
  * @return 	string
  * @retval	start address for string	Success
@@ -642,15 +644,16 @@ arst_string(char *str, attribute *pattr)
  */
 
 static char *
-parse_comma_string_bs(char *start)
+parse_comma_string_bs(char *start, char **ctx)
 {
-	static char *pc = NULL;	/* if start is null, restart from here */
+	char	    *pc;
 	char	    *dest;
 	char	    *back;
 	char	    *rv;
 
 	if (start != NULL)
-		pc = start;
+		*ctx = start;
+	pc = *ctx;
 
 	/* skip over leading white space */
 	while (pc && *pc && isspace((int)*pc))
@@ -692,6 +695,8 @@ parse_comma_string_bs(char *start)
 	if (*pc)
 		*pc++ = '\0';	/* if not end, terminate this and adv past */
 
+	*ctx = pc;
+
 	*dest = '\0';
 	back = dest;
 	while (isspace((int)*--back))	/* strip trailing spaces */
@@ -781,6 +786,7 @@ decode_arst_direct_bs(attribute *patr, char *val)
 	char			*pc;
 	char			*pstr;
 	char			*sbufp = NULL;
+	char			*ctx = NULL;
 	struct array_strings	*stp = NULL;
 	char			 strbuf[BUF_SIZE];	/* Should handle most values */
 
@@ -836,14 +842,14 @@ decode_arst_direct_bs(attribute *patr, char *val)
 	/* now copy in substrings and set pointers */
 	pc = pbuf;
 	j = 0;
-	pstr = parse_comma_string_bs(sbufp);
+	pstr = parse_comma_string_bs(sbufp, &ctx);
 	while ((pstr != NULL) && (j < ns)) {
 		stp->as_string[j] = pc;
 		while (*pstr) {
 			*pc++ = *pstr++;
 		}
 		*pc++ = '\0';
-		pstr = parse_comma_string_bs(NULL);
+		pstr = parse_comma_string_bs(NULL, &ctx);
 		j++;
 	}
 
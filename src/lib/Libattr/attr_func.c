@@ -437,11 +437,32 @@ parse_comma_string(char *start)
 {
 	static char *pc;	/* if start is null, restart from here */
 
+	return (parse_comma_string_ctx(start, &pc));
+}
+
+/**
+ * @brief
+ * 	parse_comma_string_ctx() - reentrant form of parse_comma_string(),
+ *	the place to restart from is kept in *ctx by the caller.
+ *
+ * @param[in]	  start - string to parse, NULL to continue from *ctx
+ * @param[in,out] ctx - parse position between calls
+ *
+ * @return	char *
+ * @retval	next value element
+ * @retval	NULL when there are no (more) value elements
+ */
+
+char *
+parse_comma_string_ctx(char *start, char **ctx)
+{
+	char	    *pc;
 	char	    *back;
 	char	    *rv;
 
 	if (start != NULL)
-		pc = start;
+		*ctx = start;
+	pc = *ctx;
 
 	if (*pc == '\0')
 		return NULL;	/* already at end, no strings */
@@ -466,6 +487,7 @@ parse_comma_string(char *start)
 
 	if (*pc)
 		*pc++ = '\0';	/* if not end, terminate this and adv past */
+	*ctx = pc;
 
 	return (rv);
 }
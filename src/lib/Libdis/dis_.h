@@ -66,6 +66,9 @@ disrsl_(int stream, int *negate, unsigned long *value,
 	unsigned long count, int recursv);
 int disrsll_(int stream,  int  *negate,  u_Long *value, unsigned long count, int recursv);
 int diswui_(int stream, unsigned value);
+int disrvi_(int stream, int *negate, unsigned *value);
+int disrvl_(int stream, int *negate, unsigned long *value);
+int disrvll_(int stream, int *negate, u_Long *value);
 
 extern unsigned dis_dmx10;
 extern double *dis_dp10;
@@ -40,6 +40,7 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include "auth.h"
 #include "dis.h"
@@ -762,6 +763,7 @@ dis_puts(int fd, const char *str, size_t ct)
 		if (dis_resize_buf(tp, ct + PKT_HDR_SZ) != 0)
 			return -1;
 		strcpy(tp->tdis_data, PKT_MAGIC);
+		*(tp->tdis_data + PKT_MAGIC_SZ) = 0; /* plain data, not one of AUTH_MSG_TYPES */
 		tp->tdis_pos = tp->tdis_data + PKT_HDR_SZ;
 		tp->tdis_len = PKT_HDR_SZ;
 	} else {
@@ -774,6 +776,174 @@ dis_puts(int fd, const char *str, size_t ct)
 	return ct;
 }
 
+/**
+ * @brief
+ * 	dis_getv - dis support routine to get a version 2 encoded integer
+ *	from read buffer
+ *
+ *	The first byte carries a continuation bit, the sign bit and the six
+ *	least significant bits of the magnitude, each following byte carries
+ *	a continuation bit and the next seven bits.
+ *
+ * @param[in] fd - file descriptor
+ * @param[out] negate - set to TRUE if the value is negative
+ * @param[out] value - magnitude of the value
+ *
+ * @return	int
+ *
+ * @retval	DIS_SUCCESS	success
+ * @retval	DIS_OVERFLOW	value does not fit in a u_Long, *value is set to ULLONG_MAX
+ * @retval	DIS_EOD		if EOD or error
+ * @retval	DIS_EOF		if EOF (stream closed)
+ * @retval	DIS_PROTO	malformed integer
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_getv(int fd, int *negate, u_Long *value)
+{
+	pbs_dis_buf_t *tp = dis_get_readbuf(fd);
+	u_Long locval = 0;
+	unsigned int shift = 0;
+	int overflow = 0;
+	int i;
+	int c;
+
+	if (tp == NULL)
+		return DIS_EOD;
+	for (i = 0; i < DIS_VARINT_MAXSZ; i++) {
+		if (tp->tdis_len <= 0) {
+			/* not enought data, try to get more */
+			int unused;
+
+			dis_clear_buf(tp);
+			if ((c = __recv_pkt(fd, &unused, tp)) <= 0) {
+				dis_clear_buf(tp);
+				return (c == -2 && i == 0) ? DIS_EOF : DIS_EOD;
+			}
+		}
+		c = (unsigned char) *tp->tdis_pos;
+		tp->tdis_pos++;
+		tp->tdis_len--;
+
+		if (i == 0) {
+			*negate = (c & 0x40) ? TRUE : FALSE;
+			locval = c & 0x3f;
+			shift = 6;
+		} else {
+			if (shift >= 64 || ((u_Long)(c & 0x7f) >> (64 - shift)) != 0)
+				overflow = 1;
+			else
+				locval |= (u_Long)(c & 0x7f) << shift;
+			shift += 7;
+		}
+		if ((c & 0x80) == 0) {
+			if (overflow) {
+				*value = ULLONG_MAX;
+				return DIS_OVERFLOW;
+			}
+			*value = locval;
+			return DIS_SUCCESS;
+		}
+	}
+	return DIS_PROTO;
+}
+
+/**
+ * @brief
+ * 	dis_putv - dis support routine to put a version 2 encoded integer
+ *	into the write buffer, see dis_getv() for the layout.
+ *
+ * @param[in] fd - file descriptor
+ * @param[in] negate - TRUE if the value is negative
+ * @param[in] value - magnitude of the value
+ *
+ * @return	int
+ *
+ * @retval	DIS_SUCCESS	success
+ * @retval	DIS_PROTO	if error
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_putv(int fd, int negate, u_Long value)
+{
+	unsigned char buf[DIS_VARINT_MAXSZ];
+	int ct = 0;
+
+	buf[ct] = (value & 0x3f) | (negate ? 0x40 : 0);
+	value >>= 6;
+	while (value) {
+		buf[ct++] |= 0x80;
+		buf[ct] = value & 0x7f;
+		value >>= 7;
+	}
+	ct++;
+	return (dis_puts(fd, (char *) buf, ct) == ct) ? DIS_SUCCESS : DIS_PROTO;
+}
+
+/**
+ * @brief
+ * 	dis_get_version - get the DIS encoding version in use on a connection
+ *
+ * @param[in] fd - file descriptor
+ *
+ * @return	int
+ *
+ * @retval	DIS_VERSION_2	binary encoding was negotiated
+ * @retval	DIS_VERSION_1	otherwise
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_get_version(int fd)
+{
+	pbs_tcp_chan_t *chan = transport_get_chan(fd);
+
+	if (chan == NULL || chan->dis_version != DIS_VERSION_2)
+		return DIS_VERSION_1;
+	return DIS_VERSION_2;
+}
+
+/**
+ * @brief
+ * 	dis_set_version - set the DIS encoding version used on a connection
+ *
+ *	Must only be called at a message boundary, once both ends have
+ *	agreed on the version.
+ *
+ * @param[in] fd - file descriptor
+ * @param[in] version - DIS_VERSION_1 or DIS_VERSION_2
+ *
+ * @return void
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+dis_set_version(int fd, int version)
+{
+	pbs_tcp_chan_t *chan = transport_get_chan(fd);
+
+	if (chan != NULL)
+		chan->dis_version = version;
+}
+
 /**
  * @brief
  *	flush dis write buffer
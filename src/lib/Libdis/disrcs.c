@@ -96,7 +96,7 @@ disrcs(int stream, size_t *nchars, int *retval)
 	assert(nchars != NULL);
 	assert(retval != NULL);
 
-	locret = disrsi_(stream, &negate, &count, 1, 0);
+	locret = disrvi_(stream, &negate, &count);
 	locret = negate ? DIS_BADSIGN : locret;
 	if (locret == DIS_SUCCESS) {
 		if (negate)
@@ -101,7 +101,7 @@ disrd(int stream, int *retval)
 	ldval = 0.0L;
 	locret = disrl_(stream, &ldval, &ndigs, &nskips, DBL_DIG, 1, 0);
 	if (locret == DIS_SUCCESS) {
-		locret = disrsi_(stream, &negate, &uexpon, 1, 0);
+		locret = disrvi_(stream, &negate, &uexpon);
 		if (locret == DIS_SUCCESS) {
 			expon = negate ? nskips - uexpon : nskips + uexpon;
 			if (expon + (int)ndigs > DBL_MAX_10_EXP) {
@@ -90,7 +90,7 @@ disrfcs(int stream, size_t *nchars, size_t achars, char *value)
 	assert(nchars != NULL);
 	assert(value != NULL);
 
-	locret = disrsi_(stream, &negate, &count, 1, 0);
+	locret = disrvi_(stream, &negate, &count);
 	if (locret == DIS_SUCCESS) {
 		if (negate)
 			locret = DIS_BADSIGN;
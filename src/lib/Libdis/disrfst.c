@@ -94,7 +94,7 @@ disrfst(int stream, size_t achars, char *value)
 
 	assert(value != NULL);
 
-	locret = disrsi_(stream, &negate, &count, 1, 0);
+	locret = disrvi_(stream, &negate, &count);
 	if (locret == DIS_SUCCESS) {
 		if (negate)
 			locret = DIS_BADSIGN;
@@ -97,7 +97,7 @@ disrsi(int stream, int *retval)
 	assert(retval != NULL);
 
 	value = 0;
-	switch (locret = disrsi_(stream, &negate, &uvalue, 1, 0)) {
+	switch (locret = disrvi_(stream, &negate, &uvalue)) {
 		case DIS_SUCCESS:
 			if (negate ? uvalue <= (unsigned)-(INT_MIN + 1) + 1 :
 				uvalue <= (unsigned)INT_MAX) {
@@ -97,7 +97,7 @@ short disrss(int stream, int *retval)
 	assert(retval != NULL);
 
 	value = 0;
-	switch (locret = disrsi_(stream, &negate, &uvalue, 1, 0)) {
+	switch (locret = disrvi_(stream, &negate, &uvalue)) {
 		case DIS_SUCCESS:
 			if (negate ? -uvalue >= SHRT_MIN : uvalue <= SHRT_MAX) {
 				value = negate ? -uvalue : uvalue;
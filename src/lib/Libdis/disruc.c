@@ -99,7 +99,7 @@ disruc(int stream, int *retval)
 
 	assert(retval != NULL);
 
-	locret = disrsi_(stream, &negate, &value, 1, 0);
+	locret = disrvi_(stream, &negate, &value);
 	if (locret != DIS_SUCCESS) {
 		value = 0;
 	} else if (negate) {
@@ -93,7 +93,7 @@ unsigned disrui(int stream, int *retval)
 	int		negate;
 	unsigned	value;
 
-	locret = disrsi_(stream, &negate, &value, 1, 0);
+	locret = disrvi_(stream, &negate, &value);
 	if (locret != DIS_SUCCESS) {
 		value = 0;
 	} else if (negate) {
@@ -97,7 +97,7 @@ disrull(int stream, int *retval)
 
 	assert(retval != NULL);
 
-	locret = disrsll_(stream, &negate, &value, 1, 0);
+	locret = disrvll_(stream, &negate, &value);
 	if (locret != DIS_SUCCESS) {
 		value = 0;
 	} else if (negate) {
@@ -98,7 +98,7 @@ unsigned short disrus(int stream, int *retval)
 
 	assert(retval != NULL);
 
-	locret = disrsi_(stream, &negate, &value, 1, 0);
+	locret = disrvi_(stream, &negate, &value);
 	if (locret != DIS_SUCCESS) {
 		value = 0;
 	} else if (negate) {
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "dis.h"
+#include "dis_.h"
+/**
+ * @file	disrv.c
+ *
+ * @par Synopsis:
+ *	Integer readers that honour the DIS version negotiated on <stream>.
+ *	On a version 2 channel the integer is read as a binary varint by
+ *	dis_getv(), otherwise the Data-is-Strings text readers are used.
+ *
+ *	The results follow the text readers: on overflow *<value> is set to
+ *	the largest value of its type and DIS_OVERFLOW is returned.
+ */
+
+/**
+ * @brief
+ *	Read an integer into an unsigned int magnitude and sign.
+ *
+ * @param[in] stream - socket descriptor
+ * @param[out] negate - set to TRUE if the value is negative
+ * @param[out] value - magnitude of the value
+ *
+ * @return	int
+ * @retval	DIS_SUCCESS	success
+ * @retval	error code	error
+ *
+ */
+int
+disrvi_(int stream, int *negate, unsigned *value)
+{
+	int		locret;
+	u_Long		locval;
+
+	assert(negate != NULL);
+	assert(value != NULL);
+
+	if (dis_get_version(stream) != DIS_VERSION_2)
+		return (disrsi_(stream, negate, value, 1, 0));
+
+	locret = dis_getv(stream, negate, &locval);
+	if (locret == DIS_SUCCESS && locval > UINT_MAX)
+		locret = DIS_OVERFLOW;
+	if (locret == DIS_OVERFLOW)
+		*value = UINT_MAX;
+	else
+		*value = (unsigned)locval;
+	return (locret);
+}
+
+/**
+ * @brief
+ *	Read an integer into an unsigned long magnitude and sign.
+ *
+ * @param[in] stream - socket descriptor
+ * @param[out] negate - set to TRUE if the value is negative
+ * @param[out] value - magnitude of the value
+ *
+ * @return	int
+ * @retval	DIS_SUCCESS	success
+ * @retval	error code	error
+ *
+ */
+int
+disrvl_(int stream, int *negate, unsigned long *value)
+{
+	int		locret;
+	u_Long		locval;
+
+	assert(negate != NULL);
+	assert(value != NULL);
+
+	if (dis_get_version(stream) != DIS_VERSION_2)
+		return (disrsl_(stream, negate, value, 1, 0));
+
+	locret = dis_getv(stream, negate, &locval);
+	if (locret == DIS_SUCCESS && locval > ULONG_MAX)
+		locret = DIS_OVERFLOW;
+	if (locret == DIS_OVERFLOW)
+		*value = ULONG_MAX;
+	else
+		*value = (unsigned long)locval;
+	return (locret);
+}
+
+/**
+ * @brief
+ *	Read an integer into a u_Long magnitude and sign.
+ *
+ * @param[in] stream - socket descriptor
+ * @param[out] negate - set to TRUE if the value is negative
+ * @param[out] value - magnitude of the value
+ *
+ * @return	int
+ * @retval	DIS_SUCCESS	success
+ * @retval	error code	error
+ *
+ */
+int
+disrvll_(int stream, int *negate, u_Long *value)
+{
+	assert(negate != NULL);
+	assert(value != NULL);
+
+	if (dis_get_version(stream) != DIS_VERSION_2)
+		return (disrsll_(stream, negate, value, 1, 0));
+	return (dis_getv(stream, negate, value));
+}
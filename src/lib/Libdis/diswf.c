@@ -94,7 +94,10 @@ diswf(int stream, double value)
 	/* Make zero a special case.  If we don't it will blow exponent		*/
 	/* calculation.								*/
 	if (value == 0.0) {
-		return (dis_puts(stream, "+0+0", 4) != 4 ? DIS_PROTO : DIS_SUCCESS);
+		/* the exponent follows the integer encoding of the channel */
+		if (dis_puts(stream, "+0", 2) != 2)
+			return (DIS_PROTO);
+		return (diswsi(stream, 0));
 	}
 	/* Extract the sign from the coefficient.				*/
 	dval = (negate = value < 0.0) ? -value : value;
@@ -97,7 +97,10 @@ diswl_(int stream, dis_long_double_t value, unsigned ndigs)
 	/* Make zero a special case.  If we don't it will blow exponent		*/
 	/* calculation.								*/
 	if (value == 0.0L) {
-		return (dis_puts(stream, "+0+0", 4) < 0 ? DIS_PROTO : DIS_SUCCESS);
+		/* the exponent follows the integer encoding of the channel */
+		if (dis_puts(stream, "+0", 2) != 2)
+			return (DIS_PROTO);
+		return (diswsi(stream, 0));
 	}
 	/* Extract the sign from the coefficient.				*/
 	ldval = (negate = value < 0.0L) ? -value : value;
@@ -103,6 +103,8 @@ diswsi(int stream, int value)
 		uval = value;
 		c = '+';
 	}
+	if (dis_get_version(stream) == DIS_VERSION_2)
+		return (dis_putv(stream, c == '-', uval));
 	cp = discui_(&dis_buffer[DIS_BUFSIZ], uval, &ndigs);
 	*--cp = c;
 	while (ndigs > 1)
@@ -103,6 +103,8 @@ diswsl(int stream, long value)
 		ulval = value;
 		c = '+';
 	}
+	if (dis_get_version(stream) == DIS_VERSION_2)
+		return (dis_putv(stream, c == '-', ulval));
 	cp = discul_(&dis_buffer[DIS_BUFSIZ], ulval, &ndigs);
 	*--cp = c;
 	while (ndigs > 1)
@@ -69,6 +69,9 @@ diswui_(int stream, unsigned value)
 
 	assert(stream >= 0);
 
+	if (dis_get_version(stream) == DIS_VERSION_2)
+		return (dis_putv(stream, FALSE, value));
+
 	cp = discui_(&dis_buffer[DIS_BUFSIZ], value, &ndigs);
 	*--cp = '+';
 	while (ndigs > 1)
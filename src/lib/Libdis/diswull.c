@@ -96,6 +96,8 @@ diswull(int stream, u_Long value)
 
 	assert(stream >= 0);
 
+	if (dis_get_version(stream) == DIS_VERSION_2)
+		return (dis_putv(stream, FALSE, value));
 
 	cp = discull_(&dis_buffer[DIS_BUFSIZ], value, &ndigs);
 	*--cp = '+';
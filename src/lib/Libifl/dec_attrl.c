@@ -134,3 +134,65 @@ decode_DIS_attrl(int sock, struct attrl **ppatt)
 		PBS_free_aopl((struct attropl *)pat);
 	return rc;
 }
+
+/**
+ * @brief
+ *	Same as decode_DIS_attrl() but the attrl structures and their strings
+ *	are allocated from the given arena.  On error the partial list is
+ *	left for the arena to reclaim.
+ *
+ * @param[in]   sock - socket descriptor
+ * @param[in]   ppatt - pointer to list of attributes
+ * @param[in]   arena - arena to allocate from
+ *
+ * @return int
+ * @retval 0 on SUCCESS
+ * @retval >0 on failure
+ */
+
+int
+decode_DIS_attrl_arena(int sock, struct attrl **ppatt, pbs_stat_arena_t *arena)
+{
+	int		 hasresc;
+	int		 i;
+	unsigned int	 numpat;
+	struct attrl  *pat      = 0;
+	struct attrl  **patprior = ppatt;
+	int		 rc;
+
+
+	numpat = disrui(sock, &rc);
+	if (rc) return rc;
+
+	for (i=0; i < numpat; ++i) {
+
+		(void) disrui(sock, &rc);
+		if (rc) break;
+
+		pat = stat_arena_alloc(arena, sizeof(struct attrl));
+		if (pat == 0)
+			return DIS_NOMALLOC;
+		memset(pat, 0, sizeof(struct attrl));
+
+		pat->name = stat_arena_disrst(sock, arena, &rc);
+		if (rc)	break;
+
+		hasresc = disrui(sock, &rc);
+		if (rc) break;
+		if (hasresc) {
+			pat->resource = stat_arena_disrst(sock, arena, &rc);
+			if (rc) break;
+		}
+
+		pat->value = stat_arena_disrst(sock, arena, &rc);
+		if (rc) break;
+
+		pat->op = (enum batch_op) disrui(sock, &rc);
+		if (rc) break;
+
+		*patprior = pat;
+		patprior = &pat->next;
+	}
+
+	return rc;
+}
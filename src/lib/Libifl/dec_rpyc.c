@@ -69,13 +69,14 @@
  * @param[in]  sock - socket from which status to be read
  * @param[out] objtype - type of batch status
  * @param[out] rc - error code if any failure in read
+ * @param[in]  arena - arena to allocate from, NULL to use malloc
  *
  * @return struct batch_status *
  * @retval !NULL - success
  * @retval NULL  - failure
  */
 static struct batch_status *
-read_batch_status(int sock, int *objtype, int *rc)
+read_batch_status(int sock, int *objtype, int *rc, pbs_stat_arena_t *arena)
 {
 	struct batch_status *pstcmd;
 
@@ -85,7 +86,22 @@ read_batch_status(int sock, int *objtype, int *rc)
 		return NULL;
 	}
 
-	pstcmd = (struct batch_status *) malloc(sizeof(struct batch_status));
+	if (arena != NULL) {
+		pstcmd = stat_arena_new_bstat(arena);
+		if (pstcmd == NULL) {
+			*rc = DIS_NOMALLOC;
+			return NULL;
+		}
+		*objtype = disrui(sock, rc);
+		if (*rc == DIS_SUCCESS)
+			pstcmd->name = stat_arena_disrst(sock, arena, rc);
+		if (*rc == DIS_SUCCESS)
+			*rc = decode_DIS_attrl_arena(sock, &pstcmd->attribs, arena);
+		/* on error the arena reclaims the partial status */
+		return (*rc == DIS_SUCCESS) ? pstcmd : NULL;
+	}
+
+	pstcmd = bstat_alloc();
 	if (pstcmd == NULL) {
 		*rc = DIS_NOMALLOC;
 		return NULL;
@@ -184,7 +200,7 @@ expand_remaining_subjob(struct batch_status *array, int *count)
 		return 1;
 	}
 	while ((sjidx = range_next_value(r, sjidx)) >= 0) {
-		struct batch_status *pstcmd = (struct batch_status *) malloc(sizeof(struct batch_status));
+		struct batch_status *pstcmd = bstat_alloc();
 		char *name;
 
 		if (pstcmd == NULL) {
@@ -297,6 +313,7 @@ decode_DIS_replyCmd(int sock, struct batch_reply *reply, int prot)
 	int rc = 0;
 	size_t txtlen;
 	preempt_job_info *ppj = NULL;
+	pbs_stat_arena_t *arena = NULL;
 
 	/* first decode "header" consisting of protocol type and version */
 again:
@@ -373,18 +390,28 @@ again:
 				reply->brp_un.brp_statc = NULL;
 				pstcx = &reply->brp_un.brp_statc;
 				reply->brp_count = 0;
+				if (stat_arena_enabled())
+					arena = stat_arena_new();
 			}
 			ct = disrui(sock, &rc);
-			if (rc)
+			if (rc) {
+				if (arena != NULL) {
+					stat_arena_discard(arena, reply->brp_un.brp_statc);
+					reply->brp_un.brp_statc = NULL;
+				}
 				return rc;
+			}
 			reply->brp_count += ct;
 
 			while (ct--) {
 
 				rc = DIS_PROTO;
-				pstcmd = read_batch_status(sock, &reply->brp_type, &rc);
+				pstcmd = read_batch_status(sock, &reply->brp_type, &rc, arena);
 				if (rc != DIS_SUCCESS || pstcmd == NULL) {
-					if (pstcmd)
+					if (arena != NULL) {
+						stat_arena_discard(arena, reply->brp_un.brp_statc);
+						reply->brp_un.brp_statc = NULL;
+					} else if (pstcmd)
 						pbs_statfree(pstcmd);
 					return rc;
 				}
@@ -398,7 +425,11 @@ again:
 						pstcmd_ja = NULL;
 					}
 					if (expand_remaining_subjob(pstcmd, &reply->brp_count) != 0) {
-						pbs_statfree(pstcmd);
+						if (arena != NULL) {
+							stat_arena_discard(arena, reply->brp_un.brp_statc);
+							reply->brp_un.brp_statc = NULL;
+						} else
+							pbs_statfree(pstcmd);
 						return DIS_NOMALLOC;
 					}
 					pstcmd_ja = pstcmd;
@@ -506,6 +506,7 @@ PBSD_status_aggregate(int c, int cmd, char *id, void *attrib, char *extend, int
 	struct batch_status *last = NULL;
 	int pbs_errno_clear_cnt = 0;
 	int nsvr = get_num_servers();
+	int arena_prev = -1;
 
 	if (!svr_conns)
 		return NULL;
@@ -521,6 +522,10 @@ PBSD_status_aggregate(int c, int cmd, char *id, void *attrib, char *extend, int
 	if (c == svr_conns[0]->sd)
 		single_itr = 1;
 
+	/* aggregation rewrites attribute values in place, keep them off the arena */
+	if (!single_itr && (parent_object == MGR_OBJ_SERVER || parent_object == MGR_OBJ_QUEUE))
+		arena_prev = pbs_stat_arena(0);
+
 	if ((start = get_obj_location_hint(id, parent_object)) == -1)
 		start = 0;
 
@@ -601,6 +606,8 @@ PBSD_status_aggregate(int c, int cmd, char *id, void *attrib, char *extend, int
 
 end:
 	free(failed_conn);
+	if (arena_prev != -1)
+		pbs_stat_arena(arena_prev);
 
 	if (ret && pbs_errno == PBSE_NONODES)	/* one of the servers didn't report any vnodes */
 		pbs_errno = PBSE_NONE;
@@ -60,6 +60,9 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#ifndef WIN32
+#include <sys/un.h>
+#endif
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -76,6 +79,8 @@
 #include "libutil.h"
 #include "portability.h"
 
+#define PBS_DIS_VERSION_ENV "PBS_DIS_VERSION"
+
 static pthread_once_t conn_once_ctl = PTHREAD_ONCE_INIT;
 static pthread_mutex_t conn_lock;
 static svr_conns_list_t *conn_list = NULL;
@@ -175,6 +180,139 @@ get_hostsockaddr(char *host, struct sockaddr_in *sap)
 }
 
 
+#ifndef WIN32
+/**
+ * @brief	Does the process at the other end of a Unix socket run as this user?
+ *
+ * @param[in]   sd - connected Unix socket
+ *
+ * @return int
+ * @retval 1	same user
+ * @retval 0	other user, or cannot tell
+ */
+static int
+broker_is_me(int sd)
+{
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	pbs_socklen_t len = sizeof(cred);
+
+	if (getsockopt(sd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return 0;
+	return (cred.uid == getuid());
+#else
+	uid_t euid;
+	gid_t egid;
+
+	if (getpeereid(sd, &euid, &egid) != 0)
+		return 0;
+	return (euid == getuid());
+#endif
+}
+
+/**
+ * @brief	Ask the local connection broker named by PBS_CONN_BROKER for a
+ *		session with the given server.  The broker holds connections to
+ *		the server that are already authenticated as this user and relays
+ *		the DIS packets of the session over a Unix socket, so neither the
+ *		TCP connect nor the authentication handshake happen here.
+ *
+ *		The session request is a single line, "PBSBROKER1 <host> <port>",
+ *		answered by "OK <dis version>" or "ERR <pbs errno>".  The broker
+ *		must run as this user, anyone else could listen on the socket
+ *		named in the environment and act on our requests.
+ *
+ * @param[in]   hostname - server host
+ * @param[in]   server_port - server port
+ *
+ * @return int
+ * @retval >= 0	socket to the broker, ready for batch requests
+ * @retval -1	no broker, or it cannot serve this server; connect directly
+ */
+static int
+broker_connect(char *hostname, int server_port)
+{
+	char *path;
+	int sd;
+	int i;
+	int ver;
+	int len;
+	struct sockaddr_un sun;
+	char line[PBS_CONN_BROKER_LINESZ];
+
+	path = getenv(PBS_CONN_BROKER_ENV);
+	if (path == NULL || *path == '\0' || strlen(path) >= sizeof(sun.sun_path))
+		return -1;
+
+	if ((sd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return -1;
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strcpy(sun.sun_path, path);
+	if (connect(sd, (struct sockaddr *) &sun, sizeof(sun)) != 0) {
+		close(sd);
+		return -1;
+	}
+	if (!broker_is_me(sd)) {
+		close(sd);
+		return -1;
+	}
+
+	len = snprintf(line, sizeof(line), "%s %s %d\n", PBS_CONN_BROKER_HELLO, hostname, server_port);
+	if (len >= sizeof(line) || write(sd, line, len) != len) {
+		close(sd);
+		return -1;
+	}
+	/* read the answer a byte at a time, nothing past the newline is ours */
+	for (i = 0; i < sizeof(line) - 1; i++) {
+		if (read(sd, &line[i], 1) != 1) {
+			close(sd);
+			return -1;
+		}
+		if (line[i] == '\n')
+			break;
+	}
+	line[i] = '\0';
+	if (sscanf(line, "OK %d", &ver) != 1 ||
+		(ver != DIS_VERSION_1 && ver != DIS_VERSION_2)) {
+		close(sd);
+		return -1;
+	}
+
+	if (pbs_client_thread_init_connect_context(sd) != 0) {
+		close(sd);
+		return -1;
+	}
+	DIS_tcp_funcs();
+	dis_set_version(sd, ver);
+	pbs_tcp_timeout = PBS_DIS_TCP_TIMEOUT_VLONG;
+
+	return sd;
+}
+
+/**
+ * @brief	Is the connection a session through the local connection broker?
+ *
+ * @param[in]   sd - connection socket
+ *
+ * @return int
+ * @retval 1	brokered session
+ * @retval 0	direct connection to the server
+ */
+static int
+is_broker_session(int sd)
+{
+	struct sockaddr_storage sa;
+	pbs_socklen_t len = sizeof(sa);
+
+	if (getsockname(sd, (struct sockaddr *) &sa, &len) != 0)
+		return 0;
+	return (sa.ss_family == AF_UNIX);
+}
+#else
+#define is_broker_session(sd) 0
+#endif
+
 /**
  * @brief	This function establishes a network connection to the given server.
  *
@@ -196,6 +334,16 @@ tcp_connect(char *hostname, int server_port, char *extend_data)
 	struct sockaddr_in server_addr;
 	struct batch_reply	*reply;
 	char errbuf[LOG_BUF_SIZE] = {'\0'};
+	char *dis_ver;
+	int want_dis_v2 = 0;
+
+	pbs_strncpy(pbs_server, hostname, sizeof(pbs_server)); /* set for error messages from commands */
+
+#ifndef WIN32
+	/* a plain connect may be served by the local connection broker */
+	if (extend_data == NULL && (sd = broker_connect(hostname, server_port)) != -1)
+		return sd;
+#endif
 
 		/* get socket	*/
 #ifdef WIN32
@@ -212,7 +360,6 @@ tcp_connect(char *hostname, int server_port, char *extend_data)
 		return -1;
 	}
 
-	pbs_strncpy(pbs_server, hostname, sizeof(pbs_server)); /* set for error messages from commands */
 	/* and connect... */
 
 	if (get_hostsockaddr(hostname, &server_addr) != 0)
@@ -259,6 +406,20 @@ tcp_connect(char *hostname, int server_port, char *extend_data)
 	 * no leading authentication message needing to be sent on the client
 	 * socket, so will send a "dummy" message and discard the replyback.
 	 */
+	/*
+	 * Unless the caller already uses the extend of the Connect request,
+	 * ask the server for the binary DIS encoding.  A server which does
+	 * not know about it acknowledges with a zero auxcode and the
+	 * connection stays on DIS version 1.  Setting PBS_DIS_VERSION=1 in
+	 * the environment disables the request.
+	 */
+	if (extend_data == NULL) {
+		dis_ver = getenv(PBS_DIS_VERSION_ENV);
+		if (dis_ver == NULL || atoi(dis_ver) != DIS_VERSION_1) {
+			extend_data = EXTEND_OPT_DIS_VERSION;
+			want_dis_v2 = 1;
+		}
+	}
 	if ((i = encode_DIS_ReqHdr(sd, PBS_BATCH_Connect, pbs_current_user)) ||
 		(i = encode_DIS_ReqExtend(sd, extend_data))) {
 		closesocket(sd);
@@ -273,6 +434,8 @@ tcp_connect(char *hostname, int server_port, char *extend_data)
 
 	pbs_errno = PBSE_NONE;
 	reply = PBSD_rdrpy(sd);
+	if (reply != NULL && want_dis_v2 && reply->brp_auxcode == DIS_VERSION_2)
+		dis_set_version(sd, DIS_VERSION_2);
 	PBSD_FreeReply(reply);
 	if (pbs_errno != PBSE_NONE) {
 		closesocket(sd);
@@ -836,10 +999,16 @@ disconnect_from_server(int connect)
 	if (get_conn_chan(connect) == NULL)
 		return 0;
 
-	/* send close-connection message */
+	/*
+	 * send close-connection message; a broker session is ended with the
+	 * end-of-session marker instead, the broker keeps the server
+	 * connection behind it for the next one
+	 */
 
 	DIS_tcp_funcs();
-	if ((encode_DIS_ReqHdr(connect, PBS_BATCH_Disconnect, pbs_current_user) == 0) &&
+	if (is_broker_session(connect))
+		(void) transport_send_pkt(connect, PBS_CONN_BROKER_EOS, "EOS", 3);
+	else if ((encode_DIS_ReqHdr(connect, PBS_BATCH_Disconnect, pbs_current_user) == 0) &&
 		(dis_flush(connect) == 0)) {
 		for (;;) {	/* wait for server to close connection */
 #ifdef WIN32
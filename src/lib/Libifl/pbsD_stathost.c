@@ -801,7 +801,7 @@ struct batch_status *build_return_status(struct batch_status *bstatus,
 	struct batch_status *npbs;
 	int                  i;
 
-	npbs = malloc(sizeof(struct batch_status));
+	npbs = bstat_alloc();
 	if (npbs == NULL) {
 		pbs_errno = PBSE_SYSTEM;
 		return NULL;
@@ -820,7 +820,7 @@ struct batch_status *build_return_status(struct batch_status *bstatus,
 
 				/* prevent double free: copy name, move attribs */
 				if ((npbs->name = strdup((phost_list + i)->hl_node->name)) == NULL) {
-					free(npbs);
+					bstat_free(npbs);
 					pbs_errno = PBSE_SYSTEM;
 					return NULL;
 				}
@@ -829,7 +829,7 @@ struct batch_status *build_return_status(struct batch_status *bstatus,
 				if ((phost_list+i)->hl_node->text)
 					if ((npbs->text = strdup((phost_list+i)->hl_node->text)) == NULL) {
 						free(npbs->name);
-						free(npbs);
+						bstat_free(npbs);
 						pbs_errno = PBSE_SYSTEM;
 						return NULL;
 					}
@@ -840,7 +840,7 @@ struct batch_status *build_return_status(struct batch_status *bstatus,
 				/* of the attrls of all the vnode's on the host    */
 
 				if ((npbs->name = strdup(hname)) == NULL) {
-					free(npbs);
+					bstat_free(npbs);
 					pbs_errno = PBSE_SYSTEM;
 					return NULL;
 				}
@@ -867,7 +867,7 @@ struct batch_status *build_return_status(struct batch_status *bstatus,
 	}
 	if (i == host_list_size) {
 		/* did not find a host of the given name in the table */
-		free(npbs);	/* no leaking */
+		bstat_free(npbs);	/* no leaking */
 		pbs_errno = PBSE_UNKNODE;
 	}
 
@@ -130,8 +130,15 @@ struct pbs_config pbs_conf = {
 	NULL,					/* mom short name override */
 	NULL,					/* pbs_lr_save_path */
 	0,					/* high resolution timestamp logging */
+	0,					/* synchronous logging */
+	0,					/* no structured log stream */
+	0,					/* accounting written directly */
+	-1,					/* no accounting fsync() */
 	0,					/* number of scheduler threads */
 	NULL,					/* default scheduler user */
+	NULL,					/* server hook events run in the background */
+	0,					/* hook recycling limit, 0 for the built-in default */
+	NULL,					/* no hook keeps its globals */
 	{'\0'}					/* current running user */
 #ifdef WIN32
 	,NULL					/* remote viewer launcher executable along with launch options */
@@ -672,6 +679,22 @@ __pbs_loadconf(int reload)
 				if (sscanf(conf_value, "%u", &uvalue) == 1)
 					pbs_conf.pbs_log_highres_timestamp = ((uvalue > 0) ? 1 : 0);
 			}
+			else if (!strcmp(conf_name, PBS_CONF_LOG_ASYNC)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_log_async = uvalue;
+			}
+			else if (!strcmp(conf_name, PBS_CONF_LOG_STRUCTURED)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_log_structured = ((uvalue > 0) ? 1 : 0);
+			}
+			else if (!strcmp(conf_name, PBS_CONF_ACCT_BUFFER)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_acct_buffer = uvalue;
+			}
+			else if (!strcmp(conf_name, PBS_CONF_ACCT_FSYNC)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_acct_fsync = (int) uvalue;
+			}
 			else if (!strcmp(conf_name, PBS_CONF_SCHED_THREADS)) {
 				if (sscanf(conf_value, "%u", &uvalue) == 1)
 					pbs_conf.pbs_sched_threads = uvalue;
@@ -713,6 +736,18 @@ __pbs_loadconf(int reload)
 				free(pbs_conf.pbs_daemon_service_user);
 				pbs_conf.pbs_daemon_service_user = strdup(conf_value);
 			}
+			else if (!strcmp(conf_name, PBS_CONF_HOOK_ASYNC_EVENTS)) {
+				free(pbs_conf.pbs_hook_async_events);
+				pbs_conf.pbs_hook_async_events = strdup(conf_value);
+			}
+			else if (!strcmp(conf_name, PBS_CONF_PYTHON_HOOK_MAX_BLOCKS)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_python_hook_max_blocks = uvalue;
+			}
+			else if (!strcmp(conf_name, PBS_CONF_PYTHON_PERSIST_HOOKS)) {
+				free(pbs_conf.pbs_python_persist_hooks);
+				pbs_conf.pbs_python_persist_hooks = strdup(conf_value);
+			}
 			/* iff_path is inferred from pbs_conf.pbs_exec_path - see below */
 		}
 		fclose(fp);
@@ -920,6 +955,22 @@ __pbs_loadconf(int reload)
 		if (sscanf(gvalue, "%u", &uvalue) == 1)
 			pbs_conf.pbs_log_highres_timestamp = ((uvalue > 0) ? 1 : 0);
 	}
+	if ((gvalue = getenv(PBS_CONF_LOG_ASYNC)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_log_async = uvalue;
+	}
+	if ((gvalue = getenv(PBS_CONF_LOG_STRUCTURED)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_log_structured = ((uvalue > 0) ? 1 : 0);
+	}
+	if ((gvalue = getenv(PBS_CONF_ACCT_BUFFER)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_acct_buffer = uvalue;
+	}
+	if ((gvalue = getenv(PBS_CONF_ACCT_FSYNC)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_acct_fsync = (int) uvalue;
+	}
 	if ((gvalue = getenv(PBS_CONF_SCHED_THREADS)) != NULL) {
 		if (sscanf(gvalue, "%u", &uvalue) == 1)
 			pbs_conf.pbs_sched_threads = uvalue;
@@ -929,6 +980,18 @@ __pbs_loadconf(int reload)
 		free(pbs_conf.pbs_daemon_service_user);
 		pbs_conf.pbs_daemon_service_user = strdup(gvalue);
 	}
+	if ((gvalue = getenv(PBS_CONF_HOOK_ASYNC_EVENTS)) != NULL) {
+		free(pbs_conf.pbs_hook_async_events);
+		pbs_conf.pbs_hook_async_events = strdup(gvalue);
+	}
+	if ((gvalue = getenv(PBS_CONF_PYTHON_HOOK_MAX_BLOCKS)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_python_hook_max_blocks = uvalue;
+	}
+	if ((gvalue = getenv(PBS_CONF_PYTHON_PERSIST_HOOKS)) != NULL) {
+		free(pbs_conf.pbs_python_persist_hooks);
+		pbs_conf.pbs_python_persist_hooks = strdup(gvalue);
+	}
 
 #ifdef WIN32
 	if ((gvalue = getenv(PBS_CONF_REMOTE_VIEWER)) != NULL) {
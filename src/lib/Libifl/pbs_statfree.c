@@ -54,6 +54,10 @@
  * @brief
  *	-The function that deallocates a "batch_status" structure
  *
+ *	Elements decoded into an arena (see stat_arena.c) are not freed one
+ *	by one, their arena is released after the walk when the list holds
+ *	its first element.
+ *
  * @param[in] bsp - pointer to batch request.
  *
  * @return	Void
@@ -64,8 +68,13 @@ __pbs_statfree(struct batch_status *bsp)
 {
 	struct attrl        *atnxt;
 	struct batch_status *bsnxt;
+	pbs_stat_arena_t    *release = NULL;
 
 	while (bsp != NULL) {
+		if (stat_arena_owns(bsp, &release)) {
+			bsp = bsp->next;
+			continue;
+		}
 		if (bsp->name != NULL)(void)free(bsp->name);
 		if (bsp->text != NULL)(void)free(bsp->text);
 		while (bsp->attribs != NULL) {
@@ -80,7 +89,8 @@ __pbs_statfree(struct batch_status *bsp)
 			bsp->attribs = atnxt;
 		}
 		bsnxt = bsp->next;
-		(void)free(bsp);
+		bstat_free(bsp);
 		bsp = bsnxt;
 	}
+	stat_arena_release(release);
 }
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file	stat_arena.c
+ * @brief
+ *	Arena used to decode status replies.
+ *
+ *	When enabled for a thread with pbs_stat_arena(), the batch_status and
+ *	attrl structures of a status reply, and all their strings, are carved
+ *	out of a few large chunks instead of being malloc'ed one by one.  The
+ *	strings are copied straight from the DIS receive buffer into the arena.
+ *
+ *	Every batch_status handed out by the library is preceded by a small
+ *	header, see bstat_alloc(), so that pbs_statfree() can tell arena nodes
+ *	from malloc'ed ones (a list may hold both, e.g. expanded subjobs or the
+ *	replies of several server instances) without any lookup or locking.
+ *	pbs_statfree() skips the attributes of arena nodes and releases an
+ *	arena in one go when the list it frees holds the first batch_status
+ *	allocated from it.  The contents of an arena list must therefore be
+ *	treated as read only.
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include <stdlib.h>
+#include <string.h>
+#include "libpbs.h"
+#include "dis.h"
+
+#define STAT_ARENA_ALIGN	sizeof(void *)
+#define STAT_ARENA_CHUNK_MIN	(64 * 1024)
+#define STAT_ARENA_CHUNK_MAX	(8 * 1024 * 1024)
+
+/*
+ * magic values of the batch_status header, the magic is right in front of
+ * the batch_status and can not be mistaken for the size word malloc keeps
+ * there for a batch_status allocated outside of the library
+ */
+#define BSTAT_MAGIC_MALLOC	0x5053544154534d41ULL
+#define BSTAT_MAGIC_ARENA	0x5053544154534152ULL
+
+typedef struct bstat_hdr {
+	pbs_stat_arena_t *arena;	/* owning arena, NULL if malloc'ed */
+	unsigned long long magic;
+} bstat_hdr_t;
+
+#define BSTAT_HDR_SIZE	((sizeof(bstat_hdr_t) + STAT_ARENA_ALIGN - 1) & ~(STAT_ARENA_ALIGN - 1))
+#define BSTAT_HDR(bsp)	((bstat_hdr_t *) ((char *) (bsp) - BSTAT_HDR_SIZE))
+
+typedef struct stat_arena_chunk {
+	struct stat_arena_chunk *next;
+	size_t size;		/* usable bytes in data */
+	size_t used;		/* bytes handed out */
+	char *data;
+} stat_arena_chunk_t;
+
+struct pbs_stat_arena {
+	struct pbs_stat_arena *release;	/* used by pbs_statfree() */
+	stat_arena_chunk_t *chunks;	/* most recent first */
+	struct batch_status *head;	/* first batch_status allocated */
+};
+
+/**
+ * @brief
+ *	Enable or disable decoding of status replies into an arena for
+ *	the calling thread.
+ *
+ * @param[in] enable - non-zero to enable
+ *
+ * @return int
+ * @retval previous setting
+ */
+int
+pbs_stat_arena(int enable)
+{
+	struct pbs_client_thread_context *ptr;
+	int prev;
+
+	if (pbs_client_thread_init_thread_context() != 0)
+		return 0;
+	ptr = pbs_client_thread_get_context_data();
+	if (ptr == NULL)
+		return 0;
+	prev = ptr->th_stat_arena;
+	ptr->th_stat_arena = enable ? 1 : 0;
+	return prev;
+}
+
+/**
+ * @brief
+ *	Is decoding into an arena enabled for the calling thread?
+ *
+ * @return int
+ * @retval 1 - yes
+ * @retval 0 - no
+ */
+int
+stat_arena_enabled(void)
+{
+	struct pbs_client_thread_context *ptr;
+
+	ptr = pbs_client_thread_get_context_data();
+	return (ptr != NULL && ptr->th_stat_arena);
+}
+
+/**
+ * @brief
+ *	Allocate a cleared batch_status with malloc, with the header
+ *	pbs_statfree() expects.  Every batch_status the library returns
+ *	that is not in an arena must come from here.
+ *
+ * @return struct batch_status *
+ * @retval !NULL - new batch_status
+ * @retval NULL - out of memory
+ */
+struct batch_status *
+bstat_alloc(void)
+{
+	bstat_hdr_t *hdr;
+
+	hdr = calloc(1, BSTAT_HDR_SIZE + sizeof(struct batch_status));
+	if (hdr == NULL)
+		return NULL;
+	hdr->magic = BSTAT_MAGIC_MALLOC;
+	return (struct batch_status *) ((char *) hdr + BSTAT_HDR_SIZE);
+}
+
+/**
+ * @brief
+ *	Free a batch_status itself, not what it points to.  A batch_status
+ *	without the header of bstat_alloc() is assumed to have been
+ *	malloc'ed by the caller.
+ *
+ * @param[in] bsp - batch_status to free
+ *
+ * @return void
+ */
+void
+bstat_free(struct batch_status *bsp)
+{
+	if (bsp == NULL)
+		return;
+	if (BSTAT_HDR(bsp)->magic == BSTAT_MAGIC_MALLOC)
+		free(BSTAT_HDR(bsp));
+	else
+		free(bsp);
+}
+
+/**
+ * @brief
+ *	Create a new, empty arena
+ *
+ * @return pbs_stat_arena_t *
+ * @retval !NULL - new arena
+ * @retval NULL - out of memory
+ */
+pbs_stat_arena_t *
+stat_arena_new(void)
+{
+	return calloc(1, sizeof(pbs_stat_arena_t));
+}
+
+/**
+ * @brief
+ *	Free an arena and all its memory
+ *
+ * @param[in] arena - arena to free
+ *
+ * @return void
+ */
+void
+stat_arena_free(pbs_stat_arena_t *arena)
+{
+	stat_arena_chunk_t *chunk;
+	stat_arena_chunk_t *next;
+
+	if (arena == NULL)
+		return;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	free(arena);
+}
+
+/**
+ * @brief
+ *	Allocate memory from an arena, aligned for any structure
+ *
+ * @param[in] arena - arena to allocate from
+ * @param[in] size - bytes needed
+ *
+ * @return void *
+ * @retval !NULL - memory, not initialized
+ * @retval NULL - out of memory
+ */
+void *
+stat_arena_alloc(pbs_stat_arena_t *arena, size_t size)
+{
+	stat_arena_chunk_t *chunk = arena->chunks;
+	void *p;
+
+	size = (size + STAT_ARENA_ALIGN - 1) & ~(STAT_ARENA_ALIGN - 1);
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t csize = chunk ? chunk->size * 2 : STAT_ARENA_CHUNK_MIN;
+		size_t hsize = (sizeof(stat_arena_chunk_t) + STAT_ARENA_ALIGN - 1) & ~(STAT_ARENA_ALIGN - 1);
+
+		if (csize > STAT_ARENA_CHUNK_MAX)
+			csize = STAT_ARENA_CHUNK_MAX;
+		if (csize < size)
+			csize = size;
+		chunk = malloc(hsize + csize);
+		if (chunk == NULL)
+			return NULL;
+		chunk->data = (char *) chunk + hsize;
+		chunk->size = csize;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	p = chunk->data + chunk->used;
+	chunk->used += size;
+	return p;
+}
+
+/**
+ * @brief
+ *	Allocate a cleared batch_status from an arena
+ *
+ * @param[in] arena - arena to allocate from
+ *
+ * @return struct batch_status *
+ * @retval !NULL - new batch_status
+ * @retval NULL - out of memory
+ */
+struct batch_status *
+stat_arena_new_bstat(pbs_stat_arena_t *arena)
+{
+	bstat_hdr_t *hdr;
+	struct batch_status *bs;
+
+	hdr = stat_arena_alloc(arena, BSTAT_HDR_SIZE + sizeof(struct batch_status));
+	if (hdr == NULL)
+		return NULL;
+	hdr->arena = arena;
+	hdr->magic = BSTAT_MAGIC_ARENA;
+	bs = (struct batch_status *) ((char *) hdr + BSTAT_HDR_SIZE);
+	memset(bs, 0, sizeof(struct batch_status));
+	if (arena->head == NULL)
+		arena->head = bs;
+	return bs;
+}
+
+/**
+ * @brief
+ *	Read a DIS counted string into an arena, same as disrst() otherwise
+ *
+ * @param[in] sock - socket to read from
+ * @param[in] arena - arena to allocate the string from
+ * @param[out] rc - DIS error code
+ *
+ * @return char *
+ * @retval !NULL - the NUL terminated string
+ * @retval NULL - error, see *rc
+ */
+char *
+stat_arena_disrst(int sock, pbs_stat_arena_t *arena, int *rc)
+{
+	unsigned int count;
+	char *value;
+
+	count = disrui(sock, rc);
+	if (*rc)
+		return NULL;
+	value = stat_arena_alloc(arena, (size_t) count + 1);
+	if (value == NULL) {
+		*rc = DIS_NOMALLOC;
+		return NULL;
+	}
+	if (dis_gets(sock, value, (size_t) count) != (size_t) count) {
+		*rc = DIS_PROTO;
+		return NULL;
+	}
+#ifndef NDEBUG
+	if (memchr(value, 0, (size_t) count)) {
+		*rc = DIS_NULLSTR;
+		return NULL;
+	}
+#endif
+	value[count] = '\0';
+	return value;
+}
+
+/**
+ * @brief
+ *	Find the arena a batch_status was allocated from
+ *
+ * @param[in] bsp - batch_status to look up
+ *
+ * @return pbs_stat_arena_t *
+ * @retval !NULL - owning arena
+ * @retval NULL - bsp was malloc'ed
+ */
+static pbs_stat_arena_t *
+stat_arena_find(struct batch_status *bsp)
+{
+	bstat_hdr_t *hdr = BSTAT_HDR(bsp);
+
+	if (hdr->magic != BSTAT_MAGIC_ARENA)
+		return NULL;
+	return hdr->arena;
+}
+
+/**
+ * @brief
+ *	Check whether a batch_status lives in an arena, called by
+ *	pbs_statfree() for each element of the list it frees.
+ *
+ *	If it is the first batch_status of its arena, the arena is pushed on
+ *	*release, to be freed with stat_arena_release() once the walk is over.
+ *
+ * @param[in] bsp - batch_status to check
+ * @param[in,out] release - list of arenas to release
+ *
+ * @return int
+ * @retval 1 - bsp is owned by an arena, do not free it
+ * @retval 0 - bsp was malloc'ed
+ */
+int
+stat_arena_owns(struct batch_status *bsp, pbs_stat_arena_t **release)
+{
+	pbs_stat_arena_t *arena;
+
+	if ((arena = stat_arena_find(bsp)) == NULL)
+		return 0;
+	if (arena->head == bsp) {
+		arena->release = *release;
+		*release = arena;
+	}
+	return 1;
+}
+
+/**
+ * @brief
+ *	Free the arenas collected by stat_arena_owns()
+ *
+ * @param[in] release - list of arenas to release
+ *
+ * @return void
+ */
+void
+stat_arena_release(pbs_stat_arena_t *release)
+{
+	pbs_stat_arena_t *next;
+
+	for (; release != NULL; release = next) {
+		next = release->release;
+		stat_arena_free(release);
+	}
+}
+
+/**
+ * @brief
+ *	Throw away a status list that is being decoded into an arena,
+ *	used when decoding fails part way.  The malloc'ed elements of the
+ *	list are freed and the arena is released whether or not its first
+ *	batch_status made it into the list.
+ *
+ * @param[in] arena - arena being decoded into
+ * @param[in] bsp - status list decoded so far
+ *
+ * @return void
+ */
+void
+stat_arena_discard(pbs_stat_arena_t *arena, struct batch_status *bsp)
+{
+	struct batch_status *bsnxt;
+
+	for (; bsp != NULL; bsp = bsnxt) {
+		bsnxt = bsp->next;
+		if (stat_arena_find(bsp) == NULL) {
+			bsp->next = NULL;
+			pbs_statfree(bsp);
+		}
+	}
+	stat_arena_free(arena);
+}
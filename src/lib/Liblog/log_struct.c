@@ -0,0 +1,794 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file	log_struct.c
+ * @brief
+ *	Structured log stream, written next to a text log or accounting file
+ *	when the daemon enables it with log_struct_enable(), i.e. when
+ *	PBS_LOG_STRUCTURED is set in pbs.conf.
+ *
+ *	For a text file <path> two more files are kept:
+ *	<path>.rec holds length-prefixed binary records: a timestamp, the
+ *	event type and object class, then key/value fields.
+ *	<path>.idx is a hash table on disk mapping an object id (the part
+ *	before the first '.', i.e. the job sequence number) to the offsets
+ *	of its records in <path>.rec, so that all records of a job are found
+ *	with a handful of seeks instead of a scan of the day's log.
+ *
+ *	Writers may be several processes sharing the files (a daemon and its
+ *	forked children), so each append is done under an fcntl() lock on
+ *	the index file. Daemons that buffer their log encode records as they
+ *	are logged and append them a batch at a time from the writer thread,
+ *	taking the lock once per batch.
+ *
+ * @par Functions included are:
+ *	log_struct_enable()
+ *	log_struct_enabled()
+ *	log_struct_open()
+ *	log_struct_close()
+ *	log_struct_id_hash()
+ *	log_struct_encode()
+ *	log_struct_append()
+ *	log_struct_write()
+ *	log_struct_lookup()
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "log.h"
+
+#define LOG_STRUCT_MAGIC	"PBSIDX1"
+#define LOG_STRUCT_BUCKETS	65536
+#define LOG_STRUCT_BATCH	64	/* records appended under one lock */
+
+/* index file header, followed by the buckets, then the entries */
+struct log_struct_idx_hdr {
+	char magic[8];		/* LOG_STRUCT_MAGIC */
+	uint32_t nbuckets;	/* number of uint64_t buckets */
+	uint32_t reserved;
+	uint64_t text_size;	/* size of the text file when indexing began */
+};
+
+/* index entry, chained newest first from its bucket */
+struct log_struct_idx_ent {
+	uint64_t next;		/* offset of the previous entry, 0 ends the chain */
+	uint64_t rec_off;	/* offset of the record in the .rec file */
+	uint64_t hash;		/* hash of the record's id */
+};
+
+/* fixed part of a record, after its uint32_t length */
+struct log_struct_rec_hdr {
+	int64_t sec;
+	int32_t usec;		/* -1 if not known */
+	int32_t eventtype;
+	int32_t objclass;
+	uint32_t nfields;
+};
+
+struct log_struct_file {
+	int rec_fd;
+	int idx_fd;
+	uint32_t nbuckets;
+	pthread_mutex_t mutex;	/* serializes the threads of this process */
+};
+
+#define LOG_STRUCT_BUCKET_OFF(b) \
+	((off_t)sizeof(struct log_struct_idx_hdr) + (off_t)(b) * sizeof(uint64_t))
+
+static int log_struct_on = 0;	/* set by log_struct_enable() */
+
+/**
+ * @brief
+ *	Hash an object id up to its first '.', so that "123" and
+ *	"123.server" land on the same entries.
+ *
+ * @param[in]	id - object id
+ *
+ * @return	uint64_t
+ */
+uint64_t
+log_struct_id_hash(const char *id)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	for (; (*id != '\0') && (*id != '.'); id++) {
+		h ^= (unsigned char)*id;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * @brief
+ *	Lock or unlock the whole index file for the other processes.
+ *
+ * @param[in]	fd - index file descriptor
+ * @param[in]	type - F_WRLCK or F_UNLCK
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	failure
+ */
+static int
+log_struct_lock(int fd, short type)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	while (fcntl(fd, F_SETLKW, &fl) == -1) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Read exactly len bytes at off.
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	short read or error
+ */
+static int
+log_struct_pread(int fd, void *buf, size_t len, off_t off)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = pread(fd, buf, len, off)) <= 0) {
+			if ((n == -1) && (errno == EINTR))
+				continue;
+			return -1;
+		}
+		buf = (char *)buf + n;
+		len -= n;
+		off += n;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Write exactly len bytes at off.
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	error
+ */
+static int
+log_struct_pwrite(int fd, const void *buf, size_t len, off_t off)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = pwrite(fd, buf, len, off)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf = (const char *)buf + n;
+		len -= n;
+		off += n;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Write all of iov at off, resuming after partial writes.
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	error
+ */
+static int
+log_struct_pwritev(int fd, struct iovec *iov, int cnt, off_t off)
+{
+	ssize_t n;
+
+	while (cnt > 0) {
+		if ((n = pwritev(fd, iov, cnt, off)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		off += n;
+		while ((cnt > 0) && ((size_t)n >= iov->iov_len)) {
+			n -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Request structured streams for the logs opened from now on, called
+ *	by a daemon with its PBS_LOG_STRUCTURED pbs.conf setting.
+ *
+ * @param[in]	enable - non-zero to enable
+ *
+ * @return	void
+ */
+void
+log_struct_enable(int enable)
+{
+	log_struct_on = (enable != 0);
+}
+
+/**
+ * @brief
+ *	Tell whether structured logging was requested.
+ *
+ * @return	int
+ * @retval	1	enabled with log_struct_enable()
+ * @retval	0	otherwise
+ */
+int
+log_struct_enabled(void)
+{
+	return log_struct_on;
+}
+
+/**
+ * @brief
+ *	Open (creating if needed) the structured stream of a text file.
+ *
+ * @param[in]	path - path of the text log or accounting file
+ *
+ * @return	struct log_struct_file *
+ * @retval	handle	success
+ * @retval	NULL	failure, errno set
+ */
+struct log_struct_file *
+log_struct_open(const char *path)
+{
+	char fname[MAXPATHLEN + 1];
+	struct log_struct_idx_hdr hdr;
+	struct log_struct_file *lsf;
+	struct stat sb;
+
+	if ((lsf = calloc(1, sizeof(*lsf))) == NULL)
+		return NULL;
+	lsf->rec_fd = -1;
+	lsf->idx_fd = -1;
+
+	snprintf(fname, sizeof(fname), "%s%s", path, LOG_STRUCT_REC_SUFFIX);
+	if ((lsf->rec_fd = open(fname, O_CREAT|O_RDWR, 0644)) == -1)
+		goto err;
+	snprintf(fname, sizeof(fname), "%s%s", path, LOG_STRUCT_IDX_SUFFIX);
+	if ((lsf->idx_fd = open(fname, O_CREAT|O_RDWR, 0644)) == -1)
+		goto err;
+	(void)fcntl(lsf->rec_fd, F_SETFD, FD_CLOEXEC);
+	(void)fcntl(lsf->idx_fd, F_SETFD, FD_CLOEXEC);
+
+	if (log_struct_lock(lsf->idx_fd, F_WRLCK) == -1)
+		goto err;
+	if (fstat(lsf->idx_fd, &sb) == -1) {
+		(void)log_struct_lock(lsf->idx_fd, F_UNLCK);
+		goto err;
+	}
+	if (sb.st_size == 0) {
+		/* new index, remember how much text it does not cover */
+		memset(&hdr, 0, sizeof(hdr));
+		strcpy(hdr.magic, LOG_STRUCT_MAGIC);
+		hdr.nbuckets = LOG_STRUCT_BUCKETS;
+		if (stat(path, &sb) == 0)
+			hdr.text_size = sb.st_size;
+		if ((log_struct_pwrite(lsf->idx_fd, &hdr, sizeof(hdr), 0) == -1) ||
+			(ftruncate(lsf->idx_fd, LOG_STRUCT_BUCKET_OFF(hdr.nbuckets)) == -1)) {
+			(void)log_struct_lock(lsf->idx_fd, F_UNLCK);
+			goto err;
+		}
+	} else if ((log_struct_pread(lsf->idx_fd, &hdr, sizeof(hdr), 0) == -1) ||
+		(strcmp(hdr.magic, LOG_STRUCT_MAGIC) != 0) || (hdr.nbuckets == 0)) {
+		(void)log_struct_lock(lsf->idx_fd, F_UNLCK);
+		errno = EINVAL;
+		goto err;
+	}
+	(void)log_struct_lock(lsf->idx_fd, F_UNLCK);
+
+	lsf->nbuckets = hdr.nbuckets;
+	pthread_mutex_init(&lsf->mutex, NULL);
+	return lsf;
+
+err:
+	if (lsf->rec_fd != -1)
+		close(lsf->rec_fd);
+	if (lsf->idx_fd != -1)
+		close(lsf->idx_fd);
+	free(lsf);
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Close a structured stream opened by log_struct_open().
+ *
+ * @param[in]	lsf - handle, may be NULL
+ */
+void
+log_struct_close(struct log_struct_file *lsf)
+{
+	if (lsf == NULL)
+		return;
+	close(lsf->rec_fd);
+	close(lsf->idx_fd);
+	pthread_mutex_destroy(&lsf->mutex);
+	free(lsf);
+}
+
+/**
+ * @brief
+ *	Encode a record for log_struct_append(), in the format of the .rec
+ *	file. Nothing is written unless the whole record fits in buf.
+ *
+ * @param[out]	buf - where to encode the record, may be NULL if size is 0
+ * @param[in]	size - size of buf
+ * @param[in]	sec - record time
+ * @param[in]	usec - microseconds, or -1 if not known
+ * @param[in]	eventtype - PBSEVENT_* of the record, 0 for accounting
+ * @param[in]	objclass - PBS_EVENTCLASS_* of the record
+ * @param[in]	fields - key, value, key, value, ..., NULL
+ *
+ * @return	size_t
+ * @retval	length of the encoded record, encoded only if <= size
+ *
+ * @par MT-safe: Yes
+ */
+size_t
+log_struct_encode(char *buf, size_t size, time_t sec, long usec,
+	int eventtype, int objclass, const char **fields)
+{
+	struct log_struct_rec_hdr rh;
+	uint32_t len;
+	uint32_t klen;
+	uint32_t vlen;
+	size_t need;
+	char *p;
+	int i;
+
+	rh.sec = sec;
+	rh.usec = usec;
+	rh.eventtype = eventtype;
+	rh.objclass = objclass;
+	rh.nfields = 0;
+	need = sizeof(len) + sizeof(rh);
+	for (i = 0; (fields[i] != NULL) && (fields[i + 1] != NULL); i += 2) {
+		need += 2 * sizeof(uint32_t) + strlen(fields[i]) + strlen(fields[i + 1]);
+		rh.nfields++;
+	}
+	if (need > size)
+		return need;
+
+	len = need - sizeof(len);
+	p = buf;
+	memcpy(p, &len, sizeof(len));
+	p += sizeof(len);
+	memcpy(p, &rh, sizeof(rh));
+	p += sizeof(rh);
+	for (i = 0; i < (int)rh.nfields * 2; i += 2) {
+		klen = strlen(fields[i]);
+		vlen = strlen(fields[i + 1]);
+		memcpy(p, &klen, sizeof(klen));
+		p += sizeof(klen);
+		memcpy(p, &vlen, sizeof(vlen));
+		p += sizeof(vlen);
+		memcpy(p, fields[i], klen);
+		p += klen;
+		memcpy(p, fields[i + 1], vlen);
+		p += vlen;
+	}
+	return need;
+}
+
+/**
+ * @brief
+ *	Append up to LOG_STRUCT_BATCH encoded records to a structured stream
+ *	under one lock: one write for the records, one for their index
+ *	entries, then one per index bucket they land in.
+ *
+ * @param[in]	lsf - handle
+ * @param[in]	recs - records to append, oldest first
+ * @param[in]	n - number of records, at most LOG_STRUCT_BATCH
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	failure
+ */
+static int
+log_struct_append_batch(struct log_struct_file *lsf, struct log_struct_out *recs, int n)
+{
+	struct iovec iov[LOG_STRUCT_BATCH];
+	struct log_struct_idx_ent ents[LOG_STRUCT_BATCH];
+	uint64_t buckets[LOG_STRUCT_BATCH];
+	off_t rec_off;
+	off_t ent_off = 0;
+	off_t off;
+	int nents = 0;
+	int i;
+	int j;
+
+	if (log_struct_lock(lsf->idx_fd, F_WRLCK) == -1)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = (void *)recs[i].rec;
+		iov[i].iov_len = recs[i].len;
+	}
+	if (((rec_off = lseek(lsf->rec_fd, 0, SEEK_END)) == -1) ||
+		(log_struct_pwritev(lsf->rec_fd, iov, n, rec_off) == -1))
+		goto err;
+
+	for (off = rec_off, i = 0; i < n; off += recs[i].len, i++) {
+		if (!recs[i].indexed)
+			continue;
+		if ((nents == 0) && ((ent_off = lseek(lsf->idx_fd, 0, SEEK_END)) == -1))
+			goto err;
+		ents[nents].hash = recs[i].hash;
+		ents[nents].rec_off = off;
+		buckets[nents] = recs[i].hash % lsf->nbuckets;
+		/* chain to the newest entry of the bucket, maybe from this batch */
+		for (j = nents - 1; (j >= 0) && (buckets[j] != buckets[nents]); j--)
+			;
+		if (j >= 0)
+			ents[nents].next = ent_off + j * sizeof(ents[0]);
+		else if (log_struct_pread(lsf->idx_fd, &ents[nents].next, sizeof(uint64_t),
+			LOG_STRUCT_BUCKET_OFF(buckets[nents])) == -1)
+			goto err;
+		nents++;
+	}
+	if (nents == 0)
+		return log_struct_lock(lsf->idx_fd, F_UNLCK);
+
+	if (log_struct_pwrite(lsf->idx_fd, ents, nents * sizeof(ents[0]), ent_off) == -1)
+		goto err;
+	/* publish the entries only once they are complete, newest per bucket */
+	for (i = nents - 1; i >= 0; i--) {
+		for (j = i + 1; (j < nents) && (buckets[j] != buckets[i]); j++)
+			;
+		if (j < nents)
+			continue;
+		off = ent_off + i * sizeof(ents[0]);
+		if (log_struct_pwrite(lsf->idx_fd, &off, sizeof(uint64_t),
+			LOG_STRUCT_BUCKET_OFF(buckets[i])) == -1)
+			goto err;
+	}
+	return log_struct_lock(lsf->idx_fd, F_UNLCK);
+
+err:
+	(void)log_struct_lock(lsf->idx_fd, F_UNLCK);
+	return -1;
+}
+
+/**
+ * @brief
+ *	Append records encoded by log_struct_encode() to a structured stream,
+ *	indexing those that have an id.
+ *
+ * @param[in]	lsf - handle
+ * @param[in]	recs - records to append, oldest first
+ * @param[in]	n - number of records
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	failure
+ *
+ * @par MT-safe: Yes
+ */
+int
+log_struct_append(struct log_struct_file *lsf, struct log_struct_out *recs, int n)
+{
+	int rc = 0;
+	int cnt;
+
+	if (lsf == NULL)
+		return -1;
+	pthread_mutex_lock(&lsf->mutex);
+	for (; n > 0; recs += cnt, n -= cnt) {
+		cnt = (n > LOG_STRUCT_BATCH) ? LOG_STRUCT_BATCH : n;
+		if (log_struct_append_batch(lsf, recs, cnt) == -1)
+			rc = -1;
+	}
+	pthread_mutex_unlock(&lsf->mutex);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Append a record to a structured stream and, if it has an id, index it.
+ *
+ * @param[in]	lsf - handle
+ * @param[in]	sec - record time
+ * @param[in]	usec - microseconds, or -1 if not known
+ * @param[in]	eventtype - PBSEVENT_* of the record, 0 for accounting
+ * @param[in]	objclass - PBS_EVENTCLASS_* of the record
+ * @param[in]	id - object id to index the record under, or NULL
+ * @param[in]	fields - key, value, key, value, ..., NULL
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	failure
+ *
+ * @par MT-safe: Yes
+ */
+int
+log_struct_write(struct log_struct_file *lsf, time_t sec, long usec,
+	int eventtype, int objclass, const char *id, const char **fields)
+{
+	char sbuf[LOG_BUF_SIZE * 2];
+	struct log_struct_out out;
+	char *buf = sbuf;
+	size_t need;
+	int rc;
+
+	if (lsf == NULL)
+		return -1;
+
+	need = log_struct_encode(sbuf, sizeof(sbuf), sec, usec, eventtype, objclass, fields);
+	if (need > sizeof(sbuf)) {
+		if ((buf = malloc(need)) == NULL)
+			return -1;
+		(void)log_struct_encode(buf, need, sec, usec, eventtype, objclass, fields);
+	}
+	out.rec = buf;
+	out.len = need;
+	out.indexed = (id != NULL);
+	out.hash = (id != NULL) ? log_struct_id_hash(id) : 0;
+	rc = log_struct_append(lsf, &out, 1);
+	if (buf != sbuf)
+		free(buf);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Read one record of a .rec file and decode it into rec. The keys and
+ *	values point into a buffer returned in *bufp, which the caller frees.
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	bad or truncated record
+ */
+static int
+log_struct_read_rec(int fd, off_t off, struct log_struct_rec *rec, char **bufp)
+{
+	struct log_struct_rec_hdr rh;
+	uint32_t len;
+	uint32_t klen;
+	uint32_t vlen;
+	uint32_t i;
+	char *raw = NULL;
+	char *out = NULL;
+	char *p;
+	char *end;
+	char *o;
+
+	*bufp = NULL;
+	if ((log_struct_pread(fd, &len, sizeof(len), off) == -1) || (len < sizeof(rh)))
+		return -1;
+	if ((raw = malloc(len)) == NULL)
+		return -1;
+	if (log_struct_pread(fd, raw, len, off + sizeof(len)) == -1)
+		goto err;
+	memcpy(&rh, raw, sizeof(rh));
+	if (rh.nfields > len)
+		goto err;
+
+	/* room for the strings plus their terminators and the pointer arrays */
+	if ((out = malloc(len + rh.nfields * 2 + 2 * (rh.nfields + 1) * sizeof(char *))) == NULL)
+		goto err;
+	rec->keys = (char **)out;
+	rec->vals = rec->keys + rh.nfields + 1;
+	o = (char *)(rec->vals + rh.nfields + 1);
+
+	p = raw + sizeof(rh);
+	end = raw + len;
+	for (i = 0; i < rh.nfields; i++) {
+		if ((size_t)(end - p) < 2 * sizeof(uint32_t))
+			goto err;
+		memcpy(&klen, p, sizeof(klen));
+		p += sizeof(klen);
+		memcpy(&vlen, p, sizeof(vlen));
+		p += sizeof(vlen);
+		if (((size_t)(end - p) < klen) || ((size_t)(end - p - klen) < vlen))
+			goto err;
+		rec->keys[i] = o;
+		memcpy(o, p, klen);
+		o[klen] = '\0';
+		o += klen + 1;
+		p += klen;
+		rec->vals[i] = o;
+		memcpy(o, p, vlen);
+		o[vlen] = '\0';
+		o += vlen + 1;
+		p += vlen;
+	}
+	rec->keys[i] = NULL;
+	rec->vals[i] = NULL;
+	rec->sec = rh.sec;
+	rec->usec = rh.usec;
+	rec->eventtype = rh.eventtype;
+	rec->objclass = rh.objclass;
+	rec->nfields = rh.nfields;
+	free(raw);
+	*bufp = out;
+	return 0;
+
+err:
+	free(raw);
+	free(out);
+	return -1;
+}
+
+/**
+ * @brief
+ *	Return the value of a field of a decoded record.
+ *
+ * @param[in]	rec - record
+ * @param[in]	key - field name
+ *
+ * @return	char *
+ * @retval	value	field found
+ * @retval	NULL	no such field
+ */
+char *
+log_struct_field(struct log_struct_rec *rec, const char *key)
+{
+	int i;
+
+	for (i = 0; i < rec->nfields; i++) {
+		if (strcmp(rec->keys[i], key) == 0)
+			return rec->vals[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Call func, oldest first, for every record indexed under id in the
+ *	structured stream of a text file. Records of other ids that share
+ *	the hash of id may be passed too; func must check the id itself.
+ *
+ * @param[in]	path - path of the text log or accounting file
+ * @param[in]	id - object id, only its part before the first '.' is used
+ * @param[in]	func - called for each record, a non-zero return stops
+ * @param[in]	arg - passed to func
+ *
+ * @return	int
+ * @retval	>=0	number of records passed to func
+ * @retval	-1	no usable index, or it does not cover the whole text file;
+ *			the caller should scan the text file instead
+ */
+int
+log_struct_lookup(const char *path, const char *id,
+	int (*func)(struct log_struct_rec *, void *), void *arg)
+{
+	char fname[MAXPATHLEN + 1];
+	struct log_struct_idx_hdr hdr;
+	struct log_struct_idx_ent ent;
+	struct log_struct_rec rec;
+	struct stat sb;
+	uint64_t hash;
+	uint64_t off;
+	uint64_t *offs = NULL;
+	size_t noffs = 0;
+	size_t maxoffs = 0;
+	size_t limit;
+	uint64_t *tmp;
+	char *buf;
+	int idx_fd = -1;
+	int rec_fd = -1;
+	int count = -1;
+
+	snprintf(fname, sizeof(fname), "%s%s", path, LOG_STRUCT_IDX_SUFFIX);
+	if ((idx_fd = open(fname, O_RDONLY)) == -1)
+		return -1;
+	snprintf(fname, sizeof(fname), "%s%s", path, LOG_STRUCT_REC_SUFFIX);
+	if ((rec_fd = open(fname, O_RDONLY)) == -1)
+		goto done;
+	if ((log_struct_pread(idx_fd, &hdr, sizeof(hdr), 0) == -1) ||
+		(strncmp(hdr.magic, LOG_STRUCT_MAGIC, sizeof(hdr.magic)) != 0) ||
+		(hdr.nbuckets == 0) || (hdr.text_size != 0) ||
+		(fstat(idx_fd, &sb) == -1))
+		goto done;
+
+	hash = log_struct_id_hash(id);
+	if (log_struct_pread(idx_fd, &off, sizeof(off),
+		LOG_STRUCT_BUCKET_OFF(hash % hdr.nbuckets)) == -1)
+		goto done;
+
+	/* walk the chain, bounded by the number of entries the file can hold */
+	limit = sb.st_size / sizeof(ent);
+	while ((off != 0) && (limit-- > 0)) {
+		if (log_struct_pread(idx_fd, &ent, sizeof(ent), off) == -1)
+			goto done;
+		if (ent.hash == hash) {
+			if (noffs == maxoffs) {
+				maxoffs = maxoffs ? maxoffs * 2 : 64;
+				if ((tmp = realloc(offs, maxoffs * sizeof(*offs))) == NULL)
+					goto done;
+				offs = tmp;
+			}
+			offs[noffs++] = ent.rec_off;
+		}
+		off = ent.next;
+	}
+
+	/* the chain is newest first */
+	count = 0;
+	while (noffs > 0) {
+		if (log_struct_read_rec(rec_fd, offs[--noffs], &rec, &buf) == -1)
+			continue;
+		count++;
+		if (func(&rec, arg) != 0)
+			noffs = 0;
+		free(buf);
+	}
+
+done:
+	free(offs);
+	if (rec_fd != -1)
+		close(rec_fd);
+	close(idx_fd);
+	return count;
+}
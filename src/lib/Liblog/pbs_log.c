@@ -65,8 +65,14 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <signal.h>
+#include <ctype.h>
 #include <stddef.h>
 #include <stdarg.h>
+#ifndef WIN32
+#include <sched.h>
+#include <time.h>
+#include <sys/uio.h>
+#endif
 
 #include "log.h"
 #include "pbs_ifl.h"
@@ -93,6 +99,8 @@ static pthread_mutex_t log_write_mutex;
 typedef struct {
 	struct tm ptm;
 	char microsec_buf[8];
+	time_t sec;
+	long usec;
 } ms_time; /* microsecond time stamp */
 
 char *msg_daemonname;
@@ -134,6 +142,70 @@ static unsigned int syslogfac = 0;
 static unsigned int syslogsvr = 3;
 static unsigned int pbs_log_highres_timestamp = 0;
 
+#ifndef WIN32
+/*
+ * Asynchronous logging. When a daemon calls log_async_start() with the
+ * number of records to buffer (the PBS_LOG_ASYNC pbs.conf setting), log_record()
+ * formats each record and places it in a ring, without taking the log
+ * mutex. A writer thread empties the ring with writev() while holding
+ * the log mutex, so that a slow log file system only stalls the writer.
+ *
+ * The ring is a bounded multi-producer queue: a slot is free for the
+ * producer claiming position pos when its seq is pos, and holds a
+ * record for the consumer when its seq is pos + 1. Whoever holds the
+ * log mutex is the single consumer.
+ *
+ * With a structured stream, a slot also holds the record encoded for it,
+ * after the text, so that the consumer appends a whole batch to the
+ * stream at once rather than each producer appending its own record.
+ */
+#define LOG_ASYNC_MIN_SLOTS	64
+#define LOG_ASYNC_INLINE	512	/* record bytes kept inside the slot */
+#define LOG_ASYNC_BATCH		64	/* records per writev() */
+#define LOG_ASYNC_SPINS		1000	/* retries on a full ring before dropping */
+#define LOG_ASYNC_IDLE_MS	50	/* writer sleep when the ring is empty */
+
+typedef struct {
+	unsigned long seq;		/* see above */
+	size_t len;			/* text record length */
+	size_t slen;			/* structured record length, 0 if none */
+	uint64_t hash;			/* id hash of the structured record */
+	int indexed;			/* whether it is indexed under hash */
+	char *big;			/* records longer than LOG_ASYNC_INLINE */
+	char buf[LOG_ASYNC_INLINE];
+} log_async_slot;
+
+static log_async_slot *log_async_ring;
+static unsigned long log_async_mask;
+static unsigned long log_async_head;	/* next position to fill */
+static unsigned long log_async_tail;	/* next position to write */
+static unsigned long log_async_dropped;	/* records lost to a full ring */
+static volatile int log_async_on = 0;
+static int log_async_sleeping = 0;
+static pthread_t log_async_tid;
+/*
+ * Producers hold this for reading while outside the log mutex, so that
+ * fork() never happens while one of them holds a libc lock (localtime_r()
+ * takes one) that the child would then find locked forever.
+ */
+static pthread_rwlock_t log_async_fork_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t log_async_wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_async_wake = PTHREAD_COND_INITIALIZER;
+
+static void log_async_record(int eventtype, int objclass, const char *objname, const char *text, ms_time *mst);
+static void log_async_drain(void);
+
+/*
+ * Structured stream of the open log, when enabled with log_struct_enable().
+ * It is only written with the log mutex held; asynchronous producers
+ * just look at whether it is there to know whether to encode records.
+ */
+static struct log_struct_file *log_struct = NULL;
+#define LOG_STRUCT_NFIELDS	9
+static const char *log_struct_fields(const char **fields, int objclass, const char *objname, const char *text);
+static void log_struct_record(int eventtype, int objclass, const char *objname, const char *text, ms_time *mst);
+#endif
+
 static void log_init(void);
 static int log_mutex_lock();
 static int log_mutex_unlock();
@@ -325,6 +397,29 @@ log_mutex_unlock()
 	return 0;
 }
 
+/**
+ * @brief
+ *	Initialize the log mutex. It is recursive, so that log_close() can
+ *	drain the async log ring whether or not its caller holds the lock.
+ *
+ * @return Error code
+ * @retval  0 - success
+ * @retval !0 - failure
+ */
+static int
+log_mutex_init(void)
+{
+	pthread_mutexattr_t attr;
+	int rc;
+
+	if ((rc = pthread_mutexattr_init(&attr)) != 0)
+		return rc;
+	if ((rc = pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE)) == 0)
+		rc = pthread_mutex_init(&log_write_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return rc;
+}
+
 #ifndef WIN32
 
 /**
@@ -335,7 +430,11 @@ log_mutex_unlock()
 static void
 log_pre_fork_handler()
 {
+	pthread_rwlock_wrlock(&log_async_fork_lock);
 	log_mutex_lock();
+	/* the child must neither lose nor repeat buffered records */
+	if (log_async_on)
+		log_async_drain();
 }
 
 /**
@@ -347,17 +446,23 @@ static void
 log_parent_post_fork_handler()
 {
 	log_mutex_unlock();
+	pthread_rwlock_unlock(&log_async_fork_lock);
 }
 
 /**
  * @brief
- *	wrapper function for log_mutex_unlock().
+ *	Release the log locks in the child. They are initialized afresh since
+ *	the recursive log mutex records the owner by thread id, which changes
+ *	across fork(). The writer thread does not exist in the child, so the
+ *	child logs synchronously.
  *
  */
 static void
 log_child_post_fork_handler()
 {
-	log_mutex_unlock();
+	log_async_on = 0;
+	(void)log_mutex_init();
+	(void)pthread_rwlock_init(&log_async_fork_lock, NULL);
 }
 #endif
 
@@ -374,7 +479,7 @@ log_child_post_fork_handler()
 static void
 log_init(void)
 {
-	if (pthread_mutex_init(&log_write_mutex, NULL) != 0) {
+	if (log_mutex_init() != 0) {
 		fprintf(stderr, "log write mutex init failed\n");
 		return;
 	}
@@ -621,14 +726,19 @@ log_open_main(char *filename, char *directory, int silent)
 			(void)close(fds);
 			fds = log_opened;
 		}
+		/* the async writer may be looking at the log */
+		log_mutex_lock();
 		logfile = fdopen(fds, "a");
 
 #ifdef WIN32
 		(void)setvbuf(logfile, NULL, _IONBF, 0);	/* no buffering to get instant log */
 #else
 		(void)setvbuf(logfile, NULL, _IOLBF, 0);	/* set line buffering */
+		if (log_struct_enabled())
+			__atomic_store_n(&log_struct, log_struct_open(filename), __ATOMIC_RELEASE);
 #endif
 		log_opened = 1;			/* note that file is open */
+		log_mutex_unlock();
 
 		if (!silent) {
 			ms_time mst;
@@ -933,9 +1043,11 @@ get_timestamp(ms_time *mst)
 #ifndef WIN32
 	struct tm ltm;
 #endif
+	mst->usec = 0;
 	/* if gettimeofday() fails, log messages will be printed at the epoch */
 	if (gettimeofday(&tp, NULL) != -1) {
 		now = tp.tv_sec;
+		mst->usec = tp.tv_usec;
 		if (pbs_log_highres_timestamp)
 			snprintf(mst->microsec_buf, sizeof(mst->microsec_buf), ".%06ld", (long)tp.tv_usec);
 		else
@@ -949,6 +1061,7 @@ get_timestamp(ms_time *mst)
 #endif
 
 	mst->ptm = *ptm;
+	mst->sec = now;
 }
 
 /**
@@ -1019,6 +1132,22 @@ log_record(int eventtype, int objclass, int sev, const char *objname, const char
 	if ((text == NULL) || (objname == NULL))
 		goto sigunblock;
 
+#ifndef WIN32
+	if (log_async_on && (locallog != 0 || syslogfac == 0)) {
+		pthread_rwlock_rdlock(&log_async_fork_lock);
+		get_timestamp(&mst);
+		/* straight to the ring, unless the log has to be switched */
+		if (!log_auto_switch || (mst.ptm.tm_yday == log_open_day)) {
+			log_async_record(eventtype, objclass, objname, text, &mst);
+			pthread_rwlock_unlock(&log_async_fork_lock);
+			if (sev <= LOG_CRIT)
+				log_flush();
+			goto sigunblock;
+		}
+		pthread_rwlock_unlock(&log_async_fork_lock);
+	}
+#endif
+
 	/* lock the file mutex */
 	if (log_mutex_lock() == 0) {
 		get_timestamp(&mst);
@@ -1070,6 +1199,13 @@ log_record_inner(int eventtype, int objclass, int sev, const char *objname, cons
 {
 	int rc = 0;
 	if (locallog != 0 || syslogfac == 0) {
+#ifndef WIN32
+		if (log_async_on) {
+			log_async_record(eventtype, objclass, objname, text, mst);
+			return;
+		}
+		log_struct_record(eventtype, objclass, objname, text, mst);
+#endif
 		rc = fprintf(logfile,
 				"%02d/%02d/%04d %02d:%02d:%02d%s;%04x;%s;%s;%s;%s\n",
 				mst->ptm.tm_mon + 1, mst->ptm.tm_mday, mst->ptm.tm_year + 1900,
@@ -1102,8 +1238,16 @@ log_close(int msg)
 			get_timestamp(&mst);
 			log_record_inner(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO, "Log", "Log closed", &mst);
 		}
+		/* keep the async writer out until the files are closed */
+		log_mutex_lock();
+		log_flush();
 		(void)fclose(logfile);
 		log_opened = 0;
+#ifndef WIN32
+		log_struct_close(log_struct);
+		__atomic_store_n(&log_struct, NULL, __ATOMIC_RELEASE);
+#endif
+		log_mutex_unlock();
 	}
 #if SYSLOG
 	if (syslogopen) {
@@ -1139,3 +1283,444 @@ log_level_2_etype(int level)
 
 	return etype;
 }
+
+#ifndef WIN32
+/**
+ * @brief
+ *	Wake the async log writer if it is waiting for records.
+ */
+static void
+log_async_wakeup(void)
+{
+	if (__atomic_load_n(&log_async_sleeping, __ATOMIC_ACQUIRE))
+		pthread_cond_signal(&log_async_wake);
+}
+
+/**
+ * @brief
+ *	Place a formatted record in the async log ring.
+ *
+ * @param[in] rec - the record, newline terminated
+ * @param[in] len - length of rec
+ * @param[in] out - the record encoded for the structured stream, or NULL
+ *
+ * @return int
+ * @retval  0 - record queued
+ * @retval -1 - ring is full
+ *
+ * @par MT-safe: Yes
+ */
+static int
+log_async_put(const char *rec, size_t len, struct log_struct_out *out)
+{
+	log_async_slot *slot;
+	unsigned long pos;
+	unsigned long seq;
+	long dif;
+
+	pos = __atomic_load_n(&log_async_head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &log_async_ring[pos & log_async_mask];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		dif = (long)(seq - pos);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&log_async_head, &pos, pos + 1,
+					1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0)
+			return -1;
+		else
+			pos = __atomic_load_n(&log_async_head, __ATOMIC_RELAXED);
+	}
+
+	slot->big = NULL;
+	slot->slen = (out != NULL) ? out->len : 0;
+	if ((len + slot->slen > LOG_ASYNC_INLINE) &&
+		((slot->big = malloc(len + slot->slen)) == NULL)) {
+		slot->slen = 0;
+		if (len > LOG_ASYNC_INLINE) {
+			len = LOG_ASYNC_INLINE;	/* keep what fits */
+			slot->buf[len - 1] = '\n';
+			memcpy(slot->buf, rec, len - 1);
+		} else
+			memcpy(slot->buf, rec, len);
+	} else {
+		memcpy(slot->big ? slot->big : slot->buf, rec, len);
+		if (slot->slen > 0) {
+			memcpy((slot->big ? slot->big : slot->buf) + len, out->rec, slot->slen);
+			slot->hash = out->hash;
+			slot->indexed = out->indexed;
+		}
+	}
+	slot->len = len;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Fill in the fields of a structured log record.
+ *
+ * @param[out] fields - LOG_STRUCT_NFIELDS fields, NULL terminated
+ * @param[in] objclass - event object class
+ * @param[in] objname - object name
+ * @param[in] text - log msg to be logged
+ *
+ * @return const char *
+ * @retval id to index the record under, for jobs and reservations
+ * @retval NULL if the record is not indexed
+ */
+static const char *
+log_struct_fields(const char **fields, int objclass, const char *objname, const char *text)
+{
+	fields[0] = "daemon";
+	fields[1] = msg_daemonname ? msg_daemonname : "";
+	fields[2] = "class";
+	fields[3] = class_names[objclass];
+	fields[4] = "name";
+	fields[5] = objname;
+	fields[6] = "msg";
+	fields[7] = text;
+	fields[8] = NULL;
+
+	if ((objclass == PBS_EVENTCLASS_JOB) || (objclass == PBS_EVENTCLASS_RESV) ||
+		isdigit((unsigned char)*objname))
+		return objname;
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Append a record to the structured stream of the log, if there is one.
+ *	Records of jobs and reservations are indexed by the object id. The
+ *	caller holds the log mutex.
+ *
+ * @param[in] eventtype - event type
+ * @param[in] objclass - event object class
+ * @param[in] objname - object name
+ * @param[in] text - log msg to be logged
+ * @param[in] mst - timestamp of the record
+ */
+static void
+log_struct_record(int eventtype, int objclass, const char *objname, const char *text, ms_time *mst)
+{
+	const char *fields[LOG_STRUCT_NFIELDS];
+
+	if (log_struct == NULL)
+		return;
+	(void)log_struct_write(log_struct, mst->sec, pbs_log_highres_timestamp ? mst->usec : -1,
+		eventtype & ~PBSEVENT_FORCE, objclass,
+		log_struct_fields(fields, objclass, objname, text), fields);
+}
+
+/**
+ * @brief
+ *	Format a log record and queue it for the async writer. When the ring
+ *	is full the caller drains it itself if the log mutex is free (or
+ *	already its own), and otherwise retries for a while before dropping
+ *	the record and counting it in log_async_dropped.
+ *
+ * @param[in] eventtype - event type
+ * @param[in] objclass - event object class
+ * @param[in] objname - object name
+ * @param[in] text - log msg to be logged
+ * @param[in] mst - timestamp of the record
+ */
+static void
+log_async_record(int eventtype, int objclass, const char *objname, const char *text, ms_time *mst)
+{
+	char rec[LOG_BUF_SIZE + 256];
+	char srec[LOG_BUF_SIZE + 256];
+	const char *fields[LOG_STRUCT_NFIELDS];
+	const char *id;
+	struct log_struct_out sout;
+	struct log_struct_out *out = NULL;
+	char *p = rec;
+	int len;
+	int spins;
+
+	len = snprintf(rec, sizeof(rec),
+			"%02d/%02d/%04d %02d:%02d:%02d%s;%04x;%s;%s;%s;%s\n",
+			mst->ptm.tm_mon + 1, mst->ptm.tm_mday, mst->ptm.tm_year + 1900,
+			mst->ptm.tm_hour, mst->ptm.tm_min, mst->ptm.tm_sec, mst->microsec_buf,
+			eventtype & ~PBSEVENT_FORCE, msg_daemonname,
+			class_names[objclass], objname, text);
+	if (len < 0) {
+		log_console_error("PBS cannot format its log");
+		return;
+	}
+	if ((size_t)len >= sizeof(rec)) {
+		if ((p = malloc(len + 1)) != NULL)
+			snprintf(p, len + 1,
+				"%02d/%02d/%04d %02d:%02d:%02d%s;%04x;%s;%s;%s;%s\n",
+				mst->ptm.tm_mon + 1, mst->ptm.tm_mday, mst->ptm.tm_year + 1900,
+				mst->ptm.tm_hour, mst->ptm.tm_min, mst->ptm.tm_sec, mst->microsec_buf,
+				eventtype & ~PBSEVENT_FORCE, msg_daemonname,
+				class_names[objclass], objname, text);
+		else {
+			p = rec;
+			len = sizeof(rec) - 1;
+			rec[len - 1] = '\n';
+		}
+	}
+
+	/* encode the structured record here, the writer appends it */
+	if (__atomic_load_n(&log_struct, __ATOMIC_ACQUIRE) != NULL) {
+		id = log_struct_fields(fields, objclass, objname, text);
+		sout.rec = srec;
+		sout.len = log_struct_encode(srec, sizeof(srec), mst->sec,
+			pbs_log_highres_timestamp ? mst->usec : -1,
+			eventtype & ~PBSEVENT_FORCE, objclass, fields);
+		if ((sout.len > sizeof(srec)) && ((sout.rec = malloc(sout.len)) != NULL))
+			(void)log_struct_encode((char *)sout.rec, sout.len, mst->sec,
+				pbs_log_highres_timestamp ? mst->usec : -1,
+				eventtype & ~PBSEVENT_FORCE, objclass, fields);
+		if (sout.rec != NULL) {
+			sout.indexed = (id != NULL);
+			sout.hash = (id != NULL) ? log_struct_id_hash(id) : 0;
+			out = &sout;
+		}
+	}
+
+	for (spins = 0; log_async_put(p, len, out) != 0; spins++) {
+		if (pthread_mutex_trylock(&log_write_mutex) == 0) {
+			log_async_drain();
+			log_mutex_unlock();
+			continue;
+		}
+		if (spins >= LOG_ASYNC_SPINS) {
+			__atomic_add_fetch(&log_async_dropped, 1, __ATOMIC_RELAXED);
+			break;
+		}
+		log_async_wakeup();
+		sched_yield();
+	}
+	if (p != rec)
+		free(p);
+	if ((out != NULL) && (out->rec != srec))
+		free((char *)out->rec);
+	log_async_wakeup();
+}
+
+/**
+ * @brief
+ *	Write all of iov to fd, resuming after partial writes.
+ *
+ * @param[in] fd - log file descriptor
+ * @param[in] iov - records to write, modified
+ * @param[in] cnt - number of entries in iov
+ */
+static void
+log_async_writev(int fd, struct iovec *iov, int cnt)
+{
+	ssize_t n;
+
+	while (cnt > 0) {
+		if ((n = writev(fd, iov, cnt)) < 0) {
+			if (errno == EINTR)
+				continue;
+			log_console_error("PBS cannot write to its log");
+			return;
+		}
+		while ((cnt > 0) && ((size_t)n >= iov->iov_len)) {
+			n -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+}
+
+/**
+ * @brief
+ *	Write every queued record to the log file, LOG_ASYNC_BATCH records
+ *	per writev(), and their structured records to the structured stream
+ *	a batch at a time. The caller must hold the log mutex. Records are
+ *	dropped if the log is not open.
+ */
+static void
+log_async_drain(void)
+{
+	struct iovec iov[LOG_ASYNC_BATCH + 1];
+	struct log_struct_out sout[LOG_ASYNC_BATCH + 1];
+	char dropmsg[LOG_BUF_SIZE];
+	log_async_slot *slot;
+	unsigned long pos;
+	unsigned long dropped;
+	int n;
+	int ns;
+	ms_time mst;
+
+	for (;;) {
+		n = 0;
+		ns = 0;
+		if ((dropped = __atomic_exchange_n(&log_async_dropped, 0, __ATOMIC_RELAXED)) != 0) {
+			get_timestamp(&mst);
+			iov[n].iov_base = dropmsg;
+			iov[n++].iov_len = snprintf(dropmsg, sizeof(dropmsg),
+				"%02d/%02d/%04d %02d:%02d:%02d%s;%04x;%s;%s;%s;%lu log records dropped, log buffer full\n",
+				mst.ptm.tm_mon + 1, mst.ptm.tm_mday, mst.ptm.tm_year + 1900,
+				mst.ptm.tm_hour, mst.ptm.tm_min, mst.ptm.tm_sec, mst.microsec_buf,
+				PBSEVENT_SYSTEM, msg_daemonname,
+				class_names[PBS_EVENTCLASS_SERVER], "Log", dropped);
+		}
+		for (pos = log_async_tail; n <= LOG_ASYNC_BATCH; pos++) {
+			slot = &log_async_ring[pos & log_async_mask];
+			if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+				break;
+			iov[n].iov_base = slot->big ? slot->big : slot->buf;
+			iov[n++].iov_len = slot->len;
+			if (slot->slen > 0) {
+				sout[ns].rec = (slot->big ? slot->big : slot->buf) + slot->len;
+				sout[ns].len = slot->slen;
+				sout[ns].hash = slot->hash;
+				sout[ns++].indexed = slot->indexed;
+			}
+		}
+		if (n == 0)
+			return;
+
+		if ((log_opened == 1) && (logfile != NULL))
+			log_async_writev(fileno(logfile), iov, n);
+		if ((ns > 0) && (log_struct != NULL))
+			(void)log_struct_append(log_struct, sout, ns);
+
+		for (; log_async_tail != pos; log_async_tail++) {
+			slot = &log_async_ring[log_async_tail & log_async_mask];
+			free(slot->big);
+			slot->big = NULL;
+			__atomic_store_n(&slot->seq, log_async_tail + log_async_mask + 1,
+				__ATOMIC_RELEASE);
+		}
+	}
+}
+
+/**
+ * @brief
+ *	The async log writer thread: drain the ring, then sleep until a
+ *	producer wakes it or LOG_ASYNC_IDLE_MS passes.
+ *
+ * @param[in] arg - unused
+ */
+static void *
+log_async_writer(void *arg)
+{
+	struct timespec ts;
+	log_async_slot *slot;
+
+	for (;;) {
+		if (log_mutex_lock() == 0) {
+			log_async_drain();
+			log_mutex_unlock();
+		}
+
+		pthread_mutex_lock(&log_async_wake_mutex);
+		slot = &log_async_ring[log_async_tail & log_async_mask];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != log_async_tail + 1) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += LOG_ASYNC_IDLE_MS * 1000000L;
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			__atomic_store_n(&log_async_sleeping, 1, __ATOMIC_RELEASE);
+			(void)pthread_cond_timedwait(&log_async_wake, &log_async_wake_mutex, &ts);
+			__atomic_store_n(&log_async_sleeping, 0, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&log_async_wake_mutex);
+	}
+	return NULL;
+}
+#endif
+
+/**
+ * @brief
+ *	Switch this process to asynchronous logging, buffering up to nrecs
+ *	records (rounded up to a power of two). Meant to be called by a daemon
+ *	once it has gone to the background, with the PBS_LOG_ASYNC pbs.conf
+ *	setting; processes it forks afterwards log synchronously.
+ *
+ * @param[in] nrecs - number of records to buffer, 0 to stay synchronous
+ *
+ * @return int
+ * @retval  0 - async logging started, or not requested
+ * @retval -1 - failure, logging stays synchronous
+ */
+int
+log_async_start(unsigned int nrecs)
+{
+#ifndef WIN32
+	static int atexit_done = 0;
+	unsigned long slots;
+	unsigned long i;
+	sigset_t all;
+	sigset_t old;
+	int rc;
+
+	if (log_async_on || (nrecs == 0))
+		return 0;
+
+	pthread_once(&log_once_ctl, log_init);
+	for (slots = LOG_ASYNC_MIN_SLOTS; slots < nrecs; slots <<= 1)
+		;
+
+	if (log_async_ring != NULL) {
+		/* left over from the parent of a fork */
+		for (i = 0; i <= log_async_mask; i++)
+			free(log_async_ring[i].big);
+		free(log_async_ring);
+	}
+	if ((log_async_ring = calloc(slots, sizeof(log_async_slot))) == NULL) {
+		log_err(errno, __func__, "could not allocate the log buffer");
+		return -1;
+	}
+	for (i = 0; i < slots; i++)
+		log_async_ring[i].seq = i;
+	log_async_mask = slots - 1;
+	log_async_head = 0;
+	log_async_tail = 0;
+	log_async_dropped = 0;
+
+	/* the writer must never take the daemon's signals */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	log_async_on = 1;
+	rc = pthread_create(&log_async_tid, NULL, log_async_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (rc != 0) {
+		log_async_on = 0;
+		log_err(rc, __func__, "could not start the log writer thread");
+		return -1;
+	}
+	(void)pthread_detach(log_async_tid);
+
+	if (!atexit_done) {
+		atexit(log_flush);
+		atexit_done = 1;
+	}
+#endif
+	return 0;
+}
+
+/**
+ * @brief
+ *	Write out any log records still buffered by asynchronous logging.
+ *	Called on log close, process exit and records of LOG_CRIT or worse.
+ *
+ * @par MT-safe: Yes
+ */
+void
+log_flush(void)
+{
+#ifndef WIN32
+	if (!log_async_on)
+		return;
+	if (log_mutex_lock() == 0) {
+		log_async_drain();
+		log_mutex_unlock();
+	}
+#endif
+}
@@ -62,6 +62,9 @@
 #include <signal.h>
 #include <unistd.h>
 #include <wchar.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <marshal.h>            /* For PyMarshal_* */
 
 extern PyObject* PyInit__pbs_ifl(void);
 
@@ -73,9 +76,35 @@ static struct _inittab pbs_python_inittab_modules[] = {
 
 static PyObject *
 _pbs_python_compile_file(const char *file_name,
-	const char *compiled_code_file_name);
+	const char *compiled_code_file_name, int use_cache);
+static int _pbs_python_keep_globals(const char *script_path);
+static void _pbs_python_script_account(struct python_script *py_script);
 extern int pbs_python_setup_namespace_dict(PyObject *globals);
 
+/*
+ * Default number of objects a single script may keep reachable from its
+ * globals before its namespace and code are recycled, see the pbs.conf
+ * setting PBS_PYTHON_HOOK_MAX_BLOCKS.
+ */
+#define PBS_PYTHON_HOOK_MAX_BLOCKS	1000000
+
+/*
+ * A persistent namespace is counted after its first run, then once every
+ * PBS_PYTHON_ACCOUNT_INTERVAL runs, as the walk of a big namespace costs
+ * far more than a typical hook run.
+ */
+#define PBS_PYTHON_ACCOUNT_INTERVAL	16
+
+/* header of a compiled script file, followed by the marshalled code */
+#define PBS_PYTHON_BYTECODE_MAGIC	0x50425343	/* "PBSC" */
+struct pbs_python_bytecode_hdr {
+	uint32_t magic;		/* PBS_PYTHON_BYTECODE_MAGIC */
+	uint32_t py_magic;	/* interpreter bytecode magic */
+	uint64_t src_hash;	/* FNV-1a hash of the script text */
+	uint64_t src_len;	/* length of the script text */
+	uint64_t code_len;	/* length of the marshalled code */
+};
+
 #endif      /* PYTHON */
 
 #include <pbs_python.h>
@@ -491,6 +520,7 @@ pbs_python_ext_alloc_python_script(
 	(void) memset(tmp_py_script, 0, nbytes);
 	/* check for recompile true by default */
 	tmp_py_script->check_for_recompile = 1;
+	tmp_py_script->keep_globals = _pbs_python_keep_globals(script_path);
 
 	COPY_STRING(tmp_py_script->path, script_path);
 	/* store the stat */
@@ -655,7 +685,8 @@ pbs_python_check_and_compile_script(struct python_interpreter_data *interp_data,
 
 		if (!(py_script->py_code_obj =
 			_pbs_python_compile_file(py_script->path,
-			"<embedded code object>"))) {
+			"<embedded code object>",
+			py_script->cache_bytecode))) {
 			pbs_python_write_error_to_log("Failed to compile script");
 			return -2;
 		}
@@ -749,30 +780,42 @@ pbs_python_run_code_in_namespace(struct python_interpreter_data *interp_data,
 
 		if (!(py_script->py_code_obj =
 			_pbs_python_compile_file(py_script->path,
-			"<embedded code object>"))) {
+			"<embedded code object>",
+			py_script->cache_bytecode))) {
 			pbs_python_write_error_to_log("Failed to compile script");
 			return -2;
 		}
 	}
 
-	/* make new namespace dictionary, NOTE new reference */
+	if (py_script->keep_globals && py_script->global_dict && !recompile &&
+		(py_script->restart_count == pbs_python_restart_count)) {
+		/*
+		 * persistent namespace, only kept while the code is unchanged
+		 * and the interpreter that created it is still running
+		 */
+		pdict = (PyObject *)py_script->global_dict;
+	} else {
+		/* make new namespace dictionary, NOTE new reference */
 
-	if (!(pdict = (PyObject *)pbs_python_ext_namespace_init(interp_data))) {
-		log_err(-1, __func__, "while calling pbs_python_ext_namespace_init");
-		return -1;
-	}
-	if ((pbs_python_setup_namespace_dict(pdict) == -1)) {
-		Py_CLEAR(pdict);
-		return -1;
-	}
+		if (!(pdict = (PyObject *)pbs_python_ext_namespace_init(interp_data))) {
+			log_err(-1, __func__, "while calling pbs_python_ext_namespace_init");
+			return -1;
+		}
+		if ((pbs_python_setup_namespace_dict(pdict) == -1)) {
+			Py_CLEAR(pdict);
+			return -1;
+		}
 
-	/* clear previous global/local dictionary */
-	if (py_script->global_dict) {
-		PyDict_Clear((PyObject *)py_script->global_dict); /* clear k,v */
-		Py_CLEAR(py_script->global_dict);
-	}
+		/* clear previous global/local dictionary */
+		if (py_script->global_dict) {
+			PyDict_Clear((PyObject *)py_script->global_dict); /* clear k,v */
+			Py_CLEAR(py_script->global_dict);
+		}
 
-	py_script->global_dict = pdict;
+		py_script->global_dict = pdict;
+		py_script->restart_count = pbs_python_restart_count;
+		py_script->runs_counted = 0;
+	}
 
 	orig_pid = getpid();
 
@@ -785,6 +828,11 @@ pbs_python_run_code_in_namespace(struct python_interpreter_data *interp_data,
 	if (orig_pid != getpid())
 		exit(0);
 
+	/* charge what the run kept to this script, keeping any exception */
+	PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+	_pbs_python_script_account(py_script);
+	PyErr_Restore(ptype, pvalue, ptraceback);
+
 	/* check for exception */
 	if (PyErr_Occurred()) {
 		if (PyErr_ExceptionMatches(PyExc_KeyboardInterrupt)) {
@@ -836,12 +884,149 @@ pbs_python_run_code_in_namespace(struct python_interpreter_data *interp_data,
 
 #ifdef PYTHON               /*  === BEGIN ALL FUNCTIONS REQUIRING PYTHON HEADERS === */
 
+/**
+ * @brief
+ *	Return the 64-bit FNV-1a hash of a buffer.
+ *
+ * @param[in]	buf - data to hash
+ * @param[in]	len - number of bytes in buf
+ *
+ * @return	uint64_t
+ */
+static uint64_t
+_pbs_python_hash(const char *buf, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char)buf[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * @brief
+ *	Load the compiled code of a script from its bytecode file
+ *	(<script>PBS_PYTHON_BYTECODE_SUFFIX), provided the file was built
+ *	from the same script text by the same interpreter version.
+ *
+ * @param[in]	script_path - path of the script
+ * @param[in]	src_hash - hash of the current script text
+ * @param[in]	src_len - length of the current script text
+ *
+ * @return	PyObject *
+ * @retval	code object	new reference
+ * @retval	NULL		no usable bytecode file, no exception set
+ */
+static PyObject *
+_pbs_python_load_bytecode(const char *script_path, uint64_t src_hash,
+	size_t src_len)
+{
+	char path[MAXPATHLEN + 1];
+	struct pbs_python_bytecode_hdr hdr;
+	PyObject *code = NULL;
+	char *buf = NULL;
+	FILE *fp;
+
+	if (snprintf(path, sizeof(path), "%s%s", script_path,
+		PBS_PYTHON_BYTECODE_SUFFIX) >= (int)sizeof(path))
+		return NULL;
+	if ((fp = fopen(path, "rb")) == NULL)
+		return NULL;
+
+	if ((fread(&hdr, sizeof(hdr), 1, fp) != 1) ||
+		(hdr.magic != PBS_PYTHON_BYTECODE_MAGIC) ||
+		(hdr.py_magic != (uint32_t)PyImport_GetMagicNumber()) ||
+		(hdr.src_hash != src_hash) || (hdr.src_len != src_len) ||
+		(hdr.code_len == 0) || (hdr.code_len > PY_SSIZE_T_MAX))
+		goto done;
+
+	if ((buf = malloc(hdr.code_len)) == NULL)
+		goto done;
+	if (fread(buf, 1, hdr.code_len, fp) != hdr.code_len)
+		goto done;
+
+	code = PyMarshal_ReadObjectFromString(buf, (Py_ssize_t)hdr.code_len);
+	if (code == NULL)
+		PyErr_Clear();
+	else if (!PyCode_Check(code))
+		Py_CLEAR(code);
+
+done:
+	free(buf);
+	fclose(fp);
+	return code;
+}
+
+/**
+ * @brief
+ *	Save the compiled code of a script next to it, so that later runs,
+ *	including those in freshly forked children, skip the compilation.
+ *	The file is written under a temporary name and renamed into place
+ *	so concurrent readers never see a partial file. Failures are not
+ *	fatal, the script is simply compiled again next time.
+ *
+ * @param[in]	script_path - path of the script
+ * @param[in]	src_hash - hash of the script text
+ * @param[in]	src_len - length of the script text
+ * @param[in]	code - compiled code of the script
+ *
+ * @return	void
+ */
+static void
+_pbs_python_save_bytecode(const char *script_path, uint64_t src_hash,
+	size_t src_len, PyObject *code)
+{
+	char path[MAXPATHLEN + 1];
+	char tmp_path[MAXPATHLEN + 1 + 12];	/* path + "." + pid */
+	struct pbs_python_bytecode_hdr hdr;
+	PyObject *data;
+	int fd;
+	int ok = 0;
+
+	if ((data = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION)) == NULL) {
+		PyErr_Clear();
+		return;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = PBS_PYTHON_BYTECODE_MAGIC;
+	hdr.py_magic = (uint32_t)PyImport_GetMagicNumber();
+	hdr.src_hash = src_hash;
+	hdr.src_len = src_len;
+	hdr.code_len = PyBytes_GET_SIZE(data);
+
+	if (snprintf(path, sizeof(path), "%s%s", script_path,
+		PBS_PYTHON_BYTECODE_SUFFIX) >= (int)sizeof(path)) {
+		Py_DECREF(data);
+		return;
+	}
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+	/* readable by whoever may run the script, e.g. the job owner */
+	if ((fd = open(tmp_path, O_WRONLY|O_CREAT|O_TRUNC, 0644)) != -1) {
+		if ((write(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) &&
+			(write(fd, PyBytes_AS_STRING(data), hdr.code_len) ==
+			(ssize_t)hdr.code_len))
+			ok = 1;
+		if (close(fd) != 0)
+			ok = 0;
+		if (!ok || (rename(tmp_path, path) != 0)) {
+			log_err(errno, __func__, path);
+			(void)unlink(tmp_path);
+		}
+	}
+	Py_DECREF(data);
+}
+
 /**
  * @brief
  *	only compile the python script.
  *
  * @param[in]	file_name - abs file name
  * @param[out]  compiled_code_file_name - compiled file
+ * @param[in]	use_cache - reuse and refresh the bytecode file of the script
  *
  * @return	object
  * @retval
@@ -850,7 +1035,7 @@ pbs_python_run_code_in_namespace(struct python_interpreter_data *interp_data,
  */
 static PyObject *
 _pbs_python_compile_file(const char *file_name,
-	const char *compiled_code_file_name)
+	const char *compiled_code_file_name, int use_cache)
 {
 	FILE *fp = NULL;
 
@@ -859,6 +1044,7 @@ _pbs_python_compile_file(const char *file_name,
 	char *file_buffer = NULL; /* buffer to hold the python script file */
 	char *cp = NULL; /* useful character pointer */
 	PyObject *rv = NULL;
+	uint64_t src_hash = 0;
 
 	fp = fopen(file_name, "rb");
 	if (!fp) {
@@ -923,8 +1109,18 @@ _pbs_python_compile_file(const char *file_name,
 	}
 
 	fclose(fp);
-	/* compile the string to a code object,NEW reference caller must DECREF */
-	rv = Py_CompileString(file_buffer, compiled_code_file_name, Py_file_input);
+	fp = NULL;
+
+	if (use_cache) {
+		src_hash = _pbs_python_hash(file_buffer, file_sz);
+		rv = _pbs_python_load_bytecode(file_name, src_hash, file_sz);
+	}
+	if (rv == NULL) {
+		/* compile the string to a code object,NEW reference caller must DECREF */
+		rv = Py_CompileString(file_buffer, compiled_code_file_name, Py_file_input);
+		if ((rv != NULL) && use_cache)
+			_pbs_python_save_bytecode(file_name, src_hash, file_sz, rv);
+	}
 	PyMem_Free(file_buffer);
 	return rv;
 
@@ -936,5 +1132,237 @@ ERROR_EXIT:
 	return rv;
 }
 
+/**
+ * @brief
+ *	Tell whether the globals() of a script should be kept between runs,
+ *	as requested by the pbs.conf setting PBS_PYTHON_PERSIST_HOOKS, a comma
+ *	separated list of hook names or "all". Scripts are matched by their
+ *	file name without directory and suffix, i.e. the hook name.
+ *
+ * @param[in]	script_path - path of the script
+ *
+ * @return	int
+ * @retval	1	keep globals
+ * @retval	0	start each run with fresh globals
+ */
+static int
+_pbs_python_keep_globals(const char *script_path)
+{
+	char *hooks;
+	char *copy;
+	char *tok;
+	char *save = NULL;
+	const char *name;
+	const char *dot;
+	size_t len;
+	int keep = 0;
+
+	if (((hooks = pbs_conf.pbs_python_persist_hooks) == NULL) ||
+		(*hooks == '\0'))
+		return 0;
+	if (strcmp(hooks, "all") == 0)
+		return 1;
+
+	name = strrchr(script_path, '/');
+	name = (name != NULL) ? (name + 1) : script_path;
+	dot = strrchr(name, '.');
+	len = (dot != NULL) ? (size_t)(dot - name) : strlen(name);
+
+	if ((copy = strdup(hooks)) == NULL)
+		return 0;
+	for (tok = strtok_r(copy, ", ", &save); tok != NULL;
+		tok = strtok_r(NULL, ", ", &save)) {
+		if ((strlen(tok) == len) && (strncmp(tok, name, len) == 0)) {
+			keep = 1;
+			break;
+		}
+	}
+	free(copy);
+	return keep;
+}
+
+/* state of a walk over the objects reachable from a script's globals */
+struct script_walk {
+	PyObject *globals;	/* the script's globals() */
+	PyObject *seen;		/* addresses of the objects already reached */
+	PyObject *todo;		/* objects reached but not yet visited */
+};
+
+/**
+ * @brief
+ *	visitproc for _pbs_python_script_size(): queue an object referred to
+ *	by the one being visited, unless it was reached before.
+ *
+ * @param[in]	obj - referred object
+ * @param[in]	arg - struct script_walk of the walk
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	out of memory, with a Python exception set
+ */
+static int
+_pbs_python_script_walk_visit(PyObject *obj, void *arg)
+{
+	struct script_walk *walk = arg;
+	PyObject *addr;
+	int rc;
+
+	if (obj == NULL)
+		return 0;
+	if ((addr = PyLong_FromVoidPtr(obj)) == NULL)
+		return -1;
+	if ((rc = PySet_Contains(walk->seen, addr)) == 0) {
+		if ((rc = PySet_Add(walk->seen, addr)) == 0)
+			rc = PyList_Append(walk->todo, obj);
+	} else if (rc == 1) {
+		rc = 0;
+	}
+	Py_DECREF(addr);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Tell whether the walk should look inside an object. Modules, types
+ *	and the functions of other modules are shared with the rest of the
+ *	interpreter, so they are counted but not charged with what they
+ *	refer to.
+ *
+ * @param[in]	walk - walk in progress
+ * @param[in]	obj - object being visited
+ *
+ * @return	int
+ * @retval	1	visit what obj refers to
+ * @retval	0	stop at obj
+ */
+static int
+_pbs_python_script_walk_into(struct script_walk *walk, PyObject *obj)
+{
+	if (PyModule_Check(obj) || PyType_Check(obj) || PyCFunction_Check(obj))
+		return 0;
+	if (PyFunction_Check(obj) &&
+		(PyFunction_GET_GLOBALS(obj) != walk->globals))
+		return 0;
+	return (PyObject_IS_GC(obj) && (Py_TYPE(obj)->tp_traverse != NULL));
+}
+
+/**
+ * @brief
+ *	Count the objects a script keeps reachable from its globals(), i.e.
+ *	the memory that is its own rather than the interpreter's, the
+ *	modules' or another hook's. The walk stops once limit is reached.
+ *
+ * @param[in]	globals - globals() of the script
+ * @param[in]	limit - count at which to stop
+ *
+ * @return	Py_ssize_t
+ * @retval	>=0	number of objects, at most limit
+ * @retval	-1	the objects could not be counted
+ */
+static Py_ssize_t
+_pbs_python_script_size(PyObject *globals, Py_ssize_t limit)
+{
+	struct script_walk walk;
+	PyObject *builtins;
+	PyObject *obj;
+	Py_ssize_t count = 0;
+	Py_ssize_t n;
+	int rc = 0;
+
+	walk.globals = globals;
+	walk.seen = PySet_New(NULL);
+	walk.todo = PyList_New(0);
+	if ((walk.seen == NULL) || (walk.todo == NULL))
+		goto err;
+
+	/* the builtins are everybody's, mark them as already reached */
+	builtins = PyDict_GetItemString(globals, "__builtins__"); /* borrowed */
+	if ((builtins != NULL) &&
+		(_pbs_python_script_walk_visit(builtins, &walk) == -1))
+		goto err;
+	if (PyList_SetSlice(walk.todo, 0, PyList_GET_SIZE(walk.todo), NULL) == -1)
+		goto err;
+
+	if (_pbs_python_script_walk_visit(globals, &walk) == -1)
+		goto err;
+	while (((n = PyList_GET_SIZE(walk.todo)) > 0) && (count < limit)) {
+		obj = PyList_GET_ITEM(walk.todo, n - 1);
+		Py_INCREF(obj);
+		if (PyList_SetSlice(walk.todo, n - 1, n, NULL) == -1) {
+			Py_DECREF(obj);
+			goto err;
+		}
+		count++;
+		if (_pbs_python_script_walk_into(&walk, obj))
+			rc = Py_TYPE(obj)->tp_traverse(obj,
+				_pbs_python_script_walk_visit, &walk);
+		Py_DECREF(obj);
+		if (rc != 0)
+			goto err;
+	}
+	Py_DECREF(walk.seen);
+	Py_DECREF(walk.todo);
+	return count;
+
+err:
+	PyErr_Clear();
+	Py_XDECREF(walk.seen);
+	Py_XDECREF(walk.todo);
+	return -1;
+}
+
+/**
+ * @brief
+ *	Charge a script with the objects its globals() still hold after a
+ *	run. Once the script holds more than PBS_PYTHON_HOOK_MAX_BLOCKS of
+ *	them, its namespace and compiled code are released so that only
+ *	this script pays for the cleanup, instead of restarting the whole
+ *	interpreter. The modules it imported stay in sys.modules, as they
+ *	may be shared with the server and with other hooks.
+ *
+ *	Only persistent namespaces (PBS_PYTHON_PERSIST_HOOKS) are charged,
+ *	any other is replaced on the next run anyway, and only on the runs
+ *	picked by PBS_PYTHON_ACCOUNT_INTERVAL.
+ *
+ * @param[in]	py_script - script that just ran
+ *
+ * @return	void
+ */
+static void
+_pbs_python_script_account(struct python_script *py_script)
+{
+	Py_ssize_t max_blocks;
+	Py_ssize_t held;
+
+	if (!py_script->keep_globals || (py_script->global_dict == NULL))
+		return;
+	if ((py_script->runs_counted++ % PBS_PYTHON_ACCOUNT_INTERVAL) != 0)
+		return;
+	if (pbs_conf.pbs_python_hook_max_blocks > 0)
+		max_blocks = pbs_conf.pbs_python_hook_max_blocks;
+	else
+		max_blocks = PBS_PYTHON_HOOK_MAX_BLOCKS;
+
+	held = _pbs_python_script_size((PyObject *)py_script->global_dict,
+		max_blocks);
+	if (held < 0)
+		return;
+	py_script->blocks_held = (long)held;
+	if (held < max_blocks)
+		return;
+
+	snprintf(log_buffer, LOG_BUF_SIZE-1,
+		"%s holds %ld or more objects, recycling it",
+		py_script->path, py_script->blocks_held);
+	log_buffer[LOG_BUF_SIZE-1] = '\0';
+	log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_HOOK, LOG_INFO,
+		__func__, log_buffer);
+
+	PyDict_Clear((PyObject *)py_script->global_dict);
+	Py_CLEAR(py_script->global_dict);
+	Py_CLEAR(py_script->py_code_obj); /* forces a recompile on next run */
+	(void)PyGC_Collect();
+	py_script->blocks_held = 0;
+}
 
 #endif /* PYTHON */
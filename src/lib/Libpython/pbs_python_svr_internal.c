@@ -288,14 +288,19 @@ static int      hook_scheduler_restart_cycle = FALSE; 	/* flag to tell local */
  * types (e.g. string, dict, etc.), but the PBS types are
  * not created such that their memory can be released.
  */
-/* Max hook events to service before restarting the interpreter */
-#define PBS_PYTHON_RESTART_MAX_HOOKS 100
+/*
+ * Memory held by the hook scripts themselves is reclaimed per hook (see
+ * pbs_python_run_code_in_namespace), so the hook count only restarts the
+ * interpreter when python_restart_max_hooks is explicitly set.
+ */
 /* Max objects created before restarting the interpreter */
 #define PBS_PYTHON_RESTART_MAX_OBJECTS 1000
 /* Minimum interval between interpreter restarts */
 #define PBS_PYTHON_RESTART_MIN_INTERVAL 30
 /* count of Python objects created */
 static long	object_counter = 0;
+/* count of interpreter restarts, for hook profiling */
+unsigned long	pbs_python_restart_count = 0;
 
 typedef struct hook_debug_t {
 	FILE	*input_fp;
@@ -1972,6 +1977,52 @@ py_resource_string_value(pbs_resource_value *resc_val)
  * ---------- ATTRIBUTE CONVERSION HELPER METHODS ------------
  */
 
+/**
+ * @brief
+ *	Returns the dictionary of attribute values of 'py_instance' that were
+ *	loaded from PBS but not yet converted to their Python type.  Plain
+ *	attribute values are stored there as strings, and the Python
+ *	PbsAttributeDescriptor converts one on first access, so a hook only
+ *	pays for the attributes it actually reads.  The dictionary lives in
+ *	the instance's own __dict__ and goes away with it.
+ *
+ * @param[in] py_instance - Python object
+ * @param[in] create - create the dictionary if not there yet
+ *
+ * @return	PyObject *
+ * @retval	borrowed reference to the dictionary
+ * @retval	NULL if none, or it could not be created
+ */
+static PyObject *
+pbs_python_lazy_attributes(PyObject *py_instance, int create)
+{
+	PyObject *py_dict;
+	PyObject *py_lazy;
+
+	py_dict = PyObject_GetAttrString(py_instance, "__dict__"); /* NEW */
+	if (py_dict == NULL) {
+		PyErr_Clear();
+		return NULL;
+	}
+	if (!PyDict_Check(py_dict)) {
+		Py_DECREF(py_dict);
+		return NULL;
+	}
+	py_lazy = PyDict_GetItemString(py_dict, PY_ATTRIBUTES_LAZY); /* borrowed */
+	if ((py_lazy == NULL) && create) {
+		py_lazy = PyDict_New(); /* NEW */
+		if (py_lazy != NULL) {
+			if (PyDict_SetItemString(py_dict, PY_ATTRIBUTES_LAZY, py_lazy) == -1) {
+				pbs_python_write_error_to_log(__func__);
+				Py_CLEAR(py_lazy);
+			} else
+				Py_DECREF(py_lazy); /* now owned by the instance */
+		}
+	}
+	Py_DECREF(py_dict);
+	return py_lazy;
+}
+
 /**
  * @brief
  *
@@ -2021,8 +2072,10 @@ pbs_python_populate_attributes_to_python_class(PyObject *py_instance,
 	char *value_str = NULL;
 	char *new_value_str = NULL;
 	pbs_resource_value *resc_val;
+	PyObject *py_lazy = NULL; /* values converted on first access */
 
 	hook_perf_stat_start(perf_label, perf_action, 0);
+	py_lazy = pbs_python_lazy_attributes(py_instance, TRUE);
 	for (i = 0; i < attr_def_array_size; i++) {
 		attr_p = attr_data_array + i;
 		attr_def_p = attr_def_array + i;
@@ -2206,9 +2259,14 @@ pbs_python_populate_attributes_to_python_class(PyObject *py_instance,
 					} /* while */
 
 				} else {
-					rc = pbs_python_object_set_attr_string_value(py_instance,
-						attr_def_p->at_name,
-						svrattr_val->al_value);
+					if (py_lazy != NULL)
+						rc = pbs_python_dict_set_item_string_value(py_lazy,
+							attr_def_p->at_name,
+							svrattr_val->al_value);
+					else
+						rc = pbs_python_object_set_attr_string_value(py_instance,
+							attr_def_p->at_name,
+							svrattr_val->al_value);
 
 					if ((rc != -1) && (hook_debug.data_fp != NULL)) {
 						fprintf(hook_debug.data_fp, "%s.%s=%s\n", (char *)hook_debug.objname,
@@ -2630,6 +2688,7 @@ pbs_python_populate_svrattrl_from_python_class(PyObject *py_instance,
 	static char     *the_val = NULL;
 	static int 	val_buf_size = HOOK_BUF_SIZE;
 	PyObject	*py_resc = NULL;
+	PyObject	*py_lazy = NULL;
 	long		val_sec;
 	char		*objname = NULL;
 
@@ -2724,6 +2783,7 @@ pbs_python_populate_svrattrl_from_python_class(PyObject *py_instance,
 		Py_CLEAR(py_val);
 	}
 
+	py_lazy = pbs_python_lazy_attributes(py_instance, FALSE);
 	num_attrs = PyList_Size(py_attr_keys);
 
 	if (!append) {
@@ -2766,7 +2826,13 @@ pbs_python_populate_svrattrl_from_python_class(PyObject *py_instance,
 			continue;
 		}
 
-		py_val = PyObject_GetAttrString(py_instance, name_str);
+		/* a value never accessed by the hook is still in its */
+		/* original string form, so send that back as is      */
+		if ((py_lazy != NULL) &&
+			((py_val = PyDict_GetItemString(py_lazy, name_str)) != NULL))
+			Py_INCREF(py_val);
+		else
+			py_val = PyObject_GetAttrString(py_instance, name_str);
 		/* must be Py_CLEAR(-)ed or
 		 * Py_DECREF()-ed later, so as to not leak memory
 		 */
@@ -3136,6 +3202,7 @@ pbs_python_mark_object_readonly(PyObject *py_instance)
 	PyObject	*py_attr_dict = NULL;
 	PyObject	*py_attr_keys = NULL;
 	PyObject 	*py_val = NULL;
+	PyObject	*py_lazy = NULL;
 	int		num_attrs, i;
 	int         rc = -1;
 
@@ -3198,6 +3265,7 @@ pbs_python_mark_object_readonly(PyObject *py_instance)
 		goto mark_readonly_exit;
 	}
 
+	py_lazy = pbs_python_lazy_attributes(py_instance, FALSE);
 	num_attrs = PyList_Size(py_attr_keys);
 	for (i=0; i < num_attrs; i++) {
 		char	 *name_str = NULL;
@@ -3207,6 +3275,11 @@ pbs_python_mark_object_readonly(PyObject *py_instance)
 		if (!name_str || (name_str[0] == '\0'))
 			continue;
 
+		/* not yet loaded, hence not a resource list either */
+		if ((py_lazy != NULL) &&
+			(PyDict_GetItemString(py_lazy, name_str) != NULL))
+			continue;
+
 		if (!PyObject_HasAttrString(py_instance, name_str))
 			continue;
 
@@ -5206,7 +5279,7 @@ _pbs_python_event_set(unsigned int hook_event, char *req_user, char *req_host,
 	if (is_sattr_set(SVR_ATR_PythonRestartMaxHooks))
 		max_hooks = get_sattr_long(SVR_ATR_PythonRestartMaxHooks);
 	else
-		max_hooks = PBS_PYTHON_RESTART_MAX_HOOKS;
+		max_hooks = 0;
 	if (lval != max_hooks) {
 		snprintf(log_buffer, sizeof(log_buffer),
 			"python_restart_max_hooks is now %ld", max_hooks);
@@ -5237,7 +5310,7 @@ _pbs_python_event_set(unsigned int hook_event, char *req_user, char *req_host,
 
 	hook_counter++;
 	restart_python = 0;
-	if (hook_counter >= max_hooks)
+	if ((max_hooks > 0) && (hook_counter >= max_hooks))
 		restart_python = 1;
 	if (object_counter >= max_objects)
 		restart_python = 1;
@@ -5252,6 +5325,7 @@ _pbs_python_event_set(unsigned int hook_event, char *req_user, char *req_host,
 			log_err(PBSE_INTERNAL, __func__, "Failed to restart Python interpreter");
 			goto event_set_exit;
 		}
+		pbs_python_restart_count++;
 		/* Reset counters for the next interpreter restart. */
 		hook_counter = 0;
 		object_counter = 0;
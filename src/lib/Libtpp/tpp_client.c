@@ -373,6 +373,7 @@ leaf_send_ctl_join(int tfd, void *c)
 	tpp_context_t *ctx = (tpp_context_t *) c;
 	tpp_router_t *r;
 	tpp_join_pkt_hdr_t *hdr = NULL;
+	tpp_join_ext_t *ext = NULL;
 	tpp_packet_t *pkt = NULL;
 	int len;
 	int i;
@@ -408,6 +409,14 @@ leaf_send_ctl_join(int tfd, void *c)
 			return -1;
 		}
 
+		/* tell pbs_comm which codecs we can decompress */
+		if (!tpp_bld_pkt(pkt, NULL, sizeof(tpp_join_ext_t), 1, (void **) &ext)) {
+			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+			return -1;
+		}
+		memcpy(ext->magic, TPP_JOIN_EXT_MAGIC, sizeof(ext->magic));
+		ext->codecs = tpp_codecs_supported();
+
 		if (tpp_transport_vsend(r->conn_fd, pkt) != 0) { /* this has to go irrespective of router state being down */
 			tpp_log(LOG_CRIT, __func__, "tpp_transport_vsend failed, err=%d", errno);
 			return -1;
@@ -921,13 +930,12 @@ tpp_send(int sd, void *data, int len)
 		return -1;
 	}
 
-	if ((tpp_conf->compress == 1) && (len > TPP_COMPR_SIZE)) {
-		data_dup = tpp_deflate(data, len, &to_send); /* creates a copy */
-		if (data_dup == NULL) {
-			tpp_log(LOG_CRIT, __func__, "tpp deflate failed");
-			return -1;
-		}
-	} else {
+	data_dup = NULL;
+	if ((tpp_conf->compress == 1) && (len > tpp_conf->compr_min_size)) {
+		/* creates a copy, or nothing if not worth sending compressed */
+		data_dup = tpp_compress(tpp_conf->codec, data, len, &to_send);
+	}
+	if (data_dup == NULL) {
 		data_dup = malloc(len);
 		if (!data_dup) {
 			tpp_log(errno, __func__, "Failed to duplicate data");
@@ -1875,8 +1883,8 @@ tpp_mcast_send(int mtfd, void *data, unsigned int to_send, unsigned int len)
 	mhdr->num_streams = htonl(num_fds);
 	mhdr->info_len = htonl(minfo_len);
 
-	if (tpp_conf->compress == 1 && minfo_len > TPP_COMPR_SIZE) {
-		def_ctx = tpp_multi_deflate_init(minfo_len);
+	if (tpp_conf->compress == 1 && minfo_len > tpp_conf->compr_min_size) {
+		def_ctx = tpp_multi_deflate_init(tpp_conf->codec, minfo_len);
 		if (def_ctx == NULL)
 			goto err;
 	} else {
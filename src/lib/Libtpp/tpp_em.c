@@ -75,6 +75,13 @@
 #ifdef HAVE_SYS_EVENTFD_H
 #include <sys/eventfd.h>
 #endif
+#if defined(PBS_USE_EPOLL) && defined(PBS_HAVE_IO_URING)
+#include <stdint.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
 
 /********************************** START OF MULTIPLEXING CODE *****************************************/
 /**
@@ -110,6 +117,736 @@ tpp_em_wait(void *em_ctx, em_event_t **ev_array, int timeout)
 /****************************************** Linux EPOLL ************************************************/
 
 #if defined(PBS_USE_EPOLL)
+#if defined(PBS_HAVE_IO_URING)
+/*
+ * io_uring variant of the epoll backend.
+ *
+ * Monitored descriptors are armed with one-shot IORING_OP_POLL_ADD requests.
+ * Completed polls are re-armed at the start of the next wait, so the
+ * level-triggered behaviour of epoll is preserved, while all the arming and
+ * disarming requests queued since the last wait are submitted in the same
+ * io_uring_enter() call that waits for completions. This folds the
+ * epoll_ctl() calls that the transport makes on every EM_OUT toggle into
+ * the wait itself.
+ *
+ * Every poll carries the fd and a generation number in its user_data, so
+ * completions of polls that were removed or replaced are recognized and
+ * dropped. Removal requests carry a user_data of zero.
+ *
+ * Each removal adds two completions, so a caller changing many fds between
+ * waits can fill up the completion queue. Whenever requests have to be
+ * submitted outside a wait, the completions are first reaped into a list
+ * of ready fds, which the next wait returns.
+ *
+ * The backend is used when PBS_EVENT_BACKEND=io_uring is set in the
+ * environment and the kernel supports it, else epoll is used.
+ */
+#define PBS_EVENT_BACKEND "PBS_EVENT_BACKEND" /* set to io_uring to use io_uring */
+#define URING_MIN_ENTRIES	64
+#define URING_MAX_ENTRIES	4096
+#define URING_UDATA(fd, gen)	(((unsigned long long) (gen) << 32) | (unsigned int) (fd))
+#define URING_UDATA_FD(ud)	((int) ((ud) & 0xffffffff))
+#define URING_UDATA_GEN(ud)	((unsigned int) ((ud) >> 32))
+
+typedef struct {
+	int mask;		/* events monitored for, 0 if fd is not monitored */
+	int revents;		/* events reaped, not returned yet */
+	unsigned int gen;	/* generation of the current poll request */
+	char armed;		/* a poll request is outstanding in the kernel */
+	char queued;		/* fd is on the rearm list */
+	char ready;		/* fd is on the ready list */
+} uring_fd_t;
+
+struct tpp_uring {
+	int ring_fd;
+	pthread_mutex_t lock;
+
+	/* submission queue */
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_entries;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+
+	/* completion queue */
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+
+	uring_fd_t *fds;	/* per fd state, indexed by fd */
+	int fds_sz;
+	int *rearm;		/* fds whose poll has to be (re)armed */
+	int rearm_cnt;
+	int *ready;		/* fds with reaped events */
+	int ready_cnt;
+	unsigned int gen;
+};
+
+/**
+ * @brief
+ *	Find out whether io_uring was asked for in the environment
+ *
+ * @return	int
+ * @retval	1 - io_uring requested
+ * @retval	0 - use the default backend
+ *
+ * @par MT-safe: yes
+ *
+ */
+static int
+uring_requested(void)
+{
+	char *p = getenv(PBS_EVENT_BACKEND);
+
+	return (p && strcasecmp(p, "io_uring") == 0);
+}
+
+/**
+ * @brief
+ *	Helper to enter the ring, submitting and/or waiting for completions
+ *
+ * @param[in] u - the ring
+ * @param[in] to_submit - number of sqes to submit
+ * @param[in] min_complete - number of completions to wait for
+ * @param[in] timeout - timeout in milliseconds, -1 to wait forever
+ * @param[in] sigmask - signal mask to apply while waiting, may be NULL
+ *
+ * @return	result of io_uring_enter
+ *
+ * @par MT-safe: yes
+ *
+ */
+static int
+uring_enter(struct tpp_uring *u, unsigned int to_submit, unsigned int min_complete, int timeout, const sigset_t *sigmask)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned int flags = 0;
+
+	memset(&arg, 0, sizeof(arg));
+	if (min_complete > 0 || timeout == 0) {
+		flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		if (timeout >= 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000L;
+			arg.ts = (unsigned long long) (uintptr_t) &ts;
+		}
+		if (sigmask) {
+			arg.sigmask = (unsigned long long) (uintptr_t) sigmask;
+			arg.sigmask_sz = _NSIG / 8;
+		}
+		return syscall(__NR_io_uring_enter, u->ring_fd, to_submit, min_complete, flags, &arg, sizeof(arg));
+	}
+	return syscall(__NR_io_uring_enter, u->ring_fd, to_submit, 0, 0, NULL, 0);
+}
+
+static void uring_queue_arm(struct tpp_uring *u, int fd);
+
+/**
+ * @brief
+ *	Move all completions from the completion queue to the ready list.
+ *	Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ *
+ * @par MT-safe: no
+ *
+ */
+static void
+uring_reap(struct tpp_uring *u)
+{
+	struct io_uring_cqe *cqe;
+	unsigned int head;
+	unsigned int tail;
+	unsigned long long ud;
+	uring_fd_t *f;
+	int fd;
+
+	head = *u->cq_head;
+	tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		cqe = &u->cqes[head & *u->cq_mask];
+		head++;
+
+		ud = cqe->user_data;
+		if (ud == 0)
+			continue; /* result of a poll removal */
+
+		fd = URING_UDATA_FD(ud);
+		if (fd >= u->fds_sz)
+			continue;
+		f = &u->fds[fd];
+		if (f->mask == 0 || f->gen != URING_UDATA_GEN(ud))
+			continue; /* poll that was removed or replaced */
+
+		f->armed = 0;
+		if (cqe->res < 0) {
+			if (cqe->res == -EBADF) {
+				/* fd was closed without being removed, like epoll forget it */
+				f->mask = 0;
+				f->gen = 0;
+			} else
+				uring_queue_arm(u, fd);
+			continue;
+		}
+
+		f->revents |= cqe->res;
+		if (!f->ready) {
+			f->ready = 1;
+			u->ready[u->ready_cnt++] = fd;
+		}
+
+		/* level triggered, poll again at the next wait */
+		uring_queue_arm(u, fd);
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief
+ *	Submit all queued requests to the kernel without waiting, reaping
+ *	completions first so that the completion queue has room for their
+ *	results. Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: no
+ *
+ */
+static int
+uring_submit(struct tpp_uring *u)
+{
+	unsigned int to_submit;
+
+	to_submit = *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+	if (to_submit == 0)
+		return 0;
+	uring_reap(u);
+	if (uring_enter(u, to_submit, 0, -1, NULL) < 0)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Get a free submission queue entry, pushing queued entries to the
+ *	kernel if the queue is full. Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ *
+ * @return	the sqe, to be committed with uring_commit_sqe
+ * @retval	NULL - no entry could be freed up
+ *
+ * @par MT-safe: no
+ *
+ */
+static struct io_uring_sqe *
+uring_get_sqe(struct tpp_uring *u)
+{
+	unsigned int head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+	unsigned int tail = *u->sq_tail;
+	unsigned int idx;
+	struct io_uring_sqe *sqe;
+
+	if (tail - head >= *u->sq_entries) {
+		if (uring_submit(u) != 0)
+			return NULL;
+		head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head >= *u->sq_entries) {
+			errno = EBUSY;
+			return NULL;
+		}
+	}
+	idx = tail & *u->sq_mask;
+	sqe = &u->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	u->sq_array[idx] = idx;
+	return sqe;
+}
+
+/**
+ * @brief
+ *	Make the sqe obtained from uring_get_sqe visible to the kernel
+ *
+ * @param[in] u - the ring
+ *
+ * @par MT-safe: no
+ *
+ */
+static void
+uring_commit_sqe(struct tpp_uring *u)
+{
+	__atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief
+ *	Queue a request to cancel the outstanding poll of a fd.
+ *	Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ * @param[in] fd - the fd
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: no
+ *
+ */
+static int
+uring_disarm(struct tpp_uring *u, int fd)
+{
+	struct io_uring_sqe *sqe;
+
+	if (!u->fds[fd].armed)
+		return 0;
+
+	if ((sqe = uring_get_sqe(u)) == NULL)
+		return -1;
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = URING_UDATA(fd, u->fds[fd].gen);
+	sqe->user_data = 0;
+	uring_commit_sqe(u);
+	u->fds[fd].armed = 0;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Put a fd on the list of polls to be armed at the next wait.
+ *	Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ * @param[in] fd - the fd
+ *
+ * @par MT-safe: no
+ *
+ */
+static void
+uring_queue_arm(struct tpp_uring *u, int fd)
+{
+	if (u->fds[fd].queued)
+		return;
+	u->fds[fd].queued = 1;
+	u->rearm[u->rearm_cnt++] = fd;
+}
+
+/**
+ * @brief
+ *	Submit poll requests for all fds on the rearm list.
+ *	Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: no
+ *
+ */
+static int
+uring_arm_queued(struct tpp_uring *u)
+{
+	struct io_uring_sqe *sqe;
+	uring_fd_t *f;
+	unsigned int mask;
+	int fd;
+
+	while (u->rearm_cnt > 0) {
+		fd = u->rearm[u->rearm_cnt - 1];
+		f = &u->fds[fd];
+		if (f->mask != 0 && !f->armed) {
+			if ((sqe = uring_get_sqe(u)) == NULL)
+				return -1;
+			mask = f->mask;
+#if __BYTE_ORDER == __BIG_ENDIAN
+			mask = (mask << 16) | (mask >> 16);
+#endif
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = fd;
+			sqe->poll32_events = mask;
+			sqe->user_data = URING_UDATA(fd, f->gen);
+			uring_commit_sqe(u);
+			f->armed = 1;
+		}
+		f->queued = 0;
+		u->rearm_cnt--;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Make sure the per fd state array can hold fd.
+ *	Called with the ring lock held.
+ *
+ * @param[in] u - the ring
+ * @param[in] fd - the fd
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: no
+ *
+ */
+static int
+uring_grow(struct tpp_uring *u, int fd)
+{
+	uring_fd_t *fds;
+	int *rearm;
+	int *ready;
+	int sz;
+
+	if (fd < u->fds_sz)
+		return 0;
+
+	sz = u->fds_sz * 2;
+	if (sz <= fd)
+		sz = fd + 1;
+
+	if ((fds = realloc(u->fds, sz * sizeof(uring_fd_t))) == NULL)
+		return -1;
+	memset(fds + u->fds_sz, 0, (sz - u->fds_sz) * sizeof(uring_fd_t));
+	u->fds = fds;
+
+	if ((rearm = realloc(u->rearm, sz * sizeof(int))) == NULL)
+		return -1;
+	u->rearm = rearm;
+
+	if ((ready = realloc(u->ready, sz * sizeof(int))) == NULL)
+		return -1;
+	u->ready = ready;
+	u->fds_sz = sz;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Destroy a ring created by uring_create
+ *
+ * @param[in] u - the ring
+ *
+ * @par MT-safe: no
+ *
+ */
+static void
+uring_destroy(struct tpp_uring *u)
+{
+	if (u->sqes && u->sqes != MAP_FAILED)
+		munmap(u->sqes, u->sqes_sz);
+	if (u->cq_ring && u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring)
+		munmap(u->cq_ring, u->cq_ring_sz);
+	if (u->sq_ring && u->sq_ring != MAP_FAILED)
+		munmap(u->sq_ring, u->sq_ring_sz);
+	if (u->ring_fd != -1)
+		close(u->ring_fd);
+	pthread_mutex_destroy(&u->lock);
+	free(u->fds);
+	free(u->rearm);
+	free(u->ready);
+	free(u);
+}
+
+/**
+ * @brief
+ *	Set up an io_uring instance sized for max_events monitored fds
+ *
+ * @param[in] max_events - max events that needs to be handled
+ *
+ * @return	the ring
+ * @retval	NULL - io_uring is not usable, caller should use epoll
+ *
+ * @par MT-safe: yes
+ *
+ */
+static struct tpp_uring *
+uring_create(int max_events)
+{
+	struct tpp_uring *u;
+	struct io_uring_params p;
+	unsigned int entries;
+
+	if ((u = calloc(1, sizeof(struct tpp_uring))) == NULL)
+		return NULL;
+	u->ring_fd = -1;
+	pthread_mutex_init(&u->lock, NULL);
+
+	entries = URING_MIN_ENTRIES;
+	while (entries < (unsigned int) max_events && entries < URING_MAX_ENTRIES)
+		entries <<= 1;
+
+	/*
+	 * each fd can have a poll completion and a cancelled poll completion
+	 * outstanding, size the completion queue so it does not overflow
+	 */
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+	p.cq_entries = entries * 4;
+
+	u->ring_fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (u->ring_fd == -1)
+		goto err;
+	tpp_set_close_on_exec(u->ring_fd);
+
+	/* need timeouts and signal masks on the wait, and no dropped completions */
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+		errno = ENOSYS;
+		goto err;
+	}
+
+	u->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	u->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_ring_sz > u->sq_ring_sz)
+			u->sq_ring_sz = u->cq_ring_sz;
+		u->cq_ring_sz = u->sq_ring_sz;
+	}
+
+	u->sq_ring = mmap(NULL, u->sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+	if (u->sq_ring == MAP_FAILED)
+		goto err;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		u->cq_ring = u->sq_ring;
+	else {
+		u->cq_ring = mmap(NULL, u->cq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+		if (u->cq_ring == MAP_FAILED)
+			goto err;
+	}
+
+	u->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED)
+		goto err;
+
+	u->sq_head = (unsigned int *) ((char *) u->sq_ring + p.sq_off.head);
+	u->sq_tail = (unsigned int *) ((char *) u->sq_ring + p.sq_off.tail);
+	u->sq_mask = (unsigned int *) ((char *) u->sq_ring + p.sq_off.ring_mask);
+	u->sq_entries = (unsigned int *) ((char *) u->sq_ring + p.sq_off.ring_entries);
+	u->sq_array = (unsigned int *) ((char *) u->sq_ring + p.sq_off.array);
+	u->cq_head = (unsigned int *) ((char *) u->cq_ring + p.cq_off.head);
+	u->cq_tail = (unsigned int *) ((char *) u->cq_ring + p.cq_off.tail);
+	u->cq_mask = (unsigned int *) ((char *) u->cq_ring + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *) ((char *) u->cq_ring + p.cq_off.cqes);
+
+	if (uring_grow(u, max_events > 0 ? max_events : 1) != 0)
+		goto err;
+
+	return u;
+
+err:
+	tpp_log(LOG_WARNING, __func__, "io_uring not usable, errno=%d, falling back to epoll", errno);
+	uring_destroy(u);
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Start monitoring a fd on the ring
+ *
+ * @param[in] u - the ring
+ * @param[in] fd - the fd
+ * @param[in] event_mask - events to monitor
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: yes
+ *
+ */
+static int
+uring_add_fd(struct tpp_uring *u, int fd, int event_mask)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&u->lock);
+	if (uring_grow(u, fd) != 0)
+		rc = -1;
+	else if (u->fds[fd].mask != 0) {
+		errno = EEXIST;
+		rc = -1;
+	} else {
+		if (++u->gen == 0)
+			++u->gen;
+		u->fds[fd].gen = u->gen;
+		u->fds[fd].mask = event_mask;
+		uring_queue_arm(u, fd);
+	}
+	pthread_mutex_unlock(&u->lock);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Change the events a fd is monitored for on the ring
+ *
+ * @param[in] u - the ring
+ * @param[in] fd - the fd
+ * @param[in] event_mask - events to monitor
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: yes
+ *
+ */
+static int
+uring_mod_fd(struct tpp_uring *u, int fd, int event_mask)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&u->lock);
+	if (fd >= u->fds_sz || u->fds[fd].mask == 0) {
+		errno = ENOENT;
+		rc = -1;
+	} else if (u->fds[fd].mask != event_mask) {
+		if (uring_disarm(u, fd) != 0)
+			rc = -1;
+		else {
+			if (++u->gen == 0)
+				++u->gen;
+			u->fds[fd].gen = u->gen;
+			u->fds[fd].mask = event_mask;
+			uring_queue_arm(u, fd);
+		}
+	}
+	pthread_mutex_unlock(&u->lock);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Stop monitoring a fd on the ring
+ *
+ *	Unlike adds and mods, the removal is submitted right away. An armed
+ *	poll holds a reference to the file, so if it was left for the next
+ *	wait, closing the fd after this call would not close the socket
+ *	until then.
+ *
+ * @param[in] u - the ring
+ * @param[in] fd - the fd
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ *
+ * @par MT-safe: yes
+ *
+ */
+static int
+uring_del_fd(struct tpp_uring *u, int fd)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&u->lock);
+	if (fd >= u->fds_sz || u->fds[fd].mask == 0) {
+		errno = ENOENT;
+		rc = -1;
+	} else {
+		rc = uring_disarm(u, fd);
+		u->fds[fd].mask = 0;
+		u->fds[fd].gen = 0;
+		u->fds[fd].revents = 0;
+		if (rc == 0)
+			rc = uring_submit(u);
+	}
+	pthread_mutex_unlock(&u->lock);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Arm pending polls and wait for completions on the ring, converting
+ *	them into epoll style events
+ *
+ * @param[in] u - the ring
+ * @param[out] events - array to fill
+ * @param[in] max_events - size of the events array
+ * @param[in] timeout - timeout in milliseconds, -1 to wait forever
+ * @param[in] sigmask - signal mask to apply while waiting, may be NULL
+ *
+ * @return	Number of events returned
+ * @retval -1	Failure
+ * @retval  0	Timeout
+ * @retval >0   Success (some events occured)
+ *
+ * @par MT-safe: yes
+ *
+ */
+static int
+uring_wait(struct tpp_uring *u, em_event_t *events, int max_events, int timeout, const sigset_t *sigmask)
+{
+	unsigned int to_submit;
+	unsigned int min_complete;
+	uring_fd_t *f;
+	int fd;
+	int ev;
+	int i, k;
+	int n = 0;
+
+	pthread_mutex_lock(&u->lock);
+	if (uring_arm_queued(u) != 0) {
+		pthread_mutex_unlock(&u->lock);
+		return -1;
+	}
+	to_submit = *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+	/* do not block if events are already waiting to be returned */
+	min_complete = 1;
+	if (u->ready_cnt > 0 || *u->cq_head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+		min_complete = 0;
+	pthread_mutex_unlock(&u->lock);
+
+	if (uring_enter(u, to_submit, min_complete, min_complete ? timeout : 0, sigmask) < 0) {
+		if (errno != ETIME && errno != EBUSY)
+			return -1;
+	}
+
+	pthread_mutex_lock(&u->lock);
+	uring_reap(u);
+	for (i = 0, k = 0; i < u->ready_cnt; i++) {
+		fd = u->ready[i];
+		f = &u->fds[fd];
+		if (n == max_events) {
+			/* no room, keep it for the next wait */
+			u->ready[k++] = fd;
+			continue;
+		}
+		/* like epoll, only report what is monitored for now */
+		ev = f->revents & (f->mask | EPOLLERR | EPOLLHUP);
+		if (f->mask != 0 && ev != 0) {
+			events[n].events = ev;
+			events[n].data.fd = fd;
+			n++;
+		}
+		f->revents = 0;
+		f->ready = 0;
+	}
+	u->ready_cnt = k;
+	pthread_mutex_unlock(&u->lock);
+
+	return n;
+}
+#endif
+
 /**
  * @brief
  *	Initialize event monitoring
@@ -138,6 +875,16 @@ tpp_em_init(int max_events)
 		free(ctx);
 		return NULL;
 	}
+	ctx->max_nfds = max_events;
+	ctx->init_pid = getpid();
+	ctx->uring = NULL;
+
+#if defined(PBS_HAVE_IO_URING)
+	if (uring_requested() && (ctx->uring = uring_create(max_events)) != NULL) {
+		ctx->epoll_fd = -1;
+		return ((void *) ctx);
+	}
+#endif
 
 #if defined(EPOLL_CLOEXEC)
 	ctx->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
@@ -152,8 +899,6 @@ tpp_em_init(int max_events)
 		free(ctx);
 		return NULL;
 	}
-	ctx->max_nfds = max_events;
-	ctx->init_pid = getpid();
 
 	return ((void *) ctx);
 }
@@ -174,6 +919,11 @@ void
 tpp_em_destroy(void *em_ctx)
 {
 	epoll_context_t *ctx = (epoll_context_t *) em_ctx;
+#if defined(PBS_HAVE_IO_URING)
+	if (ctx->uring)
+		uring_destroy(ctx->uring);
+	else
+#endif
 	close(ctx->epoll_fd);
 	free(ctx->events);
 	free(ctx);
@@ -212,6 +962,11 @@ tpp_em_add_fd(void *em_ctx, int fd, int event_mask)
 	if (ctx->init_pid != getpid())
 		return 0;
 
+#if defined(PBS_HAVE_IO_URING)
+	if (ctx->uring)
+		return uring_add_fd(ctx->uring, fd, event_mask);
+#endif
+
 	memset(&ev, 0, sizeof(ev));
 	ev.events = event_mask;
 	ev.data.fd = fd;
@@ -255,6 +1010,11 @@ tpp_em_mod_fd(void *em_ctx, int fd, int event_mask)
 	if (ctx->init_pid != getpid())
 		return 0;
 
+#if defined(PBS_HAVE_IO_URING)
+	if (ctx->uring)
+		return uring_mod_fd(ctx->uring, fd, event_mask);
+#endif
+
 	memset(&ev, 0, sizeof(ev));
 	ev.events = event_mask;
 	ev.data.fd = fd;
@@ -297,6 +1057,11 @@ tpp_em_del_fd(void *em_ctx, int fd)
 	if (ctx->init_pid != getpid())
 		return 0;
 
+#if defined(PBS_HAVE_IO_URING)
+	if (ctx->uring)
+		return uring_del_fd(ctx->uring, fd);
+#endif
+
 	memset(&ev, 0, sizeof(ev));
 	ev.data.fd = fd;
 	if (epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, fd, &ev) < 0)
@@ -332,6 +1097,10 @@ tpp_em_pwait(void *em_ctx, em_event_t **ev_array, int timeout, const sigset_t *s
 {
         epoll_context_t *ctx = (epoll_context_t *) em_ctx;
         *ev_array = ctx->events;
+#if defined(PBS_HAVE_IO_URING)
+	if (ctx->uring)
+		return uring_wait(ctx->uring, ctx->events, ctx->max_nfds, timeout, sigmask);
+#endif
         return (epoll_pwait(ctx->epoll_fd, ctx->events, ctx->max_nfds, timeout, sigmask));
 }
 #else
@@ -342,6 +1111,10 @@ tpp_em_pwait(void *em_ctx, em_event_t **ev_array, int timeout, const sigset_t *s
 	*ev_array = ctx->events;
 	sigset_t origmask;
 	int n;
+#if defined(PBS_HAVE_IO_URING)
+	if (ctx->uring)
+		return uring_wait(ctx->uring, ctx->events, ctx->max_nfds, timeout, sigmask);
+#endif
 	sigprocmask(SIG_SETMASK, sigmask, &origmask);
 	n = epoll_wait(ctx->epoll_fd, ctx->events, ctx->max_nfds, timeout);
 	sigprocmask(SIG_SETMASK, &origmask, NULL);
@@ -57,6 +57,8 @@ extern "C" {
 
 #ifndef WIN32
 
+#include <sys/uio.h>
+
 #define tpp_pipe_cr(a)               pipe(a)
 #define tpp_pipe_read(a, b, c)         read(a, b, c)
 #define tpp_pipe_write(a, b, c)        write(a, b, c)
@@ -69,6 +71,7 @@ extern "C" {
 #define tpp_sock_connect(a, b, c)      connect(a, b, c)
 #define tpp_sock_recv(a, b, c, d)       recv(a, b, c, d)
 #define tpp_sock_send(a, b, c, d)       send(a, b, c, d)
+#define tpp_sock_writev(a, b, c)        writev(a, b, c)
 #define tpp_sock_select(a, b, c, d, e)   select(a, b, c, d, e)
 #define tpp_sock_close(a)            close(a)
 #define tpp_sock_getsockopt(a, b, c, d, e)   getsockopt(a, b, c, d, e)
@@ -79,6 +82,11 @@ extern "C" {
 #define EINPROGRESS   EAGAIN
 #endif
 
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+
 int tpp_pipe_cr(int fds[2]);
 int tpp_pipe_read(int, char *, int);
 int tpp_pipe_write(int, char *, int);
@@ -91,6 +99,7 @@ int tpp_sock_bind(int, const struct sockaddr *, int);
 int tpp_sock_connect(int, const struct sockaddr *, int);
 int tpp_sock_recv(int, char *, int, int);
 int tpp_sock_send(int, const char *, int, int);
+int tpp_sock_writev(int, const struct iovec *, int);
 int tpp_sock_select(int, fd_set *, fd_set *, fd_set *, const struct timeval *);
 int tpp_sock_close(int);
 int tpp_sock_getsockopt(int, int, int, int *, int *);
@@ -141,6 +150,7 @@ typedef struct {
 	char *data;	/* pointer to the data buffer */
 	size_t len;	/* length of the data buffer */
 	char *pos;	/* current position - till which data is consumed */
+	char pooled;	/* data is a refcounted buffer from tpp_buf_alloc */
 } tpp_chunk_t;
 
 /*
@@ -184,6 +194,17 @@ typedef struct {
 } tpp_join_pkt_hdr_t;
 /* a bunch of tpp_addr structs follow this packet */
 
+/*
+ * Optional trailer after the addresses in a join packet from a leaf.
+ * Leaves that predate it send none, so it is only trusted if the magic
+ * matches and it fits in the packet.
+ */
+typedef struct {
+	unsigned char magic[3];     /* TPP_JOIN_EXT_MAGIC */
+	unsigned char codecs;       /* mask of codecs the leaf can decompress */
+} tpp_join_ext_t;
+#define TPP_JOIN_EXT_MAGIC "\377TJ"
+
 /*
  * The Leave packet header structure
  */
@@ -288,7 +309,25 @@ enum TPP_MSG_TYPES {
 #define TPP_STRM_TIMEOUT        600
 #define TPP_MIN_WAIT            2
 #define TPP_SEND_SIZE           8192
-#define TPP_COMPR_SIZE          8192
+#define TPP_COMPR_SIZE          8192 /* default minimum size of data to compress */
+
+/*
+ * Compression codecs. The zlib ones produce plain zlib streams that any
+ * peer can inflate. Data compressed by other codecs starts with a
+ * tpp_codec_tag_t, which can never start a zlib stream.
+ */
+#define TPP_CODEC_ZLIB          0 /* zlib, default level */
+#define TPP_CODEC_ZLIB_FAST     1 /* zlib, fastest level */
+#define TPP_CODEC_ZSTD          2 /* zstd, fast level, needs zstd support */
+#define TPP_CODEC_MAX           3
+#define TPP_CODEC_BIT(c)        (1 << (c))
+#define TPP_CODECS_ZLIB         (TPP_CODEC_BIT(TPP_CODEC_ZLIB) | TPP_CODEC_BIT(TPP_CODEC_ZLIB_FAST))
+
+typedef struct {
+	unsigned char magic[3];     /* TPP_CODEC_MAGIC */
+	unsigned char codec;        /* TPP_CODEC_* */
+} tpp_codec_tag_t;
+#define TPP_CODEC_MAGIC "\377TC"
 
 /* tpp cmds used internally by the layer to notify messages between threads */
 #define TPP_CMD_SEND            1
@@ -356,6 +395,8 @@ typedef struct {
 
 	int   num_addrs;
 	tpp_addr_t *leaf_addrs; /* list of leaf's addresses */
+
+	unsigned char codecs;   /* codecs the leaf can decompress, if directly connected */
 } tpp_leaf_t;
 
 /* routines and headers to manage FIFO queues */
@@ -413,6 +454,7 @@ typedef struct {
 
 typedef struct {
 	void *td;
+	void *pools; /* this thread's caches of free packets, chunks etc */
 	char tppstaticbuf[TPP_GEN_BUF_SZ];
 } tpp_tls_t;
 
@@ -448,6 +490,9 @@ tpp_tls_t *tpp_get_tls(void);
 char *mk_hostname(char *, int);
 struct sockaddr_in* tpp_localaddr(int);
 tpp_packet_t *tpp_bld_pkt(tpp_packet_t *, void *, int, int, void **);
+tpp_packet_t *tpp_bld_pkt_ref(tpp_packet_t *, void *, int);
+void *tpp_buf_alloc(size_t);
+void tpp_buf_release(void *);
 
 void tpp_router_terminate(void);
 void tpp_free_tls(void);
@@ -498,9 +543,13 @@ int tpp_send_ctl_msg(int, int, tpp_addr_t *, tpp_addr_t *, unsigned int, char, c
 int tpp_cr_thrd(void *(*start_routine)(void*), pthread_t *, void *);
 int tpp_set_keep_alive(int, struct tpp_config *);
 
-void *tpp_deflate(void *, unsigned int, unsigned int *);
+void *tpp_compress(int, void *, unsigned int, unsigned int *);
 void *tpp_inflate(void *, unsigned int, unsigned int);
-void *tpp_multi_deflate_init(int);
+int tpp_codec_of(void *, unsigned int);
+int tpp_codecs_supported(void);
+int tpp_codec_parse(char *);
+char *tpp_codec_name(int);
+void *tpp_multi_deflate_init(int, int);
 int tpp_multi_deflate_do(void *, int, void *, unsigned int);
 void *tpp_multi_deflate_done(void *, unsigned int *);
 
@@ -562,6 +611,7 @@ typedef struct {
 	int max_nfds;
 	pid_t init_pid;
 	em_event_t *events;
+	struct tpp_uring *uring; /* io_uring used instead of epoll_fd, if set */
 } epoll_context_t;
 
 #elif defined (PBS_USE_POLLSET)
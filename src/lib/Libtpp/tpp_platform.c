@@ -370,6 +370,31 @@ tpp_sock_send(int s, const char *buf, int len, int flags)
 	return ret;
 }
 
+/*
+ * wrapper to call windows WSASend() with a set of buffers, in the
+ * manner of writev(), and map windows error code to errno so that
+ * callers do not need conditionally compiled code
+ */
+int
+tpp_sock_writev(int s, const struct iovec *iov, int iovcnt)
+{
+	WSABUF bufs[64];
+	DWORD sent = 0;
+	int i;
+
+	if (iovcnt > 64)
+		iovcnt = 64;
+	for (i = 0; i < iovcnt; i++) {
+		bufs[i].buf = iov[i].iov_base;
+		bufs[i].len = (ULONG) iov[i].iov_len;
+	}
+	if (WSASend(s, bufs, iovcnt, &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+		errno = tr_2_errno(WSAGetLastError());
+		return -1;
+	}
+	return (int) sent;
+}
+
 /*
  * wrapper to call windows select() and map windows
  * error code to errno and massage the return value
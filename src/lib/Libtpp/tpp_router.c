@@ -92,9 +92,6 @@ pthread_mutex_t lj_lock;
 /* index of routers connected to this router */
 void *routers_idx = NULL;
 
-/* index of all leaves in the cluster */
-void *cluster_leaves_idx = NULL;
-
 /* index of special routers who need to be notified for join updates */
 void *my_leaves_notify_idx = NULL;
 time_t router_last_leaf_joined = 0;
@@ -117,6 +114,446 @@ static int router_post_connect_handler(int tfd, void *data, void *c, void *extra
 /* structure identifying this router */
 static tpp_router_t *this_router = NULL;
 
+/*
+ * Routing table of all leaves in the cluster, keyed by leaf address.
+ *
+ * Forwarding a packet only needs to find the destination leaf and pick
+ * a router for it, so those lookups do not take router_lock. The table
+ * is split into shards, each a small hash table. Bucket arrays and
+ * chains are only changed by writers holding router_lock (write), and
+ * every change is published with a release store so that a reader walking
+ * a chain at the same time always sees a consistent chain.
+ *
+ * Memory that a reader could still be looking at (table entries, old
+ * bucket arrays, leaves, a leaf's router array, routers) is not freed
+ * directly but retired with route_retire(). It is freed once every IO
+ * thread that was inside a lookup when it was retired has left it
+ * (epoch based reclamation). Each IO thread has its own reader slot, so
+ * a lookup only writes to a cache line owned by its own thread.
+ */
+#define ROUTE_SHARDS		16	/* must be a power of 2 */
+#define ROUTE_INIT_BUCKETS	64	/* must be a power of 2 */
+
+typedef struct route_ent {
+	struct route_ent *next;
+	tpp_addr_t addr;
+	tpp_leaf_t *leaf;
+} route_ent_t;
+
+typedef struct {
+	unsigned int nbuckets;
+	route_ent_t *bucket[1]; /* nbuckets entries */
+} route_bkts_t;
+
+typedef struct {
+	route_bkts_t *bkts;
+	unsigned int count;
+} route_shard_t;
+
+typedef struct route_limbo {
+	struct route_limbo *next;
+	unsigned long epoch;      /* epoch at which this was retired */
+	void *ptr;
+	void (*free_func)(void *);
+} route_limbo_t;
+
+typedef struct {
+	unsigned long active;     /* epoch when lookup began, 0 if not in one */
+	char pad[64 - sizeof(unsigned long)]; /* own cache line per thread */
+} route_reader_t;
+
+static route_shard_t route_shards[ROUTE_SHARDS];
+static route_reader_t *route_readers = NULL;
+static int route_nreaders = 0;    /* one per IO thread, plus a shared one */
+static pthread_mutex_t route_other_lock; /* serializes the shared reader slot */
+static unsigned long route_epoch = 1;
+static route_limbo_t *route_limbo = NULL;
+static pthread_mutex_t route_limbo_lock;
+
+#define ROUTE_LOAD(p)		__atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define ROUTE_STORE(p, v)	__atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * @brief
+ *	Hash a tpp address for the routing table
+ *
+ * @param[in] addr - address to hash
+ *
+ * @return hash value
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static unsigned int
+route_hash(tpp_addr_t *addr)
+{
+	unsigned int h = 2166136261u;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		h = (h ^ (unsigned int) addr->ip[i]) * 16777619u;
+	h = (h ^ (unsigned short) addr->port) * 16777619u;
+	h = (h ^ (unsigned char) addr->family) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+static int
+route_addr_eq(tpp_addr_t *a, tpp_addr_t *b)
+{
+	return (a->ip[0] == b->ip[0] && a->ip[1] == b->ip[1] &&
+		a->ip[2] == b->ip[2] && a->ip[3] == b->ip[3] &&
+		a->port == b->port && a->family == b->family);
+}
+
+static route_bkts_t *
+route_alloc_bkts(unsigned int nbuckets)
+{
+	route_bkts_t *b;
+
+	b = calloc(1, sizeof(route_bkts_t) + (nbuckets - 1) * sizeof(route_ent_t *));
+	if (b)
+		b->nbuckets = nbuckets;
+	return b;
+}
+
+/**
+ * @brief
+ *	Free a retired bucket array along with the entries chained on it
+ *
+ * @param[in] p - the route_bkts_t
+ *
+ */
+static void
+route_free_bkts(void *p)
+{
+	route_bkts_t *b = p;
+	route_ent_t *e, *nxt;
+	unsigned int i;
+
+	for (i = 0; i < b->nbuckets; i++) {
+		for (e = b->bucket[i]; e; e = nxt) {
+			nxt = e->next;
+			free(e);
+		}
+	}
+	free(b);
+}
+
+static void
+route_free_leaf(void *p)
+{
+	free_leaf((tpp_leaf_t *) p);
+}
+
+static void
+route_free_router(void *p)
+{
+	free_router((tpp_router_t *) p);
+}
+
+/**
+ * @brief
+ *	Initialize the routing table and one reader slot per IO thread
+ *
+ * @param[in] nthreads - number of IO threads
+ *
+ * @return Error code
+ * @retval -1 - Failure
+ * @retval  0 - Success
+ *
+ */
+static int
+route_init(int nthreads)
+{
+	int i;
+
+	tpp_init_lock(&route_other_lock);
+	tpp_init_lock(&route_limbo_lock);
+
+	route_nreaders = nthreads + 1;
+	route_readers = calloc(route_nreaders, sizeof(route_reader_t));
+	if (route_readers == NULL)
+		return -1;
+
+	for (i = 0; i < ROUTE_SHARDS; i++) {
+		route_shards[i].bkts = route_alloc_bkts(ROUTE_INIT_BUCKETS);
+		if (route_shards[i].bkts == NULL)
+			return -1;
+		route_shards[i].count = 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Enter a routing table lookup. Anything found in the table stays
+ *	valid until the matching route_read_end().
+ *
+ * @return reader slot to pass to route_read_end()
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+route_read_begin(void)
+{
+	int slot;
+
+	slot = tpp_get_thrd_index();
+	if (slot < 0 || slot >= route_nreaders - 1) {
+		/* not an IO thread, use the shared slot */
+		slot = route_nreaders - 1;
+		tpp_lock(&route_other_lock);
+	}
+	__atomic_store_n(&route_readers[slot].active,
+		__atomic_load_n(&route_epoch, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+	/* pairs with the fence in route_reclaim() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return slot;
+}
+
+/**
+ * @brief
+ *	Leave a routing table lookup started with route_read_begin()
+ *
+ * @param[in] slot - reader slot returned by route_read_begin()
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+route_read_end(int slot)
+{
+	__atomic_store_n(&route_readers[slot].active, 0, __ATOMIC_RELEASE);
+	if (slot == route_nreaders - 1)
+		tpp_unlock(&route_other_lock);
+}
+
+/**
+ * @brief
+ *	Free retired memory that no reader can be looking at anymore
+ *
+ * @return whether retired memory is still waiting to be freed
+ * @retval 1 - some left
+ * @retval 0 - none left
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+route_reclaim(void)
+{
+	route_limbo_t *p, **pp;
+	unsigned long oldest = ~0UL;
+	unsigned long e;
+	int i;
+	int left;
+
+	/*
+	 * a reader not seen in a slot below is guaranteed to see
+	 * everything unlinked before this fence
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	for (i = 0; i < route_nreaders; i++) {
+		e = __atomic_load_n(&route_readers[i].active, __ATOMIC_RELAXED);
+		if (e != 0 && e < oldest)
+			oldest = e;
+	}
+
+	tpp_lock(&route_limbo_lock);
+	pp = &route_limbo;
+	while ((p = *pp)) {
+		if (p->epoch < oldest) {
+			*pp = p->next;
+			p->free_func(p->ptr);
+			free(p);
+		} else
+			pp = &p->next;
+	}
+	left = (route_limbo != NULL);
+	tpp_unlock(&route_limbo_lock);
+
+	return left;
+}
+
+/**
+ * @brief
+ *	Free memory once no reader can be looking at it anymore. The caller
+ *	must have unlinked it from anything a reader can reach, and must not
+ *	touch it after this call.
+ *
+ * @param[in] ptr - memory to free
+ * @param[in] free_func - function to free it with
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+route_retire(void *ptr, void (*free_func)(void *))
+{
+	route_limbo_t *p;
+
+	if (ptr == NULL)
+		return;
+
+	if ((p = malloc(sizeof(route_limbo_t))) == NULL) {
+		/* better to leak than to free under a reader */
+		tpp_log(LOG_CRIT, __func__, "Out of memory retiring route data");
+		return;
+	}
+	p->ptr = ptr;
+	p->free_func = free_func;
+
+	tpp_lock(&route_limbo_lock);
+	p->epoch = __atomic_fetch_add(&route_epoch, 1, __ATOMIC_SEQ_CST);
+	p->next = route_limbo;
+	route_limbo = p;
+	tpp_unlock(&route_limbo_lock);
+
+	(void) route_reclaim();
+}
+
+/**
+ * @brief
+ *	Find the leaf owning an address. Must be called between
+ *	route_read_begin() and route_read_end(), or with router_lock held.
+ *
+ * @param[in] addr - address to find
+ *
+ * @return leaf, or NULL if not found
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_leaf_t *
+route_find(tpp_addr_t *addr)
+{
+	unsigned int h = route_hash(addr);
+	route_shard_t *s = &route_shards[h & (ROUTE_SHARDS - 1)];
+	route_bkts_t *b;
+	route_ent_t *e;
+
+	b = ROUTE_LOAD(s->bkts);
+	for (e = ROUTE_LOAD(b->bucket[(h / ROUTE_SHARDS) & (b->nbuckets - 1)]); e; e = ROUTE_LOAD(e->next)) {
+		if (route_addr_eq(&e->addr, addr))
+			return e->leaf;
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Double the bucket array of a shard. The entries are copied to the new
+ *	array so that readers still walking the old one are not disturbed.
+ *
+ * @param[in] s - shard to grow
+ *
+ * @par MT-safe: No, called with router_lock held for write
+ *
+ */
+static void
+route_grow(route_shard_t *s)
+{
+	route_bkts_t *ob = s->bkts;
+	route_bkts_t *nb;
+	route_ent_t *e, *ne;
+	unsigned int i, k;
+
+	if ((nb = route_alloc_bkts(ob->nbuckets * 2)) == NULL)
+		return; /* keep the longer chains */
+
+	for (i = 0; i < ob->nbuckets; i++) {
+		for (e = ob->bucket[i]; e; e = e->next) {
+			if ((ne = malloc(sizeof(route_ent_t))) == NULL) {
+				route_free_bkts(nb);
+				return;
+			}
+			*ne = *e;
+			k = (route_hash(&e->addr) / ROUTE_SHARDS) & (nb->nbuckets - 1);
+			ne->next = nb->bucket[k];
+			nb->bucket[k] = ne;
+		}
+	}
+	ROUTE_STORE(s->bkts, nb);
+	route_retire(ob, route_free_bkts);
+}
+
+/**
+ * @brief
+ *	Add an address of a leaf to the routing table
+ *
+ * @param[in] addr - address of the leaf
+ * @param[in] l - the leaf
+ *
+ * @return Error code
+ * @retval -1 - Failure, out of memory or address already present
+ * @retval  0 - Success
+ *
+ * @par MT-safe: No, called with router_lock held for write
+ *
+ */
+static int
+route_insert(tpp_addr_t *addr, tpp_leaf_t *l)
+{
+	unsigned int h = route_hash(addr);
+	route_shard_t *s = &route_shards[h & (ROUTE_SHARDS - 1)];
+	route_bkts_t *b;
+	route_ent_t *e;
+	unsigned int k;
+
+	if (route_find(addr) != NULL)
+		return -1;
+
+	if ((e = malloc(sizeof(route_ent_t))) == NULL)
+		return -1;
+	memcpy(&e->addr, addr, sizeof(tpp_addr_t));
+	e->leaf = l;
+
+	if (s->count >= s->bkts->nbuckets * 2)
+		route_grow(s);
+
+	b = s->bkts;
+	k = (h / ROUTE_SHARDS) & (b->nbuckets - 1);
+	e->next = b->bucket[k];
+	ROUTE_STORE(b->bucket[k], e);
+	s->count++;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Remove an address from the routing table
+ *
+ * @param[in] addr - address to remove
+ *
+ * @return Error code
+ * @retval -1 - Failure, address not present
+ * @retval  0 - Success
+ *
+ * @par MT-safe: No, called with router_lock held for write
+ *
+ */
+static int
+route_delete(tpp_addr_t *addr)
+{
+	unsigned int h = route_hash(addr);
+	route_shard_t *s = &route_shards[h & (ROUTE_SHARDS - 1)];
+	route_bkts_t *b = s->bkts;
+	route_ent_t *e;
+	route_ent_t **pe;
+
+	pe = &b->bucket[(h / ROUTE_SHARDS) & (b->nbuckets - 1)];
+	for (e = *pe; e; pe = &e->next, e = *pe) {
+		if (route_addr_eq(&e->addr, addr)) {
+			ROUTE_STORE(*pe, e->next);
+			s->count--;
+			route_retire(e, free);
+			return 0;
+		}
+	}
+	return -1;
+}
+
 static tpp_router_t *
 alloc_router(char *name, tpp_addr_t *address)
 {
@@ -283,6 +720,155 @@ err:
 	return -1;
 }
 
+/*
+ * max chunks in a packet broadcast to routers or leaves
+ */
+#define BCAST_MAX_CHUNKS 2
+
+/**
+ * @brief
+ *	Add data to a packet as a chunk sharing one refcounted copy of the
+ *	data with other packets. The copy is made on the first call.
+ *
+ * @param[in] - pkt  - Pointer to packet to add chunk, or create new packet if NULL
+ * @param[in] - data - The data
+ * @param[in] - len  - Length of the data
+ * @param[in,out] - shared - The shared copy, NULL till created
+ *
+ * @return The packet
+ * @retval NULL - Failure (Out of memory), pkt has been freed
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_packet_t *
+add_shared_chunk(tpp_packet_t *pkt, void *data, int len, void **shared)
+{
+	if (*shared == NULL) {
+		if ((*shared = tpp_buf_alloc(len)) == NULL) {
+			tpp_free_pkt(pkt);
+			return NULL;
+		}
+		memcpy(*shared, data, len);
+	}
+	return tpp_bld_pkt_ref(pkt, *shared, len);
+}
+
+/**
+ * @brief
+ *	Build the packet for one destination of a broadcast.
+ *
+ * @par Functionality
+ *	The first chunk is the header, whose length field the transport fills
+ *	in, so it is copied for every packet. The other chunks are copied once
+ *	into refcounted buffers on first use and shared by all the packets.
+ *
+ * @param[in] - chunks - Chunks of data to be sent
+ * @param[in] - count  - Number of chunks in the chunks array
+ * @param[in,out] - shared - Shared copies of the chunks, NULL till created
+ *
+ * @return The packet
+ * @retval NULL - Failure (Out of memory)
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_packet_t *
+bld_bcast_pkt(tpp_chunk_t *chunks, int count, void **shared)
+{
+	tpp_packet_t *pkt;
+	int j;
+
+	pkt = tpp_bld_pkt(NULL, chunks[0].data, chunks[0].len, 1, NULL);
+	for (j = 1; pkt && j < count; j++)
+		pkt = add_shared_chunk(pkt, chunks[j].data, chunks[j].len, &shared[j]);
+	return pkt;
+}
+
+/**
+ * @brief
+ *	Drop the references to the shared chunks of a broadcast
+ *
+ * @param[in] - shared - Shared copies of the chunks
+ *
+ */
+static void
+free_bcast_bufs(void **shared)
+{
+	int j;
+
+	for (j = 0; j < BCAST_MAX_CHUNKS; j++)
+		tpp_buf_release(shared[j]);
+}
+
+/**
+ * @brief
+ *	Decompress data into a buffer that can be shared by several packets
+ *
+ * @param[in] - data - The compressed data
+ * @param[in] - len  - Length of the compressed data
+ * @param[in] - totlen - Length of the data uncompressed
+ *
+ * @return The shared buffer, release with tpp_buf_release
+ * @retval NULL - Failure
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void *
+inflate_shared(void *data, unsigned int len, unsigned int totlen)
+{
+	void *raw;
+	void *buf;
+
+	if ((raw = tpp_inflate(data, len, totlen)) == NULL)
+		return NULL;
+	if ((buf = tpp_buf_alloc(totlen)) != NULL)
+		memcpy(buf, raw, totlen);
+	free(raw);
+	return buf;
+}
+
+/**
+ * @brief
+ *	Build the packet to deliver a data packet to a leaf directly connected
+ *	to this router. Data compressed with a codec that the leaf cannot
+ *	decompress is decompressed here and delivered uncompressed.
+ *
+ * @param[in] - dhdr - The data packet
+ * @param[in] - len  - Length of the data packet
+ * @param[in] - codecs - Codecs the leaf can decompress
+ *
+ * @return The packet
+ * @retval NULL - Failure (Out of memory)
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_packet_t *
+bld_leaf_data_pkt(tpp_data_pkt_hdr_t *dhdr, int len, int codecs)
+{
+	tpp_packet_t *pkt;
+	void *data = (char *) dhdr + sizeof(tpp_data_pkt_hdr_t);
+	unsigned int data_len = len - sizeof(tpp_data_pkt_hdr_t);
+	unsigned int totlen = ntohl(dhdr->totlen);
+	void *raw;
+
+	if (dhdr->type != TPP_DATA || data_len == totlen ||
+		(codecs & TPP_CODEC_BIT(tpp_codec_of(data, data_len))))
+		return tpp_bld_pkt(NULL, dhdr, len, 1, NULL);
+
+	/* on failure let the leaf report the problem */
+	if ((raw = inflate_shared(data, data_len, totlen)) == NULL)
+		return tpp_bld_pkt(NULL, dhdr, len, 1, NULL);
+
+	pkt = tpp_bld_pkt(NULL, dhdr, sizeof(tpp_data_pkt_hdr_t), 1, NULL);
+	if (pkt)
+		pkt = tpp_bld_pkt_ref(pkt, raw, totlen);
+	tpp_buf_release(raw);
+	return pkt;
+}
+
 /**
  * @brief
  *	Broadcast the given data packet to all the routers connected to this
@@ -309,9 +895,14 @@ broadcast_to_my_routers(tpp_chunk_t *chunks, int count, int origin_tfd)
 	tpp_router_t *r;
 	tpp_que_t router_list;
 	void *idx_ctx = NULL;
+	void *shared[BCAST_MAX_CHUNKS] = {NULL};
+	int route_slot;
 
 	TPP_QUE_CLEAR(&router_list);
 
+	/* keep the routers collected below from being freed till they are sent to */
+	route_slot = route_read_begin();
+
 	while (pbs_idx_find(routers_idx, NULL, (void **)&r, &idx_ctx) == PBS_IDX_RET_OK) {
 		if (r->conn_fd == -1 || r == this_router || r->conn_fd == origin_tfd || r->state != TPP_ROUTER_STATE_CONNECTED) {
 			continue; /* don't send to self, or to originating router */
@@ -327,15 +918,11 @@ broadcast_to_my_routers(tpp_chunk_t *chunks, int count, int origin_tfd)
 	tpp_unlock_rwlock(&router_lock);
 
 	while ((r = (tpp_router_t *) tpp_deque(&router_list))) {
-		int j;
-		tpp_packet_t *pkt = NULL;
+		tpp_packet_t *pkt;
 
-		for (j = 0; j < count; j++) {
-			pkt = tpp_bld_pkt(pkt, chunks[j].data, chunks[j].len, 1, NULL);
-			if (!pkt) {
-				tpp_log(LOG_CRIT, __func__, "Failed to build packet");
-				goto err;
-			}
+		if ((pkt = bld_bcast_pkt(chunks, count, shared)) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+			goto err;
 		}
 
 		if (tpp_transport_vsend(r->conn_fd, pkt) != 0) {
@@ -347,11 +934,15 @@ broadcast_to_my_routers(tpp_chunk_t *chunks, int count, int origin_tfd)
 			/* vsend will free packets even in case of failure */
 		}
 	}
+	route_read_end(route_slot);
+	free_bcast_bufs(shared);
 	return 0;
 
 err:
 	tpp_log(LOG_CRIT, __func__, "Error broadcasting to my routers");
 	while (tpp_deque(&router_list)); /* drain the list, dont free packets, transport will free */
+	route_read_end(route_slot);
+	free_bcast_bufs(shared);
 	return -1;
 }
 
@@ -387,6 +978,8 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 	void *traverse_idx = NULL;
 	void *idx_ctx = NULL;
 	tpp_que_t leaf_list;
+	void *shared[BCAST_MAX_CHUNKS] = {NULL};
+	int route_slot;
 
 	TPP_QUE_CLEAR(&leaf_list);
 
@@ -395,6 +988,8 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 	else
 		traverse_idx = this_router->my_leaves_idx;
 
+	/* keep the leaves collected below from being freed till they are sent to */
+	route_slot = route_read_begin();
 	tpp_read_lock(&router_lock);
 	while (pbs_idx_find(traverse_idx, NULL, (void **)&l, &idx_ctx) == PBS_IDX_RET_OK) {
 		/*
@@ -419,15 +1014,11 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 	tpp_unlock_rwlock(&router_lock);
 
 	while ((l = (tpp_leaf_t *) tpp_deque(&leaf_list))) {
-		int j;
-		tpp_packet_t *pkt = NULL;
+		tpp_packet_t *pkt;
 
-		for (j = 0; j < count; j++) {
-			pkt = tpp_bld_pkt(pkt, chunks[j].data, chunks[j].len, 1, NULL);
-			if (!pkt) {
-				tpp_log(LOG_CRIT, __func__, "Failed to build packet");
-				goto err;
-			}
+		if ((pkt = bld_bcast_pkt(chunks, count, shared)) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+			goto err;
 		}
 
 		if (tpp_transport_vsend(l->conn_fd, pkt) != 0) {
@@ -438,11 +1029,15 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 			/* vsend will free packets even in case of failure */
 		}
 	}
+	route_read_end(route_slot);
+	free_bcast_bufs(shared);
 	return 0;
 
 err:
 	tpp_log(LOG_CRIT, __func__, "Error broadcasting to my leaves");
 	while (tpp_deque(&leaf_list)); /* drain the list, dont free pacets, transport will free */
+	route_read_end(route_slot);
+	free_bcast_bufs(shared);
 	return -1;
 }
 
@@ -698,7 +1293,7 @@ router_close_handler_inner(int tfd, int error, void *c, int hop)
 
 		/* delete all of this leaf's addresses from the search tree */
 		for (i = 0; i < l->num_addrs; i++) {
-			if (pbs_idx_delete(cluster_leaves_idx, &l->leaf_addrs[i]) != PBS_IDX_RET_OK) {
+			if (route_delete(&l->leaf_addrs[i]) != 0) {
 				tpp_log(LOG_CRIT, __func__, "tfd=%d, Failed to delete address %s from cluster leaves", tfd, tpp_netaddr(&l->leaf_addrs[i]));
 				tpp_unlock_rwlock(&router_lock);
 				return -1;
@@ -725,7 +1320,8 @@ router_close_handler_inner(int tfd, int error, void *c, int hop)
 		 */
 		broadcast_to_my_leaves(chunks, 2, tfd, 0);
 
-		free_leaf(l);
+		/* forwarding threads may still be looking at the leaf */
+		route_retire(l, route_free_leaf);
 
 		return 0;
 
@@ -777,7 +1373,7 @@ router_close_handler_inner(int tfd, int error, void *c, int hop)
 				}
 
 				for (i = 0; i < l->num_addrs; i++) {
-					if (pbs_idx_delete(cluster_leaves_idx, &l->leaf_addrs[i]) != PBS_IDX_RET_OK) {
+					if (route_delete(&l->leaf_addrs[i]) != 0) {
 						tpp_log(LOG_CRIT, __func__, "tfd=%d, Failed to delete address %s", tfd, tpp_netaddr(&l->leaf_addrs[i]));
 						tpp_unlock_rwlock(&router_lock);
 
@@ -797,7 +1393,7 @@ router_close_handler_inner(int tfd, int error, void *c, int hop)
 				r->my_leaves_idx = pbs_idx_create(0, sizeof(tpp_addr_t));
 				if (r->my_leaves_idx == NULL) {
 					tpp_log(LOG_CRIT, __func__, "Failed to create index for my leaves");
-					free_router(r);
+					route_retire(r, route_free_router);
 					tpp_unlock_rwlock(&router_lock);
 					return -1;
 				}
@@ -836,7 +1432,7 @@ router_close_handler_inner(int tfd, int error, void *c, int hop)
 				 * a IO call (inside this function).
 				 */
 				broadcast_to_my_leaves(chunks, 2, tfd, 0);
-				free_leaf(l);
+				route_retire(l, route_free_leaf);
 			}
 		}
 
@@ -884,9 +1480,10 @@ router_close_handler_inner(int tfd, int error, void *c, int hop)
 
 			/*
 			 * context will be freed and deleted by router_close_handler
-			 * so just free router structure itself
+			 * so just free router structure itself, once no forwarding
+			 * thread can be looking at it through a leaf
 			 */
-			free_router(r);
+			route_retire(r, route_free_router);
 		}
 
 		return 0;
@@ -1004,6 +1601,10 @@ router_timer_handler(time_t now)
 		broadcast_to_my_leaves(chunks, 1, -1, 1);
 	}
 
+	/* free retired routing data once readers have moved on */
+	if (route_reclaim() && (ret == -1 || ret > 1))
+		ret = 1;
+
 	return ret;
 }
 
@@ -1340,7 +1941,6 @@ again:
 				int i;
 				int index = (int) hdr->index;
 				tpp_addr_t *addrs;
-				void *paddr;
 
 				TPP_DBPRT("Recvd TPP_CTL_JOIN FOR LEAF from pbs_comm node %s, len=%d, hop=%d", tpp_netaddr(&connected_host), len, hop);
 
@@ -1374,8 +1974,7 @@ again:
 
 				/* find the leaf */
 				found = 1;
-				paddr = &addrs[0];
-				pbs_idx_find(cluster_leaves_idx, &paddr, (void **)&l, NULL);
+				l = route_find(&addrs[0]);
 				if (!l) {
 					found = 0;
 					l = (tpp_leaf_t *) calloc(1, sizeof(tpp_leaf_t));
@@ -1413,7 +2012,17 @@ again:
 						tpp_unlock_rwlock(&router_lock);
 						return -1;
 					}
-					l->conn_fd = tfd;
+
+					/* leaves that send no trailer only know zlib */
+					l->codecs = TPP_CODECS_ZLIB;
+					if (len >= (int) (sizeof(tpp_join_pkt_hdr_t) + hdr->num_addrs * sizeof(tpp_addr_t) + sizeof(tpp_join_ext_t))) {
+						tpp_join_ext_t *ext = (tpp_join_ext_t *) (addrs + hdr->num_addrs);
+
+						if (memcmp(ext->magic, TPP_JOIN_EXT_MAGIC, sizeof(ext->magic)) == 0)
+							l->codecs = ext->codecs;
+					}
+					/* forwarding threads read codecs once they see conn_fd */
+					ROUTE_STORE(l->conn_fd, tfd);
 
 					/*
 					 * Set a context only if the JOIN came from a direct connection
@@ -1454,14 +2063,12 @@ again:
 
 				if (found == 0) {
 					int fatal = 0;
-					/* add each address to the cluster_leaves_idx tree
+					/* add each address to the cluster routing table
 					 * since this is the primary "routing table"
 					 */
 					for (i = 0; i < l->num_addrs; i++) {
-						if (pbs_idx_insert(cluster_leaves_idx, &l->leaf_addrs[i], l) != PBS_IDX_RET_OK) {
-							void *unused;
-							void *pleaf_addr = &l->leaf_addrs[i];
-							if (pbs_idx_find(cluster_leaves_idx, &pleaf_addr, &unused, NULL) == PBS_IDX_RET_OK) {
+						if (route_insert(&l->leaf_addrs[i], l) != 0) {
+							if (route_find(&l->leaf_addrs[i]) != NULL) {
 								int k;
 								tpp_log(LOG_CRIT, __func__, "tfd=%d, Failed to add address %s to cluster-leaves index "
 										"since address already exists, dropping duplicate", tfd, tpp_netaddr(&l->leaf_addrs[i]));
@@ -1562,7 +2169,7 @@ again:
 				tpp_write_lock(&router_lock);
 
 				/* find the leaf context to pass to close handler */
-				pbs_idx_find(cluster_leaves_idx, (void **)&src_addr, (void **)&l, NULL);
+				l = route_find(src_addr);
 				if (!l) {
 					TPP_DBPRT("No leaf %s found", tpp_netaddr(src_addr));
 					tpp_unlock_rwlock(&router_lock);
@@ -1602,6 +2209,10 @@ again:
 			int rsize = 0;
 			int csize = 0;
 			void *tmp;
+			int route_slot;
+			void *shared_payload = NULL; /* one copy of payload for all packets */
+			void *shared_raw = NULL; /* payload uncompressed, for leaves that cannot decompress it */
+			int raw_needed;
 
 			/* find the fd to forward to via the associated router */
 			tpp_mcast_pkt_hdr_t *mhdr = (tpp_mcast_pkt_hdr_t *) dhdr;
@@ -1644,6 +2255,12 @@ again:
 
 			tpp_log(LOG_INFO, __func__, "Total mcast member streams=%d", num_streams);
 
+			/*
+			 * stay in the routing table read section till the packets
+			 * are sent, since rlist points to names of routers found
+			 */
+			route_slot = route_read_begin();
+
 			/*
 			 * go backwards in an attempt to distribute mcast packet
 			 * first to other routers and then to local nodes
@@ -1660,10 +2277,8 @@ again:
 
 				TPP_DBPRT("MCAST data on fd=%u", src_sd);
 
-				tpp_read_lock(&router_lock);
-				pbs_idx_find(cluster_leaves_idx, (void **)&dest_host, (void **)&l, NULL);
+				l = route_find(dest_host);
 				if (l == NULL) {
-					tpp_unlock_rwlock(&router_lock);
 					snprintf(msg, sizeof(msg), "pbs_comm:%s: Dest not found at pbs_comm", tpp_netaddr(&this_router->router_addr));
 					log_noroute(src_host, dest_host, src_sd, msg);
 					tpp_send_ctl_msg(tfd, TPP_MSG_NOROUTE, src_host, dest_host, src_sd, 0, msg);
@@ -1672,7 +2287,6 @@ again:
 
 				/* find a router that is still connected */
 				target_router = get_preferred_router(l, this_router, &target_fd);
-				tpp_unlock_rwlock(&router_lock);
 
 				if (target_router == NULL) {
 					snprintf(msg, sizeof(msg), "pbs_comm:%s: No target pbs_comm found", tpp_netaddr(&this_router->router_addr));
@@ -1699,7 +2313,17 @@ again:
 					memcpy(&shdr->src_addr, &mhdr->src_addr, sizeof(tpp_addr_t));
 					memcpy(&shdr->dest_addr, &minfo->dest_addr, sizeof(tpp_addr_t));
 
-					if (!tpp_bld_pkt(pkt, payload, payload_len, 1, NULL)) {
+					/* leaf cannot decompress the payload? send it uncompressed */
+					raw_needed = (payload_len != ntohl(mhdr->totlen) &&
+						!(l->codecs & TPP_CODEC_BIT(tpp_codec_of(payload, payload_len))));
+					if (raw_needed && shared_raw == NULL)
+						shared_raw = inflate_shared(payload, payload_len, ntohl(mhdr->totlen));
+
+					if (raw_needed && shared_raw)
+						pkt = tpp_bld_pkt_ref(pkt, shared_raw, ntohl(mhdr->totlen));
+					else
+						pkt = add_shared_chunk(pkt, payload, payload_len, &shared_payload);
+					if (!pkt) {
 						tpp_log(LOG_CRIT, __func__, "Failed to build packet");
 						goto mcast_err;
 					}
@@ -1747,8 +2371,8 @@ again:
 
 						/* allocate minfo_buf for this target comm */
 						c_minfo_len = sizeof(tpp_mcast_pkt_info_t) * num_streams;
-						if (tpp_conf->compress == 1 && c_minfo_len > TPP_COMPR_SIZE) {
-							rlist[found].cmpr_ctx = tpp_multi_deflate_init(c_minfo_len);
+						if (tpp_conf->compress == 1 && c_minfo_len > tpp_conf->compr_min_size) {
+							rlist[found].cmpr_ctx = tpp_multi_deflate_init(tpp_conf->codec, c_minfo_len);
 							if (rlist[found].cmpr_ctx == NULL)
 								goto mcast_err;
 						} else {
@@ -1814,7 +2438,7 @@ again:
 						goto mcast_err;
 					}
 
-					if (!tpp_bld_pkt(pkt, payload, payload_len, 1, NULL)) {
+					if (!add_shared_chunk(pkt, payload, payload_len, &shared_payload)) {
 						tpp_log(LOG_CRIT, __func__, "Failed to build packet");
 						goto mcast_err;
 					}
@@ -1825,6 +2449,10 @@ again:
 				}
 			}
 mcast_err:
+			route_read_end(route_slot);
+			tpp_buf_release(shared_payload);
+			tpp_buf_release(shared_raw);
+
 			if (cmprsd_len > 0)
 				free(minfo_base);
 
@@ -1842,16 +2470,18 @@ mcast_err:
 			tpp_addr_t *src_host, *dest_host;
 			tpp_packet_t *pkt = NULL;
 			unsigned int src_sd;
+			int route_slot;
+			int codecs;
 
 			src_host = &dhdr->src_addr;
 			dest_host = &dhdr->dest_addr;
 			src_sd = ntohl(dhdr->src_sd);
 
-			tpp_read_lock(&router_lock);
+			route_slot = route_read_begin();
 
-			pbs_idx_find(cluster_leaves_idx, (void **)&dest_host, (void **)&l, NULL);
+			l = route_find(dest_host);
 			if (l == NULL) {
-				tpp_unlock_rwlock(&router_lock);
+				route_read_end(route_slot);
 				snprintf(msg, sizeof(msg), "tfd=%d, pbs_comm:%s: Dest not found", tfd, tpp_netaddr(&this_router->router_addr));
 				log_noroute(src_host, dest_host, src_sd, msg);
 				tpp_send_ctl_msg(tfd, TPP_MSG_NOROUTE, src_host, dest_host, src_sd, 0, msg);
@@ -1860,7 +2490,8 @@ mcast_err:
 
 			/* find a router that is still connected */
 			target_router = get_preferred_router(l, this_router, &target_fd);
-			tpp_unlock_rwlock(&router_lock);
+			codecs = l->codecs;
+			route_read_end(route_slot);
 
 			if (target_router == NULL) {
 				snprintf(msg, sizeof(msg), "tfd=%d, pbs_comm:%s: No target pbs_comm found", tfd, tpp_netaddr(&this_router->router_addr));
@@ -1869,7 +2500,10 @@ mcast_err:
 				return 0;
 			}
 
-			pkt = tpp_bld_pkt(NULL, dhdr, len, 1, NULL);
+			if (target_router == this_router)
+				pkt = bld_leaf_data_pkt(dhdr, len, codecs);
+			else
+				pkt = tpp_bld_pkt(NULL, dhdr, len, 1, NULL);
 			if (!pkt) {
 				tpp_log(LOG_CRIT, __func__, "Failed to build packet");
 				return 0;
@@ -1895,23 +2529,24 @@ mcast_err:
 				tpp_packet_t *pkt = NULL;
 				tpp_addr_t *dest_host = &ehdr->dest_addr;
 				char *msg = ((char *) ehdr) + sizeof(tpp_ctl_pkt_hdr_t);
+				int route_slot;
 
 				strcpy(lbuf, tpp_netaddr(&ehdr->dest_addr));
 				tpp_log(LOG_WARNING, __func__, "tfd=%d, Recvd TPP_CTL_NOROUTE for message, %s(sd=%d) -> %s: %s",
 							tfd, lbuf, ntohl(ehdr->src_sd), tpp_netaddr(&ehdr->src_addr), msg);
 
 				/* find the fd to forward to via the associated router */
-				tpp_read_lock(&router_lock);
+				route_slot = route_read_begin();
 
-				pbs_idx_find(cluster_leaves_idx, (void **)&dest_host, (void **)&l, NULL);
+				l = route_find(dest_host);
 				if (l == NULL) {
-					tpp_unlock_rwlock(&router_lock);
+					route_read_end(route_slot);
 					return 0;
 				}
 				/* find a router that is still connected */
 				target_router = get_preferred_router(l, this_router, &target_fd);
 
-				tpp_unlock_rwlock(&router_lock);
+				route_read_end(route_slot);
 				if (target_router == NULL) {
 					tpp_log(LOG_WARNING, NULL, "tfd=%d, No connections to send TPP_CTL_NOROUTE", tfd);
 					return 0;
@@ -1966,25 +2601,38 @@ static tpp_router_t *
 get_preferred_router(tpp_leaf_t *l, tpp_router_t *this_router, int *fd)
 {
 	int i;
+	int tot;
+	int conn_fd;
+	tpp_router_t **rarr;
 	tpp_router_t *r = NULL;
+	tpp_router_t *rt;
 
 	*fd = -1;
 
-	if (l->conn_fd != -1) {
+	/*
+	 * called without router_lock from the forwarding path, so read
+	 * every field once, the leaf may be changing underneath
+	 */
+	conn_fd = ROUTE_LOAD(l->conn_fd);
+	if (conn_fd != -1) {
 		r = this_router;
-		*fd = l->conn_fd;
+		*fd = conn_fd;
 	} else {
 
 		/*
 		 * not directly connected to me, so search for a router
 		 * to which it is connected
 		 */
-		if (l->r) {
-			for (i = 0; i < l->tot_routers; i++) {
-				if (l->r[i]) {
-					if (l->r[i]->conn_fd != -1) {
-						r = l->r[i];
-						*fd = r->conn_fd;
+		tot = ROUTE_LOAD(l->tot_routers);
+		rarr = ROUTE_LOAD(l->r);
+		if (rarr) {
+			for (i = 0; i < tot; i++) {
+				rt = ROUTE_LOAD(rarr[i]);
+				if (rt) {
+					conn_fd = __atomic_load_n(&rt->conn_fd, __ATOMIC_RELAXED);
+					if (conn_fd != -1) {
+						r = rt;
+						*fd = conn_fd;
 						break;
 					}
 				}
@@ -2024,10 +2672,16 @@ del_router_from_leaf(tpp_leaf_t *l, int tfd)
 			(l->conn_fd == tfd && l->r[i]->conn_fd == -1))) {
 			TPP_DBPRT("Removing pbs_comm %s from leaf %s", l->r[i]->router_name, tpp_netaddr(&l->leaf_addrs[0]));
 			r = l->r[i];
-			l->r[i] = NULL;
+			ROUTE_STORE(l->r[i], NULL);
 			l->num_routers--;
-			if (l->num_routers == 0)
-				free(l->r);
+			if (l->num_routers == 0) {
+				tpp_router_t **rarr = l->r;
+
+				/* lookups may still be walking the array */
+				ROUTE_STORE(l->tot_routers, 0);
+				ROUTE_STORE(l->r, NULL);
+				route_retire(rarr, free);
+			}
 			TPP_DBPRT("pbs_comm count for leaf=%s is %d", tpp_netaddr(&l->leaf_addrs[0]), l->num_routers);
 			return r;
 		}
@@ -2070,15 +2724,28 @@ add_route_to_leaf(tpp_leaf_t *l, tpp_router_t *r, int index)
 	if (index >= l->tot_routers) {
 		int sz;
 		int i;
+		tpp_router_t **rarr;
+		tpp_router_t **old;
 
+		/*
+		 * do not realloc, lookups may still be walking the old array;
+		 * publish the new array before its size, retire the old one
+		 */
 		sz = index + 3;
-		l->r = realloc(l->r, sz * sizeof(tpp_router_t *));
-		for (i = l->tot_routers; i < sz; i++)
-			l->r[i] = NULL;
-		l->tot_routers = sz;
+		rarr = malloc(sz * sizeof(tpp_router_t *));
+		if (rarr == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Out of memory resizing leaf's pbs_comm list");
+			return -1;
+		}
+		for (i = 0; i < sz; i++)
+			rarr[i] = (l->r && i < l->tot_routers) ? l->r[i] : NULL;
+		old = l->r;
+		ROUTE_STORE(l->r, rarr);
+		ROUTE_STORE(l->tot_routers, sz);
+		route_retire(old, free);
 	}
 
-	l->r[index] = r;
+	ROUTE_STORE(l->r[index], r);
 	l->num_routers++;
 
 #ifdef DEBUG
@@ -2176,9 +2843,8 @@ tpp_init_router(struct tpp_config *cnf)
 		return -1;
 	}
 
-	cluster_leaves_idx = pbs_idx_create(0, sizeof(tpp_addr_t));
-	if (cluster_leaves_idx == NULL) {
-		tpp_log(LOG_CRIT, __func__, "Failed to create index for cluster leaves");
+	if (route_init(tpp_conf->numthreads) != 0) {
+		tpp_log(LOG_CRIT, __func__, "Failed to create routing table for cluster leaves");
 		return -1;
 	}
 
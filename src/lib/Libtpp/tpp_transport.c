@@ -145,6 +145,7 @@ typedef struct {
 #endif /* localmod 149 */
 	void *em_context;         /* the em context */
 	tpp_que_t def_act_que;  /* The deferred action queue on this thread */
+	tpp_que_t cork_que;     /* connections holding back sends (tfds) */
 	tpp_mbox_t mbox;     /* message box for this thread */
 	tpp_tls_t *tpp_tls;	/* tls data related to tpp work */
 } thrd_data_t;
@@ -186,7 +187,12 @@ typedef struct {
 
 	tpp_mbox_t send_mbox;     /* mbox of pkts to send */
 	tpp_chunk_t scratch;      /* scratch to work on incoming data */
-	tpp_packet_t *curr_send_pkt; /* current packet dequed from send_mbox to be sent out  */
+	tpp_que_t send_que;       /* pkts dequed from send_mbox, being written out */
+	int send_que_len;         /* number of pkts in send_que */
+	long long cork_until;     /* time (ms) until which sends are held, 0 if not */
+	int corked;               /* tfd is in the thread's cork_que */
+	unsigned long send_chunks; /* chunks written on this connection */
+	unsigned long send_calls; /* write calls made to write them */
 	thrd_data_t *td;          /* connections controller thread */
 
 	tpp_context_t *ctx;       /* upper layers context information */
@@ -205,12 +211,17 @@ int conns_array_size = 0;                    /* the size of physical connection
 pthread_rwlock_t cons_array_lock;            /* rwlock used to synchronize array ops */
 pthread_mutex_t thrd_array_lock;             /* mutex used to synchronize thrd assignment */
 
+/* limits on how much queued data is gathered into one write */
+#define TPP_SEND_MAX_IOV   64           /* chunks */
+#define TPP_SEND_MAX_PKTS  64           /* packets taken from send_mbox */
+#define TPP_SEND_MAX_BYTES (256 * 1024) /* bytes */
+
 /* function forward declarations */
 static void *work(void *v);
 static int assign_to_worker(int tfd, int delay, thrd_data_t *td);
 static int handle_disconnect(phy_conn_t *conn);
 static void handle_incoming_data(phy_conn_t *conn);
-static void send_data(phy_conn_t *conn);
+static void send_data(phy_conn_t *conn, int flush);
 static void free_phy_conn(phy_conn_t *conn);
 static void handle_cmd(thrd_data_t *td, int tfd, int cmd, void *data);
 static short add_pkt(phy_conn_t *conn);
@@ -317,6 +328,74 @@ trigger_deferred_events(thrd_data_t *td, time_t now)
 	return wait_time;
 }
 
+/**
+ * @brief
+ *	Return the current time in milliseconds, used for the send cork window
+ *
+ * @return time in milliseconds
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static long long
+tpp_time_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((long long) tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+/**
+ * @brief
+ *	Send out data held back on corked connections whose cork window
+ *	has expired
+ *
+ * @param[in] td   - The thread data for the controlling thread
+ *
+ * @return Wait time in milliseconds for the next cork to expire, -1 if none
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: No
+ *
+ */
+static int
+trigger_corked_sends(thrd_data_t *td)
+{
+	tpp_que_elem_t *n = NULL;
+	phy_conn_t *conn;
+	long long now;
+	long long wait_time = -1;
+	int slot_state;
+	int tfd;
+
+	if (TPP_QUE_HEAD(&td->cork_que) == NULL)
+		return -1;
+
+	now = tpp_time_ms();
+	while ((n = TPP_QUE_NEXT(&td->cork_que, n))) {
+		tfd = (int)(long) TPP_QUE_DATA(n);
+		conn = get_transport_atomic(tfd, &slot_state);
+		if (conn == NULL || slot_state != TPP_SLOT_BUSY || conn->cork_until == 0) {
+			/* gone, or already flushed by a full batch */
+			if (conn)
+				conn->corked = 0;
+			n = tpp_que_del_elem(&td->cork_que, n);
+			continue;
+		}
+		if (now >= conn->cork_until) {
+			conn->corked = 0;
+			n = tpp_que_del_elem(&td->cork_que, n);
+			send_data(conn, 1);
+		} else if (wait_time == -1 || conn->cork_until - now < wait_time) {
+			wait_time = conn->cork_until - now;
+		}
+	}
+	return (int) wait_time;
+}
+
 /**
  * @brief
  * Function called by upper layers to get the "thrd" that
@@ -583,6 +662,7 @@ tpp_transport_init(struct tpp_config *conf)
 
 		thrd_pool[i]->listen_fd = -1;
 		TPP_QUE_CLEAR(&thrd_pool[i]->def_act_que);
+		TPP_QUE_CLEAR(&thrd_pool[i]->cork_que);
 
 		if ((thrd_pool[i]->em_context = tpp_em_init(max_con)) == NULL) {
 			tpp_log(LOG_CRIT, __func__, "em_init() error, errno=%d", errno);
@@ -726,6 +806,7 @@ alloc_conn(int tfd)
 		return NULL;
 	}
 	/* initialize the send queue to empty */
+	TPP_QUE_CLEAR(&conn->send_que);
 
 	/* set to stream array */
 	if (tpp_write_lock(&cons_array_lock)) {
@@ -1342,6 +1423,8 @@ handle_cmd(thrd_data_t *td, int tfd, int cmd, void *data)
 		/* clean up the lazy conn queue */
 		while ((conn_ev = tpp_deque(&td->def_act_que)))
 			free(conn_ev);
+		while (TPP_QUE_HEAD(&td->cork_que))
+			(void) tpp_que_del_elem(&td->cork_que, TPP_QUE_HEAD(&td->cork_que));
 
 		tpp_log(LOG_INFO, NULL, "Thrd exiting, had %d connections", num_cons);
 
@@ -1376,7 +1459,7 @@ handle_cmd(thrd_data_t *td, int tfd, int cmd, void *data)
 		}
 
 		/* handle socket add calls */
-		send_data(conn);
+		send_data(conn, 0);
 
 	} else if (cmd == TPP_CMD_READ) {
 		add_pkt(conn);
@@ -1523,6 +1606,13 @@ work(void *v)
 				timeout = timeout * 1000; /* milliseconds */
 			}
 
+			/* flush expired send corks, and wake up for the next one */
+			timeout2 = trigger_corked_sends(td);
+			if (timeout2 != -1) {
+				if (timeout == -1 || timeout2 < timeout)
+					timeout = timeout2;
+			}
+
 			errno = 0;
 			nfds = tpp_em_wait(td->em_context, &events, timeout);
 			if (nfds <= 0) {
@@ -1558,8 +1648,13 @@ work(void *v)
 			if (em_fd == td->listen_fd) {
 				new_connection = 1;
 			} else {
+				/*
+				 * the fd could have been closed while handling an
+				 * earlier event of this batch, and already be reused
+				 * by a connection another thread manages
+				 */
 				conn = get_transport_atomic(em_fd, &slot_state);
-				if (conn == NULL || slot_state != TPP_SLOT_BUSY)
+				if (conn == NULL || slot_state != TPP_SLOT_BUSY || conn->td != td)
 					continue;
 
 				if ((em_ev & EM_HUP) || (em_ev & EM_ERR)) {
@@ -1613,7 +1708,7 @@ work(void *v)
 							tpp_log(LOG_ERR, __func__, "Multiplexing failed");
 							return NULL;
 						}
-						send_data(conn);
+						send_data(conn, 1);
 					}
 				}
 			}
@@ -1906,8 +2001,8 @@ add_pkt(phy_conn_t *conn)
 
 /**
  * @brief
- *	Loop over the list of queued data and send out packet by packet
- *	Stop if sending would block.
+ *	Move packets from the connection's send_mbox to its send_que, calling
+ *	the presend handler on each, until TPP_SEND_MAX_PKTS are queued.
  *
  * @param[in] conn - The physical connection
  *
@@ -1918,13 +2013,119 @@ add_pkt(phy_conn_t *conn)
  *
  */
 static void
-send_data(phy_conn_t *conn)
+fill_send_que(phy_conn_t *conn)
 {
-	tpp_chunk_t *p = NULL;
 	tpp_packet_t *pkt = NULL;
+
+	while (conn->send_que_len < TPP_SEND_MAX_PKTS) {
+		/* get the next packet from send_mbox */
+		if (tpp_mbox_read(&conn->send_mbox, NULL, NULL, (void **) &pkt) != 0) {
+			if (!(errno == EAGAIN || errno == EWOULDBLOCK))
+				tpp_log(LOG_ERR, __func__, "tpp_mbox_read failed");
+			return;
+		}
+
+		/* presend handler could change pkt contents, or reject it */
+		if (pkt->curr_chunk && the_pkt_presend_handler &&
+			the_pkt_presend_handler(conn->sock_fd, pkt, conn->ctx, conn->extra) != 0) {
+			tpp_free_pkt(pkt);
+			continue;
+		}
+		if (pkt->curr_chunk == NULL) {
+			tpp_free_pkt(pkt);
+			continue;
+		}
+		if (tpp_enque(&conn->send_que, pkt) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Out of memory queueing packet to send");
+			tpp_free_pkt(pkt);
+			return;
+		}
+		conn->send_que_len++;
+	}
+}
+
+/**
+ * @brief
+ *	Account for bytes written out, advancing through the chunks of the
+ *	packets in send_que and freeing the packets that are done.
+ *
+ * @param[in] conn - The physical connection
+ * @param[in] sent - Number of bytes written
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: No
+ *
+ */
+static void
+consume_send_que(phy_conn_t *conn, size_t sent)
+{
+	tpp_packet_t *pkt;
+	tpp_chunk_t *p;
+	size_t left;
+
+	while ((pkt = TPP_QUE_DATA(TPP_QUE_HEAD(&conn->send_que)))) {
+		p = pkt->curr_chunk;
+		while (p) {
+			left = p->len - (p->pos - p->data);
+			if (left > sent) {
+				p->pos += sent;
+				sent = 0;
+				break;
+			}
+			p->pos += left;
+			sent -= left;
+			conn->send_chunks++;
+			p = GET_NEXT(p->chunk_link);
+			if (p)
+				pkt->curr_chunk = p;
+		}
+		if (p)
+			return; /* packet partly written */
+
+		/*
+		 * all data in this packet has been sent or done with.
+		 * delete this node and get next node in queue
+		 */
+		tpp_deque(&conn->send_que);
+		conn->send_que_len--;
+		tpp_free_pkt(pkt);
+	}
+}
+
+/**
+ * @brief
+ *	Loop over the list of queued data and send it out, gathering the
+ *	chunks of as many queued packets as fit (up to TPP_SEND_MAX_IOV
+ *	chunks and TPP_SEND_MAX_BYTES bytes) into a single writev call.
+ *	Stop if sending would block.
+ *
+ * @par
+ *	If a send cork window is configured (PBS_TPP_SEND_CORK), and less than
+ *	TPP_SEND_MAX_BYTES are waiting, the data is held for up to that
+ *	window so that more packets can be batched into the same write.
+ *
+ * @param[in] conn  - The physical connection
+ * @param[in] flush - Send now, ignoring the cork window
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: No
+ *
+ */
+static void
+send_data(phy_conn_t *conn, int flush)
+{
+	struct iovec iov[TPP_SEND_MAX_IOV];
+	tpp_que_elem_t *n;
+	tpp_packet_t *pkt;
+	tpp_chunk_t *p;
 	ssize_t rc;
-	int curr_pkt_done = 0;
 	size_t tosend;
+	size_t len;
+	int niov;
 
 	/*
 	 * if a socket is still connecting, we will wait to send out data,
@@ -1933,71 +2134,69 @@ send_data(phy_conn_t *conn)
 	if ((conn->net_state == TPP_CONN_CONNECTING) || (conn->net_state == TPP_CONN_INITIATING))
 		return;
 
-	while ((conn->ev_mask & EM_OUT) == 0) {
-		rc = 0;
-		curr_pkt_done = 0;
-
-		pkt = conn->curr_send_pkt;
-		if (!pkt) {
-			/* get the next packet from send_mbox */
-			if (tpp_mbox_read(&conn->send_mbox, NULL, NULL, (void **) &conn->curr_send_pkt) != 0) {
-				if (!(errno == EAGAIN || errno == EWOULDBLOCK))
-					tpp_log(LOG_ERR, __func__, "tpp_mbox_read failed");
+	if (!flush && tpp_conf->send_cork_ms > 0 && TPP_QUE_HEAD(&conn->send_que) == NULL &&
+		conn->send_mbox.mbox_size < TPP_SEND_MAX_BYTES) {
+		/* mbox_size is read without the lock, it is only a hint */
+		if (conn->cork_until == 0)
+			conn->cork_until = tpp_time_ms() + tpp_conf->send_cork_ms;
+		if (!conn->corked) {
+			if (tpp_enque(&conn->td->cork_que, (void *)(long) conn->sock_fd) != NULL) {
+				conn->corked = 1;
 				return;
 			}
-			pkt = conn->curr_send_pkt;
-		}
-		p = pkt->curr_chunk;
+		} else
+			return;
+	}
+	conn->cork_until = 0;
 
-		/* data available, first byte, presend handler present, call handler */
-		if ((p == GET_NEXT(pkt->chunks)) && (p->pos == p->data) && the_pkt_presend_handler) {
-			if ((rc = the_pkt_presend_handler(conn->sock_fd, pkt, conn->ctx, conn->extra)) == 0) {
-				p = pkt->curr_chunk; /* presend handler could change pkt contents */
+	while ((conn->ev_mask & EM_OUT) == 0) {
+		fill_send_que(conn);
+
+		niov = 0;
+		tosend = 0;
+		n = NULL;
+		while ((niov < TPP_SEND_MAX_IOV) && (tosend < TPP_SEND_MAX_BYTES) &&
+			(n = TPP_QUE_NEXT(&conn->send_que, n))) {
+			pkt = TPP_QUE_DATA(n);
+			for (p = pkt->curr_chunk; p && niov < TPP_SEND_MAX_IOV; p = GET_NEXT(p->chunk_link)) {
+				len = p->len - (p->pos - p->data);
+				if (len == 0)
+					continue;
+				iov[niov].iov_base = p->pos;
+				iov[niov].iov_len = len;
+				niov++;
+				tosend += len;
 			}
 		}
 
-		if (p && (rc == 0)) {
-			tosend = p->len - (p->pos - p->data);
-			while (tosend > 0) {
-				rc = tpp_sock_send(conn->sock_fd, p->pos, tosend, 0);
-				if (rc < 0) {
-					if (errno == EWOULDBLOCK || errno == EAGAIN) {
-						/* set this socket in POLLOUT */
-						conn->ev_mask |= EM_OUT;
-						TPP_DBPRT("EWOULDBLOCK, added EM_OUT to ev_mask, now=%x", conn->ev_mask);
-						if (tpp_em_mod_fd(conn->td->em_context, conn->sock_fd, conn->ev_mask)	== -1) {
-							tpp_log(LOG_ERR, __func__, "Multiplexing failed");
-							return;
-						}
-					} else {
-						handle_disconnect(conn);
-						return;
-					}
-					break;
-				}
-				TPP_DBPRT("tfd=%d, tosend=%d, sent=%d bytes", conn->sock_fd, tosend, rc);
-				p->pos += rc;
-				tosend -= rc;
-			}
+		if (niov == 0) {
+			if (TPP_QUE_HEAD(&conn->send_que) == NULL)
+				return; /* nothing left to send */
 
-			if (tosend == 0) {
-				p = GET_NEXT(p->chunk_link);
-				if (p)
-					pkt->curr_chunk = p;
-				else
-					curr_pkt_done = 1;
-			}
-		} else
-			curr_pkt_done = 1;
+			/* only empty chunks left, drop those packets */
+			consume_send_que(conn, 0);
+			continue;
+		}
 
-		if (pkt && curr_pkt_done) {
-			/*
-			* all data in this packet has been sent or done with.
-			* delete this node and get next node in queue
-			*/
-			tpp_free_pkt(pkt);
-			conn->curr_send_pkt = NULL;
+		rc = tpp_sock_writev(conn->sock_fd, iov, niov);
+		if (rc < 0) {
+			if (errno == EWOULDBLOCK || errno == EAGAIN) {
+				/* set this socket in POLLOUT */
+				conn->ev_mask |= EM_OUT;
+				TPP_DBPRT("EWOULDBLOCK, added EM_OUT to ev_mask, now=%x", conn->ev_mask);
+				if (tpp_em_mod_fd(conn->td->em_context, conn->sock_fd, conn->ev_mask) == -1) {
+					tpp_log(LOG_ERR, __func__, "Multiplexing failed");
+					return;
+				}
+			} else if (errno != EINTR) {
+				handle_disconnect(conn);
+				return;
+			}
+			continue;
 		}
+		TPP_DBPRT("tfd=%d, tosend=%d, sent=%d bytes in %d chunks", conn->sock_fd, tosend, rc, niov);
+		conn->send_calls++;
+		consume_send_que(conn, rc);
 	}
 }
 
@@ -2033,6 +2232,13 @@ free_phy_conn(phy_conn_t *conn)
 		if (cmd == TPP_CMD_SEND)
 			tpp_free_pkt(pkt);
 	}
+	while ((pkt = tpp_deque(&conn->send_que)))
+		tpp_free_pkt(pkt);
+
+	if (conn->send_calls > 0 && conn->send_chunks > conn->send_calls)
+		tpp_log(LOG_INFO, NULL, "tfd=%d, sent %lu chunks in %lu writes, saved %lu send calls",
+			conn->sock_fd, conn->send_chunks, conn->send_calls,
+			conn->send_chunks - conn->send_calls);
 
 	tpp_mbox_destroy(&conn->send_mbox);
 
@@ -74,6 +74,9 @@
 #ifdef PBS_COMPRESSION_ENABLED
 #include <zlib.h>
 #endif
+#ifdef PBS_ZSTD_ENABLED
+#include <zstd.h>
+#endif
 
 #define BACKTRACE_SIZE 100
 #include <execinfo.h>
@@ -99,6 +102,10 @@ long tpp_log_event_mask = 0;
 #define DEFAULT_TCP_USER_TIMEOUT 60000
 
 #define PBS_TCP_KEEPALIVE "PBS_TCP_KEEPALIVE" /* environment string to search for */
+#define PBS_TPP_SEND_CORK "PBS_TPP_SEND_CORK" /* send corking window in milliseconds */
+#define TPP_MAX_SEND_CORK 1000
+#define PBS_TPP_CODEC "PBS_TPP_COMPRESSION_CODEC" /* zlib, fast or zstd */
+#define PBS_TPP_COMPR_MIN "PBS_TPP_COMPRESSION_MIN" /* only larger messages are compressed */
 
 /* extern functions called from this file into the tpp_transport.c */
 static pbs_tcp_chan_t * tppdis_get_user_data(int sd);
@@ -375,6 +382,25 @@ set_tpp_config(struct pbs_config *pbs_conf, struct tpp_config *tpp_conf, char *n
 #else
 	tpp_conf->compress = 0;
 #endif
+	tpp_conf->codec = TPP_CODEC_ZLIB;
+	tpp_conf->compr_min_size = TPP_COMPR_SIZE;
+
+	if ((s = getenv(PBS_TPP_CODEC))) {
+		int codec = tpp_codec_parse(s);
+
+		if (codec == -1 || !(tpp_codecs_supported() & TPP_CODEC_BIT(codec)))
+			tpp_log(LOG_CRIT, NULL, "Compression codec %s not supported, using %s", s, tpp_codec_name(tpp_conf->codec));
+		else
+			tpp_conf->codec = codec;
+	}
+	if ((s = getenv(PBS_TPP_COMPR_MIN))) {
+		tpp_conf->compr_min_size = (int) atol(s);
+		if (tpp_conf->compr_min_size < 0)
+			tpp_conf->compr_min_size = 0;
+	}
+	if (tpp_conf->compress == 1)
+		tpp_log(LOG_INFO, NULL, "Compressing messages larger than %d bytes with codec %s",
+			tpp_conf->compr_min_size, tpp_codec_name(tpp_conf->codec));
 
 	/* set default parameters for keepalive */
 	tpp_conf->tcp_keepalive = 1;
@@ -429,6 +455,21 @@ set_tpp_config(struct pbs_config *pbs_conf, struct tpp_config *tpp_conf, char *n
 
 	tpp_conf->buf_limit_per_conn = 5000; /* size in KB, TODO: load from pbs.conf */
 
+	/*
+	 * if set, small sends on a connection are held for up to this many
+	 * milliseconds so that they go out together in one write
+	 */
+	tpp_conf->send_cork_ms = 0;
+	if ((s = getenv(PBS_TPP_SEND_CORK))) {
+		tpp_conf->send_cork_ms = (int) atol(s);
+		if (tpp_conf->send_cork_ms < 0)
+			tpp_conf->send_cork_ms = 0;
+		else if (tpp_conf->send_cork_ms > TPP_MAX_SEND_CORK)
+			tpp_conf->send_cork_ms = TPP_MAX_SEND_CORK;
+		if (tpp_conf->send_cork_ms > 0)
+			tpp_log(LOG_CRIT, NULL, "Using send cork window of %d ms", tpp_conf->send_cork_ms);
+	}
+
 	if (routers && routers[0] != '\0') {
 		char *p = routers;
 		char *q;
@@ -652,6 +693,363 @@ tpp_handle_auth_handshake(int tfd, int conn_fd, conn_auth_t *authdata, int for_e
 	return 1;
 }
 
+/*
+ * Pools of free packets, chunks, queue elements and data buffers.
+ *
+ * Every message sent or received needs a packet, one or more chunks,
+ * their data buffers and queue elements to pass it between threads.
+ * Instead of going to malloc for each of these, freed objects are kept
+ * in a cache private to the freeing thread. A thread whose cache grows
+ * too large hands a batch of objects over to a shared depot, and a
+ * thread whose cache is empty takes a batch from it. Packets are mostly
+ * built on one thread and freed on another (an IO thread), so this lets
+ * objects flow back to the building threads, while the depot lock is
+ * taken only once per batch.
+ *
+ * Data buffers are rounded up to a power of 2 size class; larger ones
+ * are malloc'ed directly. Every buffer carries a reference count so the
+ * same payload can be shared by the packets sent to several destinations
+ * (see tpp_bld_pkt_ref).
+ */
+#define TPP_POOL_PKT		0
+#define TPP_POOL_CHUNK		1
+#define TPP_POOL_QUE		2
+#define TPP_POOL_BUF		3	/* pool of the smallest buffer class */
+#define TPP_BUF_MIN_SHIFT	6	/* smallest buffer class, 64 bytes */
+#define TPP_BUF_CLASSES		9	/* classes from 64 bytes to 16KB */
+#define TPP_POOL_MAX		(TPP_POOL_BUF + TPP_BUF_CLASSES)
+#define TPP_POOL_BATCH		32	/* objects moved to or from the depot at once */
+#define TPP_POOL_DEPOT_BATCHES	64	/* max batches kept in a depot */
+#define TPP_POOL_DEPOT_BYTES	(8 * 1024 * 1024) /* max bytes kept in a depot */
+
+typedef struct tpp_pool_obj {
+	struct tpp_pool_obj *next;
+} tpp_pool_obj_t;
+
+typedef struct {
+	tpp_pool_obj_t *head;
+	int count;
+} tpp_pool_cache_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	int nbatch;
+	int max_batches;
+	size_t objsz;
+	tpp_pool_obj_t *batch[TPP_POOL_DEPOT_BATCHES];
+} tpp_pool_depot_t;
+
+static tpp_pool_depot_t tpp_pool_depot[TPP_POOL_MAX];
+
+/* header in front of the data of every buffer */
+typedef union {
+	struct {
+		int ref_count;
+		int pool;	/* pool index, -1 if malloc'ed directly */
+	} h;
+	long double align;	/* keep the data aligned like malloc does */
+} tpp_buf_hdr_t;
+
+/**
+ * @brief
+ *	Initialize the shared depots of the object pools
+ *
+ * @par MT-safe: No, called once from tpp_init_tls_key_once
+ *
+ */
+static void
+tpp_pool_init(void)
+{
+	int i;
+	tpp_pool_depot_t *d;
+
+	for (i = 0; i < TPP_POOL_MAX; i++) {
+		d = &tpp_pool_depot[i];
+		pthread_mutex_init(&d->lock, NULL);
+		d->nbatch = 0;
+		if (i == TPP_POOL_PKT)
+			d->objsz = sizeof(tpp_packet_t);
+		else if (i == TPP_POOL_CHUNK)
+			d->objsz = sizeof(tpp_chunk_t);
+		else if (i == TPP_POOL_QUE)
+			d->objsz = sizeof(tpp_que_elem_t);
+		else
+			d->objsz = sizeof(tpp_buf_hdr_t) + ((size_t) 1 << (TPP_BUF_MIN_SHIFT + i - TPP_POOL_BUF));
+
+		d->max_batches = TPP_POOL_DEPOT_BYTES / (TPP_POOL_BATCH * d->objsz);
+		if (d->max_batches > TPP_POOL_DEPOT_BATCHES)
+			d->max_batches = TPP_POOL_DEPOT_BATCHES;
+		if (d->max_batches < 1)
+			d->max_batches = 1;
+	}
+}
+
+/**
+ * @brief
+ *	Get the object pool caches of the calling thread
+ *
+ * @return array of TPP_POOL_MAX caches
+ * @retval NULL - Failure, caller must use malloc/free directly
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_pool_cache_t *
+tpp_pool_caches(void)
+{
+	tpp_tls_t *tls;
+
+	if ((tls = tpp_get_tls()) == NULL)
+		return NULL;
+	if (tls->pools == NULL)
+		tls->pools = calloc(TPP_POOL_MAX, sizeof(tpp_pool_cache_t));
+	return (tpp_pool_cache_t *) tls->pools;
+}
+
+/**
+ * @brief
+ *	Get an object from a pool, allocate one if the pool is empty
+ *
+ * @param[in] pool - index of the pool
+ *
+ * @return the object (uninitialized)
+ * @retval NULL - Out of memory
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void *
+tpp_pool_get(int pool)
+{
+	tpp_pool_cache_t *c;
+	tpp_pool_depot_t *d = &tpp_pool_depot[pool];
+	tpp_pool_obj_t *o;
+
+	if ((c = tpp_pool_caches()) != NULL) {
+		c = &c[pool];
+		if (c->head == NULL && __atomic_load_n(&d->nbatch, __ATOMIC_RELAXED) > 0) {
+			pthread_mutex_lock(&d->lock);
+			if (d->nbatch > 0) {
+				c->head = d->batch[--d->nbatch];
+				c->count = TPP_POOL_BATCH;
+			}
+			pthread_mutex_unlock(&d->lock);
+		}
+		if ((o = c->head) != NULL) {
+			c->head = o->next;
+			c->count--;
+			return o;
+		}
+	}
+	return malloc(d->objsz);
+}
+
+/**
+ * @brief
+ *	Return an object to a pool
+ *
+ * @param[in] pool - index of the pool
+ * @param[in] p - the object, allocated by tpp_pool_get from the same pool
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+tpp_pool_put(int pool, void *p)
+{
+	tpp_pool_cache_t *c;
+	tpp_pool_depot_t *d;
+	tpp_pool_obj_t *o = p;
+	tpp_pool_obj_t *b, *t;
+	int i;
+
+	if ((c = tpp_pool_caches()) == NULL) {
+		free(p);
+		return;
+	}
+	c = &c[pool];
+	o->next = c->head;
+	c->head = o;
+	if (++c->count < 2 * TPP_POOL_BATCH)
+		return;
+
+	/* split off a batch and hand it to the depot */
+	b = c->head;
+	for (i = 1, t = b; i < TPP_POOL_BATCH; i++)
+		t = t->next;
+	c->head = t->next;
+	c->count -= TPP_POOL_BATCH;
+	t->next = NULL;
+
+	d = &tpp_pool_depot[pool];
+	pthread_mutex_lock(&d->lock);
+	if (d->nbatch < d->max_batches) {
+		d->batch[d->nbatch++] = b;
+		b = NULL;
+	}
+	pthread_mutex_unlock(&d->lock);
+
+	/* depot full, give the batch back to the system */
+	while (b) {
+		t = b->next;
+		free(b);
+		b = t;
+	}
+}
+
+/**
+ * @brief
+ *	Destructor of the TPP thread local data, frees the pool caches
+ *	of the exiting thread
+ *
+ * @param[in] p - the tpp_tls_t of the thread
+ *
+ */
+static void
+tpp_tls_destroy(void *p)
+{
+	tpp_tls_t *tls = p;
+	tpp_pool_cache_t *c;
+	tpp_pool_obj_t *o;
+	int i;
+
+	if (tls == NULL)
+		return;
+
+	if ((c = tls->pools) != NULL) {
+		for (i = 0; i < TPP_POOL_MAX; i++) {
+			while ((o = c[i].head)) {
+				c[i].head = o->next;
+				free(o);
+			}
+		}
+		free(c);
+	}
+	free(tls);
+}
+
+/**
+ * @brief
+ *	Allocate a refcounted data buffer, with a reference count of 1
+ *
+ * @param[in] len - size of the buffer
+ *
+ * @return the buffer
+ * @retval NULL - Out of memory
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void *
+tpp_buf_alloc(size_t len)
+{
+	tpp_buf_hdr_t *h;
+	size_t sz = (size_t) 1 << TPP_BUF_MIN_SHIFT;
+	int cls;
+	int pool = -1;
+
+	for (cls = 0; cls < TPP_BUF_CLASSES && sz < len; cls++)
+		sz <<= 1;
+
+	if (cls < TPP_BUF_CLASSES) {
+		pool = TPP_POOL_BUF + cls;
+		h = tpp_pool_get(pool);
+	} else
+		h = malloc(sizeof(tpp_buf_hdr_t) + len);
+	if (h == NULL)
+		return NULL;
+
+	h->h.ref_count = 1;
+	h->h.pool = pool;
+	return h + 1;
+}
+
+/**
+ * @brief
+ *	Drop a reference to a buffer from tpp_buf_alloc, and free it when
+ *	the last reference is gone
+ *
+ * @param[in] buf - the buffer
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+tpp_buf_release(void *buf)
+{
+	tpp_buf_hdr_t *h;
+
+	if (buf == NULL)
+		return;
+
+	h = ((tpp_buf_hdr_t *) buf) - 1;
+	if (__atomic_sub_fetch(&h->h.ref_count, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+
+	if (h->h.pool == -1)
+		free(h);
+	else
+		tpp_pool_put(h->h.pool, h);
+}
+
+/**
+ * @brief
+ *	Add a chunk for the given data at the end of a packet, creating
+ *	the packet if required
+ *
+ * @param[in] - pkt  - Pointer to packet to add chunk, or create new packet if NULL
+ * @param[in] - d - data of the chunk, owned by the chunk from now on
+ * @param[in] - len  - Length of data buffer
+ * @param[in] - pooled - whether d is a buffer from tpp_buf_alloc
+ *
+ * @return the packet
+ * @retval NULL - Failure (Out of memory), pkt has been freed and the
+ *		  reference to d dropped if pooled, else d is left to the caller
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_packet_t *
+tpp_add_chunk(tpp_packet_t *pkt, void *d, int len, int pooled)
+{
+	tpp_chunk_t *chunk;
+
+	if ((chunk = tpp_pool_get(TPP_POOL_CHUNK)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Failed to build chunk");
+		goto err;
+	}
+	chunk->data = d;
+	chunk->pos = chunk->data;
+	chunk->len = len;
+	chunk->pooled = pooled;
+	CLEAR_LINK(chunk->chunk_link);
+
+	/* add chunk to packet */
+	/* if packet NULL, create packet now and add chunk */
+	if (pkt == NULL) {
+		if ((pkt = tpp_pool_get(TPP_POOL_PKT)) == NULL) {
+			tpp_pool_put(TPP_POOL_CHUNK, chunk);
+			tpp_log(LOG_CRIT, __func__, "Out of memory allocating packet");
+			goto err;
+		}
+		CLEAR_HEAD(pkt->chunks);
+		pkt->ref_count = 1;
+		pkt->totlen = 0;
+		pkt->curr_chunk = chunk;
+	}
+
+	pkt->totlen += len;
+	append_link(&pkt->chunks, &chunk->chunk_link, chunk);
+
+	return pkt;
+
+err:
+	if (pooled)
+		tpp_buf_release(d);
+	tpp_free_pkt(pkt);
+	return NULL;
+}
+
 /**
  * @brief
  *	Create a packet structure from the inputs provided
@@ -675,56 +1073,53 @@ tpp_handle_auth_handshake(int tfd, int conn_fd, conn_auth_t *authdata, int for_e
 tpp_packet_t *
 tpp_bld_pkt(tpp_packet_t *pkt, void *data, int len, int dup, void **dup_data)
 {
-	tpp_chunk_t *chunk;
 	void *d = data;
 
-	/* first create the requested chunk for the packet */
-	if ((chunk = malloc(sizeof(tpp_chunk_t))) == NULL) {
-		tpp_log(LOG_CRIT, __func__, "Failed to build chunk");
-		tpp_free_pkt(pkt);
-		return NULL;
-	}
 	/* dup flag was provided, so allocate space */
 	if (dup) {
-		d = malloc(len);
+		d = tpp_buf_alloc(len);
 		if (!d) {
 			tpp_log(LOG_CRIT, __func__, "Out of memory allocating packet duplicate data for chunk");
-			free(chunk);
 			tpp_free_pkt(pkt);
 			return NULL;
 		}
 		if (data)
 			memcpy(d, data, len);
-		if (dup_data)
-			*dup_data = d; /* return allocated data ptr */
-	}
-	chunk->data = d;
-	chunk->pos = chunk->data;
-	chunk->len = len;
-	CLEAR_LINK(chunk->chunk_link);
-
-	/* add chunk to packet */
-	/* if packet NULL, create packet now and add chunk */
-	if (pkt == NULL) {
-		if ((pkt = malloc(sizeof(tpp_packet_t))) == NULL) {
-			if (d != data)
-				free(d);
-			tpp_free_pkt(pkt);
-			tpp_log(LOG_CRIT, __func__, "Out of memory allocating packet");
-			return NULL;
-		}
-		CLEAR_HEAD(pkt->chunks);
-		pkt->ref_count = 1;
-		pkt->totlen = 0;
-		pkt->curr_chunk = chunk;
 	}
 
-	pkt->totlen += len;
-	append_link(&pkt->chunks, &chunk->chunk_link, chunk);
+	pkt = tpp_add_chunk(pkt, d, len, dup);
+	if (pkt && dup && dup_data)
+		*dup_data = d; /* return allocated data ptr */
 
 	return pkt;
 }
 
+/**
+ * @brief
+ *	Add a chunk to a packet that shares a buffer from tpp_buf_alloc,
+ *	instead of copying the data. The buffer must not be modified anymore
+ *	once shared.
+ *
+ * @param[in] - pkt  - Pointer to packet to add chunk, or create new packet if NULL
+ * @param[in] - buf - the buffer, the chunk takes its own reference to it
+ * @param[in] - len  - Length of data in buffer
+ *
+ * @return The packet
+ * @retval NULL - Failure (Out of memory), pkt has been freed
+ * @retval !NULL - Address of packet structure
+ *
+ * @par MT-safe: Yes
+ *
+ */
+tpp_packet_t *
+tpp_bld_pkt_ref(tpp_packet_t *pkt, void *buf, int len)
+{
+	tpp_buf_hdr_t *h = ((tpp_buf_hdr_t *) buf) - 1;
+
+	__atomic_add_fetch(&h->h.ref_count, 1, __ATOMIC_RELAXED);
+	return tpp_add_chunk(pkt, buf, len, 1);
+}
+
 /**
  * @brief
  *	Free a chunk
@@ -742,8 +1137,11 @@ tpp_free_chunk(tpp_chunk_t *chunk)
 {
 	if (chunk) {
 		delete_link(&chunk->chunk_link);
-		free(chunk->data);
-		free(chunk);
+		if (chunk->pooled)
+			tpp_buf_release(chunk->data);
+		else
+			free(chunk->data);
+		tpp_pool_put(TPP_POOL_CHUNK, chunk);
 	}
 }
 
@@ -769,7 +1167,7 @@ tpp_free_pkt(tpp_packet_t *pkt)
 			tpp_chunk_t *chunk;
 			while((chunk = GET_NEXT(pkt->chunks)))
 				tpp_free_chunk(chunk);
-			free(pkt);
+			tpp_pool_put(TPP_POOL_PKT, pkt);
 		}
 	}
 }
@@ -1270,7 +1668,7 @@ tpp_enque(tpp_que_t *l, void *data)
 {
 	tpp_que_elem_t *nd;
 
-	if ((nd = malloc(sizeof(tpp_que_elem_t))) == NULL) {
+	if ((nd = tpp_pool_get(TPP_POOL_QUE)) == NULL) {
 		return NULL;
 	}
 	nd->queue_data = data;
@@ -1326,7 +1724,7 @@ tpp_deque(tpp_que_t *l)
 			l->head->prev = NULL;
 		else
 			l->tail = NULL;
-		free(p);
+		tpp_pool_put(TPP_POOL_QUE, p);
 	}
 	return data;
 }
@@ -1381,7 +1779,7 @@ tpp_que_del_elem(tpp_que_t *l, tpp_que_elem_t *n)
 		if (n->prev)
 			p = n->prev;
 		/* else return p as NULL, so list QUE_NEXT starts from head again */
-		free(n);
+		tpp_pool_put(TPP_POOL_QUE, n);
 	}
 	return p;
 }
@@ -1419,7 +1817,7 @@ tpp_que_ins_elem(tpp_que_t *l, tpp_que_elem_t *n, void *data, int before)
 	tpp_que_elem_t *nd = NULL;
 
 	if (n) {
-		if ((nd = malloc(sizeof(tpp_que_elem_t))) == NULL) {
+		if ((nd = tpp_pool_get(TPP_POOL_QUE)) == NULL) {
 			return NULL;
 		}
 		nd->queue_data = data;
@@ -1552,9 +1950,10 @@ mk_hostname(char *host, int port)
 static void
 tpp_init_tls_key_once(void)
 {
-	if (pthread_key_create(&tpp_key_tls, NULL) != 0) {
+	if (pthread_key_create(&tpp_key_tls, tpp_tls_destroy) != 0) {
 		fprintf(stderr, "Failed to initialize TLS key\n");
 	}
+	tpp_pool_init();
 }
 
 /**
@@ -1610,9 +2009,184 @@ tpp_get_tls()
 	return (tpp_tls_t *) ptr; /* thread data already initialized */
 }
 
+/*
+ * Names of the compression codecs, indexed by TPP_CODEC_*
+ */
+static char *tpp_codec_names[TPP_CODEC_MAX] = {"zlib", "fast", "zstd"};
+
+/**
+ * @brief
+ *	Get the codec id for a codec name
+ *
+ * @param[in] name - name of the codec
+ *
+ * @return codec id
+ * @retval -1 - unknown codec
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_codec_parse(char *name)
+{
+	int i;
+
+	for (i = 0; i < TPP_CODEC_MAX; i++) {
+		if (strcasecmp(name, tpp_codec_names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * @brief
+ *	Get the name of a codec
+ *
+ * @param[in] codec - codec id
+ *
+ * @return name of the codec
+ *
+ * @par MT-safe: Yes
+ *
+ */
+char *
+tpp_codec_name(int codec)
+{
+	if (codec < 0 || codec >= TPP_CODEC_MAX)
+		return "unknown";
+	return tpp_codec_names[codec];
+}
+
+/**
+ * @brief
+ *	Find the codec that compressed a piece of data
+ *
+ * @param[in] data - the compressed data
+ * @param[in] len - length of data
+ *
+ * @return codec id, TPP_CODEC_ZLIB for untagged data
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_codec_of(void *data, unsigned int len)
+{
+	tpp_codec_tag_t *tag = data;
+
+	if (len >= sizeof(tpp_codec_tag_t) && memcmp(tag->magic, TPP_CODEC_MAGIC, sizeof(tag->magic)) == 0)
+		return tag->codec;
+	return TPP_CODEC_ZLIB;
+}
+
+/**
+ * @brief
+ *	Get the codecs this process can decompress
+ *
+ * @return mask of TPP_CODEC_BIT() of each supported codec
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_codecs_supported(void)
+{
+	int codecs = 0;
+
+#ifdef PBS_COMPRESSION_ENABLED
+	codecs |= TPP_CODECS_ZLIB;
+#endif
+#ifdef PBS_ZSTD_ENABLED
+	codecs |= TPP_CODEC_BIT(TPP_CODEC_ZSTD);
+#endif
+	return codecs;
+}
+
 #ifdef PBS_COMPRESSION_ENABLED
 
 #define COMPR_LEVEL Z_DEFAULT_COMPRESSION
+#define COMPR_LEVEL_FAST Z_BEST_SPEED
+#define ZSTD_LEVEL 1
+
+/*
+ * Compression counters of each codec, logged every TPP_CODEC_STATS_INTVL
+ * seconds while compression is in use
+ */
+#define TPP_CODEC_STATS_INTVL 300
+
+typedef struct {
+	unsigned long long cmpr_msgs;
+	unsigned long long cmpr_in;   /* bytes before compression */
+	unsigned long long cmpr_out;  /* bytes after compression */
+	unsigned long long cmpr_usec;
+	unsigned long long cmpr_skip; /* messages sent uncompressed as they would not shrink */
+	unsigned long long dcmpr_msgs;
+	unsigned long long dcmpr_usec;
+} tpp_codec_stats_t;
+
+static tpp_codec_stats_t tpp_codec_stats[TPP_CODEC_MAX];
+static time_t tpp_codec_stats_next = 0;
+
+#define CODEC_STAT_ADD(c, f, v) __atomic_add_fetch(&tpp_codec_stats[c].f, (v), __ATOMIC_RELAXED)
+
+static long long
+tpp_codec_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((long long) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+/**
+ * @brief
+ *	Log the compression counters of each codec in use, at most once
+ *	every TPP_CODEC_STATS_INTVL seconds
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+tpp_codec_log_stats(void)
+{
+	time_t now = time(NULL);
+	time_t next = __atomic_load_n(&tpp_codec_stats_next, __ATOMIC_RELAXED);
+	tpp_codec_stats_t *st;
+	int i;
+
+	if (now < next)
+		return;
+	/* only one thread gets to log */
+	if (!__atomic_compare_exchange_n(&tpp_codec_stats_next, &next, now + TPP_CODEC_STATS_INTVL, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return;
+	if (next == 0)
+		return; /* first call, just start the interval */
+
+	for (i = 0; i < TPP_CODEC_MAX; i++) {
+		st = &tpp_codec_stats[i];
+		if (st->cmpr_msgs == 0 && st->dcmpr_msgs == 0 && st->cmpr_skip == 0)
+			continue;
+		tpp_log(LOG_INFO, NULL, "codec %s: compressed %llu msgs, %llu -> %llu bytes (ratio %.2f), %llu ms; %llu not compressible; decompressed %llu msgs, %llu ms",
+			tpp_codec_names[i], st->cmpr_msgs, st->cmpr_in, st->cmpr_out,
+			(st->cmpr_out > 0) ? (double) st->cmpr_in / st->cmpr_out : 0.0,
+			st->cmpr_usec / 1000, st->cmpr_skip, st->dcmpr_msgs, st->dcmpr_usec / 1000);
+	}
+}
+
+/**
+ * @brief
+ *	Get the zlib compression level to use for a codec
+ *
+ * @param[in] codec - the codec
+ *
+ * @return zlib compression level
+ *
+ */
+static int
+tpp_zlib_level(int codec)
+{
+	return (codec == TPP_CODEC_ZLIB) ? COMPR_LEVEL : COMPR_LEVEL_FAST;
+}
 
 struct def_ctx {
 	z_stream cmpr_strm;
@@ -1625,6 +2199,7 @@ struct def_ctx {
  *	Initialize a multi step deflation
  *	Allocate an initial result buffer of given length
  *
+ * @param[in] codec - codec configured, picks the zlib level
  * @param[in] initial_len -  initial length of result buffer
  *
  * @return - The deflate context
@@ -1638,7 +2213,7 @@ struct def_ctx {
  *
  */
 void *
-tpp_multi_deflate_init(int initial_len)
+tpp_multi_deflate_init(int codec, int initial_len)
 {
 	int ret;
 	struct def_ctx *ctx = malloc(sizeof(struct def_ctx));
@@ -1657,7 +2232,7 @@ tpp_multi_deflate_init(int initial_len)
 	ctx->cmpr_strm.zalloc = Z_NULL;
 	ctx->cmpr_strm.zfree = Z_NULL;
 	ctx->cmpr_strm.opaque = Z_NULL;
-	ret = deflateInit(&ctx->cmpr_strm, COMPR_LEVEL);
+	ret = deflateInit(&ctx->cmpr_strm, tpp_zlib_level(codec));
 	if (ret != Z_OK) {
 		free(ctx->cmpr_buf);
 		free(ctx);
@@ -1775,6 +2350,7 @@ tpp_multi_deflate_done(void *c, unsigned int *cmpr_len)
  * @param[in] inbuf   - Ptr to buffer to compress
  * @param[in] inlen   - The size of input buffer
  * @param[out] outlen - The size of the compressed data
+ * @param[in] level   - zlib compression level
  *
  * @return      - Ptr to the compressed data buffer
  * @retval  !NULL - Success
@@ -1782,8 +2358,8 @@ tpp_multi_deflate_done(void *c, unsigned int *cmpr_len)
  *
  * @par MT-safe: No
  **/
-void *
-tpp_deflate(void *inbuf, unsigned int inlen, unsigned int *outlen)
+static void *
+tpp_zlib_deflate(void *inbuf, unsigned int inlen, unsigned int *outlen, int level)
 {
 	z_stream strm;
 	int ret;
@@ -1798,7 +2374,7 @@ tpp_deflate(void *inbuf, unsigned int inlen, unsigned int *outlen)
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
-	ret = deflateInit(&strm, Z_DEFAULT_COMPRESSION);
+	ret = deflateInit(&strm, level);
 	if (ret != Z_OK) {
 		tpp_log(LOG_CRIT, __func__, "Compression failed");
 		return NULL;
@@ -1865,6 +2441,127 @@ tpp_deflate(void *inbuf, unsigned int inlen, unsigned int *outlen)
 	return data;
 }
 
+#ifdef PBS_ZSTD_ENABLED
+/**
+ * @brief Compress data with zstd, prefixed by its codec tag
+ *
+ * @param[in] inbuf   - Ptr to buffer to compress
+ * @param[in] inlen   - The size of input buffer
+ * @param[out] outlen - The size of the compressed data
+ *
+ * @return      - Ptr to the compressed data buffer
+ * @retval  !NULL - Success
+ * @retval   NULL - Failure
+ *
+ * @par MT-safe: Yes
+ **/
+static void *
+tpp_zstd_compress(void *inbuf, unsigned int inlen, unsigned int *outlen)
+{
+	size_t bound = ZSTD_compressBound(inlen);
+	size_t ret;
+	tpp_codec_tag_t *tag;
+	char *data;
+
+	*outlen = 0;
+	if ((data = malloc(sizeof(tpp_codec_tag_t) + bound)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating zstd buffer %lu bytes", (unsigned long) bound);
+		return NULL;
+	}
+	ret = ZSTD_compress(data + sizeof(tpp_codec_tag_t), bound, inbuf, inlen, ZSTD_LEVEL);
+	if (ZSTD_isError(ret)) {
+		free(data);
+		tpp_log(LOG_CRIT, __func__, "Compression failed: %s", ZSTD_getErrorName(ret));
+		return NULL;
+	}
+	tag = (tpp_codec_tag_t *) data;
+	memcpy(tag->magic, TPP_CODEC_MAGIC, sizeof(tag->magic));
+	tag->codec = TPP_CODEC_ZSTD;
+
+	*outlen = sizeof(tpp_codec_tag_t) + ret;
+	return data;
+}
+
+/**
+ * @brief Decompress data compressed by tpp_zstd_compress
+ *
+ * @param[in] inbuf  - Ptr to compressed data, including the codec tag
+ * @param[in] inlen  - The size of input buffer
+ * @param[in] totlen - The total size of the uncompressed data
+ *
+ * @return      - Ptr to the uncompressed data buffer
+ * @retval  !NULL - Success
+ * @retval   NULL - Failure
+ *
+ * @par MT-safe: Yes
+ **/
+static void *
+tpp_zstd_decompress(void *inbuf, unsigned int inlen, unsigned int totlen)
+{
+	void *outbuf;
+	size_t ret;
+
+	if ((outbuf = malloc(totlen ? totlen : 1)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating zstd buffer %u bytes", totlen);
+		return NULL;
+	}
+	ret = ZSTD_decompress(outbuf, totlen, (char *) inbuf + sizeof(tpp_codec_tag_t), inlen - sizeof(tpp_codec_tag_t));
+	if (ZSTD_isError(ret) || ret != totlen) {
+		free(outbuf);
+		tpp_log(LOG_CRIT, __func__, "Decompression failed: %s", ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "length mismatch");
+		return NULL;
+	}
+	return outbuf;
+}
+#endif
+
+/**
+ * @brief Compress data with the configured codec
+ *
+ * @par Functionality
+ *	If the compressed data would not be smaller than the input, nothing
+ *	is returned so the caller sends the data uncompressed.
+ *
+ * @param[in] codec   - Codec to use
+ * @param[in] inbuf   - Ptr to buffer to compress
+ * @param[in] inlen   - The size of input buffer
+ * @param[out] outlen - The size of the compressed data
+ *
+ * @return      - Ptr to the compressed data buffer
+ * @retval  !NULL - Success
+ * @retval   NULL - Failure or data not compressible, send uncompressed
+ *
+ * @par MT-safe: Yes
+ **/
+void *
+tpp_compress(int codec, void *inbuf, unsigned int inlen, unsigned int *outlen)
+{
+	long long start = tpp_codec_usec();
+	void *data;
+
+#ifdef PBS_ZSTD_ENABLED
+	if (codec == TPP_CODEC_ZSTD)
+		data = tpp_zstd_compress(inbuf, inlen, outlen);
+	else
+#endif
+		data = tpp_zlib_deflate(inbuf, inlen, outlen, tpp_zlib_level(codec));
+
+	if (data && *outlen >= inlen) {
+		free(data);
+		data = NULL;
+		*outlen = 0;
+		CODEC_STAT_ADD(codec, cmpr_skip, 1);
+	} else if (data) {
+		CODEC_STAT_ADD(codec, cmpr_msgs, 1);
+		CODEC_STAT_ADD(codec, cmpr_in, inlen);
+		CODEC_STAT_ADD(codec, cmpr_out, *outlen);
+		CODEC_STAT_ADD(codec, cmpr_usec, tpp_codec_usec() - start);
+	}
+	tpp_codec_log_stats();
+
+	return data;
+}
+
 /**
  * @brief Inflate (de-compress) data
  *
@@ -1884,6 +2581,24 @@ tpp_inflate(void *inbuf, unsigned int inlen, unsigned int totlen)
 	int ret;
 	z_stream strm;
 	void *outbuf = NULL;
+	int codec = tpp_codec_of(inbuf, inlen);
+	long long start = tpp_codec_usec();
+
+	if (codec != TPP_CODEC_ZLIB) {
+#ifdef PBS_ZSTD_ENABLED
+		if (codec == TPP_CODEC_ZSTD) {
+			outbuf = tpp_zstd_decompress(inbuf, inlen, totlen);
+			if (outbuf) {
+				CODEC_STAT_ADD(codec, dcmpr_msgs, 1);
+				CODEC_STAT_ADD(codec, dcmpr_usec, tpp_codec_usec() - start);
+				tpp_codec_log_stats();
+			}
+			return outbuf;
+		}
+#endif
+		tpp_log(LOG_CRIT, __func__, "Data compressed with unsupported codec %s", tpp_codec_name(codec));
+		return NULL;
+	}
 
 	/*
 	 * in some rare cases totlen < compressed_len (inlen)
@@ -1922,11 +2637,14 @@ tpp_inflate(void *inbuf, unsigned int inlen, unsigned int totlen)
 		tpp_log(LOG_CRIT, __func__, "Decompression (inflate) failed, ret = %d", ret);
 		return NULL;
 	}
+	CODEC_STAT_ADD(codec, dcmpr_msgs, 1);
+	CODEC_STAT_ADD(codec, dcmpr_usec, tpp_codec_usec() - start);
+	tpp_codec_log_stats();
 	return outbuf;
 }
 #else
 void *
-tpp_multi_deflate_init(int initial_len)
+tpp_multi_deflate_init(int codec, int initial_len)
 {
 	tpp_log(LOG_CRIT, __func__, "TPP compression disabled");
 	return NULL;
@@ -1947,7 +2665,7 @@ tpp_multi_deflate_done(void *c, unsigned int *cmpr_len)
 }
 
 void *
-tpp_deflate(void *inbuf, unsigned int inlen, unsigned int *outlen)
+tpp_compress(int codec, void *inbuf, unsigned int inlen, unsigned int *outlen)
 {
 	tpp_log(LOG_CRIT, __func__, "TPP compression disabled");
 	return NULL;
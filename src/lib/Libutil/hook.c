@@ -2609,6 +2609,7 @@ hook_free(hook *phook, void (*pyfree_func)(struct python_script *))
 	}
 	phook->hook_name = NULL;
 	hook_init(phook, pyfree_func);
+	free(phook->prof);
 
 	free(phook);	/* now free the main structure */
 }
@@ -2772,6 +2773,11 @@ hook_purge(hook	*phook, void (*pyfree_func)(struct python_script *))
 			}
 		}
 
+		/* the compiled script is only a cache, it can be rebuilt */
+		snprintf(namebuf, MAXPATHLEN, "%s%s%s", path_hooks,
+			phook->hook_name, HOOK_BYTECODE_SUFFIX);
+		(void)unlink(namebuf);
+
 		snprintf(namebuf, MAXPATHLEN, "%s%s%s", path_hooks,
 			phook->hook_name, HOOK_FILE_SUFFIX);
 
@@ -3862,6 +3868,7 @@ hook_recov(char	*filename, FILE	*hookfp, char *msg, size_t msg_len,
 			log_err(errno, __func__, msg);
 		} else {
 			phook->hook_script_checksum = crc_file(hook_script);
+			((struct python_script *)phook->script)->cache_bytecode = 1;
 		}
 	}
 
@@ -4196,22 +4203,22 @@ num_eligible_hooks(unsigned int hook_event)
  *
  * @return void
  *
+ * @note
+ *	Measurements are taken whatever the log level, as they also feed
+ *	the hook profile (see hook_prof_record()).
  */
 void
 hook_perf_stat_start(char *label, char *action, int print_start_msg)
 {
 	char instance[MAXBUFLEN];
 
-	if (!will_log_event(PBSEVENT_DEBUG4))
-		return;
-
 	if ((label == NULL) || (action == NULL))
 		return;
 
 	snprintf(instance, sizeof(instance), "label=%s action=%s", label, action);
 	perf_stat_start(instance);
 
-	if (print_start_msg) {
+	if (print_start_msg && will_log_event(PBSEVENT_DEBUG4)) {
 		snprintf(log_buffer, sizeof(log_buffer), "%s profile_start", instance);
 		log_event(PBSEVENT_DEBUG4, PBS_EVENTCLASS_HOOK, LOG_INFO, "hook_perf_stat", log_buffer);
 	}
@@ -4228,34 +4235,193 @@ hook_perf_stat_start(char *label, char *action, int print_start_msg)
  *
  * @param[in]	print_end_msg - if 1, then mark a "profile_stop" message.
  *
- * @return void
+ * @return double
+ * @retval	walltime in seconds elapsed since hook_perf_stat_start()
+ * @retval	-1 if there was no such hook_perf_stat_start() call
  *
  */
-void
+double
 hook_perf_stat_stop(char *label, char *action, int print_end_msg)
 {
 	char instance[MAXBUFLEN];
-	char *msg;
+	double walltime;
+	double cputime;
 
 	if ((label == NULL) || (action == NULL))
-		return;
+		return (-1);
 
 	snprintf(instance, sizeof(instance), "label=%s action=%s", label, action);
 
-	if (!will_log_event(PBSEVENT_DEBUG4)) {
-		perf_stat_remove(instance);
-		return;
+	if (perf_stat_elapsed(instance, &walltime, &cputime) != 0)
+		return (-1);
+
+	if (will_log_event(PBSEVENT_DEBUG4)) {
+		snprintf(log_buffer, sizeof(log_buffer), "%s walltime=%f cputime=%f%s",
+			instance, walltime, cputime, print_end_msg ? " profile_stop" : "");
+		log_event(PBSEVENT_DEBUG4, PBS_EVENTCLASS_HOOK, LOG_INFO, "hook_perf_stat", log_buffer);
 	}
 
-	msg = perf_stat_stop(instance);
+	return (walltime);
+}
+
+/**
+ * @brief
+ *	Returns the profiling data slot of 'phook' for 'event', setting up
+ *	the hook's profiling data on first use.
+ *
+ * @param[in]	phook - the hook
+ * @param[in]	event - a single HOOK_EVENT_* value
+ *
+ * @return	int
+ * @retval	index in phook->prof->ev[]
+ * @retval	-1 on error
+ */
+static int
+hook_prof_slot(hook *phook, unsigned int event)
+{
+	int i;
+
+	if ((phook == NULL) || (event == 0))
+		return (-1);
+	for (i = 0; (event & 1) == 0; i++)
+		event >>= 1;
+	if (i >= HOOK_PROF_NEVENTS)
+		return (-1);
 
-	if (msg == NULL)
+	if (phook->prof == NULL) {
+		phook->prof = calloc(1, sizeof(struct hook_prof));
+		if (phook->prof == NULL) {
+			log_err(errno, __func__, "no memory");
+			return (-1);
+		}
+	}
+	return (i);
+}
+
+/**
+ * @brief
+ *	Add to the latency histogram of a phase of running 'phook' for 'event'.
+ *
+ * @param[in]	phook - the hook
+ * @param[in]	event - a single HOOK_EVENT_* value
+ * @param[in]	phase - which part of the hook execution was measured
+ * @param[in]	secs - the time it took, ignored if negative
+ *
+ * @return void
+ */
+void
+hook_prof_record(hook *phook, unsigned int event, enum hook_prof_phase phase, double secs)
+{
+	struct hook_prof_hist *hist;
+	unsigned long long us;
+	int i;
+	int b;
+
+	if ((secs < 0) || ((i = hook_prof_slot(phook, event)) == -1))
 		return;
 
-	if (print_end_msg)
-		snprintf(log_buffer, sizeof(log_buffer), "%s profile_stop", msg);
-	else
-		snprintf(log_buffer, sizeof(log_buffer), "%s", msg);
+	hist = &phook->prof->ev[i].phase[phase];
+	us = (unsigned long long)(secs * 1000000.0);
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+	for (b = 0; (b < HOOK_PROF_BUCKETS - 1) && ((1ULL << b) < us); b++)
+		;
+	hist->bucket[b]++;
+}
+
+/**
+ * @brief
+ *	Count an outcome of running 'phook' for 'event'.
+ *
+ * @param[in]	phook - the hook
+ * @param[in]	event - a single HOOK_EVENT_* value
+ * @param[in]	counter - what to count
+ *
+ * @return void
+ */
+void
+hook_prof_count(hook *phook, unsigned int event, enum hook_prof_counter counter)
+{
+	int i;
+
+	if ((i = hook_prof_slot(phook, event)) == -1)
+		return;
+	phook->prof->ev[i].count[counter]++;
+}
+
+/**
+ * @brief
+ *	Returns the profiling data of 'phook' in printable form, one
+ *	entry per event the hook ran for, separated by "; ", as in:
+ *	  queuejob: calls=12 rejects=1 timeouts=0 errors=0 restarts=0
+ *	  marshal_us=(sum=340 max=90 le32=3 le64=9) run_us=(...) apply_us=(...)
+ *	where each leN=count is a histogram bucket of times up to N usecs.
+ *
+ * @param[in]	phook - the hook
+ *
+ * @return	char *
+ * @retval	malloc-ed string, to be freed by the caller
+ * @retval	NULL on malloc failure
+ */
+char *
+hook_prof_as_string(hook *phook)
+{
+	static char *phase_name[HOOK_PROF_NPHASES] = {"marshal_us", "run_us", "apply_us"};
+	char *buf = NULL;
+	int buf_size = 0;
+	char tmp[128];
+	struct hook_prof_hist *hist;
+	int i;
+	int j;
+	int b;
+	int first = 1;
+
+	if (pbs_strcat(&buf, &buf_size, "") == NULL)
+		return (NULL);
+	if ((phook == NULL) || (phook->prof == NULL))
+		return (buf);
+
+	for (i = 0; i < HOOK_PROF_NEVENTS; i++) {
+		unsigned long *count = phook->prof->ev[i].count;
+
+		if (count[HOOK_PROF_CALLS] == 0)
+			continue;
+		snprintf(tmp, sizeof(tmp),
+			"%s%s: calls=%lu rejects=%lu timeouts=%lu errors=%lu restarts=%lu",
+			first ? "" : "; ", hook_event_as_string(1U << i),
+			count[HOOK_PROF_CALLS], count[HOOK_PROF_REJECTS],
+			count[HOOK_PROF_TIMEOUTS], count[HOOK_PROF_ERRORS],
+			count[HOOK_PROF_RESTARTS]);
+		if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+			goto prof_err;
+		first = 0;
+		for (j = 0; j < HOOK_PROF_NPHASES; j++) {
+			hist = &phook->prof->ev[i].phase[j];
+			snprintf(tmp, sizeof(tmp), " %s=(sum=%llu max=%llu", phase_name[j],
+				hist->total_us, hist->max_us);
+			if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+				goto prof_err;
+			for (b = 0; b < HOOK_PROF_BUCKETS; b++) {
+				if (hist->bucket[b] == 0)
+					continue;
+				if (b == HOOK_PROF_BUCKETS - 1)
+					snprintf(tmp, sizeof(tmp), " gt%llu=%u",
+						1ULL << (b - 1), hist->bucket[b]);
+				else
+					snprintf(tmp, sizeof(tmp), " le%llu=%u",
+						1ULL << b, hist->bucket[b]);
+				if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+					goto prof_err;
+			}
+			if (pbs_strcat(&buf, &buf_size, ")") == NULL)
+				goto prof_err;
+		}
+	}
+	return (buf);
 
-	log_event(PBSEVENT_DEBUG4, PBS_EVENTCLASS_HOOK, LOG_INFO, "hook_perf_stat", log_buffer);
+prof_err:
+	log_err(errno, __func__, "no memory");
+	free(buf);
+	return (NULL);
 }
@@ -113,16 +113,26 @@ struct {
 	{ND_Force_Exclhost,   VNS_FORCE_EXCLHOST}
 };
 
-/* Used for collecting performance stats */
+/*
+ * Used for collecting performance stats.  These live in a fixed, open
+ * addressed hash table keyed by the 64-bit FNV-1a hash of the instance
+ * string, so starting and stopping a measurement never allocates, and the
+ * bookkeeping can stay on in production.
+ */
+#define PERF_STAT_SLOTS	256	/* power of 2 */
+#define PERF_STAT_FREE	0
+#define PERF_STAT_INUSE	1
+#define PERF_STAT_GONE	2	/* removed, keeps probe chains intact */
+
 typedef struct perf_stat {
-	char		instance[MAXBUFLEN + 1];
-	double		walltime;
-	double		cputime;
-	pbs_list_link	pi_allstats;
+	unsigned long long	key;
+	int			state;
+	double			walltime;
+	double			cputime;
 } perf_stat_t;
 
-static int		perf_stats_initialized = 0;
-static pbs_list_head	perf_stats;
+static perf_stat_t	perf_stats[PERF_STAT_SLOTS];
+static int		perf_stats_inuse = 0;
 
 /**
  * @brief
@@ -1727,68 +1737,108 @@ get_cputime()
 
 /**
  * @brief
- *	Allocates memory for a given 'instance' of measurements.
+ *	Returns the perf_stats[] hash key of 'instance'.
  *
  * @param[in] instance - a description of what is being measured.
  *
- * @return perf_stat_t - an allocated entry.
+ * @return unsigned long long - the key, never 0
  */
-static perf_stat_t *
-perf_stat_alloc(char *instance)
+static unsigned long long
+perf_stat_key(char *instance)
 {
-	perf_stat_t	*p_stat;
-
-	if ((instance == NULL) || (instance[0] == '\0'))
-		return NULL;
+	unsigned long long h = 14695981039346656037ULL;
+	unsigned char *p;
 
-	p_stat = malloc(sizeof(perf_stat_t));
-	if (p_stat == NULL)
-		return NULL;
-
-	(void)memset((char *)p_stat, (int)0, (size_t)sizeof(perf_stat_t));
-
-	strncpy(p_stat->instance, instance, MAXBUFLEN);
-	p_stat->instance[MAXBUFLEN] = '\0';
-	p_stat->walltime = 0;
-	p_stat->cputime = 0;
-
-	delete_link(&p_stat->pi_allstats);
-	append_link(&perf_stats, &p_stat->pi_allstats, p_stat);
-
-	return (p_stat);
+	for (p = (unsigned char *)instance; *p != '\0'; p++) {
+		h ^= *p;
+		h *= 1099511628211ULL;
+	}
+	return (h ? h : 1);
 }
 
 /**
  * @brief
- *	Find an 'instance' entry among the list of saved performance
- *	stats.
+ *	Find an 'instance' entry among the saved performance stats, or
+ *	claim a slot for it.
  *
  * @param[in] instance - entity being measured.
+ * @param[in] create - if 1, claim a slot when not found.  If the table
+ *			is full, the measurement started the longest ago
+ *			(one that was likely never stopped) is given up.
  *
- * @return perf_stat_t - found entry.
+ * @return perf_stat_t - found entry, NULL if none.
  */
 static perf_stat_t *
-perf_stat_find(char *instance)
+perf_stat_find(char *instance, int create)
 {
+	unsigned long long key;
 	perf_stat_t *p_stat;
+	perf_stat_t *p_free = NULL;
+	int i;
+	int n;
 
-	if ((instance == NULL) || (instance[0] == '\0') || (perf_stats_initialized == 0))
+	if ((instance == NULL) || (instance[0] == '\0'))
 		return (NULL);
 
-	p_stat = (perf_stat_t *)GET_NEXT(perf_stats);
-	while (p_stat) {
-		if (strcmp(p_stat->instance, instance) == 0) {
+	key = perf_stat_key(instance);
+	i = (int)(key & (PERF_STAT_SLOTS - 1));
+	for (n = 0; n < PERF_STAT_SLOTS; n++, i = (i + 1) & (PERF_STAT_SLOTS - 1)) {
+		p_stat = &perf_stats[i];
+		if (p_stat->state == PERF_STAT_FREE) {
+			if (p_free == NULL)
+				p_free = p_stat;
 			break;
 		}
-		p_stat = (perf_stat_t *)GET_NEXT(p_stat->pi_allstats);
+		if (p_stat->state == PERF_STAT_GONE) {
+			if (p_free == NULL)
+				p_free = p_stat;
+			continue;
+		}
+		if (p_stat->key == key)
+			return (p_stat);
+	}
+	if (!create)
+		return (NULL);
+
+	if (p_free == NULL) {
+		/* full, give up the oldest measurement */
+		p_free = &perf_stats[0];
+		for (i = 1; i < PERF_STAT_SLOTS; i++) {
+			if (perf_stats[i].walltime < p_free->walltime)
+				p_free = &perf_stats[i];
+		}
+		perf_stats_inuse--;
+	}
+	p_free->key = key;
+	p_free->state = PERF_STAT_INUSE;
+	p_free->walltime = 0;
+	p_free->cputime = 0;
+	perf_stats_inuse++;
+	return (p_free);
+}
+
+/**
+ * @brief
+ *	Release a perf_stats[] slot.
+ *
+ * @param[in] p_stat - the slot
+ *
+ * @return void
+ */
+static void
+perf_stat_release(perf_stat_t *p_stat)
+{
+	p_stat->state = PERF_STAT_GONE;
+	if (--perf_stats_inuse <= 0) {
+		/* empty, drop the tombstones too */
+		memset(perf_stats, 0, sizeof(perf_stats));
+		perf_stats_inuse = 0;
 	}
-	return (p_stat);  /* may be a null pointer */
 }
 
 /**
  * @brief
- *	Remove (deallocate) an 'instance' entry among the list of
- *	saved performance stats.
+ *	Remove an 'instance' entry among the saved performance stats.
  *
  * @param[in] instance - entity being measured.
  *
@@ -1799,20 +1849,9 @@ perf_stat_remove(char *instance)
 {
 	perf_stat_t *p_stat;
 
-	if ((instance == NULL) || (instance[0] == '\0') || (perf_stats_initialized == 0))
-		return;
-
-	p_stat = (perf_stat_t *)GET_NEXT(perf_stats);
-	while (p_stat) {
-		if (strcmp(p_stat->instance, instance) == 0) {
-			break;
-		}
-		p_stat = (perf_stat_t *)GET_NEXT(p_stat->pi_allstats);
-	}
-	if (p_stat != NULL) {
- 		delete_link(&p_stat->pi_allstats);
-		free(p_stat);
-	}
+	p_stat = perf_stat_find(instance, 0);
+	if (p_stat != NULL)
+		perf_stat_release(p_stat);
 }
 
 /**
@@ -1828,25 +1867,43 @@ perf_stat_start(char *instance)
 {
 	perf_stat_t	*p_stat;
 
-	if ((instance == NULL) || (instance[0] == '\0'))
+	p_stat = perf_stat_find(instance, 1);
+	if (p_stat == NULL)
 		return;
 
-	if (perf_stats_initialized == 0) {
-		CLEAR_HEAD(perf_stats);
-		perf_stats_initialized = 1;
-	}
-
-	p_stat = perf_stat_find(instance);
-	if (p_stat == NULL) {
-		p_stat = perf_stat_alloc(instance);
-		if (p_stat == NULL)
-			return;
-	}
-
 	p_stat->walltime = get_walltime();
 	p_stat->cputime = get_cputime();
 }
 
+/**
+ * @brief
+ *	Returns the walltime and cputime elapsed since the perf_stat_start()
+ *	call on the same 'instance', and forgets about 'instance'.
+ *
+ * @param[in] instance - entity being measured
+ * @param[out] walltime - elapsed walltime in seconds
+ * @param[out] cputime - elapsed cputime in seconds
+ *
+ * @return int
+ * @retval 0	- success
+ * @retval -1	- no such measurement
+ */
+int
+perf_stat_elapsed(char *instance, double *walltime, double *cputime)
+{
+	perf_stat_t	*p_stat;
+
+	p_stat = perf_stat_find(instance, 0);
+	if (p_stat == NULL)
+		return (-1);
+
+	*walltime = get_walltime() - p_stat->walltime;
+	*cputime = get_cputime() - p_stat->cputime;
+	perf_stat_release(p_stat);
+
+	return (0);
+}
+
 /**
  * @brief
  *	Returns a summary of statistics gathered (e.g.
@@ -1860,32 +1917,19 @@ perf_stat_start(char *instance)
  *		     will get over-written by the next call to this
  *		     function.
  * @note
- *	This also frees up the memory used by the 'instance' entry
- *      in the list of saved stats.
+ *	This also releases the 'instance' entry in the saved stats.
  */
 char *
 perf_stat_stop(char *instance)
 {
-	perf_stat_t	*p_stat;
-	double		now_walltime;
-	double		now_cputime;
+	double		walltime;
+	double		cputime;
 	static		char stat_summary[MAXBUFLEN + 1];
 
-	if ((instance == NULL) || (instance[0] == '\0')) {
+	if (perf_stat_elapsed(instance, &walltime, &cputime) != 0)
 		return (NULL);
-	}
-
-	p_stat = perf_stat_find(instance);
-	if (p_stat == NULL)
-		return (NULL);
-
-	now_walltime = get_walltime();
-	now_cputime = get_cputime();
-
-	snprintf(stat_summary, sizeof(stat_summary), "%s walltime=%f cputime=%f", instance, (now_walltime - p_stat->walltime),  (now_cputime - p_stat->cputime));
 
- 	delete_link(&p_stat->pi_allstats);
-	free(p_stat);
+	snprintf(stat_summary, sizeof(stat_summary), "%s walltime=%f cputime=%f", instance, walltime, cputime);
 
 	return (stat_summary);
 }
@@ -45,6 +45,9 @@ All Python based types mapping to PBS attribute types.
 """
 
 _ATTRIBUTES_KEY_NAME = 'attributes'
+#: per instance dictionary of attribute values not yet converted, filled in
+#: by the hook C code and consumed by PbsAttributeDescriptor on first access
+_ATTRIBUTES_LAZY_KEY_NAME = '_attributes_lazy'
 
 __all__ = ['_generic_attr',
            'size',
@@ -104,6 +107,16 @@ _LOG = _pbs_v1.logmsg
 _IS_SETTABLE = _pbs_v1.is_attrib_val_settable
 
 
+def _lazy_values(obj):
+    """return the dictionary of not yet converted attribute values of
+    'obj', or None if it has none.
+    """
+    d = getattr(obj, "__dict__", None)
+    if d is None:
+        return None
+    return d.get(_ATTRIBUTES_LAZY_KEY_NAME)
+
+
 class PbsAttributeDescriptor():
     """This class wraps evey PBS attribute into a *DATA* descriptor AND is
     maintained per instance instead of the default per class.
@@ -170,7 +183,12 @@ class PbsAttributeDescriptor():
         #  caused pbs_resource to be instantiated every time. Probably due to
         #  _get_default_value() getting evaluatd every time.
 
-        if obj not in self.__per_instance:
+        #: a value loaded by PBS since the last set is converted on first use
+        lazy = _lazy_values(obj)
+        if lazy and self._name in lazy:
+            self.__per_instance[obj] = self._materialize(obj,
+                                                         lazy.pop(self._name))
+        elif obj not in self.__per_instance:
             v = self._get_default_value()
             self.__per_instance[obj] = v
 
@@ -187,14 +205,27 @@ class PbsAttributeDescriptor():
         # if in Python (hook script mode), the hook writer has set value to
         # to None, meaning to unset the attribute.
 
+        if (value is None) and _pbs_v1.in_python_mode():
+            set_value = ""
+        else:
+            set_value = self._convert(obj, value)
+        #:
+        self.__per_instance[obj] = set_value
+        lazy = _lazy_values(obj)
+        if lazy is not None:
+            lazy.pop(self._name, None)
+    #: m(__set__)
+
+    def _convert(self, obj, value):
+        """convert a value to the attribute's value type
+        """
+
         try:
             basestring
         except Exception:
             basestring = str
 
-        if (value is None) and _pbs_v1.in_python_mode():
-            set_value = ""
-        elif ((value is None)
+        if ((value is None)
               or (isinstance(value, basestring) and value == "")
               or isinstance(value, self._value_type)
               or self._is_entity
@@ -208,16 +239,34 @@ class PbsAttributeDescriptor():
             #                       (isinstance(value, self._value_type)
             #     - a special entity resource type : self.is_entity is True
             #                             or parent object is an entity type
-            set_value = value
-        else:
-            if self._is_resource and isinstance(value, str) and (value[0] == "@"):
-                # an indirect resource
-                set_value = value
-            else:
-                set_value = self._value_type[0](value)
-        #:
-        self.__per_instance[obj] = set_value
-    #: m(__set__)
+            return value
+        if self._is_resource and isinstance(value, str) and (value[0] == "@"):
+            # an indirect resource
+            return value
+        return self._value_type[0](value)
+    #: m(_convert)
+
+    def _materialize(self, obj, value):
+        """convert a value loaded by PBS but not yet accessed. This is done
+        as PBS would have done it when loading the object, that is in C mode.
+        A value that does not convert is handled as a failed load was: the
+        error is logged and the attribute keeps its default value.
+        """
+
+        py_mode = _pbs_v1.in_python_mode()
+        if py_mode:
+            _pbs_v1.set_c_mode()
+        try:
+            return self._convert(obj, value)
+        except Exception as e:
+            _LOG(_pbs_v1.LOG_ERROR, "%s: %s" % (e.__class__.__name__, e))
+            _LOG(_pbs_v1.LOG_ERROR, "failed to set attribute <%s>" %
+                 (self._name,))
+            return self._get_default_value()
+        finally:
+            if py_mode:
+                _pbs_v1.set_python_mode()
+    #: m(_materialize)
 
     def _set_resc_atttr(self, resc_attr, is_entity=0):
         """
@@ -232,6 +281,9 @@ class PbsAttributeDescriptor():
         """__delete__, we just set the attribute value to None"""
 
         self.__per_instance[obj] = None
+        lazy = _lazy_values(obj)
+        if lazy is not None:
+            lazy.pop(self._name, None)
     #: m(__delete__)
 
     def _get_default_value(self):
@@ -56,6 +56,9 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
 #include "dis.h"
 #include "libpbs.h"
 #include "list_link.h"
@@ -81,6 +84,7 @@
 #include "hook.h"
 #include "renew_creds.h"
 #include "mock_run.h"
+#include "avltree.h"
 #include <libutil.h>
 
 /**
@@ -104,6 +108,7 @@ extern int termin_child;
 #endif
 extern int server_stream;
 extern time_t time_now;
+extern int resc_access_perm;
 extern pbs_list_head mom_polljobs;
 extern unsigned int pbs_mom_port;
 extern int gen_nodefile_on_sister_mom;
@@ -673,6 +678,16 @@ end_loop:
 			/* Still somebody there so don't send it yet. */
 			if (ptask != NULL)
 				continue;
+			/*
+			 * KILL_JOB came down the fan-out tree, the reply
+			 * goes up with the rest of my subtree.
+			 */
+			if ((pjob->ji_fanout != NULL) &&
+				(pjob->ji_fanout->fo_command == IM_KILL_JOB)) {
+				pjob->ji_obit = TM_NULL_EVENT;
+				fanout_local_done(pjob, PBSE_NONE);
+				continue;
+			}
 			/* No tasks running. Format and send a reply to the mother superior */
 			if (cookie != NULL) {
 				(void)im_compose(stream, pjob->ji_qs.ji_jobid,
@@ -923,6 +938,154 @@ err:
 	return;
 }
 
+/*
+ * Restart recovery reads and decodes every job file and task file under
+ * mom_priv/jobs.  With many jobs on a node that is most of MoM's startup,
+ * so it is done by a few threads: each job file is read once into memory
+ * and its attributes decoded there.  What touches MoM state, the attribute
+ * actions and putting the job on the lists, is left to init_abort_jobs().
+ */
+typedef struct recov_ent {
+	char	*re_name;		/* job file name in path_jobs */
+	job	*re_job;		/* loaded job, NULL if discarded */
+	char	re_act[JOB_ATR_LAST];	/* actions for job_recov_finish() */
+} recov_ent_t;
+
+#ifndef WIN32
+typedef struct recov_work {
+	recov_ent_t	*rw_ents;
+	int		rw_nents;
+	int		rw_next;	/* next entry to hand out */
+	pthread_mutex_t	rw_mutex;
+} recov_work_t;
+#endif
+
+/**
+ * @brief
+ *	Load one job and its tasks for init_abort_jobs().
+ *
+ * @par MT-safe: Yes
+ *	Only touches the entry passed in, see job_recov_load().
+ *
+ * @param[in,out] pe - entry to load, re_job is set if it is good
+ *
+ * @return void
+ *
+ */
+static void
+recov_job(recov_ent_t *pe)
+{
+	pe->re_job = job_recov_load(pe->re_name, pe->re_act);
+	if (pe->re_job != NULL)
+		(void)task_recov(pe->re_job);
+}
+
+#ifndef WIN32
+/**
+ * @brief
+ *	Take entries from the shared list until none are left.
+ *
+ * @param[in] rw - the shared work list
+ *
+ * @return void
+ *
+ */
+static void
+recov_drain(recov_work_t *rw)
+{
+	int		i;
+
+	for (;;) {
+		pthread_mutex_lock(&rw->rw_mutex);
+		i = rw->rw_next++;
+		pthread_mutex_unlock(&rw->rw_mutex);
+		if (i >= rw->rw_nents)
+			break;
+		recov_job(&rw->rw_ents[i]);
+	}
+}
+
+/**
+ * @brief
+ *	Thread body for recov_load().
+ *
+ * @param[in] arg - the shared recov_work_t
+ *
+ * @return NULL
+ *
+ */
+static void *
+recov_worker(void *arg)
+{
+	recov_drain((recov_work_t *)arg);
+	free_avl_tls();
+	return NULL;
+}
+#endif
+
+/**
+ * @brief
+ *	Load all job files found on restart, using up to RECOV_THREADS_MAX
+ *	threads besides this one.
+ *
+ * @param[in,out] ents - job file entries
+ * @param[in]	nents - number of entries
+ *
+ * @return int
+ * @retval	number of threads used, 0 if done by the caller
+ *
+ */
+static int
+recov_load(recov_ent_t *ents, int nents)
+{
+	int		i;
+	int		nthr = 0;
+#ifndef WIN32
+	long		ncpu;
+	pthread_t	tids[RECOV_THREADS_MAX];
+	recov_work_t	rw;
+	sigset_t	allsigs;
+	sigset_t	oldsigs;
+#endif
+
+	/* set all privileges (read and write) for decoding resources	*/
+	/* see decode_resc() in lib/Libattr/attr_fn_resc.c		*/
+	resc_access_perm = ATR_DFLAG_ACCESS;
+
+#ifndef WIN32
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu > RECOV_THREADS_MAX)
+		ncpu = RECOV_THREADS_MAX;
+	if (ncpu > nents)
+		ncpu = nents;
+	if (ncpu > 1) {
+		rw.rw_ents = ents;
+		rw.rw_nents = nents;
+		rw.rw_next = 0;
+		pthread_mutex_init(&rw.rw_mutex, NULL);
+
+		/* keep MoM's signals on this thread */
+		sigfillset(&allsigs);
+		pthread_sigmask(SIG_BLOCK, &allsigs, &oldsigs);
+		for (nthr = 0; nthr < ncpu; nthr++) {
+			if (pthread_create(&tids[nthr], NULL, recov_worker, &rw) != 0)
+				break;
+		}
+		pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+		/* pick up whatever is left if fewer threads started */
+		recov_drain(&rw);
+		for (i = 0; i < nthr; i++)
+			pthread_join(tids[i], NULL);
+		pthread_mutex_destroy(&rw.rw_mutex);
+		return nthr;
+	}
+#endif
+	for (i = 0; i < nents; i++)
+		recov_job(&ents[i]);
+	return nthr;
+}
+
 /**
  * @brief
  *	On mom initialization, recover all running jobs.
@@ -960,11 +1123,19 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 	char		oldp[MAXPATHLEN+1];
 	char		rcperr[] = "rcperr.";
 	struct	stat	statbuf;
+	recov_ent_t	*ents = NULL;
+	recov_ent_t	*pe;
+	int		nents = 0;
+	int		nthr;
+	int		nbad = 0;
+	int		scanned;
+	char		*stat_str;
 	extern	char	*path_checkpoint;
 	extern	char	*path_spool;
 
 	CLEAR_HEAD((*multinode_jobs));
 
+	perf_stat_start("init_abort_jobs");
 	dir = opendir(path_jobs);
 	if (dir == NULL) {
 		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ALERT,
@@ -978,16 +1149,65 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 		psuffix = pdirent->d_name + i - job_suf_len;
 		if (strcmp(psuffix, job_suffix))
 			continue;
-		pj = job_recov(pdirent->d_name);
+		if ((nents % 64) == 0) {
+			pe = (recov_ent_t *)realloc(ents, (nents + 64) * sizeof(recov_ent_t));
+			if (pe == NULL) {
+				log_err(ENOMEM, __func__, "out of memory");
+				exit(1);
+			}
+			ents = pe;
+		}
+		pe = &ents[nents];
+		memset(pe, 0, sizeof(recov_ent_t));
+		if ((pe->re_name = strdup(pdirent->d_name)) == NULL) {
+			log_err(ENOMEM, __func__, "out of memory");
+			exit(1);
+		}
+		nents++;
+	}
+	if (errno != 0 && errno != ENOENT) {
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ALERT,
+			msg_daemonname, "Jobs directory cannot be read");
+		(void)closedir(dir);
+		exit(1);
+	}
+	(void)closedir(dir);
+
+	/* read and decode the job files in parallel */
+	perf_stat_start("init_abort_jobs load");
+	nthr = recov_load(ents, nents);
+	if ((stat_str = perf_stat_stop("init_abort_jobs load")) != NULL)
+		log_eventf(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO, __func__,
+			"%s jobs=%d threads=%d", stat_str, nents, nthr);
+
+	/*
+	 * One look at the process table serves every session killed or
+	 * checked below, whether the jobs are being killed (-r) or left
+	 * running (-p).
+	 */
+	scanned = 0;
+	if (recover != 0 && nents > 0) {
+		perf_stat_start("init_abort_jobs scan");
+		scanned = (mom_snapshot_hold() == PBSE_NONE);
+		if ((stat_str = perf_stat_stop("init_abort_jobs scan")) != NULL)
+			log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO,
+				__func__, stat_str);
+	}
+
+	perf_stat_start("init_abort_jobs recover");
+	for (pe = ents; pe < ents + nents; pe++) {
+		pj = pe->re_job;
 		if (pj == NULL) {
 			(void)strcpy(path, path_jobs);
-			(void)strcat(path, pdirent->d_name);
+			(void)strcat(path, pe->re_name);
 			(void)unlink(path);
 			psuffix = path + strlen(path) - job_suf_len;
 			strcpy(psuffix, JOB_TASKDIR_SUFFIX);
 			(void)remtree(path);
+			nbad++;
 			continue;
 		}
+		job_recov_finish(pj, pe->re_name, pe->re_act);
 
 		/* To get homedir info */
 		pj->ji_grpcache = NULL;
@@ -999,7 +1219,6 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 		}
 		append_link(&svr_alljobs, &pj->ji_alljobs, pj);
 		job_nodes(pj);
-		task_recov(pj);
 
 		/*
 		 ** Check to see if a checkpoint.old dir exists.
@@ -1141,13 +1360,14 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 			}
 		}
 	}
-	if (errno != 0 && errno != ENOENT) {
-		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ALERT,
-			msg_daemonname, "Jobs directory cannot be read");
-		(void)closedir(dir);
-		exit(1);
-	}
-	(void)closedir(dir);
+	if (scanned)
+		mom_snapshot_release();
+	if ((stat_str = perf_stat_stop("init_abort_jobs recover")) != NULL)
+		log_eventf(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO, __func__,
+			"%s recovered=%d discarded=%d", stat_str, nents - nbad, nbad);
+	for (pe = ents; pe < ents + nents; pe++)
+		free(pe->re_name);
+	free(ents);
 
 	/*
 	 ** Go through spool dir and remove files that match
@@ -1158,6 +1378,7 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 	if (dir == NULL) {
 		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ALERT,
 			msg_daemonname, "spool directory not found");
+		perf_stat_remove("init_abort_jobs");
 		return;
 	}
 
@@ -1173,6 +1394,9 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ALERT,
 			msg_daemonname, "spool directory cannot be read");
 	(void)closedir(dir);
+	if ((stat_str = perf_stat_stop("init_abort_jobs")) != NULL)
+		log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO,
+			__func__, stat_str);
 }
 
 /**
@@ -50,6 +50,8 @@
  *	The following public functions are provided:
  *		job_save_fs() -		save the disk image
  *		job_recov_fs() -		recover (read) job from disk
+ *		job_recov_load() -	read and decode a job, MT-safe
+ *		job_recov_finish() -	complete a job_recov_load()
  */
 
 #include <pbs_config.h>   /* the master config generated by configure */
@@ -88,7 +90,7 @@
 
 extern char  *path_jobs;
 extern time_t time_now;
-extern char   pbs_recov_filename[];
+extern int    resc_access_perm;
 
 /* data global only to this file */
 
@@ -282,32 +284,42 @@ job_save_fs(job *pjob)
 
 /**
  * @brief
- *		recover (read in) a job from its save file
- *
- *		This function is only needed upon server start up.
+ *		load a job from its save file without touching MoM state
  *
- *		The job structure, its attributes strings, and its dependencies
- *		are recovered from the disk.  Space to hold the above is
- *		malloc-ed as needed.
+ *		The save file is renamed to .BD in case recovery fails, so the
+ *		same file is not tried again, and read into memory in one go.
+ *		The fixed and extended portions are checked and the attributes
+ *		are decoded, but their ATR_ACTION_RECOV actions are left for
+ *		job_recov_finish().
  *
+ * @par MT-safe: Yes
+ *		The caller sets resc_access_perm to ATR_DFLAG_ACCESS first, see
+ *		recov_attr_mem().
  *
- * @param[in]	filename	- Name of job file to load job from
+ * @param[in]	filename - name of job file in path_jobs
+ * @param[out]	recov_act - JOB_ATR_LAST entries, cleared by the caller,
+ *			    set for the actions still to be run
  *
  * @return	pointer to new job structure
  *
- * @retval	 NULL - Failure
+ * @retval	 NULL - Failure, the reason has been logged
  * @retval	!NULL - Success
  *
  */
 
 job *
-job_recov_fs(char *filename)
+job_recov_load(char *filename, char *recov_act)
 {
 	int		 fds;
+	char		 namebuf[MAXPATHLEN+1];
 	char		 basen[MAXPATHLEN+1];
 	job		*pj;
-	char		*pn;
 	char		*psuffix;
+	char		*buf;
+	struct stat	 sb;
+	size_t		 len;
+	size_t		 off;
+	ssize_t		 amt;
 
 
 	pj = job_alloc();	/* allocate & initialize job structure space */
@@ -315,33 +327,29 @@ job_recov_fs(char *filename)
 		return NULL;
 	}
 
-	(void)strcpy(pbs_recov_filename, path_jobs);	/* job directory path */
-	(void)strcat(pbs_recov_filename, filename);
+	(void)snprintf(namebuf, sizeof(namebuf), "%s%s", path_jobs, filename);
 #ifdef WIN32
-	fix_perms(pbs_recov_filename);
+	fix_perms(namebuf);
 #endif
 
 	/* change file name in case recovery fails so we don't try same file */
 
-	pbs_strncpy(basen, pbs_recov_filename, sizeof(basen));
+	pbs_strncpy(basen, namebuf, sizeof(basen));
 	psuffix = basen + strlen(basen) - strlen(JOB_BAD_SUFFIX);
 	(void)strcpy(psuffix, JOB_BAD_SUFFIX);
 #ifdef WIN32
-	if (MoveFileEx(pbs_recov_filename, basen,
+	if (MoveFileEx(namebuf, basen,
 		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == 0) {
 		errno = GetLastError();
-		sprintf(log_buffer, "MoveFileEx(%s, %s) failed!",
-			pbs_recov_filename, basen);
-		log_err(errno, "nodes", log_buffer);
+		log_errf(errno, "nodes", "MoveFileEx(%s, %s) failed!",
+			namebuf, basen);
 
 	}
 	secure_file(basen, "Administrators",
 		READS_MASK|WRITES_MASK|STANDARD_RIGHTS_REQUIRED);
 #else
-	if (rename(pbs_recov_filename, basen) == -1) {
-		sprintf(log_buffer, "error renaming job file %s",
-			pbs_recov_filename);
-		log_err(errno, __func__, log_buffer);
+	if (rename(namebuf, basen) == -1) {
+		log_errf(errno, __func__, "error renaming job file %s", namebuf);
 		free((char *)pj);
 		return NULL;
 	}
@@ -349,9 +357,7 @@ job_recov_fs(char *filename)
 
 	fds = open(basen, O_RDONLY, 0);
 	if (fds < 0) {
-		sprintf(log_buffer, "error opening of job file %s",
-			pbs_recov_filename);
-		log_err(errno, __func__, log_buffer);
+		log_errf(errno, __func__, "error opening of job file %s", namebuf);
 		free((char *)pj);
 		return NULL;
 	}
@@ -359,50 +365,47 @@ job_recov_fs(char *filename)
 	setmode(fds, O_BINARY);
 #endif
 
-	/* read in job fixed sub-structure */
+	/* read the whole file, it is decoded from memory */
+
+	buf = NULL;
+	len = 0;
+	if ((fstat(fds, &sb) == 0) && (sb.st_size > 0) &&
+		((buf = malloc(sb.st_size)) != NULL)) {
+		for (off = 0; off < (size_t)sb.st_size; off += amt) {
+			amt = read(fds, buf + off, sb.st_size - off);
+			if (amt <= 0)
+				break;
+		}
+		len = off;
+	}
+	(void)close(fds);
+
+	/* check job fixed sub-structure */
 
 	errno = -1;
-	if (read(fds, (char *)&pj->ji_qs, fixedsize) != (int)fixedsize) {
-		sprintf(log_buffer, "error reading fixed portion of %s",
-			pbs_recov_filename);
-		log_err(errno, __func__, log_buffer);
+	if (len < fixedsize) {
+		log_errf(errno, __func__, "error reading fixed portion of %s",
+			namebuf);
+		free(buf);
 		free((char *)pj);
-		(void)close(fds);
 		return NULL;
 	}
+	memcpy(&pj->ji_qs, buf, fixedsize);
+
 	/* Does file name match the internal name? */
 	/* This detects ghost files */
 
-#ifdef WIN32
-	pn = strrchr(pbs_recov_filename, (int)'/');
-	if (pn == NULL)
-		pn = strrchr(pbs_recov_filename, (int)'\\');
-	if (pn == NULL) {
-		sprintf(log_buffer, "bad path %s", pbs_recov_filename);
-		log_err(errno, __func__, log_buffer);
-		free((char *)pj);
-		(void)close(fds);
-		return NULL;
-	}
-	pn++;
-#else
-	pn = strrchr(pbs_recov_filename, (int)'/') + 1;
-#endif
-
-	if (strncmp(pn, pj->ji_qs.ji_jobid, strlen(pn)-3) != 0) {
+	if (strncmp(filename, pj->ji_qs.ji_jobid, strlen(filename)-3) != 0) {
 		/* mismatch, discard job */
 
-		(void)sprintf(log_buffer,
-			"Job Id %s does not match file name for %s",
-			pj->ji_qs.ji_jobid,
-			pbs_recov_filename);
-		log_err(-1, __func__, log_buffer);
+		log_errf(-1, __func__, "Job Id %s does not match file name for %s",
+			pj->ji_qs.ji_jobid, namebuf);
+		free(buf);
 		free((char *)pj);
-		(void)close(fds);
 		return NULL;
 	}
 
-	/* read in extended save area depending on JSVERSION */
+	/* extended save area depending on JSVERSION */
 
 	errno = 0;
 	DBPRT(("Job save version %d\n", pj->ji_qs.ji_jsversion))
@@ -410,40 +413,64 @@ job_recov_fs(char *filename)
 		/* since there is no change in jobextend structure for JSVERSION(1900) and JSVERSION_18(800),
 		 * read the current structure.
 		 */
-		if (read(fds, (char *)&pj->ji_extended,
-			sizeof(union jobextend)) !=
-			sizeof(union jobextend)) {
-			sprintf(log_buffer,
-				"error reading extended portion of %s",
-				pbs_recov_filename);
-			log_err(errno, __func__, log_buffer);
+		if (len < fixedsize + extndsize) {
+			log_errf(errno, __func__,
+				"error reading extended portion of %s", namebuf);
+			free(buf);
 			free((char *)pj);
-			(void)close(fds);
 			return NULL;
 		}
+		memcpy(&pj->ji_extended, buf + fixedsize, extndsize);
 	} else {
 		/* If really an old version(i.e. pre 13.x), it wasn't there, abort out */
-		sprintf(log_buffer,
+		log_errf(errno, __func__,
 			"Job structure version cannot be recovered for job %s",
-			pbs_recov_filename);
-		log_err(errno, __func__, log_buffer);
+			namebuf);
+		free(buf);
 		free((char *)pj);
-		(void)close(fds);
 		return NULL;
 	}
 
-	/* read in working attributes */
+	/* decode working attributes */
 
-	if (recov_attr_fs(fds, pj, job_attr_idx, job_attr_def, pj->ji_wattr, (int)JOB_ATR_LAST,
-		(int)JOB_ATR_UNKN) != 0) {
-		sprintf(log_buffer, "error reading attributes portion of %s",
-			pbs_recov_filename);
-		log_err(errno, __func__, log_buffer);
+	off = fixedsize + extndsize;
+	if (recov_attr_mem(buf + off, len - off, namebuf, job_attr_idx, job_attr_def,
+		pj->ji_wattr, (int)JOB_ATR_UNKN, recov_act) != 0) {
+		log_errf(-1, __func__, "error reading attributes portion of %s",
+			namebuf);
 		job_free(pj);
-		(void)close(fds);
+		free(buf);
 		return NULL;
 	}
-	(void)close(fds);
+	free(buf);
+
+	return (pj);
+}
+
+/**
+ * @brief
+ *		finish recovering a job loaded by job_recov_load()
+ *
+ *		Runs the attribute actions job_recov_load() left and changes
+ *		the file name back to .JB.
+ *
+ * @param[in]	pj - job returned by job_recov_load()
+ * @param[in]	filename - name of job file in path_jobs
+ * @param[in]	recov_act - as set by job_recov_load()
+ *
+ * @return	void
+ *
+ */
+
+void
+job_recov_finish(job *pj, char *filename, char *recov_act)
+{
+	char		 namebuf[MAXPATHLEN+1];
+	char		 basen[MAXPATHLEN+1];
+	char		*psuffix;
+
+	recov_attr_action(pj, job_attr_def, pj->ji_wattr, (int)JOB_ATR_LAST,
+		recov_act);
 
 #if defined(WIN32)
 	/* get a handle to the job (may not exist) */
@@ -453,20 +480,59 @@ job_recov_fs(char *filename)
 
 	/* all done recovering the job, change file name back to .JB */
 
+	(void)snprintf(namebuf, sizeof(namebuf), "%s%s", path_jobs, filename);
+	pbs_strncpy(basen, namebuf, sizeof(basen));
+	psuffix = basen + strlen(basen) - strlen(JOB_BAD_SUFFIX);
+	(void)strcpy(psuffix, JOB_BAD_SUFFIX);
 #ifdef WIN32
-	if (MoveFileEx(basen, pbs_recov_filename,
+	if (MoveFileEx(basen, namebuf,
 		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == 0) {
 		errno = GetLastError();
-		sprintf(log_buffer, "MoveFileEx(%s, %s) failed!",
-			basen, pbs_recov_filename);
-		log_err(errno, "nodes", log_buffer);
+		log_errf(errno, "nodes", "MoveFileEx(%s, %s) failed!",
+			basen, namebuf);
 
 	}
-	secure_file(pbs_recov_filename, "Administrators",
+	secure_file(namebuf, "Administrators",
 		READS_MASK|WRITES_MASK|STANDARD_RIGHTS_REQUIRED);
 #else
-	(void)rename(basen, pbs_recov_filename);
+	(void)rename(basen, namebuf);
 #endif
+}
+
+/**
+ * @brief
+ *		recover (read in) a job from its save file
+ *
+ *		This function is only needed upon server start up.
+ *
+ *		The job structure, its attributes strings, and its dependencies
+ *		are recovered from the disk.  Space to hold the above is
+ *		malloc-ed as needed.
+ *
+ *
+ * @param[in]	filename	- Name of job file to load job from
+ *
+ * @return	pointer to new job structure
+ *
+ * @retval	 NULL - Failure
+ * @retval	!NULL - Success
+ *
+ */
+
+job *
+job_recov_fs(char *filename)
+{
+	job		*pj;
+	char		 recov_act[JOB_ATR_LAST];
+
+	/* set all privileges (read and write) for decoding resources	*/
+	/* see decode_resc() in lib/Libattr/attr_fn_resc.c		*/
+
+	resc_access_perm = ATR_DFLAG_ACCESS;
+	memset(recov_act, 0, sizeof(recov_act));
 
+	pj = job_recov_load(filename, recov_act);
+	if (pj != NULL)
+		job_recov_finish(pj, filename, recov_act);
 	return (pj);
 }
@@ -68,7 +68,11 @@
 #include <sys/resource.h>
 #include <sys/utsname.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
 #include <signal.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 
 #include "pbs_error.h"
 #include "portability.h"
@@ -86,6 +90,8 @@
 #include "pbs_ifl.h"
 #include "placementsets.h"
 #include "mom_vnode.h"
+#include "net_connect.h"
+#include "pbs_idx.h"
 #ifndef NAS /* localmod 113 */
 #include "hwloc.h"
 #endif /* localmod 113 */
@@ -148,6 +154,7 @@ extern	int	exiting_tasks;
 extern	vnl_t	*vnlp;
 
 extern	time_t	time_now;
+extern	pbs_list_head	svr_alljobs;
 
 /*
  ** external functions and data
@@ -746,28 +753,14 @@ resi_sum(job *pjob)
 
 /**
  * @brief
- * 	Establish system-enforced limits for the job.
+ * 	Work out the system-enforced limits for the job.
  *
  *	Run through the resource list, checking the values for all items
- *	we recognize.
- *
- * @param[in] pjob - job pointer
- * @param[in]  set_mode	- setting mode
- *
- *	If set_mode is SET_LIMIT_SET, then also set hard limits for the
- *			  system enforced limits (not-polled).
- *	If anything goes wrong with the process, return a PBS error code
- *	and print a message on standard error.  A zero-length resource list
- *	is not an error.
+ *	we recognize, and record the ones that are set with setrlimit()
+ *	or nice() in the process that becomes the job.
  *
- *	If set_mode is SET_LIMIT_SET the entry conditions are:
- *	    1.	MOM has already forked, and we are called from the child.
- *	    2.	The child is still running as root.
- *	    3.  Standard error is open to the user's file.
- *
- *	If set_mode is SET_LIMIT_ALTER, we are beening called to modify
- *	existing limits.  Cannot alter those set by setrlimit (kernel)
- *	because we are the wrong process.
+ * @param[in]	pjob - job pointer
+ * @param[out]	ml - limits to be applied by mom_apply_limits()
  *
  * @return	int
  * @retval	PBSE_NONE	Success
@@ -775,13 +768,12 @@ resi_sum(job *pjob)
  *
  */
 int
-mom_set_limits(job *pjob, int set_mode)
+mom_get_limits(job *pjob, mom_limits_t *ml)
 {
 	char		*pname;
 	int		retval;
 	ulong		value;	/* place in which to build resource value */
 	resource	*pres;
-	struct rlimit	reslim;
 	ulong		mem_limit = 0;
 	ulong		vmem_limit = 0;
 	ulong		cput_limit = 0;
@@ -790,6 +782,7 @@ mom_set_limits(job *pjob, int set_mode)
 	assert(pjob != NULL);
 	assert((get_jattr(pjob, JOB_ATR_resource))->at_type == ATR_TYPE_RESC);
 	pres = (resource *) GET_NEXT(get_jattr_list(pjob, JOB_ATR_resource));
+	memset(ml, 0, sizeof(mom_limits_t));
 
 	/*
 	 * Cycle through all the resource specifications,
@@ -830,48 +823,122 @@ mom_set_limits(job *pjob, int set_mode)
 			if (retval != PBSE_NONE)
 				return (error(pname, retval));
 		} else if (strcmp(pname, "nice") == 0) {	/* set nice */
-			if (set_mode == SET_LIMIT_SET) {
-				errno = 0;
-				if ((nice((int)pres->rs_value.at_val.at_long) == -1)
-					&& (errno != 0))
-					return (error(pname, PBSE_BADATVAL));
-			}
+			ml->ml_set |= ML_NICE;
+			ml->ml_nice = (int)pres->rs_value.at_val.at_long;
 		} else if (strcmp(pname, "file") == 0) {	/* set */
-			if (set_mode == SET_LIMIT_SET) {
-				retval = local_getsize(pres, &value);
-				if (retval != PBSE_NONE)
-					return (error(pname, retval));
-				reslim.rlim_cur = reslim.rlim_max = value;
-				if (setrlimit(RLIMIT_FSIZE, &reslim) < 0)
-					return (error(pname, PBSE_SYSTEM));
-			}
+			retval = local_getsize(pres, &value);
+			if (retval != PBSE_NONE)
+				return (error(pname, retval));
+			ml->ml_set |= ML_FSIZE;
+			ml->ml_fsize = value;
 		}
 		pres = (resource *)GET_NEXT(pres->rs_link);
 	}
 
-	if (set_mode == SET_LIMIT_SET) {
-		/* if either vmem or pvmem was given, set sys limit to lesser */
-		if (vmem_limit != 0) {
-			reslim.rlim_cur = reslim.rlim_max = vmem_limit;
-			if (setrlimit(RLIMIT_AS, &reslim) < 0)
-				return (error("RLIMIT_AS", PBSE_SYSTEM));
-		}
+	/* if either vmem or pvmem was given, set sys limit to lesser */
+	if (vmem_limit != 0) {
+		ml->ml_set |= ML_AS;
+		ml->ml_as = vmem_limit;
+	}
 
-		/* if either mem or pmem was given, set sys limit to lesser */
-		if (mem_limit != 0) {
-			reslim.rlim_cur = reslim.rlim_max = mem_limit;
-			if (setrlimit(RLIMIT_RSS, &reslim) < 0)
-				return (error("RLIMIT_RSS", PBSE_SYSTEM));
-		}
+	/* if either mem or pmem was given, set sys limit to lesser */
+	if (mem_limit != 0) {
+		ml->ml_set |= ML_RSS;
+		ml->ml_rss = mem_limit;
+	}
 
-		/* if either cput or pcput was given, set sys limit to lesser */
-		if (cput_limit != 0) {
-			reslim.rlim_cur = reslim.rlim_max =
-				(ulong)((double)cput_limit / cputfactor);
-			if (setrlimit(RLIMIT_CPU, &reslim) < 0)
-				return (error("RLIMIT_CPU", PBSE_SYSTEM));
-		}
+	/* if either cput or pcput was given, set sys limit to lesser */
+	if (cput_limit != 0) {
+		ml->ml_set |= ML_CPU;
+		ml->ml_cpu = (ulong)((double)cput_limit / cputfactor);
+	}
+	return (PBSE_NONE);
+}
+
+/**
+ * @brief
+ *	Apply limits worked out by mom_get_limits() to the current process.
+ *
+ *	Must be called from the process that becomes the job, while it is
+ *	still running as root.
+ *
+ * @param[in]	ml - limits to apply
+ *
+ * @return	int
+ * @retval	PBSE_NONE	Success
+ * @retval	PBSE_*		Error
+ *
+ */
+int
+mom_apply_limits(mom_limits_t *ml)
+{
+	struct rlimit	reslim;
+
+	if (ml->ml_set & ML_NICE) {
+		errno = 0;
+		if ((nice(ml->ml_nice) == -1) && (errno != 0))
+			return (error("nice", PBSE_BADATVAL));
+	}
+	if (ml->ml_set & ML_FSIZE) {
+		reslim.rlim_cur = reslim.rlim_max = ml->ml_fsize;
+		if (setrlimit(RLIMIT_FSIZE, &reslim) < 0)
+			return (error("file", PBSE_SYSTEM));
+	}
+	if (ml->ml_set & ML_AS) {
+		reslim.rlim_cur = reslim.rlim_max = ml->ml_as;
+		if (setrlimit(RLIMIT_AS, &reslim) < 0)
+			return (error("RLIMIT_AS", PBSE_SYSTEM));
+	}
+	if (ml->ml_set & ML_RSS) {
+		reslim.rlim_cur = reslim.rlim_max = ml->ml_rss;
+		if (setrlimit(RLIMIT_RSS, &reslim) < 0)
+			return (error("RLIMIT_RSS", PBSE_SYSTEM));
 	}
+	if (ml->ml_set & ML_CPU) {
+		reslim.rlim_cur = reslim.rlim_max = ml->ml_cpu;
+		if (setrlimit(RLIMIT_CPU, &reslim) < 0)
+			return (error("RLIMIT_CPU", PBSE_SYSTEM));
+	}
+	return (PBSE_NONE);
+}
+
+/**
+ * @brief
+ * 	Establish system-enforced limits for the job.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in]  set_mode	- setting mode
+ *
+ *	If set_mode is SET_LIMIT_SET, then also set hard limits for the
+ *			  system enforced limits (not-polled).
+ *	If anything goes wrong with the process, return a PBS error code
+ *	and print a message on standard error.  A zero-length resource list
+ *	is not an error.
+ *
+ *	If set_mode is SET_LIMIT_SET the entry conditions are:
+ *	    1.	MOM has already forked, and we are called from the child.
+ *	    2.	The child is still running as root.
+ *	    3.  Standard error is open to the user's file.
+ *
+ *	If set_mode is SET_LIMIT_ALTER, we are beening called to modify
+ *	existing limits.  Cannot alter those set by setrlimit (kernel)
+ *	because we are the wrong process.
+ *
+ * @return	int
+ * @retval	PBSE_NONE	Success
+ * @retval	PBSE_*		Error
+ *
+ */
+int
+mom_set_limits(job *pjob, int set_mode)
+{
+	mom_limits_t	ml;
+	int		retval;
+
+	if ((retval = mom_get_limits(pjob, &ml)) != PBSE_NONE)
+		return (retval);
+	if (set_mode == SET_LIMIT_SET)
+		return (mom_apply_limits(&ml));
 	return (PBSE_NONE);
 }
 
@@ -945,31 +1012,143 @@ mom_open_poll(void)
 
 /**
  * @brief
- * 	Declare start of polling loop.
+ *	Read /proc/<pid>/stat for one process into a proc_info slot.
+ *
+ * @param[in]	name - name of the /proc entry ("<pid>" or ".<pid>")
+ * @param[in]	nomem - if set, do not account vsize/rss (thread entry)
+ * @param[out]	ps - slot to fill in
  *
  * @return	int
- * @retval	PBSE_INTERNAL	Dir pdir in NULL
- * @retval	PBSE_NONE	Success
+ * @retval	0	Success
+ * @retval	1	process is owned by root, skipped
+ * @retval	-1	process could not be read
  *
  */
-int
-mom_get_sample(void)
+static int
+proc_stat_read(char *name, int nomem, proc_stat_t *ps)
 {
-	struct dirent		*dent = NULL;
 	FILE			*fd = NULL;
 	static char		path[MAXPATHLEN + 1];
-	char			procname[MAXPATHLEN + 1]; /* space for dent->d_name plus extra */
+	char			procname[MAXPATHLEN + 1]; /* space for name plus extra */
 	char			procid[MAXPATHLEN + 1];
 	struct stat		sb;
-	proc_stat_t		*ps = NULL;
+	unsigned long long 	starttime;
+	char			*stat_str = NULL;
+
+	snprintf(procid, sizeof(procid), "/proc/%s", name);
+	if ((stat(procid, &sb) == -1) || (sb.st_uid == 0)) {
+		/* ignore root-owned processes */
+		return 1;
+	}
+	snprintf(procname, sizeof(procname), "/proc/%s/stat", name);
+
+	if ((fd = fopen(procname, "r")) == NULL)
+		return -1;
+
+	stat_str = choose_procflagsfmt();
+	if (stat_str == NULL) {
+		log_err(errno, __func__, "choose_procflagsfmt allocation failed");
+		fclose(fd);
+		return -1;
+	}
+	if (fscanf(fd, stat_str,
+		   &ps->pid,		/* "%d "	1  pid %d The process id */
+		   path,		/* "(%[^)]) "	2  comm %s The filename of the executable */
+		   &ps->state,		/* "%c "	3  state %c "RSDZTW" */
+		   &ps->ppid,		/* "%d "	4  ppid %d The PID of the parent */
+		   &ps->pgrp,		/* "%d "	5  pgrp %d The process group ID */
+		   &ps->session,	/* "%d "	6  session %d The session ID */
+				   	/* "%*d "	7  ignored:  tty_nr */
+	 		   		/* "%*d "	8  ignored:  tpgid */
+		   &ps->flags,		/* "%u or %lu"	9  flags */
+				   	/* "%*lu "	10 ignored:  minflt */
+				   	/* "%*lu "	11 ignored:  cminflt */
+				   	/* "%*lu "	12 ignored:  majflt */
+				   	/* "%*lu "	13 ignored:  cmajflt */
+		   &ps->utime,		/* "%lu "	14 utime %lu */
+		   &ps->stime,		/* "%lu "	15 stime %lu */
+		   &ps->cutime,		/* "%ld "	16 cutime %ld */
+		   &ps->cstime,		/* "%ld "	17 cstime %ld */
+				   	/* "%*ld "	18 ignored:  priority %ld */
+		   			/* "%*ld "	19 ignored:  nice %ld */
+		   			/* "%*ld "	20 ignored:  num_threads %ld */
+		   			/* "%*ld "	21 ignored:  itrealvalue %ld - no longer maintained */
+		   &starttime,		/* "%llu "	22 starttime (was %lu before Linux 2.6 - see proc(5) for conversion details */
+		   &ps->vsize,		/* "%lu "	23 vsize (bytes) */
+		   &ps->rss		/* "%ld "	24 rss (number of pages) */
+		) != 14) {
+		fclose(fd);
+		return -1;
+	}
+
+	if (fstat(fileno(fd), &sb) == -1) {
+		fclose(fd);
+		return -1;
+	}
+	ps->uid = sb.st_uid;
+	fclose(fd);
+
+	/*
+	 ** A .pid thread shows the memory of the process
+	 ** but we only want to count it once.
+	 */
+	if (nomem) {
+		ps->vsize = 0;
+		ps->rss = 0;
+	}
+
+	ps->start_time = linux_time + (starttime / hz);
+	snprintf(ps->comm, sizeof(ps->comm), "%.*s",
+		(int)(sizeof(ps->comm) - 1), path);
+
+	ps->utime = JTOS(ps->utime);
+	ps->stime = JTOS(ps->stime);
+	ps->cutime = JTOS(ps->cutime);
+	ps->cstime = JTOS(ps->cstime);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Make room for one more entry in the proc_info table.
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_info_grow(void)
+{
+	void	*hold;
+
+	if (++nproc < max_proc)
+		return;
+	DBPRT(("%s: alloc more proc table space %d\n", __func__, nproc))
+	max_proc += TBL_INC;
+	hold = realloc((void *)proc_info, max_proc*sizeof(proc_stat_t));
+	assert(hold != NULL);
+	proc_info = (proc_stat_t *)hold;
+}
+
+/**
+ * @brief
+ * 	Load proc_info with every non-root process on the system by
+ *	walking /proc.
+ *
+ * @return	int
+ * @retval	PBSE_INTERNAL	Dir pdir in NULL
+ * @retval	PBSE_NONE	Success
+ *
+ */
+static int
+mom_get_sample_all(void)
+{
+	struct dirent		*dent = NULL;
 	int			nprocs = 0;
 	int			ncached = 0;
 	int			ncantstat = 0;
 	int			nnomem = 0;
-	unsigned long long 	starttime;
 	int			nskipped = 0;
 	extern time_t		time_last_sample;
-	char			*stat_str = NULL;
 
 	/* There are no job tasks created in mock run mode, so no need to walk the proc table */
 	if (mock_run)
@@ -981,14 +1160,12 @@ mom_get_sample(void)
 
 	rewinddir(pdir);
 	nproc = 0;
-	fd = NULL;
 	if (hz == 0)
 		hz = sysconf(_SC_CLK_TCK);
 	time_last_sample = time(0);
 	sampletime_floor = time_last_sample;
 	while (errno = 0, (dent = readdir(pdir)) != NULL) {
 		int	nomem = 0;
-		struct	stat	sbuf;
 
 		nprocs++;
 
@@ -1002,102 +1179,566 @@ mom_get_sample(void)
 			} else
 				continue;
 		}
-		snprintf(procid, sizeof(procid), "/proc/%s", dent->d_name);
-		if ((stat(procid, &sbuf) == -1) || (sbuf.st_uid == 0)) {
-			/* ignore root-owned processes */
-			nskipped++;
-			continue;
+
+		switch (proc_stat_read(dent->d_name, nomem, &proc_info[nproc])) {
+			case 0:
+				proc_info_grow();
+				break;
+			case 1:
+				nskipped++;
+				break;
+			default:
+				ncantstat++;
+				break;
 		}
-		snprintf(procname, sizeof(procname), "/proc/%s/stat", dent->d_name);
+	}
+	if (errno != 0 && errno != ENOENT)
+		log_err(errno, __func__, "readdir");
+	sampletime_ceil = time_last_sample;
+	sprintf(log_buffer,
+		"nprocs:  %d, cantstat:  %d, nomem:  %d, skipped:  %d, "
+		"cached:  %d",
+		nprocs - 2, ncantstat, nnomem, nskipped,
+		ncached);
+	log_event(PBSEVENT_DEBUG4, 0, LOG_DEBUG, __func__, log_buffer);
+	return (PBSE_NONE);
+}
+
+/*
+ * Process event tracker.
+ *
+ * When $proc_events is enabled, MoM subscribes to the kernel proc
+ * connector and keeps a table of every process on the node along with
+ * its parent and session, updated as fork, setsid and exit events arrive.
+ * Sampling and killing a job session then only has to look at the
+ * processes that belong to job tasks instead of walking all of /proc.
+ * If the event stream is lost (socket overrun) the table is rebuilt from
+ * /proc; if the connector cannot be used at all the tracker turns itself
+ * off and the /proc scan is used as before.
+ */
+typedef struct proc_track {
+	pid_t	pt_pid;
+	pid_t	pt_ppid;
+	pid_t	pt_sid;
+} proc_track_t;
+
+int		proc_events = 0;	/* $proc_events config option */
+static int	proc_track_fd = -1;	/* proc connector socket */
+static int	proc_track_stale = 1;	/* table must be rebuilt from /proc */
+static void	*proc_track_idx = NULL;	/* pid -> proc_track_t */
+static int	proc_snapshot = 0;	/* kill_session uses held sample */
+
+static void proc_track_close(void);
+
+/**
+ * @brief
+ *	Add or update a process in the tracked table.
+ *
+ * @param[in]	pid - process id
+ * @param[in]	ppid - parent process id
+ * @param[in]	sid - session id
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_track_add(pid_t pid, pid_t ppid, pid_t sid)
+{
+	proc_track_t	*pt = NULL;
+	void		*key = &pid;
+
+	if (pbs_idx_find(proc_track_idx, &key, (void **)&pt, NULL) == PBS_IDX_RET_OK) {
+		pt->pt_ppid = ppid;
+		pt->pt_sid = sid;
+		return;
+	}
+	if ((pt = malloc(sizeof(proc_track_t))) == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		proc_track_stale = 1;
+		return;
+	}
+	pt->pt_pid = pid;
+	pt->pt_ppid = ppid;
+	pt->pt_sid = sid;
+	if (pbs_idx_insert(proc_track_idx, &pt->pt_pid, pt) != PBS_IDX_RET_OK) {
+		free(pt);
+		proc_track_stale = 1;
+	}
+}
+
+/**
+ * @brief
+ *	Look up a process in the tracked table.
+ *
+ * @param[in]	pid - process id
+ *
+ * @return	proc_track_t *
+ * @retval	entry for pid
+ * @retval	NULL	pid is not tracked
+ *
+ */
+static proc_track_t *
+proc_track_find(pid_t pid)
+{
+	proc_track_t	*pt = NULL;
+	void		*key = &pid;
 
-		if ((fd = fopen(procname, "r")) == NULL) {
-			ncantstat++;
+	if (pbs_idx_find(proc_track_idx, &key, (void **)&pt, NULL) != PBS_IDX_RET_OK)
+		return NULL;
+	return pt;
+}
+
+/**
+ * @brief
+ *	Remove a process from the tracked table.
+ *
+ * @param[in]	pid - process id
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_track_del(pid_t pid)
+{
+	proc_track_t	*pt;
+
+	if ((pt = proc_track_find(pid)) == NULL)
+		return;
+	pbs_idx_delete(proc_track_idx, &pt->pt_pid);
+	free(pt);
+}
+
+/**
+ * @brief
+ *	Empty the tracked table.
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_track_clear(void)
+{
+	void		*ctx = NULL;
+	void		*key = NULL;
+	proc_track_t	*pt = NULL;
+
+	if (proc_track_idx == NULL)
+		return;
+	while (pbs_idx_find(proc_track_idx, &key, (void **)&pt, &ctx) == PBS_IDX_RET_OK)
+		free(pt);
+	pbs_idx_free_ctx(ctx);
+	pbs_idx_destroy(proc_track_idx);
+	proc_track_idx = NULL;
+}
+
+/**
+ * @brief
+ *	Rebuild the tracked table from /proc.
+ *
+ * @par
+ *	The connector must already be subscribed so that events for
+ *	processes that come and go while /proc is read are queued and
+ *	applied afterwards.
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	Error
+ *
+ */
+static int
+proc_track_seed(void)
+{
+	struct dirent	*dent;
+	FILE		*fp;
+	char		path[MAXPATHLEN + 1];
+	int		pid, ppid, sid;
+
+	if (pdir == NULL)
+		return -1;
+
+	proc_track_clear();
+	if ((proc_track_idx = pbs_idx_create(0, sizeof(pid_t))) == NULL) {
+		log_err(errno, __func__, "failed to create proc track index");
+		return -1;
+	}
+
+	rewinddir(pdir);
+	while ((dent = readdir(pdir)) != NULL) {
+		if (!isdigit(dent->d_name[0]))
 			continue;
-		}
+		snprintf(path, sizeof(path), "/proc/%s/stat", dent->d_name);
+		if ((fp = fopen(path, "r")) == NULL)
+			continue;
+		if (fscanf(fp, "%d (%*[^)]) %*c %d %*d %d", &pid, &ppid, &sid) == 3)
+			proc_track_add(pid, ppid, sid);
+		fclose(fp);
+	}
+	proc_track_stale = 0;
+	return 0;
+}
 
-		ps = &proc_info[nproc];
-		stat_str = choose_procflagsfmt();
-		if (stat_str == NULL) {
-			log_err(errno, __func__, "choose_procflagsfmt allocation failed");
-			return PBSE_INTERNAL;
+/**
+ * @brief
+ *	Read and apply all queued proc connector events.
+ *
+ * @par
+ *	Called from the MoM main loop when the connector socket is readable,
+ *	and before the table is used so that it reflects every event the
+ *	kernel has sent so far.
+ *
+ * @param[in]	fd - proc connector socket
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_track_read(int fd)
+{
+	char			buf[8192] __attribute__ ((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr		*nlh;
+	struct cn_msg		*cn;
+	struct proc_event	*ev;
+	proc_track_t		*pt;
+	ssize_t			len;
+
+	for (;;) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				/* events were dropped, the table can not be trusted */
+				log_event(PBSEVENT_DEBUG, 0, LOG_INFO, __func__,
+					"proc connector overrun, rescanning /proc");
+				proc_track_stale = 1;
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				log_err(errno, __func__, "recv");
+				proc_track_close();
+			}
+			return;
 		}
-		if (fscanf(fd, stat_str,
-			   &ps->pid,		/* "%d "	1  pid %d The process id */
-			   path,		/* "(%[^)]) "	2  comm %s The filename of the executable */
-			   &ps->state,		/* "%c "	3  state %c "RSDZTW" */
-			   &ps->ppid,		/* "%d "	4  ppid %d The PID of the parent */
-			   &ps->pgrp,		/* "%d "	5  pgrp %d The process group ID */
-			   &ps->session,	/* "%d "	6  session %d The session ID */
-				   		/* "%*d "	7  ignored:  tty_nr */
-	 		   			/* "%*d "	8  ignored:  tpgid */
-			   &ps->flags,		/* "%u or %lu"	9  flags */
-					   	/* "%*lu "	10 ignored:  minflt */
-					   	/* "%*lu "	11 ignored:  cminflt */
-					   	/* "%*lu "	12 ignored:  majflt */
-					   	/* "%*lu "	13 ignored:  cmajflt */
-			   &ps->utime,		/* "%lu "	14 utime %lu */
-			   &ps->stime,		/* "%lu "	15 stime %lu */
-			   &ps->cutime,		/* "%ld "	16 cutime %ld */
-			   &ps->cstime,		/* "%ld "	17 cstime %ld */
-				   		/* "%*ld "	18 ignored:  priority %ld */
-			   			/* "%*ld "	19 ignored:  nice %ld */
-			   			/* "%*ld "	20 ignored:  num_threads %ld */
-			   			/* "%*ld "	21 ignored:  itrealvalue %ld - no longer maintained */
-			   &starttime,		/* "%llu "	22 starttime (was %lu before Linux 2.6 - see proc(5) for conversion details */
-			   &ps->vsize,		/* "%lu "	23 vsize (bytes) */
-			   &ps->rss		/* "%ld "	24 rss (number of pages) */
-			) != 14) {
-			ncantstat++;
-			fclose(fd);
-			continue;
+		if (len == 0)
+			return;
+
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+			nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == NLMSG_NOOP)
+				continue;
+			if ((nlh->nlmsg_type == NLMSG_ERROR) ||
+				(nlh->nlmsg_type == NLMSG_OVERRUN)) {
+				proc_track_stale = 1;
+				continue;
+			}
+			cn = NLMSG_DATA(nlh);
+			if ((cn->id.idx != CN_IDX_PROC) || (cn->id.val != CN_VAL_PROC))
+				continue;
+			if (proc_track_stale)
+				continue;
+			ev = (struct proc_event *)cn->data;
+			switch (ev->what) {
+				case PROC_EVENT_FORK:
+					/* new threads are not separate processes */
+					if (ev->event_data.fork.child_pid !=
+						ev->event_data.fork.child_tgid)
+						break;
+					pt = proc_track_find(ev->event_data.fork.parent_tgid);
+					proc_track_add(ev->event_data.fork.child_tgid,
+						ev->event_data.fork.parent_tgid,
+						pt ? pt->pt_sid : 0);
+					break;
+
+				case PROC_EVENT_SID:
+					if (ev->event_data.sid.process_pid !=
+						ev->event_data.sid.process_tgid)
+						break;
+					if ((pt = proc_track_find(ev->event_data.sid.process_tgid)) != NULL)
+						pt->pt_sid = pt->pt_pid;
+					break;
+
+				case PROC_EVENT_EXIT:
+					if (ev->event_data.exit.process_pid !=
+						ev->event_data.exit.process_tgid)
+						break;
+					proc_track_del(ev->event_data.exit.process_tgid);
+					break;
+
+				default:
+					break;
+			}
 		}
+	}
+}
 
-		if (fstat(fileno(fd), &sb) == -1) {
-			fclose(fd);
-			continue;
+/**
+ * @brief
+ *	Open the proc connector socket and subscribe to process events.
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	Error, the caller falls back to scanning /proc
+ *
+ */
+static int
+proc_track_open(void)
+{
+	int			fd;
+	struct sockaddr_nl	sa;
+	char			buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+	struct nlmsghdr		*nlh;
+	struct cn_msg		*cn;
+	enum proc_cn_mcast_op	op = PROC_CN_MCAST_LISTEN;
+	int			rcvbuf = 4 * 1024 * 1024;
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (fd == -1) {
+		log_err(errno, __func__, "socket(NETLINK_CONNECTOR)");
+		return -1;
+	}
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	memset(&sa, 0, sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = CN_IDX_PROC;
+	sa.nl_pid = 0;
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1) {
+		log_err(errno, __func__, "bind(CN_IDX_PROC)");
+		close(fd);
+		return -1;
+	}
+
+	memset(buf, 0, sizeof(buf));
+	nlh = (struct nlmsghdr *)buf;
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_pid = getpid();
+	cn = NLMSG_DATA(nlh);
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(op);
+	memcpy(cn->data, &op, sizeof(op));
+	if (send(fd, nlh, nlh->nlmsg_len, 0) == -1) {
+		log_err(errno, __func__, "send(PROC_CN_MCAST_LISTEN)");
+		close(fd);
+		return -1;
+	}
+
+	if (add_conn(fd, ChildPipe, (pbs_net_t)0, 0, NULL, proc_track_read) == NULL) {
+		log_err(-1, __func__, "add_conn failed");
+		close(fd);
+		return -1;
+	}
+	proc_track_fd = fd;
+	proc_track_stale = 1;
+
+	log_event(PBSEVENT_SYSTEM, 0, LOG_INFO, __func__,
+		"tracking job processes with the proc connector");
+	return 0;
+}
+
+/**
+ * @brief
+ *	Stop tracking process events and drop the tracked table.
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_track_close(void)
+{
+	if (proc_track_fd != -1) {
+		close_conn(proc_track_fd);
+		proc_track_fd = -1;
+	}
+	proc_track_clear();
+	proc_track_stale = 1;
+}
+
+/**
+ * @brief
+ *	Make the tracked table current and say whether it can be used.
+ *
+ * @par
+ *	Opens or closes the connector to follow the $proc_events setting,
+ *	applies queued events and rebuilds the table if events were lost.
+ *	If the connector can not be opened $proc_events is turned off.
+ *
+ * @return	int
+ * @retval	1	the tracked table is current
+ * @retval	0	the caller must scan /proc
+ *
+ */
+static int
+proc_track_ready(void)
+{
+	if (!proc_events) {
+		if (proc_track_fd != -1)
+			proc_track_close();
+		return 0;
+	}
+	if (proc_track_fd == -1) {
+		if (proc_track_open() == -1) {
+			log_event(PBSEVENT_SYSTEM, 0, LOG_WARNING, __func__,
+				"proc connector unavailable, disabling $proc_events");
+			proc_events = 0;
+			return 0;
 		}
-		ps->uid = sb.st_uid;
-		fclose(fd);
+	}
+	proc_track_read(proc_track_fd);
+	if (proc_track_fd == -1)
+		return 0;
+	if (proc_track_stale) {
+		if (proc_track_seed() == -1) {
+			proc_track_close();
+			proc_events = 0;
+			return 0;
+		}
+		/* apply what happened while /proc was read */
+		proc_track_read(proc_track_fd);
+		if ((proc_track_fd == -1) || proc_track_stale)
+			return 0;
+	}
+	return 1;
+}
 
-		/*
-		 ** A .pid thread shows the memory of the process
-		 ** but we only want to count it once.
-		 */
-		if (nomem) {
-			ps->vsize = 0;
-			ps->rss = 0;
+/**
+ * @brief
+ *	qsort/bsearch comparison for session ids.
+ */
+static int
+cmp_sid(const void *a, const void *b)
+{
+	pid_t	x = *(const pid_t *)a;
+	pid_t	y = *(const pid_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief
+ *	Collect the sorted session ids of all live job tasks.
+ *
+ * @param[out]	nsids - number of session ids returned
+ *
+ * @return	pid_t *
+ * @retval	array of session ids (static, valid until next call)
+ *
+ */
+static pid_t *
+job_sessions(int *nsids)
+{
+	static pid_t	*sids = NULL;
+	static int	max_sids = 0;
+	int		n = 0;
+	job		*pjob;
+	task		*ptask;
+
+	for (pjob = (job *)GET_NEXT(svr_alljobs); pjob;
+		pjob = (job *)GET_NEXT(pjob->ji_alljobs)) {
+		for (ptask = (task *)GET_NEXT(pjob->ji_tasks); ptask;
+			ptask = (task *)GET_NEXT(ptask->ti_jobtask)) {
+			if (ptask->ti_qs.ti_sid <= 1)
+				continue;
+			if (n == max_sids) {
+				void	*hold;
+
+				hold = realloc(sids, (max_sids + TBL_INC) * sizeof(pid_t));
+				assert(hold != NULL);
+				sids = (pid_t *)hold;
+				max_sids += TBL_INC;
+			}
+			sids[n++] = ptask->ti_qs.ti_sid;
 		}
+	}
+	if (n > 1)
+		qsort(sids, n, sizeof(pid_t), cmp_sid);
+	*nsids = n;
+	return sids;
+}
+
+/**
+ * @brief
+ *	Load proc_info with the processes of job task sessions only,
+ *	taking the list of pids from the tracked table.
+ *
+ * @return	int
+ * @retval	PBSE_NONE	Success
+ *
+ */
+static int
+proc_track_sample(void)
+{
+	void		*ctx = NULL;
+	void		*key = NULL;
+	proc_track_t	*pt = NULL;
+	pid_t		*sids;
+	int		nsids;
+	int		ntracked = 0;
+	int		ncantstat = 0;
+	char		name[32];
+	extern time_t	time_last_sample;
+
+	nproc = 0;
+	if (hz == 0)
+		hz = sysconf(_SC_CLK_TCK);
+	time_last_sample = time(0);
+	sampletime_floor = time_last_sample;
 
-		ps->start_time = linux_time + (starttime / hz);
-		snprintf(ps->comm, sizeof(ps->comm), "%.*s",
-			(int)(sizeof(ps->comm) - 1), path);
-
-		ps->utime = JTOS(ps->utime);
-		ps->stime = JTOS(ps->stime);
-		ps->cutime = JTOS(ps->cutime);
-		ps->cstime = JTOS(ps->cstime);
-		if (++nproc == max_proc) {
-			void	*hold;
-			DBPRT(("%s: alloc more proc table space %d\n", __func__, nproc))
-			max_proc += TBL_INC;
-			hold = realloc((void *)proc_info,
-				max_proc*sizeof(proc_stat_t));
-			assert(hold != NULL);
-			proc_info = (proc_stat_t *)hold;
+	sids = job_sessions(&nsids);
+	if (nsids > 0) {
+		while (pbs_idx_find(proc_track_idx, &key, (void **)&pt, &ctx) == PBS_IDX_RET_OK) {
+			ntracked++;
+			if (pt->pt_pid <= 1)
+				continue;
+			if (bsearch(&pt->pt_sid, sids, nsids, sizeof(pid_t), cmp_sid) == NULL)
+				continue;
+			snprintf(name, sizeof(name), "%d", (int)pt->pt_pid);
+			switch (proc_stat_read(name, 0, &proc_info[nproc])) {
+				case 0:
+					proc_info_grow();
+					break;
+				case 1:
+					break;
+				default:
+					ncantstat++;
+					break;
+			}
 		}
+		pbs_idx_free_ctx(ctx);
 	}
-	if (errno != 0 && errno != ENOENT)
-		log_err(errno, __func__, "readdir");
 	sampletime_ceil = time_last_sample;
-	sprintf(log_buffer,
-		"nprocs:  %d, cantstat:  %d, nomem:  %d, skipped:  %d, "
-		"cached:  %d",
-		nprocs - 2, ncantstat, nnomem, nskipped,
-		ncached);
+	sprintf(log_buffer, "tracked:  %d, sampled:  %d, cantstat:  %d",
+		ntracked, nproc, ncantstat);
 	log_event(PBSEVENT_DEBUG4, 0, LOG_DEBUG, __func__, log_buffer);
 	return (PBSE_NONE);
 }
 
+/**
+ * @brief
+ * 	Declare start of polling loop.
+ *
+ * @par
+ *	When the process event tracker is active only the processes that
+ *	belong to job task sessions are read, otherwise all of /proc is
+ *	walked.
+ *
+ * @return	int
+ * @retval	PBSE_INTERNAL	Dir pdir in NULL
+ * @retval	PBSE_NONE	Success
+ *
+ */
+int
+mom_get_sample(void)
+{
+	if (mock_run)
+		return PBSE_NONE;
+
+	if (proc_track_ready())
+		return (proc_track_sample());
+	return (mom_get_sample_all());
+}
+
 /**
  * @brief
  * 	Update the resources used.<attributes> of a job.
@@ -1227,6 +1868,74 @@ mom_set_use(job *pjob)
 	return (PBSE_NONE);
 }
 
+/**
+ * @brief
+ *	Append a process to the Proc_lnks table.
+ *
+ * @param[in]	pid - process id
+ * @param[in]	ppid - parent process id
+ * @param[in,out]	ct - number of entries in Proc_lnks
+ *
+ * @return	Void
+ *
+ */
+static void
+plinks_add(pid_t pid, pid_t ppid, int *ct)
+{
+	if (Proc_lnks == NULL) {
+		Proc_lnks = (pbs_plinks *)malloc(TBL_INC * sizeof(pbs_plinks));
+		assert(Proc_lnks != NULL);
+		myproc_max = TBL_INC;
+	}
+
+	Proc_lnks[*ct].pl_pid = pid;
+	Proc_lnks[*ct].pl_ppid = ppid;
+	Proc_lnks[*ct].pl_parent = -1;
+	Proc_lnks[*ct].pl_sib = -1;
+	Proc_lnks[*ct].pl_child = -1;
+	Proc_lnks[*ct].pl_done = 0;
+	if (++(*ct) == myproc_max) {
+		void * hold;
+
+		myproc_max += TBL_INC;
+		hold = realloc((void *)Proc_lnks,
+			myproc_max*sizeof(pbs_plinks));
+		assert(hold != NULL);
+		Proc_lnks = (pbs_plinks *)hold;
+	}
+}
+
+/**
+ * @brief
+ *	Establish parent, child and sibling links between the first
+ *	myproc_ct entries of Proc_lnks.
+ *
+ * @param[in]	myproc_ct - number of entries in Proc_lnks
+ *
+ * @return	Void
+ *
+ */
+static void
+plinks_link(int myproc_ct)
+{
+	int	i, j;
+
+	for (i = 0; i < myproc_ct; i++) {
+		/*
+		 * Find all the children for this process, establish links.
+		 */
+		for (j = 0; j < myproc_ct; j++) {
+			if (j == i)
+				continue;
+			if (Proc_lnks[j].pl_ppid == Proc_lnks[i].pl_pid) {
+				Proc_lnks[j].pl_parent = i;
+				Proc_lnks[j].pl_sib = Proc_lnks[i].pl_child;
+				Proc_lnks[i].pl_child = j;
+			}
+		}
+	}
+}
+
 /**
  * @brief
  * 	bld_ptree - establish links (parent, child, and sibling) for processes
@@ -1247,13 +1956,7 @@ int
 bld_ptree(pid_t sid)
 {
 	int	myproc_ct;		/* count of processes in a session */
-	int	i, j;
-
-	if (Proc_lnks == NULL) {
-		Proc_lnks = (pbs_plinks *)malloc(TBL_INC * sizeof(pbs_plinks));
-		assert(Proc_lnks != NULL);
-		myproc_max = TBL_INC;
-	}
+	int	i;
 
 	/*
 	 * Build links for processes in the session in question.
@@ -1264,44 +1967,48 @@ bld_ptree(pid_t sid)
 	for (i = 0; i < nproc; i++) {
 		if (PBS_PROC_PID(i) <= 1)
 			continue;
-		if ((int)PBS_PROC_SID(i) == sid) {
-			Proc_lnks[myproc_ct].pl_pid = PBS_PROC_PID(i);
-			Proc_lnks[myproc_ct].pl_ppid = PBS_PROC_PPID(i);
-			Proc_lnks[myproc_ct].pl_parent = -1;
-			Proc_lnks[myproc_ct].pl_sib = -1;
-			Proc_lnks[myproc_ct].pl_child = -1;
-			Proc_lnks[myproc_ct].pl_done = 0;
-			if (++myproc_ct == myproc_max) {
-				void * hold;
-
-				myproc_max += TBL_INC;
-				hold = realloc((void *)Proc_lnks,
-					myproc_max*sizeof(pbs_plinks));
-				assert(hold != NULL);
-				Proc_lnks = (pbs_plinks *)hold;
-			}
-		}
+		if ((int)PBS_PROC_SID(i) == sid)
+			plinks_add(PBS_PROC_PID(i), PBS_PROC_PPID(i), &myproc_ct);
 	}
 
 	/* Now build the tree for those processes */
+	plinks_link(myproc_ct);
 
-	for (i = 0; i < myproc_ct; i++) {
-		/*
-		 * Find all the children for this process, establish links.
-		 */
-		for (j = 0; j < myproc_ct; j++) {
-			if (j == i)
-				continue;
-			if (Proc_lnks[j].pl_ppid == Proc_lnks[i].pl_pid) {
-				Proc_lnks[j].pl_parent = i;
-				Proc_lnks[j].pl_sib = Proc_lnks[i].pl_child;
-				Proc_lnks[i].pl_child = j;
-			}
-		}
-	}
 	return (myproc_ct);	/* number of processes in session */
 }
 
+/**
+ * @brief
+ *	Same as bld_ptree() but takes the processes of the session from the
+ *	process event tracker instead of the last /proc sample.
+ *
+ * @param[in] sid - session id
+ *
+ * @return	int
+ * @retval	number of processes in session
+ *
+ */
+static int
+bld_ptree_tracked(pid_t sid)
+{
+	int		myproc_ct = 0;
+	void		*ctx = NULL;
+	void		*key = NULL;
+	proc_track_t	*pt = NULL;
+
+	while (pbs_idx_find(proc_track_idx, &key, (void **)&pt, &ctx) == PBS_IDX_RET_OK) {
+		if (pt->pt_pid <= 1)
+			continue;
+		if (pt->pt_sid == sid)
+			plinks_add(pt->pt_pid, pt->pt_ppid, &myproc_ct);
+	}
+	pbs_idx_free_ctx(ctx);
+
+	plinks_link(myproc_ct);
+
+	return (myproc_ct);
+}
+
 /**
  * @brief
  * 	kill_ptree - traverse the process tree, killing the processes as we go
@@ -1379,8 +2086,14 @@ kill_session(pid_t sesid, int sig, int dir)
 	if (sesid <= 1)
 		return 0;
 
-	(void)mom_get_sample();
-	ct = bld_ptree(sesid);
+	if (proc_snapshot)
+		ct = bld_ptree(sesid);
+	else if (proc_track_ready())
+		ct = bld_ptree_tracked(sesid);
+	else {
+		(void)mom_get_sample_all();
+		ct = bld_ptree(sesid);
+	}
 	DBPRT(("%s: bld_ptree %d\n", __func__, ct))
 
 	/*
@@ -1411,6 +2124,46 @@ kill_session(pid_t sesid, int sig, int dir)
 	return ct;
 }
 
+/**
+ * @brief
+ *	Take one sample of the process table and have kill_session() use
+ *	it until mom_snapshot_release() is called.
+ *
+ * @par
+ *	Used on restart when many recovered sessions may be killed in a
+ *	row, so /proc is walked once rather than once for every session.
+ *	Processes started after the sample are still caught by the killpg()
+ *	done for SIGKILL.
+ *
+ * @return	int
+ * @retval	PBSE_NONE	Success
+ * @retval	PBSE_INTERNAL	proc table could not be read
+ *
+ */
+int
+mom_snapshot_hold(void)
+{
+	int	rc;
+
+	rc = mom_get_sample_all();
+	if (rc == PBSE_NONE)
+		proc_snapshot = 1;
+	return (rc);
+}
+
+/**
+ * @brief
+ *	Go back to sampling the process table on each kill_session().
+ *
+ * @return	void
+ *
+ */
+void
+mom_snapshot_release(void)
+{
+	proc_snapshot = 0;
+}
+
 /**
  * @brief
  *	Clean up everything related to polling.
@@ -1424,6 +2177,7 @@ int
 mom_close_poll(void)
 {
 	DBPRT(("%s: entered\n", __func__))
+	proc_track_close();
 	if (pdir) {
 		if (closedir(pdir) != 0) {
 			log_err(errno, __func__, "closedir");
@@ -1488,7 +2242,7 @@ getprocs(void)
 	if (lastproc == reqnum)		/* don't need new proc table */
 		return 1;
 
-	if (mom_get_sample() != PBSE_NONE)
+	if (mom_get_sample_all() != PBSE_NONE)
 		return 0;
 
 	lastproc = reqnum;
@@ -1558,7 +2312,7 @@ cput_proc(pid_t pid)
 	double		cputime;
 	proc_stat_t	*ps = NULL;
 
-	mom_get_sample();
+	mom_get_sample_all();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 		if (ps->pid == pid)
@@ -1637,7 +2391,7 @@ mem_job(pid_t sid)
 
 	memsize = 0;
 
-	mom_get_sample();
+	mom_get_sample_all();
 	for (i=0; i<nproc; i++) {
 
 		ps = &proc_info[i];
@@ -1674,7 +2428,7 @@ mem_proc(pid_t pid)
 	int		i;
 	proc_stat_t	*ps = NULL;
 
-	mom_get_sample();
+	mom_get_sample_all();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 		if (ps->pid == pid)
@@ -1752,7 +2506,7 @@ resi_job(pid_t jobid)
 	proc_stat_t	*ps;
 
 	resisize = 0;
-	mom_get_sample();
+	mom_get_sample_all();
 
 	for (i=0; i<nproc; i++) {
 
@@ -1792,7 +2546,7 @@ resi_proc(pid_t pid)
 	proc_stat_t	*ps = NULL;
 
 
-	mom_get_sample();
+	mom_get_sample_all();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 		if (ps->pid == pid)
@@ -1884,7 +2638,7 @@ sessions(struct rm_attribute *attrib)
 		return NULL;
 	}
 
-	mom_get_sample();
+	mom_get_sample_all();
 
 	/*
 	 ** Search for members of session
@@ -1999,7 +2753,7 @@ pids(struct rm_attribute *attrib)
 		return NULL;
 	}
 
-	mom_get_sample();
+	mom_get_sample_all();
 
 	/*
 	 ** Search for members of session
@@ -2059,7 +2813,7 @@ nusers(struct rm_attribute *attrib)
 		return NULL;
 	}
 
-	mom_get_sample();
+	mom_get_sample_all();
 	for (i=0; i<nproc; i++) {
 		ps = &proc_info[i];
 
@@ -2884,7 +3638,7 @@ walltime(struct rm_attribute *attrib)
 		rm_errno = RM_ERR_SYSTEM;
 		return NULL;
 	}
-	mom_get_sample();
+	mom_get_sample_all();
 
 	start = now;
 	for (i=0; i<nproc; i++) {
@@ -88,6 +88,9 @@ typedef struct	pbs_plinks {		/* struct to link processes */
 extern ulong totalmem;
 extern int kill_session(pid_t pid, int sig, int dir);
 extern int bld_ptree(pid_t sid);
+extern int mom_snapshot_hold(void);
+extern void mom_snapshot_release(void);
+extern int proc_events;
 
 /* struct startjob_rtn = used to pass error/session/other info 	*/
 /* 			child back to parent			*/
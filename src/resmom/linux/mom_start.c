@@ -670,7 +670,9 @@ scan_for_terminated(void)
 
 	/* Now figure out which task(s) have terminated (are zombies) */
 
-	while ((pid = waitpid(-1, &statloc, WNOHANG)) > 0) {
+	/* tasks started by the $launcher helper are reaped by it and queued */
+	while (((pid = waitpid(-1, &statloc, WNOHANG)) > 0) ||
+		((pid = launcher_reaped(&statloc)) > 0)) {
 		if (WIFEXITED(statloc))
 			exiteval = WEXITSTATUS(statloc);
 		else if (WIFSIGNALED(statloc))
@@ -116,6 +116,7 @@ extern int nsvrs;
 extern int mom_net_up;
 extern time_t mom_net_up_time;
 extern int max_poll_downtime_val;
+extern int max_check_poll;
 extern char *msg_err_malloc;
 extern int
 write_pipe_data(int upfds, void *data, int data_size);
@@ -220,6 +221,9 @@ pbs_jobnodevoid_t	job_free_node = NULL;
 #define TO_PHYNODE(vnode) pjob->ji_vnods[vnode].vn_host->hn_node
 
 eventent * event_dup(eventent *ep, job *pjob, hnodent *pnode);
+static int send_sisters_tree(job *pjob, int com);
+static void fanout_subtree_failed(job *pjob, int com, int k, int idx,
+	tm_event_t event, int errcode, int adopt);
 
 /**
  * @brief
@@ -349,6 +353,7 @@ event_alloc(job *pjob, int command, int fd, hnodent *pnode,
 	ep->ee_taskid = taskid;
 	ep->ee_argv = NULL;
 	ep->ee_envp = NULL;
+	ep->ee_fanout = 0;
 	CLEAR_LINK(ep->ee_next);
 
 	if ((ep->ee_event = eventnum++) == TM_NULL_EVENT) {
@@ -1633,6 +1638,22 @@ send_sisters_inner(job *pjob, int com, pbs_jobndstm_t command_func,
 	if (!(is_jattr_set(pjob, JOB_ATR_Cookie)))
 		return 0;
 
+	/*
+	 ** Job-wide commands go down the fan-out tree when it is
+	 ** configured and the job is big enough to make use of it.
+	 ** Jobs with released or failed nodes keep the flat path as
+	 ** their host list no longer matches on all the sisters.
+	 */
+	if ((sister_fanout > 1) &&
+		((com == IM_KILL_JOB) || (com == IM_POLL_JOB) ||
+		(com == IM_DELETE_JOB)) &&
+		(command_func == NULL) && (exclude_exec_host == NULL) &&
+		(pjob->ji_nodeid == 0) &&
+		(pjob->ji_numnodes - 1 > sister_fanout) &&
+		!pjob->ji_updated && !do_tolerate_node_failures(pjob) &&
+		(GET_NEXT(pjob->ji_failed_node_list) == NULL))
+		return send_sisters_tree(pjob, com);
+
 	cookie = get_jattr_str(pjob, JOB_ATR_Cookie);
 	num = 0;
 	for (i=0; i<pjob->ji_numnodes; i++) {
@@ -2175,6 +2196,13 @@ node_bailout(job *pjob, hnodent *np)
 				 */
 				DBPRT(("%s: KILL/ABORT JOB %s\n",
 					__func__, pjob->ji_qs.ji_jobid))
+				if (ep->ee_fanout) {
+					/* nobody below it will be heard from */
+					fanout_subtree_failed(pjob, ep->ee_command,
+						ep->ee_fanout, np - pjob->ji_hosts,
+						ep->ee_event, PBSE_SISCOMM, 0);
+					break;
+				}
 				for (i = 1; i < pjob->ji_numnodes; i++) {
 					if ((pjob->ji_hosts[i].hn_sister == SISTER_OKAY) && (reliable_job_node_find(&pjob->ji_failed_node_list, pjob->ji_hosts[i].hn_host) == NULL))
 						break;
@@ -2224,7 +2252,15 @@ node_bailout(job *pjob, hnodent *np)
 				/*
 				 ** I must be Mother Superior for the job and
 				 ** this is an error reply to a poll request.
+				 ** If the poll went down the fan-out tree, I may
+				 ** be a sister relaying it.
 				 */
+				if (ep->ee_fanout) {
+					fanout_subtree_failed(pjob, ep->ee_command,
+						ep->ee_fanout, np - pjob->ji_hosts,
+						ep->ee_event, PBSE_SISCOMM, 0);
+					break;
+				}
 				if (do_tolerate_node_failures(pjob)) {
 
 					snprintf(log_buffer, sizeof(log_buffer),
@@ -2702,6 +2738,67 @@ static	char	bail_format[] = "dis read failed: %s";
 		goto err; \
 	}
 
+/**
+ * @brief
+ *	Gather the resources_used values held in 'at' that need to
+ *	travel to the MS into the list 'send_head'.
+ *
+ * @param[in]  at - resources_used attribute to take the values from
+ * @param[in]  hook_only - if set, take only the resources set in a mom
+ *			   hook, skipping 'cput', 'mem' and 'cpupercent'
+ *			   which are sent separately
+ * @param[out] send_head - list the values are added to
+ *
+ * @return  int
+ * @retval -1     error
+ * @retval  >=0   number of values added to the list
+ *
+ */
+static int
+resc_used_list(attribute *at, int hook_only, pbs_list_head *send_head)
+{
+	extern int resc_access_perm;
+	attribute_def *ad;
+	svrattrl *pal;
+	svrattrl *nxpal;
+	pbs_list_head lhead;
+	int num = 0;
+
+	if (at->at_type != ATR_TYPE_RESC)
+		return (-1);
+	ad = &job_attr_def[(int) JOB_ATR_resc_used];
+	resc_access_perm = ATR_DFLAG_MGRD;
+
+	memset(&lhead, 0, sizeof(lhead));
+	CLEAR_HEAD(lhead);
+
+	(void) ad->at_encode(at, &lhead, ad->at_name, NULL, ATR_ENCODE_CLIENT, NULL);
+
+	pal = (svrattrl *) GET_NEXT(lhead);
+	while (pal != NULL) {
+		nxpal = (struct svrattrl *) GET_NEXT(pal->al_link);
+
+		/* no need to track the resources automatically sent to MS */
+		/* like 'cput', 'mem', and 'cpupercent',but only those */
+		/* resources that are set in a mom hook */
+		if (!hook_only ||
+		    ((pal->al_flags & ATR_VFLAG_HOOK) != 0 &&
+		    strcmp(pal->al_resc, "cput") != 0 &&
+		    strcmp(pal->al_resc, "mem") != 0 &&
+		    strcmp(pal->al_resc, "cpupercent") != 0)) {
+			if (add_to_svrattrl_list(send_head, pal->al_name, pal->al_resc,
+						 pal->al_value, pal->al_op, NULL) == -1) {
+				free_attrlist(&lhead);
+				return (-1);
+			}
+			num++;
+		}
+		pal = nxpal;
+	}
+	free_attrlist(&lhead);
+	return (num);
+}
+
 /**
  * @brief
  *	Send resources_used values to the MS via
@@ -2710,193 +2807,1278 @@ static	char	bail_format[] = "dis read failed: %s";
  * @param[in] stream - descriptor pathway to MS.
  * @param[in] pjob - poineter to owning job structure
  *
- * @return  error code
- * @retval -1     error
- * @retval  0     Success
+ * @return  error code
+ * @retval -1     error
+ * @retval  0     Success
+ *
+ */
+int
+send_resc_used_to_ms(int stream, job *pjob)
+{
+	pbs_list_head send_head;
+	svrattrl *psatl;
+	int ret;
+
+	if (pjob == NULL || stream == -1)
+		return (-1);
+
+	memset(&send_head, 0, sizeof(send_head));
+	CLEAR_HEAD(send_head);
+
+	if (resc_used_list(get_jattr(pjob, JOB_ATR_resc_used), 1, &send_head) <= 0) {
+		free_attrlist(&send_head);
+		return (-1);
+	}
+
+	psatl = (svrattrl *) GET_NEXT(send_head);
+	ret = encode_DIS_svrattrl(stream, psatl);
+	free_attrlist(&send_head);
+	if (ret != DIS_SUCCESS)
+		return (-1);
+	return (0);
+}
+
+/**
+ * @brief
+ *	Read a list of resources_used values from descriptor 'stream'
+ *	into the attribute 'at'.
+ *
+ * @param[in]  stream - descriptor pathway
+ * @param[out] at - attribute receiving the values
+ * @param[in]  replace - if set, drop what 'at' held before, otherwise
+ *			 update the values in place
+ *
+ * @return  error code
+ * @retval -1     error
+ * @retval  0     Success
+ *
+ */
+static int
+decode_resc_used(int stream, attribute *at, int replace)
+{
+	extern int resc_access_perm;
+	attribute_def *pdef;
+	pbs_list_head lhead;
+	svrattrl *psatl;
+	int errcode;
+
+	pdef = &job_attr_def[(int) JOB_ATR_resc_used];
+
+	CLEAR_HEAD(lhead);
+	if (decode_DIS_svrattrl(stream, &lhead) != DIS_SUCCESS) {
+		sprintf(log_buffer, "decode_DIS_svrattrl failed");
+		return (-1);
+	}
+	if (replace) {
+		if (is_attr_set(at) != 0)
+			pdef->at_free(at);
+		/* decode attributes from request into job structure */
+		clear_attr(at, pdef);
+	}
+
+	resc_access_perm = READ_WRITE;
+	psatl = (svrattrl *) GET_NEXT(lhead);
+	for (; psatl; psatl = (svrattrl *) GET_NEXT(psatl->al_link)) {
+
+		if ((psatl->al_name == NULL) || (psatl->al_resc == NULL)) {
+			free_attrlist(&lhead);
+			return (-1);
+		}
+
+		if (strcmp(psatl->al_name, ATTR_used) != 0) {
+			free_attrlist(&lhead);
+			return (-1);
+		}
+
+		errcode = set_attr_generic(at, pdef, psatl->al_value, psatl->al_resc, INTERNAL);
+		/* Unknown resources still get decoded */
+		/* under "unknown" resource def */
+		if ((errcode != 0) && (errcode != PBSE_UNKRESC)) {
+			free_attrlist(&lhead);
+			return (-1);
+		}
+
+		if (psatl->al_op == DFLT)
+			at->at_flags |= ATR_VFLAG_DEFLT;
+	}
+
+	free_attrlist(&lhead);
+	return (0);
+}
+
+/**
+ * @brief
+ *	Received resources_used values for job 'jobid'
+ *	from descriptor 'stream', with values to be saved in
+ *	internal nodes resources table indexed by 'nodeidx'.
+ *
+ * @param[in] stream - descriptor pathway
+ * @param[in] pjob - pointer to owning job structure
+ * @param[in] nodeidx - node index to the job's internal resources table
+ *			where received values will be saved.
+ *			resources values received from
+ *
+ * @return  error code
+ * @retval -1     error
+ * @retval  0     Success
+ *
+ */
+int
+recv_resc_used_from_sister(int stream, job *pjob, int nodeidx)
+{
+	if (pjob == NULL || stream == -1 || nodeidx < 0)
+		return (-1);
+
+	return (decode_resc_used(stream, &pjob->ji_resources[nodeidx].nr_used, 1));
+}
+
+/**
+ * @brief
+ *	Write what a node has used for a job to 'stream'.
+ *
+ *	node usage (
+ *		recommendation	int;
+ *		cput		u_long;
+ *		mem		u_long;
+ *		cpupercent	u_long;
+ *		have resc	int;
+ *		resc used	svrattrl; <if have resc>
+ *	)
+ *
+ * @param[in] stream - descriptor pathway
+ * @param[in] exitval - recommendation to kill the job
+ * @param[in] cput - cpu time used
+ * @param[in] mem - memory used
+ * @param[in] cpupercent - cpu percent used
+ * @param[in] at - resources_used values to send along
+ * @param[in] hook_only - send only the values in 'at' set by a mom hook
+ *
+ * @return  int
+ * @retval DIS_SUCCESS - success
+ * @retval other - DIS error
+ *
+ */
+static int
+send_node_usage(int stream, int exitval, u_long cput, u_long mem,
+	u_long cpupercent, attribute *at, int hook_only)
+{
+	pbs_list_head	send_head;
+	int		ret;
+
+	if ((ret = diswsi(stream, exitval)) != DIS_SUCCESS)
+		return ret;
+	if ((ret = diswul(stream, cput)) != DIS_SUCCESS)
+		return ret;
+	if ((ret = diswul(stream, mem)) != DIS_SUCCESS)
+		return ret;
+	if ((ret = diswul(stream, cpupercent)) != DIS_SUCCESS)
+		return ret;
+
+	CLEAR_HEAD(send_head);
+	if (resc_used_list(at, hook_only, &send_head) > 0) {
+		ret = diswsi(stream, 1);
+		if (ret == DIS_SUCCESS)
+			ret = encode_DIS_svrattrl(stream,
+				(svrattrl *)GET_NEXT(send_head));
+	} else
+		ret = diswsi(stream, 0);
+	free_attrlist(&send_head);
+	return ret;
+}
+
+/**
+ * @brief
+ *	Read what a node has used for a job, as written by send_node_usage().
+ *
+ * @param[in]  stream - descriptor pathway
+ * @param[out] exitval - recommendation to kill the job
+ * @param[out] nr - where to keep the values
+ * @param[in]  replace - drop the resources_used values held in 'nr'
+ *			 before, rather than update them in place
+ *
+ * @return  int
+ * @retval DIS_SUCCESS - success
+ * @retval other - DIS error
+ *
+ */
+static int
+recv_node_usage(int stream, int *exitval, noderes *nr, int replace)
+{
+	int	ret;
+	int	have;
+
+	*exitval = disrsi(stream, &ret);
+	if (ret != DIS_SUCCESS)
+		return ret;
+	nr->nr_cput = disrul(stream, &ret);
+	if (ret != DIS_SUCCESS)
+		return ret;
+	nr->nr_mem = disrul(stream, &ret);
+	if (ret != DIS_SUCCESS)
+		return ret;
+	nr->nr_cpupercent = disrul(stream, &ret);
+	if (ret != DIS_SUCCESS)
+		return ret;
+	have = disrsi(stream, &ret);
+	if (ret != DIS_SUCCESS)
+		return ret;
+	if (have && decode_resc_used(stream, &nr->nr_used, replace) != 0)
+		return DIS_PROTO;
+	return DIS_SUCCESS;
+}
+
+/**
+ * @brief
+ *	General purpose function for executing actions that are done
+ *	before calling finish_exec() on a job.
+ *
+ * @param[in]       pjob		job being operated on
+ * @param[in]       do_job_setup_send	set to 1 if job_setup_send() should be done
+ *
+ * @return enum pre_finish_results_t
+ * @retval PRE_FINISH_SUCCESS			all actions executed successfully
+ * @retval PRE_FINISH_FAIL			at least one of the actions has failed
+ * @retval PRE_FINISH_SUCCESS_JOB_SETUP_SEND	all actions up to job_setup_send()
+ *						succeeded
+ * @retval PRE_FINISH_FAIL_JOB_SETUP_SEND	action to do job_setup_send() failed
+ * @retval PRE_FINISH_FAIL_JOIN_EXTRA		action to do job_join_extra() failed
+ *
+ */
+pre_finish_results_t
+pre_finish_exec(job *pjob, int do_job_setup_send)
+{
+	if (pjob == NULL)
+		return PRE_FINISH_FAIL;
+
+	/*
+	 * If job_join_read exists, call it to read
+	 * any extra info included with the JOIN reply.
+	 * This function can return an error if there
+	 * is no extra information or deal with it
+	 * more gracefully and return SUCCESS.
+	 */
+	if (job_join_extra != NULL) {
+		if (job_join_extra(pjob, &pjob->ji_hosts[0]) != 0)
+			return PRE_FINISH_FAIL_JOIN_EXTRA;
+	}
+
+	/*
+	 * If there is a job_setup_send function,
+	 * send a SETUP_JOB message to each node.
+	 * The call to finish_exec will happen
+	 * when we get a reply from all the nodes.
+	 */
+	if (do_job_setup_send && (job_setup_send != NULL)) {
+		if (send_sisters(pjob, IM_SETUP_JOB, job_setup_send) != pjob->ji_numnodes-1)
+			return PRE_FINISH_FAIL_JOB_SETUP_SEND;
+		return PRE_FINISH_SUCCESS_JOB_SETUP_SEND;
+	}
+	return PRE_FINISH_SUCCESS;
+}
+
+/*
+ * Sister fan-out tree.
+ *
+ * When $sister_fanout is set to k (k >= 2), Mother Superior hands the
+ * job-wide KILL_JOB, POLL_JOB and DELETE_JOB commands to at most k
+ * sisters, each of which relays them to at most k more, instead of
+ * talking to every sister itself.  The tree is laid out over the host
+ * index of the job: the children of host i are hosts k*i+1 through
+ * k*i+k, so every MoM of the job can work out its place in it.
+ *
+ * The replies to KILL_JOB and POLL_JOB are gathered on the way back up.
+ * Each sister sends a single IM_FANOUT_REPLY to its parent holding one
+ * record for every node of its subtree, so Mother Superior only ever
+ * hears from its own k children.  A node that cannot be reached is
+ * reported with PBSE_SISCOMM and, when that is known at send time, its
+ * children are handed the command directly by the sender.
+ */
+
+/* walk the hosts of the subtree rooted at 'root', one level at a time */
+#define FOR_EACH_FANOUT_NODE(n, lo, hi, k, root, numnodes) \
+	for (lo = hi = (root); lo < (numnodes); lo = (k) * lo + 1, hi = (k) * hi + (k)) \
+		for (n = lo; n <= hi && n < (numnodes); n++)
+
+/**
+ * @brief
+ *	Return the number of hosts in the fan-out subtree rooted at 'root'.
+ *
+ * @param[in] numnodes - number of hosts in the job
+ * @param[in] k - arity of the tree
+ * @param[in] root - host index of the subtree root
+ *
+ * @return int
+ *
+ */
+static int
+fanout_subtree_size(int numnodes, int k, int root)
+{
+	int	n, lo, hi;
+	int	num = 0;
+
+	FOR_EACH_FANOUT_NODE(n, lo, hi, k, root, numnodes)
+		num++;
+	return num;
+}
+
+/**
+ * @brief
+ *	Check that a message came in from the mom of a given host of a
+ *	job, either on its stream or on another one from the same address.
+ *	A stream to the host is opened if there is none yet.
+ *
+ * @param[in] stream - stream the message came in on
+ * @param[in] np - host entry the sender claims to be
+ *
+ * @return int
+ * @retval TRUE - stream belongs to the host
+ * @retval FALSE - it does not
+ *
+ */
+static int
+stream_from_host(int stream, hnodent *np)
+{
+	struct sockaddr_in	*addr;
+	struct in_addr		stream_ip;
+
+	if (np->hn_stream == stream) {
+		np->hn_eof_ts = 0;
+		return TRUE;
+	}
+	if ((addr = tpp_getaddr(stream)) == NULL)
+		return FALSE;
+	stream_ip = addr->sin_addr;
+
+	if (np->hn_stream == -1)
+		np->hn_stream = tpp_open(np->hn_host, np->hn_port);
+	if (((addr = tpp_getaddr(np->hn_stream)) == NULL) ||
+		(memcmp(&stream_ip, &addr->sin_addr, sizeof(stream_ip)) != 0))
+		return FALSE;
+	return TRUE;
+}
+
+/**
+ * @brief
+ *	Check that an IM_FANOUT from a sister comes from host 'from' of the
+ *	job and that 'from' is above me in the tree.  Any ancestor will do,
+ *	as a sister hands the command straight to the children of a child
+ *	it cannot reach.  Mother Superior is checked by check_ms().
+ *
+ * @param[in] stream - stream the message came in on
+ * @param[in] pjob - job pointer
+ * @param[in] k - arity of the tree
+ * @param[in] from - host index the sender claims
+ *
+ * @return int
+ * @retval TRUE - not a valid sender
+ * @retval FALSE - okay
+ *
+ */
+static int
+check_fanout_sender(int stream, job *pjob, int k, int from)
+{
+	hnodent			*np;
+	int			p;
+
+	for (p = pjob->ji_nodeid; p > from; p = (p - 1) / k)
+		;
+	if (p != from) {
+		sprintf(log_buffer, "FANOUT from node %d, not above node %d",
+			from, pjob->ji_nodeid);
+		log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+		return TRUE;
+	}
+
+	np = &pjob->ji_hosts[from];
+	if (!stream_from_host(stream, np)) {
+		sprintf(log_buffer, "FANOUT stream %d is not from node %d (%s)",
+			stream, from, np->hn_host);
+		log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * @brief
+ *	Free the fan-out state of a job, if any.
+ *
+ * @param[in] pjob - job pointer
+ *
+ * @return Void
+ *
+ */
+void
+fanout_free(job *pjob)
+{
+	fanout_state	*fo = pjob->ji_fanout;
+	int		i;
+
+	if (fo == NULL)
+		return;
+
+	if (fo->fo_resc != NULL) {
+		for (i = 0; i < pjob->ji_numnodes; i++)
+			job_attr_def[JOB_ATR_resc_used].at_free(&fo->fo_resc[i].nr_used);
+		free(fo->fo_resc);
+	}
+	free(fo->fo_wait);
+	free(fo->fo_status);
+	free(fo->fo_kill);
+	free(fo);
+	pjob->ji_fanout = NULL;
+}
+
+/**
+ * @brief
+ *	Allocate the state a sister keeps while its subtree works on
+ *	a KILL_JOB or POLL_JOB handed down the fan-out tree.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - IM_KILL_JOB or IM_POLL_JOB
+ * @param[in] k - arity of the tree
+ * @param[in] stream - stream to the parent
+ * @param[in] event - event of the parent to reply to
+ *
+ * @return fanout_state *
+ * @retval NULL - out of memory
+ *
+ */
+static fanout_state *
+fanout_alloc(job *pjob, int com, int k, int stream, tm_event_t event)
+{
+	fanout_state	*fo;
+	int		n = pjob->ji_numnodes;
+	int		i;
+
+	if ((fo = (fanout_state *)calloc(1, sizeof(fanout_state))) == NULL)
+		return NULL;
+	pjob->ji_fanout = fo;
+
+	fo->fo_wait = (tm_event_t *)calloc(n, sizeof(tm_event_t));
+	fo->fo_status = (int *)malloc(n * sizeof(int));
+	fo->fo_kill = (int *)calloc(n, sizeof(int));
+	fo->fo_resc = (noderes *)calloc(n, sizeof(noderes));
+	if (fo->fo_wait == NULL || fo->fo_status == NULL ||
+		fo->fo_kill == NULL || fo->fo_resc == NULL) {
+		fanout_free(pjob);
+		return NULL;
+	}
+	for (i = 0; i < n; i++) {
+		fo->fo_status[i] = -1;
+		clear_attr(&fo->fo_resc[i].nr_used, &job_attr_def[JOB_ATR_resc_used]);
+	}
+
+	fo->fo_command = com;
+	fo->fo_arity = k;
+	fo->fo_stream = stream;
+	fo->fo_event = event;
+	fo->fo_local = 1;
+	fo->fo_pending = 1;
+	return fo;
+}
+
+/**
+ * @brief
+ *	Send an IM_FANOUT message carrying command 'com' to host 'idx'.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - command relayed
+ * @param[in] k - arity of the tree
+ * @param[in] idx - host index to send to
+ * @param[in,out] nep - event shared by all the hosts sent to, allocated
+ *			on first use; not used for IM_DELETE_JOB
+ * @param[out] pevent - event the reply will come back on
+ *
+ * @return int
+ * @retval 0 - message sent
+ * @retval -1 - failure
+ *
+ */
+static int
+fanout_send_one(job *pjob, int com, int k, int idx, eventent **nep,
+	tm_event_t *pevent)
+{
+	hnodent		*np = &pjob->ji_hosts[idx];
+	eventent	*ep = NULL;
+	tm_event_t	event = TM_NULL_EVENT;
+	int		ret;
+
+	if (np->hn_stream == -1)
+		np->hn_stream = tpp_open(np->hn_host, np->hn_port);
+	if (np->hn_stream == -1)
+		return -1;
+
+	if (com != IM_DELETE_JOB) {
+		if (*nep == NULL) {
+			ep = event_alloc(pjob, com, -1, np,
+				TM_NULL_EVENT, TM_NULL_TASK);
+			if (ep == NULL)
+				return -1;
+			ep->ee_fanout = k;
+			*nep = ep;
+		} else if ((ep = event_dup(*nep, pjob, np)) == NULL)
+			return -1;
+		event = ep->ee_event;
+	}
+
+	ret = im_compose(np->hn_stream, pjob->ji_qs.ji_jobid,
+		get_jattr_str(pjob, JOB_ATR_Cookie), IM_FANOUT, event,
+		TM_NULL_TASK, IM_OLD_PROTOCOL_VER);
+	if (ret == DIS_SUCCESS)
+		ret = diswsi(np->hn_stream, com);
+	if (ret == DIS_SUCCESS)
+		ret = diswsi(np->hn_stream, k);
+	if (ret == DIS_SUCCESS)
+		ret = diswsi(np->hn_stream, pjob->ji_nodeid);
+	if (ret == DIS_SUCCESS && dis_flush(np->hn_stream) == -1)
+		ret = DIS_EOF;
+	if (ret != DIS_SUCCESS) {
+		if (ep != NULL) {
+			if (ep == *nep)
+				*nep = NULL;
+			delete_link(&ep->ee_next);
+			free(ep);
+		}
+		return -1;
+	}
+	*pevent = event;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Hand command 'com' to host 'idx' for its whole subtree.  If the host
+ *	cannot be reached, hand it to the children of 'idx' instead.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - command relayed
+ * @param[in] k - arity of the tree
+ * @param[in] idx - host index at the root of the subtree
+ * @param[in,out] nep - event shared by all the hosts sent to
+ *
+ * @return int
+ * @retval number of hosts the command is on its way to
+ *
+ * @note
+ *	On Mother Superior, ji_nodekill and hn_sister are handled the same
+ *	way as in send_sisters_inner().  On a sister, the state in
+ *	pjob->ji_fanout, if any, is updated.
+ *
+ */
+static int
+fanout_send_subtree(job *pjob, int com, int k, int idx, eventent **nep)
+{
+	hnodent		*np = &pjob->ji_hosts[idx];
+	fanout_state	*fo = pjob->ji_fanout;
+	int		ms = pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE;
+	tm_event_t	event;
+	int		i;
+	int		num = 0;
+
+	if (idx >= pjob->ji_numnodes)
+		return 0;
+
+	if (ms && pjob->ji_nodekill == TM_ERROR_NODE)
+		pjob->ji_nodekill = np->hn_node;
+
+	if (np->hn_sister == SISTER_OKAY) {
+		if (fanout_send_one(pjob, com, k, idx, nep, &event) == 0) {
+			if (ms) {
+				if (pjob->ji_nodekill == np->hn_node)
+					pjob->ji_nodekill = TM_ERROR_NODE;
+			} else if (fo != NULL) {
+				fo->fo_wait[idx] = event;
+				fo->fo_pending++;
+			}
+			return fanout_subtree_size(pjob->ji_numnodes, k, idx);
+		}
+		if (ms)
+			np->hn_sister = SISTER_EOF;
+	}
+
+	if (!ms && fo != NULL)
+		fo->fo_status[idx] = PBSE_SISCOMM;
+
+	snprintf(log_buffer, sizeof(log_buffer),
+		"cannot relay request %d through %s, sending to its children",
+		com, np->hn_host ? np->hn_host : "UNDEFINED");
+	log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG,
+		pjob->ji_qs.ji_jobid, log_buffer);
+
+	for (i = k * idx + 1; i <= k * idx + k && i < pjob->ji_numnodes; i++)
+		num += fanout_send_subtree(pjob, com, k, i, nep);
+	return num;
+}
+
+/**
+ * @brief
+ *	Hand command 'com' down the fan-out tree to the children of
+ *	this host.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - command relayed
+ * @param[in] k - arity of the tree
+ *
+ * @return int
+ * @retval number of hosts the command is on its way to
+ *
+ */
+static int
+fanout_send_children(job *pjob, int com, int k)
+{
+	eventent	*nep = NULL;
+	int		me = pjob->ji_nodeid;
+	int		i;
+	int		num = 0;
+
+	for (i = k * me + 1; i <= k * me + k && i < pjob->ji_numnodes; i++)
+		num += fanout_send_subtree(pjob, com, k, i, &nep);
+	return num;
+}
+
+/**
+ * @brief
+ *	Send the IM_FANOUT_REPLY for the subtree of this sister to the
+ *	parent and drop the fan-out state.  Nodes that have not reported
+ *	are sent as PBSE_SISCOMM.
+ *
+ * @param[in] pjob - job pointer
+ *
+ * @return Void
+ *
+ */
+static void
+fanout_reply(job *pjob)
+{
+	fanout_state	*fo = pjob->ji_fanout;
+	int		stream = fo->fo_stream;
+	int		me = pjob->ji_nodeid;
+	int		n, lo, hi;
+	int		status;
+	int		ret;
+
+	ret = im_compose(stream, pjob->ji_qs.ji_jobid,
+		get_jattr_str(pjob, JOB_ATR_Cookie), IM_FANOUT_REPLY,
+		fo->fo_event, TM_NULL_TASK, IM_OLD_PROTOCOL_VER);
+	if (ret == DIS_SUCCESS)
+		ret = diswsi(stream, fanout_subtree_size(pjob->ji_numnodes,
+			fo->fo_arity, me));
+
+	FOR_EACH_FANOUT_NODE(n, lo, hi, fo->fo_arity, me, pjob->ji_numnodes) {
+		if (ret != DIS_SUCCESS)
+			continue;
+		status = fo->fo_status[n];
+		if (status == -1)
+			status = PBSE_SISCOMM;
+		if ((ret = diswsi(stream, n)) != DIS_SUCCESS)
+			continue;
+		if ((ret = diswsi(stream, status)) != DIS_SUCCESS || status != 0)
+			continue;
+
+		if (n == me)
+			ret = send_node_usage(stream,
+				(pjob->ji_qs.ji_svrflags &
+				(JOB_SVFLG_OVERLMT1|JOB_SVFLG_OVERLMT2)) ? 1 : 0,
+				resc_used(pjob, "cput", gettime),
+				resc_used(pjob, "mem", getsize),
+				resc_used(pjob, "cpupercent", gettime),
+				get_jattr(pjob, JOB_ATR_resc_used), 1);
+		else
+			ret = send_node_usage(stream, fo->fo_kill[n],
+				fo->fo_resc[n].nr_cput, fo->fo_resc[n].nr_mem,
+				fo->fo_resc[n].nr_cpupercent,
+				&fo->fo_resc[n].nr_used, 0);
+	}
+
+	if (ret != DIS_SUCCESS || dis_flush(stream) == -1) {
+		sprintf(log_buffer, "failed to send FANOUT_REPLY for request %d",
+			fo->fo_command);
+		log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+	}
+	fanout_free(pjob);
+}
+
+/**
+ * @brief
+ *	Record that this sister's own part of a fanned out command is done.
+ *	The reply goes up to the parent once the subtree has reported too.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] status - PBSE_NONE or the error to report for this host
+ *
+ * @return Void
+ *
+ */
+void
+fanout_local_done(job *pjob, int status)
+{
+	fanout_state	*fo = pjob->ji_fanout;
+
+	if (fo == NULL || fo->fo_local == 0)
+		return;
+
+	fo->fo_local = 0;
+	fo->fo_status[pjob->ji_nodeid] = status;
+	if (--fo->fo_pending == 0)
+		fanout_reply(pjob);
+}
+
+/**
+ * @brief
+ *	If all the sisters have reported on a KILL_JOB, move the job
+ *	on to EXITING.  I'm mother superior.
+ *
+ * @param[in] pjob - job pointer
+ *
+ * @return Void
+ *
+ */
+static void
+fanout_kill_check(job *pjob)
+{
+	int	i;
+
+	for (i = 1; i < pjob->ji_numnodes; i++) {
+		if (pjob->ji_hosts[i].hn_sister == SISTER_OKAY)
+			return;
+	}
+	if (check_job_substate(pjob, JOB_SUBSTATE_KILLSIS)) {
+		set_job_state(pjob, JOB_STATE_LTR_EXITING);
+		set_job_substate(pjob, JOB_SUBSTATE_EXITING);
+		exiting_tasks = 1;
+	}
+}
+
+/**
+ * @brief
+ *	Apply one node's result for a fanned out command the way a
+ *	direct reply from that node would have been.  I'm mother superior.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - IM_KILL_JOB or IM_POLL_JOB
+ * @param[in] n - host index of the node
+ * @param[in] status - PBSE_NONE or the error reported for the node
+ * @param[in] exitval - POLL_JOB recommendation to kill the job
+ *
+ * @return Void
+ *
+ */
+static void
+fanout_apply(job *pjob, int com, int n, int status, int exitval)
+{
+	hnodent		*np = &pjob->ji_hosts[n];
+
+	if (com == IM_KILL_JOB) {
+		np->hn_sister = status ? status : SISTER_KILLDONE;
+		return;
+	}
+
+	if (status == PBSE_NONE) {
+		np->hn_eof_ts = 0;
+		if (exitval)
+			pjob->ji_nodekill = np->hn_node;
+		return;
+	}
+
+	if (do_tolerate_node_failures(pjob))
+		return;
+
+	if (status == PBSE_SISCOMM) {
+		/* not heard from through the tree, same grace as a lost stream */
+		if (np->hn_eof_ts == 0)
+			np->hn_eof_ts = time_now;
+		if ((time_now - np->hn_eof_ts) <= max_poll_downtime_val)
+			return;
+	}
+	sprintf(log_buffer, "POLL_JOB failed on node %d with ERROR %d",
+		np->hn_node, status);
+	log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+	pjob->ji_nodekill = np->hn_node;
+}
+
+/**
+ * @brief
+ *	The sister at host 'idx' will not report for the subtree it
+ *	was handed.  Report 'errcode' for it and PBSE_SISCOMM for the
+ *	rest of the subtree, unless 'adopt' is set in which case the
+ *	children of 'idx' are handed the command directly.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - IM_KILL_JOB or IM_POLL_JOB
+ * @param[in] k - arity of the tree the command was sent with
+ * @param[in] idx - host index of the sister
+ * @param[in] event - event the command was sent with
+ * @param[in] errcode - error to report for 'idx'
+ * @param[in] adopt - set if 'idx' is known not to have relayed the command
+ *
+ * @return Void
+ *
+ */
+static void
+fanout_subtree_failed(job *pjob, int com, int k, int idx, tm_event_t event,
+	int errcode, int adopt)
+{
+	fanout_state	*fo = pjob->ji_fanout;
+	int		ms = pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE;
+	eventent	*nep = NULL;
+	int		n, lo, hi;
+
+	if (!ms && (fo == NULL || fo->fo_command != com ||
+		fo->fo_wait[idx] != event))
+		return;		/* stale */
+
+	sprintf(log_buffer, "request %d relayed through %s failed with ERROR %d",
+		com, pjob->ji_hosts[idx].hn_host, errcode);
+	log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+
+	if (adopt) {
+		if (ms)
+			fanout_apply(pjob, com, idx, errcode, 0);
+		else
+			fo->fo_status[idx] = errcode;
+		for (n = k * idx + 1; n <= k * idx + k && n < pjob->ji_numnodes; n++)
+			(void)fanout_send_subtree(pjob, com, k, n, &nep);
+	} else {
+		FOR_EACH_FANOUT_NODE(n, lo, hi, k, idx, pjob->ji_numnodes) {
+			if (ms)
+				fanout_apply(pjob, com, n,
+					(n == idx) ? errcode : PBSE_SISCOMM, 0);
+			else
+				fo->fo_status[n] = (n == idx) ? errcode : PBSE_SISCOMM;
+		}
+	}
+
+	if (ms) {
+		if (com == IM_KILL_JOB)
+			fanout_kill_check(pjob);
+		return;
+	}
+	fo->fo_wait[idx] = TM_NULL_EVENT;
+	if (--fo->fo_pending == 0)
+		fanout_reply(pjob);
+}
+
+/**
+ * @brief
+ *	Read an IM_FANOUT_REPLY from the sister at host 'idx'.
+ *	Mother Superior applies each record, a sister keeps them for
+ *	its own reply.
+ *
+ * @param[in] stream - stream the reply came in on
+ * @param[in] pjob - job pointer
+ * @param[in] com - command the reply is for
+ * @param[in] idx - host index of the sister
+ * @param[in] event - event of the reply
+ *
+ * @return int
+ * @retval DIS_SUCCESS - success
+ * @retval other - DIS error
+ *
+ */
+static int
+fanout_recv_reply(int stream, job *pjob, int com, int idx, tm_event_t event)
+{
+	fanout_state	*fo = pjob->ji_fanout;
+	int		ms = pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE;
+	noderes		scratch;
+	noderes		*nr;
+	int		count, i, n;
+	int		status, exitval;
+	int		ret = DIS_SUCCESS;
+
+	if (!ms && (fo == NULL || fo->fo_command != com ||
+		fo->fo_wait[idx] != event))
+		fo = NULL;	/* stale, read and drop it */
+
+	memset(&scratch, 0, sizeof(scratch));
+	clear_attr(&scratch.nr_used, &job_attr_def[JOB_ATR_resc_used]);
+
+	count = disrsi(stream, &ret);
+	for (i = 0; ret == DIS_SUCCESS && i < count; i++) {
+		n = disrsi(stream, &ret);
+		if (ret != DIS_SUCCESS)
+			break;
+		status = disrsi(stream, &ret);
+		if (ret != DIS_SUCCESS)
+			break;
+		if (n <= 0 || n >= pjob->ji_numnodes) {
+			ret = DIS_PROTO;
+			break;
+		}
+
+		exitval = 0;
+		if (status == PBSE_NONE) {
+			if (ms && (n - 1) < pjob->ji_numrescs)
+				nr = &pjob->ji_resources[n - 1];
+			else if (!ms && fo != NULL)
+				nr = &fo->fo_resc[n];
+			else
+				nr = &scratch;
+			if ((ret = recv_node_usage(stream, &exitval, nr, 1)) !=
+				DIS_SUCCESS)
+				break;
+		}
+
+		if (ms)
+			fanout_apply(pjob, com, n, status, exitval);
+		else if (fo != NULL) {
+			fo->fo_status[n] = status;
+			fo->fo_kill[n] = exitval;
+		}
+	}
+	job_attr_def[JOB_ATR_resc_used].at_free(&scratch.nr_used);
+	if (ret != DIS_SUCCESS)
+		return ret;
+
+	if (ms) {
+		if (com == IM_KILL_JOB)
+			fanout_kill_check(pjob);
+	} else if (fo != NULL) {
+		fo->fo_wait[idx] = TM_NULL_EVENT;
+		if (--fo->fo_pending == 0)
+			fanout_reply(pjob);
+	}
+	return DIS_SUCCESS;
+}
+
+/**
+ * @brief
+ *	Send a job-wide command down the sister fan-out tree.
+ *	I'm mother superior.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] com - IM_KILL_JOB, IM_POLL_JOB or IM_DELETE_JOB
+ *
+ * @return int
+ * @retval number of sisters the command is on its way to
+ *
+ */
+static int
+send_sisters_tree(job *pjob, int com)
+{
+	DBPRT(("%s: command %d fanout %d\n", __func__, com, sister_fanout))
+	return fanout_send_children(pjob, com, sister_fanout);
+}
+
+/**
+ * @brief
+ *	qsort() comparison of two jobs by the stream to their mother superior.
+ */
+static int
+cmp_ms_stream(const void *a, const void *b)
+{
+	int	sa = (*(job **)a)->ji_hosts[0].hn_stream;
+	int	sb = (*(job **)b)->ji_hosts[0].hn_stream;
+
+	return ((sa > sb) - (sa < sb));
+}
+
+/**
+ * @brief
+ *	Send what every job I'm a sister for has used to its mother
+ *	superior.  All the jobs of a mother superior go in a single
+ *	IM_POLL_BATCH message.  Used instead of answering IM_POLL_JOB
+ *	for each job when $sister_poll_batch is set.
+ *
+ *	request (
+ *		jobid	string;		empty
+ *		cookie	string;		empty
+ *		command	int;		IM_POLL_BATCH
+ *		event	int;
+ *		task	int;
+ *		count	int;
+ *		count times (
+ *			jobid		string;
+ *			cookie		string;
+ *			node index	int;
+ *			node usage	see send_node_usage();
+ *		)
+ *	)
+ *
+ * @return Void
+ *
+ */
+void
+send_resc_used_batch(void)
+{
+	job	*pjob;
+	job	**jobs;
+	int	njobs = 0;
+	int	i, j, k;
+	int	stream;
+	int	ret;
+
+	for (pjob = (job *)GET_NEXT(svr_alljobs); pjob != NULL;
+		pjob = (job *)GET_NEXT(pjob->ji_alljobs))
+		njobs++;
+	if (njobs == 0)
+		return;
+
+	jobs = (job **)malloc(njobs * sizeof(job *));
+	if (jobs == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		return;
+	}
+
+	njobs = 0;
+	for (pjob = (job *)GET_NEXT(svr_alljobs); pjob != NULL;
+		pjob = (job *)GET_NEXT(pjob->ji_alljobs)) {
+		if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) ||
+			(pjob->ji_hosts == NULL) ||
+			(pjob->ji_nodeid <= 0) ||
+			(pjob->ji_hosts[0].hn_stream == -1) ||
+			!is_jattr_set(pjob, JOB_ATR_Cookie))
+			continue;
+		if (!check_job_substate(pjob, JOB_SUBSTATE_RUNNING) &&
+			!check_job_substate(pjob, JOB_SUBSTATE_PRERUN))
+			continue;
+		jobs[njobs++] = pjob;
+	}
+	qsort(jobs, njobs, sizeof(job *), cmp_ms_stream);
+
+	for (i = 0; i < njobs; i = j) {
+		stream = jobs[i]->ji_hosts[0].hn_stream;
+		for (j = i; j < njobs && jobs[j]->ji_hosts[0].hn_stream == stream; j++)
+			;
+
+		ret = im_compose(stream, "", "", IM_POLL_BATCH, TM_NULL_EVENT,
+			TM_NULL_TASK, IM_OLD_PROTOCOL_VER);
+		if (ret == DIS_SUCCESS)
+			ret = diswsi(stream, j - i);
+		for (k = i; ret == DIS_SUCCESS && k < j; k++) {
+			pjob = jobs[k];
+			ret = diswst(stream, pjob->ji_qs.ji_jobid);
+			if (ret == DIS_SUCCESS)
+				ret = diswst(stream, get_jattr_str(pjob, JOB_ATR_Cookie));
+			if (ret == DIS_SUCCESS)
+				ret = diswsi(stream, pjob->ji_nodeid);
+			if (ret == DIS_SUCCESS)
+				ret = send_node_usage(stream,
+					(pjob->ji_qs.ji_svrflags &
+					(JOB_SVFLG_OVERLMT1|JOB_SVFLG_OVERLMT2)) ? 1 : 0,
+					resc_used(pjob, "cput", gettime),
+					resc_used(pjob, "mem", getsize),
+					resc_used(pjob, "cpupercent", gettime),
+					get_jattr(pjob, JOB_ATR_resc_used), 1);
+		}
+		if (ret != DIS_SUCCESS || dis_flush(stream) == -1) {
+			sprintf(log_buffer,
+				"failed to send POLL_BATCH for %d jobs on stream %d",
+				j - i, stream);
+			log_err(errno, __func__, log_buffer);
+		}
+	}
+	free(jobs);
+}
+
+/**
+ * @brief
+ *	Read an IM_POLL_BATCH message from a sister and update the
+ *	resources used by each of its jobs in place.  Records for jobs
+ *	I'm not mother superior for are read and dropped.
+ *
+ * @param[in] stream - stream the message came in on
+ *
+ * @return int
+ * @retval DIS_SUCCESS - success
+ * @retval other - DIS error
  *
  */
-int
-send_resc_used_to_ms(int stream, job *pjob)
+static int
+recv_resc_used_batch(int stream)
 {
-	extern int resc_access_perm;
-	attribute *at;
-	attribute_def *ad;
-	svrattrl *pal;
-	svrattrl *nxpal;
-	pbs_list_head lhead;
-	pbs_list_head send_head;
-	svrattrl *psatl;
-	int ret;
-
-	if (pjob == NULL || stream == -1)
-		return (-1);
-
-	at = get_jattr(pjob, JOB_ATR_resc_used);
-	if (at->at_type != ATR_TYPE_RESC)
-		return (-1);
-	ad = &job_attr_def[(int) JOB_ATR_resc_used];
-	resc_access_perm = ATR_DFLAG_MGRD;
-
-	memset(&lhead, 0, sizeof(lhead));
-	CLEAR_HEAD(lhead);
+	job		*pjob;
+	noderes		scratch;
+	noderes		*nr;
+	char		*jobid;
+	char		*cookie;
+	int		count, i, n;
+	int		exitval;
+	int		ret = DIS_SUCCESS;
 
-	(void) ad->at_encode(at, &lhead, ad->at_name, NULL, ATR_ENCODE_CLIENT, NULL);
-	memset(&send_head, 0, sizeof(send_head));
-	CLEAR_HEAD(send_head);
+	memset(&scratch, 0, sizeof(scratch));
+	clear_attr(&scratch.nr_used, &job_attr_def[JOB_ATR_resc_used]);
 
-	pal = (svrattrl *) GET_NEXT(lhead);
-	while (pal != NULL) {
-		nxpal = (struct svrattrl *) GET_NEXT(pal->al_link);
+	count = disrsi(stream, &ret);
+	for (i = 0; ret == DIS_SUCCESS && i < count; i++) {
+		jobid = disrst(stream, &ret);
+		if (ret != DIS_SUCCESS)
+			break;
+		cookie = disrst(stream, &ret);
+		if (ret != DIS_SUCCESS) {
+			free(jobid);
+			break;
+		}
+		n = disrsi(stream, &ret);
+		if (ret != DIS_SUCCESS) {
+			free(jobid);
+			free(cookie);
+			break;
+		}
 
-		/* no need to track the resources automatically sent to MS */
-		/* like 'cput', 'mem', and 'cpupercent',but only those */
-		/* resources that are set in a mom hook */
-		if ((pal->al_flags & ATR_VFLAG_HOOK) != 0 &&
-		    strcmp(pal->al_resc, "cput") != 0 &&
-		    strcmp(pal->al_resc, "mem") != 0 &&
-		    strcmp(pal->al_resc, "cpupercent") != 0) {
-			if (add_to_svrattrl_list(&send_head, pal->al_name, pal->al_resc,
-						 pal->al_value, pal->al_op, NULL) == -1) {
-				free_attrlist(&send_head);
-				free_attrlist(&lhead);
-				return (-1);
-			}
+		pjob = find_job(jobid);
+		if ((pjob != NULL) &&
+			(pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) &&
+			is_jattr_set(pjob, JOB_ATR_Cookie) &&
+			(strcmp(get_jattr_str(pjob, JOB_ATR_Cookie), cookie) == 0) &&
+			(n > 0) && (n < pjob->ji_numnodes) &&
+			((n - 1) < pjob->ji_numrescs) &&
+			stream_from_host(stream, &pjob->ji_hosts[n]))
+			nr = &pjob->ji_resources[n - 1];
+		else {
+			DBPRT(("%s: dropping report for %s node %d\n",
+				__func__, jobid, n))
+			pjob = NULL;
+			nr = &scratch;
 		}
-		pal = nxpal;
-	}
-	free_attrlist(&lhead);
+		free(jobid);
+		free(cookie);
 
-	psatl = (svrattrl *) GET_NEXT(send_head);
-	if (psatl == NULL) {
-		free_attrlist(&send_head);
-		return (-1);
-	}
+		ret = recv_node_usage(stream, &exitval, nr, pjob == NULL);
+		if (ret != DIS_SUCCESS || pjob == NULL)
+			continue;
 
-	ret = encode_DIS_svrattrl(stream, psatl);
-	free_attrlist(&send_head);
-	if (ret != DIS_SUCCESS)
-		return (-1);
-	return (0);
+		nr->nr_polltime = time_now;
+		if (exitval)
+			pjob->ji_nodekill = pjob->ji_hosts[n].hn_node;
+	}
+	job_attr_def[JOB_ATR_resc_used].at_free(&scratch.nr_used);
+	return ret;
 }
 
 /**
  * @brief
- *	Received resources_used values for job 'jobid'
- *	from descriptor 'stream', with values to be saved in
- *	internal nodes resources table indexed by 'nodeidx'.
+ *	Make sure every sister of a job has sent in a recent
+ *	IM_POLL_BATCH report.  A sister that has been quiet for
+ *	longer than $max_check_poll may not batch its reports, so the
+ *	caller should poll the job with IM_POLL_JOB instead; a reply to
+ *	that counts as a report too.  A sister that has been quiet for
+ *	longer than $max_poll_downtime gets the job killed, the same
+ *	as a failed IM_POLL_JOB would.  I'm mother superior.
  *
- * @param[in] stream - descriptor pathway
- * @param[in] pjob - pointer to owning job structure
- * @param[in] nodeidx - node index to the job's internal resources table
- *			where received values will be saved.
- *			resources values received from
+ * @param[in] pjob - job pointer
  *
- * @return  error code
- * @retval -1     error
- * @retval  0     Success
+ * @return int
+ * @retval 0 - all sisters reported, or the job is being killed
+ * @retval >0 - number of sisters overdue, poll the job with IM_POLL_JOB
  *
  */
 int
-recv_resc_used_from_sister(int stream, job *pjob, int nodeidx)
+check_resc_used_batch(job *pjob)
 {
-	extern int resc_access_perm;
-	attribute_def *pdef;
-	pbs_list_head lhead;
-	svrattrl *psatl;
-	int errcode;
-
-	if (pjob == NULL || stream == -1 || nodeidx < 0)
-		return (-1);
-
-	pdef = &job_attr_def[(int) JOB_ATR_resc_used];
-
-	CLEAR_HEAD(lhead);
-	if (decode_DIS_svrattrl(stream, &lhead) != DIS_SUCCESS) {
-		sprintf(log_buffer, "decode_DIS_svrattrl failed");
-		return (-1);
-	}
-	if (is_attr_set(&pjob->ji_resources[nodeidx].nr_used) != 0)
-		pdef->at_free(&pjob->ji_resources[nodeidx].nr_used);
-	/* decode attributes from request into job structure */
-	clear_attr(&pjob->ji_resources[nodeidx].nr_used, &job_attr_def[JOB_ATR_resc_used]);
+	hnodent	*np;
+	noderes	*nr;
+	int	i;
+	int	overdue = 0;
 
-	resc_access_perm = READ_WRITE;
-	psatl = (svrattrl *) GET_NEXT(lhead);
-	for (; psatl; psatl = (svrattrl *) GET_NEXT(psatl->al_link)) {
+	for (i = 1; i < pjob->ji_numnodes && (i - 1) < pjob->ji_numrescs; i++) {
+		np = &pjob->ji_hosts[i];
+		nr = &pjob->ji_resources[i - 1];
 
-		if ((psatl->al_name == NULL) || (psatl->al_resc == NULL)) {
-			free_attrlist(&lhead);
-			return (-1);
+		if (nr->nr_polltime == 0) {	/* start the clock */
+			nr->nr_polltime = time_now;
+			continue;
 		}
-
-		if (strcmp(psatl->al_name, ATTR_used) != 0) {
-			free_attrlist(&lhead);
-			return (-1);
+		if ((time_now - nr->nr_polltime) <= max_check_poll)
+			continue;
+		if ((time_now - nr->nr_polltime) <= max_poll_downtime_val) {
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG,
+				pjob->ji_qs.ji_jobid,
+				"no POLL_BATCH from %s, polling job", np->hn_host);
+			overdue++;
+			continue;
 		}
-
-		errcode = set_attr_generic(&pjob->ji_resources[nodeidx].nr_used, pdef, psatl->al_value, psatl->al_resc, INTERNAL);
-		/* Unknown resources still get decoded */
-		/* under "unknown" resource def */
-		if ((errcode != 0) && (errcode != PBSE_UNKRESC)) {
-			free_attrlist(&lhead);
-			return (-1);
+		if (reliable_job_node_find(&pjob->ji_failed_node_list, np->hn_host) != NULL)
+			continue;
+		if (do_tolerate_node_failures(pjob)) {
+			snprintf(log_buffer, sizeof(log_buffer),
+				"ignoring missing POLL_BATCH from %s as job is tolerant of node failures",
+				np->hn_host);
+			log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_JOB, LOG_DEBUG,
+				pjob->ji_qs.ji_jobid, log_buffer);
+			continue;
+		}
+		if (!is_comm_up(COMM_MATURITY_TIME)) {
+			sprintf(log_buffer, "no POLL_BATCH from %s due to pbs_comm down/recently established, not killing job",
+				np->hn_host);
+			log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+			continue;
 		}
 
-		if (psatl->al_op == DFLT)
-			pjob->ji_resources[nodeidx].nr_used.at_flags |= ATR_VFLAG_DEFLT;
+		sprintf(log_buffer, "no POLL_BATCH from %s for > %d secs, killing job now",
+			np->hn_host, max_poll_downtime_val);
+		log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+		pjob->ji_nodekill = np->hn_node;
+		return 0;
 	}
-
-	free_attrlist(&lhead);
-	return (0);
+	return overdue;
 }
 
 /**
  * @brief
- *	General purpose function for executing actions that are done
- *	before calling finish_exec() on a job.
+ *	Start killing a job on this sister at the request of mother
+ *	superior.  The reply is deferred until the tasks of the job
+ *	have been reaped.
  *
- * @param[in]       pjob		job being operated on
- * @param[in]       do_job_setup_send	set to 1 if job_setup_send() should be done
+ * @param[in] pjob - job pointer
+ * @param[in] event - event to answer once the tasks are gone
+ * @param[out] hook_msg - message from a rejecting execjob_preterm hook
+ * @param[in] msg_len - size of 'hook_msg'
+ * @param[out] hook_errcode - error code from a rejecting hook
  *
- * @return enum pre_finish_results_t
- * @retval PRE_FINISH_SUCCESS			all actions executed successfully
- * @retval PRE_FINISH_FAIL			at least one of the actions has failed
- * @retval PRE_FINISH_SUCCESS_JOB_SETUP_SEND	all actions up to job_setup_send()
- *						succeeded
- * @retval PRE_FINISH_FAIL_JOB_SETUP_SEND	action to do job_setup_send() failed
- * @retval PRE_FINISH_FAIL_JOIN_EXTRA		action to do job_join_extra() failed
+ * @return int
+ * @retval 0 - kill started
+ * @retval -1 - rejected by an execjob_preterm hook
  *
  */
-pre_finish_results_t
-pre_finish_exec(job *pjob, int do_job_setup_send)
+static int
+im_kill_job(job *pjob, tm_event_t event, char *hook_msg, size_t msg_len,
+	int *hook_errcode)
 {
-	if (pjob == NULL)
-		return PRE_FINISH_FAIL;
+	mom_hook_input_t	hook_input;
+	mom_hook_output_t	hook_output;
+	hook			*last_phook = NULL;
+	unsigned int		hook_fail_action = 0;
 
-	/*
-	 * If job_join_read exists, call it to read
-	 * any extra info included with the JOIN reply.
-	 * This function can return an error if there
-	 * is no extra information or deal with it
-	 * more gracefully and return SUCCESS.
-	 */
-	if (job_join_extra != NULL) {
-		if (job_join_extra(pjob, &pjob->ji_hosts[0]) != 0)
-			return PRE_FINISH_FAIL_JOIN_EXTRA;
-	}
+	mom_hook_input_init(&hook_input);
+	hook_input.pjob = pjob;
 
+	mom_hook_output_init(&hook_output);
+	hook_output.reject_errcode = hook_errcode;
+	hook_output.last_phook = &last_phook;
+	hook_output.fail_action = &hook_fail_action;
+	if (mom_process_hooks(HOOK_EVENT_EXECJOB_PRETERM,
+		PBS_MOM_SERVICE_NAME, mom_host, &hook_input,
+		&hook_output, hook_msg, msg_len, 1) == 0)
+		return -1;	/* explicit reject - don't cancel */
+
+	log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_DEBUG,
+		pjob->ji_qs.ji_jobid, "KILL_JOB received");
 	/*
-	 * If there is a job_setup_send function,
-	 * send a SETUP_JOB message to each node.
-	 * The call to finish_exec will happen
-	 * when we get a reply from all the nodes.
+	 ** Send the jobs a signal but we have to wait to
+	 ** do a reply to mother superior until the procs
+	 ** die and are reaped.
 	 */
-	if (do_job_setup_send && (job_setup_send != NULL)) {
-		if (send_sisters(pjob, IM_SETUP_JOB, job_setup_send) != pjob->ji_numnodes-1)
-			return PRE_FINISH_FAIL_JOB_SETUP_SEND;
-		return PRE_FINISH_SUCCESS_JOB_SETUP_SEND;
-	}
-	return PRE_FINISH_SUCCESS;
+	DBPRT(("%s: KILL_JOB %s\n", __func__, pjob->ji_qs.ji_jobid))
+	kill_job(pjob, SIGKILL);
+	set_job_substate(pjob, JOB_SUBSTATE_EXITING);
+	set_job_state(pjob, JOB_STATE_LTR_EXITING);
+	pjob->ji_obit = event;
+	exiting_tasks = 1;
+
+	mom_hook_input_init(&hook_input);
+	hook_input.pjob = pjob;
+
+	mom_hook_output_init(&hook_output);
+	hook_output.reject_errcode = hook_errcode;
+	hook_output.last_phook = &last_phook;
+	hook_output.fail_action = &hook_fail_action;
+
+	(void)mom_process_hooks(HOOK_EVENT_EXECJOB_EPILOGUE,
+		PBS_MOM_SERVICE_NAME, mom_host, &hook_input,
+		&hook_output, hook_msg, msg_len, 1);
+	return 0;
 }
 
 /**
@@ -2974,6 +4156,8 @@ im_request(int stream, int version)
 	char			*nodehost = NULL;
 	char			timebuf[TIMEBUF_SIZE] = {0};
   	char			*delete_job_msg = NULL;
+	int			event_fanout = 0;
+	int			fanned = 0;
 
 	DBPRT(("%s: stream %d version %d\n", __func__, stream, version))
 	if ((version != IM_PROTOCOL_VER) && (version != IM_OLD_PROTOCOL_VER)) {
@@ -3452,9 +4636,21 @@ join_err:
 			mom_deljob(pjob);
 			goto fini;
 
+		case IM_POLL_BATCH:
+			/*
+			 ** Sender is a sister sending what all of its jobs
+			 ** I'm mother superior for have used.  There is no
+			 ** job id, see send_resc_used_batch().
+			 */
+			reply = 0;
+			ret = recv_resc_used_batch(stream);
+			BAIL("POLL_BATCH")
+			goto done;
+
 		case IM_ALL_OKAY:
 		case IM_ERROR:
 		case IM_ERROR2:
+		case IM_FANOUT_REPLY:
 			reply = 0;
 			break;
 
@@ -3537,12 +4733,102 @@ join_err:
 		event_com = ep->ee_command;
 		event_task = ep->ee_taskid;
 		event_client = ep->ee_client;
+		event_fanout = ep->ee_fanout;
 		argv = ep->ee_argv;
 		envp = ep->ee_envp;
 		delete_link(&ep->ee_next);
 		free(ep);
 	}
 
+	if (command == IM_FANOUT) {
+		int	fo_com, fo_k, fo_from;
+
+		/*
+		 ** Sender is mom superior, or a sister above me in the
+		 ** fan-out tree, handing me a job-wide command to carry out
+		 ** and pass on to my own children.
+		 **
+		 ** auxiliary info (
+		 **	command		int;
+		 **	fanout		int;
+		 **	sender		int;
+		 ** )
+		 */
+		fo_com = disrsi(stream, &ret);
+		BAIL("FANOUT command")
+		fo_k = disrsi(stream, &ret);
+		BAIL("FANOUT fanout")
+		fo_from = disrsi(stream, &ret);
+		BAIL("FANOUT sender")
+
+		if ((fo_k < 2) || (fo_k >= pjob->ji_numnodes) ||
+			(pjob->ji_nodeid <= 0) ||
+			(pjob->ji_nodeid >= pjob->ji_numnodes) ||
+			(fo_from < 0) || (fo_from >= pjob->ji_nodeid)) {
+			SEND_ERR(PBSE_PROTOCOL)
+			goto done;
+		}
+		if (fo_from == 0) {
+			if (check_ms(stream, pjob))
+				goto fini;
+		} else if (pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) {
+			log_joberr(-1, __func__, "FANOUT to Mother Superior",
+				jobid);
+			SEND_ERR(PBSE_PROTOCOL)
+			goto done;
+		} else if (check_fanout_sender(stream, pjob, fo_k, fo_from)) {
+			SEND_ERR(PBSE_PERM)
+			goto done;
+		}
+
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, jobid,
+			"FANOUT of command %d received from node %d", fo_com, fo_from);
+
+		/* a new command supersedes whatever was still going */
+		if (pjob->ji_fanout != NULL)
+			fanout_reply(pjob);
+
+		switch (fo_com) {
+
+			case	IM_DELETE_JOB:
+				(void)fanout_send_children(pjob, fo_com, fo_k);
+				command = IM_DELETE_JOB;
+				fanned = 1;
+				break;
+
+			case	IM_POLL_JOB:
+			case	IM_KILL_JOB:
+				if (fanout_alloc(pjob, fo_com, fo_k, stream,
+					event) == NULL) {
+					log_err(errno, __func__, MALLOC_ERR_MSG);
+					SEND_ERR(PBSE_SYSTEM)
+					goto done;
+				}
+				(void)fanout_send_children(pjob, fo_com, fo_k);
+				if (fo_com == IM_POLL_JOB) {
+					DBPRT(("%s: FANOUT POLL_JOB %s\n", __func__, jobid))
+					pjob->ji_polltime = time_now;
+					fanout_local_done(pjob, PBSE_NONE);
+				} else if (im_kill_job(pjob, event, hook_msg,
+					sizeof(hook_msg), &hook_errcode) != 0) {
+					log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB,
+						LOG_INFO, jobid, hook_msg);
+					/* a reject may leave hook_errcode at 0 */
+					fanout_local_done(pjob, hook_errcode != 0 ?
+						hook_errcode : PBSE_HOOK_REJECT);
+				}
+				/* replies go up the tree when the subtree is done */
+				reply = 0;
+				goto done;
+
+			default:
+				sprintf(log_buffer, "unknown FANOUT command %d", fo_com);
+				log_joberr(-1, __func__, log_buffer, jobid);
+				SEND_ERR(PBSE_UNKREQ)
+				goto done;
+		}
+	}
+
 	switch (command) {
 
 		case	IM_KILL_JOB:
@@ -3560,49 +4846,12 @@ join_err:
 			if (check_ms(stream, pjob))
 				goto fini;
 
-			mom_hook_input_init(&hook_input);
-			hook_input.pjob = pjob;
-
-			mom_hook_output_init(&hook_output);
-			hook_output.reject_errcode = &hook_errcode;
-			hook_output.last_phook = &last_phook;
-			hook_output.fail_action = &hook_fail_action;
-			if (mom_process_hooks(HOOK_EVENT_EXECJOB_PRETERM,
-				PBS_MOM_SERVICE_NAME, mom_host, &hook_input,
-				&hook_output,
-				hook_msg, sizeof(hook_msg), 1) == 0) {
-
+			if (im_kill_job(pjob, event, hook_msg, sizeof(hook_msg),
+				&hook_errcode) != 0) {
 				SEND_ERR2(hook_errcode, (char *)hook_msg);
 				goto done;	/* explicit reject - don't cancel */
 			}
-
-
-			log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_DEBUG,
-				jobid, "KILL_JOB received");
-			/*
-			 ** Send the jobs a signal but we have to wait to
-			 ** do a reply to mother superior until the procs
-			 ** die and are reaped.
-			 */
-			DBPRT(("%s: KILL_JOB %s\n", __func__, jobid))
 			reply = 0;	/* reply will be deferred */
-			kill_job(pjob, SIGKILL);
-			set_job_substate(pjob, JOB_SUBSTATE_EXITING);
-			set_job_state(pjob, JOB_STATE_LTR_EXITING);
-			pjob->ji_obit = event;
-			exiting_tasks = 1;
-
-			mom_hook_input_init(&hook_input);
-			hook_input.pjob = pjob;
-
-			mom_hook_output_init(&hook_output);
-			hook_output.reject_errcode = &hook_errcode;
-			hook_output.last_phook = &last_phook;
-			hook_output.fail_action = &hook_fail_action;
-
-			(void)mom_process_hooks(HOOK_EVENT_EXECJOB_EPILOGUE,
-				PBS_MOM_SERVICE_NAME, mom_host, &hook_input,
-				&hook_output, hook_msg, sizeof(hook_msg), 1);
 			break;
 
 		case	IM_DELETE_JOB:
@@ -3619,7 +4868,8 @@ join_err:
 			 */
 			DBPRT(("%s: %s for %s\n", __func__, command==IM_DELETE_JOB?"DELETE_JOB":"DELETE_JOB_REPLY", pjob->ji_qs.ji_jobid));
 
-			if (check_ms(stream, pjob))
+			/* a fanned out request was checked above */
+			if (!fanned && check_ms(stream, pjob))
 				goto fini;
 
  			if ((command == IM_DELETE_JOB) || (command == IM_DELETE_JOB_REPLY))
@@ -4452,6 +5702,39 @@ join_err:
 				event, fromtask, IM_OLD_PROTOCOL_VER);
 			break;
 
+		case	IM_FANOUT_REPLY:	/* this is a REPLY */
+			/*
+			 ** Sender is a sister I handed a job-wide command to
+			 ** through the fan-out tree, reporting for itself and
+			 ** its whole subtree.
+			 **
+			 ** auxiliary info (
+			 **	count		int;
+			 **	count times (
+			 **		node index	int;
+			 **		error		int;
+			 **		<if error is 0>
+			 **		recommendation	int;
+			 **		cput		u_long;
+			 **		mem		u_long;
+			 **		cpupercent	u_long;
+			 **		have resc	int;
+			 **		resc used	svrattrl; <if have resc>
+			 **	)
+			 ** )
+			 */
+			if ((event_com != IM_KILL_JOB) && (event_com != IM_POLL_JOB)) {
+				sprintf(log_buffer,
+					"FANOUT_REPLY for unexpected request %d",
+					event_com);
+				goto err;
+			}
+			DBPRT(("%s: FANOUT_REPLY %d %s from node %d\n",
+				__func__, event_com, jobid, nodeidx))
+			ret = fanout_recv_reply(stream, pjob, event_com, nodeidx, event);
+			BAIL("FANOUT_REPLY")
+			break;
+
 		case	IM_ALL_OKAY:		/* this is a REPLY */
 			/*
 			 ** Sender is another MOM telling me that a request has
@@ -4865,6 +6148,7 @@ join_err:
 					pjob->ji_resources[nodeidx - 1].nr_cpupercent = disrul(stream, &ret);
 					BAIL("OK-POLL_JOB cpupercent")
 					recv_resc_used_from_sister(stream, pjob, nodeidx - 1);
+					pjob->ji_resources[nodeidx - 1].nr_polltime = time_now;
 					DBPRT(("%s: POLL_JOB %s OKAY kill %d cpu %lu mem %lu\n",
 					       __func__, jobid, exitval,
 					       pjob->ji_resources[nodeidx - 1].nr_cput,
@@ -5008,6 +6292,20 @@ join_err:
 				errmsg = disrst(stream, &ret);
 			}
 
+			if (event_fanout) {
+				/*
+				 ** A sister turned down a command sent down the
+				 ** fan-out tree so it went no further.  Hand it to
+				 ** its children instead.
+				 */
+				if (errmsg != NULL)
+					log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB,
+						LOG_INFO, jobid, errmsg);
+				fanout_subtree_failed(pjob, event_com, event_fanout,
+					nodeidx, event, errcode ? errcode : PBSE_SISCOMM, 1);
+				break;
+			}
+
 			switch (event_com) {
 
 				case	IM_JOIN_JOB:
@@ -5382,6 +6680,7 @@ join_err:
 				}
 				clear_attr(&pjob->ji_resources[resc_idx].nr_used,
 						&job_attr_def[JOB_ATR_resc_used]);
+				pjob->ji_resources[resc_idx].nr_polltime = 0;
 				pjob->ji_numrescs++;
 
 			}
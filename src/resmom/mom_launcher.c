@@ -0,0 +1,932 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file	mom_launcher.c
+ *
+ * @brief
+ *	Pre-forked task launcher for MoM.
+ *
+ * @par
+ *	When $launcher is enabled, MoM forks a helper process once, early
+ *	in startup before TPP, Python and the poll code are set up, while
+ *	it is still small.  finish_exec() and start_process() then send
+ *	the helper a launch request (program, argv, environment, user and
+ *	group, umask, limits, working directory and stdin/stdout/stderr
+ *	descriptors) over a socketpair instead of forking the full MoM
+ *	image.  The helper forks the process, which calls set_job(), sets
+ *	itself up and execs.  The starter return comes back tagged with
+ *	the request, so MoM does not have to wait for it: the job shell
+ *	is recorded when the reply is read in the main loop.  Because the
+ *	processes are children of the helper, the helper reaps them and
+ *	sends their exit status back to MoM, where scan_for_terminated()
+ *	handles them like its own children.
+ *
+ *	If the helper is not running, or cannot be started, the caller
+ *	falls back to forking MoM as before.
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "pbs_ifl.h"
+#include "pbs_error.h"
+#include "list_link.h"
+#include "attribute.h"
+#include "server_limits.h"
+#include "job.h"
+#include "log.h"
+#include "mom_func.h"
+#include "net_connect.h"
+
+/* message types sent from the helper to MoM */
+#define	LAUNCH_REPLY	1	/* answer to a launch request */
+#define	LAUNCH_EXIT	2	/* a launched process was reaped */
+
+struct launch_msg {
+	int			lm_type;	/* LAUNCH_REPLY or LAUNCH_EXIT */
+	long			lm_tag;		/* request a reply answers */
+	pid_t			lm_pid;		/* process id */
+	int			lm_code;	/* wait status for an exit */
+	struct startjob_rtn	lm_sjr;		/* starter return for a reply */
+};
+
+/* launch requests the helper has not answered, or MoM has not handled */
+struct launch_pending {
+	long			lp_tag;
+	char			lp_jobid[PBS_MAXSVRJOBID + 1];
+	tm_task_id		lp_task;
+	launch_done_t		lp_func;	/* NULL for launcher_wait() */
+	int			lp_done;	/* lp_sjr holds the reply */
+	struct startjob_rtn	lp_sjr;
+};
+
+int		launcher = FALSE;	/* $launcher config option */
+static int	launcher_sock = -1;	/* MoM end of the socketpair */
+static pid_t	launcher_pid = -1;
+static long	launcher_tag = 0;
+
+static struct launch_pending	*pending = NULL;
+static int			npending = 0;
+static int			max_pending = 0;
+
+/* exits reported by the helper and not yet seen by scan_for_terminated */
+static struct launch_msg	*reaped = NULL;
+static int			nreaped = 0;
+static int			max_reaped = 0;
+
+extern int	termin_child;
+extern int	lockfds;
+extern char	**environ;
+#if defined(RLIM64_INFINITY)
+extern struct rlimit64	orig_nproc_limit;
+extern struct rlimit64	orig_core_limit;
+#else
+extern struct rlimit	orig_nproc_limit;
+extern struct rlimit	orig_core_limit;
+#endif
+
+/**
+ * @brief
+ *	Read exactly len bytes from the socket, retrying on EINTR.
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	error or end of file
+ *
+ */
+static int
+launcher_readn(int sock, void *buf, size_t len)
+{
+	ssize_t	n;
+	char	*p = buf;
+
+	while (len > 0) {
+		n = read(sock, p, len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Queue a process exit reported by the helper for scan_for_terminated().
+ *
+ * @param[in]	msg - LAUNCH_EXIT message
+ *
+ * @return	Void
+ *
+ */
+static void
+launcher_queue_exit(struct launch_msg *msg)
+{
+	if (nreaped == max_reaped) {
+		void	*hold;
+
+		hold = realloc(reaped, (max_reaped + 16) * sizeof(struct launch_msg));
+		if (hold == NULL) {
+			log_err(errno, __func__, MALLOC_ERR_MSG);
+			return;
+		}
+		reaped = hold;
+		max_reaped += 16;
+	}
+	reaped[nreaped++] = *msg;
+	termin_child = 1;
+}
+
+/**
+ * @brief
+ *	Find the pending entry of a launch request.
+ *
+ * @param[in]	tag - tag of the request
+ *
+ * @return	struct launch_pending *
+ * @retval	the entry
+ * @retval	NULL	not found
+ *
+ */
+static struct launch_pending *
+launcher_find(long tag)
+{
+	int	i;
+
+	for (i = 0; i < npending; i++) {
+		if (pending[i].lp_tag == tag)
+			return &pending[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Hand the replies the helper has sent for asynchronous requests
+ *	to their callers.  If the job or task went away in the meantime,
+ *	the new session is killed.
+ *
+ * @par
+ *	Not done while launcher_wait() is reading, as the callback could
+ *	change the state of jobs under the feet of its caller.
+ *
+ * @return	Void
+ *
+ */
+static void
+launcher_dispatch(void)
+{
+	struct launch_pending	lp;
+	job			*pjob;
+	pbs_task		*ptask = NULL;
+	int			i = 0;
+
+	while (i < npending) {
+		if (!pending[i].lp_done || (pending[i].lp_func == NULL)) {
+			i++;
+			continue;
+		}
+		lp = pending[i];
+		memmove(&pending[i], &pending[i + 1],
+			(--npending - i) * sizeof(struct launch_pending));
+
+		if ((pjob = find_job(lp.lp_jobid)) != NULL)
+			ptask = task_find(pjob, lp.lp_task);
+		if ((pjob == NULL) || (ptask == NULL)) {
+			if ((lp.lp_sjr.sj_code >= 0) && (lp.lp_sjr.sj_session > 0))
+				(void)kill_session(lp.lp_sjr.sj_session, SIGKILL, 0);
+			continue;
+		}
+		lp.lp_func(pjob, ptask, &lp.lp_sjr);
+	}
+}
+
+/**
+ * @brief
+ *	Record the helper's reply to a launch request.
+ *
+ * @param[in]	msg - LAUNCH_REPLY message
+ *
+ * @return	Void
+ *
+ */
+static void
+launcher_reply(struct launch_msg *msg)
+{
+	struct launch_pending	*lp;
+
+	if ((lp = launcher_find(msg->lm_tag)) == NULL) {
+		/* nobody is waiting, do not leave the process running */
+		if ((msg->lm_sjr.sj_code >= 0) && (msg->lm_sjr.sj_session > 0))
+			(void)kill_session(msg->lm_sjr.sj_session, SIGKILL, 0);
+		return;
+	}
+	lp->lp_sjr = msg->lm_sjr;
+	lp->lp_done = 1;
+}
+
+/**
+ * @brief
+ *	Forget about the helper after it has gone away.  Requests it has
+ *	not answered fail with JOB_EXEC_RETRY.
+ *
+ * @return	Void
+ *
+ */
+static void
+launcher_lost(void)
+{
+	int	i;
+
+	if (launcher_sock != -1) {
+		close_conn(launcher_sock);
+		launcher_sock = -1;
+	}
+	if (launcher_pid != -1) {
+		log_event(PBSEVENT_SYSTEM, 0, LOG_WARNING, __func__,
+			"task launcher went away, forking tasks from MoM");
+		launcher_pid = -1;
+	}
+	for (i = 0; i < npending; i++) {
+		if (pending[i].lp_done)
+			continue;
+		memset(&pending[i].lp_sjr, 0, sizeof(pending[i].lp_sjr));
+		pending[i].lp_sjr.sj_code = JOB_EXEC_RETRY;
+		pending[i].lp_sjr.sj_session = -1;
+		pending[i].lp_done = 1;
+	}
+}
+
+/**
+ * @brief
+ *	Read one message from the helper.
+ *
+ * @param[in]	sock - launcher socket
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	the helper went away
+ *
+ */
+static int
+launcher_read_one(int sock)
+{
+	struct launch_msg	msg;
+
+	if (launcher_readn(sock, &msg, sizeof(msg)) == -1) {
+		launcher_lost();
+		return -1;
+	}
+	if (msg.lm_type == LAUNCH_EXIT)
+		launcher_queue_exit(&msg);
+	else if (msg.lm_type == LAUNCH_REPLY)
+		launcher_reply(&msg);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Read messages from the helper.  Called from the MoM main loop
+ *	when the launcher socket is readable.
+ *
+ * @param[in]	sock - launcher socket
+ *
+ * @return	Void
+ *
+ */
+static void
+launcher_read(int sock)
+{
+	(void)launcher_read_one(sock);
+	launcher_dispatch();
+}
+
+/**
+ * @brief
+ *	Return one process exit reported by the helper.  Replies that
+ *	came in ahead of it are handled first, so the exit of a job
+ *	shell is never seen before its session id is recorded.
+ *
+ * @param[out]	statloc - wait status of the process
+ *
+ * @return	pid_t
+ * @retval	pid of the process
+ * @retval	0	nothing left to report
+ *
+ */
+pid_t
+launcher_reaped(int *statloc)
+{
+	pid_t	pid;
+
+	launcher_dispatch();
+	if (nreaped == 0)
+		return 0;
+	pid = reaped[0].lm_pid;
+	*statloc = reaped[0].lm_code;
+	memmove(reaped, reaped + 1, --nreaped * sizeof(struct launch_msg));
+	return pid;
+}
+
+/**
+ * @brief
+ *	Process side of a launch: set up the session and exec the program.
+ *	Runs in a child of the helper.  The starter return is written to
+ *	errpipe just before the exec, or with a JOB_EXEC_* code if the
+ *	setup failed.
+ *
+ * @param[in]	req - launch request
+ * @param[in]	fds - stdin, stdout and stderr passed with the request
+ * @param[in]	errpipe - write end of the status pipe
+ * @param[in]	sigmask - signal mask to restore
+ *
+ * @return	does not return
+ *
+ */
+static void
+launcher_exec(struct launch_req *req, int *fds, int errpipe, sigset_t *sigmask)
+{
+	struct startjob_rtn	sjr;
+	struct sigaction	act;
+	job			*pjob;
+	int			fd;
+	int			j;
+
+	memset(&sjr, 0, sizeof(sjr));
+	sjr.sj_code = JOB_EXEC_FAIL2;
+
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_handler = SIG_DFL;
+	(void)sigaction(SIGCHLD, &act, NULL);
+	(void)sigprocmask(SIG_SETMASK, sigmask, NULL);
+
+	/* set_job() only needs the identity of the job */
+	if ((pjob = calloc(1, sizeof(job))) == NULL)
+		goto fail;
+	snprintf(pjob->ji_qs.ji_jobid, sizeof(pjob->ji_qs.ji_jobid), "%s", req->lr_jobid);
+	pjob->ji_qs.ji_svrflags = req->lr_svrflags;
+	pjob->ji_qs.ji_un.ji_momt.ji_exuid = req->lr_uid;
+	pjob->ji_qs.ji_un.ji_momt.ji_exgid = req->lr_gid;
+	j = set_job(pjob, &sjr);
+	if (j < 0) {
+		sjr.sj_code = (j == -3) ? JOB_EXEC_FAIL2 : JOB_EXEC_RETRY;
+		goto fail;
+	}
+	sjr.sj_code = JOB_EXEC_FAIL2;
+
+	daemon_protect(0, PBS_DAEMON_PROTECT_OFF);
+	mom_unnice();
+	umask(req->lr_umask);
+
+	if (req->lr_shell) {
+#if defined(RLIM64_INFINITY)
+		(void)setrlimit64(RLIMIT_CORE, &orig_core_limit);
+#ifdef	RLIMIT_NPROC
+		(void)setrlimit64(RLIMIT_NPROC, &orig_nproc_limit);
+#endif
+#else
+		(void)setrlimit(RLIMIT_CORE, &orig_core_limit);
+#ifdef	RLIMIT_NPROC
+		(void)setrlimit(RLIMIT_NPROC, &orig_nproc_limit);
+#endif
+#endif
+	}
+	if (mom_apply_limits(&req->lr_limits) != PBSE_NONE)
+		goto fail;
+	if (becomeuser_args(req->lr_euser, req->lr_uid, req->lr_gid, req->lr_rgid) == -1)
+		goto fail;
+	if (chdir(req->lr_cwd) == -1) {
+		(void)fprintf(stderr, "Could not chdir to %s\n", req->lr_cwd);
+		goto fail;
+	}
+
+	/* stdin */
+	if (req->lr_stdin)
+		fd = dup(fds[0]);
+	else
+		fd = open("/dev/null", O_RDONLY);
+	if (fd == -1)
+		(void)close(0);
+	else if (fd != 0) {
+		(void)dup2(fd, 0);
+		(void)close(fd);
+	}
+
+	switch (req->lr_stdio) {
+		case LAUNCH_STDIO_FDS:
+			(void)dup2(fds[1], 1);
+			(void)dup2(fds[2], 2);
+			break;
+
+		case LAUNCH_STDIO_DEMUX:
+			if ((fd = open_demux(req->lr_demux_addr, req->lr_demux_out)) == -1)
+				goto fail;
+			(void)dup2(fd, 1);
+			if (fd > 1)
+				(void)close(fd);
+			if ((fd = open_demux(req->lr_demux_addr, req->lr_demux_err)) == -1)
+				goto fail;
+			(void)dup2(fd, 2);
+			if (fd > 2)
+				(void)close(fd);
+			(void)write(1, req->lr_cookie, strlen(req->lr_cookie));
+			(void)write(2, req->lr_cookie, strlen(req->lr_cookie));
+			break;
+
+		default:
+			if ((fd = open("/dev/null", O_RDONLY)) == -1) {
+				(void)close(1);
+				(void)close(2);
+			} else {
+				(void)dup2(fd, 1);
+				(void)dup2(fd, 2);
+				if (fd > 2)
+					(void)close(fd);
+			}
+			break;
+	}
+	for (j = 0; j < 3; j++) {
+		if (fds[j] > 2)
+			(void)close(fds[j]);
+	}
+
+	/* tell the helper we are going, errpipe is closed on exec */
+	sjr.sj_code = JOB_EXEC_OK;
+	(void)writepipe(errpipe, &sjr, sizeof(sjr));
+
+	environ = req->lr_envp;
+	execvp(req->lr_prog, req->lr_argv);
+	(void)fprintf(stderr, "%s: %s\n", req->lr_prog, strerror(errno));
+	exit(254);
+
+fail:
+	(void)writepipe(errpipe, &sjr, sizeof(sjr));
+	exit(254);
+}
+
+/**
+ * @brief
+ *	Read a launch request from MoM, fork the process and reply with
+ *	its starter return.
+ *
+ * @param[in]	sock - helper end of the socketpair
+ * @param[in]	sigmask - signal mask to restore in the process
+ *
+ * @return	int
+ * @retval	0	Success (the process may still have failed to start)
+ * @retval	-1	MoM closed the socket or the request was garbled
+ *
+ */
+static int
+launcher_serve(int sock, sigset_t *sigmask)
+{
+	struct launch_req	req;
+	struct launch_msg	reply;
+	struct msghdr		mh;
+	struct iovec		iov;
+	struct cmsghdr		*cmsg;
+	char			cbuf[CMSG_SPACE(3 * sizeof(int))];
+	int			fds[3] = {-1, -1, -1};
+	int			nfds;
+	char			*strs = NULL;
+	char			*p;
+	int			pipes[2];
+	int			code;
+	int			i;
+	ssize_t			n;
+
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = &req;
+	iov.iov_len = sizeof(req);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+	do {
+		n = recvmsg(sock, &mh, MSG_WAITALL);
+	} while (n == -1 && errno == EINTR);
+	if (n != sizeof(req))
+		return -1;
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+			continue;
+		nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		if (nfds == 3)
+			memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+		else if (nfds == 2)
+			memcpy(&fds[1], CMSG_DATA(cmsg), 2 * sizeof(int));
+	}
+	req.lr_stdin = (fds[0] != -1);
+
+	/* the pointers in the request are MoM's, rebuild them from the strings */
+	strs = malloc(req.lr_strlen);
+	req.lr_argv = calloc(req.lr_argc + 1, sizeof(char *));
+	req.lr_envp = calloc(req.lr_envc + 1, sizeof(char *));
+	if ((strs == NULL) || (req.lr_argv == NULL) || (req.lr_envp == NULL) ||
+		(req.lr_argc < 1) ||
+		(launcher_readn(sock, strs, req.lr_strlen) == -1)) {
+		code = -1;
+		goto done;
+	}
+	p = strs;
+	req.lr_prog = p;
+	p += strlen(p) + 1;
+	for (i = 0; i < req.lr_argc; i++, p += strlen(p) + 1)
+		req.lr_argv[i] = p;
+	for (i = 0; i < req.lr_envc; i++, p += strlen(p) + 1)
+		req.lr_envp[i] = p;
+	req.lr_euser = p;
+	p += strlen(p) + 1;
+	req.lr_cwd = p;
+	p += strlen(p) + 1;
+	req.lr_cookie = p;
+
+	memset(&reply, 0, sizeof(reply));
+	reply.lm_type = LAUNCH_REPLY;
+	reply.lm_tag = req.lr_tag;
+	reply.lm_pid = -1;
+	reply.lm_sjr.sj_code = JOB_EXEC_RETRY;
+	reply.lm_sjr.sj_session = -1;
+	if (pipe2(pipes, O_CLOEXEC) == -1)
+		goto reply;
+
+	reply.lm_pid = fork();
+	if (reply.lm_pid == 0) {
+		(void)close(pipes[0]);
+		(void)close(sock);
+		launcher_exec(&req, fds, pipes[1], sigmask);
+	}
+	(void)close(pipes[1]);
+	if (reply.lm_pid != -1) {
+		if (readpipe(pipes[0], &reply.lm_sjr, sizeof(reply.lm_sjr)) != sizeof(reply.lm_sjr)) {
+			/* died before it got anywhere */
+			memset(&reply.lm_sjr, 0, sizeof(reply.lm_sjr));
+			reply.lm_sjr.sj_code = JOB_EXEC_FAIL2;
+			reply.lm_sjr.sj_session = reply.lm_pid;
+		}
+	}
+	(void)close(pipes[0]);
+
+reply:
+	code = (writepipe(sock, &reply, sizeof(reply)) == sizeof(reply)) ? 0 : -1;
+
+done:
+	for (i = 0; i < 3; i++) {
+		if (fds[i] != -1)
+			(void)close(fds[i]);
+	}
+	free(strs);
+	free(req.lr_argv);
+	free(req.lr_envp);
+	return code;
+}
+
+/**
+ * @brief
+ *	SIGCHLD handler for the helper, only there to interrupt ppoll().
+ */
+static void
+launcher_catch_child(int sig)
+{
+}
+
+/**
+ * @brief
+ *	Main loop of the helper.  Serves launch requests and reports
+ *	reaped processes until MoM closes its end of the socket, then
+ *	waits for the remaining ones.
+ *
+ * @par
+ *	SIGCHLD is blocked except while waiting in ppoll(), so an exit is
+ *	never missed between the waitpid() pass and the wait.
+ *
+ * @param[in]	sock - helper end of the socketpair
+ *
+ * @return	does not return
+ *
+ */
+static void
+launcher_main(int sock)
+{
+	struct sigaction	act;
+	sigset_t		chld;
+	sigset_t		waitmask;
+	struct pollfd		pfd;
+	struct launch_msg	msg;
+	int			statloc;
+	pid_t			pid;
+	int			mom_gone = 0;
+
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_handler = SIG_DFL;
+	(void)sigaction(SIGINT, &act, NULL);
+	(void)sigaction(SIGTERM, &act, NULL);
+	act.sa_handler = SIG_IGN;
+	(void)sigaction(SIGHUP, &act, NULL);
+
+	sigemptyset(&chld);
+	sigaddset(&chld, SIGCHLD);
+	(void)sigprocmask(SIG_BLOCK, &chld, &waitmask);
+	sigdelset(&waitmask, SIGCHLD);
+
+	act.sa_handler = launcher_catch_child;
+	(void)sigaction(SIGCHLD, &act, NULL);
+
+	log_close(0);
+
+	for (;;) {
+		while ((pid = waitpid(-1, &statloc, WNOHANG)) > 0) {
+			if (mom_gone)
+				continue;
+			memset(&msg, 0, sizeof(msg));
+			msg.lm_type = LAUNCH_EXIT;
+			msg.lm_pid = pid;
+			msg.lm_code = statloc;
+			if (writepipe(sock, &msg, sizeof(msg)) != sizeof(msg))
+				mom_gone = 1;
+		}
+		if (mom_gone) {
+			if ((pid == -1) && (errno == ECHILD))
+				exit(0);
+			(void)sigsuspend(&waitmask);
+			continue;
+		}
+
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (ppoll(&pfd, 1, NULL, &waitmask) <= 0)
+			continue;
+		if (launcher_serve(sock, &waitmask) == -1) {
+			(void)close(sock);
+			mom_gone = 1;
+		}
+	}
+}
+
+/**
+ * @brief
+ *	Start the launcher helper if $launcher is set and it is not running.
+ *
+ * @par
+ *	MoM calls this early in its startup, before TPP, Python and the
+ *	poll code are set up, while it is still small, and a plain fork()
+ *	is enough.  If the helper has to be started again later, fork_me()
+ *	cleans up the child.
+ *
+ * @param[in]	early - called during startup, before tpp_init()
+ *
+ * @return	int
+ * @retval	0	helper is running
+ * @retval	-1	helper is not available
+ *
+ */
+int
+launcher_start(int early)
+{
+	int	sv[2];
+	pid_t	pid;
+
+	if (!launcher)
+		return -1;
+	if (launcher_sock != -1)
+		return 0;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+		log_err(errno, __func__, "socketpair");
+		return -1;
+	}
+	if (!early)
+		pid = fork_me(-1);
+	else if ((pid = fork()) == 0) {
+		(void)close(lockfds);
+		net_close(-1);
+	} else if (pid == -1)
+		log_err(errno, __func__, "fork failed");
+	if (pid == -1) {
+		(void)close(sv[0]);
+		(void)close(sv[1]);
+		return -1;
+	}
+	if (pid == 0) {
+		(void)close(sv[0]);
+		launcher_main(sv[1]);
+	}
+	(void)close(sv[1]);
+	(void)fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	if (add_conn(sv[0], ChildPipe, (pbs_net_t)0, 0, NULL, launcher_read) == NULL) {
+		log_err(-1, __func__, "add_conn failed");
+		(void)close(sv[0]);
+		(void)kill(pid, SIGTERM);
+		return -1;
+	}
+	launcher_sock = sv[0];
+	launcher_pid = pid;
+
+	sprintf(log_buffer, "task launcher started, pid %d", (int)pid);
+	log_event(PBSEVENT_SYSTEM, 0, LOG_INFO, __func__, log_buffer);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Ask the helper to start a process for a task of a job.  MoM does
+ *	not wait for the process to be set up: if func is given, it is
+ *	called with the starter return from the main loop once the reply
+ *	is in, otherwise the caller collects it with launcher_wait().
+ *
+ * @param[in]	req - launch request, lr_tag, lr_argc, lr_envc and lr_strlen are filled in here
+ * @param[in]	fds - stdin (or -1), stdout and stderr for LAUNCH_STDIO_FDS
+ * @param[in]	ptask - task the process is for
+ * @param[in]	func - called with the reply, or NULL
+ *
+ * @return	long
+ * @retval	tag of the request
+ * @retval	-1	the helper could not be used, fork from MoM instead
+ *
+ */
+long
+launcher_spawn(struct launch_req *req, int *fds, pbs_task *ptask, launch_done_t func)
+{
+	struct launch_pending	*lp;
+	struct msghdr		mh;
+	struct iovec		iov;
+	struct cmsghdr		*cmsg;
+	char			cbuf[CMSG_SPACE(3 * sizeof(int))];
+	char			*strs;
+	char			*p;
+	size_t			len = 0;
+	int			nfds;
+	int			i;
+	ssize_t			n;
+
+	if (launcher_start(0) == -1)
+		return -1;
+
+	if (npending == max_pending) {
+		void	*hold;
+
+		hold = realloc(pending, (max_pending + 16) * sizeof(struct launch_pending));
+		if (hold == NULL) {
+			log_err(errno, __func__, MALLOC_ERR_MSG);
+			return -1;
+		}
+		pending = hold;
+		max_pending += 16;
+	}
+
+	if (req->lr_prog == NULL)
+		req->lr_prog = req->lr_argv[0];
+	if (req->lr_cookie == NULL)
+		req->lr_cookie = "";
+	snprintf(req->lr_jobid, sizeof(req->lr_jobid), "%s", ptask->ti_job->ji_qs.ji_jobid);
+	req->lr_svrflags = ptask->ti_job->ji_qs.ji_svrflags;
+	req->lr_tag = ++launcher_tag;
+	req->lr_argc = 0;
+	req->lr_envc = 0;
+	len += strlen(req->lr_prog) + 1;
+	for (i = 0; req->lr_argv[i]; i++, req->lr_argc++)
+		len += strlen(req->lr_argv[i]) + 1;
+	for (i = 0; req->lr_envp[i]; i++, req->lr_envc++)
+		len += strlen(req->lr_envp[i]) + 1;
+	len += strlen(req->lr_euser) + 1;
+	len += strlen(req->lr_cwd) + 1;
+	len += strlen(req->lr_cookie) + 1;
+	req->lr_strlen = len;
+
+	if ((strs = malloc(len)) == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		return -1;
+	}
+	p = stpcpy(strs, req->lr_prog) + 1;
+	for (i = 0; req->lr_argv[i]; i++)
+		p = stpcpy(p, req->lr_argv[i]) + 1;
+	for (i = 0; req->lr_envp[i]; i++)
+		p = stpcpy(p, req->lr_envp[i]) + 1;
+	p = stpcpy(p, req->lr_euser) + 1;
+	p = stpcpy(p, req->lr_cwd) + 1;
+	(void)strcpy(p, req->lr_cookie);
+
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = req;
+	iov.iov_len = sizeof(*req);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	if (req->lr_stdio == LAUNCH_STDIO_FDS) {
+		nfds = (fds[0] == -1) ? 2 : 3;
+		memset(cbuf, 0, sizeof(cbuf));
+		mh.msg_control = cbuf;
+		mh.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fds[3 - nfds], nfds * sizeof(int));
+	}
+	do {
+		n = sendmsg(launcher_sock, &mh, MSG_NOSIGNAL);
+	} while (n == -1 && errno == EINTR);
+	if ((n != sizeof(*req)) ||
+		(writepipe(launcher_sock, strs, len) != len)) {
+		log_err(errno, __func__, "launch request");
+		free(strs);
+		launcher_lost();
+		return -1;
+	}
+	free(strs);
+
+	lp = &pending[npending++];
+	memset(lp, 0, sizeof(*lp));
+	lp->lp_tag = req->lr_tag;
+	snprintf(lp->lp_jobid, sizeof(lp->lp_jobid), "%s", req->lr_jobid);
+	lp->lp_task = ptask->ti_qs.ti_task;
+	lp->lp_func = func;
+	return req->lr_tag;
+}
+
+/**
+ * @brief
+ *	Wait for the helper's reply to a launch request made without a
+ *	callback.  Exits and replies to other requests that come in
+ *	first are kept for the main loop.
+ *
+ * @param[in]	tag - tag returned by launcher_spawn()
+ * @param[out]	sjr - starter return of the process
+ *
+ * @return	int
+ * @retval	0	Success, see sjr->sj_code
+ * @retval	-1	unknown request
+ *
+ */
+int
+launcher_wait(long tag, struct startjob_rtn *sjr)
+{
+	struct launch_pending	*lp;
+
+	for (;;) {
+		if ((lp = launcher_find(tag)) == NULL)
+			return -1;
+		if (lp->lp_done)
+			break;
+		(void)launcher_read_one(launcher_sock);
+	}
+	*sjr = lp->lp_sjr;
+	npending--;
+	memmove(lp, lp + 1, (npending - (lp - pending)) * sizeof(struct launch_pending));
+	return 0;
+}
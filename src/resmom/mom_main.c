@@ -108,6 +108,7 @@
 #include	"pbs_ecl.h"
 #include	"pbs_internal.h"
 #include	"pbs_idx.h"
+#include	"avltree.h"
 #ifdef HWLOC
 #ifndef NAS /* localmod 113 */
 #include	"hwloc.h"
@@ -299,6 +300,8 @@ long joinjob_alarm_time = -1;
 long job_launch_delay = -1; /* # of seconds to delay job launch due to pipe reads (pipe read timeout)  */
 int update_joinjob_alarm_time = 0;
 int update_job_launch_delay = 0;
+int sister_fanout = 0;	/* arity of the sister fan-out tree, 0 for flat */
+int sister_poll_batch = FALSE;	/* sisters push resources_used to MS */
 
 #ifdef NAS /* localmod 015 */
 unsigned long	spoolsize = 0; /* default spoolsize = unlimited */
@@ -443,7 +446,11 @@ static handler_ret_t config_verscheck(char *);
 static handler_ret_t cputmult(char *);
 static handler_ret_t parse_config(char *);
 static handler_ret_t prologalarm(char *);
+static handler_ret_t set_proc_events(char *);
 static handler_ret_t set_joinjob_alarm(char *);
+static handler_ret_t set_launcher(char *);
+static handler_ret_t set_sister_fanout(char *);
+static handler_ret_t set_sister_poll_batch(char *);
 static handler_ret_t set_job_launch_delay(char *);
 static handler_ret_t restricted(char *);
 static handler_ret_t set_alien_attach(char *);
@@ -523,6 +530,7 @@ static struct	specials {
 	{ "ideal_load",			setidealload },
 	{ "jobdir_root",		set_jobdir_root },
 	{ "kbd_idle",			set_kbd_idle },
+	{ "launcher",			set_launcher },
 	{ "logevent",			setlogevent },
 	{ "max_check_poll",		set_max_check_poll },
 	{ "max_load",			setmaxload },
@@ -533,8 +541,11 @@ static struct	specials {
 	{ "nrun_factor",		set_nrun_factor },
 #endif
 	{ "port",			set_momport },
+	{ "proc_events",		set_proc_events },
 	{ "prologalarm",		prologalarm },
+	{ "sister_fanout",		set_sister_fanout },
 	{ "sister_join_job_alarm",	set_joinjob_alarm },
+	{ "sister_poll_batch",		set_sister_poll_batch },
 	{ "job_launch_delay",		set_job_launch_delay },
 	{ "restart_background",		set_restart_background },
 	{ "restart_transmogrify",	set_restart_transmogrify },
@@ -1907,6 +1918,86 @@ set_joinjob_alarm(char *value)
 	return HANDLER_SUCCESS;
 }
 
+/**
+ * @brief
+ *	Handler function for the $sister_fanout config option: 0 to send
+ *	job-wide commands to every sister directly, or a fan-out of at
+ *	least 2.
+ *
+ * @param[in]	value - the input given in config file.
+ *
+ * @return handler_ret_t
+ * @retval HANDLER_SUCCESS
+ * @retval HANDLER_FAIL
+ */
+static handler_ret_t
+set_sister_fanout(char *value)
+{
+	long i;
+	char *endp;
+
+	log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_NOTICE,
+		"sister_fanout", value);
+	i = strtol(value, &endp, 10);
+	/* 0 turns the tree off, 1 would make it a serial chain */
+	if ((*endp != '\0') || (i < 0) || (i == 1) || (i > INT_MAX))
+		return HANDLER_FAIL;	/* error */
+	sister_fanout = (int)i;
+	return HANDLER_SUCCESS;
+}
+
+/**
+ * @brief
+ *	Set the configuration flag that makes MoM start tasks through a
+ *	helper process it forks once, instead of forking itself per task.
+ *
+ * @param[in] value - log value
+ *
+ * @retval 0 failure
+ * @retval 1 success
+ *
+ */
+static handler_ret_t
+set_launcher(char *value)
+{
+	return (set_boolean(__func__, value, &launcher));
+}
+
+/**
+ * @brief
+ *	Set the configuration flag that makes MoM track job processes from
+ *	kernel process events instead of scanning /proc.
+ *
+ * @param[in] value - log value
+ *
+ * @retval 0 failure
+ * @retval 1 success
+ *
+ */
+static handler_ret_t
+set_proc_events(char *value)
+{
+	return (set_boolean(__func__, value, &proc_events));
+}
+
+/**
+ * @brief
+ *	Set the configuration flag that makes sisters send the resources
+ *	used by all their jobs to each mother superior in one message per
+ *	poll cycle, instead of being polled for each job.
+ *
+ * @param[in] value - log value
+ *
+ * @retval 0 failure
+ * @retval 1 success
+ *
+ */
+static handler_ret_t
+set_sister_poll_batch(char *value)
+{
+	return (set_boolean(__func__, value, &sister_poll_batch));
+}
+
 /**
  * @brief
  *	Handler function for the $job_launch_delay cconfig option.
@@ -4008,6 +4099,10 @@ read_config(char *file)
 	vnode_additive       = 1;	/* keep vnodes on HUP */
 	joinjob_alarm_time   = -1;
 	job_launch_delay     = -1;
+	sister_fanout        = 0;
+	sister_poll_batch    = FALSE;
+	proc_events          = FALSE;
+	launcher             = FALSE;
 #ifdef NAS /* localmod 015 */
 	spoolsize            = 0; /* unlimited by default */
 #endif /* localmod 015 */
@@ -7379,6 +7474,13 @@ main(int argc, char *argv[])
 
 #endif /* !WIN32 */
 
+	/*
+	 * init_abort_jobs() decodes jobs on up to RECOV_THREADS_MAX threads,
+	 * besides this one and the TPP thread, and they search the
+	 * definition indexes; size the avltree traces before any are built.
+	 */
+	avl_set_maxthreads(RECOV_THREADS_MAX + 2);
+
 	if ((job_attr_idx = cr_attrdef_idx(job_attr_def, JOB_ATR_LAST)) == NULL) {
 		log_err(errno, __func__, "Failed creating job attribute search index");
 		return (-1);
@@ -7413,6 +7515,8 @@ main(int argc, char *argv[])
 	path_undeliv = mk_dirs("undelivered/");
 	path_addconfigs = mk_dirs("mom_priv/config.d");
 
+	log_struct_enable(pbs_conf.pbs_log_structured);
+
 	/* open log file while std in,out,err still open, forces to fd 4 */
 #ifdef	WIN32
 	/* Don't worry about return value of log_open() like */
@@ -7988,6 +8092,14 @@ main(int argc, char *argv[])
 		return (3);
 	}
 
+#ifndef	WIN32
+	/*
+	 * fork the task launcher while MoM is still small, before
+	 * Python, TPP and the poll code are set up
+	 */
+	(void)launcher_start(1);
+#endif
+
 	sprintf(log_buffer, "Out of memory");
 	if (pbs_conf.pbs_leaf_name) {
 		char *p;
@@ -8719,10 +8831,14 @@ main(int argc, char *argv[])
 				/*
 				 ** Send message to get info from other MOM's
 				 ** if I am Mother Superior for the job and
-				 ** it is not being killed.
+				 ** it is not being killed, unless the sisters
+				 ** send in what they use on their own and all
+				 ** of them still do.
 				 */
 				if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) &&
-					(pjob->ji_nodekill == TM_ERROR_NODE)) {
+					(pjob->ji_nodekill == TM_ERROR_NODE) &&
+					!(sister_poll_batch &&
+					(check_resc_used_batch(pjob) == 0))) {
 					int err_flag=0;
 					/*
 					 ** If can't send poll to everybody, the
@@ -8811,6 +8927,10 @@ main(int argc, char *argv[])
 					(void)terminate_job(pjob, 1);
 				}
 			} /* for pjob in mom_polljobs */
+
+			/* report usage of the jobs I'm a sister for */
+			if (sister_poll_batch)
+				send_resc_used_batch();
 		} /* for pjob in svr_alljobs */
 	} /* Mom main loop */
 
@@ -176,6 +176,7 @@ char *variables_else[] = {	/* variables to add, value computed */
 
 static	int num_var_else = sizeof(variables_else) / sizeof(char *);
 static	void catchinter(int);
+static	mode_t job_umask(job *);
 
 extern int is_direct_write(job *, enum job_file, char *, int *);
 static int direct_write_possible = 1;
@@ -616,9 +617,11 @@ is_joined(job *pjob)
 
 /**
  * @brief
- * 	open_std_out_err - open standard out and err to files
+ * 	open_std_fds - open the job's standard out and err files
  *
  * @param[in] pjob - job pointer
+ * @param[out] pout - descriptor for standard out, > 2
+ * @param[out] perr - descriptor for standard err, > 2
  *
  * @return	int
  * @retval	0	Success
@@ -627,7 +630,7 @@ is_joined(job *pjob)
  */
 
 static int
-open_std_out_err(job *pjob)
+open_std_fds(job *pjob, int *pout, int *perr)
 {
 	int	   i;
 	int	   file_out = -2;
@@ -658,6 +661,10 @@ open_std_out_err(job *pjob)
 		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_NOTICE,
 			pjob->ji_qs.ji_jobid,
 			"Unable to open standard output/error");
+		if (file_out >= 0)
+			(void)close(file_out);
+		if (file_err >= 0)
+			(void)close(file_err);
 		return -1;
 	}
 
@@ -671,6 +678,32 @@ open_std_out_err(job *pjob)
 
 	FDMOVE(file_out);	/* make sure descriptor > 2       */
 	FDMOVE(file_err);	/* so don't clobber stdin/out/err */
+	*pout = file_out;
+	*perr = file_err;
+	return 0;
+}
+
+/**
+ * @brief
+ * 	open_std_out_err - open standard out and err to files
+ *
+ * @param[in] pjob - job pointer
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	Error
+ *
+ */
+
+static int
+open_std_out_err(job *pjob)
+{
+	int	   file_out;
+	int	   file_err;
+
+	if (open_std_fds(pjob, &file_out, &file_err) == -1)
+		return -1;
+
 	if (file_out != 1) {
 		(void)close(1);
 		(void)dup(file_out);
@@ -1507,6 +1540,94 @@ job_setup(job *pjob, struct passwd **pwdparm)
 	return JOB_EXEC_OK;
 }
 
+/**
+ * @brief
+ *	Record that the shell of a job has been started, or bail out of
+ *	the job if it could not be.
+ *
+ * @par Functionality:
+ *	Record the session id and global id (if one), set the state and
+ *	substate to RUNNING, get a first sample of usage for this job
+ *	and return a status update to the Server so it knows the job is
+ *	going.  Called with the starter return read from the job starter
+ *	process, or from the $launcher helper.
+ *
+ * @param[in]	pjob - job being started
+ * @param[in]	ptask - task of the job shell
+ * @param[in]	sjr - starter return
+ *
+ * @return	None
+ *
+ */
+static void
+job_shell_started(job *pjob, pbs_task *ptask, struct startjob_rtn *sjr)
+{
+	/*
+	 ** Set the global id before exiting on error so any
+	 ** information can be put into the job struct first.
+	 */
+	set_globid(pjob, sjr);
+	if (sjr->sj_code < 0) {
+#if MOM_ALPS
+		/* we couldn't get a reservation so refresh the inventory */
+		if (sjr->sj_reservation == -1)
+			call_hup = HUP_INIT;
+#endif
+		(void)sprintf(log_buffer, "job not started, %s %d",
+			(sjr->sj_code==JOB_EXEC_RETRY)?
+			"Retry" : "Failure", sjr->sj_code);
+		exec_bail(pjob, sjr->sj_code, log_buffer);
+		return;
+	}
+
+	ptask->ti_qs.ti_sid = sjr->sj_session;
+	ptask->ti_qs.ti_status = TI_STATE_RUNNING;
+
+	strcpy(ptask->ti_qs.ti_parentjobid, pjob->ji_qs.ji_jobid);
+	if (task_save(ptask) == -1) {
+		(void)sprintf(log_buffer, "Task save failed");
+		exec_bail(pjob, JOB_EXEC_RETRY, log_buffer);
+		return;
+	}
+
+	/*
+	 * return from the starter indicated the job is a go ...
+	 * record the start time and session/process id
+	 */
+
+	start_walltime(pjob);
+
+	set_jattr_l_slim(pjob, JOB_ATR_session_id, sjr->sj_session, SET);
+
+	set_job_state(pjob, JOB_STATE_LTR_RUNNING);
+	set_job_substate(pjob, JOB_SUBSTATE_RUNNING);
+	job_save(pjob);
+
+	if (mom_get_sample() == PBSE_NONE) {
+		time_resc_updated = time_now;
+		(void)mom_set_use(pjob);
+	}
+	/*
+	 * these are set so that it will
+	 * return them to the Server on the first update below
+	 */
+	(get_jattr(pjob, JOB_ATR_errpath))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_outpath))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_session_id))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_altid))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_state))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_substate))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_jobdir))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_altid2))->at_flags |= ATR_VFLAG_MODIFY;
+	(get_jattr(pjob, JOB_ATR_acct_id))->at_flags |= ATR_VFLAG_MODIFY;
+
+	enqueue_update_for_send(pjob, IS_RESCUSED);
+	next_sample_time = min_check_poll;
+	log_eventf(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->ji_qs.ji_jobid, "Started, pid = %d", sjr->sj_session);
+
+	return;
+}
+
 /**
  * @brief
  *	record_finish_exec - record the results of finish_exec()
@@ -1760,70 +1881,7 @@ record_finish_exec(int sd)
 		}
 	}
 
-	/*
-	 ** Set the global id before exiting on error so any
-	 ** information can be put into the job struct first.
-	 */
-	set_globid(pjob, &sjr);
-	if (sjr.sj_code < 0) {
-#if MOM_ALPS
-		/* we couldn't get a reservation so refresh the inventory */
-		if (sjr.sj_reservation == -1)
-			call_hup = HUP_INIT;
-#endif
-		(void)sprintf(log_buffer, "job not started, %s %d",
-			(sjr.sj_code==JOB_EXEC_RETRY)?
-			"Retry" : "Failure", sjr.sj_code);
-		exec_bail(pjob, sjr.sj_code, log_buffer);
-		return;
-	}
-
-	ptask->ti_qs.ti_sid = sjr.sj_session;
-	ptask->ti_qs.ti_status = TI_STATE_RUNNING;
-
-	strcpy(ptask->ti_qs.ti_parentjobid, pjob->ji_qs.ji_jobid);
-	if (task_save(ptask) == -1) {
-		(void)sprintf(log_buffer, "Task save failed");
-		exec_bail(pjob, JOB_EXEC_RETRY, log_buffer);
-		return;
-	}
-
-	/*
-	 * return from the starter indicated the job is a go ...
-	 * record the start time and session/process id
-	 */
-
-	start_walltime(pjob);
-
-	set_jattr_l_slim(pjob, JOB_ATR_session_id, sjr.sj_session, SET);
-
-	set_job_state(pjob, JOB_STATE_LTR_RUNNING);
-	set_job_substate(pjob, JOB_SUBSTATE_RUNNING);
-	job_save(pjob);
-
-	if (mom_get_sample() == PBSE_NONE) {
-		time_resc_updated = time_now;
-		(void)mom_set_use(pjob);
-	}
-	/*
-	 * these are set so that it will
-	 * return them to the Server on the first update below
-	 */
-	(get_jattr(pjob, JOB_ATR_errpath))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_outpath))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_session_id))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_altid))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_state))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_substate))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_jobdir))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_altid2))->at_flags |= ATR_VFLAG_MODIFY;
-	(get_jattr(pjob, JOB_ATR_acct_id))->at_flags |= ATR_VFLAG_MODIFY;
-
-	enqueue_update_for_send(pjob, IS_RESCUSED);
-	next_sample_time = min_check_poll;
-	log_eventf(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->ji_qs.ji_jobid, "Started, pid = %d", sjr.sj_session);
-
-	return;
+	job_shell_started(pjob, ptask, &sjr);
 }
 
 /**
@@ -2761,116 +2819,568 @@ receive_job_update_request(int sd)
 }
 
 /**
- *
  * @brief
- * 	Used by MOM superior to start the shell process for 'pjob'
+ *	Give the job owner the script of a job and return its path, with
+ *	brackets escaped, to be passed to the shell.
  *
- * @param[in]	pjob - pointer to the job whose initial shell is
- *		being spawned.
+ * @param[in]	pjob - job being started
+ * @param[out]	name - buffer for the path
+ * @param[in]	len - size of name
  *
  * @return	Void
  *
  */
-void
-finish_exec(job *pjob)
+static void
+job_script_name(job *pjob, char *name, size_t len)
 {
-	char			**argv = NULL;
+	char	buf[(2 * MAXPATHLEN) + 5];
+	char	*s, *d;
+
+	if (*pjob->ji_qs.ji_fileprefix != '\0')
+		sprintf(buf, "%s%s%s", path_jobs,
+			pjob->ji_qs.ji_fileprefix, JOB_SCRIPT_SUFFIX);
+	else
+		sprintf(buf, "%s%s%s", path_jobs,
+			pjob->ji_qs.ji_jobid, JOB_SCRIPT_SUFFIX);
+	(void)chown(buf, pjob->ji_qs.ji_un.ji_momt.ji_exuid,
+		pjob->ji_qs.ji_un.ji_momt.ji_exgid);
+
+	/* add escape in front of brackets */
+	for (s = buf, d = name; *s && ((d - name) < len - 2); s++, d++) {
+		if (*s == '[' || *s == ']')
+			*d++ = '\\';
+		*d = *s;
+	}
+	*d = '\0';
+}
+
+/**
+ * @brief
+ *	Build the environment of the shell of a job: the variables from
+ *	MoM's environment, those passed with the job and the PBS_*
+ *	variables.  Also creates TMPDIR, the PBS_NODEFILE and, for
+ *	sandbox=PRIVATE, the job directory.
+ *
+ * @param[in]	pjob - job being started
+ * @param[in]	ptask - task of the job shell
+ * @param[in]	pwdp - password entry of the job owner
+ * @param[in]	shell - shell of the job
+ * @param[in]	vtab - variable table to add to
+ * @param[in]	pbs_jobdir - staging and execution directory of the job
+ * @param[in]	sandbox_private - job runs in sandbox=PRIVATE mode
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	JOB_EXEC_*	error
+ *
+ */
+static int
+job_env_build(job *pjob, pbs_task *ptask, struct passwd *pwdp, char *shell,
+	struct var_table *vtab, char *pbs_jobdir, int sandbox_private)
+{
+	struct array_strings	*vstrs;
 	char			buf[(2 * MAXPATHLEN) + 5];
-	pid_t			cpid;
-	struct passwd		*pwdp;		/* for uid, shell, home dir */
-	int			i, j, k;
-	pbs_socklen_t		len;
-	int			is_interactive = 0;
-	int			numthreads;
-#if SHELL_INVOKE == 1
-	int			pipe_script[] = {-1, -1};
-#endif
-	char			*pts_name;	/* name of slave pty */
-	char			*shell;
-	int			jsmpipe[] = {-1, -1};	/* job starter to MOM for sid */
-	int			jsmpipe2[] = {-1, -1};	/* job starter to MOM */
-	int			child2parent_job_update_pipe[] = {-1, -1};	/* job starter to MOM */
-	int			child2parent_job_update_pipe_w = -1;
-	int			upfds = -1;	/* init to invalid fd */
-	int			upfds2 = -1;	/* init to invalid fd */
-	int			mjspipe[] = {-1, -1};	/* MOM to job starter for ack */
-	int			mjspipe2[] = {-1, -1};	/* MOM to job starter */
-	int			parent2child_job_update_pipe[] = {-1, -1};	/* MOM to job starter */
-	int			parent2child_job_update_pipe_r = -1;
-	int			parent2child_job_update_status_pipe[] = {-1, -1};	/* MOM to job starter */
-	int			parent2child_job_update_status_pipe_r = -1;	/* init to invalid fd */
-	int			downfds = -1;	/* init to invalid fd */
-	int			downfds2 = -1;	/* init to invalid fd */
-	int			parent2child_moms_status_pipe[] = {-1, -1};	/* MOM to job starter */
-	int			parent2child_moms_status_pipe_r = -1;	/* init to invalid fd */
-	int			port_out, port_err;
-	struct startjob_rtn	sjr;
-#if MOM_ALPS
-	struct startjob_rtn	ack;
-#endif
-	pbs_task			*ptask;
-	struct	array_strings	*vstrs;
-	struct	sockaddr_in	saddr;
-	int			nodemux = 0;
-	char			*pbs_jobdir; /* staging and execution directory of this job */
-	int			sandbox_private = 0;
-	int			display_number = 0, n = 0;
-	struct			pfwdsock *socks = NULL;
+	int			j;
 #ifdef NAS /* localmod 020 */
-	char * schedselect;
+	char			*schedselect;
 #endif /* localmod 020 */
-	char			hook_msg[HOOK_MSG_SIZE+1];
-	int			hook_rc;
-	int			prolo_hooks = 0;/*# of runnable prologue hooks*/
-	char			*progname = NULL;
-	pbs_list_head		argv_list;
-	char			*the_progname;
-	char			**the_argv;
-	char			**the_env;
-	char			**res_env;
-	hook			*last_phook = NULL;
-	unsigned int		hook_fail_action = 0;
-	int			hook_errcode = 0;
-	mom_hook_input_t	hook_input;
-	mom_hook_output_t	hook_output;
-	int			job_has_executable;
-	FILE			*temp_stderr = stderr;
-	vnl_t			*vnl_fails = NULL;
-	vnl_t			*vnl_good = NULL;
 
-	ptc = -1; /* No current master pty */
+	vstrs = get_jattr_arst(pjob, JOB_ATR_variables);
 
-	memset(&sjr, 0, sizeof(sjr));
-	if (is_jattr_set(pjob, JOB_ATR_nodemux))
-		nodemux = get_jattr_long(pjob, JOB_ATR_nodemux);
+	/*  First variables from the local environment */
 
+	for (j = 0; j < num_var_env; ++j)
+		bld_env_variables(vtab, environ[j], NULL);
 
-	if ((i = job_setup(pjob, &pwdp)) != JOB_EXEC_OK) {
-		exec_bail(pjob, i, NULL);
-		return;
-	}
+	/* Second, the variables passed with the job.  They may */
+	/* be overwritten with new correct values for this job	*/
 
-	/* wait until after job_setup to call jobdirname(), we need the user's home info */
-	pbs_jobdir = jobdirname(pjob->ji_qs.ji_jobid, pjob->ji_grpcache->gc_homedir);
+	for (j = 0; j < vstrs->as_usedptr; ++j)
+		bld_env_variables(vtab, vstrs->as_string[j], NULL);
 
-	if ((is_jattr_set(pjob, JOB_ATR_sandbox)) &&
-		(strcasecmp(get_jattr_str(pjob, JOB_ATR_sandbox), "PRIVATE")== 0)) {
-		/* set local variable sandbox_private */
-		sandbox_private = 1;
-	}
+	/* .. Next the critical variables: home, path, logname, ... */
+	/* these may replace some passed in with the job	    */
 
-	/* If job has been checkpointed, restart from the checkpoint image */
+	/* HOME */
+	bld_env_variables(vtab, variables_else[0], pwdp->pw_dir); /* HOME */
 
-	if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_CHKPT) ||
-		(pjob->ji_qs.ji_svrflags & JOB_SVFLG_ChkptMig)) {
-		if ((i = local_restart(pjob, NULL)) != 0) {
-			post_restart(pjob, i);
+	/* LOGNAME */
+	bld_env_variables(vtab, variables_else[1], pwdp->pw_name);
+
+	/* PBS_JOBNAME */
+	bld_env_variables(vtab, variables_else[2], get_jattr_str(pjob, JOB_ATR_jobname));
+
+	/* PBS_JOBID */
+	bld_env_variables(vtab, variables_else[3], pjob->ji_qs.ji_jobid);
+
+	/* PBS_QUEUE */
+	bld_env_variables(vtab, variables_else[4], get_jattr_str(pjob, JOB_ATR_in_queue));
+
+	/* SHELL */
+	bld_env_variables(vtab, variables_else[5], shell);
+
+	/* USER, for compatability */
+	bld_env_variables(vtab, variables_else[6], pwdp->pw_name);
+
+	/* PBS_JOBCOOKIE */
+	bld_env_variables(vtab, variables_else[7], get_jattr_str(pjob, JOB_ATR_Cookie));
+
+	/* PBS_NODENUM */
+	sprintf(buf, "%d", pjob->ji_nodeid);
+	bld_env_variables(vtab, variables_else[8], buf);
+
+	/* PBS_TASKNUM */
+	sprintf(buf, "%u", ptask->ti_qs.ti_task);
+	bld_env_variables(vtab, variables_else[9], buf);
+
+	/* PBS_MOMPORT */
+	sprintf(buf, "%u", pbs_rm_port);
+	bld_env_variables(vtab, variables_else[10], buf);
+
+	/* OMP_NUM_THREADS and NCPUS eq to number of cpus */
+
+	sprintf(buf, "%d", pjob->ji_vnods[0].vn_threads);
+#ifdef NAS /* localmod 020 */
+	/*
+	 * If ompthreads specified, use it to set OMP_NUM_THREADS, else
+	 * set OMP_NUM_THREADS=1
+	 * (Cannot just leave it unset because then the MKL sparse solvers
+	 * use every CPU in the system.)
+	 */
+	schedselect = get_jattr_str(pjob,  JOB_ATR_SchedSelect);
+	if (schedselect && strstr(schedselect, OMPTHREADS) != NULL)
+		bld_env_variables(vtab, variables_else[12], buf);
+	else
+		bld_env_variables(vtab, variables_else[12], "1");
+#else
+	bld_env_variables(vtab, variables_else[12], buf);
+#endif /* localmod 020 */
+	bld_env_variables(vtab, "NCPUS", buf);
+
+	/* PBS_NODEFILE */
+
+	if (generate_pbs_nodefile(pjob, buf, sizeof(buf)-1, log_buffer, LOG_BUF_SIZE - 1) == 0)
+		bld_env_variables(vtab, variables_else[11], buf);
+	else {
+		log_err(errno, __func__, log_buffer);
+		return JOB_EXEC_FAIL1;
+	}
+
+	/* PBS_ACCOUNT */
+	if (is_jattr_set(pjob, JOB_ATR_account))
+		bld_env_variables(vtab, variables_else[13], get_jattr_str(pjob, JOB_ATR_account));
+
+	/* If an Sub job of an Array job, put in the index */
+
+	if (strchr(pjob->ji_qs.ji_jobid, (int)'[') != NULL) {
+		char *pparent;
+		char *pindex;
+
+		get_index_and_parent(pjob->ji_qs.ji_jobid, &pparent, &pindex);
+		bld_env_variables(vtab, variables_else[14], pindex);
+		bld_env_variables(vtab, variables_else[15], pparent);
+	}
+
+	/* Add TMPDIR to environment */
+#ifdef NAS /* localmod 010 */
+	(void) NAS_tmpdirname(pjob);
+#endif /* localmod 010 */
+	j = mktmpdir(pjob->ji_qs.ji_jobid,
+		pjob->ji_qs.ji_un.ji_momt.ji_exuid,
+		pjob->ji_qs.ji_un.ji_momt.ji_exgid,
+		vtab);
+	if (j != 0)
+		return j;
+
+	/* set PBS_JOBDIR */
+	if (sandbox_private) {
+		/* Add PBS_JOBDIR if it doesn't already exist */
+		j = mkjobdir(pjob->ji_qs.ji_jobid,
+			pbs_jobdir,
+			pjob->ji_qs.ji_un.ji_momt.ji_exuid,
+			pjob->ji_qs.ji_un.ji_momt.ji_exgid);
+		if (j != 0) {
+			sprintf(log_buffer, "unable to create the job directory %s",
+				pbs_jobdir);
+			log_joberr(errno, __func__ , log_buffer, pjob->ji_qs.ji_jobid);
+			return j;
+		}
+		bld_env_variables(vtab, "PBS_JOBDIR", pbs_jobdir);
+	} else {
+		bld_env_variables(vtab, "PBS_JOBDIR", pwdp->pw_dir);
+	}
+	return 0;
+}
+
+#if	!MOM_ALPS && !(defined(PBS_SECURITY) && (PBS_SECURITY == KRB5))
+/**
+ * @brief
+ *	Start the shell of a job through the $launcher helper instead of
+ *	forking MoM.
+ *
+ * @par
+ *	The environment, TMPDIR, the job directory, limits and the standard
+ *	files are prepared here in MoM, and the script name is written to
+ *	the shell's stdin.  The helper forks the shell, which only has to
+ *	call set_job(), set its limits and user, change directory and exec.
+ *	MoM does not wait for it: job_shell_started() records the job as
+ *	running once the helper has replied.
+ *
+ * @par
+ *	Jobs that need something done in the job's session before the shell
+ *	runs still fork from MoM: prologue and execjob_launch hooks, the
+ *	prologue script, interactive jobs, stored credentials, jobs that
+ *	tolerate node failures and multi-node jobs using pbs_demux.
+ *
+ * @param[in]	pjob - job being started
+ * @param[in]	pwdp - password entry of the job owner
+ * @param[in]	pbs_jobdir - staging and execution directory of the job
+ * @param[in]	sandbox_private - job runs in sandbox=PRIVATE mode
+ * @param[in]	nodemux - job does not use pbs_demux
+ *
+ * @return	int
+ * @retval	0	handled, the job was started or bailed out of
+ * @retval	-1	not handled, fork the job starter from MoM
+ *
+ */
+static int
+finish_exec_launcher(job *pjob, struct passwd *pwdp, char *pbs_jobdir,
+	int sandbox_private, int nodemux)
+{
+	struct launch_req	req;
+	struct var_table	vtab;
+	struct array_strings	*vstrs;
+	struct stat		sb;
+	pbs_task		*ptask;
+	char			buf[(3 * MAXPATHLEN) + 10];	/* "cd <jobdir>;<name>\n" */
+	char			name[(2 * MAXPATHLEN) + 5];
+	char			**argv = NULL;
+	char			*shell = NULL;
+	char			**at = NULL;
+	int			fds[3] = {-1, -1, -1};
+	int			pipe_script[2] = {-1, -1};
+	int			job_has_executable;
+	int			code = JOB_EXEC_RETRY;
+	int			i, j;
+
+	if (!launcher)
+		return -1;
+	if ((pjob->ji_numnodes > 1) && !nodemux)
+		return -1;
+	if (is_jattr_set(pjob, JOB_ATR_interactive) &&
+		(get_jattr_long(pjob, JOB_ATR_interactive) != 0))
+		return -1;
+	if ((num_eligible_hooks(HOOK_EVENT_EXECJOB_PROLOGUE) > 0) ||
+		(num_eligible_hooks(HOOK_EVENT_EXECJOB_LAUNCH) > 0))
+		return -1;
+	if (pjob->ji_extended.ji_ext.ji_credtype != PBS_CREDTYPE_NONE)
+		return -1;
+	if (do_tolerate_node_failures(pjob))
+		return -1;
+	if (stat(path_prolog, &sb) == 0)
+		return -1;
+	if (launcher_start(0) == -1)
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	vtab.v_envp = NULL;
+	vtab.v_used = 0;
+	job_has_executable = is_jattr_set(pjob, JOB_ATR_executable);
+
+	if ((ptask = momtask_create(pjob)) == NULL) {
+		(void)sprintf(log_buffer, "Task creation failed");
+		exec_bail(pjob, JOB_EXEC_RETRY, log_buffer);
+		return 0;
+	}
+
+	/* set_shell() cuts the host off the entry it picks, put it back */
+	vstrs = NULL;
+	if (is_jattr_set(pjob, JOB_ATR_shell)) {
+		vstrs = get_jattr_arst(pjob, JOB_ATR_shell);
+		if ((at = calloc(vstrs->as_usedptr + 1, sizeof(char *))) == NULL) {
+			log_err(errno, __func__, MALLOC_ERR_MSG);
+			goto bail;
+		}
+		for (j = 0; j < vstrs->as_usedptr; j++)
+			at[j] = strchr(vstrs->as_string[j], '@');
+	}
+	shell = strdup(set_shell(pjob, pwdp));
+	if (vstrs != NULL) {
+		for (j = 0; j < vstrs->as_usedptr; j++) {
+			if (at[j] != NULL)
+				*at[j] = '@';
+		}
+	}
+	if (shell == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		goto bail;
+	}
+
+	/* set up the environment to be given to the job */
+	vstrs = get_jattr_arst(pjob, JOB_ATR_variables);
+	vtab.v_ensize = vstrs->as_usedptr + num_var_else + num_var_env +
+		EXTRA_ENV_PTRS;
+	vtab.v_envp = (char **)calloc(vtab.v_ensize, sizeof(char *));
+	if (vtab.v_envp == NULL) {
+		log_err(ENOMEM, __func__, "out of memory");
+		code = JOB_EXEC_FAIL1;
+		goto bail;
+	}
+	if ((j = job_env_build(pjob, ptask, pwdp, shell, &vtab,
+		pbs_jobdir, sandbox_private)) != 0) {
+		code = j;
+		goto bail;
+	}
+	bld_env_variables(&vtab, "PBS_ENVIRONMENT", "PBS_BATCH");
+	bld_env_variables(&vtab, "ENVIRONMENT", "BATCH");
+	*(vtab.v_envp + vtab.v_used) = NULL;
+
+	if ((j = mom_get_limits(pjob, &req.lr_limits)) != PBSE_NONE) {
+		(void)sprintf(log_buffer, "Unable to set limits, err=%d", j);
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_ERR,
+			pjob->ji_qs.ji_jobid, log_buffer);
+		code = (j == PBSE_RESCUNAV) ? JOB_EXEC_RETRY : JOB_EXEC_FAIL2;
+		goto bail;
+	}
+
+	/* site_job_setup() runs in MoM, the job's session does not exist yet */
+	if (site_job_setup(pjob) != 0) {
+		code = JOB_EXEC_FAIL2;
+		goto bail;
+	}
+
+	if (job_has_executable) {
+		if (decode_xml_arg_list(get_jattr_str(pjob, JOB_ATR_executable),
+			get_jattr_str(pjob, JOB_ATR_Arglist), &req.lr_prog, &argv) != 0) {
+			code = JOB_EXEC_FAIL2;
+			goto bail;
+		}
+	} else {
+		/* the shell is a login shell, its name starts with a '-' */
+		if ((argv = calloc(2, sizeof(char *))) == NULL ||
+			(argv[0] = malloc(strlen(lastname(shell)) + 2)) == NULL) {
+			log_err(errno, __func__, MALLOC_ERR_MSG);
+			code = JOB_EXEC_FAIL1;
+			goto bail;
+		}
+		sprintf(argv[0], "-%s", lastname(shell));
+		req.lr_prog = shell;
+
+		/* the script, or its name, is the shell's stdin */
+		job_script_name(pjob, name, sizeof(name));
+#if SHELL_INVOKE == 1
+		if (pipe(pipe_script) == -1) {
+			(void)sprintf(log_buffer,
+				"Failed to create shell name pipe");
+			log_err(errno, __func__, log_buffer);
+			goto bail;
+		}
+		/* if in "sandbox=PRIVATE" mode, prepend "cd $PBS_JOBDIR;" */
+		if (sandbox_private)
+			snprintf(buf, sizeof(buf), "cd %s;%s\n", pbs_jobdir, name);
+		else
+			snprintf(buf, sizeof(buf), "%s\n", name);
+		if (writepipe(pipe_script[1], buf, strlen(buf)) != strlen(buf)) {
+			log_err(errno, __func__, "write of shell name pipe");
+			goto bail;
+		}
+		(void)close(pipe_script[1]);
+		pipe_script[1] = -1;
+		fds[0] = pipe_script[0];
+#else	/* SHELL_INVOKE == 0 */
+		(void)strcpy(buf, path_jobs);
+		if (*pjob->ji_qs.ji_fileprefix != '\0')
+			(void)strcat(buf, pjob->ji_qs.ji_fileprefix);
+		else
+			(void)strcat(buf, pjob->ji_qs.ji_jobid);
+		(void)strcat(buf, JOB_SCRIPT_SUFFIX);
+		if ((pipe_script[0] = open(buf, O_RDONLY, 0)) < 0) {
+			log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_ERR,
+				pjob->ji_qs.ji_jobid,
+				"Unable to open script");
+			code = JOB_EXEC_FAIL1;
+			goto bail;
+		}
+		fds[0] = pipe_script[0];
+#endif	/* SHELL_INVOKE */
+	}
+
+	if (open_std_fds(pjob, &fds[1], &fds[2]) == -1)
+		goto bail;
+
+	/*
+	 * An executable runs in PBS_JOBDIR in "sandbox=PRIVATE" mode, a shell
+	 * in the user's home, to process the "dot" files, unless there is no
+	 * home.  See the same choice in finish_exec().
+	 */
+	if (job_has_executable && sandbox_private)
+		req.lr_cwd = pbs_jobdir;
+	else if (sandbox_private && (stat(pwdp->pw_dir, &sb) == -1))
+		req.lr_cwd = pbs_jobdir;
+	else
+		req.lr_cwd = pwdp->pw_dir;
+
+	req.lr_uid = pjob->ji_qs.ji_un.ji_momt.ji_exuid;
+	req.lr_gid = pjob->ji_qs.ji_un.ji_momt.ji_exgid;
+	if (pjob->ji_grpcache)
+		req.lr_rgid = pjob->ji_grpcache->gc_rgid;
+	else
+		req.lr_rgid = pjob->ji_qs.ji_un.ji_momt.ji_exgid;
+	req.lr_euser = get_jattr_str(pjob, JOB_ATR_euser);
+	req.lr_umask = job_umask(pjob);
+	req.lr_shell = 1;
+	req.lr_stdio = LAUNCH_STDIO_FDS;
+	req.lr_argv = argv;
+	req.lr_envp = vtab.v_envp;
+
+	pjob->ji_qs.ji_stime = time_now;
+	set_jattr_l_slim(pjob, JOB_ATR_stime, time_now, SET);
+	pjob->ji_sampletim  = time_now;
+
+	if (launcher_spawn(&req, fds, ptask, job_shell_started) == -1) {
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_ERR,
+			pjob->ji_qs.ji_jobid,
+			"Unable to start job through the task launcher");
+		goto bail;
+	}
+
+	/* record job working directory in jobdir attribute */
+	set_jattr_str_slim(pjob, JOB_ATR_jobdir, sandbox_private ? pbs_jobdir : pwdp->pw_dir, NULL);
+	code = JOB_EXEC_OK;
+
+bail:
+	for (i = 0; i < 3; i++) {
+		if (fds[i] != -1)
+			(void)close(fds[i]);
+	}
+	if (pipe_script[1] != -1)
+		(void)close(pipe_script[1]);
+	free_str_array(argv);
+	if (vtab.v_envp != NULL) {
+		for (i = 0; i < vtab.v_used; i++)
+			free(vtab.v_envp[i]);
+		free(vtab.v_envp);
+	}
+	free(shell);
+	free(at);
+	if (code != JOB_EXEC_OK)
+		exec_bail(pjob, code, NULL);
+	return 0;
+}
+#endif	/* !MOM_ALPS && !KRB5 */
+
+/**
+ *
+ * @brief
+ * 	Used by MOM superior to start the shell process for 'pjob'
+ *
+ * @param[in]	pjob - pointer to the job whose initial shell is
+ *		being spawned.
+ *
+ * @return	Void
+ *
+ */
+void
+finish_exec(job *pjob)
+{
+	char			**argv = NULL;
+	char			buf[(2 * MAXPATHLEN) + 5];
+	pid_t			cpid;
+	struct passwd		*pwdp;		/* for uid, shell, home dir */
+	int			i, j, k;
+	pbs_socklen_t		len;
+	int			is_interactive = 0;
+#if SHELL_INVOKE == 1
+	int			pipe_script[] = {-1, -1};
+#endif
+	char			*pts_name;	/* name of slave pty */
+	char			*shell;
+	int			jsmpipe[] = {-1, -1};	/* job starter to MOM for sid */
+	int			jsmpipe2[] = {-1, -1};	/* job starter to MOM */
+	int			child2parent_job_update_pipe[] = {-1, -1};	/* job starter to MOM */
+	int			child2parent_job_update_pipe_w = -1;
+	int			upfds = -1;	/* init to invalid fd */
+	int			upfds2 = -1;	/* init to invalid fd */
+	int			mjspipe[] = {-1, -1};	/* MOM to job starter for ack */
+	int			mjspipe2[] = {-1, -1};	/* MOM to job starter */
+	int			parent2child_job_update_pipe[] = {-1, -1};	/* MOM to job starter */
+	int			parent2child_job_update_pipe_r = -1;
+	int			parent2child_job_update_status_pipe[] = {-1, -1};	/* MOM to job starter */
+	int			parent2child_job_update_status_pipe_r = -1;	/* init to invalid fd */
+	int			downfds = -1;	/* init to invalid fd */
+	int			downfds2 = -1;	/* init to invalid fd */
+	int			parent2child_moms_status_pipe[] = {-1, -1};	/* MOM to job starter */
+	int			parent2child_moms_status_pipe_r = -1;	/* init to invalid fd */
+	int			port_out, port_err;
+	struct startjob_rtn	sjr;
+#if MOM_ALPS
+	struct startjob_rtn	ack;
+#endif
+	pbs_task			*ptask;
+	struct	array_strings	*vstrs;
+	struct	sockaddr_in	saddr;
+	int			nodemux = 0;
+	char			*pbs_jobdir; /* staging and execution directory of this job */
+	int			sandbox_private = 0;
+	int			display_number = 0, n = 0;
+	struct			pfwdsock *socks = NULL;
+	char			hook_msg[HOOK_MSG_SIZE+1];
+	int			hook_rc;
+	int			prolo_hooks = 0;/*# of runnable prologue hooks*/
+	char			*progname = NULL;
+	pbs_list_head		argv_list;
+	char			*the_progname;
+	char			**the_argv;
+	char			**the_env;
+	char			**res_env;
+	hook			*last_phook = NULL;
+	unsigned int		hook_fail_action = 0;
+	int			hook_errcode = 0;
+	mom_hook_input_t	hook_input;
+	mom_hook_output_t	hook_output;
+	int			job_has_executable;
+	FILE			*temp_stderr = stderr;
+	vnl_t			*vnl_fails = NULL;
+	vnl_t			*vnl_good = NULL;
+
+	ptc = -1; /* No current master pty */
+
+	memset(&sjr, 0, sizeof(sjr));
+	if (is_jattr_set(pjob, JOB_ATR_nodemux))
+		nodemux = get_jattr_long(pjob, JOB_ATR_nodemux);
+
+
+	if ((i = job_setup(pjob, &pwdp)) != JOB_EXEC_OK) {
+		exec_bail(pjob, i, NULL);
+		return;
+	}
+
+	/* wait until after job_setup to call jobdirname(), we need the user's home info */
+	pbs_jobdir = jobdirname(pjob->ji_qs.ji_jobid, pjob->ji_grpcache->gc_homedir);
+
+	if ((is_jattr_set(pjob, JOB_ATR_sandbox)) &&
+		(strcasecmp(get_jattr_str(pjob, JOB_ATR_sandbox), "PRIVATE")== 0)) {
+		/* set local variable sandbox_private */
+		sandbox_private = 1;
+	}
+
+	/* If job has been checkpointed, restart from the checkpoint image */
+
+	if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_CHKPT) ||
+		(pjob->ji_qs.ji_svrflags & JOB_SVFLG_ChkptMig)) {
+		if ((i = local_restart(pjob, NULL)) != 0) {
+			post_restart(pjob, i);
 			exec_bail(pjob, (i == PBSE_CKPBSY) ?
 				JOB_EXEC_RETRY : JOB_EXEC_FAIL2, NULL);
 		}
 		return;
 	}
 
+#if	!MOM_ALPS && !(defined(PBS_SECURITY) && (PBS_SECURITY == KRB5))
+	if (finish_exec_launcher(pjob, pwdp, pbs_jobdir, sandbox_private, nodemux) == 0)
+		return;
+#endif
+
 	if (pjob->ji_numnodes == 1 || nodemux) {
 		port_out = -1;
 		port_err = -1;
@@ -3142,7 +3652,7 @@ finish_exec(job *pjob)
 	cpid = fork_me(-1);
 	if (cpid > 0) {
 		conn_t *conn = NULL;
-		char	*s, *d, holdbuf[(2 * MAXPATHLEN) + 5];
+		char	holdbuf[(2 * MAXPATHLEN) + 5];
 
 		/* the parent side, still the main man, uhh that is MOM */
 
@@ -3271,22 +3781,7 @@ finish_exec(job *pjob)
 			(void) close(ptc);
 			ptc = -1;
 		}
-		if (*pjob->ji_qs.ji_fileprefix != '\0')
-			sprintf(buf, "%s%s%s", path_jobs,
-				pjob->ji_qs.ji_fileprefix, JOB_SCRIPT_SUFFIX);
-		else
-			sprintf(buf, "%s%s%s", path_jobs,
-				pjob->ji_qs.ji_jobid, JOB_SCRIPT_SUFFIX);
-		(void)chown(buf, pjob->ji_qs.ji_un.ji_momt.ji_exuid,
-			pjob->ji_qs.ji_un.ji_momt.ji_exgid);
-
-		/* add escape in front of brackets */
-		for (s = buf, d = holdbuf; *s && ((d - holdbuf) < sizeof(holdbuf)); s++, d++) {
-			if (*s == '[' || *s == ']')
-				*d++ = '\\';
-			*d = *s;
-		}
-		*d = '\0';
+		job_script_name(pjob, holdbuf, sizeof(holdbuf));
 		snprintf(buf, sizeof(buf), "%s", holdbuf);
 		DBPRT(("shell: %s\n", buf))
 #if SHELL_INVOKE == 1
@@ -3467,137 +3962,13 @@ finish_exec(job *pjob)
 #endif
 #endif
 
-	/*  First variables from the local environment */
-
-	for (j = 0; j < num_var_env; ++j)
-		bld_env_variables(&(pjob->ji_env), environ[j], NULL);
-
-	/* Second, the variables passed with the job.  They may */
-	/* be overwritten with new correct values for this job	*/
-
-	for (j = 0; j < vstrs->as_usedptr; ++j)
-		bld_env_variables(&(pjob->ji_env), vstrs->as_string[j], NULL);
-
-	/* .. Next the critical variables: home, path, logname, ... */
-	/* these may replace some passed in with the job	    */
-
-	/* HOME */
-	bld_env_variables(&(pjob->ji_env), variables_else[0], pwdp->pw_dir); /* HOME */
-
-	/* LOGNAME */
-	bld_env_variables(&(pjob->ji_env), variables_else[1], pwdp->pw_name);
-
-	/* PBS_JOBNAME */
-	bld_env_variables(&(pjob->ji_env), variables_else[2], get_jattr_str(pjob, JOB_ATR_jobname));
-
-	/* PBS_JOBID */
-	bld_env_variables(&(pjob->ji_env), variables_else[3], pjob->ji_qs.ji_jobid);
-
-	/* PBS_QUEUE */
-	bld_env_variables(&(pjob->ji_env), variables_else[4], get_jattr_str(pjob, JOB_ATR_in_queue));
-
-	/* SHELL */
-	bld_env_variables(&(pjob->ji_env), variables_else[5], shell);
-
-	/* USER, for compatability */
-	bld_env_variables(&(pjob->ji_env), variables_else[6], pwdp->pw_name);
-
-	/* PBS_JOBCOOKIE */
-	bld_env_variables(&(pjob->ji_env), variables_else[7], get_jattr_str(pjob, JOB_ATR_Cookie));
-
-	/* PBS_NODENUM */
-	sprintf(buf, "%d", pjob->ji_nodeid);
-	bld_env_variables(&(pjob->ji_env), variables_else[8], buf);
-
-	/* PBS_TASKNUM */
-	sprintf(buf, "%u", ptask->ti_qs.ti_task);
-	bld_env_variables(&(pjob->ji_env), variables_else[9], buf);
-
-	/* PBS_MOMPORT */
-	sprintf(buf, "%u", pbs_rm_port);
-	bld_env_variables(&(pjob->ji_env), variables_else[10], buf);
-
-	/* OMP_NUM_THREADS and NCPUS eq to number of cpus */
-
-	numthreads = pjob->ji_vnods[0].vn_threads;
-	sprintf(buf, "%d", numthreads);
-#ifdef NAS /* localmod 020 */
-	/*
-	 * If ompthreads specified, use it to set OMP_NUM_THREADS, else
-	 * set OMP_NUM_THREADS=1
-	 * (Cannot just leave it unset because then the MKL sparse solvers
-	 * use every CPU in the system.)
-	 */
-	schedselect = get_jattr_str(pjob,  JOB_ATR_SchedSelect);
-	if (schedselect && strstr(schedselect, OMPTHREADS) != NULL)
-		bld_env_variables(&(pjob->ji_env), variables_else[12], buf);
-	else
-		bld_env_variables(&(pjob->ji_env), variables_else[12], "1");
-#else
-	bld_env_variables(&(pjob->ji_env), variables_else[12], buf);
-#endif /* localmod 020 */
-	bld_env_variables(&(pjob->ji_env), "NCPUS", buf);
-
-	/* PBS_NODEFILE */
-
-	if (generate_pbs_nodefile(pjob, buf, sizeof(buf)-1, log_buffer, LOG_BUF_SIZE - 1) == 0)
-		bld_env_variables(&(pjob->ji_env), variables_else[11], buf);
-	else {
-		log_err(errno, __func__, log_buffer);
-		starter_return(upfds, downfds, JOB_EXEC_FAIL1, &sjr);
-	}
-
-	/* PBS_ACCOUNT */
-	if (is_jattr_set(pjob, JOB_ATR_account))
-		bld_env_variables(&(pjob->ji_env), variables_else[13], get_jattr_str(pjob, JOB_ATR_account));
-
-	/* If an Sub job of an Array job, put in the index */
-
-	if (strchr(pjob->ji_qs.ji_jobid, (int)'[') != NULL) {
-		char *pparent;
-		char *pindex;
-
-		get_index_and_parent(pjob->ji_qs.ji_jobid, &pparent, &pindex);
-		bld_env_variables(&(pjob->ji_env), variables_else[14], pindex);
-		bld_env_variables(&(pjob->ji_env), variables_else[15], pparent);
-	}
+	if ((j = job_env_build(pjob, ptask, pwdp, shell, &pjob->ji_env,
+		pbs_jobdir, sandbox_private)) != 0)
+		starter_return(upfds, downfds, j, &sjr);	/* exits */
 
 	/* if user specified umask for job, set it */
-	if (is_jattr_set(pjob, JOB_ATR_umask)) {
-		sprintf(buf, "%ld", get_jattr_long(pjob, JOB_ATR_umask));
-		sscanf(buf, "%o", &j);
-		umask(j);
-	} else
-		umask(077);
-
-	/* Add TMPDIR to environment */
-#ifdef NAS /* localmod 010 */
-	(void) NAS_tmpdirname(pjob);
-#endif /* localmod 010 */
-	j = mktmpdir(pjob->ji_qs.ji_jobid,
-		pjob->ji_qs.ji_un.ji_momt.ji_exuid,
-		pjob->ji_qs.ji_un.ji_momt.ji_exgid,
-		&(pjob->ji_env));
-	if (j != 0)
-		starter_return(upfds, downfds, j, &sjr);
+	umask(job_umask(pjob));
 
-	/* set PBS_JOBDIR */
-	if (sandbox_private) {
-		/* Add PBS_JOBDIR if it doesn't already exist */
-		j = mkjobdir(pjob->ji_qs.ji_jobid,
-			pbs_jobdir,
-			pjob->ji_qs.ji_un.ji_momt.ji_exuid,
-			pjob->ji_qs.ji_un.ji_momt.ji_exgid);
-		if (j != 0) {
-			sprintf(log_buffer, "unable to create the job directory %s",
-				pbs_jobdir);
-			log_joberr(errno, __func__ , log_buffer, pjob->ji_qs.ji_jobid);
-			starter_return(upfds, downfds, j, &sjr); /* exits */
-		}
-		bld_env_variables(&(pjob->ji_env), "PBS_JOBDIR", pbs_jobdir);
-	} else {
-		bld_env_variables(&(pjob->ji_env), "PBS_JOBDIR", pwdp->pw_dir);
-	}
 
 	mom_unnice();
 
@@ -4508,51 +4879,396 @@ if (site_job_setup(pjob) != 0) {
 			}
 		}
 
-		/* include any new env settings added. */
-		the_env = pjob->ji_env.v_envp;
-		*(pjob->ji_env.v_envp + pjob->ji_env.v_used) = NULL;
+		/* include any new env settings added. */
+		the_env = pjob->ji_env.v_envp;
+		*(pjob->ji_env.v_envp + pjob->ji_env.v_used) = NULL;
+
+		execve(the_progname, the_argv, the_env);
+		free(progname);
+		free_attrlist(&argv_list);
+		free_str_array(the_argv);
+		the_argv = NULL;
+		free_str_array(hook_output.env);
+		free_str_array(the_env);
+		the_env = NULL;
+	} else if (cpid == 0) { /* child does demux */
+		char	*arg[2];
+		char	*shellname;
+
+		/* setup descriptors 3 and 4 */
+		(void)dup2(pjob->ji_stdout, 3);
+		if (pjob->ji_stdout > 3)
+			close(pjob->ji_stdout);
+		(void)dup2(pjob->ji_stderr, 4);
+		if (pjob->ji_stderr > 4)
+			close(pjob->ji_stderr);
+
+		/* construct argv array */
+		shell = pbs_conf.pbs_demux_path;
+		shellname = strrchr(shell, '/');
+		if (shellname)
+			++shellname;	/* go past last '/' */
+		else
+			shellname = shell;
+		arg[0] = shellname;
+		arg[1] = NULL;
+
+		/* we're purposely not calling log_close() here */
+		/* for this causes a side-effect. log_close() would */
+		/* do an fclose(<logfile>), but its file position */
+		/* is still shared with the parent mom, which */
+		/* could be writing to the <logfile>. */
+		execve(shell, arg, pjob->ji_env.v_envp);
+	}
+	fprintf(temp_stderr, "pbs_mom, exec of %s failed with error: %s\n",
+		shell, strerror(errno));
+	exit(254);	/* should never, ever get here */
+}
+
+/**
+ * @brief
+ *	Allocate the environment table for a task of the job.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] envp - environment passed with the task
+ * @param[out] vtab - table to set up
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	out of memory
+ *
+ */
+static int
+task_env_init(job *pjob, char **envp, struct var_table *vtab)
+{
+	int	j;
+	struct	array_strings	*vstrs;
+
+	for (j=0; envp[j]; j++)
+		;
+	vstrs = get_jattr_arst(pjob, JOB_ATR_variables);
+	vtab->v_ensize = vstrs->as_usedptr + num_var_else + num_var_env +
+		j + EXTRA_ENV_PTRS;
+	vtab->v_used   = 0;
+	vtab->v_envp = (char **)malloc(vtab->v_ensize * sizeof(char *));
+	if (vtab->v_envp == NULL)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Fill in the environment of a task of the job, and create its TMPDIR.
+ *
+ * @param[in] ptask - pointer to task structure
+ * @param[in] envp - environment passed with the task
+ * @param[in,out] vtab - table set up by task_env_init()
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	JOB_EXEC_* error from mktmpdir()
+ *
+ */
+static int
+task_env_build(task *ptask, char **envp, struct var_table *vtab)
+{
+	job	*pjob = ptask->ti_job;
+	char	buf[MAXPATHLEN+2];
+	int	i, j;
+	struct	array_strings	*vstrs;
+
+	vstrs = get_jattr_arst(pjob, JOB_ATR_variables);
+
+	/* First variables from the local environment */
+	for (j = 0; j < num_var_env; ++j)
+		bld_env_variables(vtab, environ[j], NULL);
+
+	/* Next, the variables passed with the job.  They may   */
+	/* be overwritten with new correct values for this job	*/
+
+	for (j = 0; j < vstrs->as_usedptr; ++j)
+		bld_env_variables(vtab, vstrs->as_string[j], NULL);
+
+	/* HOME */
+	bld_env_variables(vtab, variables_else[0],
+		pjob->ji_grpcache->gc_homedir);
+
+	/* PBS_JOBNAME */
+	bld_env_variables(vtab, variables_else[2],
+		get_jattr_str(pjob, JOB_ATR_jobname));
+
+	/* PBS_JOBID */
+	bld_env_variables(vtab, variables_else[3], pjob->ji_qs.ji_jobid);
+
+	/* PBS_QUEUE */
+	bld_env_variables(vtab, variables_else[4],
+		get_jattr_str(pjob, JOB_ATR_in_queue));
+
+	/* PBS_JOBCOOKIE */
+	bld_env_variables(vtab, variables_else[7],
+		get_jattr_str(pjob, JOB_ATR_Cookie));
+
+	/* PBS_NODENUM */
+	sprintf(buf, "%d", pjob->ji_nodeid);
+	bld_env_variables(vtab, variables_else[8], buf);
+
+	/* PBS_TASKNUM */
+	sprintf(buf, "%8.8X", ptask->ti_qs.ti_task);
+	bld_env_variables(vtab, variables_else[9], buf);
+
+	/* PBS_MOMPORT */
+	sprintf(buf, "%d", pbs_rm_port);
+	bld_env_variables(vtab, variables_else[10], buf);
+
+	/* OMP_NUM_THREADS and NCPUS eq to number of cpus */
+	sprintf(buf, "%d", pjob->ji_vnods[ptask->ti_qs.ti_myvnode].vn_threads);
+#ifdef NAS /* localmod 020 */
+	/* Force OMP_NUM_THREADS=1 on Columbia.
+	 * If you've ever seen a 256 process MPI program try to start 256
+	 * threads for each process, you'd know why.
+	 */
+	bld_env_variables(vtab, variables_else[12], "1");
+#else
+	bld_env_variables(vtab, variables_else[12], buf);
+#endif /* localmod 020 */
+	bld_env_variables(vtab, "NCPUS", buf);
+
+	/* PBS_ACCOUNT */
+	if (is_jattr_set(pjob, JOB_ATR_account))
+		bld_env_variables(vtab, variables_else[13],
+			get_jattr_str(pjob, JOB_ATR_account));
+
+	/* set Environment to reflect batch */
+	bld_env_variables(vtab, "PBS_ENVIRONMENT", "PBS_BATCH");
+	bld_env_variables(vtab, "ENVIRONMENT", "BATCH");
+
+	for (i=0; envp[i]; i++)
+		bld_env_variables(vtab, envp[i], NULL);
+
+	/* Add TMPDIR to environment */
+#ifdef NAS /* localmod 010 */
+	(void) NAS_tmpdirname(pjob);
+#endif /* localmod 010 */
+	j = mktmpdir(pjob->ji_qs.ji_jobid,
+		pjob->ji_qs.ji_un.ji_momt.ji_exuid,
+		pjob->ji_qs.ji_un.ji_momt.ji_exgid,
+		vtab);
+	if (j != 0)
+		return j;
+
+	/* set PBS_JOBDIR */
+	if ((is_jattr_set(pjob, JOB_ATR_sandbox)) &&
+		(strcasecmp(get_jattr_str(pjob, JOB_ATR_sandbox), "PRIVATE") == 0)) {
+		bld_env_variables(vtab, "PBS_JOBDIR",
+			jobdirname(pjob->ji_qs.ji_jobid, pjob->ji_grpcache->gc_homedir));
+	} else {
+		bld_env_variables(vtab, "PBS_JOBDIR", pjob->ji_grpcache->gc_homedir);
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Return the umask a task of the job runs with.
+ *
+ * @param[in] pjob - job pointer
+ *
+ * @return	mode_t
+ *
+ */
+static mode_t
+job_umask(job *pjob)
+{
+	char	buf[32];
+	int	j;
 
-		execve(the_progname, the_argv, the_env);
-		free(progname);
-		free_attrlist(&argv_list);
-		free_str_array(the_argv);
-		the_argv = NULL;
-		free_str_array(hook_output.env);
-		free_str_array(the_env);
-		the_env = NULL;
-	} else if (cpid == 0) { /* child does demux */
-		char	*arg[2];
-		char	*shellname;
+	if (is_jattr_set(pjob, JOB_ATR_umask)) {
+		sprintf(buf, "%ld", get_jattr_long(pjob, JOB_ATR_umask));
+		sscanf(buf, "%o", &j);
+		return ((mode_t)j);
+	}
+	return (077);
+}
 
-		/* setup descriptors 3 and 4 */
-		(void)dup2(pjob->ji_stdout, 3);
-		if (pjob->ji_stdout > 3)
-			close(pjob->ji_stdout);
-		(void)dup2(pjob->ji_stderr, 4);
-		if (pjob->ji_stderr > 4)
-			close(pjob->ji_stderr);
+/**
+ * @brief
+ *	Record the result of starting a task in MoM.
+ *
+ * @param[in] ptask - pointer to task structure
+ * @param[in] progname - program the task runs, for the log
+ * @param[in] sjr - result returned by the task's starter
+ *
+ * @return	int
+ * @retval	PBSE_NONE	task is running
+ * @retval	PBSE_SYSTEM	task was not started
+ *
+ */
+static int
+task_started(task *ptask, char *progname, struct startjob_rtn *sjr)
+{
+	job	*pjob = ptask->ti_job;
 
-		/* construct argv array */
-		shell = pbs_conf.pbs_demux_path;
-		shellname = strrchr(shell, '/');
-		if (shellname)
-			++shellname;	/* go past last '/' */
-		else
-			shellname = shell;
-		arg[0] = shellname;
-		arg[1] = NULL;
+	/*
+	 ** Set the global id before exiting on error so any
+	 ** information can be put into the job struct first.
+	 */
+	set_globid(pjob, sjr);
+	if (sjr->sj_code < 0) {
+		(void)sprintf(log_buffer, "task not started, %s %s %d",
+			(sjr->sj_code==JOB_EXEC_RETRY)?
+			"Retry" : "Failure",
+			progname,
+			sjr->sj_code);
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB,
+			LOG_NOTICE, pjob->ji_qs.ji_jobid, log_buffer);
+		return PBSE_SYSTEM;
+	}
 
-		/* we're purposely not calling log_close() here */
-		/* for this causes a side-effect. log_close() would */
-		/* do an fclose(<logfile>), but its file position */
-		/* is still shared with the parent mom, which */
-		/* could be writing to the <logfile>. */
-		execve(shell, arg, pjob->ji_env.v_envp);
+	ptask->ti_qs.ti_sid = sjr->sj_session;
+	ptask->ti_qs.ti_status = TI_STATE_RUNNING;
+
+	(void)task_save(ptask);
+	if (!check_job_substate(pjob, JOB_SUBSTATE_RUNNING)) {
+		set_job_state(pjob, JOB_STATE_LTR_RUNNING);
+		set_job_substate(pjob, JOB_SUBSTATE_RUNNING);
+		job_save(pjob);
 	}
-	fprintf(temp_stderr, "pbs_mom, exec of %s failed with error: %s\n",
-		shell, strerror(errno));
-	exit(254);	/* should never, ever get here */
+	(void)sprintf(log_buffer, "task %8.8X started, %s",
+		ptask->ti_qs.ti_task, progname);
+	log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO,
+		pjob->ji_qs.ji_jobid, log_buffer);
+
+	return PBSE_NONE;
+}
+
+#if	!MOM_ALPS && !(defined(PBS_SECURITY) && (PBS_SECURITY == KRB5))
+/**
+ * @brief
+ *	Start a task through the $launcher helper instead of forking MoM.
+ *
+ * @par
+ *	The environment, TMPDIR, limits and standard out/err files are
+ *	prepared here in MoM; the helper forks the task, which only has to
+ *	set its session, limits and user, change directory and exec.
+ *	Tasks that need an execjob_launch hook, a stored credential or an
+ *	interactive pty still need the full MoM image and are not handled.
+ *
+ * @param[in] ptask - pointer to task structure
+ * @param[in] argv - argument list
+ * @param[in] envp - pointer to environment variable list
+ * @param[in] nodemux - false if the task process needs demux
+ * @param[in] ipaddr - address of Mother Superior, for the demux
+ *
+ * @return	int
+ * @retval	PBSE_NONE	task started
+ * @retval	PBSE_SYSTEM	task could not be started
+ * @retval	-1		not handled, fork the task from MoM
+ *
+ */
+static int
+start_process_launcher(task *ptask, char **argv, char **envp, bool nodemux,
+	u_long ipaddr)
+{
+	job			*pjob = ptask->ti_job;
+	struct launch_req	req;
+	struct var_table	vtab;
+	struct startjob_rtn	sjr;
+	int			fds[3] = {-1, -1, -1};
+	int			rc = -1;
+	int			j;
+	long			tag;
+
+	if (!launcher)
+		return -1;
+	if (num_eligible_hooks(HOOK_EVENT_EXECJOB_LAUNCH) > 0)
+		return -1;
+	if (pjob->ji_extended.ji_ext.ji_credtype != PBS_CREDTYPE_NONE)
+		return -1;
+	if ((pjob->ji_numnodes == 1) && is_jattr_set(pjob, JOB_ATR_interactive) &&
+		(get_jattr_long(pjob, JOB_ATR_interactive) > 0))
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	memset(&sjr, 0, sizeof(sjr));
+	if (task_env_init(pjob, envp, &vtab) == -1)
+		return PBSE_SYSTEM;
+	vtab.v_envp[0] = NULL;
+
+	if ((j = task_env_build(ptask, envp, &vtab)) != 0) {
+		sjr.sj_code = j;
+		rc = task_started(ptask, argv[0], &sjr);
+		goto done;
+	}
+	*(vtab.v_envp + vtab.v_used) = NULL;
+
+	if ((j = mom_get_limits(pjob, &req.lr_limits)) != PBSE_NONE) {
+		(void)sprintf(log_buffer, "Unable to set limits, err=%d", j);
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_WARNING,
+			pjob->ji_qs.ji_jobid, log_buffer);
+		sjr.sj_code = (j == PBSE_RESCUNAV) ? JOB_EXEC_RETRY : JOB_EXEC_FAIL2;
+		rc = task_started(ptask, argv[0], &sjr);
+		goto done;
+	}
+
+	/* If nodemux is not already set by the caller, check job's JOB_ATR_nodemux attribute. */
+	if (!nodemux && (is_jattr_set(pjob, JOB_ATR_nodemux)))
+		nodemux = get_jattr_long(pjob, JOB_ATR_nodemux);
+
+	if (pjob->ji_numnodes > 1) {
+		if (nodemux)
+			req.lr_stdio = LAUNCH_STDIO_NULL;
+		else {
+			req.lr_stdio = LAUNCH_STDIO_DEMUX;
+			req.lr_demux_addr = ipaddr;
+			req.lr_demux_out = pjob->ji_stdout;
+			req.lr_demux_err = pjob->ji_stderr;
+			req.lr_cookie = get_jattr_str(pjob, JOB_ATR_Cookie);
+		}
+	} else {
+		/* normal batch job, single node, write straight to files */
+		if (open_std_fds(pjob, &fds[1], &fds[2]) == -1) {
+			sjr.sj_code = JOB_EXEC_RETRY;
+			rc = task_started(ptask, argv[0], &sjr);
+			goto done;
+		}
+		req.lr_stdio = LAUNCH_STDIO_FDS;
+	}
+
+	req.lr_uid = pjob->ji_qs.ji_un.ji_momt.ji_exuid;
+	req.lr_gid = pjob->ji_qs.ji_un.ji_momt.ji_exgid;
+	if (pjob->ji_grpcache)
+		req.lr_rgid = pjob->ji_grpcache->gc_rgid;
+	else
+		req.lr_rgid = pjob->ji_qs.ji_un.ji_momt.ji_exgid;
+	req.lr_euser = get_jattr_str(pjob, JOB_ATR_euser);
+	req.lr_umask = job_umask(pjob);
+	if ((is_jattr_set(pjob, JOB_ATR_sandbox)) &&
+		(strcasecmp(get_jattr_str(pjob, JOB_ATR_sandbox), "PRIVATE") == 0))
+		req.lr_cwd = jobdirname(pjob->ji_qs.ji_jobid, pjob->ji_grpcache->gc_homedir);
+	else
+		req.lr_cwd = pjob->ji_grpcache->gc_homedir;
+	req.lr_argv = argv;
+	req.lr_envp = vtab.v_envp;
+
+	/* the caller needs the result, as it does when forking from MoM */
+	if ((tag = launcher_spawn(&req, fds, ptask, NULL)) == -1)
+		goto done;	/* rc is -1, fork from MoM */
+	if ((launcher_wait(tag, &sjr) == -1) || (sjr.sj_session == -1))
+		goto done;	/* no process was made, fork from MoM */
+
+	rc = task_started(ptask, argv[0], &sjr);
+
+done:
+	if (fds[1] != -1)
+		(void)close(fds[1]);
+	if (fds[2] != -1)
+		(void)close(fds[2]);
+	for (j = 0; j < vtab.v_used; j++)
+		free(vtab.v_envp[j]);
+	free(vtab.v_envp);
+	return rc;
 }
+#endif	/* !MOM_ALPS && !KRB5 */
 
 /**
  * @brief
@@ -4575,15 +5291,12 @@ int
 start_process(task *ptask, char **argv, char **envp, bool nodemux)
 {
 	job	*pjob = ptask->ti_job;
-	int	ebsize;
-	char	buf[MAXPATHLEN+2];
 	pid_t	pid;
 	int	pipes[2], kid_read, kid_write, parent_read, parent_write;
 	int	pts;
 	int	i, j, k;
 	int	fd;
 	u_long	ipaddr;
-	struct	array_strings	*vstrs;
 	struct  startjob_rtn sjr;
 	char	*pbs_jobdir; /* staging and execution directory of this job */
 	int			hook_errcode = 0;
@@ -4605,26 +5318,6 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 
 	pbs_jobdir = jobdirname(pjob->ji_qs.ji_jobid, pjob->ji_grpcache->gc_homedir);
 	memset(&sjr, 0, sizeof(sjr));
-	if (pipe(pipes) == -1)
-		return PBSE_SYSTEM;
-	if (pipes[1] < 3) {
-		kid_write = fcntl(pipes[1], F_DUPFD, 3);
-		(void)close(pipes[1]);
-	} else
-		kid_write = pipes[1];
-	parent_read = pipes[0];
-
-	if (pipe(pipes) == -1) {
-		close(kid_write);
-		close(parent_read);
-		return PBSE_SYSTEM;
-	}
-	if (pipes[0] < 3) {
-		kid_read = fcntl(pipes[0], F_DUPFD, 3);
-		(void)close(pipes[0]);
-	} else
-		kid_read = pipes[0];
-	parent_write = pipes[1];
 
 	/*
 	 ** Get ipaddr to Mother Superior.
@@ -4646,6 +5339,32 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 		ipaddr = ap->sin_addr.s_addr;
 	}
 
+#if	!MOM_ALPS && !(defined(PBS_SECURITY) && (PBS_SECURITY == KRB5))
+	if ((i = start_process_launcher(ptask, argv, envp, nodemux, ipaddr)) != -1)
+		return i;
+#endif
+
+	if (pipe(pipes) == -1)
+		return PBSE_SYSTEM;
+	if (pipes[1] < 3) {
+		kid_write = fcntl(pipes[1], F_DUPFD, 3);
+		(void)close(pipes[1]);
+	} else
+		kid_write = pipes[1];
+	parent_read = pipes[0];
+
+	if (pipe(pipes) == -1) {
+		close(kid_write);
+		close(parent_read);
+		return PBSE_SYSTEM;
+	}
+	if (pipes[0] < 3) {
+		kid_read = fcntl(pipes[0], F_DUPFD, 3);
+		(void)close(pipes[0]);
+	} else
+		kid_read = pipes[0];
+	parent_write = pipes[1];
+
 	/*
 	 ** Begin a new process for the fledgling task.
 	 */
@@ -4672,37 +5391,7 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 		DBPRT(("%s: read start return %d %d\n", __func__,
 			sjr.sj_code, sjr.sj_session))
 
-		/*
-		 ** Set the global id before exiting on error so any
-		 ** information can be put into the job struct first.
-		 */
-		set_globid(pjob, &sjr);
-		if (sjr.sj_code < 0) {
-			(void)sprintf(log_buffer, "task not started, %s %s %d",
-				(sjr.sj_code==JOB_EXEC_RETRY)?
-				"Retry" : "Failure",
-				argv[0],
-				sjr.sj_code);
-			log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB,
-				LOG_NOTICE, pjob->ji_qs.ji_jobid, log_buffer);
-			return PBSE_SYSTEM;
-		}
-
-		ptask->ti_qs.ti_sid = sjr.sj_session;
-		ptask->ti_qs.ti_status = TI_STATE_RUNNING;
-
-		(void)task_save(ptask);
-		if (!check_job_substate(pjob, JOB_SUBSTATE_RUNNING)) {
-			set_job_state(pjob, JOB_STATE_LTR_RUNNING);
-			set_job_substate(pjob, JOB_SUBSTATE_RUNNING);
-			job_save(pjob);
-		}
-		(void)sprintf(log_buffer, "task %8.8X started, %s",
-			ptask->ti_qs.ti_task, argv[0]);
-		log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO,
-			pjob->ji_qs.ji_jobid, log_buffer);
-
-		return PBSE_NONE;
+		return (task_started(ptask, argv[0], &sjr));
 	}
 
 	/************************************************/
@@ -4718,16 +5407,8 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 	 * set up the Environmental Variables to be given to the job
 	 */
 
-	for (j=0, ebsize=0; envp[j]; j++)
-		ebsize += strlen(envp[j]);
-	vstrs = get_jattr_arst(pjob, JOB_ATR_variables);
-	pjob->ji_env.v_ensize = vstrs->as_usedptr + num_var_else + num_var_env +
-		j + EXTRA_ENV_PTRS;
-	pjob->ji_env.v_used   = 0;
-	pjob->ji_env.v_envp = (char **)malloc(pjob->ji_env.v_ensize * sizeof(char *));
-	if (pjob->ji_env.v_envp == NULL) {
+	if (task_env_init(pjob, envp, &pjob->ji_env) == -1)
 		return PBSE_SYSTEM;
-	}
 
 #if defined(PBS_SECURITY) && (PBS_SECURITY == KRB5)
 	if (ptask->ti_job->ji_tasks.ll_prior == ptask->ti_job->ji_tasks.ll_next) {/* create only on first task */
@@ -4752,102 +5433,14 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 #endif
 #endif
 
-	/* First variables from the local environment */
-	for (j = 0; j < num_var_env; ++j)
-		bld_env_variables(&(pjob->ji_env), environ[j], NULL);
-
-	/* Next, the variables passed with the job.  They may   */
-	/* be overwritten with new correct values for this job	*/
-
-	for (j = 0; j < vstrs->as_usedptr; ++j)
-		bld_env_variables(&(pjob->ji_env), vstrs->as_string[j], NULL);
-
-	/* HOME */
-	bld_env_variables(&(pjob->ji_env), variables_else[0],
-		pjob->ji_grpcache->gc_homedir);
-
-	/* PBS_JOBNAME */
-	bld_env_variables(&(pjob->ji_env), variables_else[2],
-		get_jattr_str(pjob, JOB_ATR_jobname));
-
-	/* PBS_JOBID */
-	bld_env_variables(&(pjob->ji_env), variables_else[3], pjob->ji_qs.ji_jobid);
-
-	/* PBS_QUEUE */
-	bld_env_variables(&(pjob->ji_env), variables_else[4],
-		get_jattr_str(pjob, JOB_ATR_in_queue));
-
-	/* PBS_JOBCOOKIE */
-	bld_env_variables(&(pjob->ji_env), variables_else[7],
-		get_jattr_str(pjob, JOB_ATR_Cookie));
-
-	/* PBS_NODENUM */
-	sprintf(buf, "%d", pjob->ji_nodeid);
-	bld_env_variables(&(pjob->ji_env), variables_else[8], buf);
-
-	/* PBS_TASKNUM */
-	sprintf(buf, "%8.8X", ptask->ti_qs.ti_task);
-	bld_env_variables(&(pjob->ji_env), variables_else[9], buf);
-
-	/* PBS_MOMPORT */
-	sprintf(buf, "%d", pbs_rm_port);
-	bld_env_variables(&(pjob->ji_env), variables_else[10], buf);
-
-	/* OMP_NUM_THREADS and NCPUS eq to number of cpus */
-	sprintf(buf, "%d", pjob->ji_vnods[ptask->ti_qs.ti_myvnode].vn_threads);
-#ifdef NAS /* localmod 020 */
-	/* Force OMP_NUM_THREADS=1 on Columbia.
-	 * If you've ever seen a 256 process MPI program try to start 256
-	 * threads for each process, you'd know why.
-	 */
-	bld_env_variables(&(pjob->ji_env), variables_else[12], "1");
-#else
-	bld_env_variables(&(pjob->ji_env), variables_else[12], buf);
-#endif /* localmod 020 */
-	bld_env_variables(&(pjob->ji_env), "NCPUS", buf);
-
-	/* PBS_ACCOUNT */
-	if (is_jattr_set(pjob, JOB_ATR_account))
-		bld_env_variables(&(pjob->ji_env), variables_else[13],
-			get_jattr_str(pjob, JOB_ATR_account));
-
-	if (is_jattr_set(pjob, JOB_ATR_umask)) {
-		sprintf(buf, "%ld", get_jattr_long(pjob, JOB_ATR_umask));
-		sscanf(buf, "%o", &j);
-		umask(j);
-	} else {
-		umask(077);
-	}
-
+	umask(job_umask(pjob));
 	mom_unnice();
 
-	/* set Environment to reflect batch */
-	bld_env_variables(&(pjob->ji_env), "PBS_ENVIRONMENT", "PBS_BATCH");
-	bld_env_variables(&(pjob->ji_env), "ENVIRONMENT", "BATCH");
-
-	for (i=0; envp[i]; i++)
-		bld_env_variables(&(pjob->ji_env), envp[i], NULL);
-
-	/* Add TMPDIR to environment */
-#ifdef NAS /* localmod 010 */
-	(void) NAS_tmpdirname(pjob);
-#endif /* localmod 010 */
-	j = mktmpdir(pjob->ji_qs.ji_jobid,
-		pjob->ji_qs.ji_un.ji_momt.ji_exuid,
-		pjob->ji_qs.ji_un.ji_momt.ji_exgid,
-		&(pjob->ji_env));
+	j = task_env_build(ptask, envp, &pjob->ji_env);
 	if (j != 0) {
 		starter_return(kid_write, kid_read, j, &sjr);
 	}
 
-	/* set PBS_JOBDIR */
-	if ((is_jattr_set(pjob, JOB_ATR_sandbox)) &&
-		(strcasecmp(get_jattr_str(pjob, JOB_ATR_sandbox), "PRIVATE") == 0)) {
-		bld_env_variables(&(pjob->ji_env), "PBS_JOBDIR", pbs_jobdir);
-	} else {
-		bld_env_variables(&(pjob->ji_env), "PBS_JOBDIR", pjob->ji_grpcache->gc_homedir);
-	}
-
 	j = set_job(pjob, &sjr);
 	if (j < 0) {
 		if (j == -1) {
@@ -5138,6 +5731,8 @@ nodes_free(job *pj)
 	int		 i;
 	vmpiprocs       *vp;
 
+	fanout_free(pj);
+
 	if (pj->ji_vnods) {
 		vp = pj->ji_vnods;
 		for (i = 0; i < pj->ji_numvnod; i++, vp++) {
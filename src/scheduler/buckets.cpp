@@ -57,6 +57,7 @@
 #include "check.h"
 #include <log.h>
 #include "pbs_internal.h"
+#include "sched_prof.h"
 
 /* bucket_bitpool constructor */
 bucket_bitpool *
@@ -399,6 +400,7 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 	node_bucket **buckets = NULL;
 	node_bucket **tmp;
 	int node_ct;
+	sched_prof_timer prof(PROF_BUCKETS);
 
 	if (policy == NULL || nodes == NULL)
 		return NULL;
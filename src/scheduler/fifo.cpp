@@ -96,6 +96,7 @@
 #include "multi_threading.h"
 #include "pbs_python.h"
 #include "libpbs.h"
+#include "sched_prof.h"
 
 #ifdef NAS
 #include "site_code.h"
@@ -544,7 +545,9 @@ intermediate_schedule(int sd, const sched_cmd *cmd)
 	int cycle_cnt = 0; /* count of cycles run */
 
 	do {
+		sched_prof_cycle_start();
 		ret = scheduling_cycle(sd, cmd);
+		sched_prof_cycle_end(sd);
 
 		/* don't restart cycle if :- */
 
@@ -594,6 +597,7 @@ scheduling_cycle(int sd, const sched_cmd *cmd)
 	int error = 0;			/* error happened, don't run main loop */
 	status *policy;			/* policy structure used for cycle */
 	schd_error *err = NULL;
+	sched_prof_timer cycle_prof(PROF_CYCLE);
 
 	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST, LOG_DEBUG,
 		  "", "Starting Scheduling Cycle");
@@ -611,7 +615,10 @@ scheduling_cycle(int sd, const sched_cmd *cmd)
 	do_hard_cycle_interrupt = 0;
 #endif /* localmod 030 */
 	/* create the server / queue / job / node structures */
-	if ((sinfo = query_server(&cstat, sd)) == NULL) {
+	sched_prof_timer query_prof(PROF_QUERY);
+	sinfo = query_server(&cstat, sd);
+	query_prof.stop();
+	if (sinfo == NULL) {
 		log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_NOTICE,
 			  "", "Problem with creating server data structure");
 		end_cycle_tasks(sinfo);
@@ -880,15 +887,22 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 		log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_DEBUG,
 			njob->name, "Considering job to run");
 
+		sched_prof_count(PROF_CONSIDERED);
+		if (sinfo->equiv_classes != NULL && njob->ec_index != UNSPECIFIED &&
+			sinfo->equiv_classes[njob->ec_index]->can_not_run)
+			sched_prof_count(PROF_EQUIV_SKIPPED);
+
 		should_use_buckets = job_should_use_buckets(njob);
 		if(should_use_buckets)
 			flags = USE_BUCKETS;
 
+		sched_prof_timer ok_prof(PROF_IS_OK_TO_RUN);
 		if (njob->is_shrink_to_fit) {
 			/* Pass the suitable heuristic for shrinking */
 			ns_arr = is_ok_to_run_STF(policy, sinfo, qinfo, njob, flags, err, shrink_job_algorithm);
 		} else
 			ns_arr = is_ok_to_run(policy, sinfo, qinfo, njob, flags, err);
+		ok_prof.stop();
 
 		if (err->status_code == NEVER_RUN)
 			njob->can_never_run = 1;
@@ -922,6 +936,8 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				free_nspecs(ns_arr);
 		}
 		else if (policy->preempting && in_runnable_state(njob) && (!njob -> can_never_run)) {
+			sched_prof_timer preempt_prof(PROF_PREEMPT);
+
 			if (find_and_preempt_jobs(policy, sd, njob, sinfo, err) > 0) {
 				rc = SUCCESS;
 				sort_again = MUST_RESORT_JOBS;
@@ -939,6 +955,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 		}
 #endif /* localmod 034 */
 
+		if (rc == SUCCESS)
+			sched_prof_count(PROF_RUN);
+
 		/* if run_update_resresv() returns an error, it's generally pretty serious.
 		 * lets bail out of the cycle now
 		 */
@@ -954,7 +973,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 #else
 			if (should_backfill_with_job(policy, sinfo, njob, num_topjobs) != 0) {
 #endif
+				sched_prof_timer cal_prof(PROF_CALENDAR);
 				cal_rc = add_job_to_calendar(sd, policy, sinfo, njob, should_use_buckets);
+				cal_prof.stop();
 
 				if (cal_rc > 0) { /* Success! */
 #ifdef NAS /* localmod 034 */
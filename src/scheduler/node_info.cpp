@@ -46,6 +46,7 @@
  *
  * Functions included are:
  * 	query_nodes()
+ * 	stat_nodes_cached()
  * 	query_node_info()
  * 	free_nodes()
  * 	set_node_info_state()
@@ -112,7 +113,10 @@
  *
  */
 
+#include <algorithm>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <pbs_config.h>
 
@@ -127,6 +131,7 @@
 #include <errno.h>
 #include <time.h>
 #include <pbs_ifl.h>
+#include <libpbs.h>
 #include <log.h>
 #include <grunt.h>
 #include <libutil.h>
@@ -240,6 +245,164 @@ alloc_tdata_nd_query(struct batch_status *nodes, server_info *sinfo, int sidx, i
 	return tdata;
 }
 
+/*
+ * Copy of the vnode status kept between cycles.  With a single server the
+ * scheduler asks only for the vnodes that changed since the last reply
+ * (see EXTEND_OPT_STAT_SINCE) and merges them in here.  nodes holds one
+ * individually allocated batch_status per vnode, in server order and linked
+ * through their next pointers.  With several servers every cycle is a full
+ * listing, held in whole until the next query.
+ */
+static struct {
+	std::string since;
+	std::vector<struct batch_status *> nodes;
+	std::unordered_map<std::string, size_t> idx;
+	struct batch_status *whole;
+} node_stat_cache;
+
+/**
+ * @brief	free one batch_status taken out of a status list
+ *
+ * @param[in]	bs	-	batch_status to free
+ *
+ * @return void
+ */
+static void
+free_one_bstat(struct batch_status *bs)
+{
+	bs->next = NULL;
+	pbs_statfree(bs);
+}
+
+/**
+ * @brief	drop every vnode held in the node status cache
+ *
+ * @return void
+ */
+static void
+node_stat_cache_clear()
+{
+	for (auto bs : node_stat_cache.nodes)
+		free_one_bstat(bs);
+	node_stat_cache.nodes.clear();
+	node_stat_cache.idx.clear();
+	node_stat_cache.since.clear();
+}
+
+/**
+ * @brief	merge a conditional vnode status reply into the node status
+ *		cache.  Deleted vnodes are dropped first, then changed vnodes
+ *		replace their old copy or are appended.
+ *
+ * @param[in]	reply	-	reply to merge, consumed
+ *
+ * @return void
+ */
+static void
+node_stat_cache_merge(struct batch_status *reply)
+{
+	struct batch_status *bs;
+	struct batch_status *next;
+	struct attrl *attrp;
+	bool removed = false;
+
+	if (reply->name == NULL || reply->name[0] != '\0') {
+		/* a server that does not know the since= option; a full listing */
+		node_stat_cache_clear();
+		for (bs = reply; bs != NULL; bs = bs->next)
+			node_stat_cache.nodes.push_back(bs);
+		reply = NULL;
+	} else {
+		for (attrp = reply->attribs; attrp != NULL; attrp = attrp->next) {
+			if (!strcmp(attrp->name, STAT_SINCE_FULL) && !strcmp(attrp->value, "1")) {
+				node_stat_cache_clear();
+				break;
+			}
+		}
+		for (attrp = reply->attribs; attrp != NULL; attrp = attrp->next) {
+			if (!strcmp(attrp->name, STAT_SINCE_TOKEN))
+				node_stat_cache.since = attrp->value;
+			else if (!strcmp(attrp->name, STAT_SINCE_DELETED)) {
+				auto it = node_stat_cache.idx.find(attrp->value);
+				if (it != node_stat_cache.idx.end()) {
+					free_one_bstat(node_stat_cache.nodes[it->second]);
+					node_stat_cache.nodes[it->second] = NULL;
+					node_stat_cache.idx.erase(it);
+					removed = true;
+				}
+			}
+		}
+		bs = reply->next;
+		free_one_bstat(reply);
+		reply = bs;
+	}
+
+	for (bs = reply; bs != NULL; bs = next) {
+		next = bs->next;
+		bs->next = NULL;
+		auto it = node_stat_cache.idx.find(bs->name);
+		if (it != node_stat_cache.idx.end()) {
+			free_one_bstat(node_stat_cache.nodes[it->second]);
+			node_stat_cache.nodes[it->second] = bs;
+		} else {
+			node_stat_cache.idx[bs->name] = node_stat_cache.nodes.size();
+			node_stat_cache.nodes.push_back(bs);
+		}
+	}
+
+	if (removed) {
+		node_stat_cache.nodes.erase(std::remove(node_stat_cache.nodes.begin(),
+			node_stat_cache.nodes.end(), nullptr), node_stat_cache.nodes.end());
+		node_stat_cache.idx.clear();
+	}
+	if (node_stat_cache.idx.size() != node_stat_cache.nodes.size()) {
+		node_stat_cache.idx.clear();
+		for (size_t i = 0; i < node_stat_cache.nodes.size(); i++)
+			node_stat_cache.idx[node_stat_cache.nodes[i]->name] = i;
+	}
+
+	for (size_t i = 0; i < node_stat_cache.nodes.size(); i++)
+		node_stat_cache.nodes[i]->next = (i + 1 < node_stat_cache.nodes.size()) ? node_stat_cache.nodes[i + 1] : NULL;
+}
+
+/**
+ * @brief	get the status of all vnodes, using the node status cache
+ *
+ * @param[in]	pbs_sd	-	communication descriptor with the pbs server
+ * @param[in]	attrib	-	attributes to query
+ *
+ * @return	struct batch_status *
+ * @retval	list of vnodes, owned by the cache and valid until the next call
+ * @retval	NULL on error
+ */
+static struct batch_status *
+stat_nodes_cached(int pbs_sd, struct attrl *attrib)
+{
+	struct batch_status *reply;
+
+	if (node_stat_cache.whole != NULL) {
+		pbs_statfree(node_stat_cache.whole);
+		node_stat_cache.whole = NULL;
+	}
+
+	if (get_num_servers() > 1) {
+		node_stat_cache_clear();
+		node_stat_cache.whole = send_statvnode(pbs_sd, NULL, attrib, NULL);
+		return node_stat_cache.whole;
+	}
+
+	if ((reply = send_statvnode_since(pbs_sd, attrib, node_stat_cache.since.c_str())) == NULL) {
+		/* start over with a full listing */
+		node_stat_cache_clear();
+		return NULL;
+	}
+	node_stat_cache_merge(reply);
+
+	if (node_stat_cache.nodes.empty())
+		return NULL;
+	return node_stat_cache.nodes[0];
+}
+
 /**
  * @brief
  *      query_nodes - query all the nodes associated with a server
@@ -312,7 +475,7 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	}
 
 	/* get nodes from PBS server */
-	if ((nodes = send_statvnode(pbs_sd, NULL, attrib, NULL)) == NULL) {
+	if ((nodes = stat_nodes_cached(pbs_sd, attrib)) == NULL) {
 		err = pbs_geterrmsg(pbs_sd);
 		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO, "", "Error getting nodes: %s", err);
 		return NULL;
@@ -329,7 +492,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
 		tdata = alloc_tdata_nd_query(nodes, sinfo, 0, num_nodes - 1);
 		if (tdata == NULL) {
-			pbs_statfree(nodes);
 			return NULL;
 		}
 		query_node_info_chunk(tdata);
@@ -343,7 +505,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	} else {
 		if ((ninfo_arr = static_cast<node_info **>(malloc((num_nodes + 1) * sizeof(node_info *)))) == NULL) {
 			log_err(errno, __func__, MEM_ERR_MSG);
-			pbs_statfree(nodes);
 			return NULL;
 		}
 		ninfo_arr[0] = NULL;
@@ -392,7 +553,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 			pthread_mutex_unlock(&result_lock);
 		}
 		if (th_err) {
-			pbs_statfree(nodes);
 			free_nodes(ninfo_arr);
 			return NULL;
 		}
@@ -415,7 +575,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	if (nidx == 0) {
 		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SERVER, LOG_INFO, __func__,
 			"No nodes found in partitions serviced by scheduler");
-		pbs_statfree(nodes);
 		free(ninfo_arr);
 		return NULL;
 	}
@@ -425,7 +584,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 #endif /* localmod 062 */
 	resolve_indirect_resources(ninfo_arr);
 	sinfo->num_nodes = nidx;
-	pbs_statfree(nodes);
 	return ninfo_arr;
 }
 
@@ -615,6 +615,8 @@ int add_node_events(timed_event *te, void *arg1, void *arg2);
 
 struct batch_status *send_statvnode(int virtual_fd, char *id, struct attrl *attrib, char *extend);
 
+struct batch_status *send_statvnode_since(int virtual_fd, struct attrl *attrib, const char *since);
+
 /*
  * Find a node by its hostname
  */
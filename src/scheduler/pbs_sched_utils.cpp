@@ -1085,6 +1085,7 @@ sched_main(int argc, char *argv[], schedule_func sched_ptr)
 	} else {
 		(void) sprintf(path_log, "%s/sched_logs_%s", pbs_conf.pbs_home_path, sc_name);
 	}
+	log_struct_enable(pbs_conf.pbs_log_structured);
 	if (log_open(logfile, path_log) == -1) {
 		fprintf(stderr, "%s: logfile could not be opened\n", argv[0]);
 		exit(1);
@@ -1233,6 +1234,8 @@ sched_main(int argc, char *argv[], schedule_func sched_ptr)
 	setvbuf(stdout, NULL, _IOLBF, 0);
 	setvbuf(stderr, NULL, _IOLBF, 0);
 #endif
+
+	(void)log_async_start(pbs_conf.pbs_log_async);
 	pid = getpid();
 	daemon_protect(0, PBS_DAEMON_PROTECT_ON);
 	freopen("/dev/null", "r", stdin);
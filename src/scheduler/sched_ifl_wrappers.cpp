@@ -49,6 +49,7 @@
 #include "misc.h"
 #include "log.h"
 #include "server_info.h"
+#include "sched_prof.h"
 
 
 /**
@@ -91,6 +92,7 @@ int
 send_run_job(int virtual_sd, int has_runjob_hook, const std::string& jobid, char *execvnode, char *svr_id_job)
 {
  	int job_owner_sd;
+	sched_prof_timer prof(PROF_RUN_JOB);
 
 	if (jobid.empty() || execvnode == NULL)
 		return 1;
@@ -257,8 +259,12 @@ struct batch_status *
 send_selstat(int virtual_fd, struct attropl *attrib, struct attrl *rattrib, char *extend)
 {
 	struct batch_status *ret = NULL;
+	int arena;
 
+	/* the job list is only read, decode it into an arena */
+	arena = pbs_stat_arena(1);
 	ret = pbs_selstat(virtual_fd, attrib, rattrib, extend);
+	pbs_stat_arena(arena);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
@@ -283,8 +289,45 @@ struct batch_status *
 send_statvnode(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
 	struct batch_status *ret = NULL;
+	int arena;
 
+	/* the node list is only read, decode it into an arena */
+	arena = pbs_stat_arena(1);
 	ret = pbs_statvnode(virtual_fd, id, attrib, extend);
+	pbs_stat_arena(arena);
+	if (handle_part_tolerance(ret) == NULL) {
+		pbs_statfree(ret);
+		return NULL;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief	Wrapper for a conditional pbs_statvnode of all vnodes
+ *
+ * @param[in] c - communication handle
+ * @param[in] attrib - pointer to attribute list
+ * @param[in] since - token from the previous reply, "" for a full listing
+ *
+ * @return	struct batch_status *
+ * @retval	header object followed by the vnodes changed since the token
+ * @retval	NULL for error
+ *
+ * @note	The reply is not decoded into an arena since the caller keeps
+ *		and frees the vnodes individually.
+ */
+struct batch_status *
+send_statvnode_since(int virtual_fd, struct attrl *attrib, const char *since)
+{
+	struct batch_status *ret = NULL;
+	std::string extend(EXTEND_OPT_STAT_SINCE);
+	int arena;
+
+	extend += since;
+	arena = pbs_stat_arena(0);
+	ret = pbs_statvnode(virtual_fd, NULL, attrib, const_cast<char *>(extend.c_str()));
+	pbs_stat_arena(arena);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
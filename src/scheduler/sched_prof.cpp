@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    sched_prof.cpp
+ *
+ * @brief
+ * 	Times the phases of a scheduling cycle and counts the jobs it
+ * 	considers, skips and runs.  Each cycle is logged as one summary
+ * 	record, and the last SCHED_PROF_WINDOW cycles are published as
+ * 	log2 histograms in the cycle_profile attribute of the sched
+ * 	object.  If PBS_SCHED_PROF_TRACE names a file, every timed phase
+ * 	is also appended to it in Chrome trace event format.
+ */
+
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pbs_ifl.h>
+#include <log.h>
+#include "pbs_internal.h"
+#include "data_types.h"
+#include "constant.h"
+#include "globals.h"
+#include "sched_prof.h"
+
+#define SCHED_PROF_PUBLISH_PERIOD	60	/* min seconds between updates of the sched object */
+
+static const char *prof_phase_name[PROF_NPHASES] = {
+	"cycle", "query", "query_server", "query_nodes", "query_jobs",
+	"query_resvs", "sort", "buckets", "dup", "is_ok_to_run",
+	"calendar", "preempt", "run_job"
+};
+
+static const char *prof_count_name[PROF_NCOUNTS] = {
+	"jobs_considered", "equiv_skipped", "jobs_run"
+};
+
+struct prof_cycle {
+	unsigned long long us[PROF_NPHASES];
+	unsigned long calls[PROF_NPHASES];
+	unsigned long count[PROF_NCOUNTS];
+};
+
+static struct prof_cycle prof_cur;			/* the cycle in progress */
+static struct prof_cycle prof_ring[SCHED_PROF_WINDOW];	/* the last finished cycles */
+static int prof_ring_next;
+static int prof_ring_used;
+static bool prof_active;
+static time_t prof_last_publish;
+static FILE *prof_trace;
+static bool prof_trace_failed;
+
+/**
+ * @brief
+ * 	Returns the monotonic clock in microseconds.
+ */
+static unsigned long long
+prof_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/**
+ * @brief
+ * 	Opens the Chrome trace file named by PBS_SCHED_PROF_TRACE, if any,
+ * 	starting the JSON array when the file is new.  The array is left
+ * 	open, which the trace viewers accept, so cycles can be appended.
+ *
+ * @return void
+ */
+static void
+prof_trace_open(void)
+{
+	char *path;
+	struct stat sb;
+
+	if (prof_trace != NULL || prof_trace_failed)
+		return;
+	if ((path = getenv(SCHED_PROF_TRACE_ENV)) == NULL || *path == '\0') {
+		prof_trace_failed = true;
+		return;
+	}
+	if ((prof_trace = fopen(path, "a")) == NULL) {
+		log_errf(errno, __func__, "could not open trace file %s", path);
+		prof_trace_failed = true;
+		return;
+	}
+	if (fstat(fileno(prof_trace), &sb) == 0 && sb.st_size == 0)
+		fputs("[\n", prof_trace);
+}
+
+/**
+ * @brief
+ * 	Constructor - starts timing phase 'p'
+ *
+ * @param[in]	p	-	the phase to time
+ */
+sched_prof_timer::sched_prof_timer(enum sched_prof_phase p) : phase(p), running(prof_active)
+{
+	if (running)
+		start_us = prof_now_us();
+	else
+		start_us = 0;
+}
+
+/**
+ * @brief
+ * 	Destructor - stops the timer if it is still running
+ */
+sched_prof_timer::~sched_prof_timer()
+{
+	stop();
+}
+
+/**
+ * @brief
+ * 	Stops timing and adds the elapsed time to the phase of the current
+ * 	cycle.  Calling it again does nothing.
+ *
+ * @return void
+ */
+void
+sched_prof_timer::stop()
+{
+	unsigned long long dur;
+
+	if (!running)
+		return;
+	running = false;
+	if (!prof_active)
+		return;
+
+	dur = prof_now_us() - start_us;
+	prof_cur.us[phase] += dur;
+	prof_cur.calls[phase]++;
+	if (prof_trace != NULL)
+		fprintf(prof_trace,
+			"{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":1},\n",
+			prof_phase_name[phase], start_us, dur, (int) getpid());
+}
+
+/**
+ * @brief
+ * 	Stops timing the current phase and starts timing phase 'p'
+ *
+ * @param[in]	p	-	the next phase
+ *
+ * @return void
+ */
+void
+sched_prof_timer::next(enum sched_prof_phase p)
+{
+	stop();
+	phase = p;
+	running = prof_active;
+	if (running)
+		start_us = prof_now_us();
+}
+
+/**
+ * @brief
+ * 	Count an event of the current cycle
+ *
+ * @param[in]	c	-	what to count
+ *
+ * @return void
+ */
+void
+sched_prof_count(enum sched_prof_counter c)
+{
+	if (prof_active)
+		prof_cur.count[c]++;
+}
+
+/**
+ * @brief
+ * 	Start profiling a scheduling cycle
+ *
+ * @return void
+ */
+void
+sched_prof_cycle_start(void)
+{
+	memset(&prof_cur, 0, sizeof(prof_cur));
+	prof_trace_open();
+	prof_active = true;
+}
+
+/**
+ * @brief
+ * 	Set the cycle_profile attribute of our sched object
+ *
+ * @param[in]	pbs_sd	-	primary socket descriptor to the server pool
+ *
+ * @return void
+ */
+static void
+prof_publish(int pbs_sd)
+{
+	struct attropl attr = {0};
+	char *value;
+
+	if ((value = sched_prof_as_string()) == NULL)
+		return;
+
+	attr.name = const_cast<char *>(ATTR_sched_cycle_profile);
+	attr.value = value;
+	attr.op = SET;
+	if (pbs_manager(pbs_sd, MGR_CMD_SET, MGR_OBJ_SCHED,
+		const_cast<char *>(sc_name), &attr, NULL) != 0)
+		log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"Failed to update %s at the server", ATTR_sched_cycle_profile);
+	free(value);
+}
+
+/**
+ * @brief
+ * 	Finish profiling a scheduling cycle: log its summary, add it to the
+ * 	histograms, and publish them if SCHED_PROF_PUBLISH_PERIOD has passed.
+ *
+ * @param[in]	pbs_sd	-	primary socket descriptor to the server pool
+ *
+ * @return void
+ */
+void
+sched_prof_cycle_end(int pbs_sd)
+{
+	char buf[MAX_LOG_SIZE];
+	int len = 0;
+	int i;
+	time_t now;
+
+	if (!prof_active)
+		return;
+	prof_active = false;
+
+	for (i = 0; i < PROF_NPHASES && len < (int) sizeof(buf); i++) {
+		if (prof_cur.calls[i] == 0)
+			continue;
+		len += snprintf(buf + len, sizeof(buf) - len, "%s=%lluus/%lu ",
+			prof_phase_name[i], prof_cur.us[i], prof_cur.calls[i]);
+	}
+	for (i = 0; i < PROF_NCOUNTS && len < (int) sizeof(buf); i++)
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s=%lu",
+			i == 0 ? "" : " ", prof_count_name[i], prof_cur.count[i]);
+	log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SCHED, LOG_DEBUG, "cycle_profile", "%s", buf);
+
+	prof_ring[prof_ring_next] = prof_cur;
+	prof_ring_next = (prof_ring_next + 1) % SCHED_PROF_WINDOW;
+	if (prof_ring_used < SCHED_PROF_WINDOW)
+		prof_ring_used++;
+
+	if (prof_trace != NULL) {
+		fprintf(prof_trace,
+			"{\"name\":\"jobs\",\"ph\":\"C\",\"ts\":%llu,\"pid\":%d,"
+			"\"args\":{\"considered\":%lu,\"equiv_skipped\":%lu,\"run\":%lu}},\n",
+			prof_now_us(), (int) getpid(), prof_cur.count[PROF_CONSIDERED],
+			prof_cur.count[PROF_EQUIV_SKIPPED], prof_cur.count[PROF_RUN]);
+		fflush(prof_trace);
+	}
+
+	now = time(NULL);
+	if (got_sigpipe || now - prof_last_publish < SCHED_PROF_PUBLISH_PERIOD)
+		return;
+	prof_last_publish = now;
+	prof_publish(pbs_sd);
+}
+
+/**
+ * @brief
+ * 	Returns the profile of the last SCHED_PROF_WINDOW cycles in
+ * 	printable form, as in:
+ * 	  cycles=100 jobs_considered=5210 equiv_skipped=4800 jobs_run=37
+ * 	  cycle_us=(sum=912345 max=40211 le8192=61 le16384=30 ...) query_us=(...) ...
+ * 	where the counts are totals over the window and each leN=count is a
+ * 	histogram bucket of per-cycle phase times up to N usecs.
+ *
+ * @return	char *
+ * @retval	malloc-ed string, to be freed by the caller
+ * @retval	NULL on malloc failure
+ */
+char *
+sched_prof_as_string(void)
+{
+	char *buf = NULL;
+	int buf_size = 0;
+	char tmp[128];
+	unsigned long count[PROF_NCOUNTS] = {0};
+	int i;
+	int j;
+	int b;
+
+	for (i = 0; i < prof_ring_used; i++)
+		for (j = 0; j < PROF_NCOUNTS; j++)
+			count[j] += prof_ring[i].count[j];
+
+	snprintf(tmp, sizeof(tmp), "cycles=%d", prof_ring_used);
+	if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+		goto prof_err;
+	for (j = 0; j < PROF_NCOUNTS; j++) {
+		snprintf(tmp, sizeof(tmp), " %s=%lu", prof_count_name[j], count[j]);
+		if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+			goto prof_err;
+	}
+
+	for (j = 0; j < PROF_NPHASES; j++) {
+		unsigned int bucket[SCHED_PROF_BUCKETS] = {0};
+		unsigned long long total_us = 0;
+		unsigned long long max_us = 0;
+		bool seen = false;
+
+		for (i = 0; i < prof_ring_used; i++) {
+			unsigned long long us = prof_ring[i].us[j];
+
+			if (prof_ring[i].calls[j] == 0)
+				continue;
+			seen = true;
+			total_us += us;
+			if (us > max_us)
+				max_us = us;
+			for (b = 0; (b < SCHED_PROF_BUCKETS - 1) && ((1ULL << b) < us); b++)
+				;
+			bucket[b]++;
+		}
+		if (!seen)
+			continue;
+
+		snprintf(tmp, sizeof(tmp), " %s_us=(sum=%llu max=%llu",
+			prof_phase_name[j], total_us, max_us);
+		if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+			goto prof_err;
+		for (b = 0; b < SCHED_PROF_BUCKETS; b++) {
+			if (bucket[b] == 0)
+				continue;
+			if (b == SCHED_PROF_BUCKETS - 1)
+				snprintf(tmp, sizeof(tmp), " gt%llu=%u", 1ULL << (b - 1), bucket[b]);
+			else
+				snprintf(tmp, sizeof(tmp), " le%llu=%u", 1ULL << b, bucket[b]);
+			if (pbs_strcat(&buf, &buf_size, tmp) == NULL)
+				goto prof_err;
+		}
+		if (pbs_strcat(&buf, &buf_size, ")") == NULL)
+			goto prof_err;
+	}
+	return buf;
+
+prof_err:
+	log_err(errno, __func__, MEM_ERR_MSG);
+	free(buf);
+	return NULL;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+#ifndef _SCHED_PROF_H
+#define _SCHED_PROF_H
+
+/*
+ * Scheduling cycle profiler.  Phases may nest (e.g. run_job inside
+ * preempt, dup inside calendar), so their times are inclusive.
+ * Only the main thread records, and only while a cycle is running.
+ */
+
+#define SCHED_PROF_TRACE_ENV	"PBS_SCHED_PROF_TRACE"	/* Chrome trace file */
+#define SCHED_PROF_WINDOW	100	/* cycles kept for the histograms */
+#define SCHED_PROF_BUCKETS	32	/* bucket i holds times <= 2^i usecs, last one the rest */
+
+enum sched_prof_phase {
+	PROF_CYCLE,		/* the whole scheduling cycle */
+	PROF_QUERY,		/* query_server() */
+	PROF_QUERY_SERVER,	/* stat of the server */
+	PROF_QUERY_NODES,
+	PROF_QUERY_JOBS,	/* queues and their jobs */
+	PROF_QUERY_RESVS,
+	PROF_SORT,		/* sorting nodes and jobs */
+	PROF_BUCKETS,		/* creating node buckets */
+	PROF_DUP,		/* dup_server_info() */
+	PROF_IS_OK_TO_RUN,	/* is_ok_to_run() from the main loop */
+	PROF_CALENDAR,		/* adding top jobs to the calendar */
+	PROF_PREEMPT,		/* find_and_preempt_jobs() */
+	PROF_RUN_JOB,		/* run requests to the server */
+	PROF_NPHASES
+};
+
+enum sched_prof_counter {
+	PROF_CONSIDERED,	/* jobs considered by the main loop */
+	PROF_EQUIV_SKIPPED,	/* of those, skipped because of their equivalence class */
+	PROF_RUN,		/* jobs run, including by preemption */
+	PROF_NCOUNTS
+};
+
+/* times a phase from construction to stop() or destruction */
+class sched_prof_timer
+{
+	enum sched_prof_phase phase;
+	unsigned long long start_us;
+	bool running;
+
+public:
+	explicit sched_prof_timer(enum sched_prof_phase p);
+	~sched_prof_timer();
+	void stop();
+	void next(enum sched_prof_phase p);
+};
+
+void sched_prof_cycle_start(void);
+void sched_prof_cycle_end(int pbs_sd);
+void sched_prof_count(enum sched_prof_counter c);
+
+/* the rolling histograms, as published in the sched object */
+char *sched_prof_as_string(void);
+
+#endif /* _SCHED_PROF_H */
@@ -151,6 +151,7 @@
 #include "parse.h"
 #include "hook.h"
 #include "libpbs.h"
+#include "sched_prof.h"
 #ifdef NAS
 #include "site_code.h"
 #endif
@@ -192,6 +193,7 @@ query_server(status *pol, int pbs_sd)
 	resource_resv **jobs_alive;
 	status *policy;
 	int job_arrays_associated = FALSE;
+	sched_prof_timer prof(PROF_QUERY_SERVER);
 
 	if (pol == NULL)
 		return NULL;
@@ -245,9 +247,11 @@ query_server(status *pol, int pbs_sd)
 	 * will populate internal data structures based on this batch status
 	 * after all other data is queried
 	 */
+	prof.next(PROF_QUERY_RESVS);
 	bs_resvs = stat_resvs(pbs_sd);
 
 	/* get the nodes, if any - NOTE: will set sinfo -> num_nodes */
+	prof.next(PROF_QUERY_NODES);
 	if ((sinfo->nodes = query_nodes(pbs_sd, sinfo)) == NULL) {
 		pbs_statfree(server);
 		sinfo->fstree = NULL;
@@ -257,11 +261,13 @@ query_server(status *pol, int pbs_sd)
 	}
 
 	/* sort the nodes before we filter them down to more useful lists */
+	prof.next(PROF_SORT);
 	if (!policy->node_sort->empty())
 		qsort(sinfo->nodes, sinfo->num_nodes, sizeof(node_info *),
 			multi_node_sort);
 
 	/* get the queues */
+	prof.next(PROF_QUERY_JOBS);
 	if ((sinfo->queues = query_queues(policy, pbs_sd, sinfo)) == NULL) {
 		pbs_statfree(server);
 		sinfo->fstree = NULL;
@@ -270,6 +276,8 @@ query_server(status *pol, int pbs_sd)
 		return NULL;
 	}
 
+	prof.stop();
+
 	if (sinfo->has_nodes_assoc_queue)
 		sinfo->unassoc_nodes =
 			node_filter(sinfo->nodes, sinfo->num_nodes, is_unassoc_node, NULL, 0);
@@ -315,8 +323,10 @@ query_server(status *pol, int pbs_sd)
 	}
 
 	/* get reservations, if any - NOTE: will set sinfo -> num_resvs */
+	prof.next(PROF_QUERY_RESVS);
 	sinfo->resvs = query_reservations(pbs_sd, sinfo, bs_resvs);
 	pbs_statfree(bs_resvs);
+	prof.stop();
 
 	if (create_server_arrays(sinfo) == 0) { /* bad stuff happened */
 		sinfo->fstree = NULL;
@@ -2220,6 +2230,7 @@ dup_server_info(server_info *osinfo)
 {
 	server_info *nsinfo;		/* scheduler internal form of server info */
 	int i;
+	sched_prof_timer prof(PROF_DUP);
 
 	if (osinfo == NULL)
 		return NULL;
@@ -93,6 +93,7 @@
 #include "constant.h"
 #include "server_info.h"
 #include "resource.h"
+#include "sched_prof.h"
 
 #ifdef NAS
 #include "site_code.h"
@@ -1200,6 +1201,7 @@ sort_jobs(status *policy, server_info *sinfo)
 	int job_index = 0;
 	int index = 0;
 	int count = 0;
+	sched_prof_timer prof(PROF_SORT);
 
 	/** sort jobs in such a way that Higher Priority jobs come on top
 	 * followed by preempted jobs and then normal jobs
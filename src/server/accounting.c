@@ -45,6 +45,8 @@
  * accounting.c - contains functions to record accounting information
  *
  * Functions included are:
+ *	acct_async_start()
+ *	acct_flush()
  *	acct_open()
  *	acct_record()
  *	acct_close()
@@ -62,6 +64,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
 #include "list_link.h"
 #include "attribute.h"
 #include "resource.h"
@@ -83,10 +88,47 @@ static FILE *acctfile;		/* open stream for log file */
 static volatile int acct_opened = 0;
 static int acct_opened_day;
 static int acct_auto_switch = 0;
+static struct log_struct_file *acct_struct = NULL; /* structured stream, if enabled */
 static char *acct_buf = 0;
 static int acct_bufsize = PBS_ACCT_MAX_RCD;
 static const char *do_not_emit_alter[] = {ATTR_estimated, ATTR_used, NULL};
 
+/*
+ * Buffered accounting. When acct_async_start() is given a buffer size in
+ * bytes (PBS_ACCT_BUFFER in pbs.conf), write_account_record() only appends
+ * the record to acct_q, and a writer thread writes the queue out in
+ * batches. When the queue is full the server waits for the writer, so
+ * records are never dropped and memory stays bounded. Given an fsync
+ * interval in seconds (PBS_ACCT_FSYNC), the writer also calls fsync() on
+ * the file at most that often, once for all the records written since the
+ * last one. Records for the structured stream are encoded into acct_sq and
+ * appended by the writer too, a batch at a time.
+ */
+#define ACCT_ASYNC_MIN_BUFFER	65536
+/* room taken in acct_sq by a structured record of len bytes */
+#define ACCT_SREC_SIZE(len) \
+	((sizeof(struct log_struct_out) + (len) + 7) & ~(size_t)7)
+
+static int acct_async_on = 0;
+static int acct_fd = -1;		/* what the writer writes to */
+static int acct_fsync_interval = -1;	/* -1 for no fsync() */
+static char *acct_q = NULL;		/* records not yet taken by the writer */
+static size_t acct_q_len = 0;
+static size_t acct_q_size = 0;
+static size_t acct_q_max = 0;		/* bound passed to acct_async_start() */
+static char *acct_w = NULL;		/* records being written */
+static size_t acct_w_size = 0;
+static char *acct_sq = NULL;		/* structured records, see acct_senqueue() */
+static size_t acct_sq_len = 0;
+static size_t acct_sq_size = 0;
+static char *acct_sw = NULL;		/* structured records being written */
+static size_t acct_sw_size = 0;
+static int acct_w_busy = 0;
+static int acct_unsynced = 0;		/* written but not yet synced */
+static pthread_mutex_t acct_q_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t acct_q_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t acct_q_space = PTHREAD_COND_INITIALIZER;
+
 /* Global Data */
 
 extern char *acctlog_spacechar;
@@ -904,6 +946,348 @@ acct_resv(resc_resv *presv, char *buf, int len)
 	return (pb);
 }
 
+/**
+ * @brief
+ *	Write a buffer in full to the accounting file.
+ *
+ * @param[in]	fd - accounting file descriptor
+ * @param[in]	buf - records
+ * @param[in]	len - bytes in buf
+ *
+ * @return	Error code
+ * @retval	 0  - Success
+ * @retval	-1  - Failure
+ */
+static int
+acct_write(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, buf, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		buf += n;
+		len -= n;
+	}
+	return (0);
+}
+
+/**
+ * @brief
+ *	Append the structured records taken from acct_sq to the structured
+ *	stream. Each is a struct log_struct_out, whose rec is not set yet,
+ *	followed by the encoded record and padding.
+ *
+ * @param[in]	lsf - structured stream
+ * @param[in]	buf - records
+ * @param[in]	len - bytes in buf
+ *
+ * @return	void
+ */
+static void
+acct_struct_write(struct log_struct_file *lsf, char *buf, size_t len)
+{
+	struct log_struct_out outs[64];
+	struct log_struct_out *out;
+	size_t off = 0;
+	int n = 0;
+
+	while (off < len) {
+		out = (struct log_struct_out *)(buf + off);
+		outs[n] = *out;
+		outs[n++].rec = (char *)(out + 1);
+		off += ACCT_SREC_SIZE(out->len);
+		if ((n == 64) || (off >= len)) {
+			if (log_struct_append(lsf, outs, n) == -1)
+				log_err(errno, __func__, "could not write structured accounting records");
+			n = 0;
+		}
+	}
+}
+
+/**
+ * @brief
+ *	Main of the accounting writer thread: take whatever records are
+ *	queued, write them with one write(), and fsync() the file when
+ *	PBS_ACCT_FSYNC asks for it.
+ *
+ * @param[in]	arg - unused
+ *
+ * @return	void *
+ */
+static void *
+acct_writer(void *arg)
+{
+	struct timespec ts;
+	struct log_struct_file *lsf;
+	time_t last_sync;
+	int pending;
+	char *tmp;
+	size_t len;
+	size_t slen;
+	size_t size;
+	int fd;
+
+	last_sync = time(NULL);
+	pthread_mutex_lock(&acct_q_mutex);
+	for (;;) {
+		if (acct_q_len == 0) {
+			if (acct_unsynced) {
+				/* sync what is written once the interval is up */
+				ts.tv_sec = last_sync + acct_fsync_interval;
+				ts.tv_nsec = 0;
+				(void)pthread_cond_timedwait(&acct_q_ready, &acct_q_mutex, &ts);
+			} else
+				(void)pthread_cond_wait(&acct_q_ready, &acct_q_mutex);
+			if ((acct_q_len == 0) && (!acct_unsynced ||
+				(time(NULL) - last_sync < acct_fsync_interval)))
+				continue;
+		}
+
+		/* take the queue, leaving the server an empty buffer */
+		tmp = acct_w;
+		acct_w = acct_q;
+		acct_q = tmp;
+		size = acct_w_size;
+		acct_w_size = acct_q_size;
+		acct_q_size = size;
+		len = acct_q_len;
+		acct_q_len = 0;
+		tmp = acct_sw;
+		acct_sw = acct_sq;
+		acct_sq = tmp;
+		size = acct_sw_size;
+		acct_sw_size = acct_sq_size;
+		acct_sq_size = size;
+		slen = acct_sq_len;
+		acct_sq_len = 0;
+		fd = acct_fd;
+		lsf = acct_struct;
+		pending = acct_unsynced || ((len > 0) && (acct_fsync_interval >= 0));
+		acct_w_busy = 1;
+		pthread_cond_broadcast(&acct_q_space);
+		pthread_mutex_unlock(&acct_q_mutex);
+
+		if ((len > 0) && (acct_write(fd, acct_w, len) == -1))
+			log_err(errno, __func__, "could not write accounting records");
+		if ((slen > 0) && (lsf != NULL))
+			acct_struct_write(lsf, acct_sw, slen);
+		if (pending && (time(NULL) - last_sync >= acct_fsync_interval)) {
+			if (fsync(fd) == -1)
+				log_err(errno, __func__, "could not sync the accounting file");
+			last_sync = time(NULL);
+			pending = 0;
+		}
+
+		pthread_mutex_lock(&acct_q_mutex);
+		acct_unsynced = pending;
+		acct_w_busy = 0;
+		pthread_cond_broadcast(&acct_q_space);
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Wait until the writer has written every queued accounting record.
+ *	Called before the accounting file is closed or switched.
+ *
+ * @return	void
+ */
+void
+acct_flush(void)
+{
+	if (!acct_async_on)
+		return;
+	pthread_mutex_lock(&acct_q_mutex);
+	while ((acct_q_len > 0) || (acct_sq_len > 0) || acct_w_busy) {
+		pthread_cond_signal(&acct_q_ready);
+		pthread_cond_wait(&acct_q_space, &acct_q_mutex);
+	}
+	if (acct_unsynced) {
+		(void)fsync(acct_fd);
+		acct_unsynced = 0;
+	}
+	pthread_mutex_unlock(&acct_q_mutex);
+}
+
+/**
+ * @brief
+ *	Child side of fork(): the writer thread is not there, so go back to
+ *	writing records directly; the parent writes what was queued.
+ *
+ * @return	void
+ */
+static void
+acct_atfork_child(void)
+{
+	acct_async_on = 0;
+	acct_q_len = 0;
+	acct_sq_len = 0;
+	acct_w_busy = 0;
+	acct_unsynced = 0;
+	(void)pthread_mutex_init(&acct_q_mutex, NULL);
+	(void)pthread_cond_init(&acct_q_ready, NULL);
+	(void)pthread_cond_init(&acct_q_space, NULL);
+}
+
+/**
+ * @brief
+ *	Encode the structured record of an accounting record into acct_sq.
+ *	The caller holds acct_q_mutex.
+ *
+ * @param[in]	id - accounting record id
+ * @param[in]	fields - fields of the record
+ * @param[in]	need - ACCT_SREC_SIZE() of the encoded record
+ * @param[in]	rlen - length of the encoded record
+ *
+ * @return	void
+ */
+static void
+acct_senqueue(const char *id, const char **fields, size_t need, size_t rlen)
+{
+	struct log_struct_out *out;
+	char *p;
+
+	if (acct_sq_len + need > acct_sq_size) {
+		if ((p = realloc(acct_sq, acct_sq_len + need + ACCT_ASYNC_MIN_BUFFER)) == NULL) {
+			log_err(errno, __func__, "could not queue a structured accounting record");
+			return;
+		}
+		acct_sq = p;
+		acct_sq_size = acct_sq_len + need + ACCT_ASYNC_MIN_BUFFER;
+	}
+	out = (struct log_struct_out *)(acct_sq + acct_sq_len);
+	out->rec = NULL;
+	out->len = rlen;
+	out->indexed = 1;
+	out->hash = log_struct_id_hash(id);
+	(void)log_struct_encode((char *)(out + 1), rlen, time_now, -1, 0,
+		PBS_EVENTCLASS_ACCT, fields);
+	acct_sq_len += need;
+}
+
+/**
+ * @brief
+ *	Queue an accounting record for the writer, waiting for room if
+ *	the queue is full.
+ *
+ * @param[in]	prefix - date and record type part of the record
+ * @param[in]	id - accounting record id
+ * @param[in]	text - text of the record
+ * @param[in]	fields - fields of its structured record, or NULL
+ *
+ * @return	void
+ */
+static void
+acct_enqueue(const char *prefix, const char *id, const char *text, const char **fields)
+{
+	size_t plen = strlen(prefix);
+	size_t ilen = strlen(id);
+	size_t tlen = strlen(text);
+	size_t need = plen + ilen + tlen + 2;
+	size_t rlen = 0;
+	size_t sneed = 0;
+	size_t nsize;
+	char *p;
+
+	if (fields != NULL) {
+		rlen = log_struct_encode(NULL, 0, time_now, -1, 0, PBS_EVENTCLASS_ACCT, fields);
+		sneed = ACCT_SREC_SIZE(rlen);
+	}
+
+	pthread_mutex_lock(&acct_q_mutex);
+	/* a record larger than the bound waits for an empty queue */
+	while ((acct_q_len + acct_sq_len > 0) &&
+		(acct_q_len + acct_sq_len + need + sneed > acct_q_max))
+		pthread_cond_wait(&acct_q_space, &acct_q_mutex);
+
+	if (acct_q_len + need > acct_q_size) {
+		nsize = (acct_q_len + need > acct_q_max) ? acct_q_len + need : acct_q_max;
+		if ((p = realloc(acct_q, nsize)) == NULL) {
+			pthread_mutex_unlock(&acct_q_mutex);
+			log_err(errno, __func__, "could not queue an accounting record");
+			return;
+		}
+		acct_q = p;
+		acct_q_size = nsize;
+	}
+
+	p = acct_q + acct_q_len;
+	memcpy(p, prefix, plen);
+	p += plen;
+	memcpy(p, id, ilen);
+	p += ilen;
+	*p++ = ';';
+	memcpy(p, text, tlen);
+	p += tlen;
+	*p = '\n';
+	acct_q_len += need;
+	if (fields != NULL)
+		acct_senqueue(id, fields, sneed, rlen);
+	pthread_cond_signal(&acct_q_ready);
+	pthread_mutex_unlock(&acct_q_mutex);
+}
+
+/**
+ * @brief
+ *	Start writing accounting records from a writer thread.
+ *	Meant to be called once the server has gone to the background.
+ *
+ * @param[in]	bufsize - bytes of records that may be queued, 0 to keep
+ *			  writing them directly (PBS_ACCT_BUFFER)
+ * @param[in]	fsync_interval - seconds between fsync()s of the file,
+ *				 -1 for none (PBS_ACCT_FSYNC)
+ *
+ * @return      Error code
+ * @retval	 0  - Success, or buffering not requested
+ * @retval	-1  - Failure, records are written directly
+ */
+int
+acct_async_start(unsigned int bufsize, int fsync_interval)
+{
+	static int atfork_done = 0;
+	pthread_t tid;
+	sigset_t all;
+	sigset_t old;
+	int rc;
+
+	if (acct_async_on || (bufsize == 0))
+		return (0);
+	acct_q_max = (bufsize < ACCT_ASYNC_MIN_BUFFER) ? ACCT_ASYNC_MIN_BUFFER : bufsize;
+	acct_fsync_interval = fsync_interval;
+
+	if (!atfork_done) {
+		if (pthread_atfork(NULL, NULL, acct_atfork_child) != 0) {
+			log_err(-1, __func__, "could not set the accounting atfork handler");
+			return (-1);
+		}
+		atfork_done = 1;
+	}
+
+	if (acct_opened == 1) {
+		(void)fflush(acctfile);
+		acct_fd = fileno(acctfile);
+	}
+
+	/* the writer must never take the server's signals */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	acct_async_on = 1;
+	rc = pthread_create(&tid, NULL, acct_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (rc != 0) {
+		acct_async_on = 0;
+		log_err(rc, __func__, "could not start the accounting writer thread");
+		return (-1);
+	}
+	(void)pthread_detach(tid);
+	return (0);
+}
+
 /**
  * @brief
  * acct_open() - open the acct file for append.
@@ -953,10 +1337,20 @@ acct_open(char *filename)
 
 	(void)setvbuf(newacct, NULL, _IOLBF, 0); /* set line buffering */
 
-	if (acct_opened > 0) 		/* if acct was open, close it */
+	if (acct_opened > 0) {		/* if acct was open, close it */
+		acct_flush();
 		(void)fclose(acctfile);
-
+	}
+	if (acct_async_on)
+		pthread_mutex_lock(&acct_q_mutex);
+	log_struct_close(acct_struct);
+	acct_struct = NULL;
 	acctfile = newacct;
+	acct_fd = fileno(acctfile);
+	if (log_struct_enabled())
+		acct_struct = log_struct_open(filename);
+	if (acct_async_on)
+		pthread_mutex_unlock(&acct_q_mutex);
 	acct_opened = 1;			/* note that file is open */
 	(void)sprintf(logmsg, "Account file %s opened", filename);
 	log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO,
@@ -975,9 +1369,16 @@ void
 acct_close()
 {
 	if (acct_opened == 1) {
+		acct_flush();
 		(void)fclose(acctfile);
 		acct_opened = 0;
 	}
+	if (acct_async_on)
+		pthread_mutex_lock(&acct_q_mutex);
+	log_struct_close(acct_struct);
+	acct_struct = NULL;
+	if (acct_async_on)
+		pthread_mutex_unlock(&acct_q_mutex);
 }
 
 /**
@@ -994,6 +1395,8 @@ void
 write_account_record(int acctype, const char *id, char *text)
 {
 	struct tm *ptm;
+	char type[2];
+	const char *fields[7];
 
 	if (acct_opened == 0)
 		return;		/* file not open, don't bother */
@@ -1009,11 +1412,35 @@ write_account_record(int acctype, const char *id, char *text)
 	if (text == NULL)
 		text = "";
 
+	type[0] = (char)acctype;
+	type[1] = '\0';
+	fields[0] = "type";
+	fields[1] = type;
+	fields[2] = "name";
+	fields[3] = id;
+	fields[4] = "msg";
+	fields[5] = text;
+	fields[6] = NULL;
+
+	if (acct_async_on) {
+		/* "%02d/%02d/%04d %02d:%02d:%02d;%c;" at full int widths */
+		char prefix[80];
+
+		snprintf(prefix, sizeof(prefix), "%02d/%02d/%04d %02d:%02d:%02d;%c;",
+			ptm->tm_mon+1, ptm->tm_mday, ptm->tm_year+1900,
+			ptm->tm_hour, ptm->tm_min, ptm->tm_sec, (char)acctype);
+		acct_enqueue(prefix, id, text, (acct_struct != NULL) ? fields : NULL);
+		return;
+	}
+
 	(void)fprintf(acctfile,
 		"%02d/%02d/%04d %02d:%02d:%02d;%c;%s;%s\n",
 		ptm->tm_mon+1, ptm->tm_mday, ptm->tm_year+1900,
 		ptm->tm_hour, ptm->tm_min, ptm->tm_sec,
 		(char)acctype, id, text);
+	if (acct_struct != NULL)
+		(void)log_struct_write(acct_struct, time_now, -1, 0,
+			PBS_EVENTCLASS_ACCT, id, fields);
 }
 
 /**
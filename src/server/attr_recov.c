@@ -283,6 +283,75 @@ save_attr_fs(attribute_def *padef, attribute *pattr, int numattr)
 }
 
 
+/**
+ * @brief
+ *		decode one attribute read back from a save file
+ *
+ *		In the normal case the attribute is decoded directly into the
+ *		real attribute since there will be one entry only for it.
+ *
+ *		However, "entity limits" are special and may have multiple,
+ *		the first of which is "SET" and the following are "INCR".
+ *		For the SET case, we do it directly as for the normal attrs.
+ *		For the INCR,  we have to decode into a temp attr and then
+ *		call set_entity to do the INCR.
+ *
+ * @param[in]	pal - attribute as read, with its name/resc/value set
+ * @param[in]	parent - object the attributes belong to
+ * @param[in]	padef_idx - search index of the attribute definitions
+ * @param[in]	padef - parent's attribute definition array
+ * @param[in]	pattr - parent's attribute array
+ * @param[in]	unknown - index of the unknown attribute list, or 0
+ * @param[out]	recov_act - if not NULL, the ATR_ACTION_RECOV action is not
+ *			    run, recov_act[index] is set for recov_attr_action()
+ *
+ * @return	int
+ * @retval	0	decoded
+ * @retval	-1	unknown attribute discarded or decode failed
+ */
+static int
+recov_attr_one(svrattrl *pal, void *parent, void *padef_idx, attribute_def *padef,
+	attribute *pattr, int unknown, char *recov_act)
+{
+	int	index;
+	int	rc;
+
+	/* find the attribute definition based on the name */
+
+	index = find_attr(padef_idx, padef, pal->al_name);
+	if (index < 0) {
+		/*
+		 * There are two ways this could happen:
+		 * 1. if the (job) attribute is in the "unknown" list -
+		 *    keep it there;
+		 * 2. if the server was rebuilt and an attribute was
+		 *    deleted, -  the fact is logged and the attribute
+		 *    is discarded (system,queue) or kept (job)
+		 */
+		if (unknown > 0) {
+			index = unknown;
+		} else {
+			log_errf(-1, __func__, "unknown attribute \"%s\" discarded", pal->al_name);
+			return (-1);
+		}
+	}
+
+	if (((padef+index)->at_type != ATR_TYPE_ENTITY) || (pal->al_atopl.op != INCR)) {
+		rc = set_attr_generic(pattr+index, padef+index, pal->al_value, pal->al_resc, INTERNAL);
+		if ((rc == 0) && (padef+index)->at_action) {
+			if (recov_act != NULL)
+				recov_act[index] = 1;
+			else
+				(void)(padef+index)->at_action(pattr+index, parent, ATR_ACTION_RECOV);
+		}
+	} else {
+		/* for INCR case of entity limit, decode locally */
+		rc = set_attr_generic(pattr+index, padef+index, pal->al_value, pal->al_resc, INCR);
+	}
+	(pattr+index)->at_flags = pal->al_flags & ~ATR_VFLAG_MODIFY;
+	return (rc == 0 ? 0 : -1);
+}
+
 /**
  * @brief
  *		read attributes from disk file
@@ -310,7 +379,6 @@ recov_attr_fs(int fd, void *parent, void *padef_idx, attribute_def *padef, attri
 {
 	int	  amt;
 	int	  len;
-	int	  index;
 	svrattrl *pal = NULL;
 	int	  palsize = 0;
 	svrattrl *tmpal = NULL;
@@ -395,51 +463,107 @@ recov_attr_fs(int fd, void *parent, void *padef_idx, attribute_def *padef, attri
 
 		pal->al_refct = 1;	/* ref count reset to 1 */
 
-		/* find the attribute definition based on the name */
-
-		index = find_attr(padef_idx, padef, pal->al_name);
-		if (index < 0) {
-			/*
-			 * There are two ways this could happen:
-			 * 1. if the (job) attribute is in the "unknown" list -
-			 *    keep it there;
-			 * 2. if the server was rebuilt and an attribute was
-			 *    deleted, -  the fact is logged and the attribute
-			 *    is discarded (system,queue) or kept (job)
-			 */
-			if (unknown > 0) {
-				index = unknown;
-			} else {
-				log_errf(-1, __func__, "unknown attribute \"%s\" discarded", pal->al_name);
-				continue;
-			}
+		(void)recov_attr_one(pal, parent, padef_idx, padef, pattr, unknown, NULL);
+	}
+
+	(void)free(pal);
+	return (0);
+}
+
+/**
+ * @brief
+ *		recover attributes from a save file already read into memory
+ *
+ *		Same as recov_attr_fs() but works on the bytes after the fixed
+ *		part of the object, and leaves the ATR_ACTION_RECOV actions to a
+ *		later recov_attr_action() call.  This lets the attributes of many
+ *		objects be decoded on worker threads.
+ *
+ * @par MT-safe: Yes
+ *		Provided the caller has set resc_access_perm to ATR_DFLAG_ACCESS
+ *		and the definition indexes allow for the number of threads,
+ *		see avl_set_maxthreads().
+ *
+ * @param[in]	buf - file contents following the fixed part
+ * @param[in]	len - number of bytes in buf
+ * @param[in]	fname - file name, for error messages
+ * @param[in]	padef_idx - search index of the attribute definitions
+ * @param[in]	padef - parent's attribute definition array
+ * @param[in]	pattr - parent's attribute array
+ * @param[in]	unknown - index of the unknown attribute list, or 0
+ * @param[out]	recov_act - limit entries, set for the attributes whose
+ *			    action is still to be run
+ *
+ * @return      Error code
+ * @retval	 0  - Success
+ * @retval	-1  - Failure
+ */
+int
+recov_attr_mem(char *buf, size_t len, char *fname, void *padef_idx, attribute_def *padef,
+	attribute *pattr, int unknown, char *recov_act)
+{
+	svrattrl	 pal;
+	size_t		 amt;
+
+	while (1) {
+		if (len < sizeof(svrattrl)) {
+			log_errf(-1, __func__, "read1 error of %s", fname);
+			return (-1);
+		}
+		memcpy(&pal, buf, sizeof(svrattrl));
+		if (pal.al_tsize == ENDATTRIBUTES)
+			break;		/* hit dummy attribute that is eof */
+		if ((pal.al_tsize <= (int)sizeof(svrattrl)) || ((size_t)pal.al_tsize > len)) {
+			log_errf(-1, __func__, "Invalid attr list size in %s", fname);
+			return (-1);
 		}
+		amt = pal.al_tsize - sizeof(svrattrl);
 
-		/*
-		 * In the normal case we just decode the attribute directly
-		 * into the real attribute since there will be one entry only
-		 * for that attribute.
-		 *
-		 * However, "entity limits" are special and may have multiple,
-		 * the first of which is "SET" and the following are "INCR".
-		 * For the SET case, we do it directly as for the normal attrs.
-		 * For the INCR,  we have to decode into a temp attr and then
-		 * call set_entity to do the INCR.
-		 */
+		/* the pointers into the data are of course bad, so reset them */
 
-		if (((padef+index)->at_type != ATR_TYPE_ENTITY) || (pal->al_atopl.op != INCR)) {
-			int rc = set_attr_generic(pattr+index, padef+index, pal->al_value, pal->al_resc, INTERNAL);
-			if (! rc) {
-				if ((padef+index)->at_action)
-					(void)(padef+index)->at_action(pattr+index, parent, ATR_ACTION_RECOV);
-			}
-		} else {
-			/* for INCR case of entity limit, decode locally */
-			set_attr_generic(pattr+index, padef+index, pal->al_value, pal->al_resc, INCR);
+		CLEAR_LINK(pal.al_link);
+		pal.al_name = buf + sizeof(svrattrl);
+		if (pal.al_rescln)
+			pal.al_resc = pal.al_name + pal.al_nameln;
+		else
+			pal.al_resc = NULL;
+		if (pal.al_valln)
+			pal.al_value = pal.al_name + pal.al_nameln + pal.al_rescln;
+		else
+			pal.al_value = NULL;
+		if ((size_t)pal.al_nameln + pal.al_rescln + pal.al_valln > amt) {
+			log_errf(-1, __func__, "Invalid attr list size in %s", fname);
+			return (-1);
 		}
-		(pattr+index)->at_flags = pal->al_flags & ~ATR_VFLAG_MODIFY;
-	}
+		pal.al_refct = 1;
 
-	(void)free(pal);
+		(void)recov_attr_one(&pal, NULL, padef_idx, padef, pattr, unknown, recov_act);
+
+		buf += pal.al_tsize;
+		len -= pal.al_tsize;
+	}
 	return (0);
 }
+
+/**
+ * @brief
+ *		run the ATR_ACTION_RECOV actions left by recov_attr_mem()
+ *
+ * @param[in]	parent - object the attributes belong to
+ * @param[in]	padef - parent's attribute definition array
+ * @param[in]	pattr - parent's attribute array
+ * @param[in]	limit - number of attributes
+ * @param[in]	recov_act - entries set by recov_attr_mem()
+ *
+ * @return	void
+ */
+void
+recov_attr_action(void *parent, attribute_def *padef, attribute *pattr, int limit, char *recov_act)
+{
+	int	index;
+
+	for (index = 0; index < limit; index++) {
+		if (recov_act[index])
+			(void)(padef+index)->at_action(pattr+index, parent, ATR_ACTION_RECOV);
+	}
+}
@@ -177,6 +177,40 @@ static	unsigned long	hook_rescdef_checksum = 0;
 #define	SYNC_MOM_HOOKFILES_TIMEOUT_TPP	120	/* 2 minutes */
 #define	SYNC_MOM_HOOKFILES_TIMEOUT	900	/* 15 minutes */
 
+/* server hook events to run in a background child, see process_hooks_async() */
+#define	HOOK_ASYNC_MAX_CHILDREN	16
+
+/* exit status bits of an asynchronous hook child */
+#define	HOOK_ASYNC_REJECTED		0x1
+#define	HOOK_ASYNC_RESTART_CYCLE	0x2
+#define	HOOK_ASYNC_ERROR		0x4
+#define	HOOK_ASYNC_DROPPED		0x8	/* changes asked for were lost */
+/* the rest of the exit status is the number of hooks the child ran */
+#define	HOOK_ASYNC_RAN_SHIFT		4
+#define	HOOK_ASYNC_RAN_MAX		(0xff >> HOOK_ASYNC_RAN_SHIFT)
+#define	HOOK_PERF_ASYNC			"hook_async"
+
+static int hook_async_child = 0;	/* set in the child running the hooks */
+static int hook_async_running = 0;	/* children not yet reaped */
+static int hook_async_ran = 0;		/* hooks run so far, in the child */
+static int hook_async_dropped = 0;	/* a hook asked for changes, in the child */
+
+/*
+ * Background hooks of one event run in the order of the events: each
+ * child holds the write end of a pipe until it exits, and the next child
+ * for the same event waits for EOF on the read end before running its
+ * hooks.  The server keeps the read end of the latest pipe of each event,
+ * only to hand it to the next child, it never waits on it.
+ */
+static struct {
+	unsigned int event;
+	int fd;
+} hook_async_gate[] = {
+	{HOOK_EVENT_MANAGEMENT, -1},
+	{HOOK_EVENT_MODIFYVNODE, -1},
+	{HOOK_EVENT_RESV_END, -1}
+};
+
 extern char *msg_daemonname;
 extern char *path_priv;
 extern char *path_hooks;
@@ -1412,6 +1446,7 @@ mgr_hook_import(struct batch_request *preq)
 			output_path);
 		goto mgr_hook_import_error;
 	}
+	((struct python_script *)phook->script)->cache_bytecode = 1;
 
 	phook->hook_script_checksum = crc_file(output_path);
 
@@ -2352,6 +2387,20 @@ status_hook(hook *phook, struct batch_request *preq, pbs_list_head *pstathd, cha
 				strcpy(val_str, hook_debug_as_string(phook->debug));
 			} else if (strcmp(pal->al_name, HOOKATT_FAIL_ACTION) == 0) {
 				strcpy(val_str, hook_fail_action_as_string(phook->fail_action));
+			} else if (strcmp(pal->al_name, HOOKATT_PROFILE) == 0) {
+				/* can be long, hence not in val_str */
+				char *prof;
+
+				if ((prof = hook_prof_as_string(phook)) == NULL)
+					return (PBSE_SYSTEM);
+				if (attrlist_add(&pstat->brp_attr, pal->al_name,
+					(prof[0] != '\0') ? prof : "none") != 0) {
+					free(prof);
+					return (PBSE_INTERNAL);
+				}
+				free(prof);
+				pal = (svrattrl *)GET_NEXT(pal->al_link);
+				continue;
 			} else {
 				snprintf(hook_msg, msg_len-1,
 					"unknown hook attribute %s", pal->al_name);
@@ -3731,12 +3780,440 @@ get_resv_list(void) {
 	return &resv_attr_list;
 }
 
+/**
+ * @brief
+ *		Returns the set of server hook events that are to run
+ *		asynchronously, as listed (comma separated event names) in the
+ *		PBS_HOOK_ASYNC_EVENTS pbs.conf setting when first called.
+ *		Only events in ASYNC_HOOK_EVENTS, the ones whose outcome does not
+ *		gate a reply, are honored.
+ *
+ * @return	unsigned int
+ * @retval	mask of HOOK_EVENT_* values, 0 if none
+ */
+static unsigned int
+async_hook_events(void)
+{
+	static int loaded = 0;
+	static unsigned int events = 0;
+	char *val;
+	char *buf;
+	char *tok;
+	char *save = NULL;
+	unsigned int ev;
+
+	if (loaded)
+		return events;
+	loaded = 1;
+
+	if (((val = pbs_conf.pbs_hook_async_events) == NULL) || (*val == '\0'))
+		return events;
+	if ((buf = strdup(val)) == NULL) {
+		log_err(errno, __func__, msg_err_malloc);
+		return events;
+	}
+	for (tok = strtok_r(buf, ", ", &save); tok != NULL;
+		tok = strtok_r(NULL, ", ", &save)) {
+		ev = hookstr_event_toint(tok);
+		if ((ev & ASYNC_HOOK_EVENTS) == 0) {
+			snprintf(log_buffer, sizeof(log_buffer),
+				"%s: ignoring '%s', not an event that can run in the background",
+				PBS_CONF_HOOK_ASYNC_EVENTS, tok);
+			log_event(PBSEVENT_ADMIN, PBS_EVENTCLASS_HOOK, LOG_WARNING,
+				__func__, log_buffer);
+			continue;
+		}
+		events |= ev;
+	}
+	free(buf);
+	if (events != 0) {
+		snprintf(log_buffer, sizeof(log_buffer),
+			"hooks for events 0x%x will run in the background, "
+			"only their accept or reject is kept", events);
+		log_event(PBSEVENT_ADMIN, PBS_EVENTCLASS_HOOK, LOG_INFO,
+			__func__, log_buffer);
+	}
+	return events;
+}
+
+/**
+ * @brief
+ *		Returns the hook after 'phook' in the list of an event that may
+ *		run asynchronously.
+ *
+ * @param[in]	phook - current hook
+ * @param[in]	hook_event - one of ASYNC_HOOK_EVENTS
+ *
+ * @return	hook *
+ * @retval	next hook
+ * @retval	NULL at the end of the list
+ */
+static hook *
+async_hook_next(hook *phook, unsigned int hook_event)
+{
+	if (hook_event == HOOK_EVENT_MANAGEMENT)
+		return (hook *)GET_NEXT(phook->hi_management_hooks);
+	else if (hook_event == HOOK_EVENT_MODIFYVNODE)
+		return (hook *)GET_NEXT(phook->hi_modifyvnode_hooks);
+	return (hook *)GET_NEXT(phook->hi_resv_end_hooks);
+}
+
+/**
+ * @brief
+ *		Tells whether a hook of an event that may run asynchronously
+ *		would be run by process_hooks().
+ *
+ * @param[in]	phook - the hook
+ *
+ * @return	int
+ * @retval	1	- it would run
+ * @retval	0	- it would be skipped
+ */
+static int
+async_hook_runs(hook *phook)
+{
+	return (phook->enabled && (phook->user == HOOK_PBSADMIN) &&
+		(phook->script != NULL));
+}
+
+/**
+ * @brief
+ *		Tells whether any hook attached to an event that may run
+ *		asynchronously would actually execute.
+ *
+ * @param[in]	hook_event - one of ASYNC_HOOK_EVENTS
+ * @param[in]	head_ptr - list of hooks for 'hook_event'
+ *
+ * @return	int
+ * @retval	1	- at least one hook would run
+ * @retval	0	- none
+ */
+static int
+async_hooks_runnable(unsigned int hook_event, pbs_list_head *head_ptr)
+{
+	hook *phook;
+
+	for (phook = (hook *)GET_NEXT(*head_ptr); phook != NULL;
+		phook = async_hook_next(phook, hook_event)) {
+		if (async_hook_runs(phook))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *		Logs, when the server loads its hooks at startup, each hook that
+ *		will run in the background because its event is listed in
+ *		PBS_HOOK_ASYNC_EVENTS.  Only whether such a hook accepts or
+ *		rejects the event comes back from its child: changes it asks
+ *		for, e.g. to vnode attributes, are not applied.
+ *
+ * @return	void
+ */
+void
+log_async_hooks(void)
+{
+	unsigned int events;
+	pbs_list_head *head_ptr;
+	hook *phook;
+	int i;
+
+	if ((events = async_hook_events()) == 0)
+		return;
+	for (i = 0; i < sizeof(hook_async_gate) / sizeof(hook_async_gate[0]); i++) {
+		if ((events & hook_async_gate[i].event) == 0)
+			continue;
+		if (hook_async_gate[i].event == HOOK_EVENT_MANAGEMENT)
+			head_ptr = &svr_management_hooks;
+		else if (hook_async_gate[i].event == HOOK_EVENT_MODIFYVNODE)
+			head_ptr = &svr_modifyvnode_hooks;
+		else
+			head_ptr = &svr_resv_end_hooks;
+		for (phook = (hook *)GET_NEXT(*head_ptr); phook != NULL;
+			phook = async_hook_next(phook, hook_async_gate[i].event)) {
+			snprintf(log_buffer, sizeof(log_buffer),
+				"%s hook runs in the background: only its accept "
+				"or reject is kept, changes it asks for are not applied",
+				hook_event_as_string(hook_async_gate[i].event));
+			log_event(PBSEVENT_ADMIN, PBS_EVENTCLASS_HOOK, LOG_WARNING,
+				phook->hook_name, log_buffer);
+		}
+	}
+}
+
+/**
+ * @brief
+ *		Returns the slot in hook_async_gate[] of an asynchronous event.
+ *
+ * @param[in]	hook_event - one of ASYNC_HOOK_EVENTS
+ *
+ * @return	int *
+ * @retval	pointer to the gate descriptor of the event
+ * @retval	NULL if the event cannot run in the background
+ */
+static int *
+async_gate(unsigned int hook_event)
+{
+	int i;
+
+	for (i = 0; i < sizeof(hook_async_gate) / sizeof(hook_async_gate[0]); i++) {
+		if (hook_async_gate[i].event == hook_event)
+			return &hook_async_gate[i].fd;
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *		Waits until the background hooks already started for an event
+ *		are done, that is until the last of their children exits, then
+ *		closes the gate.  Only called in a child, the server must not
+ *		block on its background hooks.
+ *
+ * @param[in,out]	gate - gate descriptor of the event, set to -1
+ *
+ * @return	void
+ */
+static void
+async_gate_wait(int *gate)
+{
+	char c;
+
+	if (*gate == -1)
+		return;
+	while ((read(*gate, &c, 1) == -1) && (errno == EINTR))
+		;
+	close(*gate);
+	*gate = -1;
+}
+
+/**
+ * @brief
+ *		Callback function for reaping the child that ran the hooks of an
+ *		asynchronous event.  This is where the outcome of those hooks is
+ *		applied back to the server, on the main thread.
+ *
+ * @param[in]	ptask	- work task pointer, wt_parm1 holds the hook event
+ *			  and wt_parm2 its list of hooks
+ *
+ * @return	void
+ */
+static void
+post_async_hooks(struct work_task *ptask)
+{
+	int stat = ptask->wt_aux;
+	unsigned int hook_event = (unsigned int)(long)ptask->wt_parm1;
+	pbs_list_head *head_ptr = (pbs_list_head *)ptask->wt_parm2;
+	char pid_str[32];
+	double run_secs;
+	hook *phook;
+	int bits;
+	int ran;
+	int i;
+
+	if (hook_async_running > 0)
+		hook_async_running--;
+
+	snprintf(pid_str, sizeof(pid_str), "%ld", ptask->wt_event);
+	run_secs = hook_perf_stat_stop(HOOK_PERF_ASYNC, pid_str, 0);
+
+	if (!WIFEXITED(stat)) {
+		snprintf(log_buffer, sizeof(log_buffer),
+			"background %s hooks (pid %ld) encountered errors: %d",
+			hook_event_as_string(hook_event), ptask->wt_event, stat);
+		log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_HOOK, LOG_ERR,
+			__func__, log_buffer);
+		return;
+	}
+
+	bits = WEXITSTATUS(stat);
+	ran = bits >> HOOK_ASYNC_RAN_SHIFT;
+
+	/*
+	 * The child's own profile is lost with it, account the run here.
+	 * Hooks run in list order and the first reject or error ends the
+	 * run, so the last hook that ran is the one that rejected or failed.
+	 * Each hook that ran is charged the fork-to-reap time of the child.
+	 */
+	i = 0;
+	for (phook = (hook *)GET_NEXT(*head_ptr); (phook != NULL) && (i < ran);
+		phook = async_hook_next(phook, hook_event)) {
+		if (!async_hook_runs(phook))
+			continue;
+		i++;
+		hook_prof_count(phook, hook_event, HOOK_PROF_CALLS);
+		hook_prof_record(phook, hook_event, HOOK_PROF_RUN, run_secs);
+		if (i < ran)
+			continue;
+		if (bits & HOOK_ASYNC_ERROR)
+			hook_prof_count(phook, hook_event, HOOK_PROF_ERRORS);
+		else if (bits & HOOK_ASYNC_REJECTED)
+			hook_prof_count(phook, hook_event, HOOK_PROF_REJECTS);
+	}
+
+	if (bits & HOOK_ASYNC_DROPPED) {
+		snprintf(log_buffer, sizeof(log_buffer),
+			"background %s hooks (pid %ld) asked for vnode changes, "
+			"not applied as the hooks ran in the background",
+			hook_event_as_string(hook_event), ptask->wt_event);
+		log_event(PBSEVENT_ADMIN, PBS_EVENTCLASS_HOOK, LOG_WARNING,
+			__func__, log_buffer);
+	}
+	if (bits & HOOK_ASYNC_RESTART_CYCLE) {
+		set_scheduler_flag(SCH_SCHEDULE_RESTART_CYCLE, dflt_scheduler);
+		log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+			"background hook requested for scheduler to restart cycle");
+	}
+	snprintf(log_buffer, sizeof(log_buffer),
+		"background %s hooks (pid %ld) %s", hook_event_as_string(hook_event),
+		ptask->wt_event,
+		(bits & HOOK_ASYNC_ERROR) ? "encountered an internal error" :
+		((bits & HOOK_ASYNC_REJECTED) ? "rejected the event" : "accepted the event"));
+	log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		log_buffer);
+}
+
+/**
+ * @brief
+ *		Run the hooks of an event whose outcome does not gate the reply
+ *		to 'preq' in a child process, against the copy of the server
+ *		state it inherits, so the request does not wait on them.  The
+ *		child runs them through process_hooks() exactly as it would have
+ *		been done inline, and reports the outcome in its exit status,
+ *		picked up by post_async_hooks().
+ *
+ *		Hooks of the same event run one event at a time, in the order
+ *		of the events: a child waits for the previous child of its event
+ *		to exit before running its hooks (see hook_async_gate[]).  When
+ *		the hooks cannot be handed off (too many children, or set_task(),
+ *		pipe() or fork() failed), the caller runs them inline right away.
+ *		The server never waits on the background hooks, so such an
+ *		inline run may overtake the background runs of earlier events.
+ *
+ *		Only the outcome of the hooks comes back from the child, changes
+ *		they ask for are made to its copy of the server and lost, see
+ *		log_async_hooks().
+ *
+ * @param[in] 	preq	- the batch request
+ * @param[in] 	hook_event - the event, one of ASYNC_HOOK_EVENTS
+ * @param[in] 	head_ptr - list of hooks for 'hook_event'
+ * @param[in]   pyinter_func - the interrupt function for the hook alarm
+ *
+ * @return	int
+ * @retval	1	- hooks handed off to a child, accept the request
+ * @retval	2	- no hook to run
+ * @retval	-2	- could not hand off, run the hooks inline
+ *
+ * @par MT-safe: No
+ */
+static int
+process_hooks_async(struct batch_request *preq, unsigned int hook_event,
+	pbs_list_head *head_ptr, void (*pyinter_func)(void))
+{
+	char hook_msg[HOOK_MSG_SIZE];
+	pid_t pid;
+	int rc;
+	int bits = 0;
+	int *gate;
+	int pfd[2];
+	struct work_task *ptask;
+
+	if (!async_hooks_runnable(hook_event, head_ptr))
+		return (2);
+
+	if ((gate = async_gate(hook_event)) == NULL)
+		return (-2);
+
+	if (hook_async_running >= HOOK_ASYNC_MAX_CHILDREN) {
+		log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+			"too many background hooks running, running hooks inline");
+		return (-2);
+	}
+
+	/* set up the reaping before the fork, so a child is never left unaccounted */
+	ptask = set_task(WORK_Deferred_Child, 0, post_async_hooks,
+		(void *)(long)hook_event);
+	if (ptask == NULL) {
+		log_err(errno, __func__, msg_err_malloc);
+		return (-2);
+	}
+	if (pipe(pfd) == -1) {
+		log_err(errno, __func__, "pipe failed, running hooks inline");
+		delete_task(ptask);
+		return (-2);
+	}
+	(void)fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+	(void)fcntl(pfd[1], F_SETFD, FD_CLOEXEC);
+
+	pid = fork();
+	if (pid == -1) {
+		log_err(errno, __func__, "fork failed, running hooks inline");
+		close(pfd[0]);
+		close(pfd[1]);
+		delete_task(ptask);
+		return (-2);
+	}
+
+	if (pid != 0) {		/* The parent (main server) */
+		char pid_str[32];
+
+		ptask->wt_event = (long)pid;
+		ptask->wt_parm2 = (void *)head_ptr;
+		hook_async_running++;
+		snprintf(pid_str, sizeof(pid_str), "%ld", (long)pid);
+		hook_perf_stat_start(HOOK_PERF_ASYNC, pid_str, 0);
+		/* the next child for this event waits on this one */
+		close(pfd[1]);
+		if (*gate != -1)
+			close(*gate);
+		*gate = pfd[0];
+		return (1);
+	}
+
+	/* Close all server connections */
+	net_close(-1);
+	tpp_terminate();
+	/* Unprotect child from being killed by kernel */
+	daemon_protect(0, PBS_DAEMON_PROTECT_OFF);
+
+	/* wait for the hooks of the previous event, pfd[1] is held until exit */
+	close(pfd[0]);
+	async_gate_wait(gate);
+
+	hook_async_child = 1;
+	if (dflt_scheduler != NULL)
+		dflt_scheduler->svr_do_schedule = SCH_SCHEDULE_NULL;
+
+	rc = process_hooks(preq, hook_msg, sizeof(hook_msg), pyinter_func);
+	if (rc == 0) {
+		bits |= HOOK_ASYNC_REJECTED;
+		if (hook_msg[0] != '\0')
+			log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_HOOK, LOG_ERR,
+				__func__, hook_msg);
+	} else if (rc == -1)
+		bits |= HOOK_ASYNC_ERROR;
+	if ((dflt_scheduler != NULL) &&
+		(dflt_scheduler->svr_do_schedule == SCH_SCHEDULE_RESTART_CYCLE))
+		bits |= HOOK_ASYNC_RESTART_CYCLE;
+	if (hook_async_dropped)
+		bits |= HOOK_ASYNC_DROPPED;
+	if (hook_async_ran > HOOK_ASYNC_RAN_MAX)
+		hook_async_ran = HOOK_ASYNC_RAN_MAX;
+	bits |= hook_async_ran << HOOK_ASYNC_RAN_SHIFT;
+
+	exit(bits);
+}
+
 /**
  * @brief
  *
  *		Process hook scripts based on request type.
  *		This loops through the matching list of
  *		hooks, and executes the corresponding hook scripts.
+ *		Hooks of events listed in PBS_HOOK_ASYNC_EVENTS are handed off
+ *		to a child process instead, and the request is accepted
+ *		without waiting on them (see process_hooks_async()).
  *
  * @see
  * 		req_modifyjob, req_movejob, req_quejob, req_resvSub, req_delete and req_runjob
@@ -3847,6 +4324,12 @@ process_hooks(struct batch_request *preq, char *hook_msg, size_t msg_len,
 
 	memset(hook_msg, '\0', msg_len);
 
+	if (!hook_async_child && (hook_event & async_hook_events())) {
+		rc = process_hooks_async(preq, hook_event, head_ptr, pyinter_func);
+		if (rc != -2)
+			return (rc);
+	}
+
 	/* initialize global flags */
 	pbs_python_event_accept();
 
@@ -3895,6 +4378,8 @@ process_hooks(struct batch_request *preq, char *hook_msg, size_t msg_len,
 			num_run++;
 			continue;
 		}
+		if (hook_async_child)
+			hook_async_ran++;
 		rc = server_process_hooks(preq->rq_type, preq->rq_user, preq->rq_host, phook,
 				hook_event, pjob, &req_ptr, hook_msg, msg_len, pyinter_func,
 				&num_run, &event_initialized);
@@ -3964,6 +4449,9 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 	pbs_list_head 		event_vnode;
 	pbs_list_head 		event_resv;
 	char			perf_label[MAXBUFLEN];
+	double			marshal_secs = -1;
+	double			run_secs = -1;
+	unsigned long		restarts;
 
 	if (phook == NULL) {
 		log_event(PBSEVENT_DEBUG3,
@@ -4040,11 +4528,20 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 		}
 	}
 
+	/* everything up to running the script is charged to this hook's */
+	/* marshal phase, including building the event for the first hook */
+	hook_perf_stat_start(perf_label, HOOK_PERF_MARSHAL, 0);
+
 	/* optimization here - create an event object only if there's */
 	/* at least one enabled hook */
 	if (!(*event_initialized)) { /* only once for all hooks */
+		restarts = pbs_python_restart_count;
+		hook_perf_stat_start(perf_label, HOOK_PERF_EVENT_SET, 0);
 		rc = pbs_python_event_set(hook_event, rq_user,
 			rq_host, req_ptr, perf_label);
+		hook_perf_stat_stop(perf_label, HOOK_PERF_EVENT_SET, 0);
+		if (pbs_python_restart_count != restarts)
+			hook_prof_count(phook, hook_event, HOOK_PROF_RESTARTS);
 
 		if (rc == -1) { /* internal server code failure */
 			log_event(PBSEVENT_DEBUG2,
@@ -4305,12 +4802,15 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 		fprintf(fp_debug, "%s.%s=%d\n", EVENT_OBJECT, "alarm", phook->alarm);
 	}
 
+	marshal_secs = hook_perf_stat_stop(perf_label, HOOK_PERF_MARSHAL, 0);
+
 	/* let rc pass through */
 	if (rc == 0) {
 		hook_perf_stat_start(perf_label, "run_code", 0);
 		rc = pbs_python_run_code_in_namespace(&svr_interp_data, phook->script, 0);
-		hook_perf_stat_stop(perf_label, "run_code", 0);
+		run_secs = hook_perf_stat_stop(perf_label, "run_code", 0);
 	}
+	hook_perf_stat_start(perf_label, HOOK_PERF_HOOK_RESULTS, 0);
 
 	if (fp_debug != NULL) {
 		fclose(fp_debug);
@@ -4392,6 +4892,7 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 
 	switch (rc) {
 		case -1:	/* internal error */
+			hook_prof_count(phook, hook_event, HOOK_PROF_ERRORS);
 			log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_HOOK,
 				LOG_ERR, phook->hook_name,
 				"Internal server error encountered. Skipping hook.");
@@ -4404,6 +4905,7 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 			rc = -1;
 			goto server_process_hooks_exit;
 		case -2:	/* unhandled exception */
+			hook_prof_count(phook, hook_event, HOOK_PROF_ERRORS);
 			pbs_python_event_reject(NULL);
 			pbs_python_event_param_mod_disallow();
 
@@ -4420,6 +4922,7 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 			rc = 0;
 			goto server_process_hooks_exit;
 		case -3:	/* alarm timeout */
+			hook_prof_count(phook, hook_event, HOOK_PROF_TIMEOUTS);
 			pbs_python_event_reject(NULL);
 			pbs_python_event_param_mod_disallow();
 
@@ -4504,6 +5007,9 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 			}
 		}
 
+		/* a background hook would only change the child's copy */
+		if (hook_async_child && pbs_python_has_vnode_set())
+			hook_async_dropped = 1;
 		pbs_python_do_vnode_set();
 		write_hook_reject_debug_output_and_close(emsg);
 		rc = 0;
@@ -4657,6 +5163,15 @@ int server_process_hooks(int rq_type, char *rq_user, char *rq_host, hook *phook,
 	write_hook_accept_debug_output_and_close();
 	rc = 1;
 server_process_hooks_exit:
+	if (marshal_secs < 0)	/* left before running the script */
+		marshal_secs = hook_perf_stat_stop(perf_label, HOOK_PERF_MARSHAL, 0);
+	hook_prof_record(phook, hook_event, HOOK_PROF_MARSHAL, marshal_secs);
+	hook_prof_record(phook, hook_event, HOOK_PROF_RUN, run_secs);
+	hook_prof_record(phook, hook_event, HOOK_PROF_APPLY,
+		hook_perf_stat_stop(perf_label, HOOK_PERF_HOOK_RESULTS, 0));
+	hook_prof_count(phook, hook_event, HOOK_PROF_CALLS);
+	if (rc == 0)
+		hook_prof_count(phook, hook_event, HOOK_PROF_REJECTS);
 	hook_perf_stat_stop(perf_label, "server_process_hooks", 1);
 	return (rc);
 }
@@ -6778,6 +7293,10 @@ post_server_periodic_hook(struct work_task *ptask)
 		log_err(-1, __func__, "A periodic hook disappeared");
 		return;
 	}
+	/* the child's own profile is lost with it, account the run here */
+	hook_prof_count(phook, HOOK_EVENT_PERIODIC, HOOK_PROF_CALLS);
+	hook_prof_record(phook, HOOK_EVENT_PERIODIC, HOOK_PROF_RUN,
+		hook_perf_stat_stop(phook->hook_name, HOOK_PERF_RUN_CODE, 0));
 	if (WIFEXITED(stat)) {
 		char reject_msg[HOOK_MSG_SIZE + 1] = {'\0'};
 		char *next_time_str;
@@ -6810,6 +7329,7 @@ post_server_periodic_hook(struct work_task *ptask)
 		}
 
 		if ((hook_error_flag == 1) || (accept_flag == 0)) {
+			hook_prof_count(phook, HOOK_EVENT_PERIODIC, HOOK_PROF_REJECTS);
 			snprintf(log_buffer, sizeof(log_buffer),
 				"%s request rejected by '%s'",
 				"periodic", phook->hook_name);
@@ -6913,6 +7433,7 @@ run_periodic_hook(struct work_task *ptask)
 			log_err(errno, __func__, msg_err_malloc);
 			return;
 		}
+		hook_perf_stat_start(phook->hook_name, HOOK_PERF_RUN_CODE, 0);
 		/* Set a timed task for next occurance of this hook */
 		(void)set_task(WORK_Timed, time_now + phook->freq,
 			run_periodic_hook, phook);
@@ -330,6 +330,7 @@ job_alloc(void)
 	pj->ji_postevent = TM_NULL_EVENT;
 	pj->ji_preq = NULL;
 	pj->ji_nodekill = TM_ERROR_NODE;
+	pj->ji_fanout = NULL;
 	pj->ji_flags = 0;
 	pj->ji_jsmpipe = -1;
 	pj->ji_mjspipe = -1;
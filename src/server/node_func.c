@@ -114,6 +114,23 @@ extern int process_topology_info(void **, char *);
 extern void release_lic_for_cray(struct pbsnode *pnode);
 static void remove_node_topology(char *);
 
+/*
+ * Conditional node status (see req_stat_node()): every change to the encoded
+ * status of a vnode, and every vnode deletion, is stamped with the next value
+ * of node_stat_gen.  Deletions are kept in a bounded ring; node_stat_floor is
+ * the generation of the newest tombstone that has been pushed out of it.
+ */
+unsigned long long node_stat_gen = 0;
+unsigned long long node_stat_floor = 0;
+time_t node_stat_epoch = 0;
+
+static struct node_stat_tomb {
+	char *nt_name;
+	unsigned long long nt_gen;
+} node_stat_tombs[NODE_STAT_TOMBS];
+static int node_stat_ntombs = 0;	/* tombstones in use */
+static int node_stat_tombnext = 0;	/* next slot to fill */
+
 /**
  * @brief
  * 		find_nodebyname() - find a node host by its name
@@ -317,6 +334,9 @@ initialize_pbsnode(struct pbsnode *pnode, char *pname, int ntype)
 	if (pnode->nd_moms == NULL)
 		return (PBSE_SYSTEM);
 	pnode->nd_nummslots = 1;
+	pnode->nd_stat_gen = 0;
+	pnode->nd_stat_hash = 0;
+	pnode->nd_stat_sig = 0;
 	CLEAR_LINK(pnode->nd_link);
 
 	/* first, clear the attributes */
@@ -534,6 +554,72 @@ free_pnode(struct pbsnode *pnode)
 	free(pnode); /* delete the pnode from memory */
 }
 
+/**
+ * @brief
+ * 		node_stat_tombstone - remember that a vnode was deleted so a
+ *		conditional status request can report it.  When the ring is full
+ *		the oldest entry is dropped and the floor raised to its generation.
+ *
+ * @param[in]	pnode	-	vnode being deleted
+ *
+ * @return	void
+ */
+void
+node_stat_tombstone(struct pbsnode *pnode)
+{
+	struct node_stat_tomb *pt;
+	char *name;
+
+	if ((name = strdup(pnode->nd_name)) == NULL) {
+		/* cannot report it, force everyone behind us to a full listing */
+		node_stat_floor = ++node_stat_gen;
+		return;
+	}
+
+	pt = &node_stat_tombs[node_stat_tombnext];
+	if (node_stat_ntombs == NODE_STAT_TOMBS) {
+		node_stat_floor = pt->nt_gen;
+		free(pt->nt_name);
+	} else
+		node_stat_ntombs++;
+	pt->nt_name = name;
+	pt->nt_gen = ++node_stat_gen;
+	node_stat_tombnext = (node_stat_tombnext + 1) % NODE_STAT_TOMBS;
+}
+
+/**
+ * @brief
+ * 		node_stat_deleted_since - append a "deleted" entry for each vnode
+ *		deleted after generation since.
+ *
+ * @param[in]	since	-	generation the client last saw
+ * @param[in,out]	phead	-	list to append the svrattrl entries to
+ *
+ * @return	int
+ * @retval	0	: success
+ * @retval	PBSE_SYSTEM	: out of memory
+ */
+int
+node_stat_deleted_since(unsigned long long since, pbs_list_head *phead)
+{
+	int i;
+	int len;
+	struct node_stat_tomb *pt;
+	svrattrl *pal;
+
+	for (i = 0; i < NODE_STAT_TOMBS; i++) {
+		pt = &node_stat_tombs[i];
+		if (pt->nt_name == NULL || pt->nt_gen <= since)
+			continue;
+		len = strlen(pt->nt_name);
+		if ((pal = attrlist_create(STAT_SINCE_DELETED, NULL, len)) == NULL)
+			return PBSE_SYSTEM;
+		strcpy(pal->al_value, pt->nt_name);
+		append_link(phead, &pal->al_link, pal);
+	}
+	return 0;
+}
+
 /**
  * @brief
  * 		effective_node_delete - physically delete a vnode, including its
@@ -604,6 +690,8 @@ effective_node_delete(struct pbsnode *pnode)
 	DBPRT(("Deleting node %s from database\n", pnode->nd_name))
 	node_delete_db(pnode);
 
+	node_stat_tombstone(pnode);
+
 	remove_node_topology(pnode->nd_name);
 
 	/* delete the node from the node tree as well as the node array */
@@ -457,6 +457,7 @@ main(int argc, char **argv)
 	}
 
 	(void) snprintf(path_log, sizeof(path_log), "%s/%s", pbs_conf.pbs_home_path, PBS_COMM_LOGDIR);
+	log_struct_enable(pbs_conf.pbs_log_structured);
 	(void) log_open(log_file, path_log);
 
 	/* set pbs_comm's process limits */
@@ -836,6 +836,7 @@ pbsd_init(int type)
 	print_hooks(HOOK_EVENT_PROVISION);
 	print_hooks(HOOK_EVENT_PERIODIC);
 	print_hooks(HOOK_EVENT_RESV_END);
+	log_async_hooks();
 
 	/*
 	 * cleanup  the hooks work directory
@@ -941,6 +941,7 @@ main(int argc, char **argv)
 	*log_event_mask = get_sattr_long(SVR_ATR_log_events);
 	(void)sprintf(path_log, "%s/%s", pbs_conf.pbs_home_path, PBS_LOGFILES);
 
+	log_struct_enable(pbs_conf.pbs_log_structured);
 	(void)log_open(log_file, path_log);
 	(void)sprintf(log_buffer, msg_startup1, PBS_VERSION, server_init_type);
 	log_event(PBSEVENT_SYSTEM | PBSEVENT_ADMIN | PBSEVENT_FORCE,
@@ -1124,6 +1125,9 @@ main(int argc, char **argv)
 	(void)setvbuf(stderr, NULL, _IOLBF, 0);
 #endif	/* end the ifndef DEBUG */
 
+	(void)log_async_start(pbs_conf.pbs_log_async);
+	(void)acct_async_start(pbs_conf.pbs_acct_buffer, pbs_conf.pbs_acct_fsync);
+
 	/* Protect from being killed by kernel */
 	daemon_protect(0, PBS_DAEMON_PROTECT_ON);
 
@@ -61,7 +61,8 @@
 /**
  * @brief
  * 		req_connect - process a Connection Request
- * 		Almost does nothing.
+ * 		Almost does nothing, besides flagging qsub daemon connections
+ * 		and agreeing to DIS version 2 when the client asks for it.
  *
  * @param[in]	preq	- Connection Request
  */
@@ -79,6 +80,21 @@ req_connect(struct batch_request *preq)
 	if (preq->rq_extend != NULL) {
 		if (strcmp(preq->rq_extend, QSUB_DAEMON) == 0)
 			conn->cn_authen |= PBS_NET_CONN_FROM_QSUB_DAEMON;
+		else if (strcmp(preq->rq_extend, EXTEND_OPT_DIS_VERSION) == 0) {
+			int sock = preq->rq_conn;
+
+			/*
+			 * Client asked for the binary DIS encoding, say yes in
+			 * the auxcode of the acknowledgement, which still goes
+			 * out in version 1, and switch the channel afterwards.
+			 */
+			preq->rq_reply.brp_code = PBSE_NONE;
+			preq->rq_reply.brp_auxcode = DIS_VERSION_2;
+			preq->rq_reply.brp_choice = BATCH_REPLY_CHOICE_NULL;
+			if (reply_send(preq) == 0)
+				dis_set_version(sock, DIS_VERSION_2);
+			return;
+		}
 	}
 
 	reply_ack(preq);
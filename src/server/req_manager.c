@@ -1602,6 +1602,7 @@ mgr_sched_set(struct batch_request *preq)
 	int	  rc;
 	pbs_sched *psched;
 	int only_scheduling = 1;
+	int only_profile = 1;
 
 	psched = find_sched(preq->rq_ind.rq_manager.rq_objname);
 	if (!psched) {
@@ -1612,8 +1613,11 @@ mgr_sched_set(struct batch_request *preq)
 	CLEAR_HEAD(unsetlist);
 	plist = (svrattrl *)GET_NEXT(preq->rq_ind.rq_manager.rq_attr);
 	while (plist) {
-		if (strcmp(plist->al_atopl.name, ATTR_scheduling)) {
-			only_scheduling = 0;
+		/* the scheduler's own cycle profile does not change its configuration */
+		if (strcmp(plist->al_atopl.name, ATTR_sched_cycle_profile)) {
+			only_profile = 0;
+			if (strcmp(plist->al_atopl.name, ATTR_scheduling))
+				only_scheduling = 0;
 		}
 		if (plist->al_atopl.value == NULL || plist->al_atopl.value[0] == '\0') {
 			tmp = (struct svrattrl *)GET_NEXT(plist->al_link);
@@ -1651,6 +1655,12 @@ mgr_sched_set(struct batch_request *preq)
 	if (only_scheduling != 1)
 		set_scheduler_flag(SCH_CONFIGURE, psched);
 
+	if (only_profile) {
+		/* not saved, and set every few cycles, so not logged either */
+		reply_ack(preq);
+		return;
+	}
+
 	sched_save_db(psched);
 
 done:
@@ -52,6 +52,10 @@
  * 	status_que()
  * 	req_stat_node()
  * 	status_node()
+ * 	stat_since_parse()
+ * 	stat_since_fnv()
+ * 	stat_since_hash()
+ * 	stat_since_header()
  * 	req_stat_svr()
  * 	req_stat_sched()
  * 	update_state_ct()
@@ -69,6 +73,7 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <stdlib.h>
+#include <string.h>
 #include "libpbs.h"
 #include <ctype.h>
 #include "server_limits.h"
@@ -125,6 +130,10 @@ static int bad;
 
 static int status_que(pbs_queue *, struct batch_request *, pbs_list_head *);
 static int status_node(struct pbsnode *, struct batch_request *, pbs_list_head *);
+static int stat_since_parse(char *, unsigned long long *);
+static unsigned long long stat_since_fnv(unsigned long long, char *);
+static unsigned long long stat_since_hash(unsigned long long, pbs_list_head *);
+static int stat_since_header(struct brp_status *, int);
 static int status_resv(resc_resv *, struct batch_request *, pbs_list_head *);
 
 /**
@@ -560,8 +569,14 @@ req_stat_node(struct batch_request *preq)
 	struct batch_reply  *preply;
 	svrattrl	    *pal;
 	struct pbsnode	    *pnode = NULL;
+	struct brp_status   *pstat;
+	struct brp_status   *pnstat;
+	unsigned long long  since = 0;
+	unsigned long long  sig;
+	unsigned long long  hash;
 	int		    rc   = 0;
 	int		    type = 0;
+	int		    count;
 	int		    i;
 
 	/*
@@ -598,8 +613,8 @@ req_stat_node(struct batch_request *preq)
 	if (type == 0) {		/* get status of the named node */
 		rc = status_node(pnode, preq, &preply->brp_un.brp_status);
 
-	} else {			/* get status of all nodes */
-	
+	} else if (stat_since_parse(preq->rq_extend, &since) == 0) {
+		/* get status of all nodes */
 		for (i = 0; i < svr_totnodes; i++) {
 			pnode = pbsndlist[i];
 
@@ -608,6 +623,60 @@ req_stat_node(struct batch_request *preq)
 			if (rc)
 				break;
 		}
+	} else {
+		/*
+		 * Conditional status: the client holds a copy of the vnodes as of
+		 * generation "since" and wants only those that changed after it.
+		 * The reply leads with a header object (empty name) carrying the
+		 * token for the next request, whether this is a full listing and
+		 * the names of vnodes deleted since.  A vnode's status is encoded
+		 * as usual and hashed; a vnode whose hash or requested attribute
+		 * list differs from the last time is stamped with a new generation.
+		 */
+		pstat = (struct brp_status *)malloc(sizeof(struct brp_status));
+		if (pstat == NULL) {
+			req_reject(PBSE_SYSTEM, 0, preq);
+			return;
+		}
+		pstat->brp_objtype = MGR_OBJ_NODE;
+		pstat->brp_objname[0] = '\0';
+		CLEAR_LINK(pstat->brp_stlink);
+		CLEAR_HEAD(pstat->brp_attr);
+		append_link(&preply->brp_un.brp_status, &pstat->brp_stlink, pstat);
+		preply->brp_count++;
+
+		sig = stat_since_hash(preq->rq_perm, &preq->rq_ind.rq_status.rq_attr);
+		for (i = 0; i < svr_totnodes; i++) {
+			pnode = pbsndlist[i];
+
+			count = preply->brp_count;
+			rc = status_node(pnode, preq,
+				&preply->brp_un.brp_status);
+			if (rc)
+				break;
+			if (preply->brp_count == count)
+				continue;
+
+			pnstat = (struct brp_status *)GET_PRIOR(preply->brp_un.brp_status);
+			hash = stat_since_hash(0, &pnstat->brp_attr);
+			if (pnode->nd_stat_gen == 0 || pnode->nd_stat_hash != hash ||
+				pnode->nd_stat_sig != sig) {
+				pnode->nd_stat_gen = ++node_stat_gen;
+				pnode->nd_stat_hash = hash;
+				pnode->nd_stat_sig = sig;
+			}
+			if (since != 0 && pnode->nd_stat_gen <= since) {
+				delete_link(&pnstat->brp_stlink);
+				free_attrlist(&pnstat->brp_attr);
+				free(pnstat);
+				preply->brp_count--;
+			}
+		}
+		if (!rc) {
+			rc = stat_since_header(pstat, since == 0);
+			if (!rc && since != 0)
+				rc = node_stat_deleted_since(since, &pstat->brp_attr);
+		}
 	}
 
 	if (!rc) {
@@ -699,6 +768,132 @@ status_node(struct pbsnode *pnode, struct batch_request *preq, pbs_list_head *ps
 	return (rc);
 }
 
+/**
+ * @brief
+ * 		stat_since_parse - look for a conditional status token,
+ *		"since=<epoch>.<generation>", in the extend string of a node status
+ *		request.  An empty token, one from another server instance or one
+ *		older than the tombstone floor asks for a full listing.
+ *
+ * @param[in]	extend	-	request extend string, may be NULL
+ * @param[out]	since	-	generation to report changes after, 0 for all
+ *
+ * @return	int
+ * @retval	0	: not a conditional request
+ * @retval	1	: conditional request
+ */
+static int
+stat_since_parse(char *extend, unsigned long long *since)
+{
+	char *p;
+	char *end;
+	long epoch;
+	unsigned long long gen;
+
+	*since = 0;
+	if (extend == NULL || (p = strstr(extend, EXTEND_OPT_STAT_SINCE)) == NULL)
+		return 0;
+
+	if (node_stat_epoch == 0)
+		node_stat_epoch = time_now;
+
+	p += strlen(EXTEND_OPT_STAT_SINCE);
+	epoch = strtol(p, &end, 10);
+	if (end == p || *end != '.' || epoch != (long)node_stat_epoch)
+		return 1;
+	p = end + 1;
+	gen = strtoull(p, &end, 10);
+	if (end == p || gen < node_stat_floor || gen > node_stat_gen)
+		return 1;
+	*since = gen;
+	return 1;
+}
+
+/**
+ * @brief
+ * 		stat_since_fnv - fold a string, including its terminating null,
+ *		into an FNV-1a hash.  A NULL string folds in nothing.
+ *
+ * @param[in]	h	-	hash so far
+ * @param[in]	str	-	string to add
+ *
+ * @return	unsigned long long	- updated hash
+ */
+static unsigned long long
+stat_since_fnv(unsigned long long h, char *str)
+{
+	if (str == NULL)
+		return h;
+	do {
+		h ^= (unsigned char)*str;
+		h *= 1099511628211ULL;
+	} while (*str++ != '\0');
+	return h;
+}
+
+/**
+ * @brief
+ * 		stat_since_hash - FNV-1a hash of a list of svrattrl, used to tell
+ *		whether the encoded status of a vnode has changed.
+ *
+ * @param[in]	seed	-	value mixed in ahead of the list
+ * @param[in]	phead	-	list of svrattrl to hash
+ *
+ * @return	unsigned long long	- hash value
+ */
+static unsigned long long
+stat_since_hash(unsigned long long seed, pbs_list_head *phead)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	svrattrl *pal;
+	int i;
+
+	for (i = 0; i < (int)sizeof(seed); i++) {
+		h ^= (seed >> (i * 8)) & 0xff;
+		h *= 1099511628211ULL;
+	}
+	for (pal = (svrattrl *)GET_NEXT(*phead); pal; pal = (svrattrl *)GET_NEXT(pal->al_link)) {
+		/* hash name, resource and value, each with its terminating null */
+		h = stat_since_fnv(h, pal->al_name);
+		h = stat_since_fnv(h, pal->al_resc);
+		h = stat_since_fnv(h, pal->al_value);
+		h ^= (unsigned char)pal->al_op;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * @brief
+ * 		stat_since_header - fill in the token and full-listing attributes
+ *		of the header object of a conditional node status reply.
+ *
+ * @param[in,out]	pstat	-	header object
+ * @param[in]	full	-	non-zero if every vnode is in the reply
+ *
+ * @return	int
+ * @retval	0	: success
+ * @retval	PBSE_SYSTEM	: out of memory
+ */
+static int
+stat_since_header(struct brp_status *pstat, int full)
+{
+	char token[64];
+	svrattrl *pal;
+
+	snprintf(token, sizeof(token), "%ld.%llu", (long)node_stat_epoch, node_stat_gen);
+	if ((pal = attrlist_create(STAT_SINCE_TOKEN, NULL, strlen(token))) == NULL)
+		return PBSE_SYSTEM;
+	strcpy(pal->al_value, token);
+	append_link(&pstat->brp_attr, &pal->al_link, pal);
+
+	if ((pal = attrlist_create(STAT_SINCE_FULL, NULL, 1)) == NULL)
+		return PBSE_SYSTEM;
+	strcpy(pal->al_value, full ? "1" : "0");
+	append_link(&pstat->brp_attr, &pal->al_link, pal);
+	return 0;
+}
+
 /**
  * @brief
  * 	update_isrunhook - update the value is has_runjob_hook
@@ -1985,6 +1985,12 @@ main(int argc, char *argv[], char *envp[])
 
 		(void)pbs_python_ext_alloc_python_script(hook_script,
 			(struct python_script **) &py_script);
+		/* hook scripts delivered by the server keep their bytecode */
+		if ((py_script != NULL) &&
+			(strlen(hook_script) > strlen(HOOK_SCRIPT_SUFFIX)) &&
+			(strcmp(hook_script + strlen(hook_script) -
+			strlen(HOOK_SCRIPT_SUFFIX), HOOK_SCRIPT_SUFFIX) == 0))
+			py_script->cache_bytecode = 1;
 
 		hook_perf_stat_start(perf_label, HOOK_PERF_START_PYTHON, 0);
 		if (pbs_python_ext_start_interpreter(&svr_interp_data) != 0) {
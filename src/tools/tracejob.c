@@ -47,6 +47,11 @@
  * 	get_cols()
  * 	main()
  * 	parse_log()
+ * 	parse_log_line()
+ * 	scan_log_mmap()
+ * 	parse_struct_rec()
+ * 	match_job_name()
+ * 	add_log_entry()
  * 	sort_by_date()
  * 	sort_by_message()
  * 	strip_path()
@@ -65,7 +70,12 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #if defined(HAVE_SYS_IOCTL_H)
 #include <sys/ioctl.h>
 #endif
@@ -85,8 +95,30 @@ struct log_entry *log_lines;
 int ll_cur_amm;
 int ll_max_amm;
 int has_high_res_timestamp = 0;
+time_t window_begin = 0;	/* -B, 0 if not set */
+time_t window_end = 0;		/* -E, 0 if not set */
 
 static char none[1] = { '\0' };
+
+/* a part of a mapped log file scanned by one thread of scan_log_mmap() */
+struct scan_chunk {
+	const char *start;	/* first byte, at the start of a line */
+	const char *end;	/* one past the last byte */
+	const char *needle;	/* what a matching line holds after a ';' */
+	size_t nlen;
+	const char **lines;	/* start of each line found */
+	size_t *lens;		/* and its length */
+	size_t nlines;
+	size_t maxlines;
+	int threaded;		/* searched by a thread of its own */
+};
+
+/* state of a log_struct_lookup() for parse_struct_rec() */
+struct struct_lookup {
+	char *job;	/* the name of the job */
+	int ind;	/* which log file - index in enum index */
+	int lineno;	/* records passed so far */
+};
 /**
  * @brief
  * 		returns columns, in characters from winsize struct.
@@ -150,6 +182,10 @@ main(int argc, char *argv[])
 	struct stat sbuf;
 #endif /* localmod 022 */
 	int unknw_job = 0;
+	int nthreads = 0;	/* search mapped files with threads if > 0 */
+	time_t day_begin;
+	struct tm tm_day;
+	struct struct_lookup lookup;	/* state of a structured index search */
 
 	/*the real deal or output pbs_version and exit?*/
 	PRINT_VERSION_AND_EXIT(argc, argv);
@@ -164,7 +200,7 @@ main(int argc, char *argv[])
 
 	pbs_loadconf(0);
 
-	while ((c = getopt(argc, argv, "zvamslw:p:n:f:c:-:")) != EOF) {
+	while ((c = getopt(argc, argv, "zvamslw:p:n:f:c:t:B:E:-:")) != EOF) {
 		switch (c) {
 			case 'v':
 				verbose = 1;
@@ -206,6 +242,22 @@ main(int argc, char *argv[])
 				prefix_path = optarg;
 				break;
 
+			case 't':
+				nthreads = strtol(optarg, &endp, 10);
+				if ((*endp != '\0') || (nthreads < 1))
+					error = 1;
+				break;
+
+			case 'B':
+				if ((window_begin = cvtdate(optarg)) == -1)
+					error = 1;
+				break;
+
+			case 'E':
+				if ((window_end = cvtdate(optarg)) == -1)
+					error = 1;
+				break;
+
 			case 'n':
 				number_of_days = strtol(optarg, &endp, 10);
 				if (*endp != '\0')
@@ -257,7 +309,8 @@ main(int argc, char *argv[])
 	/* no jobs */
 	if (error || argc == optind) {
 		printf(
-			"USAGE: %s [-a|s|l|m|v] [-w size] [-p path] [-n days] [-f filter_type] job_identifier...\n",
+			"USAGE: %s [-a|s|l|m|v] [-w size] [-p path] [-n days] [-f filter_type]\n"
+			"       [-t threads] [-B begin_time] [-E end_time] job_identifier...\n",
 			strip_path(argv[0]));
 
 		printf(
@@ -273,7 +326,10 @@ main(int argc, char *argv[])
 			"   -s : don't use server log files\n"
 			"   -l : don't use scheduler log files\n"
 			"   -m : don't use mom log files\n"
-			"   -v : verbose mode - show more error messages\n");
+			"   -v : verbose mode - show more error messages\n"
+			"   -t : search log files with this many threads\n"
+			"   -B : report entries logged at or after [[CC]YY]MMDDhhmm[.SS]\n"
+			"   -E : report entries logged at or before [[CC]YY]MMDDhhmm[.SS]\n");
 
 		printf("\n       %s --version\n", strip_path(argv[0]));
 		printf("   --version : display version only\n\n");
@@ -293,6 +349,11 @@ main(int argc, char *argv[])
 	time(&t);
 	t_save = t;
 
+	/* look back far enough to reach the start of the window */
+	if (window_begin && (window_begin < t_save) &&
+		((t_save - window_begin) / SECONDS_IN_DAY + 2 > number_of_days))
+		number_of_days = (t_save - window_begin) / SECONDS_IN_DAY + 2;
+
 	for (opt = optind; opt < argc; opt++) {
 		ll_cur_amm = 0;	/* reset line count to zero */
 		for (i = 0, t = t_save; i < number_of_days; i++, t -= SECONDS_IN_DAY) {
@@ -301,6 +362,15 @@ main(int argc, char *argv[])
 			day = tm_ptr->tm_mday;
 			year = tm_ptr->tm_year;
 
+			/* skip the days outside the window, with an hour to spare for DST */
+			tm_day = *tm_ptr;
+			tm_day.tm_hour = tm_day.tm_min = tm_day.tm_sec = 0;
+			tm_day.tm_isdst = -1;
+			day_begin = mktime(&tm_day);
+			if ((window_end && (day_begin > window_end)) ||
+				(window_begin && (day_begin + SECONDS_IN_DAY + 3600 <= window_begin)))
+				continue;
+
 			for (j = 0; j < 4; j++) {
 				if ((j == IND_ACCT && no_acct) || (j == IND_SERVER && no_svr) ||
 					(j == IND_MOM && no_mom)   || (j == IND_SCHED && no_schd))
@@ -315,6 +385,19 @@ main(int argc, char *argv[])
 				filename = log_path(prefix_path, j, month, day, year);
 #endif /* localmod 022 */
 
+				/* the structured index, when there is one, saves the scan */
+				lookup.job = argv[opt];
+				lookup.ind = j;
+				lookup.lineno = 0;
+				if (log_struct_lookup(filename, argv[opt], parse_struct_rec, &lookup) >= 0)
+					continue;
+
+				if (nthreads > 0) {
+					if ((scan_log_mmap(filename, argv[opt], j, nthreads) == -1) && verbose)
+						perror(filename);
+					continue;
+				}
+
 				if ((fp = fopen(filename, "r")) == NULL) {
 					if (verbose)
 						perror(filename);
@@ -391,17 +474,11 @@ main(int argc, char *argv[])
 void
 parse_log(FILE *fp, char *job, int ind)
 {
-	struct log_entry tmp;	/* temporary log entry */
 	char *buf;		/* buffer to read in from file */
 	char *tbuf;		/* temporarily hold realloc's for main buffer */
 	char job_buf[128];	/* hold the jobid and the . */
-	char *p;		/* pointer to use for strtok */
-	int field_count;	/* which field in log entry */
 	int j = 0;
-	struct tm tms;		/* used to convert date to unix date */
 	int lineno = 0;
-	int slen;
-	char *pdot;
 	int buf_size = 16384;	/* initial buffer size */
 	int break_fl = 0;
 
@@ -409,8 +486,6 @@ parse_log(FILE *fp, char *job, int ind)
 	if (!buf)
 		return;
 
-	tms.tm_isdst = -1;	/* mktime() will attempt to figure it out */
-
 	strcpy(job_buf, job);
 
 	while (fgets(buf, buf_size, fp) != NULL) {
@@ -432,144 +507,574 @@ parse_log(FILE *fp, char *job, int ind)
 		lineno++;
 		j++;
 		buf[strlen(buf)-1] = '\0';
-		p = strtok(buf, ";");
-		field_count = 0;
-		memset(&tmp, 0, sizeof(struct log_entry));
-
-		for (field_count = 0; field_count < 6 && p != NULL; field_count++) {
-			switch (field_count) {
-				case FLD_DATE:
-					tmp.date = p;
-					if (ind == IND_ACCT)
-						field_count = 2;
-					break;
-
-				case FLD_EVENT:
-					tmp.event = p;
-					break;
-
-				case FLD_OBJ:
-					tmp.obj = p;
-					break;
-
-				case FLD_TYPE:
-					tmp.type = p;
-					break;
-
-				case FLD_NAME:
-					tmp.name = p;
-					break;
-
-				case FLD_MSG:
-					tmp.msg = p;
-					break;
-
-				default:
-					printf("Field count too big!\n");
-					printf("%s\n", p);
-			}
+		parse_log_line(buf, job_buf, ind, lineno);
+	}
+	free(buf);
+}
+
+/**
+ * @brief
+ *		parse_log_line - split one line of a server, mom, scheduler or
+ *		    accounting log at its ';' separators and, if the object
+ *		    name field matches the job, add it to log_lines.
+ *
+ *		A daemon log line has six fields: date, event, object class,
+ *		object type, name and message.  An accounting line has only
+ *		date, record type, name and message, so for IND_ACCT the event
+ *		and object fields are skipped and the record type is kept as
+ *		the object type.  The message runs to the end of the line and
+ *		keeps any ';' it contains.  Shared by the stdio scan of
+ *		parse_log() and the mmap scan of scan_log_mmap().
+ *
+ * @param[in,out]	line	-	one line, newline stripped; the ';'
+ *					separators are overwritten by strtok()
+ * @param[in]	job	-	the job id to match, see match_job_name()
+ * @param[in]	ind	-	which log file - index in enum index
+ * @param[in]	lineno	-	line number in the file, breaks ties between
+ *				lines with the same time stamp when sorting
+ *
+ *	@return	nothing
+ *	@note
+ *		add_log_entry() copies the fields it keeps, so line may be
+ *		reused once this returns.  Modifies global variables:
+ *		log_lines, ll_cur_amm, ll_max_amm
+ *
+ * @par MT-safe: No, uses strtok() and the global log_lines
+ */
+void
+parse_log_line(char *line, char *job, int ind, int lineno)
+{
+	struct log_entry tmp;	/* temporary log entry */
+	char *p;		/* pointer to use for strtok */
+	int field_count;	/* which field in log entry */
+
+	p = strtok(line, ";");
+	field_count = 0;
+	memset(&tmp, 0, sizeof(struct log_entry));
+
+	for (field_count = 0; field_count < 6 && p != NULL; field_count++) {
+		switch (field_count) {
+			case FLD_DATE:
+				tmp.date = p;
+				if (ind == IND_ACCT)
+					field_count = 2;
+				break;
+
+			case FLD_EVENT:
+				tmp.event = p;
+				break;
+
+			case FLD_OBJ:
+				tmp.obj = p;
+				break;
+
+			case FLD_TYPE:
+				tmp.type = p;
+				break;
 
-			p = strtok(NULL, ";");
+			case FLD_NAME:
+				tmp.name = p;
+				break;
+
+			case FLD_MSG:
+				/* the message is the rest of the line, ';' and all */
+				tmp.msg = p;
+				if ((p = strtok(NULL, "")) != NULL)
+					p[-1] = ';';
+				p = NULL;
+				continue;
+
+			default:
+				printf("Field count too big!\n");
+				printf("%s\n", p);
 		}
 
-		pdot = strchr(job_buf, (int)'.');
-		if (pdot == NULL && tmp.name != NULL) {
-			int	tlen = strlen(job_buf);
+		p = strtok(NULL, ";");
+	}
 
-			slen = strcspn(tmp.name, ".");
-			if (tlen > slen)
-				slen = tlen;
-		} else
-			slen = strlen(job_buf);
+	if (match_job_name(job, tmp.name))
+		add_log_entry(&tmp, ind, lineno);
+}
 
-		if (tmp.name != NULL && strncmp(job_buf, tmp.name, slen) == 0) {
-			if (ll_cur_amm >= ll_max_amm)
-				alloc_more_space();
+/**
+ * @brief
+ *		line_time - get the time stamp at the start of a log line
+ *
+ * @param[in]	p	-	start of the line
+ * @param[in]	end	-	end of the mapped file
+ *
+ * @return	time_t
+ * @retval	the time of the line
+ * @retval	-1	: the line does not start with a time stamp
+ */
+static time_t
+line_time(const char *p, const char *end)
+{
+	char buf[20];
+	struct tm tms;
 
-			free_log_entry(&log_lines[ll_cur_amm]);
+	/* MM/DD/YYYY HH:MM:SS */
+	if ((end - p < 19) || (p[2] != '/') || (p[10] != ' '))
+		return -1;
+	memcpy(buf, p, 19);
+	buf[19] = '\0';
+	memset(&tms, 0, sizeof(tms));
+	tms.tm_isdst = -1;
+	if (sscanf(buf, "%d/%d/%d %d:%d:%d", &tms.tm_mon, &tms.tm_mday,
+		&tms.tm_year, &tms.tm_hour, &tms.tm_min, &tms.tm_sec) != 6)
+		return -1;
+	tms.tm_year -= 1900;
+	tms.tm_mon--;
+	return mktime(&tms);
+}
 
-			if (tmp.date != NULL) {
-				/*
-				 * We need to parse the time string.
-				 * The string will either have high res logging or not.
-				 * The high res logging is after the dot after the seconds field.
-				 */
-				log_lines[ll_cur_amm].date = strdup(tmp.date);
-				if ((ind != IND_ACCT) && (strchr(tmp.date, '.'))) {
-					/* Parse time string looking for high res logging.  If we don't parse 7 fields, we have a invalid log time. */
-					if (sscanf(tmp.date, "%d/%d/%d %d:%d:%d.%ld", &tms.tm_mon,
-					    &tms.tm_mday, &tms.tm_year, &tms.tm_hour, &tms.tm_min,
-					    &tms.tm_sec, &(log_lines[ll_cur_amm].highres)) != 7) {
-						log_lines[ll_cur_amm].date_time = -1;	/* error in date field */
-						log_lines[ll_cur_amm].highres = NO_HIGH_RES_TIMESTAMP;
-					} else { /* We found all 7 fields, correctly formed time string */
-						has_high_res_timestamp = 1;
-						if (tms.tm_year > 1900)
-							tms.tm_year -= 1900;
-						/* The number of months since January,
- 						 * in the range 0 to 11 for mktime()
- 						 */
-						tms.tm_mon--;
-						log_lines[ll_cur_amm].date_time = mktime(&tms);
-					}
-				} else { /* Normal time string */
-					if (sscanf(tmp.date, "%d/%d/%d %d:%d:%d", &tms.tm_mon, &tms.tm_mday,
-					    &tms.tm_year, &tms.tm_hour, &tms.tm_min, &tms.tm_sec) != 6) {
-						log_lines[ll_cur_amm].date_time = -1;	/* error in date field */
-					} else { /* We found all 6 fields, correctly formed time string */
-						if (tms.tm_year > 1900)
-							tms.tm_year -= 1900;
-						tms.tm_mon--;         /* The number of months since January, in the range 0 to 11 for mktime */
-						log_lines[ll_cur_amm].date_time = mktime(&tms);
-					}
-					log_lines[ll_cur_amm].highres = NO_HIGH_RES_TIMESTAMP;
+/**
+ * @brief
+ *		log_bsearch - find by binary search where the lines logged at or
+ *		    after a time start in a mapped log file.  Lines are assumed
+ *		    to be in time order; the caller allows some slack for the
+ *		    few that are not.
+ *
+ * @param[in]	map	-	the mapped file
+ * @param[in]	lo	-	offset of a line start to search from
+ * @param[in]	hi	-	offset to search to
+ * @param[in]	when	-	the time
+ *
+ * @return	size_t
+ * @retval	offset of the first line stamped at or after when, or hi
+ */
+static size_t
+log_bsearch(const char *map, size_t lo, size_t hi, time_t when)
+{
+	const char *q;
+	size_t mid;
+	size_t s;
+	time_t t;
+
+	/* lo is always a line start before the answer, hi at or after it */
+	while (hi - lo > 65536) {
+		mid = lo + (hi - lo) / 2;
+		/* the first line with a time stamp after mid */
+		t = -1;
+		for (s = mid; s < hi; s = q - map + 1) {
+			if ((q = memchr(map + s, '\n', hi - s)) == NULL || (size_t)(q - map + 1) >= hi) {
+				s = hi;
+				break;
+			}
+			if ((t = line_time(q + 1, map + hi)) != -1) {
+				s = q - map + 1;
+				break;
+			}
+		}
+		if (t == -1)
+			hi = mid;
+		else if (t < when)
+			lo = s;
+		else
+			hi = s;
+	}
 
-				}
+	while (lo < hi) {
+		if (((t = line_time(map + lo, map + hi)) != -1) && (t >= when))
+			return lo;
+		if ((q = memchr(map + lo, '\n', hi - lo)) == NULL)
+			break;
+		lo = q - map + 1;
+	}
+	return hi;
+}
+
+/**
+ * @brief
+ *		scan_chunk - thread routine of scan_log_mmap(), find the lines of a
+ *		    chunk that have the needle at the start of a field.  The
+ *		    search runs on memchr(), which the C library vectorizes.
+ *
+ * @param[in,out]	arg	-	the struct scan_chunk to search
+ *
+ * @return	NULL
+ */
+static void *
+scan_chunk(void *arg)
+{
+	struct scan_chunk *ch = arg;
+	const char *p = ch->start;
+	const char *hit;
+	const char *ls;
+	const char *le;
+	const char **nlines;
+	size_t *nlens;
+
+	while ((size_t)(ch->end - p) >= ch->nlen) {
+		if ((hit = memchr(p, ch->needle[0], ch->end - p - ch->nlen + 1)) == NULL)
+			break;
+		if ((hit == ch->start) || (hit[-1] != ';') ||
+			(memcmp(hit, ch->needle, ch->nlen) != 0)) {
+			p = hit + 1;
+			continue;
+		}
+
+		for (ls = hit; (ls > ch->start) && (ls[-1] != '\n'); ls--)
+			;
+		if ((le = memchr(hit, '\n', ch->end - hit)) == NULL)
+			le = ch->end;
+
+		if (ch->nlines == ch->maxlines) {
+			ch->maxlines = ch->maxlines ? ch->maxlines * 2 : 256;
+			nlines = realloc(ch->lines, ch->maxlines * sizeof(char *));
+			nlens = realloc(ch->lens, ch->maxlines * sizeof(size_t));
+			if (nlines != NULL)
+				ch->lines = nlines;
+			if (nlens != NULL)
+				ch->lens = nlens;
+			if ((nlines == NULL) || (nlens == NULL)) {
+				ch->maxlines = ch->nlines;
+				break;
 			}
-			if (tmp.event != NULL)
-				log_lines[ll_cur_amm].event = strdup(tmp.event);
-			else
-				log_lines[ll_cur_amm].event = none;
-			if (tmp.obj != NULL)
-				log_lines[ll_cur_amm].obj = strdup(tmp.obj);
-			else
-				log_lines[ll_cur_amm].obj = none;
-			if (tmp.type != NULL)
-				log_lines[ll_cur_amm].type = strdup(tmp.type);
-			else
-				log_lines[ll_cur_amm].type = none;
-			if (tmp.name != NULL)
-				log_lines[ll_cur_amm].name = strdup(tmp.name);
+		}
+		ch->lines[ch->nlines] = ls;
+		ch->lens[ch->nlines] = le - ls;
+		ch->nlines++;
+		p = le + 1;
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *		scan_log_mmap - parse out the entries of a log file for a job like
+ *		    parse_log(), but map the file and search it with several
+ *		    threads.  With a time window, only the part of the file
+ *		    inside it is searched.
+ *
+ * @param[in]	filename	-	the log file
+ * @param[in]	job	-	the name of the job
+ * @param[in]	ind	-	which log file - index in enum index
+ * @param[in]	nthreads	-	how many threads to search with
+ *
+ * @return	int
+ * @retval	0	: the file was searched
+ * @retval	-1	: it could not be opened or mapped, errno is set
+ *
+ * @par MT-safe: No
+ */
+int
+scan_log_mmap(char *filename, char *job, int ind, int nthreads)
+{
+	struct scan_chunk *chunks;
+	pthread_t *tids;
+	struct stat sb;
+	char needle[128];
+	char *map;
+	char *line = NULL;
+	char *tmp;
+	size_t linesz = 0;
+	size_t lo;
+	size_t hi;
+	size_t pos;
+	size_t i;
+	size_t k;
+	int lineno = 0;
+	int fd;
+	int n;
+
+	if ((fd = open(filename, O_RDONLY)) == -1)
+		return -1;
+	if (fstat(fd, &sb) == -1) {
+		close(fd);
+		return -1;
+	}
+	if (sb.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	(void)madvise(map, sb.st_size, MADV_SEQUENTIAL);
+
+	/* allow a minute of slack for lines written out of order */
+	lo = 0;
+	hi = sb.st_size;
+	if (window_end)
+		hi = log_bsearch(map, lo, hi, window_end + 61);
+	if (window_begin)
+		lo = log_bsearch(map, lo, hi, window_begin - 60);
+
+	/* every name of the job starts with its id up to the first '.' */
+	snprintf(needle, sizeof(needle), "%s", job);
+	needle[strcspn(needle, ".")] = '\0';
+
+	/* no point in threads for less than a megabyte each */
+	if ((size_t)nthreads > (hi - lo) / (1024 * 1024) + 1)
+		nthreads = (hi - lo) / (1024 * 1024) + 1;
+	chunks = calloc(nthreads, sizeof(struct scan_chunk));
+	tids = calloc(nthreads, sizeof(pthread_t));
+	if ((chunks == NULL) || (tids == NULL) || (*needle == '\0')) {
+		free(chunks);
+		free(tids);
+		munmap(map, sb.st_size);
+		return (*needle == '\0') ? 0 : -1;
+	}
+
+	pos = lo;
+	for (n = 0; n < nthreads; n++) {
+		chunks[n].start = map + pos;
+		if (n == nthreads - 1)
+			pos = hi;
+		else {
+			pos = lo + (hi - lo) / nthreads * (n + 1);
+			if (pos < (size_t)(chunks[n].start - map))
+				pos = chunks[n].start - map;
+			if ((tmp = memchr(map + pos, '\n', hi - pos)) == NULL)
+				pos = hi;
 			else
-				log_lines[ll_cur_amm].name = none;
-			if (tmp.msg != NULL)
-				log_lines[ll_cur_amm].msg = strdup(tmp.msg);
+				pos = tmp - map + 1;
+		}
+		chunks[n].end = map + pos;
+		chunks[n].needle = needle;
+		chunks[n].nlen = strlen(needle);
+		if (n > 0) {
+			if (pthread_create(&tids[n], NULL, scan_chunk, &chunks[n]) == 0)
+				chunks[n].threaded = 1;
 			else
-				log_lines[ll_cur_amm].msg = none;
-			switch (ind) {
-				case IND_SERVER:
-					log_lines[ll_cur_amm].log_file = 'S';
-					break;
-
-				case IND_SCHED:
-					log_lines[ll_cur_amm].log_file = 'L';
-					break;
-
-				case IND_ACCT:
-					log_lines[ll_cur_amm].log_file = 'A';
-					break;
-
-				case IND_MOM:
-					log_lines[ll_cur_amm].log_file = 'M';
-					break;
-				default:
-					log_lines[ll_cur_amm].log_file = 'U';	/* undefined */
+				scan_chunk(&chunks[n]);	/* do it here then */
+		}
+	}
+	scan_chunk(&chunks[0]);
+	for (n = 1; n < nthreads; n++) {
+		if (chunks[n].threaded)
+			pthread_join(tids[n], NULL);
+	}
+
+	/* the chunks are in file order, so the entries come out in it too */
+	for (n = 0; n < nthreads; n++) {
+		for (i = 0; i < chunks[n].nlines; i++) {
+			k = chunks[n].lens[i];
+			if (k + 1 > linesz) {
+				if ((tmp = realloc(line, k + 1)) == NULL)
+					continue;
+				line = tmp;
+				linesz = k + 1;
 			}
-			log_lines[ll_cur_amm].lineno = lineno;
-			ll_cur_amm++;
+			memcpy(line, chunks[n].lines[i], k);
+			line[k] = '\0';
+			parse_log_line(line, job, ind, ++lineno);
 		}
+		free(chunks[n].lines);
+		free(chunks[n].lens);
 	}
-	free(buf);
+
+	free(line);
+	free(chunks);
+	free(tids);
+	munmap(map, sb.st_size);
+	return 0;
+}
+
+/**
+ * @brief
+ *		parse_struct_rec - log_struct_lookup() callback, turn a record of
+ *		    a structured log or accounting stream into a log entry like
+ *		    parse_log() does for a line of text
+ *
+ * @param[in]	rec	-	the record
+ * @param[in]	arg	-	the struct struct_lookup of the search
+ *
+ * @return	int
+ * @retval	0	: always, to go on with the next record
+ *
+ * @par MT-safe: No
+ */
+int
+parse_struct_rec(struct log_struct_rec *rec, void *arg)
+{
+	struct struct_lookup *lookup = arg;
+	struct log_entry tmp;
+	struct tm *ptm;
+	char date[96];	/* "%02d/.../%06ld" with full int and long widths */
+	char event[16];
+	time_t t = rec->sec;
+
+	memset(&tmp, 0, sizeof(struct log_entry));
+	tmp.name = log_struct_field(rec, "name");
+	/* the index is by sequence number, so check the whole id */
+	if (!match_job_name(lookup->job, tmp.name))
+		return 0;
+
+	ptm = localtime(&t);
+	if (rec->usec >= 0)
+		snprintf(date, sizeof(date), "%02d/%02d/%04d %02d:%02d:%02d.%06ld",
+			ptm->tm_mon + 1, ptm->tm_mday, ptm->tm_year + 1900,
+			ptm->tm_hour, ptm->tm_min, ptm->tm_sec, rec->usec);
+	else
+		snprintf(date, sizeof(date), "%02d/%02d/%04d %02d:%02d:%02d",
+			ptm->tm_mon + 1, ptm->tm_mday, ptm->tm_year + 1900,
+			ptm->tm_hour, ptm->tm_min, ptm->tm_sec);
+	tmp.date = date;
+
+	if (lookup->ind == IND_ACCT) {
+		tmp.type = log_struct_field(rec, "type");
+	} else {
+		snprintf(event, sizeof(event), "%04x", rec->eventtype);
+		tmp.event = event;
+		tmp.obj = log_struct_field(rec, "daemon");
+		tmp.type = log_struct_field(rec, "class");
+	}
+	tmp.msg = log_struct_field(rec, "msg");
+
+	add_log_entry(&tmp, lookup->ind, ++lookup->lineno);
+	return 0;
+}
+
+/**
+ * @brief
+ *		match_job_name - tell whether the object name of a log entry is
+ *		    the job asked for.  A job id given without a server part
+ *		    matches any server.
+ *
+ * @param[in]	job	-	the name of the job
+ * @param[in]	name	-	the object name of the log entry, may be NULL
+ *
+ * @return	int
+ * @retval	1	: the entry is for the job
+ * @retval	0	: it is not
+ */
+int
+match_job_name(char *job, char *name)
+{
+	int slen;
+
+	if (name == NULL)
+		return 0;
+
+	if (strchr(job, (int)'.') == NULL) {
+		int	tlen = strlen(job);
+
+		slen = strcspn(name, ".");
+		if (tlen > slen)
+			slen = tlen;
+	} else
+		slen = strlen(job);
+
+	return (strncmp(job, name, slen) == 0);
+}
+
+/**
+ * @brief
+ *		add_log_entry - copy a matching log entry into log_lines,
+ *		    converting its date to a unix date
+ *
+ * @param[in]	tmp	-	the entry, pointing into the caller's buffers
+ * @param[in]	ind	-	which log file - index in enum index
+ * @param[in]	lineno	-	position of the entry in its log file
+ *
+ *	@return	nothing
+ *	@note
+ *		modifies global variables: loglines, ll_cur_amm, ll_max_amm
+ *
+ * @par MT-safe: No
+ */
+void
+add_log_entry(struct log_entry *tmp, int ind, int lineno)
+{
+	struct tm tms;		/* used to convert date to unix date */
+
+	tms.tm_isdst = -1;	/* mktime() will attempt to figure it out */
+
+	if (ll_cur_amm >= ll_max_amm)
+		alloc_more_space();
+
+	free_log_entry(&log_lines[ll_cur_amm]);
+
+	if (tmp->date != NULL) {
+		/*
+		 * We need to parse the time string.
+		 * The string will either have high res logging or not.
+		 * The high res logging is after the dot after the seconds field.
+		 */
+		log_lines[ll_cur_amm].date = strdup(tmp->date);
+		if ((ind != IND_ACCT) && (strchr(tmp->date, '.'))) {
+			/* Parse time string looking for high res logging.  If we don't parse 7 fields, we have a invalid log time. */
+			if (sscanf(tmp->date, "%d/%d/%d %d:%d:%d.%ld", &tms.tm_mon,
+			    &tms.tm_mday, &tms.tm_year, &tms.tm_hour, &tms.tm_min,
+			    &tms.tm_sec, &(log_lines[ll_cur_amm].highres)) != 7) {
+				log_lines[ll_cur_amm].date_time = -1;	/* error in date field */
+				log_lines[ll_cur_amm].highres = NO_HIGH_RES_TIMESTAMP;
+			} else { /* We found all 7 fields, correctly formed time string */
+				has_high_res_timestamp = 1;
+				if (tms.tm_year > 1900)
+					tms.tm_year -= 1900;
+				/* The number of months since January,
+				 * in the range 0 to 11 for mktime()
+				 */
+				tms.tm_mon--;
+				log_lines[ll_cur_amm].date_time = mktime(&tms);
+			}
+		} else { /* Normal time string */
+			if (sscanf(tmp->date, "%d/%d/%d %d:%d:%d", &tms.tm_mon, &tms.tm_mday,
+			    &tms.tm_year, &tms.tm_hour, &tms.tm_min, &tms.tm_sec) != 6) {
+				log_lines[ll_cur_amm].date_time = -1;	/* error in date field */
+			} else { /* We found all 6 fields, correctly formed time string */
+				if (tms.tm_year > 1900)
+					tms.tm_year -= 1900;
+				tms.tm_mon--;         /* The number of months since January, in the range 0 to 11 for mktime */
+				log_lines[ll_cur_amm].date_time = mktime(&tms);
+			}
+			log_lines[ll_cur_amm].highres = NO_HIGH_RES_TIMESTAMP;
+
+		}
+	}
+	if (tmp->event != NULL)
+		log_lines[ll_cur_amm].event = strdup(tmp->event);
+	else
+		log_lines[ll_cur_amm].event = none;
+	if (tmp->obj != NULL)
+		log_lines[ll_cur_amm].obj = strdup(tmp->obj);
+	else
+		log_lines[ll_cur_amm].obj = none;
+	if (tmp->type != NULL)
+		log_lines[ll_cur_amm].type = strdup(tmp->type);
+	else
+		log_lines[ll_cur_amm].type = none;
+	if (tmp->name != NULL)
+		log_lines[ll_cur_amm].name = strdup(tmp->name);
+	else
+		log_lines[ll_cur_amm].name = none;
+	if (tmp->msg != NULL)
+		log_lines[ll_cur_amm].msg = strdup(tmp->msg);
+	else
+		log_lines[ll_cur_amm].msg = none;
+	switch (ind) {
+		case IND_SERVER:
+			log_lines[ll_cur_amm].log_file = 'S';
+			break;
+
+		case IND_SCHED:
+			log_lines[ll_cur_amm].log_file = 'L';
+			break;
+
+		case IND_ACCT:
+			log_lines[ll_cur_amm].log_file = 'A';
+			break;
+
+		case IND_MOM:
+			log_lines[ll_cur_amm].log_file = 'M';
+			break;
+		default:
+			log_lines[ll_cur_amm].log_file = 'U';	/* undefined */
+	}
+	log_lines[ll_cur_amm].lineno = lineno;
+
+	/* keep entries with a bad date, they may still tell something */
+	if ((log_lines[ll_cur_amm].date_time != -1) &&
+		((window_begin && (log_lines[ll_cur_amm].date_time < window_begin)) ||
+		(window_end && (log_lines[ll_cur_amm].date_time > window_end)))) {
+		free_log_entry(&log_lines[ll_cur_amm]);
+		return;
+	}
+	ll_cur_amm++;
 }
 
 /**
@@ -111,6 +111,11 @@ struct log_entry
 /* prototypes */
 int sort_by_date(const void *v1, const void *v2);
 void parse_log(FILE *fp, char *job, int act);
+void parse_log_line(char *line, char *job, int ind, int lineno);
+int scan_log_mmap(char *filename, char *job, int ind, int nthreads);
+int parse_struct_rec(struct log_struct_rec *rec, void *arg);
+int match_job_name(char *job, char *name);
+void add_log_entry(struct log_entry *tmp, int ind, int lineno);
 char *strip_path(char *path);
 void free_log_entry(struct log_entry *lg);
 void line_wrap(char *line, int start, int end);
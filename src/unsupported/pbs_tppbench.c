@@ -0,0 +1,1560 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file	pbs_tppbench.c
+ *
+ * @brief
+ *	Throughput and latency benchmark for TPP and pbs_comm
+ *
+ * @par Functionality:
+ *	Simulates a large number of TPP leaves on one host, each with its own
+ *	TCP connection to a pbs_comm router, and drives a configurable mix of
+ *	message sizes, unicast and multicast traffic through the router.
+ *
+ *	The TPP client library supports a single leaf per process, so the
+ *	simulated leaves speak the TPP wire protocol directly (JOIN, DATA and
+ *	MCAST_DATA packets) from a few IO threads. Every message carries its
+ *	send time, and the receiving leaf records the delivery latency.
+ *
+ *	By default a router is started in a forked child on the loopback
+ *	interface, running the same Libtpp router code as pbs_comm, and
+ *	honouring the PBS_TPP_* environment settings. TPP does not take
+ *	loopback names, so the router is named after the first other address
+ *	of the host, or the name given with -H. With -r an existing
+ *	pbs_comm is used instead, and -P gives its pid to account its CPU.
+ *
+ *	Leaves authenticate with reserved ports, so this must run as root
+ *	against a router that allows resvport authentication. Against the
+ *	loopback router each leaf uses its own 127/8 source address; against
+ *	a remote router the leaves are spread over the addresses given with
+ *	-a, about 500 leaves per address.
+ *
+ *	With -V every message is filled with content derived from a seed it
+ *	carries, and the receiving leaf checks it, so that data mixed up or
+ *	overwritten on the way through the router is reported.
+ */
+
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <ifaddrs.h>
+#include "pbs_internal.h"
+#include "pbs_version.h"
+#include "auth.h"
+#include "avltree.h"
+#include "tpp_internal.h"
+
+#define BENCH_DEF_PORT		17099
+#define BENCH_MAGIC		0x54505042	/* "TPPB" */
+#define BENCH_MAX_SIZES		16
+#define BENCH_MAX_PKT		(64 * 1024 * 1024)
+#define BENCH_MAX_OUT		(1024 * 1024)	/* stop generating for a leaf with this much unsent */
+#define BENCH_RECV_CHUNK	(64 * 1024)
+#define BENCH_BURST		256		/* max messages generated per loop per thread */
+#define BENCH_PORTS_PER_ADDR	500		/* reserved ports used per source address */
+#define BENCH_JOIN_TIMEOUT	60
+
+/* benchmark phases */
+#define PHASE_JOIN	0
+#define PHASE_WARMUP	1
+#define PHASE_MEASURE	2
+#define PHASE_STOP	3
+
+/* message kinds */
+#define MSG_PROBE	0	/* sent by a leaf to itself to find out it is registered */
+#define MSG_DATA	1
+
+/*
+ * latency histogram, the first 64 buckets are exact, after that each power
+ * of two is split into 32 buckets, so values are kept to within 3%
+ */
+#define HIST_LINEAR	64
+#define HIST_SUB	32
+#define HIST_BUCKETS	(HIST_LINEAR + 59 * HIST_SUB)
+
+/* header at the start of every payload */
+typedef struct {
+	unsigned int magic;
+	unsigned int kind;
+	unsigned long long send_ns;
+	unsigned long long seed;	/* of the content after the header, 0 if not to be verified */
+} bench_msg_t;
+
+typedef struct {
+	char *data;
+	size_t len;
+	size_t size;
+} bench_buf_t;
+
+typedef struct {
+	int fd;
+	int idx;
+	tpp_addr_t addr;	/* address the leaf registered with the router */
+	int joined;		/* own probe came back, so router knows the leaf */
+	time_t last_probe;
+	int em_out;		/* waiting for EM_OUT */
+	bench_buf_t in;
+	bench_buf_t out;
+} bench_leaf_t;
+
+typedef struct {
+	pthread_t tid;
+	int id;
+	void *em_ctx;
+	bench_leaf_t **leaves;
+	int nleaves;
+	int next;			/* next leaf to generate a message from */
+	unsigned long long rnd;
+	char *payload;
+	tpp_mcast_pkt_info_t *minfo;
+	unsigned long long gen_count;	/* messages generated, for rate limiting */
+
+	/* counted while measuring */
+	unsigned long long sent_ucast;
+	unsigned long long sent_mcast;
+	unsigned long long delivered;
+	unsigned long long delivered_bytes;
+	unsigned long long noroute;
+	unsigned long long errors;
+	unsigned long long max_lat;
+
+	/* counted in all phases, with -V */
+	unsigned long long verified;
+	unsigned long long corrupt;
+	unsigned long long hist[HIST_BUCKETS];
+} bench_thrd_t;
+
+/* configuration */
+static char *router_host = NULL;
+static char *router_name = NULL;	/* name of the loopback router */
+static int router_port = BENCH_DEF_PORT;
+static pid_t router_pid = -1;
+static int router_threads = 4;
+static int num_leaves = 1000;
+static int num_thrds = 4;
+static int sizes[BENCH_MAX_SIZES] = {1024};
+static int num_sizes = 1;
+static int max_size = 1024;
+static int mcast_pct = 0;
+static int fanout = 16;
+static long window = 1000;
+static double rate = 0;
+static int duration = 10;
+static int warmup = 2;
+static int compress = 0;
+static int codec = TPP_CODEC_ZLIB;
+static int compr_min = TPP_COMPR_SIZE;
+static int verify = 0;
+static struct in_addr *src_addrs = NULL;
+static int num_src_addrs = 0;
+
+/* shared state */
+static bench_leaf_t *leaves = NULL;
+static bench_thrd_t *thrds = NULL;
+static bench_leaf_t **fd_map = NULL;	/* leaf by connection fd */
+static int fd_map_sz = 0;
+static volatile int phase = PHASE_JOIN;
+static long inflight = 0;
+static int joined = 0;
+static unsigned long long start_ns;
+static unsigned long long measure_ns;
+
+/**
+ * @brief
+ *	Get the current monotonic time in nanoseconds
+ *
+ * @return time in nanoseconds
+ *
+ */
+static unsigned long long
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief
+ *	xorshift random number generator, one state per thread
+ *
+ * @param[in,out] s - the state
+ *
+ * @return next random number
+ *
+ */
+static unsigned long long
+next_rnd(unsigned long long *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+/**
+ * @brief
+ *	Fill a payload after its header with somewhat compressible content
+ *	derived from a seed
+ *
+ * @param[out] p - the payload
+ * @param[in] len - length of the payload
+ * @param[in] seed - the seed, not 0
+ *
+ */
+static void
+fill_payload(char *p, unsigned int len, unsigned long long seed)
+{
+	unsigned int c;
+
+	for (c = sizeof(bench_msg_t); c < len; c++)
+		p[c] = "abcdefghijklmnopqrstuvwxyz0123456789"[next_rnd(&seed) % (c % 7 ? 4 : 36)];
+}
+
+/**
+ * @brief
+ *	Check that a payload has the content fill_payload() gave it
+ *
+ * @param[in] p - the payload
+ * @param[in] len - length of the payload
+ * @param[in] seed - the seed it was filled with
+ *
+ * @return whether the content is intact
+ * @retval 1 - intact
+ * @retval 0 - corrupt
+ *
+ */
+static int
+check_payload(const char *p, unsigned int len, unsigned long long seed)
+{
+	unsigned int c;
+
+	for (c = sizeof(bench_msg_t); c < len; c++)
+		if (p[c] != "abcdefghijklmnopqrstuvwxyz0123456789"[next_rnd(&seed) % (c % 7 ? 4 : 36)])
+			return 0;
+	return 1;
+}
+
+/**
+ * @brief
+ *	Map a latency value to its histogram bucket
+ *
+ * @param[in] v - value in nanoseconds
+ *
+ * @return bucket index
+ *
+ */
+static int
+hist_bucket(unsigned long long v)
+{
+	int msb;
+	int shift;
+
+	if (v < HIST_LINEAR)
+		return (int) v;
+	msb = 63 - __builtin_clzll(v);
+	shift = msb - 5;
+	return HIST_LINEAR + (shift - 1) * HIST_SUB + (int) ((v >> shift) - HIST_SUB);
+}
+
+/**
+ * @brief
+ *	Get the value a histogram bucket represents, the middle of its range
+ *
+ * @param[in] b - bucket index
+ *
+ * @return value in nanoseconds
+ *
+ */
+static unsigned long long
+hist_value(int b)
+{
+	int shift;
+	unsigned long long mant;
+
+	if (b < HIST_LINEAR)
+		return b;
+	shift = (b - HIST_LINEAR) / HIST_SUB + 1;
+	mant = (b - HIST_LINEAR) % HIST_SUB + HIST_SUB;
+	return (mant << shift) + (1ULL << (shift - 1));
+}
+
+/**
+ * @brief
+ *	Find the value at a percentile of a histogram
+ *
+ * @param[in] hist - the histogram
+ * @param[in] total - number of values in the histogram
+ * @param[in] pct - the percentile
+ *
+ * @return value in nanoseconds
+ *
+ */
+static unsigned long long
+hist_percentile(unsigned long long *hist, unsigned long long total, double pct)
+{
+	unsigned long long want;
+	unsigned long long seen = 0;
+	int b;
+
+	if (total == 0)
+		return 0;
+	want = (unsigned long long) (total * pct / 100.0);
+	if (want >= total)
+		want = total - 1;
+	for (b = 0; b < HIST_BUCKETS; b++) {
+		seen += hist[b];
+		if (seen > want)
+			return hist_value(b);
+	}
+	return hist_value(HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief
+ *	Make sure a buffer has room for more bytes
+ *
+ * @param[in] b - the buffer
+ * @param[in] more - bytes needed beyond the current length
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Out of memory
+ *
+ */
+static int
+buf_reserve(bench_buf_t *b, size_t more)
+{
+	size_t sz;
+	char *p;
+
+	if (b->len + more <= b->size)
+		return 0;
+	sz = b->size ? b->size : BENCH_RECV_CHUNK;
+	while (sz < b->len + more)
+		sz *= 2;
+	if ((p = realloc(b->data, sz)) == NULL)
+		return -1;
+	b->data = p;
+	b->size = sz;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Append bytes to a buffer
+ *
+ * @param[in] b - the buffer
+ * @param[in] data - bytes to append
+ * @param[in] len - number of bytes
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Out of memory
+ *
+ */
+static int
+buf_append(bench_buf_t *b, void *data, size_t len)
+{
+	if (buf_reserve(b, len) != 0)
+		return -1;
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Write out as much of the pending output of a leaf as the socket takes,
+ *	and watch for EM_OUT while some is left
+ *
+ * @param[in] td - the owning thread
+ * @param[in] lf - the leaf
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Connection failed
+ *
+ */
+static int
+leaf_flush(bench_thrd_t *td, bench_leaf_t *lf)
+{
+	size_t off = 0;
+	ssize_t rc;
+	int want_out;
+
+	while (off < lf->out.len) {
+		rc = send(lf->fd, lf->out.data + off, lf->out.len - off, 0);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+		off += rc;
+	}
+	if (off > 0) {
+		memmove(lf->out.data, lf->out.data + off, lf->out.len - off);
+		lf->out.len -= off;
+	}
+
+	want_out = (lf->out.len > 0);
+	if (want_out != lf->em_out) {
+		if (tpp_em_mod_fd(td->em_ctx, lf->fd, EM_IN | EM_ERR | EM_HUP | (want_out ? EM_OUT : 0)) != 0)
+			return -1;
+		lf->em_out = want_out;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Queue a TPP_DATA packet from a leaf to another leaf
+ *
+ * @param[in] lf - sending leaf
+ * @param[in] dest - receiving leaf
+ * @param[in] data - payload, possibly compressed
+ * @param[in] len - length of payload
+ * @param[in] totlen - uncompressed length of payload
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Out of memory
+ *
+ */
+static int
+queue_data(bench_leaf_t *lf, bench_leaf_t *dest, void *data, unsigned int len, unsigned int totlen)
+{
+	tpp_data_pkt_hdr_t dhdr;
+
+	memset(&dhdr, 0, sizeof(dhdr));
+	dhdr.ntotlen = htonl(sizeof(dhdr) + len);
+	dhdr.type = TPP_DATA;
+	dhdr.src_sd = htonl(lf->idx);
+	dhdr.dest_sd = htonl(dest->idx);
+	dhdr.totlen = htonl(totlen);
+	memcpy(&dhdr.src_addr, &lf->addr, sizeof(tpp_addr_t));
+	memcpy(&dhdr.dest_addr, &dest->addr, sizeof(tpp_addr_t));
+
+	if (buf_append(&lf->out, &dhdr, sizeof(dhdr)) != 0)
+		return -1;
+	return buf_append(&lf->out, data, len);
+}
+
+/**
+ * @brief
+ *	Queue a TPP_MCAST_DATA packet from a leaf to a number of leaves
+ *
+ * @param[in] lf - sending leaf
+ * @param[in] minfo - member stream info, one per receiving leaf
+ * @param[in] nmembers - number of receiving leaves
+ * @param[in] data - payload, possibly compressed
+ * @param[in] len - length of payload
+ * @param[in] totlen - uncompressed length of payload
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Out of memory
+ *
+ */
+static int
+queue_mcast(bench_leaf_t *lf, tpp_mcast_pkt_info_t *minfo, int nmembers, void *data, unsigned int len, unsigned int totlen)
+{
+	tpp_mcast_pkt_hdr_t mhdr;
+	unsigned int info_len = nmembers * sizeof(tpp_mcast_pkt_info_t);
+
+	memset(&mhdr, 0, sizeof(mhdr));
+	mhdr.ntotlen = htonl(sizeof(mhdr) + info_len + len);
+	mhdr.type = TPP_MCAST_DATA;
+	mhdr.hop = 0;
+	mhdr.num_streams = htonl(nmembers);
+	mhdr.info_len = htonl(info_len);
+	mhdr.info_cmprsd_len = 0;
+	mhdr.totlen = htonl(totlen);
+	memcpy(&mhdr.src_addr, &lf->addr, sizeof(tpp_addr_t));
+
+	if (buf_append(&lf->out, &mhdr, sizeof(mhdr)) != 0)
+		return -1;
+	if (buf_append(&lf->out, minfo, info_len) != 0)
+		return -1;
+	return buf_append(&lf->out, data, len);
+}
+
+/**
+ * @brief
+ *	Queue a probe from a leaf to itself. It comes back once the router
+ *	has registered the leaf, or a NOROUTE comes back before that.
+ *
+ * @param[in] lf - the leaf
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Out of memory
+ *
+ */
+static int
+queue_probe(bench_leaf_t *lf)
+{
+	bench_msg_t m;
+
+	m.magic = BENCH_MAGIC;
+	m.kind = MSG_PROBE;
+	m.send_ns = now_ns();
+	m.seed = 0;
+	lf->last_probe = time(NULL);
+	return queue_data(lf, lf, &m, sizeof(m), sizeof(m));
+}
+
+/**
+ * @brief
+ *	Account a packet received by a leaf
+ *
+ * @param[in] td - the owning thread
+ * @param[in] lf - the receiving leaf
+ * @param[in] pkt - the packet
+ * @param[in] len - length of the packet
+ *
+ */
+static void
+handle_pkt(bench_thrd_t *td, bench_leaf_t *lf, char *pkt, unsigned int len)
+{
+	unsigned char type = (unsigned char) pkt[sizeof(unsigned int)];
+
+	if (type == TPP_DATA && len >= sizeof(tpp_data_pkt_hdr_t)) {
+		tpp_data_pkt_hdr_t dhdr;
+		bench_msg_t m;
+		char *payload = pkt + sizeof(tpp_data_pkt_hdr_t);
+		unsigned int plen = len - sizeof(tpp_data_pkt_hdr_t);
+		unsigned int totlen;
+		void *raw = NULL;
+		unsigned long long lat;
+
+		memcpy(&dhdr, pkt, sizeof(dhdr));
+		totlen = ntohl(dhdr.totlen);
+		if (plen != totlen) {
+			if ((raw = tpp_inflate(payload, plen, totlen)) == NULL) {
+				if (phase == PHASE_MEASURE)
+					td->errors++;
+				__atomic_sub_fetch(&inflight, 1, __ATOMIC_RELAXED);
+				return;
+			}
+			payload = raw;
+			plen = totlen;
+		}
+		if (plen < sizeof(m)) {
+			free(raw);
+			return;
+		}
+		memcpy(&m, payload, sizeof(m));
+		if (m.magic != BENCH_MAGIC) {
+			free(raw);
+			return;
+		}
+		if (m.kind == MSG_DATA && m.seed != 0) {
+			td->verified++;
+			if (!check_payload(payload, plen, m.seed))
+				td->corrupt++;
+		}
+		free(raw);
+
+		if (m.kind == MSG_PROBE) {
+			if (!lf->joined) {
+				lf->joined = 1;
+				__atomic_add_fetch(&joined, 1, __ATOMIC_RELAXED);
+			}
+			return;
+		}
+
+		__atomic_sub_fetch(&inflight, 1, __ATOMIC_RELAXED);
+		if (phase != PHASE_MEASURE || m.send_ns < measure_ns)
+			return;
+		lat = now_ns() - m.send_ns;
+		td->delivered++;
+		td->delivered_bytes += totlen;
+		td->hist[hist_bucket(lat)]++;
+		if (lat > td->max_lat)
+			td->max_lat = lat;
+
+	} else if (type == TPP_CTL_MSG && len >= sizeof(tpp_ctl_pkt_hdr_t)) {
+		tpp_ctl_pkt_hdr_t chdr;
+
+		memcpy(&chdr, pkt, sizeof(chdr));
+		if (chdr.code != TPP_MSG_NOROUTE)
+			return;
+		/* probes of leaves not yet registered come back this way too */
+		if (memcmp(&chdr.dest_addr, &lf->addr, sizeof(tpp_addr_t)) == 0)
+			return;
+		__atomic_sub_fetch(&inflight, 1, __ATOMIC_RELAXED);
+		if (phase == PHASE_MEASURE)
+			td->noroute++;
+	}
+}
+
+/**
+ * @brief
+ *	Read whatever is available on a leaf connection and handle all the
+ *	complete packets in it
+ *
+ * @param[in] td - the owning thread
+ * @param[in] lf - the leaf
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Connection closed or failed
+ *
+ */
+static int
+leaf_read(bench_thrd_t *td, bench_leaf_t *lf)
+{
+	ssize_t rc;
+	size_t space;
+	size_t off;
+	unsigned int plen;
+
+	for (;;) {
+		if (buf_reserve(&lf->in, BENCH_RECV_CHUNK) != 0)
+			return -1;
+		space = lf->in.size - lf->in.len;
+		rc = recv(lf->fd, lf->in.data + lf->in.len, space, 0);
+		if (rc == 0)
+			return -1;
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		lf->in.len += rc;
+
+		off = 0;
+		while (lf->in.len - off > sizeof(unsigned int)) {
+			memcpy(&plen, lf->in.data + off, sizeof(plen));
+			plen = ntohl(plen);
+			if (plen <= sizeof(unsigned int) || plen > BENCH_MAX_PKT)
+				return -1;
+			if (lf->in.len - off < plen)
+				break;
+			handle_pkt(td, lf, lf->in.data + off, plen);
+			off += plen;
+		}
+		if (off > 0) {
+			memmove(lf->in.data, lf->in.data + off, lf->in.len - off);
+			lf->in.len -= off;
+		}
+
+		if ((size_t) rc < space)
+			return 0; /* drained, level triggered monitor tells us if more comes */
+	}
+}
+
+/**
+ * @brief
+ *	Generate the next message from a leaf, unicast or multicast
+ *
+ * @param[in] td - the owning thread
+ * @param[in] lf - the sending leaf
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Out of memory
+ *
+ */
+static int
+gen_msg(bench_thrd_t *td, bench_leaf_t *lf)
+{
+	bench_msg_t m;
+	unsigned int size;
+	unsigned int len;
+	void *data;
+	void *cmpr = NULL;
+	int is_mcast;
+	int nmembers = 1;
+	int rc;
+	int i;
+
+	size = sizes[next_rnd(&td->rnd) % num_sizes];
+	is_mcast = (mcast_pct > 0 && (int) (next_rnd(&td->rnd) % 100) < mcast_pct);
+	if (is_mcast)
+		nmembers = fanout;
+
+	m.magic = BENCH_MAGIC;
+	m.kind = MSG_DATA;
+	m.send_ns = now_ns();
+	m.seed = 0;
+	if (verify) {
+		m.seed = next_rnd(&td->rnd);
+		fill_payload(td->payload, size, m.seed);
+	}
+	memcpy(td->payload, &m, sizeof(m));
+
+	data = td->payload;
+	len = size;
+	if (compress && size > (unsigned int) compr_min) {
+		unsigned int clen;
+
+		if ((cmpr = tpp_compress(codec, td->payload, size, &clen)) != NULL) {
+			data = cmpr;
+			len = clen;
+		}
+	}
+
+	__atomic_add_fetch(&inflight, nmembers, __ATOMIC_RELAXED);
+	if (is_mcast) {
+		for (i = 0; i < nmembers; i++) {
+			bench_leaf_t *dest = &leaves[next_rnd(&td->rnd) % num_leaves];
+
+			td->minfo[i].src_sd = htonl(lf->idx);
+			td->minfo[i].src_magic = 0;
+			td->minfo[i].dest_sd = htonl(dest->idx);
+			memcpy(&td->minfo[i].dest_addr, &dest->addr, sizeof(tpp_addr_t));
+		}
+		rc = queue_mcast(lf, td->minfo, nmembers, data, len, size);
+		if (phase == PHASE_MEASURE)
+			td->sent_mcast++;
+	} else {
+		rc = queue_data(lf, &leaves[next_rnd(&td->rnd) % num_leaves], data, len, size);
+		if (phase == PHASE_MEASURE)
+			td->sent_ucast++;
+	}
+	free(cmpr);
+	td->gen_count++;
+	return rc;
+}
+
+/**
+ * @brief
+ *	Generate messages from the leaves of a thread, within the in flight
+ *	window and the rate limit
+ *
+ * @param[in] td - the thread
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Failure
+ *
+ */
+static int
+gen_burst(bench_thrd_t *td)
+{
+	long budget;
+	long i;
+	int tries;
+	bench_leaf_t *lf = NULL;
+
+	budget = window - __atomic_load_n(&inflight, __ATOMIC_RELAXED);
+	if (budget > BENCH_BURST)
+		budget = BENCH_BURST;
+	if (rate > 0) {
+		double allowed = (now_ns() - start_ns) / 1e9 * rate / num_thrds;
+
+		if (allowed - td->gen_count < budget)
+			budget = (long) (allowed - td->gen_count);
+	}
+
+	for (i = 0; i < budget; i++) {
+		/* skip leaves whose connection is backed up */
+		for (tries = 0; tries < td->nleaves; tries++) {
+			lf = td->leaves[td->next];
+			td->next = (td->next + 1) % td->nleaves;
+			if (lf->fd != -1 && lf->out.len < BENCH_MAX_OUT)
+				break;
+		}
+		if (tries == td->nleaves)
+			break;
+		if (gen_msg(td, lf) != 0 || leaf_flush(td, lf) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Close a leaf after its connection failed
+ *
+ * @param[in] td - the owning thread
+ * @param[in] lf - the leaf
+ *
+ */
+static void
+leaf_close(bench_thrd_t *td, bench_leaf_t *lf)
+{
+	fprintf(stderr, "leaf %d: connection to router lost\n", lf->idx);
+	tpp_em_del_fd(td->em_ctx, lf->fd);
+	close(lf->fd);
+	lf->fd = -1;
+	if (phase == PHASE_MEASURE)
+		td->errors++;
+}
+
+/**
+ * @brief
+ *	The IO thread, handles the leaves assigned to it
+ *
+ * @param[in] arg - the thread structure
+ *
+ * @return NULL
+ *
+ */
+static void *
+io_thread(void *arg)
+{
+	bench_thrd_t *td = arg;
+	em_event_t *events;
+	bench_leaf_t *lf;
+	int nfds;
+	int i;
+	int fd;
+	int ev;
+
+	while (phase != PHASE_STOP) {
+		if (phase == PHASE_JOIN) {
+			time_t now = time(NULL);
+
+			for (i = 0; i < td->nleaves; i++) {
+				lf = td->leaves[i];
+				if (lf->fd != -1 && !lf->joined && now - lf->last_probe >= 1) {
+					if (queue_probe(lf) != 0 || leaf_flush(td, lf) != 0)
+						leaf_close(td, lf);
+				}
+			}
+		} else if (gen_burst(td) != 0) {
+			fprintf(stderr, "thread %d: out of memory\n", td->id);
+			break;
+		}
+
+		nfds = tpp_em_wait(td->em_ctx, &events, 1);
+		for (i = 0; i < nfds; i++) {
+			fd = EM_GET_FD(events, i);
+			ev = EM_GET_EVENT(events, i);
+			if (fd < 0 || fd >= fd_map_sz || (lf = fd_map[fd]) == NULL || lf->fd != fd)
+				continue;
+			if (ev & (EM_IN | EM_HUP | EM_ERR)) {
+				if (leaf_read(td, lf) != 0) {
+					leaf_close(td, lf);
+					continue;
+				}
+			}
+			if (ev & EM_OUT) {
+				if (leaf_flush(td, lf) != 0)
+					leaf_close(td, lf);
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Connect a leaf to the router from a reserved port and register it
+ *	with a TPP_CTL_JOIN packet
+ *
+ * @param[in] lf - the leaf
+ * @param[in] router - router address
+ * @param[in] loopback - router is the loopback router
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Failure
+ *
+ */
+static int
+leaf_connect(bench_leaf_t *lf, struct sockaddr_in *router, int loopback)
+{
+	struct sockaddr_in src;
+	tpp_join_pkt_hdr_t jhdr;
+	tpp_join_ext_t ext;
+	char pkt[sizeof(jhdr) + sizeof(tpp_addr_t) + sizeof(ext)];
+	int port;
+	int step;
+	int fd = -1;
+	int err = 0;
+	int on = 1;
+
+	memset(&src, 0, sizeof(src));
+	src.sin_family = AF_INET;
+	if (loopback) {
+		/* a source address of its own for every leaf */
+		src.sin_addr.s_addr = htonl(0x7f010001 + lf->idx);
+		port = IPPORT_RESERVED - 1;
+		step = 1;
+	} else {
+		if (num_src_addrs > 0)
+			src.sin_addr = src_addrs[lf->idx / BENCH_PORTS_PER_ADDR];
+		else
+			src.sin_addr.s_addr = htonl(INADDR_ANY);
+		port = IPPORT_RESERVED - 1 - lf->idx % BENCH_PORTS_PER_ADDR;
+		step = BENCH_PORTS_PER_ADDR;
+	}
+
+	for (; port >= IPPORT_RESERVED / 2; port -= step) {
+		if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+			return -1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		src.sin_port = htons(port);
+		if (bind(fd, (struct sockaddr *) &src, sizeof(src)) == 0 &&
+			connect(fd, (struct sockaddr *) router, sizeof(*router)) == 0)
+			break;
+		err = errno;
+		close(fd);
+		fd = -1;
+		if (err != EADDRINUSE && err != EADDRNOTAVAIL)
+			break;
+	}
+	if (fd == -1) {
+		fprintf(stderr, "leaf %d: cannot connect from a reserved port of %s: %s\n",
+			lf->idx, inet_ntoa(src.sin_addr), strerror(err));
+		return -1;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	/* register with the address the connection comes from */
+	memset(&lf->addr, 0, sizeof(lf->addr));
+	memcpy(&lf->addr.ip[0], &src.sin_addr, sizeof(src.sin_addr));
+	lf->addr.port = src.sin_port;
+	lf->addr.family = TPP_ADDR_FAMILY_IPV4;
+
+	memset(&jhdr, 0, sizeof(jhdr));
+	jhdr.ntotlen = htonl(sizeof(pkt));
+	jhdr.type = TPP_CTL_JOIN;
+	jhdr.hop = 1;
+	jhdr.node_type = TPP_LEAF_NODE;
+	jhdr.index = 0;
+	jhdr.num_addrs = 1;
+	memcpy(ext.magic, TPP_JOIN_EXT_MAGIC, sizeof(ext.magic));
+	ext.codecs = tpp_codecs_supported();
+
+	memcpy(pkt, &jhdr, sizeof(jhdr));
+	memcpy(pkt + sizeof(jhdr), &lf->addr, sizeof(tpp_addr_t));
+	memcpy(pkt + sizeof(jhdr) + sizeof(tpp_addr_t), &ext, sizeof(ext));
+	if (send(fd, pkt, sizeof(pkt), 0) != sizeof(pkt)) {
+		fprintf(stderr, "leaf %d: failed to send join: %s\n", lf->idx, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	lf->fd = fd;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Find a name for the loopback router. TPP does not accept loopback
+ *	addresses as node names, so use the first other IPv4 address of
+ *	this host.
+ *
+ * @param[out] buf - buffer for the name
+ * @param[in] len - size of buf
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - No usable address
+ *
+ */
+static int
+get_router_name(char *buf, size_t len)
+{
+	struct ifaddrs *ifa, *p;
+	int rc = -1;
+
+	if (getifaddrs(&ifa) != 0)
+		return -1;
+	for (p = ifa; p && rc != 0; p = p->ifa_next) {
+		struct sockaddr_in *sa = (struct sockaddr_in *) p->ifa_addr;
+
+		if (sa == NULL || sa->sin_family != AF_INET)
+			continue;
+		if (ntohl(sa->sin_addr.s_addr) >> 24 == IN_LOOPBACKNET)
+			continue;
+		if (inet_ntop(AF_INET, &sa->sin_addr, buf, len) != NULL)
+			rc = 0;
+	}
+	freeifaddrs(ifa);
+	return rc;
+}
+
+/**
+ * @brief
+ *	Start a router in a child process, the same way pbs_comm does
+ *
+ * @return pid of the router process
+ * @retval -1 - Failure
+ *
+ */
+static pid_t
+start_router(void)
+{
+	static char *auth_methods[] = {AUTH_RESVPORT_NAME, NULL};
+	struct pbs_config pconf;
+	struct tpp_config conf;
+	char name[PBS_MAXHOSTNAME + 1];
+	pid_t pid;
+
+	if (router_name)
+		snprintf(name, sizeof(name), "%s", router_name);
+	else if (get_router_name(name, sizeof(name)) != 0) {
+		fprintf(stderr, "no non-loopback address to name the router, use -H\n");
+		return -1;
+	}
+
+	if ((pid = fork()) != 0)
+		return pid;
+
+	memset(&pconf, 0, sizeof(pconf));
+	memset(&conf, 0, sizeof(conf));
+	strcpy(pconf.auth_method, AUTH_RESVPORT_NAME);
+	pconf.supported_auth_methods = auth_methods;
+	pconf.pbs_exec_path = "";
+	pconf.pbs_home_path = "";
+	pconf.pbs_use_compression = compress;
+
+	if (set_tpp_config(&pconf, &conf, name, router_port, NULL) == -1) {
+		fprintf(stderr, "router: error setting TPP config\n");
+		_exit(1);
+	}
+	conf.node_type = TPP_ROUTER_NODE;
+	conf.numthreads = router_threads;
+	avl_set_maxthreads(router_threads + 1);
+
+	if (tpp_init_router(&conf) == -1) {
+		fprintf(stderr, "router: tpp init failed\n");
+		_exit(1);
+	}
+	for (;;)
+		pause();
+}
+
+/**
+ * @brief
+ *	Wait for the router to accept connections
+ *
+ * @param[in] router - router address
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Router not reachable
+ *
+ */
+static int
+wait_router(struct sockaddr_in *router)
+{
+	int i;
+	int fd;
+	int rc = -1;
+
+	for (i = 0; i < 100 && rc != 0; i++) {
+		if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+			return -1;
+		rc = connect(fd, (struct sockaddr *) router, sizeof(*router));
+		close(fd);
+		if (rc != 0)
+			usleep(100000);
+	}
+	return rc;
+}
+
+/**
+ * @brief
+ *	Get the CPU time used by a process so far
+ *
+ * @param[in] pid - the process
+ * @param[out] user - user time in seconds
+ * @param[out] sys - system time in seconds
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Not available
+ *
+ */
+static int
+proc_cpu(pid_t pid, double *user, double *sys)
+{
+	char path[64];
+	char buf[1024];
+	char *p;
+	unsigned long ut, st;
+	FILE *fp;
+	size_t n;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+	n = fread(buf, 1, sizeof(buf) - 1, fp);
+	fclose(fp);
+	buf[n] = '\0';
+
+	/* skip past the command name, which may contain blanks */
+	if ((p = strrchr(buf, ')')) == NULL)
+		return -1;
+	if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &ut, &st) != 2)
+		return -1;
+	*user = (double) ut / sysconf(_SC_CLK_TCK);
+	*sys = (double) st / sysconf(_SC_CLK_TCK);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Parse a comma separated list of message sizes
+ *
+ * @param[in] list - the list
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Bad list
+ *
+ */
+static int
+parse_sizes(char *list)
+{
+	char *tok;
+	char *saveptr;
+	char *endp;
+	long v;
+
+	num_sizes = 0;
+	max_size = 0;
+	for (tok = strtok_r(list, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+		v = strtol(tok, &endp, 10);
+		if (*endp == 'k' || *endp == 'K') {
+			v *= 1024;
+			endp++;
+		} else if (*endp == 'm' || *endp == 'M') {
+			v *= 1024 * 1024;
+			endp++;
+		}
+		if (*endp != '\0' || v < (long) sizeof(bench_msg_t) || v > BENCH_MAX_PKT / 2 || num_sizes == BENCH_MAX_SIZES)
+			return -1;
+		sizes[num_sizes++] = (int) v;
+		if (v > max_size)
+			max_size = (int) v;
+	}
+	return (num_sizes > 0 ? 0 : -1);
+}
+
+/**
+ * @brief
+ *	Parse a comma separated list of source addresses
+ *
+ * @param[in] list - the list
+ *
+ * @return Error code
+ * @retval  0 - Success
+ * @retval -1 - Bad list
+ *
+ */
+static int
+parse_addrs(char *list)
+{
+	char *tok;
+	char *saveptr;
+	struct in_addr *tmp;
+
+	for (tok = strtok_r(list, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+		if ((tmp = realloc(src_addrs, (num_src_addrs + 1) * sizeof(struct in_addr))) == NULL)
+			return -1;
+		src_addrs = tmp;
+		if (inet_pton(AF_INET, tok, &src_addrs[num_src_addrs]) != 1)
+			return -1;
+		num_src_addrs++;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Print the results of the measurement
+ *
+ * @param[in] secs - measured wall clock time
+ * @param[in] rcpu - router CPU seconds used, -1 if unknown
+ * @param[in] rsys - router system CPU seconds used
+ * @param[in] bcpu - benchmark CPU seconds used
+ *
+ */
+static void
+report(double secs, double rcpu, double rsys, double bcpu)
+{
+	static unsigned long long hist[HIST_BUCKETS];
+	unsigned long long ucast = 0, mcast = 0, delivered = 0, bytes = 0;
+	unsigned long long noroute = 0, errors = 0, max_lat = 0;
+	unsigned long long verified = 0, corrupt = 0;
+	int i, b;
+
+	for (i = 0; i < num_thrds; i++) {
+		bench_thrd_t *td = &thrds[i];
+
+		ucast += td->sent_ucast;
+		mcast += td->sent_mcast;
+		delivered += td->delivered;
+		bytes += td->delivered_bytes;
+		noroute += td->noroute;
+		errors += td->errors;
+		verified += td->verified;
+		corrupt += td->corrupt;
+		if (td->max_lat > max_lat)
+			max_lat = td->max_lat;
+		for (b = 0; b < HIST_BUCKETS; b++)
+			hist[b] += td->hist[b];
+	}
+
+	printf("leaves:       %d (joined %d), io threads %d\n", num_leaves, joined, num_thrds);
+	printf("messages:     sizes");
+	for (i = 0; i < num_sizes; i++)
+		printf("%s%d", i ? "," : " ", sizes[i]);
+	printf(", mcast %d%% x %d, window %ld", mcast_pct, fanout, window);
+	if (rate > 0)
+		printf(", rate %.0f/s", rate);
+	if (compress)
+		printf(", %s compression above %d", tpp_codec_name(codec), compr_min);
+	printf("\n");
+	printf("duration:     %.2f s\n", secs);
+	printf("sent:         %llu unicast, %llu mcast\n", ucast, mcast);
+	printf("delivered:    %llu msgs, %.1f msgs/s, %.2f MB/s\n", delivered,
+		delivered / secs, bytes / secs / (1024 * 1024));
+	printf("latency:      p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n",
+		hist_percentile(hist, delivered, 50) / 1000.0,
+		hist_percentile(hist, delivered, 99) / 1000.0,
+		hist_percentile(hist, delivered, 99.9) / 1000.0,
+		max_lat / 1000.0);
+	if (rcpu >= 0)
+		printf("router cpu:   %.1f%% (%.1f%% sys), %.2f us per msg\n", rcpu * 100 / secs, rsys * 100 / secs,
+			delivered ? rcpu * 1e6 / delivered : 0);
+	else
+		printf("router cpu:   unknown, use -P with a remote router\n");
+	printf("bench cpu:    %.1f%%\n", bcpu * 100 / secs);
+	printf("noroute:      %llu, errors %llu, in flight at end %ld\n", noroute, errors,
+		__atomic_load_n(&inflight, __ATOMIC_RELAXED));
+	if (verify)
+		printf("verified:     %llu payloads, %llu corrupt\n", verified, corrupt);
+}
+
+/**
+ * @brief
+ *	Print usage
+ *
+ * @param[in] prog - program name
+ *
+ */
+static void
+usage(char *prog)
+{
+	fprintf(stderr, "usage: %s [-r router[:port] [-P router_pid] [-a addr,...]] [-H router_name] [-p port] [-t router_threads]\n"
+		"\t[-n leaves] [-T io_threads] [-s size,...] [-m mcast_pct] [-f fanout]\n"
+		"\t[-w window] [-R rate] [-d secs] [-W warmup_secs] [-c] [-V]\n", prog);
+	fprintf(stderr, "       %s --version\n", prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct sockaddr_in router;
+	struct rusage ru_start, ru_end;
+	struct rlimit rl;
+	double ru_user = 0, ru_sys = 0, ru_user2 = 0, ru_sys2 = 0;
+	double rcpu = -1, rsys = 0;
+	pid_t child = -1;
+	unsigned long long end_ns;
+	int loopback;
+	int c, i;
+	char *s;
+	time_t t;
+
+	/*the real deal or just pbs_version and exit*/
+	PRINT_VERSION_AND_EXIT(argc, argv);
+
+	while ((c = getopt(argc, argv, "r:P:a:H:p:t:n:T:s:m:f:w:R:d:W:cV")) != -1) {
+		switch (c) {
+			case 'r':
+				router_host = tpp_parse_hostname(optarg, &router_port);
+				break;
+			case 'P':
+				router_pid = atoi(optarg);
+				break;
+			case 'a':
+				if (parse_addrs(optarg) != 0) {
+					fprintf(stderr, "bad address list %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'H':
+				router_name = optarg;
+				break;
+			case 'p':
+				router_port = atoi(optarg);
+				break;
+			case 't':
+				router_threads = atoi(optarg);
+				break;
+			case 'n':
+				num_leaves = atoi(optarg);
+				break;
+			case 'T':
+				num_thrds = atoi(optarg);
+				break;
+			case 's':
+				if (parse_sizes(optarg) != 0) {
+					fprintf(stderr, "bad size list %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'm':
+				mcast_pct = atoi(optarg);
+				break;
+			case 'f':
+				fanout = atoi(optarg);
+				break;
+			case 'w':
+				window = atol(optarg);
+				break;
+			case 'R':
+				rate = atof(optarg);
+				break;
+			case 'd':
+				duration = atoi(optarg);
+				break;
+			case 'W':
+				warmup = atoi(optarg);
+				break;
+			case 'c':
+				compress = 1;
+				break;
+			case 'V':
+				verify = 1;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc || num_leaves < 1 || num_thrds < 1 || router_threads < 1 || fanout < 1 ||
+		mcast_pct < 0 || mcast_pct > 100 || window < 1 || duration < 1 || warmup < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (num_thrds > num_leaves)
+		num_thrds = num_leaves;
+	if (router_host && num_src_addrs > 0 && num_leaves > num_src_addrs * BENCH_PORTS_PER_ADDR) {
+		fprintf(stderr, "%d source addresses allow at most %d leaves\n", num_src_addrs, num_src_addrs * BENCH_PORTS_PER_ADDR);
+		return 1;
+	}
+	if (router_host && num_src_addrs == 0 && num_leaves > BENCH_PORTS_PER_ADDR) {
+		fprintf(stderr, "more than %d leaves against a remote router need source addresses (-a)\n", BENCH_PORTS_PER_ADDR);
+		return 1;
+	}
+
+	if (compress) {
+		if ((s = getenv("PBS_TPP_COMPRESSION_CODEC")) != NULL) {
+			codec = tpp_codec_parse(s);
+			if (codec == -1 || !(tpp_codecs_supported() & TPP_CODEC_BIT(codec))) {
+				fprintf(stderr, "compression codec %s not supported\n", s);
+				return 1;
+			}
+		}
+		if ((s = getenv("PBS_TPP_COMPRESSION_MIN")) != NULL)
+			compr_min = atoi(s);
+	}
+
+	if ((getuid() != 0) || (geteuid() != 0)) {
+		fprintf(stderr, "%s: Must be run by root, leaves connect from reserved ports\n", argv[0]);
+		return 2;
+	}
+
+	if (tpp_init_tls_key() != 0) {
+		fprintf(stderr, "Failed to initialize tls key\n");
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	/* a descriptor per leaf, here and in the loopback router */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	memset(&router, 0, sizeof(router));
+	router.sin_family = AF_INET;
+	router.sin_port = htons(router_port);
+	loopback = (router_host == NULL);
+	if (loopback) {
+		router.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if ((child = start_router()) == -1)
+			return 1;
+		router_pid = child;
+	} else {
+		struct addrinfo hints, *ai;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(router_host, NULL, &hints, &ai) != 0) {
+			fprintf(stderr, "cannot resolve %s\n", router_host);
+			return 1;
+		}
+		router.sin_addr = ((struct sockaddr_in *) ai->ai_addr)->sin_addr;
+		freeaddrinfo(ai);
+	}
+
+	if (wait_router(&router) != 0) {
+		fprintf(stderr, "router at %s:%d not reachable\n", inet_ntoa(router.sin_addr), router_port);
+		goto out;
+	}
+
+	/* connect all leaves and hand them out to the IO threads */
+	leaves = calloc(num_leaves, sizeof(bench_leaf_t));
+	thrds = calloc(num_thrds, sizeof(bench_thrd_t));
+	if (leaves == NULL || thrds == NULL)
+		goto oom;
+
+	for (i = 0; i < num_thrds; i++) {
+		bench_thrd_t *td = &thrds[i];
+
+		td->id = i;
+		td->rnd = 0x9e3779b97f4a7c15ULL * (i + 1);
+		td->payload = malloc(max_size);
+		td->minfo = malloc(fanout * sizeof(tpp_mcast_pkt_info_t));
+		td->leaves = malloc((num_leaves / num_thrds + 1) * sizeof(bench_leaf_t *));
+		if (!td->payload || !td->minfo || !td->leaves)
+			goto oom;
+		if ((td->em_ctx = tpp_em_init(num_leaves / num_thrds + 1)) == NULL) {
+			fprintf(stderr, "failed to initialize event monitor\n");
+			goto out;
+		}
+		fill_payload(td->payload, max_size, td->rnd);
+	}
+
+	printf("connecting %d leaves to %s:%d\n", num_leaves, inet_ntoa(router.sin_addr), router_port);
+	for (i = 0; i < num_leaves; i++) {
+		bench_leaf_t *lf = &leaves[i];
+		bench_thrd_t *td = &thrds[i % num_thrds];
+
+		lf->idx = i;
+		if (leaf_connect(lf, &router, loopback) != 0)
+			goto out;
+		if (lf->fd >= fd_map_sz) {
+			int sz = lf->fd * 2 + 1;
+			bench_leaf_t **tmp = realloc(fd_map, sz * sizeof(bench_leaf_t *));
+
+			if (tmp == NULL)
+				goto oom;
+			memset(tmp + fd_map_sz, 0, (sz - fd_map_sz) * sizeof(bench_leaf_t *));
+			fd_map = tmp;
+			fd_map_sz = sz;
+		}
+		fd_map[lf->fd] = lf;
+		if (tpp_em_add_fd(td->em_ctx, lf->fd, EM_IN | EM_ERR | EM_HUP) != 0) {
+			fprintf(stderr, "failed to monitor leaf %d\n", i);
+			goto out;
+		}
+		td->leaves[td->nleaves++] = lf;
+	}
+
+	start_ns = now_ns();
+	for (i = 0; i < num_thrds; i++) {
+		if (pthread_create(&thrds[i].tid, NULL, io_thread, &thrds[i]) != 0) {
+			fprintf(stderr, "failed to create thread\n");
+			goto out;
+		}
+	}
+
+	/* wait for the router to know all leaves */
+	for (t = time(NULL); __atomic_load_n(&joined, __ATOMIC_RELAXED) < num_leaves && time(NULL) - t < BENCH_JOIN_TIMEOUT; )
+		usleep(100000);
+	printf("%d of %d leaves registered in %ld s\n", joined, num_leaves, (long) (time(NULL) - t));
+
+	phase = PHASE_WARMUP;
+	start_ns = now_ns();
+	sleep(warmup);
+
+	getrusage(RUSAGE_SELF, &ru_start);
+	if (router_pid != -1 && proc_cpu(router_pid, &ru_user, &ru_sys) == 0)
+		rcpu = 0;
+	measure_ns = now_ns();
+	phase = PHASE_MEASURE;
+	sleep(duration);
+	phase = PHASE_STOP;
+	end_ns = now_ns();
+	getrusage(RUSAGE_SELF, &ru_end);
+	if (rcpu == 0 && proc_cpu(router_pid, &ru_user2, &ru_sys2) == 0) {
+		rcpu = (ru_user2 - ru_user) + (ru_sys2 - ru_sys);
+		rsys = ru_sys2 - ru_sys;
+	} else
+		rcpu = -1;
+
+	for (i = 0; i < num_thrds; i++)
+		pthread_join(thrds[i].tid, NULL);
+
+	report((end_ns - measure_ns) / 1e9, rcpu, rsys,
+		(ru_end.ru_utime.tv_sec - ru_start.ru_utime.tv_sec) + (ru_end.ru_utime.tv_usec - ru_start.ru_utime.tv_usec) / 1e6 +
+		(ru_end.ru_stime.tv_sec - ru_start.ru_stime.tv_sec) + (ru_end.ru_stime.tv_usec - ru_start.ru_stime.tv_usec) / 1e6);
+
+	if (child != -1) {
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+	}
+	return 0;
+
+oom:
+	fprintf(stderr, "out of memory\n");
+out:
+	if (child != -1) {
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+	}
+	return 1;
+}
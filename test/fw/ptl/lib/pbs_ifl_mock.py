@@ -323,6 +323,7 @@ ATTR_NODE_TopologyInfo = 'topology_info'
 ATTR_NODE_last_used_time = 'last_used_time'
 ATTR_NODE_last_state_change_time = 'last_state_change_time'
 ATTR_sched_server_dyn_res_alarm = 'server_dyn_res_alarm'
+ATTR_sched_cycle_profile = 'cycle_profile'
 ATTR_RESC_TYPE = 'type'
 ATTR_RESC_FLAG = 'flag'
 
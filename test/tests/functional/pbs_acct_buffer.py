@@ -0,0 +1,88 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('server')
+class TestAcctBuffer(TestFunctional):
+
+    """
+    This test suite tests buffered accounting, enabled by the
+    PBS_ACCT_BUFFER and PBS_ACCT_FSYNC pbs.conf settings.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.server.hostname,
+                               confs={'PBS_ACCT_BUFFER': '65536',
+                                      'PBS_ACCT_FSYNC': '0'})
+        self.server.restart()
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_ACCT_BUFFER',
+                                        'PBS_ACCT_FSYNC'])
+        self.server.restart()
+        TestFunctional.tearDown(self)
+
+    def test_records_written(self):
+        """
+        Buffered records reach the accounting log while the server runs,
+        and every record queued is written out, in order, by the time
+        the server exits.
+        """
+        a = {'resources_available.ncpus': 0}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname)
+        j = Job(TEST_USER)
+        jid = self.server.submit(j)
+        self.server.accounting_match(';Q;%s;' % jid, id=jid)
+
+        jids = [self.server.submit(Job(TEST_USER)) for _ in range(100)]
+        start = time.time()
+        self.server.stop()
+        self.server.log_match('Server shutdown completed', starttime=start)
+
+        acct = os.path.join(self.server.pbs_conf['PBS_HOME'], 'server_priv',
+                            'accounting', time.strftime('%Y%m%d'))
+        ret = self.du.cat(self.server.hostname, acct, sudo=True)
+        queued = [l.split(';')[2] for l in ret['out']
+                  if l.split(';')[1:2] == ['Q']]
+        self.assertEqual(queued[-len(jids):], jids)
+        self.server.start()
@@ -0,0 +1,149 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestConnBroker(TestFunctional):
+
+    """
+    This test suite tests the session lifecycle of pbs_connbroker:
+    commands run with PBS_CONN_BROKER borrow the broker's server
+    connection, end their session with the end-of-session marker so
+    the connection is kept, and a session that drops without it makes
+    the broker close the connection.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 2047})
+        self.exec_path = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                                      'bin')
+        self.start = time.time()
+        cmd = [os.path.join(self.exec_path, 'pbs_connbroker'), '-n', '1',
+               self.server.hostname]
+        ret = self.du.run_cmd(self.server.hostname, cmd=cmd,
+                              runas=TEST_USER)
+        self.assertEqual(ret['rc'], 0, 'pbs_connbroker failed: ' +
+                         '\n'.join(ret['err']))
+        m = re.match(r'PBS_CONN_BROKER=([^;]+);', ret['out'][0])
+        self.assertIsNotNone(m, 'unexpected output: %s' % ret['out'])
+        self.sockpath = m.group(1)
+
+    def tearDown(self):
+        self.du.run_cmd(self.server.hostname,
+                        cmd=['pkill', '-TERM', '-u', str(TEST_USER),
+                             'pbs_connbroker'], sudo=True)
+        TestFunctional.tearDown(self)
+
+    def qstat_brokered(self):
+        """
+        Run qstat -B through the broker and return its output
+        """
+        cmd = ['env', 'PBS_CONN_BROKER=' + self.sockpath,
+               os.path.join(self.exec_path, 'qstat'), '-B']
+        ret = self.du.run_cmd(self.server.hostname, cmd=cmd,
+                              runas=TEST_USER)
+        self.assertEqual(ret['rc'], 0, 'qstat failed: ' +
+                         '\n'.join(ret['err']))
+        return ret['out']
+
+    def user_requests(self, rq_type, starttime):
+        """
+        Return the server log lines of requests of the given type from
+        the test user since starttime
+        """
+        msg = 'Type %d request received from %s@' % (rq_type, TEST_USER)
+        return self.server.log_match(msg, starttime=starttime, n='ALL',
+                                     allmatch=True, max_attempts=2)
+
+    def test_sessions_reuse_connection(self):
+        """
+        Sessions that end with the end-of-session marker leave the
+        server connection in the pool: no new Connect request and no
+        Disconnect request reach the server.
+        """
+        self.server.log_match('Type 0 request received from %s@' %
+                              TEST_USER, starttime=self.start)
+        t = time.time()
+        direct = self.server.status(SERVER)
+        for _ in range(3):
+            out = self.qstat_brokered()
+            self.assertEqual(len(out), 3, out)
+            self.assertIn(direct[0]['id'].split('.')[0], out[2])
+        lines = self.user_requests(21, t)
+        self.assertEqual(len(lines), 3)
+        socks = set(l[1].split('sock=')[1] for l in lines)
+        self.assertEqual(len(socks), 1, 'sessions used more than one '
+                         'server connection')
+        msg = 'Type 0 request received from %s@' % TEST_USER
+        self.server.log_match(msg, starttime=t, existence=False,
+                              max_attempts=2)
+        msg = 'Type 59 request received from %s@' % TEST_USER
+        self.server.log_match(msg, starttime=t, existence=False,
+                              max_attempts=2)
+
+    def test_dropped_session_closes_connection(self):
+        """
+        A session that drops without the end-of-session marker makes the
+        broker close its server connection, and the next session runs on
+        a fresh one.
+        """
+        self.qstat_brokered()
+        t = time.time()
+        port = self.server.pbs_conf.get('PBS_BATCH_SERVICE_PORT', 15001)
+        script = ('import socket, sys\n'
+                  's = socket.socket(socket.AF_UNIX)\n'
+                  's.connect(sys.argv[1])\n'
+                  's.sendall(("PBSBROKER1 %s %s\\n" % '
+                  '(sys.argv[2], sys.argv[3])).encode())\n'
+                  'print(s.recv(64).decode().strip())\n'
+                  's.close()\n')
+        cmd = ['python3', '-c', script, self.sockpath,
+               self.server.hostname, str(port)]
+        ret = self.du.run_cmd(self.server.hostname, cmd=cmd,
+                              runas=TEST_USER)
+        self.assertEqual(ret['rc'], 0, '\n'.join(ret['err']))
+        self.assertTrue(ret['out'][0].startswith('OK '), ret['out'])
+        msg = 'Type 59 request received from %s@' % TEST_USER
+        self.server.log_match(msg, starttime=t)
+        t = time.time()
+        self.qstat_brokered()
+        msg = 'Type 0 request received from %s@' % TEST_USER
+        self.server.log_match(msg, starttime=t)
@@ -0,0 +1,128 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestDisVersion(TestFunctional):
+
+    """
+    This test suite tests the binary DIS encoding (version 2) that
+    client connections ask for in their Connect request, and the
+    PBS_DIS_VERSION=1 environment setting which keeps a client on the
+    text encoding.
+    """
+
+    def run_client(self, cmd, args, dis_v1=False):
+        """
+        Run a client command, on DIS version 1 if dis_v1 is set, and
+        return its output
+        """
+        path = os.path.join(self.server.pbs_conf['PBS_EXEC'], 'bin', cmd)
+        if dis_v1:
+            full = ['env', 'PBS_DIS_VERSION=1', path] + args
+        else:
+            full = [path] + args
+        ret = self.du.run_cmd(self.server.hostname, cmd=full,
+                              runas=TEST_USER)
+        self.assertEqual(ret['rc'], 0, ' '.join(full) + ' failed: ' +
+                         '\n'.join(ret['err']))
+        return ret['out']
+
+    def submit_held(self):
+        """
+        Submit held jobs whose attributes cover negative, large and
+        floating point values, so they do not change between status
+        requests
+        """
+        jids = []
+        attrs = [{ATTR_p: '-1024', ATTR_l + '.mem': '17179869184kb'},
+                 {ATTR_p: '1023', ATTR_l + '.walltime': '1000000:00:00'},
+                 {ATTR_l + '.ncpus': '1', ATTR_N: 'dis,v2 test',
+                  ATTR_v: 'DIS_A=-1,DIS_B=4294967296'}]
+        for a in attrs:
+            a[ATTR_h] = None
+            jids.append(self.server.submit(Job(TEST_USER, attrs=a)))
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'H'}, id=jid)
+        return jids
+
+    def test_status_same_on_both_versions(self):
+        """
+        Job, queue and server status read over the binary encoding
+        match what the text encoding returns.
+        """
+        jids = self.submit_held()
+        for args in (['-f'] + jids, ['-Qf'], ['-Bf']):
+            v2 = self.run_client('qstat', args)
+            v1 = self.run_client('qstat', args, dis_v1=True)
+            self.assertEqual(v1, v2, 'qstat %s differs between DIS '
+                             'versions' % ' '.join(args))
+        out = '\n'.join(self.run_client('qstat', ['-f', jids[0]]))
+        self.assertIn('Priority = -1024', out)
+        self.assertIn('Resource_List.mem = 17179869184kb', out)
+
+    def test_requests_on_both_versions(self):
+        """
+        Requests with integer and negative arguments are decoded the
+        same way by the server from either encoding.
+        """
+        jids = self.submit_held()
+        self.run_client('qalter', ['-p', '-900', jids[0]])
+        self.server.expect(JOB, {ATTR_p: -900}, id=jids[0])
+        self.run_client('qalter', ['-p', '-901', jids[0]], dis_v1=True)
+        self.server.expect(JOB, {ATTR_p: -901}, id=jids[0])
+        self.run_client('qrls', [jids[1]])
+        self.run_client('qdel', [jids[2]], dis_v1=True)
+        self.server.expect(JOB, 'queue', op=UNSET, id=jids[2])
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[1])
+
+    def test_large_status_reply(self):
+        """
+        A status reply with many jobs decodes the same over both
+        encodings.
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        for i in range(200):
+            self.server.submit(Job(TEST_USER, attrs={ATTR_N: 'j%d' % i}))
+        v2 = self.run_client('qstat', ['-f'])
+        v1 = self.run_client('qstat', ['-f'], dis_v1=True)
+        self.assertEqual(v1, v2)
+        self.assertEqual(len([l for l in v2 if l.startswith('Job Id:')]),
+                         200)
@@ -0,0 +1,142 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('hooks')
+class TestHookAsync(TestFunctional):
+
+    """
+    This test suite tests server hooks run in the background for the
+    events listed in the PBS_HOOK_ASYNC_EVENTS pbs.conf setting.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.server.hostname,
+                               confs={'PBS_HOOK_ASYNC_EVENTS': 'management'})
+        self.server.restart()
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 4095})
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_HOOK_ASYNC_EVENTS'])
+        self.server.restart()
+        TestFunctional.tearDown(self)
+
+    def test_background_reject(self):
+        """
+        A management hook that rejects in the background does not fail
+        the qmgr request; the rejection is logged when the child running
+        the hook is reaped.
+        """
+        hook_body = """
+import pbs
+e = pbs.event()
+pbs.logmsg(pbs.LOG_DEBUG, "async mgmt hook ran")
+e.reject("async reject")
+"""
+        a = {'event': 'management', 'enabled': 'True'}
+        self.server.create_import_hook('async_rej', a, hook_body)
+        start = time.time()
+        self.server.manager(MGR_CMD_SET, SERVER, {'comment': 'async'})
+        self.server.expect(SERVER, {'comment': 'async'})
+        self.server.log_match('async mgmt hook ran', starttime=start)
+        self.server.log_match('async reject', starttime=start)
+        self.server.log_match(r'background management hooks \(pid \d+\) '
+                              'rejected the event', regexp=True,
+                              starttime=start)
+
+    def test_background_order(self):
+        """
+        Background hooks of one event run one event at a time, in the
+        order of the events, even when an earlier one takes longer.
+        """
+        hook_body = """
+import pbs
+import time
+e = pbs.event()
+m = e.management
+for a in m.attribs:
+    if a.name == 'comment':
+        if a.value == 'order1':
+            time.sleep(3)
+        pbs.logmsg(pbs.LOG_DEBUG, "async order %s" % a.value)
+"""
+        a = {'event': 'management', 'enabled': 'True'}
+        self.server.create_import_hook('async_order', a, hook_body)
+        start = time.time()
+        for i in range(1, 4):
+            self.server.manager(MGR_CMD_SET, SERVER,
+                                {'comment': 'order%d' % i})
+        lines = []
+        for i in range(1, 4):
+            lines.append(self.server.log_match('async order order%d' % i,
+                                               n='ALL', starttime=start,
+                                               max_attempts=20)[0])
+        self.assertEqual(lines, sorted(lines),
+                         'background hooks ran out of order')
+
+    def test_background_changes_dropped(self):
+        """
+        The server logs at startup that a management hook runs in the
+        background, and warns when such a hook asks for vnode changes,
+        which are not applied.
+        """
+        hook_body = """
+import pbs
+e = pbs.event()
+vn = pbs.server().vnode('%s')
+vn.comment = 'set by async hook'
+e.reject("async reject")
+""" % self.mom.shortname
+        a = {'event': 'management', 'enabled': 'True'}
+        self.server.create_import_hook('async_set', a, hook_body)
+        start = time.time()
+        self.server.restart()
+        self.server.log_match('async_set;management hook runs in the '
+                              'background', starttime=start)
+        start = time.time()
+        self.server.manager(MGR_CMD_SET, SERVER, {'comment': 'async'})
+        self.server.log_match(r'background management hooks \(pid \d+\) '
+                              'asked for vnode changes, not applied',
+                              regexp=True, starttime=start)
+        self.server.expect(VNODE, {'comment': 'set by async hook'},
+                           id=self.mom.shortname, op=NE)
@@ -0,0 +1,116 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('hooks')
+class TestHookBytecode(TestFunctional):
+
+    """
+    This test suite tests the compiled bytecode cache kept next to each
+    server hook script, in <hook>.PYC.
+    """
+
+    body = """
+import pbs
+pbs.logmsg(pbs.LOG_DEBUG, 'bytecode test %s')
+pbs.event().accept()
+"""
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.hooks_dir = os.path.join(self.server.pbs_conf['PBS_HOME'],
+                                      'server_priv', 'hooks')
+        self.pyc = os.path.join(self.hooks_dir, 'bc.PYC')
+
+    def run_hook(self, seen, unseen):
+        """
+        Submit a job and check which version of the hook ran
+        """
+        start = time.time()
+        self.server.submit(Job(TEST_USER))
+        self.server.log_match('bytecode test %s' % seen, starttime=start)
+        self.server.log_match('bytecode test %s' % unseen, starttime=start,
+                              existence=False, max_attempts=5)
+
+    def test_stale_bytecode_ignored(self):
+        """
+        The cache is written on the first run and rewritten when the
+        script changes. A cache built from other script text, or one that
+        is not a cache at all, is ignored and the script is compiled.
+        """
+        hook = self.server.hostname
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('bc', a, self.body % 'v1')
+        self.run_hook('v1', 'v2')
+        self.assertTrue(self.du.isfile(hook, self.pyc, sudo=True))
+
+        # keep the v1 cache, then change the script
+        old = self.du.create_temp_file(hook)
+        self.du.run_copy(hook, src=self.pyc, dest=old, sudo=True)
+        self.server.import_hook('bc', self.body % 'v2')
+        self.run_hook('v2', 'v1')
+
+        # a cache built from the v1 text must not be used for v2
+        self.server.stop()
+        self.du.run_copy(hook, src=old, dest=self.pyc, sudo=True)
+        self.server.start()
+        self.run_hook('v2', 'v1')
+
+        # nor must a file that is not a cache
+        self.server.stop()
+        junk = self.du.create_temp_file(hook, body='not bytecode')
+        self.du.run_copy(hook, src=junk, dest=self.pyc, sudo=True)
+        self.server.start()
+        self.run_hook('v2', 'v1')
+        self.du.rm(hook, path=[old, junk], sudo=True, force=True)
+
+    def test_bytecode_removed_with_hook(self):
+        """
+        Deleting a hook removes its bytecode cache.
+        """
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('bc', a, self.body % 'v1')
+        self.run_hook('v1', 'v2')
+        self.assertTrue(self.du.isfile(self.server.hostname, self.pyc,
+                                       sudo=True))
+        self.server.manager(MGR_CMD_DELETE, HOOK, id='bc')
+        self.assertFalse(self.du.isfile(self.server.hostname, self.pyc,
+                                        sudo=True))
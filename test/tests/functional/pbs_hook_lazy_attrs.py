@@ -0,0 +1,149 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestHookLazyAttrs(TestFunctional):
+
+    """
+    This test suite tests that hook object attributes, which are converted
+    to their Python type only when a hook first reads them, come back to
+    the server unchanged whether the hook read them, set them or never
+    touched them.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 2047})
+        self.attrs = {ATTR_p: '-5', ATTR_r: 'n', ATTR_N: 'lazy_job',
+                      ATTR_A: 'acct1', ATTR_v: 'LAZY_A=1,LAZY_B=x y',
+                      ATTR_l + '.walltime': '01:02:03', ATTR_h: None}
+
+    def check_job(self, jid, **changed):
+        """
+        Check that the job carries the attributes it was submitted with,
+        except for those in 'changed', where None means unset
+        """
+        exp = {ATTR_p: -5, ATTR_r: 'False', ATTR_N: 'lazy_job',
+               ATTR_A: 'acct1', ATTR_l + '.walltime': '01:02:03',
+               'job_state': 'H'}
+        exp.update(changed)
+        exp = {k: v for k, v in exp.items() if v is not None}
+        self.server.expect(JOB, exp, id=jid)
+        job = self.server.status(JOB, id=jid)[0]
+        self.assertIn('LAZY_A=1', job[ATTR_v])
+        self.assertIn('LAZY_B=x y', job[ATTR_v])
+
+    def test_untouched_attributes(self):
+        """
+        A queuejob hook that sets one attribute and reads no other leaves
+        the rest of the job as submitted.
+        """
+        hook_body = """
+import pbs
+pbs.event().job.comment = "lazy hook"
+"""
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('lazy', a, hook_body)
+        jid = self.server.submit(Job(TEST_USER, attrs=self.attrs))
+        self.check_job(jid, comment='lazy hook')
+
+    def test_read_attributes(self):
+        """
+        Attributes read by a hook have the values and types of the job,
+        queue and server they came from.
+        """
+        hook_body = """
+import pbs
+e = pbs.event()
+j = e.job
+s = pbs.server()
+pbs.logmsg(pbs.LOG_DEBUG, "lazy: Priority=%d/%s" %
+           (j.Priority, type(j.Priority).__name__))
+pbs.logmsg(pbs.LOG_DEBUG, "lazy: Rerunable=%s/%s" %
+           (j.Rerunable, type(j.Rerunable).__name__))
+pbs.logmsg(pbs.LOG_DEBUG, "lazy: Job_Name=%s" % j.Job_Name)
+pbs.logmsg(pbs.LOG_DEBUG, "lazy: walltime=%s" % j.Resource_List['walltime'])
+pbs.logmsg(pbs.LOG_DEBUG, "lazy: default_queue=%s" % s.default_queue)
+pbs.logmsg(pbs.LOG_DEBUG, "lazy: queue_type=%s" %
+           s.queue(s.default_queue).queue_type)
+"""
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('lazy', a, hook_body)
+        jid = self.server.submit(Job(TEST_USER, attrs=self.attrs))
+        for msg in ('lazy: Priority=-5/int', 'lazy: Rerunable=False/bool',
+                    'lazy: Job_Name=lazy_job', 'lazy: walltime=01:02:03',
+                    'lazy: default_queue=workq', 'lazy: queue_type=Execution'):
+            self.server.log_match(msg)
+        self.check_job(jid)
+
+    def test_read_then_set(self):
+        """
+        A value read and then set by a hook is converted before it is
+        changed, and the new value reaches the server.
+        """
+        hook_body = """
+import pbs
+j = pbs.event().job
+j.Priority = j.Priority + 1
+j.Job_Name = j.Job_Name + "_2"
+del j.Account_Name
+"""
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('lazy', a, hook_body)
+        jid = self.server.submit(Job(TEST_USER, attrs=self.attrs))
+        self.server.expect(JOB, ATTR_A, op=UNSET, id=jid)
+        self.check_job(jid, **{ATTR_p: -4, ATTR_N: 'lazy_job_2',
+                               ATTR_A: None})
+
+    def test_modifyjob_round_trip(self):
+        """
+        A modifyjob hook that does not touch the job leaves the altered
+        job with its original attributes plus the alteration.
+        """
+        hook_body = """
+import pbs
+pbs.event().accept()
+"""
+        a = {'event': 'modifyjob', 'enabled': 'True'}
+        self.server.create_import_hook('lazy', a, hook_body)
+        jid = self.server.submit(Job(TEST_USER, attrs=self.attrs))
+        self.server.alterjob(jid, {ATTR_N: 'renamed'})
+        self.check_job(jid, **{ATTR_N: 'renamed'})
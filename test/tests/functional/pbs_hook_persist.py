@@ -0,0 +1,107 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('hooks')
+class TestHookPersistGlobals(TestFunctional):
+
+    """
+    This test suite tests the pbs.conf setting PBS_PYTHON_PERSIST_HOOKS,
+    which keeps the global namespace of the listed server hooks from one
+    run to the next.
+    """
+
+    body = """
+import pbs
+try:
+    runs += 1
+except NameError:
+    runs = 1
+pbs.logmsg(pbs.LOG_DEBUG, 'persist test runs=%d' % runs)
+pbs.event().accept()
+"""
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_PYTHON_PERSIST_HOOKS'])
+        self.server.restart()
+        TestFunctional.tearDown(self)
+
+    def run_hook(self, persist):
+        """
+        Restart the server with the given setting, then run the hook
+        three times
+        """
+        if persist is None:
+            self.du.unset_pbs_config(self.server.hostname,
+                                     confs=['PBS_PYTHON_PERSIST_HOOKS'])
+        else:
+            self.du.set_pbs_config(self.server.hostname,
+                                   confs={'PBS_PYTHON_PERSIST_HOOKS':
+                                          persist})
+        self.server.restart()
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('pg', a, self.body)
+        start = time.time()
+        for _ in range(3):
+            self.server.submit(Job(TEST_USER))
+        return start
+
+    def test_globals_kept(self):
+        """
+        The globals of a listed hook survive between runs.
+        """
+        start = self.run_hook('other,pg')
+        self.server.log_match('persist test runs=3', starttime=start)
+
+    def test_globals_cleared(self):
+        """
+        Without the setting, or when the hook is not listed, each run
+        starts with fresh globals.
+        """
+        for persist in [None, 'other']:
+            start = self.run_hook(persist)
+            m = self.server.log_match('persist test runs=1',
+                                      starttime=start, n='ALL',
+                                      allmatch=True)
+            self.assertEqual(len(m), 3)
+            self.server.log_match('persist test runs=2', starttime=start,
+                                  existence=False, max_attempts=5)
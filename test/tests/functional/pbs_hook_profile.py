@@ -0,0 +1,181 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('hooks')
+class TestHookProfile(TestFunctional):
+
+    """
+    This test suite tests the read-only hook attribute 'profile', as
+    reported by 'qmgr -c "list hook <name> profile"'.
+    """
+
+    def list_profile(self, name):
+        """
+        Return the profile of the named hook for each event it ran for,
+        as a dictionary of event name to profile string
+        """
+        qmgr = os.path.join(self.server.pbs_conf['PBS_EXEC'], 'bin', 'qmgr')
+        ret = self.du.run_cmd(self.server.hostname,
+                              cmd=[qmgr, '-c', 'list hook %s profile' % name],
+                              sudo=True)
+        self.assertEqual(ret['rc'], 0, '\n'.join(ret['err']))
+        out = ' '.join(l.strip() for l in ret['out'])
+        m = re.search(r'profile = (.*)$', out)
+        self.assertIsNotNone(m, 'no profile in: %s' % out)
+        prof = {}
+        if m.group(1) == 'none':
+            return prof
+        for ent in m.group(1).split('; '):
+            ev, _, rest = ent.partition(': ')
+            prof[ev] = rest
+        return prof
+
+    def counts(self, prof):
+        """
+        Return the outcome counters of a profile string as a dictionary
+        """
+        return {k: int(v) for k, v in
+                re.findall(r'(calls|rejects|timeouts|errors|restarts)=(\d+)',
+                           prof)}
+
+    def phase_count(self, prof, phase):
+        """
+        Return the number of samples in the histogram of a phase
+        """
+        m = re.search(r'%s=\(sum=\d+ max=\d+((?: (?:le|gt)\d+=\d+)*)\)' %
+                      phase, prof)
+        self.assertIsNotNone(m, 'no %s in: %s' % (phase, prof))
+        return sum(int(b.split('=')[1]) for b in m.group(1).split())
+
+    def test_profile_counts(self):
+        """
+        Calls and rejects of a queuejob hook are counted, and each call
+        adds to the histogram of every phase.
+        """
+        hook_body = """
+import pbs
+e = pbs.event()
+if e.job.Job_Name == 'reject_me':
+    e.reject('rejected by profile test')
+"""
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('prof', a, hook_body)
+        self.assertEqual(self.list_profile('prof'), {})
+        self.server.submit(Job(TEST_USER))
+        self.server.submit(Job(TEST_USER))
+        with self.assertRaises(PbsSubmitError):
+            self.server.submit(Job(TEST_USER, attrs={ATTR_N: 'reject_me'}))
+        prof = self.list_profile('prof')
+        self.assertIn('queuejob', prof)
+        self.assertIn('calls=3 rejects=1 timeouts=0 errors=0',
+                      prof['queuejob'])
+        for phase in ('marshal_us', 'run_us', 'apply_us'):
+            self.assertEqual(self.phase_count(prof['queuejob'], phase), 3)
+
+    def test_marshal_every_hook(self):
+        """
+        Every hook of an event gets its marshal time recorded, not only
+        the first one, which builds the event objects.
+        """
+        hook_body = """
+import pbs
+pbs.event().accept()
+"""
+        for name, order in (('prof1', 1), ('prof2', 2)):
+            a = {'event': 'queuejob', 'enabled': 'True', 'order': order}
+            self.server.create_import_hook(name, a, hook_body)
+        for _ in range(2):
+            self.server.submit(Job(TEST_USER))
+        for name in ('prof1', 'prof2'):
+            prof = self.list_profile(name)['queuejob']
+            self.assertIn('calls=2 ', prof)
+            self.assertEqual(self.phase_count(prof, 'marshal_us'), 2)
+
+    def test_background_profile(self):
+        """
+        Management hooks run in the background are accounted when the
+        child running them is reaped: the hook that rejects gets the call
+        and the reject, and the hook after it is not called.
+        """
+        self.du.set_pbs_config(self.server.hostname,
+                               confs={'PBS_HOOK_ASYNC_EVENTS': 'management'})
+        self.server.restart()
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 4095})
+        rej = """
+import pbs
+e = pbs.event()
+for a in e.management.attribs:
+    if a.name == 'comment' and a.value == 'prof':
+        e.reject('background reject')
+"""
+        acc = """
+import pbs
+pbs.event().accept()
+"""
+        a = {'event': 'management', 'enabled': 'True', 'order': 1}
+        self.server.create_import_hook('prof_rej', a, rej)
+        a = {'event': 'management', 'enabled': 'True', 'order': 2}
+        start = time.time()
+        self.server.create_import_hook('prof_acc', a, acc)
+        # hooks of the setup requests run in order, wait for the last one
+        msg = r'background management hooks \(pid \d+\) %s'
+        self.server.log_match(msg % 'accepted the event', regexp=True,
+                              starttime=start)
+        before_rej = self.counts(self.list_profile('prof_rej')['management'])
+        before_acc = self.counts(
+            self.list_profile('prof_acc').get('management', ''))
+
+        start = time.time()
+        self.server.manager(MGR_CMD_SET, SERVER, {'comment': 'prof'})
+        self.server.log_match(msg % 'rejected the event', regexp=True,
+                              starttime=start)
+        after_rej = self.counts(self.list_profile('prof_rej')['management'])
+        after_acc = self.counts(
+            self.list_profile('prof_acc').get('management', ''))
+        self.assertEqual(after_rej['calls'] - before_rej['calls'], 1)
+        self.assertEqual(after_rej['rejects'] - before_rej['rejects'], 1)
+        self.assertEqual(after_acc.get('calls', 0),
+                         before_acc.get('calls', 0))
+
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_HOOK_ASYNC_EVENTS'])
+        self.server.restart()
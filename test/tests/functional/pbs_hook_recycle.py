@@ -0,0 +1,144 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('hooks')
+class TestHookRecycle(TestFunctional):
+
+    """
+    This test suite tests the recycling of a single hook script once its
+    persistent namespace holds more objects than the
+    PBS_PYTHON_HOOK_MAX_BLOCKS pbs.conf setting allows.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.server.hostname,
+                               confs={'PBS_PYTHON_HOOK_MAX_BLOCKS': '1000',
+                                      'PBS_PYTHON_PERSIST_HOOKS':
+                                      'big,small'})
+        self.server.restart()
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 2047})
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_PYTHON_HOOK_MAX_BLOCKS',
+                                        'PBS_PYTHON_PERSIST_HOOKS'])
+        self.server.restart()
+        TestFunctional.tearDown(self)
+
+    def server_rss(self):
+        """
+        Return the resident set size of the server in kB
+        """
+        status = '/proc/%s/status' % self.server.get_pid()
+        ret = self.du.run_cmd(self.server.hostname,
+                              cmd=['grep', 'VmRSS', status], sudo=True)
+        self.assertEqual(ret['rc'], 0, '\n'.join(ret['err']))
+        return int(ret['out'][0].split()[1])
+
+    def test_recycle_only_big_hook(self):
+        """
+        A hook whose globals hold more objects than allowed is recycled
+        after its run, a small hook of the same event is not, and the
+        modules imported by the recycled hook stay loaded.
+        """
+        big = """
+import pbs
+import json
+junk = [str(i) for i in range(5000)]
+pbs.event().accept()
+"""
+        small = """
+import pbs
+import sys
+pbs.logmsg(pbs.LOG_DEBUG, 'json loaded: %s' % ('json' in sys.modules))
+pbs.event().accept()
+"""
+        a = {'event': 'queuejob', 'enabled': 'True', 'order': 1}
+        self.server.create_import_hook('big', a, big)
+        a = {'event': 'queuejob', 'enabled': 'True', 'order': 2}
+        self.server.create_import_hook('small', a, small)
+
+        start = time.time()
+        self.server.submit(Job(TEST_USER))
+        self.server.log_match(r'big\.PY holds \d+ or more objects, '
+                              'recycling it', regexp=True, starttime=start)
+        self.server.log_match('json loaded: True', starttime=start)
+        self.server.log_match(r'small\.PY holds .* recycling it',
+                              regexp=True, starttime=start,
+                              existence=False, max_attempts=5)
+
+        # the recycled hook is compiled again on its next run
+        start = time.time()
+        self.server.submit(Job(TEST_USER))
+        self.server.log_match(r'Compiling script file: <.*big\.PY>',
+                              regexp=True, starttime=start)
+        self.server.log_match(r'Compiling script file: <.*small\.PY>',
+                              regexp=True, starttime=start,
+                              existence=False, max_attempts=5)
+
+    def test_recycle_frees_memory(self):
+        """
+        The memory of a recycled hook is given back.  The server grows
+        while the hook keeps 192MB under the object limit, and is back to
+        its size once a version of the hook that also goes over the limit
+        has run and been recycled.
+        """
+        hog = """
+import pbs
+hog = [bytearray(64 << 20) for i in range(3)]
+%s
+pbs.event().accept()
+"""
+        a = {'event': 'queuejob', 'enabled': 'True'}
+        self.server.create_import_hook('big', a, hog % '')
+        base = self.server_rss()
+        self.server.submit(Job(TEST_USER))
+        self.assertGreater(self.server_rss() - base, 150 * 1024)
+
+        self.server.import_hook('big',
+                                hog % 'junk = [str(i) for i in range(5000)]')
+        start = time.time()
+        self.server.submit(Job(TEST_USER))
+        self.server.log_match(r'big\.PY holds \d+ or more objects, '
+                              'recycling it', regexp=True, starttime=start)
+        self.assertLess(self.server_rss() - base, 50 * 1024)
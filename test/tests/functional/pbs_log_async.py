@@ -0,0 +1,130 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('server')
+class TestLogAsync(TestFunctional):
+
+    """
+    This test suite tests asynchronous logging, enabled by the
+    PBS_LOG_ASYNC pbs.conf setting.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.server.hostname,
+                               confs={'PBS_LOG_ASYNC': '64'})
+        self.server.restart()
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 4095})
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_LOG_ASYNC'])
+        self.server.restart()
+        TestFunctional.tearDown(self)
+
+    def run_script(self, body):
+        """
+        Run a shell script as root on the server host
+        """
+        ret = self.du.run_cmd(self.server.hostname, cmd=body, sudo=True,
+                              as_script=True)
+        self.assertEqual(ret['rc'], 0, '\n'.join(ret['err']))
+
+    def test_records_flushed(self):
+        """
+        Buffered records reach the log while the server runs, and the
+        last ones are written out when the server exits.
+        """
+        start = time.time()
+        self.server.manager(MGR_CMD_SET, SERVER, {'comment': 'async log'})
+        self.server.log_match('Type 9 request received', starttime=start)
+        start = time.time()
+        self.server.stop()
+        self.server.log_match('Server shutdown completed', starttime=start)
+        self.server.start()
+
+    def test_records_dropped(self):
+        """
+        When the log cannot be written and the buffer is full, records
+        are dropped rather than blocking the server, and the number of
+        dropped records is logged once the log can be written again.
+        The log is replaced by a FIFO whose reader is stopped.
+        """
+        logdir = os.path.join(self.server.pbs_conf['PBS_HOME'],
+                              'server_logs')
+        log = os.path.join(logdir, time.strftime('%Y%m%d'))
+        out = self.du.create_temp_file(self.server.hostname)
+        qstat = os.path.join(self.server.pbs_conf['PBS_EXEC'], 'bin',
+                             'qstat')
+
+        self.run_script('mv %s %s.async && mkfifo %s\n'
+                        'nohup cat %s > %s 2>/dev/null </dev/null &\n' %
+                        (log, log, log, log, out))
+        self.server.signal('-HUP')
+        time.sleep(2)
+        self.run_script('pkill -STOP -f "cat %s"' % log)
+        start = time.time()
+        try:
+            self.run_script('for i in $(seq 1 1000); do %s -B; done '
+                            '>/dev/null 2>&1' % qstat)
+            # the server kept serving requests with its log stalled
+            self.assertLess(time.time() - start, 300)
+        finally:
+            self.run_script('pkill -CONT -f "cat %s"' % log)
+            self.run_script('rm -f %s && mv %s.async %s' % (log, log, log))
+            self.server.signal('-HUP')
+        for _ in range(30):
+            ret = self.du.run_cmd(self.server.hostname,
+                                  cmd=['pgrep', '-f', 'cat %s' % log])
+            if ret['rc'] != 0:
+                break
+            time.sleep(1)
+
+        ret = self.du.cat(self.server.hostname, out, sudo=True)
+        lines = ret['out']
+        dropped = [l for l in lines
+                   if 'log records dropped, log buffer full' in l]
+        self.assertTrue(dropped, 'no dropped records reported')
+        # whatever was buffered was written out when the log was closed
+        self.assertIn('Log closed', lines[-1])
+        self.du.rm(self.server.hostname, path=out, sudo=True, force=True)
+        self.server.log_match('Log opened', starttime=start)
@@ -0,0 +1,125 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestMomLauncher(TestFunctional):
+
+    """
+    This test suite tests the $launcher MoM parameter, with which MoM
+    starts job shells and tasks through a helper process forked at
+    startup instead of forking itself.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+        self.mom.add_config({'$launcher': 'true',
+                             '$logevent': '0xffffffff'})
+        self.mom.restart()
+        self.mom.log_match('task launcher started', starttime=self.mom.ctime)
+
+    def job_output(self, jid):
+        """
+        Wait for a job to finish and return its output
+        """
+        self.server.expect(JOB, {'job_state': 'F'}, id=jid, extend='x',
+                           offset=1)
+        job = self.server.status(JOB, id=jid, extend='x')
+        out_file = job[0]['Output_Path'].split(':')[1]
+        ret = self.du.cat(hostname=self.mom.hostname, filename=out_file,
+                          sudo=True)
+        self.du.rm(hostname=self.mom.hostname, path=out_file, sudo=True,
+                   force=True)
+        return '\n'.join(ret.get('out', []))
+
+    def test_launcher_job_shell(self):
+        """
+        A batch job's shell is started through the helper: MoM records
+        it as running without forking, and the job writes its output.
+        """
+        j = Job(TEST_USER)
+        j.create_script('#!/bin/sh\necho launched $PBS_JOBID\n')
+        jid = self.server.submit(j)
+        self.mom.log_match(jid + ';Started, pid =')
+        self.assertIn('launched ' + jid, self.job_output(jid))
+        self.mom.log_match(jid + ';Unable to start job through the task '
+                           'launcher', existence=False, max_attempts=2)
+
+    def test_launcher_job_session(self):
+        """
+        The shell started through the helper runs in its own session,
+        so MoM can kill it when it exceeds its walltime.
+        """
+        j = Job(TEST_USER, attrs={'Resource_List.walltime': 5})
+        j.set_sleep_time(100)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, 'session_id', op=SET, id=jid)
+        self.server.expect(JOB, {'job_state': 'F'}, id=jid, extend='x',
+                           offset=5)
+        self.mom.log_match(jid + ';walltime')
+
+    def test_launcher_tm_spawn(self):
+        """
+        A task spawned with pbsdsh goes through the helper and its
+        output reaches the job.
+        """
+        j = Job(TEST_USER)
+        j.create_script('#!/bin/sh\npbsdsh -n 0 -- /bin/echo spawned\n')
+        jid = self.server.submit(j)
+        self.assertIn('spawned', self.job_output(jid))
+
+    def test_launcher_prologue_fallback(self):
+        """
+        A job with an execjob_prologue hook still forks from MoM, and
+        the prologue and the job both run.
+        """
+        hook_body = 'import pbs\npbs.logmsg(pbs.LOG_DEBUG, "prologue ran")\n'
+        self.server.create_import_hook('prolo',
+                                       {'event': 'execjob_prologue',
+                                        'enabled': 'true'},
+                                       hook_body)
+        j = Job(TEST_USER)
+        j.create_script('#!/bin/sh\necho after prologue\n')
+        jid = self.server.submit(j)
+        self.mom.log_match('prologue ran')
+        self.assertIn('after prologue', self.job_output(jid))
@@ -0,0 +1,128 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestMomProcEvents(TestFunctional):
+
+    """
+    This test suite tests the $proc_events MoM parameter, with which MoM
+    follows job processes from kernel proc connector events instead of
+    scanning /proc for every sample.
+    """
+
+    tracking = 'tracking job processes with the proc connector'
+    fallback = 'proc connector unavailable, disabling $proc_events'
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        if self.mom.is_cpuset_mom():
+            self.skip_test('test does not support cpuset MoMs')
+        if self.du.get_platform(self.mom.hostname) != 'linux':
+            self.skip_test('the proc connector is Linux only')
+
+    def set_proc_events(self):
+        """
+        Turn $proc_events on and check that MoM took the directive
+        """
+        start = time.time()
+        self.mom.add_config({'$proc_events': 'true',
+                             '$logevent': '0xffffffff',
+                             '$min_check_poll': 5,
+                             '$max_check_poll': 10})
+        self.mom.log_match('set_proc_events;true', starttime=start)
+
+    def check_cput(self):
+        """
+        Run a job that burns CPU and check that MoM reports the CPU
+        time and memory it uses
+        """
+        j = Job(TEST_USER)
+        j.create_script('#!/bin/sh\n'
+                        'end=$(($(date +%s) + 20))\n'
+                        'while [ $(date +%s) -lt $end ]; do :; done\n'
+                        'sleep 300\n')
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, {'resources_used.cput': '00:00:00'},
+                           op=NE, id=jid, offset=10, max_attempts=60,
+                           interval=2)
+        self.server.expect(JOB, 'resources_used.mem', op=SET, id=jid)
+        return jid
+
+    def test_proc_events_tracking(self):
+        """
+        With $proc_events on, MoM subscribes to the proc connector once
+        it samples a job, and the job's resources_used still updates.
+        """
+        start = time.time()
+        self.set_proc_events()
+        self.check_cput()
+        try:
+            self.mom.log_match(self.tracking, starttime=start,
+                               max_attempts=5)
+        except PtlLogMatchError:
+            self.mom.log_match(self.fallback, starttime=start)
+            self.skip_test('the proc connector is not available here')
+
+    def test_proc_events_fallback(self):
+        """
+        When the proc connector cannot be opened, MoM turns
+        $proc_events off, goes back to scanning /proc, and the job's
+        resources_used still updates. Binding to the connector needs
+        CAP_NET_ADMIN, so MoM is started without it.
+        """
+        ret = self.du.run_cmd(self.mom.hostname, cmd=['which', 'setpriv'])
+        if ret['rc'] != 0:
+            self.skip_test('setpriv is needed to start MoM without '
+                           'CAP_NET_ADMIN')
+        self.mom.stop()
+        try:
+            start = time.time()
+            self.mom.start(launcher='setpriv --bounding-set -net_admin')
+            self.set_proc_events()
+            jid = self.check_cput()
+            self.mom.log_match(self.fallback, starttime=start)
+            self.mom.log_match(self.tracking, starttime=start,
+                               existence=False, max_attempts=2)
+            self.server.delete(jid)
+            self.server.expect(JOB, 'queue', op=UNSET, id=jid)
+        finally:
+            self.mom.restart()
@@ -0,0 +1,138 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestMomRecoverJobs(TestFunctional):
+
+    """
+    This test suite tests how MoM recovers the jobs under mom_priv/jobs
+    when it restarts: the job files are read and decoded by several
+    threads, and the process table is sampled once for every session.
+    """
+
+    njobs = 6
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': self.njobs}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname)
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+
+    def submit_jobs(self, sleep=300):
+        """
+        Submit njobs jobs with a mix of attribute types and wait for
+        them to run
+        """
+        jids = []
+        for i in range(self.njobs):
+            a = {'Resource_List.select': '1:ncpus=1',
+                 'Resource_List.walltime': 3600,
+                 ATTR_N: 'recov%d' % i,
+                 ATTR_v: 'RECOV_A=a%d,RECOV_B=b\\,c' % i}
+            j = Job(TEST_USER, attrs=a)
+            j.set_sleep_time(sleep)
+            jids.append(self.server.submit(j))
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        return jids
+
+    def test_recover_p_keeps_jobs(self):
+        """
+        Restarting MoM with -p loads every job, samples the process
+        table once, and the jobs keep running with their attributes.
+        """
+        jids = self.submit_jobs(sleep=60)
+        self.mom.stop(sig='-INT')
+        start = time.time()
+        self.mom.start(args=['-p'])
+        self.mom.log_match('init_abort_jobs;.*jobs=%d threads=' % self.njobs,
+                           regexp=True, starttime=start)
+        self.mom.log_match('init_abort_jobs;.*scan', regexp=True,
+                           starttime=start)
+        self.mom.log_match('recovered=%d discarded=0' % self.njobs,
+                           starttime=start)
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'F',
+                                     'Exit_status': 0}, id=jid,
+                               extend='x', offset=1, max_attempts=120)
+
+    def test_recover_r_kills_jobs(self):
+        """
+        Restarting MoM with -r loads every job and kills the sessions
+        using one sample of the process table; the jobs are requeued.
+        """
+        jids = self.submit_jobs()
+        self.mom.stop(sig='-INT')
+        start = time.time()
+        self.mom.start(args=['-r'])
+        self.mom.log_match('init_abort_jobs;.*scan', regexp=True,
+                           starttime=start)
+        self.mom.log_match('recovered=%d discarded=0' % self.njobs,
+                           starttime=start)
+        for jid in jids:
+            self.server.expect(JOB, {'run_count': 1}, op=GT, id=jid,
+                               extend='x')
+
+    def test_recover_bad_job_file(self):
+        """
+        A job file too short to hold the fixed portion is discarded and
+        left as a .BD file, and the other jobs are still recovered.
+        """
+        jids = self.submit_jobs()
+        self.mom.stop(sig='-INT')
+        jobs_dir = os.path.join(self.mom.pbs_conf['PBS_HOME'], 'mom_priv',
+                                'jobs')
+        bad = os.path.join(jobs_dir, jids[0] + '.JB')
+        self.du.run_cmd(self.mom.hostname, ['truncate', '-s', '16', bad],
+                        sudo=True)
+        start = time.time()
+        self.mom.start(args=['-p'])
+        self.mom.log_match('error reading fixed portion of ' + bad,
+                           starttime=start)
+        self.mom.log_match('recovered=%d discarded=1' % (self.njobs - 1),
+                           starttime=start)
+        self.assertTrue(self.du.isfile(self.mom.hostname,
+                                       path=bad[:-3] + '.BD', sudo=True))
+        for jid in jids[1:]:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
@@ -0,0 +1,87 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+import re
+
+from tests.functional import *
+
+
+@tags('sched')
+class TestSchedCycleProfile(TestFunctional):
+
+    """
+    This test suite tests the cycle_profile attribute the scheduler
+    publishes on its sched object.
+    """
+
+    def test_cycle_profile(self):
+        """
+        After a scheduling cycle cycle_profile holds the cycle counts and
+        phase histograms, a manager cannot set it, and 'print sched'
+        does not list it.
+        """
+        # a fresh scheduler publishes its profile after its first cycle
+        self.scheduler.restart()
+        jid = self.server.submit(Job(TEST_USER))
+        self.server.expect(JOB, {ATTR_state: 'R'}, id=jid)
+        self.server.expect(SCHED, 'cycle_profile', op=SET, id='default')
+
+        st = self.server.status(SCHED, 'cycle_profile', id='default')
+        prof = st[0]['cycle_profile']
+        self.logger.info('cycle_profile: %s' % prof)
+        pat = r'cycles=[1-9]\d* jobs_considered=\d+ equiv_skipped=\d+ ' \
+              r'jobs_run=\d+'
+        self.assertTrue(re.match(pat, prof), prof)
+        self.assertIn(' cycle_us=(sum=', prof)
+        self.assertIn(' query_us=(sum=', prof)
+
+        msg = 'Cannot set attribute, read only or insufficient permission'
+        with self.assertRaises(PbsManagerError) as e:
+            self.server.manager(MGR_CMD_SET, SCHED,
+                                {'cycle_profile': 'cycles=0'},
+                                id='default', runas=ROOT_USER)
+        self.assertIn(msg, e.exception.msg[0])
+        st = self.server.status(SCHED, 'cycle_profile', id='default')
+        self.assertNotEqual(st[0]['cycle_profile'], 'cycles=0')
+
+        qmgr = os.path.join(self.server.pbs_conf['PBS_EXEC'], 'bin', 'qmgr')
+        ret = self.du.run_cmd(self.server.hostname,
+                              cmd=[qmgr, '-c', 'print sched'], sudo=True)
+        self.assertEqual(ret['rc'], 0)
+        self.assertNotIn('cycle_profile', '\n'.join(ret['out']))
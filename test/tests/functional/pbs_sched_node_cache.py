@@ -0,0 +1,131 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestSchedNodeCache(TestFunctional):
+
+    """
+    This test suite tests the scheduler's vnode status cache, which
+    asks the server only for the vnodes that changed since its last
+    node status request.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 1}
+        self.mom.create_vnodes(a, 4)
+        self.vn = [self.mom.shortname + '[%d]' % i for i in range(4)]
+
+    def submit(self, select='1:ncpus=1'):
+        """
+        Submit a long running job with the given select
+        """
+        j = Job(TEST_USER, attrs={'Resource_List.select': select})
+        j.set_sleep_time(1000)
+        return self.server.submit(j)
+
+    def fill(self):
+        """
+        Run one job on each vnode, and return their ids
+        """
+        jids = [self.submit() for _ in self.vn]
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        return jids
+
+    def test_changed_vnode_seen(self):
+        """
+        A vnode whose resources change after it was cached is seen
+        with its new value in the next cycle.
+        """
+        self.fill()
+        jid = self.submit()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.ncpus': 2},
+                            id=self.vn[2])
+        self.server.expect(JOB, {'job_state': 'R',
+                                 'exec_vnode': '(%s:ncpus=1)' % self.vn[2]},
+                           id=jid)
+
+    def test_unchanged_vnodes_kept(self):
+        """
+        Vnodes that did not change keep their state in the cache over
+        cycles in which only one vnode is sent.
+        """
+        jids = self.fill()
+        for i in range(3):
+            self.server.delete(jids[i], wait=True)
+            jid = self.submit('1:ncpus=1:vnode=%s' % self.vn[i])
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+            jid = self.submit('1:ncpus=1:vnode=%s' % self.vn[3])
+            self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+            self.server.delete(jid, wait=True)
+
+    def test_deleted_vnode_dropped(self):
+        """
+        A vnode deleted after it was cached is no longer offered to
+        jobs.
+        """
+        jid = self.submit('1:ncpus=1:vnode=%s' % self.vn[1])
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.delete(jid, wait=True)
+        self.server.manager(MGR_CMD_DELETE, NODE, id=self.vn[1])
+        jid = self.submit('1:ncpus=1:vnode=%s' % self.vn[1])
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid, offset=2)
+        msg = 'Can Never Run|Not Running'
+        self.server.expect(JOB, {'comment': (MATCH_RE, msg)}, id=jid)
+
+    def test_server_restart(self):
+        """
+        After a server restart the scheduler's token is stale, it gets
+        a full listing and still sees later changes.
+        """
+        self.fill()
+        self.server.restart()
+        jid = self.submit()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.ncpus': 2},
+                            id=self.vn[0])
+        self.server.expect(JOB, {'job_state': 'R',
+                                 'exec_vnode': '(%s:ncpus=1)' % self.vn[0]},
+                           id=jid)
@@ -0,0 +1,130 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestSchedStatArena(TestFunctional):
+
+    """
+    This test suite tests the scheduler's use of the status arena, in
+    which the job and vnode status replies it reads are decoded into a
+    few large chunks rather than one allocation per string.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_CREATE, RSC,
+                            {'type': 'string', 'flag': 'h'}, id='color')
+        a = {'resources_available.ncpus': 2}
+        self.mom.create_vnodes(a, 10)
+        self.vn = [self.mom.shortname + '[%d]' % i for i in range(10)]
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.color': 'red'},
+                            id=self.vn[3])
+        self.scheduler.add_resource('color')
+
+    def check_cycle(self, start):
+        """
+        Check that a scheduling cycle finished and the scheduler is
+        still up
+        """
+        self.scheduler.log_match('Leaving Scheduling Cycle',
+                                 starttime=start)
+        self.assertTrue(self.scheduler.isUp())
+
+    def test_many_jobs(self):
+        """
+        Jobs whose status spans several arena chunks, including one
+        attribute larger than a chunk, are read and scheduled.
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        j = Job(TEST_USER, attrs={ATTR_v: 'ARENA_BIG=' + 'b' * 70000})
+        j.set_sleep_time(1000)
+        big = self.server.submit(j)
+        jids = []
+        for i in range(40):
+            a = {ATTR_N: 'arena%d' % i,
+                 ATTR_v: 'ARENA_A=%s,ARENA_B=%d' % ('a' * 200, i)}
+            j = Job(TEST_USER, attrs=a)
+            j.set_sleep_time(1000)
+            jids.append(self.server.submit(j))
+        start = time.time()
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.check_cycle(start)
+        self.server.expect(JOB, {'job_state=R': 20})
+        self.server.expect(JOB, {'job_state': 'R'}, id=big)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[18])
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jids[19])
+        self.server.delete(jids[:5], wait=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[23])
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jids[24])
+
+    def test_job_arrays(self):
+        """
+        Array parents and their running subjobs are read correctly.
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        j = Job(TEST_USER, attrs={ATTR_J: '1-30'})
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        j = Job(TEST_USER)
+        j.set_sleep_time(1000)
+        jid2 = self.server.submit(j)
+        start = time.time()
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.check_cycle(start)
+        self.server.expect(JOB, {'job_state': 'B'}, id=jid)
+        self.server.expect(JOB, {'job_state=R': 20}, extend='t')
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+    def test_vnode_string_values(self):
+        """
+        String resources decoded from vnode status into the arena are
+        matched by job selects, over several cycles.
+        """
+        for _ in range(3):
+            j = Job(TEST_USER, attrs={'Resource_List.select':
+                                      '1:ncpus=2:color=red'})
+            j.set_sleep_time(1000)
+            jid = self.server.submit(j)
+            self.server.expect(JOB, {'job_state': 'R',
+                                     'exec_vnode': '(%s:ncpus=2)'
+                                     % self.vn[3]}, id=jid)
+            self.server.delete(jid, wait=True)
@@ -0,0 +1,144 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@requirements(num_moms=4)
+class TestSisterFanout(TestFunctional):
+
+    """
+    This test suite tests the $sister_fanout MoM parameter, with which
+    mother superior relays job-wide KILL_JOB and POLL_JOB requests
+    through a tree of sister MoMs (IM_FANOUT) instead of talking to
+    every sister itself.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        if len(self.moms) != 4:
+            self.skip_test('test requires 4 MoMs as input, '
+                           'use -p moms=<m1>:<m2>:<m3>:<m4>')
+        self.momlist = list(self.moms.values())
+        for m in self.momlist:
+            if m.is_cpuset_mom():
+                self.skip_test('test does not support cpuset MoMs')
+        self.hosts = [m.shortname for m in self.momlist]
+
+    def set_fanout(self, k):
+        """
+        Set $sister_fanout to k on all the MoMs
+        """
+        for m in self.momlist:
+            m.add_config({'$sister_fanout': k,
+                          '$logevent': '0xffffffff',
+                          '$min_check_poll': 5,
+                          '$max_check_poll': 10})
+
+    def submit_job(self):
+        """
+        Submit a job with one chunk on each MoM, in MoM order
+        """
+        select = '+'.join(['vnode=' + h for h in self.hosts])
+        j = Job(TEST_USER, attrs={'Resource_List.select': select})
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        return jid
+
+    def test_kill_through_tree(self):
+        """
+        With $sister_fanout 2, sisters 1 and 2 get the KILL_JOB from
+        mother superior, sister 3 gets it from sister 1, and the job
+        still ends normally.
+        """
+        self.set_fanout(2)
+        jid = self.submit_job()
+        self.server.delete(jid)
+        self.server.expect(JOB, 'queue', id=jid, op=UNSET, offset=1)
+        msg = 'FANOUT of command 2 received from node %d'
+        self.momlist[1].log_match(jid + ';' + msg % 0)
+        self.momlist[2].log_match(jid + ';' + msg % 0)
+        self.momlist[3].log_match(jid + ';' + msg % 1)
+        for m in self.momlist[1:]:
+            m.log_match(jid + ';KILL_JOB received')
+
+    def test_poll_through_tree(self):
+        """
+        With $sister_fanout 2, the POLL_JOB requests go down the tree,
+        the replies come back up, and the job is not killed for want
+        of replies.
+        """
+        self.set_fanout(2)
+        jid = self.submit_job()
+        self.momlist[3].log_match(
+            jid + ';FANOUT of command 7 received from node 1',
+            max_attempts=30, interval=2)
+        self.logger.info('Wait for a few more poll cycles')
+        time.sleep(30)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.momlist[0].log_match('POLL_JOB failed on node',
+                                  existence=False, starttime=self.server.ctime)
+
+    def test_fanout_disabled(self):
+        """
+        By default mother superior sends KILL_JOB to every sister
+        itself, so no MoM sees an IM_FANOUT.
+        """
+        for m in self.momlist:
+            m.add_config({'$logevent': '0xffffffff'})
+        jid = self.submit_job()
+        self.server.delete(jid)
+        self.server.expect(JOB, 'queue', id=jid, op=UNSET, offset=1)
+        for m in self.momlist[1:]:
+            m.log_match(jid + ';KILL_JOB received')
+            m.log_match(jid + ';FANOUT of command', existence=False,
+                        max_attempts=2)
+
+    def test_fanout_of_one_rejected(self):
+        """
+        A fan-out of 1 would relay job-wide requests down a serial chain
+        of sisters, so MoM rejects it as a configuration error.
+        """
+        mom = self.momlist[0]
+        start = time.time()
+        mom.add_config({'$sister_fanout': 1})
+        mom.log_match('command "$sister_fanout 1" failed, aborting',
+                      starttime=start)
+        mom.add_config({'$sister_fanout': 0})
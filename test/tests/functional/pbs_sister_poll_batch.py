@@ -0,0 +1,132 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@requirements(num_moms=2)
+class TestSisterPollBatch(TestFunctional):
+
+    """
+    This test suite tests the $sister_poll_batch MoM parameter, with
+    which sisters push the resources used by all of their jobs to
+    mother superior in one IM_POLL_BATCH message instead of answering
+    an IM_POLL_JOB for each job.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        if len(self.moms) != 2:
+            self.skip_test('test requires 2 MoMs as input, '
+                           'use -p moms=<m1>:<m2>')
+        self.momA, self.momB = list(self.moms.values())
+        self.hostA = self.momA.shortname
+        self.hostB = self.momB.shortname
+
+    def set_batch(self, mom, val):
+        """
+        Set $sister_poll_batch on a MoM, with short poll intervals
+        """
+        mom.add_config({'$sister_poll_batch': val,
+                        '$logevent': '0xffffffff',
+                        '$min_check_poll': 5,
+                        '$max_check_poll': 10,
+                        '$max_poll_downtime': 40})
+
+    def submit_job(self):
+        """
+        Submit a job with mother superior on momA and a chunk on momB
+        """
+        select = 'vnode=%s+vnode=%s' % (self.hostA, self.hostB)
+        j = Job(TEST_USER, attrs={'Resource_List.select': select,
+                                  'Resource_List.place': 'scatter'})
+        j.create_script('#!/bin/sh\nsleep 1000\n')
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        return jid
+
+    def test_batch_poll(self):
+        """
+        With $sister_poll_batch on both MoMs, mother superior gets the
+        sister's usage in batches, does not fall back to IM_POLL_JOB
+        and does not kill the job.
+        """
+        self.set_batch(self.momA, True)
+        self.set_batch(self.momB, True)
+        jid = self.submit_job()
+        self.logger.info('Wait past $max_poll_downtime')
+        time.sleep(60)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.momA.log_match(jid + ';no POLL_BATCH from', existence=False,
+                            starttime=self.server.ctime, max_attempts=2)
+        self.server.expect(JOB, 'resources_used.cput', op=SET, id=jid)
+
+    def test_batch_poll_fallback(self):
+        """
+        If mother superior batches but the sister does not, mother
+        superior falls back to IM_POLL_JOB for the job, the sister's
+        replies keep it alive and the job is not killed after
+        $max_poll_downtime.
+        """
+        self.set_batch(self.momA, True)
+        self.set_batch(self.momB, False)
+        jid = self.submit_job()
+        self.momA.log_match(jid + ';no POLL_BATCH from %s, polling job'
+                            % self.hostB, max_attempts=30, interval=2)
+        self.logger.info('Wait past $max_poll_downtime')
+        time.sleep(60)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.momA.log_match(jid + ';no POLL_BATCH from %s for' % self.hostB,
+                            existence=False, starttime=self.server.ctime,
+                            max_attempts=2)
+
+    def test_batch_sister_only(self):
+        """
+        If the sister batches but mother superior does not, mother
+        superior still polls the job with IM_POLL_JOB and accepts the
+        sister's batches, and the job keeps running.
+        """
+        self.set_batch(self.momA, False)
+        self.set_batch(self.momB, True)
+        jid = self.submit_job()
+        self.logger.info('Wait past $max_poll_downtime')
+        time.sleep(60)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.momA.log_match(jid + ';POLL failed from node', existence=False,
+                            starttime=self.server.ctime, max_attempts=2)
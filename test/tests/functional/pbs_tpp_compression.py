@@ -0,0 +1,121 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('comm')
+class TestTPPCompression(TestFunctional):
+
+    """
+    This test suite tests the TPP compression codecs selected with the
+    PBS_TPP_COMPRESSION_CODEC and PBS_TPP_COMPRESSION_MIN environment
+    variables.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.mom.add_config({'$logevent': '0xffffffff'})
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+
+    def tearDown(self):
+        self.mom.restart()
+        TestFunctional.tearDown(self)
+
+    def start_mom(self, env):
+        """
+        Restart MoM with the given environment and wait for its node
+        to come back
+        """
+        self.mom.stop()
+        start = time.time()
+        self.mom.start(launcher=['env'] + env)
+        self.server.expect(NODE, {'state': 'free'}, id=self.mom.shortname)
+        return start
+
+    def run_big_job(self):
+        """
+        Run a job whose attributes are well over the compression
+        threshold and check that they arrive intact
+        """
+        val = 'x' * 8000
+        j = Job(TEST_USER, attrs={ATTR_v: 'TPP_BIG=' + val})
+        j.create_script('#!/bin/sh\n[ "$TPP_BIG" = "%s" ] || exit 3\n' % val)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'F', 'Exit_status': 0},
+                           id=jid, extend='x', offset=1)
+
+    def test_codec_fast(self):
+        """
+        The fast codec is used above the configured threshold, and
+        the data it compresses is read back by the other daemons.
+        """
+        start = self.start_mom(['PBS_TPP_COMPRESSION_CODEC=fast',
+                                'PBS_TPP_COMPRESSION_MIN=64'])
+        self.mom.log_match('Compressing messages larger than 64 bytes '
+                           'with codec fast', starttime=start)
+        self.run_big_job()
+
+    def test_codec_unsupported(self):
+        """
+        An unknown codec name is logged and the default zlib codec is
+        used instead.
+        """
+        start = self.start_mom(['PBS_TPP_COMPRESSION_CODEC=bogus'])
+        self.mom.log_match('Compression codec bogus not supported, '
+                           'using zlib', starttime=start)
+        self.mom.log_match('with codec zlib', starttime=start)
+        self.run_big_job()
+
+    def test_codec_zstd(self):
+        """
+        When built with zstd, data compressed by MoM with it reaches the
+        server through pbs_comm.
+        """
+        start = self.start_mom(['PBS_TPP_COMPRESSION_CODEC=zstd',
+                                'PBS_TPP_COMPRESSION_MIN=64'])
+        try:
+            self.mom.log_match('Compression codec zstd not supported',
+                               starttime=start, max_attempts=3)
+            self.skipTest('PBS was built without zstd')
+        except PtlLogMatchError:
+            pass
+        self.mom.log_match('with codec zstd', starttime=start)
+        self.run_big_job()
@@ -0,0 +1,159 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('comm')
+class TestTPPIoUring(TestFunctional):
+
+    """
+    This test suite tests the io_uring event monitor backend that TPP
+    uses instead of epoll when PBS_EVENT_BACKEND=io_uring is set in the
+    environment, and its fallback to epoll.
+    """
+
+    not_usable = 'io_uring not usable'
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        if self.du.get_platform() != 'linux':
+            self.skipTest('io_uring is only available on Linux')
+
+    def tearDown(self):
+        self.comm.restart()
+        self.mom.restart()
+        TestFunctional.tearDown(self)
+
+    def start_comm(self, backend):
+        """
+        Restart pbs_comm with the given event backend, reconnect MoM to
+        it and return the number of io_uring instances pbs_comm uses
+        """
+        self.comm.stop()
+        start = time.time()
+        self.comm.start(launcher=['env', 'PBS_EVENT_BACKEND=' + backend])
+        self.mom.restart()
+        self.server.expect(NODE, {'state': 'free'}, id=self.mom.shortname)
+        ret = self.du.run_cmd(self.comm.hostname,
+                              cmd=['ls', '-l', '/proc/%s/fd' %
+                                   self.comm.get_pid()], sudo=True)
+        return start, len([l for l in ret['out'] if 'io_uring' in l])
+
+    def run_jobs(self, njobs=10):
+        """
+        Run a burst of short jobs and check they all finish
+        """
+        jids = []
+        for _ in range(njobs):
+            j = Job(TEST_USER)
+            j.set_sleep_time(1)
+            jids.append(self.server.submit(j))
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'F', 'Exit_status': 0},
+                               id=jid, extend='x', offset=1)
+
+    def test_comm_io_uring(self):
+        """
+        With PBS_EVENT_BACKEND=io_uring, pbs_comm waits for events on
+        io_uring, traffic through it is delivered, and it notices a
+        MoM going away.
+        """
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+        start, nrings = self.start_comm('io_uring')
+        if nrings == 0:
+            self.comm.log_match(self.not_usable, starttime=start)
+            self.skipTest('io_uring is not usable on this host')
+        self.run_jobs()
+        start = time.time()
+        self.mom.stop()
+        self.comm.log_match('Connection from leaf .* down', regexp=True,
+                            starttime=start, max_attempts=10)
+        self.mom.start()
+        self.server.expect(NODE, {'state': 'free'}, id=self.mom.shortname)
+
+    def test_default_backend(self):
+        """
+        Without PBS_EVENT_BACKEND, or with another value, pbs_comm keeps
+        using epoll.
+        """
+        start, nrings = self.start_comm('epoll')
+        self.assertEqual(nrings, 0)
+        self.comm.log_match(self.not_usable, starttime=start,
+                            existence=False, max_attempts=5)
+
+    def test_bench_io_uring(self):
+        """
+        pbs_tppbench, whose leaves and loopback router both use the
+        io_uring backend, delivers all messages intact while a second
+        instance keeps attaching leaves to the router and closing them.
+        """
+        bench = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                             'unsupported', 'pbs_tppbench')
+        if not self.du.isfile(self.server.hostname, path=bench):
+            self.skipTest('pbs_tppbench is not installed')
+        out_file = self.du.create_temp_file()
+        script = ['export PBS_EVENT_BACKEND=io_uring',
+                  '%s -V -n 200 -T 2 -t 4 -s 64,4096,70000 -m 20 -f 8 '
+                  '-d 20 > %s 2>&1 &' % (bench, out_file),
+                  'sleep 5',
+                  'for i in 1 2 3; do',
+                  '    %s -r 127.0.0.1 -p 17099 -a 127.3.0.$i -n 300 -T 2 '
+                  '-s 64 -d 3 -W 0 || exit 1' % bench,
+                  '    sleep 1',
+                  'done',
+                  'wait',
+                  'cat %s' % out_file]
+        ret = self.du.run_cmd(self.server.hostname, cmd='\n'.join(script),
+                              sudo=True, as_script=True)
+        self.du.rm(self.server.hostname, path=out_file, force=True,
+                   sudo=True)
+        out = ret['out']
+        self.logger.info('\n'.join(out))
+        self.assertEqual(ret['rc'], 0, 'pbs_tppbench failed: %s' %
+                         '\n'.join(out + ret['err']))
+        for l in out:
+            if 'leaves registered' in l:
+                n = l.split()
+                self.assertEqual(n[0], n[2], l)
+            elif l.startswith('noroute:'):
+                self.assertIn('noroute:      0, errors 0,', l)
+            elif l.startswith('verified:'):
+                self.assertTrue(l.endswith(' 0 corrupt'), l)
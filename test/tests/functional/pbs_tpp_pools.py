@@ -0,0 +1,107 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('comm')
+class TestTPPPools(TestFunctional):
+
+    """
+    This test suite drives the pbs_comm router code through
+    pbs_tppbench with message sizes spread over all the size classes of
+    the TPP buffer pools and beyond, and has every message checked on
+    delivery, so that a pooled packet, chunk or buffer reused while
+    still in use shows up as a corrupt or lost message.
+    """
+
+    # 24 is the smallest message pbs_tppbench sends, 16384 the largest
+    # pooled buffer class
+    sizes = '24,64,100,128,500,1000,2048,4000,8192,16000,16384,16385,70000'
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.bench = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                                  'unsupported', 'pbs_tppbench')
+        if not self.du.isfile(self.server.hostname, path=self.bench):
+            self.skipTest('pbs_tppbench is not installed')
+
+    def run_bench(self, args):
+        """
+        Run pbs_tppbench as root against its loopback router with
+        payload verification on, and check no message was lost,
+        unroutable or corrupt
+        """
+        cmd = [self.bench, '-V', '-n', '200', '-T', '2', '-t', '4',
+               '-s', self.sizes, '-d', '10', '-W', '1'] + args
+        ret = self.du.run_cmd(self.server.hostname, cmd=cmd, sudo=True)
+        out = ret['out']
+        self.logger.info('\n'.join(out))
+        self.assertEqual(ret['rc'], 0, 'pbs_tppbench failed: %s' %
+                         '\n'.join(out + ret['err']))
+        self.assertIn('200 of 200 leaves registered', '\n'.join(out))
+        res = [l for l in out if l.startswith('noroute:')]
+        self.assertEqual(len(res), 1)
+        self.assertIn('noroute:      0, errors 0,', res[0])
+        res = [l for l in out if l.startswith('verified:')]
+        self.assertEqual(len(res), 1)
+        n = res[0].split()
+        self.assertGreater(int(n[1]), 0, res[0])
+        self.assertEqual(n[3], '0', res[0])
+
+    def test_pooled_sizes_unicast(self):
+        """
+        Unicast messages of all sizes arrive intact
+        """
+        self.run_bench(['-m', '0'])
+
+    def test_pooled_sizes_mcast(self):
+        """
+        Multicast messages, whose payload buffer the router shares
+        between the packets to all members, arrive intact at every
+        member, mixed with unicast ones
+        """
+        self.run_bench(['-m', '50', '-f', '16'])
+
+    def test_pooled_sizes_compressed(self):
+        """
+        Messages compressed above the compression threshold arrive
+        intact
+        """
+        self.run_bench(['-m', '30', '-f', '8', '-c'])
@@ -0,0 +1,105 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('comm')
+class TestTPPRouteLookup(TestFunctional):
+
+    """
+    This test suite drives the pbs_comm router code through
+    pbs_tppbench while leaves keep joining and leaving, so that route
+    lookups done without router_lock run against a changing routing
+    table, and checks every message is still routed and delivered.
+    """
+
+    port = 17099
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.bench = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                                  'unsupported', 'pbs_tppbench')
+        if not self.du.isfile(self.server.hostname, path=self.bench):
+            self.skipTest('pbs_tppbench is not installed')
+
+    def run_bench(self, script):
+        """
+        Run a shell script that drives pbs_tppbench as root and return
+        its output
+        """
+        ret = self.du.run_cmd(self.server.hostname, cmd=script, sudo=True,
+                              as_script=True)
+        self.assertEqual(ret['rc'], 0, 'pbs_tppbench failed: %s' %
+                         '\n'.join(ret['out'] + ret['err']))
+        return ret['out']
+
+    def test_lookup_under_leaf_churn(self):
+        """
+        One pbs_tppbench measures traffic through its loopback router
+        while a second one repeatedly attaches 300 more leaves to the
+        same router and leaves again. All of them must register each
+        time, and no message may be unroutable or lost. Every round
+        uses a source address of its own, since the reserved ports of
+        the previous round are still in TIME_WAIT.
+        """
+        out_file = self.du.create_temp_file()
+        script = ['%s -p %d -n 200 -T 2 -t 4 -s 64,4096 -m 20 -f 8 '
+                  '-d 30 > %s 2>&1 &' % (self.bench, self.port, out_file),
+                  'sleep 5',
+                  'for i in 1 2 3 4 5; do',
+                  '    %s -r 127.0.0.1 -p %d -a 127.2.0.$i -n 300 -T 2 '
+                  '-s 64 -d 3 -W 0 || exit 1' % (self.bench, self.port),
+                  '    sleep 1',
+                  'done',
+                  'wait',
+                  'cat %s' % out_file]
+        out = self.run_bench('\n'.join(script))
+        self.du.rm(self.server.hostname, path=out_file, force=True,
+                   sudo=True)
+        self.logger.info('\n'.join(out))
+        reg = [l for l in out if 'leaves registered' in l]
+        self.assertEqual(len(reg), 6)
+        for l in reg:
+            n = l.split()
+            self.assertEqual(n[0], n[2], l)
+        res = [l for l in out if l.startswith('noroute:')]
+        self.assertEqual(len(res), 6)
+        for l in res:
+            self.assertIn('noroute:      0, errors 0,', l)
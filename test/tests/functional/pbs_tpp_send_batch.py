@@ -0,0 +1,127 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('comm')
+class TestTPPSendBatch(TestFunctional):
+
+    """
+    This test suite tests how TPP gathers the packets queued on a
+    connection into vectored writes, and the send cork window set with
+    the PBS_TPP_SEND_CORK environment variable.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.comm.hostname,
+                               confs={'PBS_COMM_LOG_EVENTS': 511})
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.comm.hostname,
+                                 confs=['PBS_COMM_LOG_EVENTS'])
+        self.comm.restart()
+        self.mom.restart()
+        TestFunctional.tearDown(self)
+
+    def start_comm(self, env=None):
+        """
+        Restart pbs_comm, with the given environment if any, and
+        reconnect MoM to it
+        """
+        self.comm.stop()
+        start = time.time()
+        if env:
+            self.comm.start(launcher=['env'] + env)
+        else:
+            self.comm.start()
+        self.mom.restart()
+        self.server.expect(NODE, {'state': 'free'}, id=self.mom.shortname)
+        return start
+
+    def run_jobs(self, njobs=10):
+        """
+        Run a burst of short jobs and check they all finish
+        """
+        jids = []
+        for _ in range(njobs):
+            j = Job(TEST_USER)
+            j.set_sleep_time(1)
+            jids.append(self.server.submit(j))
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'F', 'Exit_status': 0},
+                               id=jid, extend='x', offset=1)
+
+    def test_send_cork_window(self):
+        """
+        With PBS_TPP_SEND_CORK set, pbs_comm logs the window it uses
+        and traffic through it is still delivered.
+        """
+        start = self.start_comm(['PBS_TPP_SEND_CORK=5'])
+        self.comm.log_match('Using send cork window of 5 ms',
+                            starttime=start)
+        self.run_jobs()
+
+    def test_send_cork_limits(self):
+        """
+        The send cork window is capped at one second, and a negative
+        value turns it off.
+        """
+        start = self.start_comm(['PBS_TPP_SEND_CORK=100000'])
+        self.comm.log_match('Using send cork window of 1000 ms',
+                            starttime=start)
+        start = self.start_comm(['PBS_TPP_SEND_CORK=-5'])
+        self.comm.log_match('Using send cork window', starttime=start,
+                            existence=False, max_attempts=5)
+        self.run_jobs(2)
+
+    def test_vectored_writes(self):
+        """
+        A connection that carried a burst of packets reports on close
+        how many send calls the vectored writes saved.
+        """
+        self.start_comm()
+        self.run_jobs(20)
+        start = time.time()
+        self.mom.stop()
+        self.comm.log_match(r'sent \d+ chunks in \d+ writes, saved \d+ '
+                            'send calls', regexp=True, starttime=start)
@@ -0,0 +1,115 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('commands')
+class TestTracejobIndex(TestFunctional):
+
+    """
+    This test suite tests that tracejob reports the same records whether
+    it reads them through the structured log index or scans the text
+    logs.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.home = self.server.pbs_conf['PBS_HOME']
+        self.day = time.strftime('%Y%m%d')
+        self.logs = [os.path.join(self.home, 'server_logs', self.day),
+                     os.path.join(self.home, 'server_priv', 'accounting',
+                                  self.day)]
+        self.server.stop()
+        self.run_script(''.join('mv -f %s %s.save 2>/dev/null\n'
+                                'rm -f %s.rec %s.idx\n' % (l, l, l, l)
+                                for l in self.logs))
+        # the structured stream is written by the async writer threads
+        self.du.set_pbs_config(self.server.hostname,
+                               confs={'PBS_LOG_ASYNC': '64',
+                                      'PBS_LOG_STRUCTURED': '1'})
+        self.server.start()
+
+    def tearDown(self):
+        self.server.stop()
+        self.du.unset_pbs_config(self.server.hostname,
+                                 confs=['PBS_LOG_ASYNC',
+                                        'PBS_LOG_STRUCTURED'])
+        self.run_script(''.join('rm -f %s %s.rec %s.idx %s.idx.off\n'
+                                'mv -f %s.save %s 2>/dev/null\n' %
+                                (l, l, l, l, l, l) for l in self.logs) +
+                        'exit 0\n')
+        self.server.start()
+        TestFunctional.tearDown(self)
+
+    def run_script(self, body):
+        """
+        Run a shell script as root on the server host
+        """
+        ret = self.du.run_cmd(self.server.hostname, cmd=body, sudo=True,
+                              as_script=True)
+        self.assertEqual(ret['rc'], 0, '\n'.join(ret['err']))
+        return ret['out']
+
+    def test_index_matches_scan(self):
+        """
+        The server log and accounting records tracejob finds through
+        the index are the ones it finds by scanning the text logs.
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 2047})
+        j = Job(TEST_USER, {ATTR_h: None})
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {ATTR_state: 'H'}, id=jid)
+        self.server.delete(jid)
+        self.server.expect(JOB, 'queue', op=UNSET, id=jid)
+        # let the writer threads drain before the files are read
+        self.server.stop()
+
+        for l in self.logs:
+            self.assertTrue(self.du.isfile(self.server.hostname,
+                                           path=l + '.idx', sudo=True),
+                            '%s.idx was not written' % l)
+        tracejob = os.path.join(self.server.pbs_conf['PBS_EXEC'], 'bin',
+                                'tracejob')
+        cmd = '%s -m -l %s\n' % (tracejob, jid)
+        indexed = self.run_script(cmd)
+        scanned = self.run_script(''.join('mv %s.idx %s.idx.off\n' % (l, l)
+                                          for l in self.logs) + cmd)
+        self.assertIn('dequeuing from', '\n'.join(indexed))
+        self.assertEqual(indexed, scanned)
@@ -0,0 +1,90 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@tags('commands')
+class TestTracejobWindow(TestFunctional):
+
+    """
+    This test suite tests the tracejob -t, -B and -E options.
+    """
+
+    def tracejob(self, jid, *opts):
+        """
+        Return what tracejob reports for jid, run with opts
+        """
+        cmd = [os.path.join(self.server.pbs_conf['PBS_EXEC'], 'bin',
+                            'tracejob')] + list(opts) + [jid]
+        ret = self.du.run_cmd(self.server.hostname, cmd=cmd, sudo=True)
+        return ret['out'] + ret['err']
+
+    def test_window(self):
+        """
+        -B and -E report only what was logged inside the window, with or
+        without -t, and -t reports what the sequential scan does.
+        """
+        j = Job(TEST_USER, {ATTR_h: None})
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {ATTR_state: 'H'}, id=jid)
+        time.sleep(3)
+        mid = time.strftime('%m%d%H%M.%S', time.localtime())
+        time.sleep(3)
+        self.server.delete(jid)
+        self.server.expect(JOB, 'queue', op=UNSET, id=jid)
+
+        queued = 'Job Queued at request of'
+        deleted = 'Job to be deleted at request of'
+        full = self.tracejob(jid)
+        self.assertIn(queued, '\n'.join(full))
+        self.assertIn(deleted, '\n'.join(full))
+        self.assertEqual(self.tracejob(jid, '-t', '4'), full)
+
+        for opt in (['-B', mid], ['-B', mid, '-t', '4']):
+            out = '\n'.join(self.tracejob(jid, *opt))
+            self.assertNotIn(queued, out)
+            self.assertIn(deleted, out)
+        for opt in (['-E', mid], ['-E', mid, '-t', '4']):
+            out = '\n'.join(self.tracejob(jid, *opt))
+            self.assertIn(queued, out)
+            self.assertNotIn(deleted, out)
+        # nothing was logged in the second the window covers
+        out = '\n'.join(self.tracejob(jid, '-B', mid, '-E', mid))
+        self.assertIn("Couldn't find Job Id", out)